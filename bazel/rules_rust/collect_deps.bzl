@@ -112,3 +112,38 @@ def get_namespace_json_files(ctx):
             if RustBindingsFromCcInfo in dep
         ]
     return []
+
+def get_cc_import_merged_namespaces_env_files(ctx):
+    """Merges the C++ dependencies' namespace json files for the `cc_import!` macro.
+
+    The merged hierarchy is written to a rustc env file, which sets the
+    CC_IMPORT_MERGED_NAMESPACES environment variable. `cc_import!` then uses it instead of merging
+    the files listed in CC_IMPORT_NAMESPACES in every expansion.
+
+    Args:
+        ctx (ctx): The target's context object.
+
+    Returns:
+        list[Artifact]: The rustc env files to add to the target's `rustc_env_files`.
+    """
+    namespace_json_files = get_namespace_json_files(ctx)
+
+    # There is nothing to merge in a single file. The namespaces of the underlying `crate` of a
+    # `rust_test` are not known here, so its hierarchy is merged by `cc_import!`.
+    if (len(namespace_json_files) < 2 or getattr(ctx.attr, "crate", None) or
+        not hasattr(ctx.executable, "_cc_import_merged_namespaces_builder")):
+        return []
+
+    env_file = ctx.actions.declare_file(ctx.label.name + "_cc_import_namespaces.env")
+    args = ctx.actions.args()
+    args.add(env_file, format = "--out=%s")
+    args.add_all(namespace_json_files)
+    ctx.actions.run(
+        executable = ctx.executable._cc_import_merged_namespaces_builder,
+        inputs = namespace_json_files,
+        outputs = [env_file],
+        arguments = [args],
+        mnemonic = "CcImportMergeNamespaces",
+        progress_message = "Merging the C++ namespaces of %{label}",
+    )
+    return [env_file]
@@ -72,7 +72,7 @@ def _get_dep_bindings_infos(ctx):
         if CcBindingsFromRustInfo in dep
     ]
 
-def _generate_bindings(ctx, basename, inputs, args, rustc_env):
+def _generate_bindings(ctx, basename, inputs, args, rustc_env, use_persistent_worker):
     """Invokes the `cc_bindings_from_rs` tool to generate C++ bindings for a Rust crate.
 
     Args:
@@ -81,11 +81,15 @@ def _generate_bindings(ctx, basename, inputs, args, rustc_env):
       inputs: `cc_bindings_from_rs` inputs specific to the target `crate`
       args: `rustc` and `process_wrapper` arguments from construct_arguments.
       rustc_env: `rustc` environment to use when running `cc_bindings_from_rs`
+      use_persistent_worker: Whether to run `cc_bindings_from_rs` as a persistent worker
+        (instead of through `process_wrapper`)
 
     Returns:
-      A pair of files:
+      A tuple of files:
       - h_out_file (named "<basename>_cc_api.h")
       - rs_out_file (named "<basename>_cc_api_impl.rs")
+      - bloat_report_output (named "<basename>_cc_api_bloat_report.json"), or None unless the
+        `generate_bloat_report` build setting is enabled
     """
     h_out_file = ctx.actions.declare_file(basename + "_cc_api.h")
     rs_out_file = ctx.actions.declare_file(basename + "_cc_api_impl.rs")
@@ -100,6 +104,10 @@ def _generate_bindings(ctx, basename, inputs, args, rustc_env):
     crubit_args.add("--rustfmt-exe-path", ctx.file._rustfmt)
     crubit_args.add("--rustfmt-config-path", ctx.file._rustfmt_cfg)
 
+    # The crate is type-checked and borrow-checked when compiling the Rust
+    # target itself, so there is no need to repeat that analysis here.
+    crubit_args.add("--skip-full-analysis")
+
     for dep_bindings_info in _get_dep_bindings_infos(ctx):
         for header in dep_bindings_info.headers:
             arg = dep_bindings_info.crate_key + "=" + header.short_path
@@ -113,18 +121,66 @@ def _generate_bindings(ctx, basename, inputs, args, rustc_env):
             error_report_output.path,
         )
         outputs.append(error_report_output)
+    if ctx.attr._generate_profile[BuildSettingInfo].value:
+        profile_output = ctx.actions.declare_file(basename + "_cc_api_profile.json")
+        crubit_args.add(
+            "--profile-out",
+            profile_output.path,
+        )
+        outputs.append(profile_output)
+    bloat_report_output = None
+    if ctx.attr._generate_bloat_report[BuildSettingInfo].value:
+        bloat_report_output = ctx.actions.declare_file(basename + "_cc_api_bloat_report.json")
+        crubit_args.add(
+            "--bloat-report-out",
+            bloat_report_output.path,
+        )
+        outputs.append(bloat_report_output)
+
+    inputs = depset(
+        [ctx.file._clang_format, ctx.file._rustfmt, ctx.file._rustfmt_cfg],
+        transitive = [inputs],
+    )
+    progress_message = "Generating C++ bindings from Rust: %s" % h_out_file
+
+    if use_persistent_worker:
+        # Bazel starts a worker with the arguments of the action that are not flag files, and
+        # sends it the contents of the flag files as the arguments of each request. Actions only
+        # share a worker if they have the same startup arguments and environment, so everything
+        # that is specific to the crate goes in the flag files: the crate's environment as
+        # `--rustc-env` flags, and its `rustc` flags. The worker replaces `${pwd}` in the
+        # arguments, as `process_wrapper` would.
+        for name, value in rustc_env.items():
+            crubit_args.add("--rustc-env={}={}".format(name, value))
+        crubit_args.add("--")
+        crubit_args.set_param_file_format("multiline")
+        crubit_args.use_param_file("@%s", use_always = True)
+
+        # TODO(b/254049425): We shouldn't override the panic arg, and instead work fine in any case.
+        args.rustc_flags.add("-Cpanic=abort")
+        args.rustc_flags.use_param_file("@%s", use_always = True)
+        ctx.actions.run(
+            outputs = outputs,
+            inputs = inputs,
+            executable = ctx.executable._cc_bindings_from_rs_tool,
+            mnemonic = "CcBindingsFromRust",
+            progress_message = progress_message,
+            arguments = [crubit_args, args.rustc_flags],
+            execution_requirements = {
+                "requires-worker-protocol": "json",
+                "supports-workers": "1",
+            },
+        )
+        return (h_out_file, rs_out_file, bloat_report_output)
 
     ctx.actions.run(
         outputs = outputs,
-        inputs = depset(
-            [ctx.file._clang_format, ctx.file._rustfmt, ctx.file._rustfmt_cfg],
-            transitive = [inputs],
-        ),
+        inputs = inputs,
         env = rustc_env,
         tools = [ctx.executable._cc_bindings_from_rs_tool],
         executable = ctx.executable._process_wrapper,
         mnemonic = "CcBindingsFromRust",
-        progress_message = "Generating C++ bindings from Rust: %s" % h_out_file,
+        progress_message = progress_message,
         # We don't use `args.all` here, because we want to do a couple of things:
         #
         # 1. specifically separate the crubit_args from the rustc_args, via `--`, putting crubit
@@ -139,7 +195,7 @@ def _generate_bindings(ctx, basename, inputs, args, rustc_env):
         arguments = [args.process_wrapper_flags, "--", ctx.executable._cc_bindings_from_rs_tool.path, crubit_args, "--", args.rustc_flags, "-Cpanic=abort"],
     )
 
-    return (h_out_file, rs_out_file)
+    return (h_out_file, rs_out_file, bloat_report_output)
 
 def _make_cc_info_for_h_out_file(ctx, h_out_file, cc_infos):
     """Creates and returns CcInfo for the generated ..._cc_api.h header file.
@@ -290,12 +346,20 @@ def _cc_bindings_from_rust_aspect_impl(target, ctx):
         skip_expanding_rustc_env = True,
     )
 
-    (h_out_file, rs_out_file) = _generate_bindings(
+    # The worker doesn't read the `--env-file` and `--arg-file` of build scripts, which are
+    # handled by `process_wrapper`.
+    use_persistent_worker = (
+        ctx.attr._use_persistent_worker[BuildSettingInfo].value and
+        not build_env_files and
+        not build_flags_files
+    )
+    (h_out_file, rs_out_file, bloat_report_output) = _generate_bindings(
         ctx,
         basename,
         compile_inputs,
         args,
         env,
+        use_persistent_worker,
     )
 
     impl_cc_info = _compile_rs_out_file(ctx, rs_out_file, target)
@@ -314,7 +378,11 @@ def _cc_bindings_from_rust_aspect_impl(target, ctx):
             crate_key = crate_info.name,
             headers = [h_out_file],
         ),
-        OutputGroupInfo(out = depset([h_out_file, rs_out_file])),
+        OutputGroupInfo(
+            out = depset([h_out_file, rs_out_file]),
+            # For //common:bloat_report_aggregator.
+            bloat_report = depset([bloat_report_output] if bloat_report_output else []),
+        ),
     ]
 
 cc_bindings_from_rust_aspect = aspect(
@@ -342,6 +410,8 @@ cc_bindings_from_rust_aspect = aspect(
             default = [
                 "//support/internal:bindings_support",
                 "//support/rs_std:rs_char",
+                "//support/rs_std:slice_ref",
+                "//support/rs_std:str_ref",
             ],
         ),
         "_process_wrapper": attr.label(
@@ -373,6 +443,15 @@ cc_bindings_from_rust_aspect = aspect(
         "_generate_error_report": attr.label(
             default = "//cc_bindings_from_rs/bazel_support:generate_error_report",
         ),
+        "_generate_profile": attr.label(
+            default = "//cc_bindings_from_rs/bazel_support:generate_profile",
+        ),
+        "_generate_bloat_report": attr.label(
+            default = "//cc_bindings_from_rs/bazel_support:generate_bloat_report",
+        ),
+        "_use_persistent_worker": attr.label(
+            default = "//cc_bindings_from_rs/bazel_support:use_persistent_worker",
+        ),
     },
     toolchains = [
         "@rules_rust//rust:toolchain_type",
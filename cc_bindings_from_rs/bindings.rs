@@ -4,6 +4,7 @@
 #![feature(rustc_private)]
 #![deny(rustc::internal)]
 
+extern crate rustc_ast;
 extern crate rustc_attr;
 extern crate rustc_hir;
 extern crate rustc_infer;
@@ -14,6 +15,7 @@ extern crate rustc_trait_selection;
 extern crate rustc_type_ir;
 
 use arc_anyhow::{Context, Error, Result};
+use bloat_report::{BloatReport, ItemBloat, TokenCounts};
 use code_gen_utils::{
     escape_non_identifier_chars, format_cc_ident, format_cc_includes, make_rs_ident, CcInclude,
     NamespaceQualifier,
@@ -21,10 +23,14 @@ use code_gen_utils::{
 use error_report::{anyhow, bail, ensure, ErrorReporting};
 use itertools::Itertools;
 use proc_macro2::{Ident, Literal, TokenStream};
+use profiler::Profiler;
 use quote::{format_ident, quote, ToTokens};
+use rustc_ast::ast::LitKind;
 use rustc_attr::find_deprecation;
 use rustc_hir::def::{DefKind, Res};
-use rustc_hir::{AssocItemKind, Item, ItemKind, Node, Safety, UseKind, UsePath};
+use rustc_hir::{
+    AssocItemKind, BlockCheckMode, ExprKind, Item, ItemKind, Node, QPath, Safety, UseKind, UsePath,
+};
 use rustc_infer::infer::TyCtxtInferExt;
 use rustc_middle::dep_graph::DepContext;
 use rustc_middle::mir::Mutability;
@@ -35,6 +41,7 @@ use rustc_target::abi::{Abi, FieldsShape, Integer, Layout, Primitive, Scalar};
 use rustc_target::spec::PanicStrategy;
 use rustc_trait_selection::infer::InferCtxtExt;
 use rustc_type_ir::RegionKind;
+use std::cell::RefCell;
 use std::collections::{BTreeSet, HashMap, HashSet};
 use std::hash::{Hash, Hasher};
 use std::iter::once;
@@ -68,6 +75,26 @@ memoized::query_group! {
         #[input]
         fn errors(&self) -> Rc<dyn ErrorReporting>;
 
+        /// Collects the time spent in formatting each item (and in the other
+        /// phases of `format_crate`) for the `--profile-out` report.
+        #[input]
+        fn profiler(&self) -> Rc<Profiler>;
+
+        /// Collects the code generated for each item for the
+        /// `--bloat-report-out` report, if requested.
+        #[input]
+        fn bloat_report(&self) -> Option<Rc<RefCell<BloatReport>>>;
+
+        /// When set, the C++ bindings for each top-level module of the crate
+        /// are generated into a separate header, named
+        /// `<module_header_prefix>.<module name>.h`.  The main header then only
+        /// contains the bindings for the items in the crate root, and
+        /// `#include`s all the module headers.  This way, C++ code that only
+        /// uses one module of a big crate can include (and parse) just that
+        /// module's header.
+        #[input]
+        fn module_header_prefix(&self) -> Option<Rc<str>>;
+
         // TODO(b/262878759): Provide a set of enabled/disabled Crubit features.
         #[input]
         fn _features(&self) -> ();
@@ -109,6 +136,12 @@ fn support_header<'tcx>(db: &dyn BindingsGenerator<'tcx>, suffix: &'tcx str) ->
 pub struct Output {
     pub h_body: TokenStream,
     pub rs_body: TokenStream,
+
+    /// The file names and bodies of the headers of the top-level modules of
+    /// the crate, which should be placed next to the main header (see
+    /// `BindingsGenerator::module_header_prefix`).  Empty if the bindings are
+    /// not split into per-module headers.
+    pub module_h_bodies: Vec<(Rc<str>, TokenStream)>,
 }
 
 pub fn generate_bindings(db: &Database) -> Result<Output> {
@@ -127,21 +160,28 @@ pub fn generate_bindings(db: &Database) -> Result<Output> {
         quote! { __COMMENT__ #txt __NEWLINE__ }
     };
 
-    let Output { h_body, rs_body } = format_crate(db).unwrap_or_else(|err| {
+    let Output { h_body, rs_body, module_h_bodies } = format_crate(db).unwrap_or_else(|err| {
         let txt = format!("Failed to generate bindings for the crate: {err}");
         let src = quote! { __COMMENT__ #txt };
-        Output { h_body: src.clone(), rs_body: src }
+        Output { h_body: src.clone(), rs_body: src, module_h_bodies: vec![] }
     });
 
-    let h_body = quote! {
-        #top_comment
+    let format_h_body = |h_body: TokenStream| {
+        quote! {
+            #top_comment
 
-        // TODO(b/251445877): Replace `#pragma once` with include guards.
-        __HASH_TOKEN__ pragma once __NEWLINE__
-        __NEWLINE__
+            // TODO(b/251445877): Replace `#pragma once` with include guards.
+            __HASH_TOKEN__ pragma once __NEWLINE__
+            __NEWLINE__
 
-        #h_body
+            #h_body
+        }
     };
+    let h_body = format_h_body(h_body);
+    let module_h_bodies = module_h_bodies
+        .into_iter()
+        .map(|(file_name, h_body)| (file_name, format_h_body(h_body)))
+        .collect();
 
     let rs_body = quote! {
         #top_comment
@@ -156,7 +196,7 @@ pub fn generate_bindings(db: &Database) -> Result<Output> {
         #rs_body
     };
 
-    Ok(Output { h_body, rs_body })
+    Ok(Output { h_body, rs_body, module_h_bodies })
 }
 
 #[derive(Clone, Debug, Default)]
@@ -335,8 +375,16 @@ impl FullyQualifiedName {
 
 /// Whether functions using `extern "C"` ABI can safely handle values of type
 /// `ty` (e.g. when passing by value arguments or return values of such type).
-fn is_c_abi_compatible_by_value(ty: Ty) -> bool {
+fn is_c_abi_compatible_by_value<'tcx>(tcx: TyCtxt<'tcx>, ty: Ty<'tcx>) -> bool {
     match ty.kind() {
+        // Crubit only assumes that `&[T]` and `&str` have the same *layout* as
+        // `rs_std::SliceRef<T>` and `rs_std::StrRef` (see
+        // `rust_builtin_type_abi_assumptions.md`) and therefore slice and string references are
+        // passed by pointer (the pointed-to elements or characters are still not copied).
+        ty::TyKind::Ref(_, referent_ty, _)
+            if matches!(referent_ty.kind(), ty::TyKind::Slice(_) | ty::TyKind::Str) =>
+            false,
+
         // `improper_ctypes_definitions` warning doesn't complain about the following types:
         ty::TyKind::Bool |
         ty::TyKind::Float{..} |
@@ -361,14 +409,16 @@ fn is_c_abi_compatible_by_value(ty: Ty) -> bool {
         // - To replicate field offsets, Crubit may insert explicit padding fields. These
         //   extra fields may also impact the ABI of the generated bindings.
         //
+        // `is_c_abi_compatible_adt` returns `true` for the structs where neither of this can
+        // happen (and `false` for tuples).
+        //
         // TODO(lukasza): In the future, some additional performance gains may be realized by
-        // returning `true` in a few limited cases (this may require additional complexity to
-        // ensure that `format_adt` never injects explicit padding into such structs):
-        // - `#[repr(C)]` structs and unions,
+        // returning `true` in a few more limited cases:
+        // - `#[repr(C)]` unions,
         // - `#[repr(transparent)]` struct that wraps an ABI-safe type,
         // - Discriminant-only enums (b/259984090).
         ty::TyKind::Tuple{..} |  // An empty tuple (`()` - the unit type) is handled above.
-        ty::TyKind::Adt{..} => false,
+        ty::TyKind::Adt{..} => is_c_abi_compatible_adt(tcx, ty),
 
         // These kinds of reference-related types are not implemented yet - `is_c_abi_compatible_by_value`
         // should never need to handle them, because `format_ty_for_cc` fails for such types.
@@ -391,6 +441,54 @@ fn is_c_abi_compatible_by_value(ty: Ty) -> bool {
     }
 }
 
+/// Whether the C++ bindings of the ADT `ty` have the same `extern "C"` ABI as
+/// `ty` itself (always `false` if `ty` is not an ADT).  This is the case for non-generic, `#[repr(C)]` structs
+/// (without `packed` or `align` modifiers) where all fields are either
+/// primitive types that map to C++ fundamental types, or (recursively) such
+/// structs:
+/// - `#[repr(C)]` means that Rust and C++ lay out and pass the struct the same
+///   way, as long as the C++ struct has the same fields.
+/// - Since all fields have known C++ types, `format_fields` doesn't replace any
+///   of them with a blob of bytes, and relies on the natural `#[repr(C)]`
+///   padding rather than inserting explicit padding fields.
+/// - Not needing drop means that the C++ bindings have a trivial destructor and
+///   a trivial (bitwise) move constructor.  Their copy constructor may call a
+///   `Clone` thunk, or be deleted, but since C++ bindings of structs are
+///   `[[clang::trivial_abi]]` they are still passed and returned in registers
+///   like the C struct with the same fields (and the callee owns by-value
+///   parameters, as in Rust).
+/// - Empty structs are excluded, because their size is 0 in Rust, but 1 in C++.
+fn is_c_abi_compatible_adt<'tcx>(tcx: TyCtxt<'tcx>, ty: Ty<'tcx>) -> bool {
+    let ty::TyKind::Adt(adt_def, substs_ref) = ty.kind() else {
+        return false;
+    };
+    let repr = adt_def.repr();
+    let is_field_c_abi_compatible = |field_ty: Ty<'tcx>| match field_ty.kind() {
+        ty::TyKind::Bool
+        | ty::TyKind::Float(ty::FloatTy::F32 | ty::FloatTy::F64)
+        | ty::TyKind::Int(
+            ty::IntTy::I8 | ty::IntTy::I16 | ty::IntTy::I32 | ty::IntTy::I64 | ty::IntTy::Isize,
+        )
+        | ty::TyKind::Uint(
+            ty::UintTy::U8
+            | ty::UintTy::U16
+            | ty::UintTy::U32
+            | ty::UintTy::U64
+            | ty::UintTy::Usize,
+        ) => true,
+        ty::TyKind::Adt(..) => is_c_abi_compatible_adt(tcx, field_ty),
+        _ => false,
+    };
+    adt_def.is_struct()
+        && substs_ref.is_empty()
+        && repr.c()
+        && !repr.packed()
+        && repr.align.is_none()
+        && !ty.needs_drop(tcx, tcx.param_env(adt_def.did()))
+        && adt_def.all_fields().next().is_some()
+        && adt_def.all_fields().all(|field| is_field_c_abi_compatible(field.ty(tcx, substs_ref)))
+}
+
 /// Location where a type is used.
 #[derive(PartialEq, Eq, Hash, Copy, Clone, Debug)]
 enum TypeLocation {
@@ -436,6 +534,53 @@ fn format_pointer_or_reference_ty_for_cc<'tcx>(
     Ok(CcSnippet { prereqs, tokens: quote! { #tokens #const_qualifier #pointer_sigil } })
 }
 
+/// Asserts that the target architecture meets the assumption from Crubit's
+/// `rust_builtin_type_abi_assumptions.md` - we assume that `&[T]` and `&str`
+/// have the same layout as `rs_std::SliceRef<T>` and `rs_std::StrRef`: a
+/// pointer followed by a `usize` number of elements.
+fn assert_slice_ref_layout<'tcx>(tcx: TyCtxt<'tcx>, slice_ref_ty: Ty<'tcx>) {
+    let layout = tcx
+        .layout_of(ty::ParamEnv::empty().and(tcx.erase_regions(slice_ref_ty)))
+        .expect("`layout_of` is expected to succeed for slice references of sized types")
+        .layout;
+    let pointer_size = tcx.data_layout.pointer_size.bytes();
+    assert_eq!(pointer_size, layout.align().abi.bytes());
+    assert_eq!(2 * pointer_size, layout.size().bytes());
+    assert!(matches!(
+        layout.abi(),
+        Abi::ScalarPair(
+            Scalar::Initialized { value: Primitive::Pointer(_), .. },
+            Scalar::Initialized { value: Primitive::Int(_, /* signedness = */ false), .. },
+        )
+    ));
+}
+
+/// Formats a `&[T]` (or `&mut [T]`) slice reference as `rs_std::SliceRef<T
+/// const>` (or `rs_std::SliceRef<T>`).
+fn format_slice_ref_ty_for_cc<'tcx>(
+    db: &dyn BindingsGenerator<'tcx>,
+    slice_ref_ty: Ty<'tcx>,
+    element_ty: Ty<'tcx>,
+    mutability: rustc_middle::mir::Mutability,
+) -> Result<CcSnippet> {
+    let tcx = db.tcx();
+    assert_slice_ref_layout(tcx, slice_ref_ty);
+
+    ensure!(!element_ty.is_c_void(tcx), "Slices of `c_void` are not supported");
+    let const_qualifier = match mutability {
+        Mutability::Mut => quote! {},
+        Mutability::Not => quote! { const },
+    };
+    // `rs_std::SliceRef<T>` only holds a `T*` and therefore (like for pointers) a forward
+    // declaration of `T` is sufficient.
+    let CcSnippet { tokens: element_ty, mut prereqs } = db
+        .format_ty_for_cc(element_ty, TypeLocation::Other)
+        .with_context(|| format!("Failed to format the element type of `{slice_ref_ty}`"))?;
+    prereqs.move_defs_to_fwd_decls();
+    prereqs.includes.insert(db.support_header("rs_std/slice_ref.h"));
+    Ok(CcSnippet { prereqs, tokens: quote! { rs_std::SliceRef< #element_ty #const_qualifier > } })
+}
+
 /// Formats `ty` into a `CcSnippet` that represents how the type should be
 /// spelled in a C++ declaration of a function parameter or field.
 fn format_ty_for_cc<'tcx>(
@@ -598,6 +743,24 @@ fn format_ty_for_cc<'tcx>(
                      function parameter types and return types (b/286256327)",
                 ),
             };
+            match referent_ty.kind() {
+                ty::TyKind::Slice(element_ty) => {
+                    return format_slice_ref_ty_for_cc(db, ty, *element_ty, *mutability);
+                }
+                ty::TyKind::Str => {
+                    ensure!(
+                        *mutability == Mutability::Not,
+                        "`&mut str` is not supported, because C++ could use it to write \
+                         invalid UTF-8"
+                    );
+                    assert_slice_ref_layout(tcx, ty);
+                    return Ok(CcSnippet::with_include(
+                        quote! { rs_std::StrRef },
+                        db.support_header("rs_std/str_ref.h"),
+                    ));
+                }
+                _ => (),
+            }
             let lifetime = format_region_as_cc_lifetime(region);
             format_pointer_or_reference_ty_for_cc(
                 db,
@@ -616,7 +779,7 @@ fn format_ty_for_cc<'tcx>(
                 Some(sig) => sig,
             };
             check_fn_sig(&sig)?;
-            is_thunk_required(&sig).context("Function pointers can't have a thunk")?;
+            is_thunk_required(tcx, &sig).context("Function pointers can't have a thunk")?;
 
             // `is_thunk_required` check above implies `extern "C"` (or `"C-unwind"`).
             // This assertion reinforces that the generated C++ code doesn't need
@@ -731,6 +894,13 @@ fn format_ty_for_rs(tcx: TyCtxt, ty: Ty) -> Result<TokenStream> {
             let lifetime = format_region_as_rs_lifetime(region);
             quote! { & #lifetime #mutability #ty }
         }
+        ty::TyKind::Str => quote! { str },
+        ty::TyKind::Slice(element_ty) => {
+            let element_ty = format_ty_for_rs(tcx, *element_ty).with_context(|| {
+                format!("Failed to format the element type of the slice type `{ty}`")
+            })?;
+            quote! { [#element_ty] }
+        }
         _ => bail!("The following Rust type is not supported yet: {ty}"),
     })
 }
@@ -834,7 +1004,7 @@ fn format_thunk_decl<'tcx>(
             .zip(cc_types.into_iter())
             .map(|(&ty, cc_type)| -> Result<TokenStream> {
                 let cc_type = cc_type.into_tokens(&mut prereqs);
-                if is_c_abi_compatible_by_value(ty) {
+                if is_c_abi_compatible_by_value(tcx, ty) {
                     Ok(quote! { #cc_type })
                 } else {
                     // Rust thunk will move a value via memcpy - we need to `ensure` that
@@ -851,7 +1021,7 @@ fn format_thunk_decl<'tcx>(
     };
 
     let thunk_ret_type: TokenStream;
-    if is_c_abi_compatible_by_value(sig.output()) {
+    if is_c_abi_compatible_by_value(tcx, sig.output()) {
         thunk_ret_type = main_api_ret_type;
     } else {
         thunk_ret_type = quote! { void };
@@ -903,7 +1073,7 @@ fn format_thunk_impl<'tcx>(
         .map(|(param_name, ty)| {
             let rs_type = format_ty_for_rs(tcx, *ty)
                 .with_context(|| format!("Error handling parameter `{param_name}`"))?;
-            Ok(if is_c_abi_compatible_by_value(*ty) {
+            Ok(if is_c_abi_compatible_by_value(tcx, *ty) {
                 quote! { #param_name: #rs_type }
             } else {
                 quote! { #param_name: &mut ::core::mem::MaybeUninit<#rs_type> }
@@ -914,7 +1084,7 @@ fn format_thunk_impl<'tcx>(
     let mut thunk_ret_type = format_ty_for_rs(tcx, sig.output())?;
     let mut thunk_body = {
         let fn_args = param_names_and_types.iter().map(|(rs_name, ty)| {
-            if is_c_abi_compatible_by_value(*ty) {
+            if is_c_abi_compatible_by_value(tcx, *ty) {
                 quote! { #rs_name }
             } else if let Safety::Unsafe = sig.safety {
                 // The whole call will be wrapped in `unsafe` below.
@@ -932,7 +1102,7 @@ fn format_thunk_impl<'tcx>(
     if let Safety::Unsafe = sig.safety {
         thunk_body = quote! {unsafe {#thunk_body}};
     }
-    if !is_c_abi_compatible_by_value(sig.output()) {
+    if !is_c_abi_compatible_by_value(tcx, sig.output()) {
         thunk_params.push(quote! {
             __ret_slot: &mut ::core::mem::MaybeUninit<#thunk_ret_type>
         });
@@ -999,7 +1169,7 @@ fn check_fn_sig(sig: &ty::FnSig) -> Result<()> {
 
 /// Returns `Ok(())` if no thunk is required.
 /// Otherwise returns an error the describes why the thunk is needed.
-fn is_thunk_required(sig: &ty::FnSig) -> Result<()> {
+fn is_thunk_required<'tcx>(tcx: TyCtxt<'tcx>, sig: &ty::FnSig<'tcx>) -> Result<()> {
     match sig.abi {
         // "C" ABI is okay: Before https://rust-lang.github.io/rfcs/2945-c-unwind-abi.html a
         // Rust panic that "escapes" a "C" ABI function leads to Undefined Behavior.  This is
@@ -1022,9 +1192,12 @@ fn is_thunk_required(sig: &ty::FnSig) -> Result<()> {
         _ => bail!("Calling convention other than `extern \"C\"` requires a thunk"),
     };
 
-    ensure!(is_c_abi_compatible_by_value(sig.output()), "Return type requires a thunk");
+    ensure!(is_c_abi_compatible_by_value(tcx, sig.output()), "Return type requires a thunk");
     for (i, param_ty) in sig.inputs().iter().enumerate() {
-        ensure!(is_c_abi_compatible_by_value(*param_ty), "Type of parameter #{i} requires a thunk");
+        ensure!(
+            is_c_abi_compatible_by_value(tcx, *param_ty),
+            "Type of parameter #{i} requires a thunk"
+        );
     }
 
     Ok(())
@@ -1193,6 +1366,86 @@ fn create_type_alias<'tcx>(
     })
 }
 
+/// Formats the body of a C++ function that mirrors the Rust function
+/// `local_def_id`, if the Rust function is trivial enough: this lets C++
+/// compilers inline it (rather than calling an opaque Rust thunk).  Returns
+/// `None` if the C++ function needs to call into Rust.
+///
+/// Only functions that are obviously free of side effects (and can't panic)
+/// are mirrored:
+/// - Field accessors like `fn get_f32(&self) -> f32 { self.f32_field }`
+///   (`self_ty` should be `None` unless the function takes `self` by
+///   reference).
+/// - Functions that return a literal, like `fn answer() -> i32 { 42 }`.
+///
+/// The return type has to be a primitive type (e.g. `f32` or `bool`), so that
+/// returning the value by copy is equivalent in Rust and in C++.
+fn format_trivial_fn_body_for_cc<'tcx>(
+    tcx: TyCtxt<'tcx>,
+    local_def_id: LocalDefId,
+    sig: &ty::FnSig<'tcx>,
+    self_ty: Option<Ty<'tcx>>,
+) -> Option<TokenStream> {
+    let ret_ty = sig.output();
+    if !ret_ty.is_primitive() || !is_c_abi_compatible_by_value(tcx, ret_ty) {
+        return None;
+    }
+
+    let body = tcx.hir().body(tcx.hir_node_by_def_id(local_def_id).body_id()?);
+    let ExprKind::Block(block, None) = body.value.kind else {
+        return None;
+    };
+    if !block.stmts.is_empty() || block.rules != BlockCheckMode::DefaultBlock {
+        return None;
+    }
+    let expr = block.expr?;
+    match (&expr.kind, body.params) {
+        (ExprKind::Lit(lit), []) => match lit.node {
+            LitKind::Bool(value) => Some(quote! { return #value; }),
+            LitKind::Int(value, _) if ret_ty.is_integral() => {
+                // Larger values would need a suffix to avoid compiler warnings in C++.
+                let value = Literal::i64_unsuffixed(i64::try_from(value.get()).ok()?);
+                Some(quote! { return #value; })
+            }
+            _ => None,
+        },
+        (ExprKind::Field(base, field_name), [self_param]) => {
+            let self_ty = self_ty?;
+            let ty::TyKind::Adt(adt_def, _) = self_ty.kind() else {
+                return None;
+            };
+            if !adt_def.is_struct() {
+                return None;
+            }
+            let ExprKind::Path(QPath::Resolved(None, path)) = base.kind else {
+                return None;
+            };
+            if path.res != Res::Local(self_param.pat.hir_id) {
+                return None;
+            }
+            // Auto-deref could also find the field in a `Deref::Target` of `self_ty` (e.g. if the
+            // field of `self_ty` is not visible in the method).
+            let typeck_results = tcx.typeck(local_def_id);
+            if typeck_results.expr_ty_adjusted(base) != self_ty {
+                return None;
+            }
+            let field_def =
+                &adt_def.non_enum_variant().fields[typeck_results.field_index(expr.hir_id)];
+            if field_def.ty(tcx, ty::List::empty()) != ret_ty {
+                return None;
+            }
+            // `format_fields` names the fields based on their source order.
+            let (index, _) = adt_def
+                .all_fields()
+                .sorted_by_key(|field_def| tcx.def_span(field_def.did))
+                .find_position(|other_field_def| other_field_def.did == field_def.did)?;
+            let cc_name = format_field_cc_name(field_name.as_str(), index);
+            Some(quote! { return this-> #cc_name; })
+        }
+        _ => None,
+    }
+}
+
 /// Formats a function with the given `local_def_id`.
 ///
 /// Will panic if `local_def_id`
@@ -1210,7 +1463,7 @@ fn format_fn(db: &dyn BindingsGenerator<'_>, local_def_id: LocalDefId) -> Result
     let sig = get_fn_sig(tcx, local_def_id);
     check_fn_sig(&sig)?;
     // TODO(b/262904507): Don't require thunks for mangled extern "C" functions.
-    let needs_thunk = is_thunk_required(&sig).is_err()
+    let needs_thunk = is_thunk_required(tcx, &sig).is_err()
         || (tcx.get_attr(def_id, rustc_span::symbol::sym::no_mangle).is_none()
             && tcx.get_attr(def_id, rustc_span::symbol::sym::export_name).is_none());
     let thunk_name = {
@@ -1376,6 +1629,14 @@ fn format_fn(db: &dyn BindingsGenerator<'_>, local_def_id: LocalDefId) -> Result
             },
         }
     };
+    // Trivial functions are mirrored in C++, so that C++ compilers can inline them - in this case
+    // neither the C++ thunk declaration nor the Rust thunk implementation are needed.
+    let trivial_fn_body = if needs_thunk {
+        let self_ty = self_ty.filter(|_| method_kind == FunctionKind::MethodTakingSelfByRef);
+        format_trivial_fn_body_for_cc(tcx, local_def_id, &sig, self_ty)
+    } else {
+        None
+    };
     let cc_details = if !needs_definition {
         CcSnippet::default()
     } else {
@@ -1391,6 +1652,23 @@ fn format_fn(db: &dyn BindingsGenerator<'_>, local_def_id: LocalDefId) -> Result
         };
 
         let mut prereqs = main_api_prereqs;
+        if let Some(impl_body) = trivial_fn_body.as_ref() {
+            return Ok(ApiSnippets {
+                main_api,
+                cc_details: CcSnippet {
+                    prereqs,
+                    tokens: quote! {
+                        __NEWLINE__
+                        inline #main_api_ret_type #struct_name #main_api_fn_name (
+                                #( #main_api_params ),* ) #method_qualifiers {
+                            #impl_body
+                        }
+                        __NEWLINE__
+                    },
+                },
+                rs_details: quote! {},
+            });
+        }
         let thunk_decl =
             format_thunk_decl(db, def_id, &sig, &thunk_name)?.into_tokens(&mut prereqs);
 
@@ -1398,21 +1676,27 @@ fn format_fn(db: &dyn BindingsGenerator<'_>, local_def_id: LocalDefId) -> Result
             .iter()
             .enumerate()
             .map(|(i, Param { cc_name, ty, .. })| {
-                if i == 0 && method_kind.has_self_param() {
-                    if method_kind == FunctionKind::MethodTakingSelfByValue {
+                let is_self = i == 0 && method_kind.has_self_param();
+                let value = if is_self { quote! { *this } } else { quote! { #cc_name } };
+                if !is_c_abi_compatible_by_value(tcx, *ty) {
+                    if is_self {
+                        // `self` taken by value, through a pointer to the object.
                         quote! { this }
                     } else {
-                        quote! { *this }
+                        quote! { & #cc_name }
                     }
-                } else if is_c_abi_compatible_by_value(*ty) {
-                    quote! { #cc_name }
+                } else if ty.is_adt() && !ty.is_copy_modulo_regions(tcx, tcx.param_env(def_id)) {
+                    // Structs that can't be copied are moved instead, which is a `memcpy`, as
+                    // only those that don't need drop are passed by value.
+                    prereqs.includes.insert(CcInclude::utility()); // for `std::move`
+                    quote! { std::move(#value) }
                 } else {
-                    quote! { & #cc_name }
+                    value
                 }
             })
             .collect_vec();
         let impl_body: TokenStream;
-        if is_c_abi_compatible_by_value(sig.output()) {
+        if is_c_abi_compatible_by_value(tcx, sig.output()) {
             impl_body = quote! {
                 return __crubit_internal :: #thunk_name( #( #thunk_args ),* );
             };
@@ -1634,6 +1918,12 @@ fn repr_attrs(db: &dyn BindingsGenerator<'_>, def_id: DefId) -> Rc<[rustc_attr::
     attrs.into()
 }
 
+/// Formats the name of the C++ data member that represents the field `name`,
+/// where `index` is the position of the field in the source order.
+fn format_field_cc_name(name: &str, index: usize) -> TokenStream {
+    format_cc_ident(name).unwrap_or_else(|_err| format_ident!("__field{index}").into_token_stream())
+}
+
 fn format_fields<'tcx>(
     db: &dyn BindingsGenerator<'tcx>,
     core: &AdtCoreBindings<'tcx>,
@@ -1700,8 +1990,7 @@ fn format_fields<'tcx>(
                     })
                 });
                 let name = field_def.ident(tcx);
-                let cc_name = format_cc_ident(name.as_str())
-                    .unwrap_or_else(|_err| format_ident!("__field{index}").into_token_stream());
+                let cc_name = format_field_cc_name(name.as_str(), index);
                 let rs_name = {
                     let name_starts_with_digit = name
                         .as_str()
@@ -2159,10 +2448,14 @@ fn format_copy_ctor_and_assignment_operator<'tcx>(
                 #cc_struct_name(const #cc_struct_name&) = default;  __NEWLINE__
                 #cc_struct_name& operator=(const #cc_struct_name&) = default;
             });
+            // Together with the trivial move operations and destructor of types that don't need
+            // drop (as `Copy` types never do), this makes the bindings trivially copyable, so that
+            // e.g. `std::vector` and `std::copy` copy them with `memcpy`.
             let cc_details = CcSnippet::with_include(
                 quote! {
                     static_assert(std::is_trivially_copy_constructible_v<#cc_struct_name>);
                     static_assert(std::is_trivially_copy_assignable_v<#cc_struct_name>);
+                    static_assert(std::is_trivially_copyable_v<#cc_struct_name>);
                 },
                 CcInclude::type_traits(),
             );
@@ -2336,6 +2629,138 @@ fn format_move_ctor_and_assignment_operator<'tcx>(
     })
 }
 
+/// Formats `begin` and `end` methods for an ADT that implements the `Iterator`
+/// trait, so that C++ range-based `for` loops can iterate over its items.  The
+/// items are pulled from Rust in batches (see `crubit::BatchedIterator`), so
+/// that there is one Rust thunk call per batch, rather than per item.
+///
+/// Returns an empty `ApiSnippets` if the ADT doesn't implement `Iterator`, and
+/// an error if the `Iterator` impl can't be supported.
+fn format_iterator_methods<'tcx>(
+    db: &dyn BindingsGenerator<'tcx>,
+    core: &AdtCoreBindings<'tcx>,
+) -> Result<ApiSnippets> {
+    let tcx = db.tcx();
+    let Some(trait_id) = tcx.get_diagnostic_item(sym::Iterator) else {
+        return Ok(ApiSnippets::default());
+    };
+    let self_ty = core.self_ty;
+    if !does_type_implement_trait(tcx, self_ty, trait_id) {
+        return Ok(ApiSnippets::default());
+    }
+
+    let param_env = tcx.param_env(core.def_id);
+    let item_ty = {
+        let item_def_id = tcx
+            .associated_items(trait_id)
+            .in_definition_order()
+            .find(|item| item.kind == ty::AssocKind::Type && item.name == sym::Item)
+            .expect("`Iterator` should have an `Item` associated type")
+            .def_id;
+        let item_ty = Ty::new_projection(tcx, item_def_id, [self_ty]);
+        tcx.normalize_erasing_regions(param_env, item_ty)
+    };
+    // The Rust thunk moves the items into a C++ buffer (which never runs their destructors).
+    ensure!(
+        !item_ty.needs_drop(tcx, param_env),
+        "Iterating over items of type `{item_ty}` is not supported, because they need to be dropped"
+    );
+    let mut prereqs = CcPrerequisites::default();
+    let item_cc_ty = db
+        .format_ty_for_cc(item_ty, TypeLocation::Other)
+        .with_context(|| format!("Error formatting the `Iterator::Item` type `{item_ty}`"))?
+        .into_tokens(&mut prereqs);
+    let item_rs_ty = format_ty_for_rs(tcx, item_ty)?;
+
+    // Methods with the same names would conflict with `begin` and `end` below.
+    let has_conflicting_method = tcx
+        .inherent_impls(core.def_id)
+        .into_iter()
+        .flatten()
+        .flat_map(|impl_id| tcx.associated_items(impl_id).in_definition_order())
+        .any(|item| matches!(item.name.as_str(), "begin" | "end"));
+    ensure!(
+        !has_conflicting_method,
+        "Can't generate `begin` and `end` methods for `Iterator` (because of methods with \
+         the same name)"
+    );
+
+    let thunk_name = {
+        let next_def_id = tcx
+            .associated_items(trait_id)
+            .in_definition_order()
+            .find(|item| item.kind == ty::AssocKind::Fn && item.name == sym::next)
+            .expect("`Iterator` should have a `next` method")
+            .def_id;
+        let args = tcx.mk_args_trait(self_ty, std::iter::empty());
+        let instance = ty::Instance::new(next_def_id, args);
+        let symbol = tcx.symbol_name(instance);
+        format!("__crubit_thunk_{}_batch", &escape_non_identifier_chars(symbol.name))
+    };
+    let cc_thunk_name = format_cc_ident(&thunk_name)?;
+    let rs_thunk_name = make_rs_ident(&thunk_name);
+
+    prereqs.includes.insert(db.support_header("internal/batched_iterator.h"));
+    prereqs.includes.insert(CcInclude::cstddef());
+    let main_api = {
+        let mut prereqs = prereqs.clone();
+        prereqs.move_defs_to_fwd_decls();
+        CcSnippet {
+            prereqs,
+            tokens: quote! {
+                __NEWLINE__ __COMMENT__ "Iterator::next (via range-based `for` loops)"
+                crubit::BatchedIterator<#item_cc_ty> begin(); __NEWLINE__
+                crubit::BatchedIteratorEnd end(); __NEWLINE__ __NEWLINE__
+            },
+        }
+    };
+    let cc_details = {
+        let adt_cc_name = &core.cc_short_name;
+        CcSnippet {
+            prereqs,
+            tokens: quote! {
+                namespace __crubit_internal {
+                    extern "C" std::size_t #cc_thunk_name(
+                        void* __self, #item_cc_ty* __buffer, std::size_t __capacity);
+                }
+                inline crubit::BatchedIterator<#item_cc_ty> #adt_cc_name::begin() {
+                    return crubit::BatchedIterator<#item_cc_ty>(
+                        this, &__crubit_internal::#cc_thunk_name);
+                }
+                inline crubit::BatchedIteratorEnd #adt_cc_name::end() {
+                    return {};
+                }
+            },
+        }
+    };
+    let rs_details = {
+        let adt_rs_name = &core.rs_fully_qualified_name;
+        quote! {
+            #[no_mangle]
+            extern "C" fn #rs_thunk_name(
+                __self: &mut #adt_rs_name,
+                __buffer: *mut ::core::mem::MaybeUninit<#item_rs_ty>,
+                __capacity: usize,
+            ) -> usize {
+                let mut __len = 0;
+                while __len < __capacity {
+                    match <#adt_rs_name as ::core::iter::Iterator>::next(__self) {
+                        None => break,
+                        Some(__item) => {
+                            // SAFETY: The C++ caller provides a buffer with room for
+                            // `__capacity` items.
+                            unsafe { (*__buffer.add(__len)).write(__item) };
+                            __len += 1;
+                        }
+                    }
+                }
+                __len
+            }
+        }
+    };
+    Ok(ApiSnippets { main_api, cc_details, rs_details })
+}
+
 /// Formats an algebraic data type (an ADT - a struct, an enum, or a union)
 /// represented by `core`.  This function is infallible - after
 /// `format_adt_core` returns success we have committed to emitting C++ bindings
@@ -2400,6 +2825,14 @@ fn format_adt<'tcx>(
     let move_ctor_and_assignment_snippets =
         db.format_move_ctor_and_assignment_operator(core.clone()).unwrap_or_else(|err| err);
 
+    let iterator_snippets = format_iterator_methods(db, &core).unwrap_or_else(|err| {
+        let msg = format!("{err:#}");
+        ApiSnippets {
+            main_api: CcSnippet::new(quote! { __NEWLINE__ __COMMENT__ #msg }),
+            ..Default::default()
+        }
+    });
+
     let impl_items_snippets = tcx
         .inherent_impls(core.def_id)
         .into_iter()
@@ -2435,6 +2868,7 @@ fn format_adt<'tcx>(
         destructor_snippets,
         move_ctor_and_assignment_snippets,
         copy_ctor_and_assignment_snippets,
+        iterator_snippets,
         impl_items_snippets,
     ]
     .into_iter()
@@ -2719,23 +3153,52 @@ pub fn format_namespace_bound_cc_tokens(
     iter.collect()
 }
 
+/// Measures the code generated for the item `def_id`, for the bloat report.
+/// The thunks are the `extern "C"` functions that `rs_details` defines.
+fn measure_item(tcx: TyCtxt, def_id: LocalDefId, api_snippets: &ApiSnippets) -> ItemBloat {
+    let rs = TokenCounts::of(&api_snippets.rs_details);
+    let mut cc = TokenCounts::of(&api_snippets.main_api.tokens);
+    cc += TokenCounts::of(&api_snippets.cc_details.tokens);
+    ItemBloat::new(
+        tcx.def_path_str(def_id),
+        Some(format_source_location(tcx, def_id)),
+        rs,
+        cc,
+        rs.extern_c,
+    )
+}
+
 /// Formats all public items from the Rust crate being compiled.
 fn format_crate(db: &Database) -> Result<Output> {
     let tcx = db.tcx();
-    let mut cc_details_prereqs = CcPrerequisites::default();
-    let mut cc_details: Vec<(LocalDefId, TokenStream)> = vec![];
+    let mut cc_details: Vec<(LocalDefId, CcSnippet)> = vec![];
     let mut rs_body = TokenStream::default();
     let mut main_apis = HashMap::<LocalDefId, CcSnippet>::new();
-    let formatted_items = tcx
-        .hir()
-        .items()
-        .filter_map(|item_id| {
-            let def_id: LocalDefId = item_id.owner_id.def_id;
-            db.format_item(def_id)
-                .unwrap_or_else(|err| Some(format_unsupported_def(db, def_id, err)))
-                .map(|api_snippets| (def_id, api_snippets))
-        })
-        .sorted_by_key(|(def_id, _)| tcx.def_span(*def_id));
+
+    // The items are formatted one after another, on the current thread: `TyCtxt`
+    // can only be shared across threads when `rustc` itself runs its queries in
+    // parallel (`-Zthreads`), and `Database` memoizes into `Rc`s.  Instead, each
+    // item is formatted only once, and its position in the source order is
+    // computed once (rather than calling `def_span` from every comparison of the
+    // sorts below).  Using the position rather than the span also makes the
+    // order deterministic when two items have the same span (e.g. when they are
+    // generated by the same macro invocation).
+    let mut item_ids = tcx.hir().items().map(|item_id| item_id.owner_id.def_id).collect_vec();
+    item_ids.sort_by_cached_key(|def_id| tcx.def_span(*def_id));
+    let source_order: HashMap<LocalDefId, usize> =
+        item_ids.iter().enumerate().map(|(index, def_id)| (*def_id, index)).collect();
+    let profiler = db.profiler();
+    let bloat_report = db.bloat_report();
+    let formatted_items = item_ids.into_iter().filter_map(|def_id| {
+        let _span = profiler.span(profiler::ITEM, || tcx.def_path_str(def_id));
+        let api_snippets = db
+            .format_item(def_id)
+            .unwrap_or_else(|err| Some(format_unsupported_def(db, def_id, err)))?;
+        if let Some(bloat_report) = &bloat_report {
+            bloat_report.borrow_mut().add(measure_item(tcx, def_id, &api_snippets));
+        }
+        Some((def_id, api_snippets))
+    });
     for (def_id, api_snippets) in formatted_items {
         let old_item = main_apis.insert(def_id, api_snippets.main_api);
         assert!(old_item.is_none(), "Duplicated key: {def_id:?}");
@@ -2744,7 +3207,7 @@ fn format_crate(db: &Database) -> Result<Output> {
         // `CcPrerequisites::defs` always use `main_api` as the predecessor
         // - `chain`ing `cc_details` after `ordered_main_apis` trivially
         // meets the prerequisites.
-        cc_details.push((def_id, api_snippets.cc_details.into_tokens(&mut cc_details_prereqs)));
+        cc_details.push((def_id, api_snippets.cc_details));
         rs_body.extend(api_snippets.rs_details);
     }
 
@@ -2752,14 +3215,15 @@ fn format_crate(db: &Database) -> Result<Output> {
     // `CcPrerequisites::defs` and 2) makes a best effort attempt to keep the
     // `main_apis` in the same order as the source order of the Rust APIs.
     let ordered_ids = {
+        let _span = profiler.span(profiler::PHASE, || "toposort".to_string());
         let toposort::TopoSortResult { ordered: ordered_ids, failed: failed_ids } = {
             let nodes = main_apis.keys().copied();
             let deps = main_apis.iter().flat_map(|(&successor, main_api)| {
                 let predecessors = main_api.prereqs.defs.iter().copied();
                 predecessors.map(move |predecessor| toposort::Dependency { predecessor, successor })
             });
-            toposort::toposort(nodes, deps, move |lhs_id, rhs_id| {
-                tcx.def_span(*lhs_id).cmp(&tcx.def_span(*rhs_id))
+            toposort::toposort(nodes, deps, |lhs_id, rhs_id| {
+                source_order[lhs_id].cmp(&source_order[rhs_id])
             })
         };
         assert_eq!(
@@ -2771,23 +3235,168 @@ fn format_crate(db: &Database) -> Result<Output> {
         );
         ordered_ids
     };
+    let ordered_main_apis = ordered_ids
+        .into_iter()
+        .map(|def_id| (def_id, main_apis.remove(&def_id).unwrap()))
+        .collect_vec();
 
-    // Destructure/rebuild `main_apis` (in the same order as `ordered_ids`) into
+    let split = db.module_header_prefix().and_then(|prefix| {
+        let module_deps = module_header_deps(tcx, &ordered_main_apis, &cc_details)?;
+        Some((prefix, module_deps))
+    });
+    let Some((prefix, module_deps)) = split else {
+        let h_body = format_cc_header_body(db, ordered_main_apis, cc_details, BTreeSet::new())?;
+        return Ok(Output { h_body, rs_body, module_h_bodies: vec![] });
+    };
+
+    // Partition the items by their top-level module (preserving the toposort order
+    // within each module), and format a separate header for each module.  The
+    // main header `#include`s all of them, followed by the items in the crate
+    // root.
+    let module_header_name = |module: &str| -> Rc<str> { format!("{prefix}.{module}.h").into() };
+    let mut main_apis_by_module = HashMap::<Option<Rc<str>>, Vec<(LocalDefId, CcSnippet)>>::new();
+    for (def_id, main_api) in ordered_main_apis {
+        main_apis_by_module
+            .entry(top_level_module(tcx, def_id))
+            .or_default()
+            .push((def_id, main_api));
+    }
+    let mut cc_details_by_module = HashMap::<Option<Rc<str>>, Vec<(LocalDefId, CcSnippet)>>::new();
+    for (def_id, cc_details) in cc_details {
+        cc_details_by_module
+            .entry(top_level_module(tcx, def_id))
+            .or_default()
+            .push((def_id, cc_details));
+    }
+    let mut module_h_bodies = vec![];
+    let mut all_module_includes = BTreeSet::new();
+    for (module, deps) in module_deps.into_iter().sorted() {
+        let Some(module) = module else {
+            continue; // The crate root is formatted into the main header below.
+        };
+        let includes =
+            deps.iter().map(|dep| CcInclude::user_header(module_header_name(dep))).collect();
+        let h_body = format_cc_header_body(
+            db,
+            main_apis_by_module.remove(&Some(module.clone())).unwrap_or_default(),
+            cc_details_by_module.remove(&Some(module.clone())).unwrap_or_default(),
+            includes,
+        )?;
+        all_module_includes.insert(CcInclude::user_header(module_header_name(&module)));
+        module_h_bodies.push((module_header_name(&module), h_body));
+    }
+    let h_body = format_cc_header_body(
+        db,
+        main_apis_by_module.remove(&None).unwrap_or_default(),
+        cc_details_by_module.remove(&None).unwrap_or_default(),
+        all_module_includes,
+    )?;
+    Ok(Output { h_body, rs_body, module_h_bodies })
+}
+
+/// Returns the name of the top-level module that contains `def_id`, or `None`
+/// for items directly in the crate root.
+fn top_level_module(tcx: TyCtxt, def_id: LocalDefId) -> Option<Rc<str>> {
+    FullyQualifiedName::new(tcx, def_id.to_def_id()).mod_path.0.first().cloned()
+}
+
+/// Computes which top-level modules the bindings of each top-level module
+/// depend on, when the bindings are split into one header per module (see
+/// `BindingsGenerator::module_header_prefix`).  The crate root (`None`) is
+/// included in the result as well.
+///
+/// Returns `None` if the bindings can't be split: when module headers would
+/// need to include each other, or when a module header would need to include
+/// the main header (which includes all the module headers).
+fn module_header_deps(
+    tcx: TyCtxt,
+    main_apis: &[(LocalDefId, CcSnippet)],
+    cc_details: &[(LocalDefId, CcSnippet)],
+) -> Option<HashMap<Option<Rc<str>>, BTreeSet<Rc<str>>>> {
+    // A `main_api` only needs the definitions from other modules - forward
+    // declarations are repeated in each header that needs them.  `cc_details` are
+    // formatted after all the `main_api`s of the crate (see `format_crate`), so
+    // they can also depend on `main_api`s that only have a forward declaration.
+    let main_api_prereqs = main_apis
+        .iter()
+        .map(|(def_id, main_api)| (*def_id, main_api.prereqs.defs.iter().collect_vec()));
+    let cc_details_prereqs = cc_details.iter().map(|(def_id, cc_details)| {
+        let CcPrerequisites { defs, fwd_decls, .. } = &cc_details.prereqs;
+        (*def_id, defs.iter().chain(fwd_decls.iter()).collect_vec())
+    });
+
+    let mut deps = HashMap::<Option<Rc<str>>, BTreeSet<Rc<str>>>::new();
+    for (def_id, prereq_ids) in main_api_prereqs.chain(cc_details_prereqs) {
+        let module = top_level_module(tcx, def_id);
+        let module_deps = deps.entry(module.clone()).or_default();
+        for prereq_id in prereq_ids {
+            match top_level_module(tcx, *prereq_id) {
+                // Items within a module header are in toposort order.
+                prereq_module if prereq_module == module => (),
+                None => return None,
+                Some(prereq_module) => {
+                    module_deps.insert(prereq_module);
+                }
+            }
+        }
+    }
+
+    let modules: BTreeSet<Rc<str>> = deps
+        .iter()
+        .flat_map(|(module, module_deps)| module.iter().chain(module_deps.iter()))
+        .cloned()
+        .collect();
+    let module_deps =
+        deps.iter().filter_map(|(module, module_deps)| Some((module.as_ref()?, module_deps)));
+    let dependencies = module_deps.flat_map(|(successor, module_deps)| {
+        module_deps.iter().map(move |predecessor| toposort::Dependency {
+            predecessor: predecessor.clone(),
+            successor: successor.clone(),
+        })
+    });
+    let toposort::TopoSortResult { failed, .. } =
+        toposort::toposort(modules, dependencies, |lhs, rhs| lhs.cmp(rhs));
+    if !failed.is_empty() {
+        return None;
+    }
+
+    Some(deps)
+}
+
+/// Formats the body of a C++ header with the bindings for `main_apis` (which
+/// should already be in toposort order) and `cc_details`: the `#include`s
+/// they need (in addition to `includes`), the forward declarations they need,
+/// and then the bindings themselves.
+fn format_cc_header_body(
+    db: &Database,
+    main_apis: Vec<(LocalDefId, CcSnippet)>,
+    cc_details: Vec<(LocalDefId, CcSnippet)>,
+    mut includes: BTreeSet<CcInclude>,
+) -> Result<TokenStream> {
+    let tcx = db.tcx();
+    let _span = db.profiler().span(profiler::PHASE, || "format_cc_header_body".to_string());
+    let mut cc_details_prereqs = CcPrerequisites::default();
+    let cc_details = cc_details
+        .into_iter()
+        .map(|(def_id, cc_details)| (def_id, cc_details.into_tokens(&mut cc_details_prereqs)))
+        .collect_vec();
+    includes.append(&mut cc_details_prereqs.includes);
+
+    // Destructure/rebuild `main_apis` (in the same order as they are given) into
     // `includes`, and `ordered_cc` (mixing in `fwd_decls` and `cc_details`).
-    let (includes, ordered_cc) = {
+    let ordered_cc = {
         let mut already_declared = HashSet::new();
         let mut fwd_decls = HashSet::new();
-        let mut includes = cc_details_prereqs.includes;
         let mut ordered_main_apis: Vec<(LocalDefId, TokenStream)> = Vec::new();
-        for def_id in ordered_ids.into_iter() {
+        for (def_id, main_api) in main_apis.into_iter() {
             let CcSnippet {
                 tokens: cc_tokens,
                 prereqs: CcPrerequisites {
                     includes: mut inner_includes,
                     fwd_decls: inner_fwd_decls,
-                    .. // `defs` have already been utilized by `toposort` above
+                    .. // `defs` have already been utilized by `toposort` in `format_crate`
                 }
-            } = main_apis.remove(&def_id).unwrap();
+            } = main_api;
 
             fwd_decls.extend(inner_fwd_decls.difference(&already_declared).copied());
             already_declared.insert(def_id);
@@ -2814,31 +3423,27 @@ fn format_crate(db: &Database) -> Result<Output> {
             })
             .collect_vec();
 
-        (includes, ordered_cc)
+        ordered_cc
     };
 
     // Generate top-level elements of the C++ header file.
-    let h_body = {
-        // TODO(b/254690602): Decide whether using `#crate_name` as the name of the
-        // top-level namespace is okay (e.g. investigate if this name is globally
-        // unique + ergonomic).
-        let crate_name = format_cc_ident(tcx.crate_name(LOCAL_CRATE).as_str())?;
-
-        let includes = format_cc_includes(&includes);
-        let ordered_cc = format_namespace_bound_cc_tokens(ordered_cc, tcx);
-        quote! {
-            #includes
-            __NEWLINE__ __NEWLINE__
-            namespace #crate_name {
-                __NEWLINE__
-                #ordered_cc
-                __NEWLINE__
-            }
+    // TODO(b/254690602): Decide whether using `#crate_name` as the name of the
+    // top-level namespace is okay (e.g. investigate if this name is globally
+    // unique + ergonomic).
+    let crate_name = format_cc_ident(tcx.crate_name(LOCAL_CRATE).as_str())?;
+
+    let includes = format_cc_includes(&includes);
+    let ordered_cc = format_namespace_bound_cc_tokens(ordered_cc, tcx);
+    Ok(quote! {
+        #includes
+        __NEWLINE__ __NEWLINE__
+        namespace #crate_name {
+            __NEWLINE__
+            #ordered_cc
             __NEWLINE__
         }
-    };
-
-    Ok(Output { h_body, rs_body })
+        __NEWLINE__
+    })
 }
 
 #[cfg(test)]
@@ -2881,6 +3486,46 @@ pub mod tests {
         });
     }
 
+    #[test]
+    fn test_generated_bindings_bloat_report() {
+        let test_src = r#"
+                #[no_mangle]
+                pub extern "C" fn public_function() {}
+
+                pub fn thunked_function(x: i32) -> i32 { x }
+            "#;
+        run_compiler_for_testing(test_src, |tcx| {
+            let bloat_report = Rc::new(RefCell::new(BloatReport::new("rust_out")));
+            let db = Database::new(
+                tcx,
+                /* crubit_support_path_format= */
+                "<crubit/support/for/tests/{header}>".into(),
+                /* crate_name_to_include_paths= */ Default::default(),
+                /* errors = */ Rc::new(IgnoreErrors),
+                /* profiler= */ Rc::new(Profiler::disabled()),
+                /* bloat_report= */ Some(bloat_report.clone()),
+                /* module_header_prefix= */ None,
+                /* _features= */ (),
+            );
+            generate_bindings(&db).unwrap();
+            let bloat_report = bloat_report.borrow();
+            let item = |name: &str| {
+                bloat_report.items.iter().find(|item| item.name.ends_with(name)).unwrap()
+            };
+
+            // Called directly from C++.
+            let public_function = item("public_function");
+            assert_eq!(public_function.thunks, 0);
+            assert_eq!(public_function.rs_tokens, 0);
+            assert!(public_function.cc_tokens > 0);
+
+            let thunked_function = item("thunked_function");
+            assert_eq!(thunked_function.thunks, 1);
+            assert_eq!(thunked_function.estimated_symbols, 1);
+            assert!(thunked_function.rs_tokens > 0);
+        });
+    }
+
     /// `test_generated_bindings_fn_export_name` covers a scenario where
     /// `MixedSnippet::cc` is present but `MixedSnippet::rs` is empty
     /// (because no Rust thunks are needed).
@@ -3000,20 +3645,14 @@ pub mod tests {
                         };
                         ...
                         std::int32_t SomeStruct::public_static_method() {
-                            ...
+                            return 123;
                         }
                         ...
                     }  // namespace rust_out
                 }
             );
-            assert_rs_matches!(
-                bindings.rs_body,
-                quote! {
-                    extern "C" fn ...() -> i32 {
-                        ::rust_out::SomeStruct::public_static_method()
-                    }
-                }
-            );
+            // `public_static_method` is trivial enough to be mirrored in C++.
+            assert_rs_not_matches!(bindings.rs_body, quote! { public_static_method });
         });
     }
 
@@ -3045,6 +3684,134 @@ pub mod tests {
         });
     }
 
+    /// Tests that `module_header_prefix` splits the bindings into one header
+    /// per top-level module, and that each header `#include`s the headers of
+    /// the modules whose definitions it needs.
+    #[test]
+    fn test_generated_bindings_split_by_module() {
+        let test_src = r#"
+                #![allow(dead_code)]
+
+                pub mod inner {
+                    pub struct Inner(pub bool);
+                }
+                pub mod outer {
+                    pub struct Outer(pub crate::inner::Inner);
+                }
+                pub fn f(_: outer::Outer) {}
+            "#;
+        test_generated_bindings_split_by_module(test_src, |bindings| {
+            let bindings = bindings.unwrap();
+            let module_h_bodies: HashMap<Rc<str>, TokenStream> =
+                bindings.module_h_bodies.into_iter().collect();
+            assert_eq!(2, module_h_bodies.len());
+
+            let inner_h_body = &module_h_bodies["test_cc_api.inner.h"];
+            assert_cc_matches!(
+                inner_h_body.clone(),
+                quote! {
+                    namespace rust_out {
+                        namespace inner {
+                            ...
+                            struct CRUBIT_INTERNAL_RUST_TYPE(...) alignas(1) [[clang::trivial_abi]] Inner final { ... }
+                            ...
+                        }
+                    }
+                }
+            );
+            assert_cc_not_matches!(inner_h_body.clone(), quote! { Outer });
+
+            assert_cc_matches!(
+                module_h_bodies["test_cc_api.outer.h"].clone(),
+                quote! {
+                    __HASH_TOKEN__ include "test_cc_api.inner.h" ...
+                    namespace rust_out {
+                        namespace outer {
+                            ...
+                            struct CRUBIT_INTERNAL_RUST_TYPE(...) alignas(1) [[clang::trivial_abi]] Outer final {
+                              ... union { ... ::rust_out::inner::Inner __field0; }; ...
+                            };
+                            ...
+                        }
+                    }
+                }
+            );
+
+            assert_cc_matches!(
+                bindings.h_body.clone(),
+                quote! {
+                    __HASH_TOKEN__ include "test_cc_api.inner.h"
+                    __HASH_TOKEN__ include "test_cc_api.outer.h" ...
+                    namespace rust_out {
+                        ...
+                        void f(::rust_out::outer::Outer __param_0);
+                        ...
+                    }
+                }
+            );
+            assert_cc_not_matches!(bindings.h_body, quote! { Inner final });
+        });
+    }
+
+    /// Tests that the bindings are not split into per-module headers when a
+    /// module header would need to include the main header (i.e. when an item
+    /// in a module depends on the definition of an item in the crate root).
+    #[test]
+    fn test_generated_bindings_split_by_module_depends_on_crate_root() {
+        let test_src = r#"
+                #![allow(dead_code)]
+
+                pub struct Root(pub bool);
+                pub mod m {
+                    pub struct S(pub crate::Root);
+                }
+            "#;
+        test_generated_bindings_split_by_module(test_src, |bindings| {
+            let bindings = bindings.unwrap();
+            assert!(bindings.module_h_bodies.is_empty());
+            assert_cc_matches!(
+                bindings.h_body,
+                quote! {
+                    namespace rust_out {
+                        ...
+                        struct CRUBIT_INTERNAL_RUST_TYPE(...) alignas(1) [[clang::trivial_abi]] Root final { ... }
+                        ...
+                        namespace m {
+                            ...
+                            struct CRUBIT_INTERNAL_RUST_TYPE(...) alignas(1) [[clang::trivial_abi]] S final { ... }
+                            ...
+                        }
+                        ...
+                    }
+                }
+            );
+        });
+    }
+
+    /// Tests that the bindings are not split into per-module headers when the
+    /// module headers would need to include each other.
+    #[test]
+    fn test_generated_bindings_split_by_module_cyclic_modules() {
+        let test_src = r#"
+                #![allow(dead_code)]
+
+                pub mod a {
+                    pub struct A1(pub bool);
+                    pub struct A2(pub crate::b::B1);
+                }
+                pub mod b {
+                    pub struct B1(pub bool);
+                    pub struct B2(pub crate::a::A1);
+                }
+            "#;
+        test_generated_bindings_split_by_module(test_src, |bindings| {
+            let bindings = bindings.unwrap();
+            assert!(bindings.module_h_bodies.is_empty());
+            assert_cc_matches!(bindings.h_body.clone(), quote! { A2 final });
+            assert_cc_matches!(bindings.h_body, quote! { B2 final });
+        });
+    }
+
     /// Tests that `toposort` is used to reorder item bindings.
     #[test]
     fn test_generated_bindings_prereq_defs_field_deps_require_reordering() {
@@ -3974,39 +4741,312 @@ pub mod tests {
         });
     }
 
-    /// This test verifies that `format_item` uses `CcPrerequisites::fwd_decls`
-    /// rather than `CcPrerequisites::defs` for function declarations in the
-    /// `main_api`.
+    /// This test verifies that `format_item` uses `CcPrerequisites::fwd_decls`
+    /// rather than `CcPrerequisites::defs` for function declarations in the
+    /// `main_api`.
+    #[test]
+    fn test_format_item_fn_cc_prerequisites_if_only_cpp_declaration_needed() {
+        let test_src = r#"
+                #[no_mangle]
+                pub extern "C" fn foo(s: S) -> bool { s.0 }
+
+                #[repr(C)]
+                pub struct S(bool);
+            "#;
+        test_format_item(test_src, "foo", |result| {
+            let result = result.unwrap().unwrap();
+            let main_api = &result.main_api;
+
+            // Minimal coverage, just to double-check that the test setup works.
+            //
+            // Note that this is only a function *declaration* (not a function definition -
+            // there is no function body), and therefore `S` just needs to be
+            // forward-declared earlier.
+            assert_cc_matches!(main_api.tokens, quote! { bool foo(::rust_out::S s); });
+
+            // Main checks: `CcPrerequisites::defs` and `CcPrerequisites::fwd_decls`.
+            //
+            // Verifying the actual def_id is tricky, because `test_format_item` doesn't
+            // expose `tcx` to the verification function (and therefore calling
+            // `find_def_id_by_name` is not easily possible).
+            assert_eq!(0, main_api.prereqs.defs.len());
+            assert_eq!(1, main_api.prereqs.fwd_decls.len());
+        });
+    }
+
+    /// Tests that `Copy`, `#[repr(C)]` structs are passed by value to `extern
+    /// "C"` functions, without a thunk.
+    #[test]
+    fn test_format_item_fn_extern_c_repr_c_struct_by_value() {
+        let test_src = r#"
+                #[repr(C)]
+                #[derive(Clone, Copy)]
+                pub struct Point {
+                    pub x: i32,
+                    pub y: f64,
+                }
+
+                #[no_mangle]
+                pub extern "C" fn scale(p: Point, factor: f64) -> Point {
+                    Point { x: p.x, y: p.y * factor }
+                }
+            "#;
+        test_format_item(test_src, "scale", |result| {
+            let result = result.unwrap().unwrap();
+            assert_cc_matches!(
+                result.main_api.tokens,
+                quote! {
+                    extern "C" ::rust_out::Point scale(::rust_out::Point p, double factor);
+                }
+            );
+            assert!(result.cc_details.tokens.is_empty());
+            assert!(result.rs_details.is_empty());
+        });
+    }
+
+    /// Tests that thunks take and return `Copy`, `#[repr(C)]` structs by value
+    /// (rather than through a pointer), including for `self`.
+    #[test]
+    fn test_format_item_fn_thunk_repr_c_struct_by_value() {
+        let test_src = r#"
+                #[repr(C)]
+                #[derive(Clone, Copy)]
+                pub struct Point {
+                    pub x: i32,
+                    pub y: i32,
+                }
+
+                impl Point {
+                    pub fn transposed(self) -> Point {
+                        Point { x: self.y, y: self.x }
+                    }
+                }
+            "#;
+        test_format_item(test_src, "Point", |result| {
+            let result = result.unwrap().unwrap();
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    ...
+                    namespace __crubit_internal {
+                    extern "C" ::rust_out::Point ...(::rust_out::Point);
+                    }
+                    inline ::rust_out::Point Point::transposed() && {
+                      return __crubit_internal::...(*this);
+                    }
+                    ...
+                },
+            );
+            assert_rs_matches!(
+                result.rs_details,
+                quote! {
+                    ...
+                    #[no_mangle]
+                    extern "C" fn ...(__self: ::rust_out::Point) -> ::rust_out::Point {
+                        ::rust_out::Point::transposed(__self)
+                    }
+                    ...
+                },
+            );
+        });
+    }
+
+    /// Tests that thunks also take and return `#[repr(C)]` structs that aren't
+    /// `Copy`, but don't need drop, by value, moving them.
+    #[test]
+    fn test_format_item_fn_thunk_non_copy_repr_c_struct_by_value() {
+        let test_src = r#"
+                #[repr(C)]
+                #[derive(Clone)]
+                pub struct Point {
+                    pub x: i32,
+                    pub y: i32,
+                }
+
+                impl Point {
+                    pub fn transposed(self) -> Point {
+                        Point { x: self.y, y: self.x }
+                    }
+                }
+
+                pub fn get_x(p: Point) -> i32 {
+                    p.x
+                }
+            "#;
+        test_format_item(test_src, "Point", |result| {
+            let result = result.unwrap().unwrap();
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    ...
+                    namespace __crubit_internal {
+                    extern "C" ::rust_out::Point ...(::rust_out::Point);
+                    }
+                    inline ::rust_out::Point Point::transposed() && {
+                      return __crubit_internal::...(std::move(*this));
+                    }
+                    ...
+                },
+            );
+        });
+        test_format_item(test_src, "get_x", |result| {
+            let result = result.unwrap().unwrap();
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    namespace __crubit_internal {
+                    extern "C" std::int32_t ...(::rust_out::Point);
+                    }
+                    inline std::int32_t get_x(::rust_out::Point p) {
+                      return __crubit_internal::...(std::move(p));
+                    }
+                },
+            );
+        });
+    }
+
+    /// Tests that `#[repr(C, packed)]` structs still go through a pointer, since
+    /// the C++ bindings can't replicate their ABI.
+    #[test]
+    fn test_format_item_fn_packed_struct_by_value_requires_thunk() {
+        let test_src = r#"
+                #[repr(C, packed)]
+                #[derive(Clone, Copy)]
+                pub struct Packed {
+                    pub x: u8,
+                    pub y: u32,
+                }
+
+                #[no_mangle]
+                pub extern "C" fn get_y(p: Packed) -> u32 {
+                    p.y
+                }
+            "#;
+        test_format_item(test_src, "get_y", |result| {
+            let result = result.unwrap().unwrap();
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    namespace __crubit_internal {
+                    extern "C" std::uint32_t ...(::rust_out::Packed*);
+                    }
+                    ...
+                },
+            );
+        });
+    }
+
+    /// Tests that slice references are passed to (and returned from) the thunk
+    /// via a pointer to a `rs_std::SliceRef`, without copying the elements.
+    #[test]
+    fn test_format_item_fn_slice_ref_param_and_return_type() {
+        let test_src = r#"
+                pub fn tail<'a>(x: &'a [i32]) -> &'a [i32] {
+                    &x[1..]
+                }
+            "#;
+        test_format_item(test_src, "tail", |result| {
+            let result = result.unwrap().unwrap();
+            let main_api = &result.main_api;
+            assert_cc_matches!(
+                main_api.tokens,
+                quote! {
+                    rs_std::SliceRef<std::int32_t const>
+                    tail(rs_std::SliceRef<std::int32_t const> x);
+                }
+            );
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    namespace __crubit_internal {
+                        extern "C" void ...(
+                            rs_std::SliceRef<std::int32_t const>*,
+                            rs_std::SliceRef<std::int32_t const>* __ret_ptr);
+                    }
+                    inline rs_std::SliceRef<std::int32_t const>
+                    tail(rs_std::SliceRef<std::int32_t const> x) {
+                        crubit::ReturnValueSlot<rs_std::SliceRef<std::int32_t const>> __ret_slot;
+                        __crubit_internal::...(&x, __ret_slot.Get());
+                        return std::move(__ret_slot).AssumeInitAndTakeValue();
+                    }
+                }
+            );
+            assert_rs_matches!(
+                result.rs_details,
+                quote! {
+                    #[no_mangle]
+                    extern "C" fn ...<'a>(
+                        x: &mut ::core::mem::MaybeUninit<&'a [i32]>,
+                        __ret_slot: &mut ::core::mem::MaybeUninit<&'a [i32]>
+                    ) -> () {
+                        __ret_slot.write(::rust_out::tail(unsafe { x.assume_init_read() }));
+                    }
+                }
+            );
+        });
+    }
+
+    /// Tests that functions returning a literal are mirrored in C++ (so that C++
+    /// compilers can inline them), rather than calling a Rust thunk.
     #[test]
-    fn test_format_item_fn_cc_prerequisites_if_only_cpp_declaration_needed() {
+    fn test_format_item_fn_returning_literal() {
         let test_src = r#"
-                #[no_mangle]
-                pub extern "C" fn foo(s: S) -> bool { s.0 }
-
-                #[repr(C)]
-                pub struct S(bool);
+                pub fn answer() -> i32 {
+                    42
+                }
             "#;
-        test_format_item(test_src, "foo", |result| {
+        test_format_item(test_src, "answer", |result| {
             let result = result.unwrap().unwrap();
-            let main_api = &result.main_api;
-
-            // Minimal coverage, just to double-check that the test setup works.
-            //
-            // Note that this is only a function *declaration* (not a function definition -
-            // there is no function body), and therefore `S` just needs to be
-            // forward-declared earlier.
-            assert_cc_matches!(main_api.tokens, quote! { bool foo(::rust_out::S s); });
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    inline std::int32_t answer() {
+                        return 42;
+                    }
+                }
+            );
+            assert_cc_not_matches!(result.cc_details.tokens, quote! { __crubit_internal });
+            assert_rs_not_matches!(result.rs_details, quote! { answer });
+        });
 
-            // Main checks: `CcPrerequisites::defs` and `CcPrerequisites::fwd_decls`.
-            //
-            // Verifying the actual def_id is tricky, because `test_format_item` doesn't
-            // expose `tcx` to the verification function (and therefore calling
-            // `find_def_id_by_name` is not easily possible).
-            assert_eq!(0, main_api.prereqs.defs.len());
-            assert_eq!(1, main_api.prereqs.fwd_decls.len());
+        let test_src = r#"
+                pub fn is_supported() -> bool {
+                    true
+                }
+            "#;
+        test_format_item(test_src, "is_supported", |result| {
+            let result = result.unwrap().unwrap();
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    inline bool is_supported() {
+                        return true;
+                    }
+                }
+            );
+            assert_rs_not_matches!(result.rs_details, quote! { is_supported });
         });
     }
 
+    /// Tests that functions are not mirrored in C++ if their body is more than
+    /// a literal that C++ can spell without a suffix.
+    #[test]
+    fn test_format_item_fn_returning_non_trivial_value() {
+        for (test_src, fn_name) in [
+            ("pub fn max_u64() -> u64 { 18446744073709551615 }", "max_u64"),
+            ("pub fn with_stmt() -> i32 { let x = 42; x }", "with_stmt"),
+            ("pub fn with_param(_x: i32) -> i32 { 42 }", "with_param"),
+            ("pub fn float() -> f32 { 4.2 }", "float"),
+        ] {
+            test_format_item(test_src, fn_name, |result| {
+                let result = result.unwrap().unwrap();
+                assert_cc_matches!(result.cc_details.tokens, quote! { __crubit_internal });
+                let fn_name = make_rs_ident(fn_name);
+                assert_rs_matches!(result.rs_details, quote! { ::rust_out::#fn_name });
+            });
+        }
+    }
+
     #[test]
     fn test_format_item_fn_with_type_aliased_return_type() {
         // Type aliases disappear at the `rustc_middle::ty::Ty` level and therefore in
@@ -5439,7 +6479,7 @@ pub mod tests {
 
                 impl SomeStruct {
                     pub fn get_f32(&self) -> f32 {
-                        self.0
+                        self.0 * 2.0
                     }
                 }
             "#;
@@ -5453,13 +6493,128 @@ pub mod tests {
 
                 impl SomeStruct {
                     pub fn get_f32(self: &SomeStruct) -> f32 {
-                        self.0
+                        self.0 * 2.0
                     }
                 }
             "#;
         test_format_item_method_taking_self_by_const_ref(test_src);
     }
 
+    /// Tests that trivial field accessors are mirrored in C++ (so that C++
+    /// compilers can inline them), rather than calling a Rust thunk.
+    #[test]
+    fn test_format_item_method_trivial_field_accessors() {
+        let test_src = r#"
+                pub struct SomeStruct {
+                    pub f32_field: f32,
+                    i32_field: i32,
+                }
+
+                impl SomeStruct {
+                    pub fn get_f32(&self) -> f32 {
+                        self.f32_field
+                    }
+
+                    pub fn get_i32(&mut self) -> i32 {
+                        self.i32_field
+                    }
+                }
+            "#;
+        test_format_item(test_src, "SomeStruct", |result| {
+            let result = result.unwrap().unwrap();
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    inline float SomeStruct::get_f32()
+                        const [[clang::annotate_type("lifetime", "__anon1")]] {
+                      return this->f32_field;
+                    }
+                    ...
+                    inline std::int32_t SomeStruct::get_i32()
+                        [[clang::annotate_type("lifetime", "__anon1")]] {
+                      return this->i32_field;
+                    }
+                },
+            );
+            assert_cc_not_matches!(result.cc_details.tokens, quote! { __crubit_internal });
+            assert_rs_not_matches!(result.rs_details, quote! { get_f32 });
+            assert_rs_not_matches!(result.rs_details, quote! { get_i32 });
+        });
+    }
+
+    #[test]
+    fn test_format_item_method_trivial_tuple_field_accessor() {
+        let test_src = r#"
+                pub struct SomeStruct(pub i32, pub f32);
+
+                impl SomeStruct {
+                    pub fn get_f32(&self) -> f32 {
+                        self.1
+                    }
+                }
+            "#;
+        test_format_item(test_src, "SomeStruct", |result| {
+            let result = result.unwrap().unwrap();
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    inline float SomeStruct::get_f32()
+                        const [[clang::annotate_type("lifetime", "__anon1")]] {
+                      return this->__field1;
+                    }
+                },
+            );
+            assert_rs_not_matches!(result.rs_details, quote! { get_f32 });
+        });
+    }
+
+    /// Tests that accessors are not mirrored in C++ if they don't (only) read
+    /// a field of `Self`.
+    #[test]
+    fn test_format_item_method_non_trivial_field_accessors() {
+        let test_src = r#"
+                pub struct Inner {
+                    pub x: i32,
+                }
+
+                pub struct SomeStruct(Inner);
+
+                impl std::ops::Deref for SomeStruct {
+                    type Target = Inner;
+                    fn deref(&self) -> &Inner {
+                        &self.0
+                    }
+                }
+
+                impl SomeStruct {
+                    /// Reads a field of `Inner` (rather than of `Self`).
+                    pub fn get_x(&self) -> i32 {
+                        self.x
+                    }
+
+                    /// Does more than reading a field.
+                    pub fn get_x_plus_one(&self) -> i32 {
+                        self.0.x + 1
+                    }
+                }
+            "#;
+        test_format_item(test_src, "SomeStruct", |result| {
+            let result = result.unwrap().unwrap();
+            assert_rs_matches!(
+                result.rs_details,
+                quote! {
+                    extern "C" fn ...<'__anon1>(__self: &'__anon1 ::rust_out::SomeStruct) -> i32 {
+                        ::rust_out::SomeStruct::get_x(__self)
+                    }
+                    ...
+                    extern "C" fn ...<'__anon1>(__self: &'__anon1 ::rust_out::SomeStruct) -> i32 {
+                        ::rust_out::SomeStruct::get_x_plus_one(__self)
+                    }
+                },
+            );
+        });
+    }
+
     fn test_format_item_method_taking_self_by_mutable_ref(test_src: &str) {
         test_format_item(test_src, "SomeStruct", |result| {
             let result = result.unwrap().unwrap();
@@ -5658,6 +6813,148 @@ pub mod tests {
         });
     }
 
+    #[test]
+    fn test_format_item_struct_with_iterator_trait() {
+        let test_src = r#"
+                pub struct Counter(u32);
+
+                impl Iterator for Counter {
+                    type Item = u32;
+                    fn next(&mut self) -> Option<u32> {
+                        self.0 = self.0.checked_sub(1)?;
+                        Some(self.0)
+                    }
+                }
+            "#;
+        test_format_item(test_src, "Counter", |result| {
+            let result = result.unwrap().unwrap();
+            let main_api = &result.main_api;
+            assert!(main_api.prereqs.includes.contains(&CcInclude::user_header(
+                "crubit/support/for/tests/internal/batched_iterator.h".into()
+            )));
+            assert_cc_matches!(
+                main_api.tokens,
+                quote! {
+                    ...
+                    struct ... Counter final {
+                        ...
+                        public:
+                          __COMMENT__ "Iterator::next (via range-based `for` loops)"
+                          crubit::BatchedIterator<std::uint32_t> begin();
+                          crubit::BatchedIteratorEnd end();
+                        ...
+                    };
+                }
+            );
+            assert_cc_matches!(
+                result.cc_details.tokens,
+                quote! {
+                    namespace __crubit_internal {
+                        extern "C" std::size_t ...(
+                            void* __self, std::uint32_t* __buffer, std::size_t __capacity);
+                    }
+                    inline crubit::BatchedIterator<std::uint32_t> Counter::begin() {
+                        return crubit::BatchedIterator<std::uint32_t>(
+                            this, &__crubit_internal::...);
+                    }
+                    inline crubit::BatchedIteratorEnd Counter::end() {
+                        return {};
+                    }
+                }
+            );
+            assert_rs_matches!(
+                result.rs_details,
+                quote! {
+                    #[no_mangle]
+                    extern "C" fn ...(
+                        __self: &mut ::rust_out::Counter,
+                        __buffer: *mut ::core::mem::MaybeUninit<u32>,
+                        __capacity: usize,
+                    ) -> usize {
+                        let mut __len = 0;
+                        while __len < __capacity {
+                            match <::rust_out::Counter as ::core::iter::Iterator>::next(__self) {
+                                None => break,
+                                Some(__item) => {
+                                    unsafe { (*__buffer.add(__len)).write(__item) };
+                                    __len += 1;
+                                }
+                            }
+                        }
+                        __len
+                    }
+                }
+            );
+        });
+    }
+
+    #[test]
+    fn test_format_item_struct_with_iterator_trait_and_unsupported_item() {
+        let test_src = r#"
+                pub struct Lines(Vec<String>);
+
+                impl Iterator for Lines {
+                    type Item = String;
+                    fn next(&mut self) -> Option<String> {
+                        self.0.pop()
+                    }
+                }
+            "#;
+        test_format_item(test_src, "Lines", |result| {
+            let result = result.unwrap().unwrap();
+            let main_api = &result.main_api;
+            assert_cc_matches!(
+                main_api.tokens,
+                quote! {
+                    ...
+                    struct ... Lines final {
+                        ...
+                        __COMMENT__ "Iterating over items of type `std::string::String` is not \
+                                     supported, because they need to be dropped"
+                        ...
+                    };
+                }
+            );
+            assert_cc_not_matches!(main_api.tokens, quote! { begin });
+        });
+    }
+
+    #[test]
+    fn test_format_item_struct_with_iterator_trait_and_begin_method() {
+        let test_src = r#"
+                pub struct Counter(u32);
+
+                impl Counter {
+                    pub fn begin(&self) -> u32 { self.0 }
+                }
+
+                impl Iterator for Counter {
+                    type Item = u32;
+                    fn next(&mut self) -> Option<u32> {
+                        self.0 = self.0.checked_sub(1)?;
+                        Some(self.0)
+                    }
+                }
+            "#;
+        test_format_item(test_src, "Counter", |result| {
+            let result = result.unwrap().unwrap();
+            let main_api = &result.main_api;
+            assert_cc_matches!(
+                main_api.tokens,
+                quote! {
+                    ...
+                    struct ... Counter final {
+                        ...
+                        __COMMENT__ "Can't generate `begin` and `end` methods for `Iterator` \
+                                     (because of methods with the same name)"
+                        ...
+                    };
+                }
+            );
+            assert_cc_not_matches!(main_api.tokens, quote! { BatchedIterator });
+        });
+    }
+
     #[test]
     fn test_format_item_struct_with_copy_trait() {
         let test_src = r#"
@@ -5698,6 +6995,7 @@ pub mod tests {
                 quote! {
                     static_assert(std::is_trivially_copy_constructible_v<Point>);
                     static_assert(std::is_trivially_copy_assignable_v<Point>);
+                    static_assert(std::is_trivially_copyable_v<Point>);
                 },
             );
 
@@ -7209,7 +8507,40 @@ pub mod tests {
                     "",
                 ),
             ),
+            // Slice references:
+            (
+                "&'static [i32]",
+                (
+                    "rs_std :: SliceRef < std :: int32_t const >",
+                    "<crubit/support/for/tests/rs_std/slice_ref.h>",
+                    "",
+                    "",
+                ),
+            ),
+            (
+                "&'static mut [f64]",
+                (
+                    "rs_std :: SliceRef < double >",
+                    "<crubit/support/for/tests/rs_std/slice_ref.h>",
+                    "",
+                    "",
+                ),
+            ),
+            // String references:
+            (
+                "&'static str",
+                ("rs_std :: StrRef", "<crubit/support/for/tests/rs_std/str_ref.h>", "", ""),
+            ),
             // `SomeStruct` is a `fwd_decls` prerequisite (not `defs` prerequisite):
+            (
+                "&'static [SomeStruct]",
+                (
+                    "rs_std :: SliceRef < :: rust_out :: SomeStruct const >",
+                    "<crubit/support/for/tests/rs_std/slice_ref.h>",
+                    "",
+                    "SomeStruct",
+                ),
+            ),
             ("*mut SomeStruct", ("::rust_out::SomeStruct*", "", "", "SomeStruct")),
             // Testing propagation of deeper/nested `fwd_decls`:
             ("*mut *mut SomeStruct", (":: rust_out :: SomeStruct * *", "", "", "SomeStruct")),
@@ -7385,13 +8716,23 @@ pub mod tests {
                 "The following Rust type is not supported yet: [i32; 42]",
             ),
             (
-                "&'static [i32]", // TyKind::Slice (nested underneath TyKind::Ref)
-                "Failed to format the referent of the reference type `&'static [i32]`: \
+                "*const [i32]", // TyKind::Slice (nested underneath TyKind::RawPtr)
+                "Failed to format the pointee of the pointer type `*const [i32]`: \
                  The following Rust type is not supported yet: [i32]",
             ),
             (
-                "&'static str", // TyKind::Str (nested underneath TyKind::Ref)
-                "Failed to format the referent of the reference type `&'static str`: \
+                "&'static [&'static i32]", // TyKind::Ref (nested reference - slice element)
+                "Failed to format the element type of `&'static [&'static i32]`: \
+                 Can't format `&'static i32`, because references are only supported \
+                 in function parameter types and return types (b/286256327)",
+            ),
+            (
+                "&'static mut str", // TyKind::Str (nested underneath TyKind::Ref)
+                "`&mut str` is not supported, because C++ could use it to write invalid UTF-8",
+            ),
+            (
+                "*const str", // TyKind::Str (nested underneath TyKind::RawPtr)
+                "Failed to format the pointee of the pointer type `*const str`: \
                  The following Rust type is not supported yet: str",
             ),
             (
@@ -7527,6 +8868,10 @@ pub mod tests {
             ("&mut i32", "& '__anon1 mut i32"),
             ("&'_ i32", "& '__anon1 i32"),
             ("&'static i32", "& 'static i32"),
+            // Slice references:
+            ("&[i32]", "& '__anon1 [i32]"),
+            ("&'static mut [SomeStruct]", "& 'static mut [:: rust_out :: SomeStruct]"),
+            ("&'static str", "& 'static str"),
             // Pointer to an ADT:
             ("*mut SomeStruct", "* mut :: rust_out :: SomeStruct"),
             ("extern \"C\" fn(i32) -> i32", "extern \"C\" fn(i32) -> i32"),
@@ -7568,16 +8913,6 @@ pub mod tests {
                 "[i32; 42]", // TyKind::Array
                 "The following Rust type is not supported yet: [i32; 42]",
             ),
-            (
-                "&'static [i32]", // TyKind::Slice (nested underneath TyKind::Ref)
-                "Failed to format the referent of the reference type `&'static [i32]`: \
-                 The following Rust type is not supported yet: [i32]",
-            ),
-            (
-                "&'static str", // TyKind::Str (nested underneath TyKind::Ref)
-                "Failed to format the referent of the reference type `&'static str`: \
-                 The following Rust type is not supported yet: str",
-            ),
             (
                 "impl Eq", // TyKind::Alias
                 "The following Rust type is not supported yet: impl Eq",
@@ -8544,6 +9879,9 @@ pub mod tests {
             /* crubit_support_path_format= */ "<crubit/support/for/tests/{header}>".into(),
             /* crate_name_to_include_paths= */ Default::default(),
             /* errors = */ Rc::new(IgnoreErrors),
+            /* profiler= */ Rc::new(Profiler::disabled()),
+            /* bloat_report= */ None,
+            /* module_header_prefix= */ None,
             /* _features= */ (),
         )
     }
@@ -8561,4 +9899,27 @@ pub mod tests {
             test_function(generate_bindings(&bindings_db_for_tests(tcx)))
         })
     }
+
+    /// Like `test_generated_bindings`, but with the bindings split into
+    /// per-module headers, named `test_cc_api.<module>.h`.
+    fn test_generated_bindings_split_by_module<F, T>(source: &str, test_function: F) -> T
+    where
+        F: FnOnce(Result<Output>) -> T + Send,
+        T: Send,
+    {
+        run_compiler_for_testing(source, |tcx| {
+            let db = Database::new(
+                tcx,
+                /* crubit_support_path_format= */
+                "<crubit/support/for/tests/{header}>".into(),
+                /* crate_name_to_include_paths= */ Default::default(),
+                /* errors = */ Rc::new(IgnoreErrors),
+                /* profiler= */ Rc::new(Profiler::disabled()),
+                /* bloat_report= */ None,
+                /* module_header_prefix= */ Some("test_cc_api".into()),
+                /* _features= */ (),
+            );
+            test_function(generate_bindings(&db))
+        })
+    }
 }
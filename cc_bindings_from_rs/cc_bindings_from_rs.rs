@@ -7,21 +7,30 @@
 #![deny(rustc::internal)]
 
 extern crate rustc_middle;
+extern crate rustc_span;
 
 use arc_anyhow::{Context, Result};
 use itertools::Itertools;
 use rustc_middle::ty::TyCtxt; // See also <internal link>/ty.html#import-conventions
+use rustc_span::def_id::LOCAL_CRATE;
+use std::cell::RefCell;
 use std::collections::HashMap;
+use std::ffi::OsString;
 use std::path::Path;
 use std::rc::Rc;
+use std::time::Instant;
 
 use bindings::Database;
+use bloat_report::BloatReport;
 use cmdline::Cmdline;
 use code_gen_utils::CcInclude;
 use error_report::{ErrorReport, ErrorReporting, IgnoreErrors};
-use run_compiler::run_compiler;
+use persistent_worker::{run_persistent_worker, Outcome, PERSISTENT_WORKER_FLAG};
+use profiler::Profiler;
+use run_compiler::{run_compiler, run_compiler_without_full_analysis};
 use token_stream_printer::{
-    cc_tokens_to_formatted_string, rs_tokens_to_formatted_string, RustfmtConfig,
+    cc_tokens_to_formatted_string, rs_tokens_to_formatted_string, tokens_to_unformatted_string,
+    RustfmtConfig,
 };
 
 fn write_file(path: &Path, content: &str) -> Result<()> {
@@ -33,6 +42,8 @@ fn new_db<'tcx>(
     cmdline: &Cmdline,
     tcx: TyCtxt<'tcx>,
     errors: Rc<dyn ErrorReporting>,
+    profiler: Rc<Profiler>,
+    bloat_report: Option<Rc<RefCell<BloatReport>>>,
 ) -> Database<'tcx> {
     let crubit_support_path_format = cmdline.crubit_support_path_format.as_str().into();
 
@@ -42,16 +53,33 @@ fn new_db<'tcx>(
         paths.push(CcInclude::user_header(include_path.as_str().into()));
     }
 
+    // The module headers are written next to `h_out` (see `run_with_tcx`), and named
+    // after it.
+    let module_header_prefix = if cmdline.split_h_out_by_module {
+        cmdline.h_out.file_stem().map(|stem| stem.to_string_lossy().into())
+    } else {
+        None
+    };
+
     Database::new(
         tcx,
         crubit_support_path_format,
         crate_name_to_include_paths.into(),
         errors,
+        profiler,
+        bloat_report,
+        module_header_prefix,
         /* _features= */ (),
     )
 }
 
-fn run_with_tcx(cmdline: &Cmdline, tcx: TyCtxt) -> Result<()> {
+/// The number of items listed in the `slowestItems` section of the
+/// `--profile-out` report.
+const NUM_SLOWEST_ITEMS_TO_PROFILE: usize = 20;
+
+/// `rustc_start` is when `rustc` started parsing and analyzing the crate (i.e.
+/// the start of the `rustc` span of the `--profile-out` report).
+fn run_with_tcx(cmdline: &Cmdline, tcx: TyCtxt, rustc_start: Instant) -> Result<()> {
     use bindings::{generate_bindings, Output};
 
     let errors: Rc<dyn ErrorReporting> = if cmdline.error_report_out.is_some() {
@@ -59,21 +87,50 @@ fn run_with_tcx(cmdline: &Cmdline, tcx: TyCtxt) -> Result<()> {
     } else {
         Rc::new(IgnoreErrors)
     };
+    let profiler = Rc::new(if cmdline.profile_out.is_some() {
+        Profiler::new(rustc_start)
+    } else {
+        Profiler::disabled()
+    });
+    let bloat_report = cmdline.bloat_report_out.as_ref().map(|_| {
+        Rc::new(RefCell::new(BloatReport::new(tcx.crate_name(LOCAL_CRATE).to_string())))
+    });
+    let phase = |name: &'static str| profiler.span(profiler::PHASE, || name.to_string());
+    profiler.record(profiler::PHASE, || "rustc".to_string(), rustc_start, Instant::now());
+
+    let Output { h_body, rs_body, module_h_bodies } = {
+        let _span = phase("generate_bindings");
+        let db = new_db(cmdline, tcx, errors.clone(), profiler.clone(), bloat_report.clone());
+        let output = generate_bindings(&db)?;
+        memoized::print_query_stats_if_requested(&db.query_stats());
+        output
+    };
 
-    let Output { h_body, rs_body } = {
-        let db = new_db(cmdline, tcx, errors.clone());
-        generate_bindings(&db)?
+    let format_cc = |h_body| {
+        if cmdline.skip_formatting {
+            return tokens_to_unformatted_string(h_body);
+        }
+        let _span = phase("clang-format");
+        cc_tokens_to_formatted_string(h_body, &cmdline.clang_format_exe_path)
     };
 
-    {
-        let h_body = cc_tokens_to_formatted_string(h_body, &cmdline.clang_format_exe_path)?;
-        write_file(&cmdline.h_out, &h_body)?;
+    write_file(&cmdline.h_out, &format_cc(h_body)?)?;
+
+    for (file_name, h_body) in module_h_bodies {
+        write_file(&cmdline.h_out.with_file_name(&*file_name), &format_cc(h_body)?)?;
     }
 
     {
-        let rustfmt_config =
-            RustfmtConfig::new(&cmdline.rustfmt_exe_path, cmdline.rustfmt_config_path.as_deref());
-        let rs_body = rs_tokens_to_formatted_string(rs_body, &rustfmt_config)?;
+        let rs_body = if cmdline.skip_formatting {
+            tokens_to_unformatted_string(rs_body)?
+        } else {
+            let rustfmt_config = RustfmtConfig::new(
+                &cmdline.rustfmt_exe_path,
+                cmdline.rustfmt_config_path.as_deref(),
+            );
+            let _span = phase("rustfmt");
+            rs_tokens_to_formatted_string(rs_body, &rustfmt_config)?
+        };
         write_file(&cmdline.rs_out, &rs_body)?;
     }
 
@@ -81,15 +138,97 @@ fn run_with_tcx(cmdline: &Cmdline, tcx: TyCtxt) -> Result<()> {
         write_file(error_report_out, &errors.serialize_to_string().unwrap())?;
     }
 
+    if let (Some(bloat_report_out), Some(bloat_report)) = (&cmdline.bloat_report_out, bloat_report)
+    {
+        let bloat_report = bloat_report.borrow().serialize_to_vec().unwrap();
+        write_file(bloat_report_out, std::str::from_utf8(&bloat_report).unwrap())?;
+    }
+
+    if let Some(profile_out) = &cmdline.profile_out {
+        let profile = profiler.serialize_to_string(NUM_SLOWEST_ITEMS_TO_PROFILE).unwrap();
+        write_file(profile_out, &profile)?;
+    }
+
     Ok(())
 }
 
+/// Sets the `--rustc-env` variables for as long as it lives, and then restores
+/// their previous values (so that they don't leak into the next crate of a
+/// persistent worker).
+struct RustcEnv {
+    previous: Vec<(String, Option<OsString>)>,
+}
+
+impl RustcEnv {
+    fn set(vars: &[(String, String)]) -> Self {
+        let previous = vars
+            .iter()
+            .map(|(name, value)| {
+                let previous = std::env::var_os(name);
+                std::env::set_var(name, value);
+                (name.clone(), previous)
+            })
+            .collect();
+        Self { previous }
+    }
+}
+
+impl Drop for RustcEnv {
+    fn drop(&mut self) {
+        // In reverse, so that the first value of a variable set twice wins.
+        for (name, previous) in self.previous.iter().rev() {
+            match previous {
+                Some(value) => std::env::set_var(name, value),
+                None => std::env::remove_var(name),
+            }
+        }
+    }
+}
+
 /// Main entrypoint that (unlike `main`) doesn't do any intitializations that
 /// should only happen once for the binary (e.g. it doesn't call
 /// `init_env_logger`) and therefore can be used from the tests module below.
 fn run_with_cmdline_args(args: &[String]) -> Result<()> {
     let cmdline = Cmdline::new(args)?;
-    run_compiler(&cmdline.rustc_args, |tcx| run_with_tcx(&cmdline, tcx))
+    let _rustc_env = RustcEnv::set(&cmdline.rustc_env);
+    let rustc_start = Instant::now();
+    if cmdline.skip_full_analysis {
+        run_compiler_without_full_analysis(&cmdline.rustc_args, |tcx| {
+            run_with_tcx(&cmdline, tcx, rustc_start)
+        })
+    } else {
+        run_compiler(&cmdline.rustc_args, |tcx| run_with_tcx(&cmdline, tcx, rustc_start))
+    }
+}
+
+/// Generates the bindings for the `WorkRequest`s that Bazel sends to a
+/// persistent worker, one crate after the other in the same process.
+/// `startup_args` are the arguments that the worker was started with (without
+/// `--persistent_worker`), and come before the arguments of each request.
+///
+/// Each crate still gets a new `rustc` session: `rustc` can't share its
+/// sessions (or the crate metadata that they load) between crates. What the
+/// worker saves is the startup of the tool and of `rustc_driver` for each
+/// crate, and the files that it reads (e.g. the sysroot) stay in the page
+/// cache.
+///
+/// The diagnostics of `rustc` go to the stderr of the worker, which Bazel
+/// writes to the worker's log, and the response of a failed request has the
+/// error of the tool.
+fn run_as_persistent_worker(startup_args: &[String]) -> Result<()> {
+    // Outside of a worker, `process_wrapper --subst pwd=${pwd}` does this.
+    let pwd = std::env::current_dir()?.display().to_string();
+    run_persistent_worker(std::io::stdin().lock(), std::io::stdout(), |request_args| {
+        let args = startup_args
+            .iter()
+            .chain(request_args)
+            .map(|arg| arg.replace("${pwd}", &pwd))
+            .collect_vec();
+        match run_with_cmdline_args(&args) {
+            Ok(()) => Outcome { exit_code: 0, output: String::new() },
+            Err(err) => Outcome { exit_code: 1, output: format!("{err:?}") },
+        }
+    })
 }
 
 fn main() -> Result<()> {
@@ -104,6 +243,11 @@ fn main() -> Result<()> {
     // Unicode.  This seems okay.
     let args = std::env::args().collect_vec();
 
+    if args.iter().any(|arg| arg == PERSISTENT_WORKER_FLAG) {
+        let startup_args = args.into_iter().filter(|arg| arg != PERSISTENT_WORKER_FLAG);
+        return run_as_persistent_worker(&startup_args.collect_vec());
+    }
+
     run_with_cmdline_args(&args).map_err(|err| match err.downcast_ref::<clap::Error>() {
         // Explicitly call `clap::Error::exit`, because 1) it results in *colored* output and
         // 2) it uses a zero exit code for specific "errors" (e.g. for `--help` output).
@@ -345,6 +489,26 @@ mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_profile_generation() -> Result<()> {
+        let test_args = TestArgs::default_args()?;
+        let profile_out_path = test_args.tempdir.path().join("profile.json");
+        let profile_out_arg = format!("--profile-out={}", profile_out_path.display());
+        let test_args = test_args.with_extra_crubit_args(&[&profile_out_arg]);
+
+        test_args.run().expect("Profile generation should succeed");
+        let profile = std::fs::read_to_string(&profile_out_path)?;
+        for expected_span in ["rustc", "generate_bindings", "toposort", "clang-format", "rustfmt"] {
+            assert!(
+                profile.contains(&format!(r#""name": "{expected_span}""#)),
+                "Missing `{expected_span}` span in the profile:\n{profile}"
+            );
+        }
+        assert!(profile.contains(r#""name": "public_module::public_function""#), "{profile}");
+        assert!(profile.contains(r#""slowestItems": ["#), "{profile}");
+        Ok(())
+    }
+
     #[test]
     fn test_happy_path() -> Result<()> {
         let test_args = TestArgs::default_args()?;
@@ -421,6 +585,20 @@ extern "C" fn __crubit_thunk__ANY_IDENTIFIER_CHARACTERS()
         Ok(())
     }
 
+    /// `test_rustc_env` tests that the `--rustc-env` variables are seen by the
+    /// crate, and are unset again afterwards (as a persistent worker needs).
+    #[test]
+    fn test_rustc_env() -> Result<()> {
+        const NAME: &str = "CRUBIT_TEST_RUSTC_ENV";
+        TestArgs::default_args()?
+            .with_rs_input(&format!(r#"pub const VALUE: &str = env!("{NAME}");"#))
+            .with_extra_crubit_args(&[&format!("--rustc-env={NAME}=value")])
+            .run()
+            .expect("`env!` should see the --rustc-env variable");
+        assert_eq!(std::env::var_os(NAME), None);
+        Ok(())
+    }
+
     /// `test_run_compiler_error_propagation` tests that errors from
     /// `run_compiler` get propagated. More detailed test coverage of
     /// various specific error types can be found in tests in `run_compiler.
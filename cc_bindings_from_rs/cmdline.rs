@@ -64,6 +64,47 @@ pub struct Cmdline {
     /// Path to the error reporting output file.
     #[clap(long, value_parser, value_name = "FILE")]
     pub error_report_out: Option<PathBuf>,
+
+    /// Path to the bloat report output file. The report lists the amount of
+    /// code generated for each item (tokens, thunks, static assertions and an
+    /// estimate of the symbols), in the JSON format of `bloat_report`.
+    #[clap(long, value_parser, value_name = "FILE")]
+    pub bloat_report_out: Option<PathBuf>,
+
+    /// Path to the profile output file. The profile shows the time spent in
+    /// each phase of the tool (e.g. in `rustc` analysis, in formatting each
+    /// item, in `clang-format` and `rustfmt`) in the Chrome trace-event JSON
+    /// format, followed by a list of the items that took the longest to format.
+    #[clap(long, value_parser, value_name = "FILE")]
+    pub profile_out: Option<PathBuf>,
+
+    /// Generate the bindings right after macro expansion and name resolution,
+    /// without waiting for the Rust compiler to type-check and borrow-check
+    /// all function bodies. Only use this when the crate is also compiled by a
+    /// regular `rustc` invocation, which will report any errors in the bodies.
+    #[clap(long)]
+    pub skip_full_analysis: bool,
+
+    /// Generate the C++ bindings for each top-level module of the crate into a
+    /// separate header, next to the `--h-out` header (which will `#include`
+    /// all of them). For example, with `--h-out=foo_cc_api.h` the bindings for
+    /// `mod bar` are generated into `foo_cc_api.bar.h`.
+    #[clap(long)]
+    pub split_h_out_by_module: bool,
+
+    /// Write the generated sources without formatting them with `clang-format`
+    /// and `rustfmt` (which can take most of the time for large crates). The
+    /// unformatted sources still have a line break after each item.
+    #[clap(long)]
+    pub skip_formatting: bool,
+
+    /// Environment variables to set while the Rust compiler runs (e.g. for the
+    /// `env!` macros of the crate). The persistent worker gets the environment
+    /// of each crate this way, because its own environment is shared by all
+    /// the crates that it generates bindings for.
+    /// Example: "--rustc-env=CARGO_PKG_NAME=foo".
+    #[clap(long = "rustc-env", value_parser = parse_rustc_env, value_name = "NAME=VALUE")]
+    pub rustc_env: Vec<(String, String)>,
 }
 
 impl Cmdline {
@@ -123,6 +164,16 @@ fn parse_bindings_from_dependency(s: &str) -> Result<(String, String)> {
     Ok((crate_name.to_string(), include.to_string()))
 }
 
+/// Parse cmdline arguments of the following form: `"NAME=VALUE"` (the value
+/// may be empty).
+fn parse_rustc_env(s: &str) -> Result<(String, String)> {
+    let Some((name, value)) = s.split_once('=') else {
+        bail!("Expected NAME=VALUE syntax but no `=` found in `{s}`");
+    };
+    ensure!(!name.is_empty(), "Empty environment variable names are invalid");
+    Ok((name.to_string(), value.to_string()))
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -159,6 +210,11 @@ mod tests {
         assert_eq!(Path::new("rustfmt.exe"), cmdline.rustfmt_exe_path);
         assert!(cmdline.bindings_from_dependencies.is_empty());
         assert!(cmdline.rustfmt_config_path.is_none());
+        assert!(!cmdline.skip_full_analysis);
+        assert!(!cmdline.split_h_out_by_module);
+        assert!(!cmdline.skip_formatting);
+        assert!(cmdline.profile_out.is_none());
+        assert!(cmdline.rustc_env.is_empty());
         // Ignoring `rustc_args` in this test - they are covered in a separate
         // test below: `test_rustc_args_happy_path`.
     }
@@ -235,6 +291,18 @@ Options:
           Path to a rustfmt.toml file that should replace the default formatting of the .rs files generated by the tool
       --error-report-out <FILE>
           Path to the error reporting output file
+      --bloat-report-out <FILE>
+          Path to the bloat report output file. The report lists the amount of code generated for each item (tokens, thunks, static assertions and an estimate of the symbols), in the JSON format of `bloat_report`
+      --profile-out <FILE>
+          Path to the profile output file. The profile shows the time spent in each phase of the tool (e.g. in `rustc` analysis, in formatting each item, in `clang-format` and `rustfmt`) in the Chrome trace-event JSON format, followed by a list of the items that took the longest to format
+      --skip-full-analysis
+          Generate the bindings right after macro expansion and name resolution, without waiting for the Rust compiler to type-check and borrow-check all function bodies. Only use this when the crate is also compiled by a regular `rustc` invocation, which will report any errors in the bodies
+      --split-h-out-by-module
+          Generate the C++ bindings for each top-level module of the crate into a separate header, next to the `--h-out` header (which will `#include` all of them). For example, with `--h-out=foo_cc_api.h` the bindings for `mod bar` are generated into `foo_cc_api.bar.h`
+      --skip-formatting
+          Write the generated sources without formatting them with `clang-format` and `rustfmt` (which can take most of the time for large crates). The unformatted sources still have a line break after each item
+      --rustc-env <NAME=VALUE>
+          Environment variables to set while the Rust compiler runs (e.g. for the `env!` macros of the crate). The persistent worker gets the environment of each crate this way, because its own environment is shared by all the crates that it generates bindings for. Example: "--rustc-env=CARGO_PKG_NAME=foo"
   -h, --help
           Print help
 "#;
@@ -301,6 +369,92 @@ Options:
         assert_eq!("path2", cmdline.bindings_from_dependencies[1].1);
     }
 
+    #[test]
+    fn test_skip_full_analysis() {
+        let cmdline = new_cmdline([
+            "--h-out=foo.h",
+            "--rs-out=foo_impl.rs",
+            "--crubit-support-path-format=<crubit/support/{header}>",
+            "--clang-format-exe-path=clang-format.exe",
+            "--rustfmt-exe-path=rustfmt.exe",
+            "--skip-full-analysis",
+        ])
+        .unwrap();
+
+        assert!(cmdline.skip_full_analysis);
+    }
+
+    #[test]
+    fn test_split_h_out_by_module() {
+        let cmdline = new_cmdline([
+            "--h-out=foo.h",
+            "--rs-out=foo_impl.rs",
+            "--crubit-support-path-format=<crubit/support/{header}>",
+            "--clang-format-exe-path=clang-format.exe",
+            "--rustfmt-exe-path=rustfmt.exe",
+            "--split-h-out-by-module",
+        ])
+        .unwrap();
+
+        assert!(cmdline.split_h_out_by_module);
+    }
+
+    #[test]
+    fn test_skip_formatting() {
+        let cmdline = new_cmdline([
+            "--h-out=foo.h",
+            "--rs-out=foo_impl.rs",
+            "--crubit-support-path-format=<crubit/support/{header}>",
+            "--clang-format-exe-path=clang-format.exe",
+            "--rustfmt-exe-path=rustfmt.exe",
+            "--skip-formatting",
+        ])
+        .unwrap();
+
+        assert!(cmdline.skip_formatting);
+    }
+
+    #[test]
+    fn test_profile_out() {
+        let cmdline = new_cmdline([
+            "--h-out=foo.h",
+            "--rs-out=foo_impl.rs",
+            "--crubit-support-path-format=<crubit/support/{header}>",
+            "--clang-format-exe-path=clang-format.exe",
+            "--rustfmt-exe-path=rustfmt.exe",
+            "--profile-out=foo_profile.json",
+        ])
+        .unwrap();
+
+        assert_eq!(Some(Path::new("foo_profile.json")), cmdline.profile_out.as_deref());
+    }
+
+    #[test]
+    fn test_rustc_env() {
+        let cmdline = new_cmdline([
+            "--h-out=foo.h",
+            "--rs-out=foo_impl.rs",
+            "--crubit-support-path-format=<crubit/support/{header}>",
+            "--clang-format-exe-path=clang-format.exe",
+            "--rustfmt-exe-path=rustfmt.exe",
+            "--rustc-env=CARGO_PKG_NAME=foo",
+            "--rustc-env=EMPTY=",
+            "--rustc-env=DIR=${pwd}=x",
+        ])
+        .unwrap();
+
+        assert_eq!(
+            cmdline.rustc_env,
+            [
+                ("CARGO_PKG_NAME".to_string(), "foo".to_string()),
+                ("EMPTY".to_string(), "".to_string()),
+                ("DIR".to_string(), "${pwd}=x".to_string()),
+            ]
+        );
+        assert!(parse_rustc_env("NO_VALUE").is_err());
+        assert!(parse_rustc_env("=value").is_err());
+    }
+
     #[test]
     fn test_parse_bindings_from_dependency() {
         assert_eq!(
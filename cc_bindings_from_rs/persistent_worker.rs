@@ -0,0 +1,126 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! The JSON protocol of Bazel persistent workers
+//! (https://bazel.build/remote/persistent), which lets `cc_bindings_from_rs`
+//! stay alive between the bindings actions of many crates.
+//!
+//! Bazel starts the worker with its startup arguments and `--persistent_worker`,
+//! and then writes one `WorkRequest` per line to the worker's stdin. Each
+//! request carries the contents of the action's flag files as `arguments`. The
+//! worker answers each request with one `WorkResponse` line on its stdout. The
+//! requests are handled one at a time (i.e. this is a singleplex worker), so
+//! their `requestId` is always 0.
+
+use anyhow::{Context, Result};
+use serde::{Deserialize, Serialize};
+use std::io::{BufRead, Write};
+
+/// The flag that Bazel passes to start the tool as a persistent worker.
+pub const PERSISTENT_WORKER_FLAG: &str = "--persistent_worker";
+
+/// The fields of a `WorkRequest` that the worker uses (the others, e.g. the
+/// digests of the `inputs`, are ignored).
+#[derive(Debug, Default, Deserialize, PartialEq)]
+#[serde(rename_all = "camelCase", default)]
+struct WorkRequest {
+    arguments: Vec<String>,
+    request_id: i32,
+}
+
+#[derive(Debug, Serialize)]
+#[serde(rename_all = "camelCase")]
+struct WorkResponse {
+    exit_code: i32,
+    output: String,
+    request_id: i32,
+}
+
+/// The result of handling a request: the exit code of the action, and the
+/// output (e.g. error messages) that Bazel shows for it.
+pub struct Outcome {
+    pub exit_code: i32,
+    pub output: String,
+}
+
+/// Handles the `WorkRequest`s read from `requests` with `handle`, until
+/// `requests` is closed, and writes the `WorkResponse`s to `responses`.
+///
+/// `handle` gets the arguments of a request. Errors in the protocol itself
+/// (e.g. a request that is not valid JSON) end the worker with an error, and
+/// Bazel then starts a new one.
+pub fn run_persistent_worker(
+    requests: impl BufRead,
+    mut responses: impl Write,
+    mut handle: impl FnMut(&[String]) -> Outcome,
+) -> Result<()> {
+    for line in requests.lines() {
+        let line = line.context("Error when reading a work request")?;
+        if line.trim().is_empty() {
+            continue;
+        }
+        let request: WorkRequest = serde_json::from_str(&line)
+            .with_context(|| format!("Error when parsing the work request `{line}`"))?;
+        let Outcome { exit_code, output } = handle(&request.arguments);
+        let response = WorkResponse { exit_code, output, request_id: request.request_id };
+        serde_json::to_writer(&mut responses, &response)?;
+        // Bazel waits for the whole line before reading the response.
+        responses.write_all(b"\n")?;
+        responses.flush().context("Error when writing a work response")?;
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn parse_responses(responses: &[u8]) -> Vec<serde_json::Value> {
+        std::str::from_utf8(responses)
+            .unwrap()
+            .lines()
+            .map(|line| serde_json::from_str(line).unwrap())
+            .collect()
+    }
+
+    #[test]
+    fn test_run_persistent_worker() {
+        let requests = concat!(
+            r#"{"arguments": ["--a", "1"], "inputs": [{"path": "x", "digest": "y"}]}"#,
+            "\n\n",
+            r#"{"arguments": ["--fail"], "requestId": 0}"#,
+            "\n",
+        );
+        let mut handled = vec![];
+        let mut responses = vec![];
+        run_persistent_worker(requests.as_bytes(), &mut responses, |args| {
+            handled.push(args.to_vec());
+            if args.contains(&"--fail".to_string()) {
+                Outcome { exit_code: 1, output: "failed".to_string() }
+            } else {
+                Outcome { exit_code: 0, output: String::new() }
+            }
+        })
+        .unwrap();
+
+        assert_eq!(handled, [vec!["--a", "1"], vec!["--fail"]]);
+        let responses = parse_responses(&responses);
+        assert_eq!(responses.len(), 2);
+        assert_eq!(responses[0]["exitCode"], 0);
+        assert_eq!(responses[0]["requestId"], 0);
+        assert_eq!(responses[1]["exitCode"], 1);
+        assert_eq!(responses[1]["output"], "failed");
+    }
+
+    #[test]
+    fn test_run_persistent_worker_invalid_request() {
+        let mut responses = vec![];
+        let err = run_persistent_worker("not json\n".as_bytes(), &mut responses, |_| {
+            panic!("Invalid requests shouldn't be handled")
+        })
+        .unwrap_err();
+        assert!(format!("{err:#}").contains("not json"), "{err:#}");
+        assert!(responses.is_empty());
+    }
+}
@@ -0,0 +1,268 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! Measures where `cc_bindings_from_rs` spends its time: in each phase of the
+//! tool (e.g. `rustc` analysis, the toposort, `clang-format`) and in
+//! formatting each item.  The measurements are reported in the Chrome
+//! trace-event format, which can be loaded into `chrome://tracing` or
+//! https://ui.perfetto.dev.
+
+use anyhow::Result;
+use serde::Serialize;
+use std::cell::RefCell;
+use std::cmp::Reverse;
+use std::time::{Duration, Instant};
+
+/// Category of the spans that cover a single phase of the tool.
+pub const PHASE: &str = "phase";
+
+/// Category of the spans that cover formatting a single item.  The slowest of
+/// these spans are additionally listed in the `slowestItems` section of the
+/// report.
+pub const ITEM: &str = "item";
+
+/// Collects timed spans.  When profiling is disabled, `span` and `record` do
+/// nothing (and in particular, don't compute the names of the spans).
+#[derive(Debug)]
+pub struct Profiler {
+    /// The start of the timeline (i.e. `ts: 0` in the report).
+    origin: Instant,
+
+    /// `None` if profiling is disabled.
+    // The interior mutability / borrow_mut will never panic: it is never borrowed for longer than
+    // a method call, and the methods do not call each other.
+    events: Option<RefCell<Vec<Event>>>,
+}
+
+#[derive(Debug)]
+struct Event {
+    category: &'static str,
+    name: String,
+    start: Duration,
+    duration: Duration,
+}
+
+impl Profiler {
+    /// Creates a `Profiler` whose timeline starts at `origin`.
+    pub fn new(origin: Instant) -> Self {
+        Self { origin, events: Some(RefCell::new(vec![])) }
+    }
+
+    /// Creates a `Profiler` that doesn't record anything.
+    pub fn disabled() -> Self {
+        Self { origin: Instant::now(), events: None }
+    }
+
+    /// Starts a span that ends when the returned `Span` is dropped.
+    pub fn span(&self, category: &'static str, name: impl FnOnce() -> String) -> Span<'_> {
+        let name = self.events.as_ref().map(|_| name());
+        Span { profiler: self, category, name, start: Instant::now() }
+    }
+
+    /// Records a span that started at `start` and ended at `end`.  This is
+    /// useful for the spans that can't be covered by a `Span` guard (e.g.
+    /// because they started before the `Profiler` was created).
+    pub fn record(
+        &self,
+        category: &'static str,
+        name: impl FnOnce() -> String,
+        start: Instant,
+        end: Instant,
+    ) {
+        let Some(events) = &self.events else {
+            return;
+        };
+        events.borrow_mut().push(Event {
+            category,
+            name: name(),
+            start: start.saturating_duration_since(self.origin),
+            duration: end.saturating_duration_since(start),
+        });
+    }
+
+    /// Serializes the recorded spans as a Chrome trace-event JSON object,
+    /// with the `num_slowest_items` slowest `ITEM` spans additionally listed
+    /// under the `slowestItems` key (which trace viewers ignore).
+    ///
+    /// See https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+    /// for the description of the format.
+    pub fn serialize_to_string(&self, num_slowest_items: usize) -> Result<String> {
+        let events = self.events.as_ref().map(|events| events.borrow());
+        let events: &[Event] = events.as_deref().map(Vec::as_slice).unwrap_or_default();
+
+        let trace_events = events
+            .iter()
+            .map(|event| TraceEvent {
+                name: &event.name,
+                cat: event.category,
+                ph: "X",
+                ts: as_micros(event.start),
+                dur: as_micros(event.duration),
+                pid: 1,
+                tid: 1,
+            })
+            .collect();
+
+        let mut items = events.iter().filter(|event| event.category == ITEM).collect::<Vec<_>>();
+        // `sort_by_key` is stable, so items that took the same time stay in source order.
+        items.sort_by_key(|event| Reverse(event.duration));
+        let slowest_items = items
+            .into_iter()
+            .take(num_slowest_items)
+            .map(|event| SlowItem { name: &event.name, duration_us: as_micros(event.duration) })
+            .collect();
+
+        let report = Report { trace_events, display_time_unit: "ms", slowest_items };
+        Ok(serde_json::to_string_pretty(&report)?)
+    }
+}
+
+fn as_micros(duration: Duration) -> f64 {
+    duration.as_secs_f64() * 1e6
+}
+
+/// A span started by `Profiler::span`.
+#[must_use = "The span ends when it is dropped"]
+pub struct Span<'a> {
+    profiler: &'a Profiler,
+    category: &'static str,
+    /// `None` if profiling is disabled.
+    name: Option<String>,
+    start: Instant,
+}
+
+impl Drop for Span<'_> {
+    fn drop(&mut self) {
+        if let Some(name) = self.name.take() {
+            self.profiler.record(self.category, || name, self.start, Instant::now());
+        }
+    }
+}
+
+#[derive(Serialize)]
+#[serde(rename_all = "camelCase")]
+struct Report<'a> {
+    trace_events: Vec<TraceEvent<'a>>,
+    display_time_unit: &'static str,
+    slowest_items: Vec<SlowItem<'a>>,
+}
+
+/// A "complete event" (`"ph": "X"`) - i.e. a span with a start and a duration
+/// (both in microseconds).
+#[derive(Serialize)]
+struct TraceEvent<'a> {
+    name: &'a str,
+    cat: &'static str,
+    ph: &'static str,
+    ts: f64,
+    dur: f64,
+    pid: u32,
+    tid: u32,
+}
+
+#[derive(Serialize)]
+#[serde(rename_all = "camelCase")]
+struct SlowItem<'a> {
+    name: &'a str,
+    duration_us: f64,
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn parse(report: &str) -> serde_json::Value {
+        serde_json::from_str(report).unwrap()
+    }
+
+    #[test]
+    fn test_disabled() {
+        let profiler = Profiler::disabled();
+        {
+            let _span = profiler.span(PHASE, || panic!("Names shouldn't be computed"));
+        }
+        profiler.record(
+            ITEM,
+            || panic!("Names shouldn't be computed"),
+            Instant::now(),
+            Instant::now(),
+        );
+
+        let report = parse(&profiler.serialize_to_string(10).unwrap());
+        assert_eq!(report["traceEvents"], serde_json::json!([]));
+        assert_eq!(report["slowestItems"], serde_json::json!([]));
+    }
+
+    #[test]
+    fn test_span() {
+        let origin = Instant::now();
+        let profiler = Profiler::new(origin);
+        {
+            let _span = profiler.span(PHASE, || "some_phase".to_string());
+        }
+
+        let report = parse(&profiler.serialize_to_string(10).unwrap());
+        let events = report["traceEvents"].as_array().unwrap();
+        assert_eq!(events.len(), 1);
+        assert_eq!(events[0]["name"], "some_phase");
+        assert_eq!(events[0]["cat"], "phase");
+        assert_eq!(events[0]["ph"], "X");
+        assert!(events[0]["ts"].as_f64().unwrap() >= 0.0);
+        assert!(events[0]["dur"].as_f64().unwrap() >= 0.0);
+        assert_eq!(report["displayTimeUnit"], "ms");
+    }
+
+    #[test]
+    fn test_record() {
+        let origin = Instant::now();
+        let profiler = Profiler::new(origin);
+        let start = origin + Duration::from_micros(100);
+        let end = start + Duration::from_micros(25);
+        profiler.record(PHASE, || "rustc".to_string(), start, end);
+
+        let report = parse(&profiler.serialize_to_string(10).unwrap());
+        let events = report["traceEvents"].as_array().unwrap();
+        assert_eq!(events.len(), 1);
+        assert_eq!(events[0]["name"], "rustc");
+        assert_eq!(events[0]["ts"].as_f64().unwrap().round(), 100.0);
+        assert_eq!(events[0]["dur"].as_f64().unwrap().round(), 25.0);
+    }
+
+    #[test]
+    fn test_record_before_origin() {
+        let start = Instant::now();
+        let origin = start + Duration::from_micros(10);
+        let profiler = Profiler::new(origin);
+        profiler.record(PHASE, || "rustc".to_string(), start, origin);
+
+        let report = parse(&profiler.serialize_to_string(10).unwrap());
+        assert_eq!(report["traceEvents"][0]["ts"].as_f64().unwrap(), 0.0);
+    }
+
+    #[test]
+    fn test_slowest_items() {
+        let origin = Instant::now();
+        let profiler = Profiler::new(origin);
+        let record_item = |name: &str, micros: u64| {
+            let end = origin + Duration::from_micros(micros);
+            profiler.record(ITEM, || name.to_string(), origin, end);
+        };
+        record_item("fast", 1);
+        record_item("slowest", 30);
+        record_item("slow", 20);
+        record_item("slow_too", 20);
+        profiler.record(PHASE, || "phase".to_string(), origin, origin + Duration::from_secs(1));
+
+        let report = parse(&profiler.serialize_to_string(3).unwrap());
+        assert_eq!(report["traceEvents"].as_array().unwrap().len(), 5);
+        let names = report["slowestItems"]
+            .as_array()
+            .unwrap()
+            .iter()
+            .map(|item| item["name"].as_str().unwrap().to_string())
+            .collect::<Vec<_>>();
+        assert_eq!(names, ["slowest", "slow", "slow_too"]);
+        assert_eq!(report["slowestItems"][0]["durationUs"].as_f64().unwrap().round(), 30.0);
+    }
+}
@@ -33,6 +33,35 @@ use rustc_session::EarlyDiagCtxt;
 /// - Is safe to run from unit tests (which may run in parallel / on multiple
 ///   threads).
 pub fn run_compiler<F, R>(rustc_args: &[String], callback: F) -> Result<R>
+where
+    F: FnOnce(TyCtxt) -> Result<R> + Send,
+    R: Send,
+{
+    run_compiler_impl(rustc_args, callback, /* skip_full_analysis= */ false)
+}
+
+/// Like `run_compiler`, but invokes the `callback` right after macro expansion
+/// and name resolution, without running the full analysis of the crate first.
+///
+/// The `callback` can still use all `TyCtxt` queries (e.g. `type_of` or
+/// `fn_sig`), which are computed on demand.  What is skipped is the work that
+/// the `callback` doesn't ask for - most notably type-checking and
+/// borrow-checking of function bodies.  As a consequence, errors inside
+/// function bodies are *not* reported, so this should only be used when the
+/// crate is also compiled by a separate `rustc` invocation.
+pub fn run_compiler_without_full_analysis<F, R>(rustc_args: &[String], callback: F) -> Result<R>
+where
+    F: FnOnce(TyCtxt) -> Result<R> + Send,
+    R: Send,
+{
+    run_compiler_impl(rustc_args, callback, /* skip_full_analysis= */ true)
+}
+
+fn run_compiler_impl<F, R>(
+    rustc_args: &[String],
+    callback: F,
+    skip_full_analysis: bool,
+) -> Result<R>
 where
     F: FnOnce(TyCtxt) -> Result<R> + Send,
     R: Send,
@@ -55,7 +84,7 @@ where
     });
     Lazy::force(&ENV_LOGGER_INIT);
 
-    AfterAnalysisCallback::new(rustc_args, callback).run()
+    AfterAnalysisCallback::new(rustc_args, callback, skip_full_analysis).run()
 }
 
 struct AfterAnalysisCallback<'a, F, R>
@@ -65,6 +94,9 @@ where
 {
     args: &'a [String],
     callback_or_result: Either<F, Result<R>>,
+    /// Whether to invoke the callback from `after_expansion` (rather than from
+    /// `after_analysis`), and stop the compilation before the analysis.
+    skip_full_analysis: bool,
 }
 
 impl<'a, F, R> AfterAnalysisCallback<'a, F, R>
@@ -72,8 +104,22 @@ where
     F: FnOnce(TyCtxt) -> Result<R> + Send,
     R: Send,
 {
-    fn new(args: &'a [String], callback: F) -> Self {
-        Self { args, callback_or_result: Either::Left(callback) }
+    fn new(args: &'a [String], callback: F, skip_full_analysis: bool) -> Self {
+        Self { args, callback_or_result: Either::Left(callback), skip_full_analysis }
+    }
+
+    fn invoke_callback<'tcx>(&mut self, queries: &'tcx Queries<'tcx>) {
+        let mut query_context = queries
+            .global_ctxt()
+            .expect("Expecting no compile errors before invoking the callback.");
+        query_context.enter(|tcx| {
+            let callback = {
+                let temporary_placeholder = Either::Right(Err(anyhow!("unused")));
+                std::mem::replace(&mut self.callback_or_result, temporary_placeholder)
+                    .left_or_else(|_| panic!("The callback should only run once"))
+            };
+            self.callback_or_result = Either::Right(callback(tcx));
+        });
     }
 
     /// Runs Rust compiler, and then invokes the stored callback (with
@@ -120,6 +166,22 @@ where
         config.opts.lint_opts.push(("warnings".to_string(), rustc_lint_defs::Level::Allow));
     }
 
+    fn after_expansion<'tcx>(
+        &mut self,
+        _compiler: &Compiler,
+        queries: &'tcx Queries<'tcx>,
+    ) -> rustc_driver::Compilation {
+        if !self.skip_full_analysis {
+            return rustc_driver::Compilation::Continue;
+        }
+
+        // Errors reported so far (e.g. by name resolution) or by the queries
+        // that the callback runs are still propagated, because `rustc_driver`
+        // aborts if there were any errors when `Stop` is returned.
+        self.invoke_callback(queries);
+        rustc_driver::Compilation::Stop
+    }
+
     fn after_analysis<'tcx>(
         &mut self,
         _compiler: &Compiler,
@@ -128,18 +190,7 @@ where
         // `after_analysis` is only called by `rustc_driver` if earlier compiler
         // analysis was successful (which as the *last* compilation phase
         // presumably covers *all* errors).
-        let mut query_context = queries
-            .global_ctxt()
-            .expect("Expecting no compile errors inside `after_analysis` callback.");
-        query_context.enter(|tcx| {
-            let callback = {
-                let temporary_placeholder = Either::Right(Err(anyhow!("unused")));
-                std::mem::replace(&mut self.callback_or_result, temporary_placeholder)
-                    .left_or_else(|_| panic!("`after_analysis` should only run once"))
-            };
-            self.callback_or_result = Either::Right(callback(tcx));
-        });
-
+        self.invoke_callback(queries);
         rustc_driver::Compilation::Stop
     }
 }
@@ -231,4 +282,76 @@ mod tests {
         assert!(!out_path.exists());
         Ok(())
     }
+
+    /// Returns `rustc` cmdline arguments for compiling `rust_source` as a
+    /// library crate.
+    fn rustc_args_for_testing(tmpdir: &std::path::Path, rust_source: &str) -> Result<Vec<String>> {
+        let rs_path = tmpdir.join("input_crate.rs");
+        std::fs::write(&rs_path, rust_source)?;
+
+        let mut rustc_args = vec![
+            "run_compiler_unittest_executable".to_string(),
+            "--crate-type=lib".to_string(),
+            format!("--sysroot={}", get_sysroot_for_testing().display()),
+            rs_path.display().to_string(),
+        ];
+        if let Some(target_arg) = setup_rustc_target_for_testing(tmpdir) {
+            rustc_args.push(format!("--target={}", target_arg));
+        }
+        Ok(rustc_args)
+    }
+
+    const RUST_SOURCE_WITH_ERROR_IN_BODY: &'static str = r#"
+            pub fn public_function() -> i32 {
+                "not an i32"
+            }
+        "#;
+
+    #[test]
+    fn test_run_compiler_reports_errors_in_function_bodies() -> Result<()> {
+        let tmpdir = tempdir()?;
+        let rustc_args = rustc_args_for_testing(tmpdir.path(), RUST_SOURCE_WITH_ERROR_IN_BODY)?;
+
+        let err = run_compiler(&rustc_args, |_tcx| Ok(()))
+            .expect_err("The type error should be reported by the full analysis");
+
+        let msg = format!("{err:#}");
+        assert_eq!("Errors reported by Rust compiler.", msg);
+        Ok(())
+    }
+
+    /// `test_run_compiler_without_full_analysis_skips_function_bodies` tests
+    /// that function bodies are not type-checked, while the items in the crate
+    /// are still available to the callback.
+    #[test]
+    fn test_run_compiler_without_full_analysis_skips_function_bodies() -> Result<()> {
+        let tmpdir = tempdir()?;
+        let rustc_args = rustc_args_for_testing(tmpdir.path(), RUST_SOURCE_WITH_ERROR_IN_BODY)?;
+
+        let sig = run_compiler_without_full_analysis(&rustc_args, |tcx| {
+            let def_id = tcx
+                .hir()
+                .body_owners()
+                .find(|def_id| tcx.item_name(def_id.to_def_id()).as_str() == "public_function")
+                .expect("`public_function` should be found");
+            Ok(tcx.fn_sig(def_id).instantiate_identity().skip_binder().to_string())
+        })?;
+
+        assert_eq!("fn() -> i32", sig);
+        Ok(())
+    }
+
+    #[test]
+    fn test_run_compiler_without_full_analysis_reports_errors_in_signatures() -> Result<()> {
+        let tmpdir = tempdir()?;
+        let rustc_args =
+            rustc_args_for_testing(tmpdir.path(), "pub fn public_function() -> NoSuchType {}")?;
+
+        let err = run_compiler_without_full_analysis(&rustc_args, |_tcx| Ok(()))
+            .expect_err("Name resolution errors should be reported before the callback");
+
+        let msg = format!("{err:#}");
+        assert_eq!("Errors reported by Rust compiler.", msg);
+        Ok(())
+    }
 }
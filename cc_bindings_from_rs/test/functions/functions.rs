@@ -92,6 +92,26 @@ pub mod fn_param_ty_tests {
     pub fn set_mut_ref_to_sum_of_ints(sum: &mut i32, x: i32, y: i32) {
         *sum = x + y;
     }
+
+    pub fn sum_of_i32_slice(x: &[i32]) -> i32 {
+        x.iter().sum()
+    }
+
+    pub fn double_each_i32_in_slice(x: &mut [i32]) {
+        x.iter_mut().for_each(|i| *i *= 2);
+    }
+
+    pub fn get_tail_of_i32_slice(x: &[i32]) -> &[i32] {
+        x.get(1..).unwrap_or_default()
+    }
+
+    pub fn count_chars_in_str(s: &str) -> usize {
+        s.chars().count()
+    }
+
+    pub fn trim_str(s: &str) -> &str {
+        s.trim()
+    }
 }
 
 /// APIs for testing functions that return the unit / `()` / `void` type.
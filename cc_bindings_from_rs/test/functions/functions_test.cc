@@ -4,11 +4,17 @@
 
 #include <cstdint>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "cc_bindings_from_rs/test/functions/functions_cc_api.h"
 #include "support/rs_std/rs_char.h"
+#include "support/rs_std/slice_ref.h"
+#include "support/rs_std/str_ref.h"
 
 namespace crubit {
 namespace {
@@ -81,6 +87,42 @@ TEST(FnParamTyTest, Int32MutRef) {
   EXPECT_EQ(sum, 456 + 789);
 }
 
+TEST(FnParamTyTest, Int32Slice) {
+  const std::vector<std::int32_t> v = {1, 2, 3};
+  EXPECT_EQ(fn_param_ty_tests::sum_of_i32_slice(std::span(v)), 1 + 2 + 3);
+  EXPECT_EQ(fn_param_ty_tests::sum_of_i32_slice({}), 0);
+}
+
+TEST(FnParamTyTest, Int32MutSlice) {
+  std::vector<std::int32_t> v = {1, 2, 3};
+  fn_param_ty_tests::double_each_i32_in_slice(std::span(v));
+  EXPECT_THAT(v, testing::ElementsAre(2, 4, 6));
+}
+
+TEST(FnParamTyTest, Int32SliceReturnedWithoutCopying) {
+  const std::vector<std::int32_t> v = {1, 2, 3};
+  rs_std::SliceRef<const std::int32_t> tail =
+      fn_param_ty_tests::get_tail_of_i32_slice(std::span(v));
+  EXPECT_EQ(tail.data(), v.data() + 1);
+  EXPECT_EQ(tail.size(), 2);
+  EXPECT_TRUE(fn_param_ty_tests::get_tail_of_i32_slice({}).empty());
+}
+
+TEST(FnParamTyTest, Str) {
+  std::optional<rs_std::StrRef> s = rs_std::StrRef::from_utf8("zażółć");
+  ASSERT_TRUE(s.has_value());
+  EXPECT_EQ(fn_param_ty_tests::count_chars_in_str(*s), 6);
+  EXPECT_EQ(fn_param_ty_tests::count_chars_in_str(rs_std::StrRef()), 0);
+}
+
+TEST(FnParamTyTest, StrReturnedWithoutCopying) {
+  const std::string str = "  foo  ";
+  rs_std::StrRef trimmed = fn_param_ty_tests::trim_str(
+      rs_std::StrRef::from_utf8_unchecked(str));
+  EXPECT_EQ(trimmed.data(), str.data() + 2);
+  EXPECT_EQ(std::string_view(trimmed), "foo");
+}
+
 std::int32_t AddInt32(std::int32_t x, std::int32_t y) { return x + y; }
 
 std::int32_t MultiplyInt32(std::int32_t x, std::int32_t y) { return x * y; }
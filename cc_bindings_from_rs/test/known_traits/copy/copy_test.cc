@@ -29,6 +29,9 @@ void MainTestBody() {
 
   // Minimal verification that the copy assignment operator worked as expected.
   EXPECT_EQ(123, TypeUnderTest::extract_int(std::move(copy)));
+
+  // No copy or move calls into Rust, so that e.g. `std::vector` can `memcpy`.
+  static_assert(std::is_trivially_copyable_v<TypeUnderTest>);
 }
 
 TEST(CopyTest, ExplicitImpl) {
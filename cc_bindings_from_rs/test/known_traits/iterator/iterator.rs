@@ -0,0 +1,57 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! This crate is used as a test input for `cc_bindings_from_rs` and the
+//! generated C++ bindings are then tested via `iterator_test.cc`.
+
+/// Iterator over the numbers `0..end`.
+pub struct Counter {
+    next: u32,
+    end: u32,
+}
+
+impl Counter {
+    pub fn with_end(end: u32) -> Self {
+        Self { next: 0, end }
+    }
+}
+
+impl Iterator for Counter {
+    type Item = u32;
+
+    fn next(&mut self) -> Option<u32> {
+        if self.next == self.end {
+            return None;
+        }
+        let result = self.next;
+        self.next += 1;
+        Some(result)
+    }
+}
+
+/// Iterator that is not fused: it returns `None` after every `period` items
+/// (and then continues with more items).
+pub struct Unfused {
+    count: u32,
+    period: u32,
+}
+
+impl Unfused {
+    pub fn with_period(period: u32) -> Self {
+        Self { count: 0, period }
+    }
+}
+
+impl Iterator for Unfused {
+    type Item = u32;
+
+    fn next(&mut self) -> Option<u32> {
+        self.count += 1;
+        if self.count % (self.period + 1) == 0 {
+            None
+        } else {
+            Some(self.count)
+        }
+    }
+}
@@ -0,0 +1,60 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include <cstdint>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "cc_bindings_from_rs/test/known_traits/iterator/iterator_cc_api.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+std::vector<std::uint32_t> Collect(iterator::Counter counter) {
+  std::vector<std::uint32_t> result;
+  for (std::uint32_t i : counter) {
+    result.push_back(i);
+  }
+  return result;
+}
+
+TEST(IteratorTest, Empty) {
+  EXPECT_THAT(Collect(iterator::Counter::with_end(0)), IsEmpty());
+}
+
+TEST(IteratorTest, FewItems) {
+  EXPECT_THAT(Collect(iterator::Counter::with_end(3)), ElementsAre(0, 1, 2));
+}
+
+TEST(IteratorTest, ManyBatches) {
+  std::vector<std::uint32_t> items = Collect(iterator::Counter::with_end(1000));
+  ASSERT_EQ(items.size(), 1000u);
+  for (std::uint32_t i = 0; i < items.size(); ++i) {
+    EXPECT_EQ(items[i], i);
+  }
+}
+
+TEST(IteratorTest, Unfused) {
+  // The loop ends at the first `None` returned by the Rust iterator.
+  iterator::Unfused unfused = iterator::Unfused::with_period(2);
+  std::vector<std::uint32_t> items;
+  for (std::uint32_t i : unfused) {
+    items.push_back(i);
+  }
+  EXPECT_THAT(items, ElementsAre(1, 2));
+
+  // Iterating again continues where the Rust iterator left off.
+  items.clear();
+  for (std::uint32_t i : unfused) {
+    items.push_back(i);
+  }
+  EXPECT_THAT(items, ElementsAre(4, 5));
+}
+
+}  // namespace
+}  // namespace crubit
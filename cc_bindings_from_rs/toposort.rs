@@ -2,8 +2,8 @@
 // Exceptions. See /LICENSE for license information.
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
-use std::cmp::Ordering;
-use std::collections::{BinaryHeap, HashMap};
+use std::cmp::{Ordering, Reverse};
+use std::collections::{BinaryHeap, HashMap, HashSet};
 use std::fmt::Debug;
 use std::hash::Hash;
 
@@ -63,10 +63,14 @@ use std::hash::Hash;
 /// queue](https://en.wikipedia.org/wiki/Priority_queue) - this helps remove nodes in the desired
 /// order.
 ///
-/// Rust's standard library conveniently provides a priority queue as
-/// `std::collections::BinaryHeap`.  The `preferred_order` function is exposed
-/// to the `BinaryHeap` via the `Ord` implementation of the private `HeapNode`
-/// struct below.
+/// To keep the cost low for graphs with many nodes and dependencies, the
+/// `NodeId`s are only hashed while translating `deps`, and `preferred_order`
+/// is only called while sorting the `nodes` once upfront.  After that, the
+/// nodes are identified by their dense position in the `preferred_order`, the
+/// successors of all nodes are stored in a single array (in the [compressed
+/// sparse row](https://en.wikipedia.org/wiki/Sparse_matrix#Compressed_sparse_row_(CSR,_CRS_or_Yale_format))
+/// format), and the priority queue (`std::collections::BinaryHeap`) compares
+/// plain integers.
 ///
 /// # Why not use an existing Cargo crate?
 ///
@@ -126,58 +130,87 @@ where
     NodeId: Clone + Debug + Eq + Hash,
     CmpFn: Fn(&NodeId, &NodeId) -> Ordering,
 {
-    // Translating `nodes` and `deps` into a `graph` that maps node ids into 1)
-    // `count_of_predecessors` and 2) a set of `successor` ids.
-    let mut graph: HashMap<NodeId, GraphNode<NodeId>> =
-        nodes.into_iter().map(|id| (id, GraphNode::default())).collect();
+    // Identifying nodes by their position in the `preferred_order`.  Duplicated
+    // `nodes` are ignored.
+    let mut nodes: Vec<NodeId> = {
+        let mut seen = HashSet::new();
+        nodes.into_iter().filter(|id| seen.insert(id.clone())).collect()
+    };
+    nodes.sort_by(&preferred_order);
+    let index_of: HashMap<NodeId, usize> =
+        nodes.iter().enumerate().map(|(index, id)| (id.clone(), index)).collect();
+
+    // Translating `deps` into 1) `count_of_predecessors` and 2) `successors` of
+    // each node, where the `successors` of the node at `index` are
+    // `successors[successors_start[index]..successors_start[index + 1]]`.
+    let mut count_of_predecessors: Vec<usize> = vec![0; nodes.len()];
+    let mut successors_start: Vec<usize> = vec![0; nodes.len() + 1];
+    let mut edges: Vec<(usize, usize)> = Vec::new();
     for Dependency { predecessor, successor } in deps.into_iter() {
-        graph
-            .get_mut(&successor)
-            .unwrap_or_else(|| panic!(
+        let successor_index = *index_of.get(&successor).unwrap_or_else(|| {
+            panic!(
                 "`Dependency::successor` should refer to a NodeId in the `nodes` parameter. \
-                 predecessor = {predecessor:?}; successor = {successor:?}"))
-            .count_of_predecessors += 1;
-        graph
-            .get_mut(&predecessor)
-            .unwrap_or_else(|| panic!(
+                 predecessor = {predecessor:?}; successor = {successor:?}"
+            )
+        });
+        let predecessor_index = *index_of.get(&predecessor).unwrap_or_else(|| {
+            panic!(
                 "`Dependency::predecessor` should refer to a NodeId in the `nodes` parameter. \
-                 predecessor = {predecessor:?}; successor = {successor:?}"))
-            .successors
-            .push(successor);
+                 predecessor = {predecessor:?}; successor = {successor:?}"
+            )
+        });
+        count_of_predecessors[successor_index] += 1;
+        successors_start[predecessor_index + 1] += 1;
+        edges.push((predecessor_index, successor_index));
+    }
+    for index in 0..nodes.len() {
+        successors_start[index + 1] += successors_start[index];
+    }
+    let mut successors: Vec<usize> = vec![0; edges.len()];
+    {
+        let mut next_successor = successors_start.clone();
+        for (predecessor_index, successor_index) in edges {
+            successors[next_successor[predecessor_index]] = successor_index;
+            next_successor[predecessor_index] += 1;
+        }
     }
 
-    // `ready` contains ids of nodes which have no remaining predecessors (and which
-    // therefore are ready to be added to the `ordered` result of the
-    // topological sort).  Using a BinaryHeap to store the `ready` nodes helps
-    // to extract them in the `preferred_order`.  (This is the `S` data structure from
-    // https://en.wikipedia.org/wiki/Topological_sorting#Kahn%27s_algorithm.)
-    let mut ready: BinaryHeap<HeapNode<'_, NodeId, CmpFn>> = graph
+    // `ready` contains indices of nodes which have no remaining predecessors (and
+    // which therefore are ready to be added to the `ordered` result of the
+    // topological sort).  Using a BinaryHeap (of `Reverse`d indices, because
+    // `BinaryHeap::pop` removes the greatest item) to store the `ready` nodes helps
+    // to extract them in the `preferred_order`.  (This is the `S` data structure
+    // from https://en.wikipedia.org/wiki/Topological_sorting#Kahn%27s_algorithm.)
+    let mut ready: BinaryHeap<Reverse<usize>> = count_of_predecessors
         .iter()
-        .filter(|(_, graph_node)| graph_node.count_of_predecessors == 0)
-        .map(|(id, _)| HeapNode { id: id.clone(), cmp_fn: &preferred_order })
+        .enumerate()
+        .filter(|(_, count)| **count == 0)
+        .map(|(index, _)| Reverse(index))
         .collect();
 
-    // `ordered` contains the topologically ordered results.  (This is the `L` list
+    // `ordered_indices` contains the topologically ordered results.  (This is the `L` list
     // from https://en.wikipedia.org/wiki/Topological_sorting#Kahn%27s_algorithm.)
-    let mut ordered: Vec<NodeId> = Vec::with_capacity(graph.len());
-    while let Some(HeapNode { id: removed_id, .. }) = ready.pop() {
-        let removed_graph_node = graph.remove(&removed_id).unwrap();
-        for succ_id in removed_graph_node.successors.into_iter() {
-            let succ = graph.get_mut(&succ_id).unwrap();
-            assert!(succ.count_of_predecessors > 0);
-            succ.count_of_predecessors -= 1;
-            if succ.count_of_predecessors == 0 {
-                ready.push(HeapNode { id: succ_id, cmp_fn: &preferred_order });
+    let mut ordered_indices: Vec<usize> = Vec::with_capacity(nodes.len());
+    while let Some(Reverse(removed_index)) = ready.pop() {
+        let removed_successors =
+            &successors[successors_start[removed_index]..successors_start[removed_index + 1]];
+        for &succ_index in removed_successors {
+            let count = &mut count_of_predecessors[succ_index];
+            assert!(*count > 0);
+            *count -= 1;
+            if *count == 0 {
+                ready.push(Reverse(succ_index));
             }
         }
-        ordered.push(removed_id);
+        ordered_indices.push(removed_index);
     }
 
     // `failed` contains the remaining nodes - ones that either formed a dependency
     // cycle or (possibly indirectly) depended on a node participating in a
-    // cycle.
-    let mut failed: Vec<NodeId> = graph.into_keys().collect();
-    failed.sort_by(preferred_order);
+    // cycle.  Since `nodes` are sorted, so is `failed`.
+    let mut nodes: Vec<Option<NodeId>> = nodes.into_iter().map(Some).collect();
+    let ordered = ordered_indices.into_iter().map(|index| nodes[index].take().unwrap()).collect();
+    let failed = nodes.into_iter().flatten().collect();
 
     TopoSortResult { ordered, failed }
 }
@@ -201,65 +234,6 @@ pub struct TopoSortResult<NodeId> {
     pub failed: Vec<NodeId>,
 }
 
-struct GraphNode<NodeId> {
-    count_of_predecessors: usize,
-    successors: Vec<NodeId>,
-}
-
-// TODO(https://github.com/rust-lang/rust/issues/26925): It should be possible to
-// `#[derive(Default)]` here, but `derive` insists that `NodeId` has to
-// implement `Default` even though the default vector doesn't contain any
-// `NodeId`s.
-impl<NodeId> Default for GraphNode<NodeId> {
-    fn default() -> Self {
-        Self { count_of_predecessors: 0, successors: Vec::new() }
-    }
-}
-
-struct HeapNode<'a, NodeId, CmpFn>
-where
-    CmpFn: Fn(&NodeId, &NodeId) -> Ordering,
-{
-    id: NodeId,
-    cmp_fn: &'a CmpFn,
-}
-
-impl<'a, NodeId, CmpFn> Ord for HeapNode<'a, NodeId, CmpFn>
-where
-    CmpFn: Fn(&NodeId, &NodeId) -> Ordering,
-{
-    fn cmp(&self, other: &Self) -> Ordering {
-        // https://doc.rust-lang.org/stable/std/collections/struct.BinaryHeap.html#method.pop
-        // "removes the greatest item from the binary heap" and therefore to pop items
-        // in the `cmp_fn`-described preferred order we need to call `reverse()`
-        // below.
-        (self.cmp_fn)(&self.id, &other.id).reverse()
-    }
-}
-
-impl<'a, NodeId, CmpFn> PartialOrd for HeapNode<'a, NodeId, CmpFn>
-where
-    CmpFn: Fn(&NodeId, &NodeId) -> Ordering,
-{
-    fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
-        Some(self.cmp(other))
-    }
-}
-
-impl<'a, NodeId, CmpFn> PartialEq for HeapNode<'a, NodeId, CmpFn>
-where
-    CmpFn: Fn(&NodeId, &NodeId) -> Ordering,
-{
-    fn eq(&self, other: &Self) -> bool {
-        self.cmp(other) == Ordering::Equal
-    }
-}
-
-impl<'a, NodeId, CmpFn> Eq for HeapNode<'a, NodeId, CmpFn> where
-    CmpFn: Fn(&NodeId, &NodeId) -> Ordering
-{
-}
-
 #[cfg(test)]
 mod tests {
     /// Test helper providing simplified API for `super::toposort`:
@@ -316,6 +290,49 @@ mod tests {
         assert_eq!(failed, vec![5, 6, 7]);
     }
 
+    /// Straightforward (and slow) implementation of `toposort` that
+    /// repeatedly picks the first node (in the preferred order) that has no
+    /// remaining predecessors.
+    fn reference_toposort(nodes: &[i32], deps: &[(i32, i32)]) -> (Vec<i32>, Vec<i32>) {
+        let mut remaining = nodes.to_vec();
+        remaining.sort();
+        remaining.dedup();
+        let mut ordered = vec![];
+        while let Some(pos) = remaining.iter().position(|node| {
+            deps.iter().all(|(pred, succ)| succ != node || !remaining.contains(pred))
+        }) {
+            ordered.push(remaining.remove(pos));
+        }
+        (ordered, remaining)
+    }
+
+    #[test]
+    fn test_toposort_matches_reference() {
+        // Pseudo-random graphs, generated with a linear congruential generator
+        // to avoid depending on the `rand` crate.
+        let mut seed: u64 = 12345;
+        let mut next = |max: i32| -> i32 {
+            seed = seed.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+            ((seed >> 33) % (max as u64)) as i32
+        };
+        for _ in 0..50 {
+            let count_of_nodes = 1 + next(60);
+            let nodes: Vec<i32> = (0..count_of_nodes).map(|_| next(count_of_nodes)).collect();
+            let deps: Vec<(i32, i32)> = (0..next(2 * count_of_nodes))
+                .map(|_| {
+                    let pred = nodes[next(nodes.len() as i32) as usize];
+                    let succ = nodes[next(nodes.len() as i32) as usize];
+                    (pred, succ)
+                })
+                .collect();
+            assert_eq!(
+                toposort(&nodes, &deps),
+                reference_toposort(&nodes, &deps),
+                "nodes = {nodes:?}; deps = {deps:?}"
+            );
+        }
+    }
+
     #[test]
     fn test_example() {
         // TODO: Remove this test once rustdoc examples of the `toposort` function are
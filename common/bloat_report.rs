@@ -0,0 +1,235 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! Statistics about the amount of code generated for each item, as written to
+//! `--bloat_report_out` by `rs_bindings_from_cc` and to `--bloat-report-out` by
+//! `cc_bindings_from_rs`, and merged across targets by
+//! `bloat_report_aggregator`. They point at the items whose bindings are worth
+//! disabling (e.g. with `crubit_feature_hint`) or writing by hand to cut build
+//! time and binary size.
+
+use proc_macro2::{Delimiter, TokenStream, TokenTree};
+use serde::{Deserialize, Serialize};
+
+/// Counts of the tokens in a stream of generated code.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct TokenCounts {
+    /// The tokens of the code, without the comments and the formatting markers
+    /// of `token_stream_printer`. A group counts as one token for its
+    /// delimiters.
+    pub tokens: u64,
+    /// The `fn` keywords, i.e. the Rust functions and function declarations.
+    pub fns: u64,
+    /// The `extern "C"` functions or blocks.
+    pub extern_c: u64,
+    /// The C++ `static_assert`s and the Rust `assert!`-like macros (which are
+    /// only generated in constant contexts).
+    pub static_asserts: u64,
+}
+
+impl TokenCounts {
+    pub fn of(tokens: &TokenStream) -> Self {
+        let mut counts = Self::default();
+        counts.add(tokens.clone());
+        counts
+    }
+
+    fn add(&mut self, tokens: TokenStream) {
+        let mut iter = tokens.into_iter().peekable();
+        while let Some(tt) = iter.next() {
+            match &tt {
+                TokenTree::Ident(ident) if ident == "__NEWLINE__" || ident == "__SPACE__" => {
+                    continue;
+                }
+                TokenTree::Ident(ident) if ident == "__COMMENT__" => {
+                    // Skips the comment's text.
+                    iter.next();
+                    continue;
+                }
+                TokenTree::Punct(punct) if punct.as_char() == '#' => {
+                    // Skips doc comments, i.e. `#[doc = "..."]`.
+                    if let Some(TokenTree::Group(group)) = iter.peek() {
+                        if group.delimiter() == Delimiter::Bracket
+                            && matches!(
+                                group.stream().into_iter().next(),
+                                Some(TokenTree::Ident(ident)) if ident == "doc"
+                            )
+                        {
+                            iter.next();
+                            continue;
+                        }
+                    }
+                }
+                TokenTree::Ident(ident) if ident == "fn" => self.fns += 1,
+                TokenTree::Ident(ident) if ident == "static_assert" => self.static_asserts += 1,
+                TokenTree::Ident(ident) if ident.to_string().starts_with("assert") => {
+                    if matches!(iter.peek(), Some(TokenTree::Punct(p)) if p.as_char() == '!') {
+                        self.static_asserts += 1;
+                    }
+                }
+                TokenTree::Ident(ident) if ident == "extern" => {
+                    if let Some(TokenTree::Literal(abi)) = iter.peek() {
+                        if abi.to_string() == "\"C\"" {
+                            self.extern_c += 1;
+                        }
+                    }
+                }
+                TokenTree::Group(group) => self.add(group.stream()),
+                _ => {}
+            }
+            self.tokens += 1;
+        }
+    }
+}
+
+impl std::ops::AddAssign for TokenCounts {
+    fn add_assign(&mut self, other: Self) {
+        self.tokens += other.tokens;
+        self.fns += other.fns;
+        self.extern_c += other.extern_c;
+        self.static_asserts += other.static_asserts;
+    }
+}
+
+/// The code generated for a single (top-level) item.
+#[derive(Clone, Debug, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct ItemBloat {
+    pub name: String,
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub source_loc: Option<String>,
+    pub rs_tokens: u64,
+    pub cc_tokens: u64,
+    pub thunks: u64,
+    pub static_asserts: u64,
+    /// An estimate of the symbols that the item adds to the compiled bindings:
+    /// one per thunk and one per other Rust function. (Inline functions may
+    /// end up with no symbol, and generic ones with many.)
+    pub estimated_symbols: u64,
+}
+
+impl ItemBloat {
+    /// Measures an item from the counts of its Rust and C++ code, where
+    /// `thunks` is the number of thunks among the functions counted in `rs`.
+    pub fn new(
+        name: impl Into<String>,
+        source_loc: Option<String>,
+        rs: TokenCounts,
+        cc: TokenCounts,
+        thunks: u64,
+    ) -> Self {
+        Self {
+            name: name.into(),
+            source_loc,
+            rs_tokens: rs.tokens,
+            cc_tokens: cc.tokens,
+            thunks,
+            static_asserts: rs.static_asserts + cc.static_asserts,
+            estimated_symbols: thunks + rs.fns.saturating_sub(thunks),
+        }
+    }
+
+    /// Whether no code was generated for the item.
+    pub fn is_empty(&self) -> bool {
+        self.rs_tokens == 0 && self.cc_tokens == 0
+    }
+}
+
+/// The items of one bindings target, in the order of generation.
+#[derive(Clone, Debug, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct BloatReport {
+    pub target: String,
+    pub items: Vec<ItemBloat>,
+}
+
+impl BloatReport {
+    pub fn new(target: impl Into<String>) -> Self {
+        Self { target: target.into(), items: vec![] }
+    }
+
+    /// Adds `item`, unless no code was generated for it.
+    pub fn add(&mut self, item: ItemBloat) {
+        if !item.is_empty() {
+            self.items.push(item);
+        }
+    }
+
+    pub fn serialize_to_vec(&self) -> anyhow::Result<Vec<u8>> {
+        Ok(serde_json::to_vec_pretty(self)?)
+    }
+
+    /// Parses a report written by `serialize_to_vec`.
+    pub fn parse(bytes: &[u8]) -> anyhow::Result<Self> {
+        Ok(serde_json::from_slice(bytes)?)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use quote::quote;
+
+    #[test]
+    fn test_token_counts_of_rust() {
+        let counts = TokenCounts::of(&quote! {
+            __COMMENT__ "Not code."
+            #[doc = "Not code either."]
+            pub fn f() -> i32 { unsafe { crate::detail::__rust_thunk___Z1fv() } } __NEWLINE__
+            const _: () = assert!(::core::mem::size_of::<S>() == 4);
+            mod detail { extern "C" { pub(crate) fn __rust_thunk___Z1fv() -> i32; } }
+        });
+        assert_eq!(counts.fns, 2);
+        assert_eq!(counts.extern_c, 1);
+        assert_eq!(counts.static_asserts, 1);
+        // `pub`, `fn`, `f`, `()`, `-`, `>`, `i32` and `{}`.
+        assert_eq!(TokenCounts::of(&quote! { pub fn f() -> i32 {} }).tokens, 8);
+        assert_eq!(TokenCounts::of(&quote! { __COMMENT__ "x" #[doc = "y"] __NEWLINE__ }).tokens, 0);
+    }
+
+    #[test]
+    fn test_token_counts_of_cc() {
+        let counts = TokenCounts::of(&quote! {
+            __HASH_TOKEN__ include "foo.h" __NEWLINE__
+            extern "C" void __rust_thunk___Z1fv() { f(); }
+            static_assert(sizeof(S) == 4);
+        });
+        assert_eq!(counts.fns, 0);
+        assert_eq!(counts.extern_c, 1);
+        assert_eq!(counts.static_asserts, 1);
+    }
+
+    #[test]
+    fn test_item_bloat() {
+        let rs = TokenCounts { tokens: 10, fns: 3, extern_c: 0, static_asserts: 2 };
+        let cc = TokenCounts { tokens: 20, fns: 0, extern_c: 1, static_asserts: 1 };
+        let item = ItemBloat::new("S", Some("s.h".to_string()), rs, cc, 1);
+        assert_eq!(
+            item,
+            ItemBloat {
+                name: "S".to_string(),
+                source_loc: Some("s.h".to_string()),
+                rs_tokens: 10,
+                cc_tokens: 20,
+                thunks: 1,
+                static_asserts: 3,
+                estimated_symbols: 3,
+            }
+        );
+    }
+
+    #[test]
+    fn test_report_round_trip() {
+        let mut report = BloatReport::new("//foo:bar");
+        report.add(ItemBloat::new(
+            "f",
+            None,
+            TokenCounts { tokens: 1, fns: 1, ..Default::default() },
+            TokenCounts::default(),
+            1,
+        ));
+        let empty = TokenCounts::default();
+        report.add(ItemBloat::new("empty", None, empty, empty, 0));
+        assert_eq!(report.items.len(), 1);
+        assert_eq!(BloatReport::parse(&report.serialize_to_vec().unwrap()).unwrap(), report);
+    }
+}
@@ -0,0 +1,201 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! Merges the bloat reports of many targets (as written by
+//! `rs_bindings_from_cc` and `cc_bindings_from_rs`, see `bloat_report`) into a
+//! single JSON report with the totals of each target and the items that
+//! generate the most code across all of them, worst first.
+//!
+//! The reports of a build are in the `bloat_report` output group of the
+//! bindings targets when `//rs_bindings_from_cc/bazel_support:generate_bloat_report`
+//! (or `//cc_bindings_from_rs/bazel_support:generate_bloat_report`) is set:
+//!
+//!   bazel build --output_groups=bloat_report \
+//!     --//rs_bindings_from_cc/bazel_support:generate_bloat_report //foo/...
+//!   bloat_report_aggregator --out=/tmp/bloat.json \
+//!     $(find bazel-bin/foo -name '*_bloat_report.json')
+
+use anyhow::{Context, Result};
+use bloat_report::{BloatReport, ItemBloat};
+use clap::Parser;
+use serde::Serialize;
+use std::cmp::Reverse;
+use std::path::PathBuf;
+
+#[derive(Debug, Parser)]
+#[clap(name = "bloat_report_aggregator")]
+#[clap(about = "Aggregates the bloat reports of many targets", long_about = None)]
+struct Cmdline {
+    /// Output path for the aggregated JSON report.
+    #[clap(long, value_parser, value_name = "FILE")]
+    out: PathBuf,
+
+    /// Number of items to list, across all the targets.
+    #[clap(long, value_parser, value_name = "N", default_value_t = 100)]
+    top_items: usize,
+
+    /// The reports to aggregate. `@FILE` stands for all the reports listed
+    /// (one per line) in `FILE`.
+    #[clap(value_parser, value_name = "REPORT")]
+    reports: Vec<String>,
+}
+
+/// The totals of the items of a target.
+#[derive(Debug, Default, PartialEq, Serialize)]
+struct TargetTotals {
+    target: String,
+    items: u64,
+    rs_tokens: u64,
+    cc_tokens: u64,
+    thunks: u64,
+    static_asserts: u64,
+    estimated_symbols: u64,
+}
+
+impl TargetTotals {
+    fn of(report: &BloatReport) -> Self {
+        let mut totals = Self { target: report.target.clone(), ..Default::default() };
+        for item in &report.items {
+            totals.items += 1;
+            totals.rs_tokens += item.rs_tokens;
+            totals.cc_tokens += item.cc_tokens;
+            totals.thunks += item.thunks;
+            totals.static_asserts += item.static_asserts;
+            totals.estimated_symbols += item.estimated_symbols;
+        }
+        totals
+    }
+}
+
+#[derive(Debug, PartialEq, Serialize)]
+struct TargetItem {
+    target: String,
+    #[serde(flatten)]
+    item: ItemBloat,
+}
+
+/// The worst offenders first: by estimated symbols, then by generated tokens.
+fn cost(estimated_symbols: u64, rs_tokens: u64, cc_tokens: u64) -> Reverse<(u64, u64)> {
+    Reverse((estimated_symbols, rs_tokens + cc_tokens))
+}
+
+#[derive(Debug, Default, Serialize)]
+struct Aggregate {
+    num_reports: u64,
+    targets: Vec<TargetTotals>,
+    top_items: Vec<TargetItem>,
+}
+
+fn aggregate(reports: Vec<BloatReport>, top_items: usize) -> Aggregate {
+    let mut aggregate = Aggregate::default();
+    for report in reports {
+        aggregate.num_reports += 1;
+        aggregate.targets.push(TargetTotals::of(&report));
+        let target = report.target;
+        let items = report.items.into_iter();
+        aggregate.top_items.extend(items.map(|item| TargetItem { target: target.clone(), item }));
+    }
+    // `sort_by_key` is stable, so equally costly targets and items stay in the order of the
+    // reports.
+    aggregate.targets.sort_by_key(|t| cost(t.estimated_symbols, t.rs_tokens, t.cc_tokens));
+    aggregate
+        .top_items
+        .sort_by_key(|i| cost(i.item.estimated_symbols, i.item.rs_tokens, i.item.cc_tokens));
+    aggregate.top_items.truncate(top_items);
+    aggregate
+}
+
+/// Expands the `@FILE` arguments into the reports that they list.
+fn expand_report_args(args: &[String]) -> Result<Vec<PathBuf>> {
+    let mut reports = vec![];
+    for arg in args {
+        if let Some(list) = arg.strip_prefix('@') {
+            let list = std::fs::read_to_string(list)
+                .with_context(|| format!("Error when reading the report list `{list}`"))?;
+            reports.extend(list.lines().filter(|line| !line.is_empty()).map(PathBuf::from));
+        } else {
+            reports.push(PathBuf::from(arg));
+        }
+    }
+    Ok(reports)
+}
+
+fn run(cmdline: &Cmdline) -> Result<()> {
+    let reports = expand_report_args(&cmdline.reports)?
+        .iter()
+        .map(|path| {
+            let bytes = std::fs::read(path)
+                .with_context(|| format!("Error when reading the report `{}`", path.display()))?;
+            BloatReport::parse(&bytes)
+                .with_context(|| format!("Error when parsing the report `{}`", path.display()))
+        })
+        .collect::<Result<Vec<_>>>()?;
+    let aggregate = aggregate(reports, cmdline.top_items);
+    std::fs::write(&cmdline.out, serde_json::to_string_pretty(&aggregate)?)
+        .with_context(|| format!("Error when writing to `{}`", cmdline.out.display()))
+}
+
+fn main() -> Result<()> {
+    run(&Cmdline::parse())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn item(name: &str, estimated_symbols: u64, rs_tokens: u64) -> ItemBloat {
+        ItemBloat { name: name.to_string(), estimated_symbols, rs_tokens, ..Default::default() }
+    }
+
+    #[test]
+    fn test_aggregate() {
+        let reports = vec![
+            BloatReport { target: "//a".to_string(), items: vec![item("a1", 1, 10)] },
+            BloatReport {
+                target: "//b".to_string(),
+                items: vec![item("b1", 1, 20), item("b2", 5, 1), item("b3", 0, 1)],
+            },
+        ];
+        let aggregate = aggregate(reports, 3);
+        assert_eq!(aggregate.num_reports, 2);
+        assert_eq!(
+            aggregate.targets.iter().map(|t| (t.target.as_str(), t.items)).collect::<Vec<_>>(),
+            [("//b", 3), ("//a", 1)]
+        );
+        assert_eq!(aggregate.targets[0].estimated_symbols, 6);
+        assert_eq!(aggregate.targets[0].rs_tokens, 22);
+        assert_eq!(
+            aggregate
+                .top_items
+                .iter()
+                .map(|i| (i.target.as_str(), i.item.name.as_str()))
+                .collect::<Vec<_>>(),
+            [("//b", "b2"), ("//b", "b1"), ("//a", "a1")]
+        );
+    }
+
+    #[test]
+    fn test_run() {
+        let dir = std::env::temp_dir();
+        let report_path = dir.join("bloat_report_aggregator_test.json");
+        let report = BloatReport { target: "//a".to_string(), items: vec![item("a1", 1, 10)] };
+        std::fs::write(&report_path, report.serialize_to_vec().unwrap()).unwrap();
+        let list_path = dir.join("bloat_report_aggregator_test.list");
+        std::fs::write(&list_path, format!("{}\n", report_path.display())).unwrap();
+        let out = dir.join("bloat_report_aggregator_test_out.json");
+
+        run(&Cmdline {
+            out: out.clone(),
+            top_items: 10,
+            reports: vec![format!("@{}", list_path.display())],
+        })
+        .unwrap();
+        let output: serde_json::Value =
+            serde_json::from_str(&std::fs::read_to_string(&out).unwrap()).unwrap();
+        assert_eq!(output["num_reports"], 1);
+        assert_eq!(output["targets"][0]["target"], "//a");
+        assert_eq!(output["top_items"][0]["name"], "a1");
+        assert_eq!(output["top_items"][0]["target"], "//a");
+    }
+}
@@ -4,10 +4,13 @@
 
 use std::borrow::Cow;
 use std::cell::RefCell;
-use std::collections::BTreeMap;
+use std::collections::hash_map::DefaultHasher;
+use std::collections::{BTreeMap, HashMap};
 use std::fmt::{self, Arguments, Display, Formatter};
+use std::hash::{Hash, Hasher};
+use std::sync::Mutex;
 
-use serde::Serialize;
+use serde::{Deserialize, Serialize};
 
 #[doc(hidden)]
 pub mod macro_internal {
@@ -116,6 +119,9 @@ pub trait ErrorReporting: std::fmt::Debug {
     fn insert(&self, error: &arc_anyhow::Error);
     fn serialize_to_vec(&self) -> anyhow::Result<Vec<u8>>;
     fn serialize_to_string(&self) -> anyhow::Result<String>;
+    /// Serializes the report in the compact binary format, which can be read
+    /// back (like the JSON formats) by [`parse_report`].
+    fn serialize_to_binary(&self) -> anyhow::Result<Vec<u8>>;
 }
 
 /// A null [`ErrorReporting`] strategy.
@@ -132,6 +138,10 @@ impl ErrorReporting for IgnoreErrors {
     fn serialize_to_string(&self) -> anyhow::Result<String> {
         Ok(String::new())
     }
+
+    fn serialize_to_binary(&self) -> anyhow::Result<Vec<u8>> {
+        Ok(vec![])
+    }
 }
 
 /// An aggregate of zero or more errors.
@@ -148,23 +158,22 @@ impl ErrorReport {
     }
 }
 
+/// Returns the format string that `error` is reported under, and its sample
+/// message.
+fn format_and_sample_message(error: &arc_anyhow::Error) -> (Cow<'static, str>, Cow<'_, str>) {
+    let root_cause = error.root_cause();
+    if let Some(error) = root_cause.downcast_ref::<FormattedError>() {
+        let sample_message = if error.message != error.fmt { &*error.message } else { "" };
+        (error.fmt.clone(), Cow::Borrowed(sample_message))
+    } else {
+        (Cow::Borrowed("{}"), Cow::Owned(format!("{error}")))
+    }
+}
+
 impl ErrorReporting for ErrorReport {
     fn insert(&self, error: &arc_anyhow::Error) {
-        let root_cause = error.root_cause();
-        if let Some(error) = root_cause.downcast_ref::<FormattedError>() {
-            let sample_message = if error.message != error.fmt { &*error.message } else { "" };
-            self.map
-                .borrow_mut()
-                .entry(error.fmt.clone())
-                .or_default()
-                .add(Cow::Borrowed(sample_message));
-        } else {
-            self.map
-                .borrow_mut()
-                .entry(Cow::Borrowed("{}"))
-                .or_default()
-                .add(Cow::Owned(format!("{error}")));
-        }
+        let (fmt, sample_message) = format_and_sample_message(error);
+        self.map.borrow_mut().entry(fmt).or_default().add(sample_message);
     }
 
     fn serialize_to_vec(&self) -> anyhow::Result<Vec<u8>> {
@@ -174,12 +183,117 @@ impl ErrorReporting for ErrorReport {
     fn serialize_to_string(&self) -> anyhow::Result<String> {
         Ok(serde_json::to_string_pretty(&*self.map.borrow())?)
     }
+
+    fn serialize_to_binary(&self) -> anyhow::Result<Vec<u8>> {
+        Ok(encode_binary_report(&self.map.borrow()))
+    }
+}
+
+/// A thread-safe aggregate of zero or more errors, which serializes to the same
+/// report as [`ErrorReport`].
+///
+/// The errors are spread over `NUM_SHARDS` independently locked maps, so that
+/// threads reporting different errors rarely contend. Static format strings
+/// (the common case) are keyed by their address rather than their contents,
+/// so inserting them neither compares nor copies strings. The shards are only
+/// merged by contents (and sorted) when serializing.
+///
+/// When the same error is reported concurrently from several threads, which of
+/// the messages becomes the `sample_message` is unspecified.
+#[derive(Debug)]
+pub struct ShardedErrorReport {
+    shards: [Mutex<HashMap<FormatKey, ErrorReportEntry>>; Self::NUM_SHARDS],
+}
+
+impl Default for ShardedErrorReport {
+    fn default() -> Self {
+        Self { shards: std::array::from_fn(|_| Mutex::default()) }
+    }
 }
 
-#[derive(Default, Debug, Serialize)]
+impl ShardedErrorReport {
+    const NUM_SHARDS: usize = 16;
+
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Merges the shards into a single map, sorted by format string.
+    fn merged(&self) -> BTreeMap<Cow<'static, str>, ErrorReportEntry> {
+        let mut merged = BTreeMap::<Cow<'static, str>, ErrorReportEntry>::new();
+        for shard in &self.shards {
+            for (key, entry) in shard.lock().unwrap().iter() {
+                let fmt = match key {
+                    FormatKey::Static(fmt) => Cow::Borrowed(fmt.0),
+                    FormatKey::Owned(fmt) => Cow::Owned(fmt.clone()),
+                };
+                merged.entry(fmt).or_default().merge(entry);
+            }
+        }
+        merged
+    }
+}
+
+impl ErrorReporting for ShardedErrorReport {
+    fn insert(&self, error: &arc_anyhow::Error) {
+        let (fmt, sample_message) = format_and_sample_message(error);
+        let key = match fmt {
+            Cow::Borrowed(fmt) => FormatKey::Static(StaticFormat(fmt)),
+            Cow::Owned(fmt) => FormatKey::Owned(fmt),
+        };
+        // `DefaultHasher::new` is deterministic, so a given format string always
+        // lands in the same shard.
+        let mut hasher = DefaultHasher::new();
+        key.hash(&mut hasher);
+        let shard = &self.shards[hasher.finish() as usize % Self::NUM_SHARDS];
+        shard.lock().unwrap().entry(key).or_default().add(sample_message);
+    }
+
+    fn serialize_to_vec(&self) -> anyhow::Result<Vec<u8>> {
+        Ok(serde_json::to_vec(&self.merged())?)
+    }
+
+    fn serialize_to_string(&self) -> anyhow::Result<String> {
+        Ok(serde_json::to_string_pretty(&self.merged())?)
+    }
+
+    fn serialize_to_binary(&self) -> anyhow::Result<Vec<u8>> {
+        Ok(encode_binary_report(&self.merged()))
+    }
+}
+
+#[derive(Debug, PartialEq, Eq, Hash)]
+enum FormatKey {
+    Static(StaticFormat),
+    Owned(String),
+}
+
+/// A static format string, compared and hashed by address.
+///
+/// The same literal may appear at different addresses (e.g. in different
+/// crates); such duplicates are merged by `ShardedErrorReport::merged`.
+#[derive(Debug, Clone, Copy)]
+struct StaticFormat(&'static str);
+
+impl PartialEq for StaticFormat {
+    fn eq(&self, other: &Self) -> bool {
+        std::ptr::eq(self.0, other.0)
+    }
+}
+
+impl Eq for StaticFormat {}
+
+impl Hash for StaticFormat {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        (self.0.as_ptr() as usize).hash(state);
+        self.0.len().hash(state);
+    }
+}
+
+#[derive(Default, Debug, Serialize, Deserialize)]
 struct ErrorReportEntry {
     count: u64,
-    #[serde(skip_serializing_if = "String::is_empty")]
+    #[serde(default, skip_serializing_if = "String::is_empty")]
     sample_message: String,
 }
 
@@ -190,6 +304,121 @@ impl ErrorReportEntry {
         }
         self.count += 1;
     }
+
+    fn merge(&mut self, other: &ErrorReportEntry) {
+        if self.count == 0 {
+            self.sample_message = other.sample_message.clone();
+        }
+        self.count += other.count;
+    }
+}
+
+/// The first bytes of a report in the binary format. The leading null byte
+/// can't start a JSON report, so the formats can't be confused.
+const BINARY_REPORT_MAGIC: &[u8] = b"\0crubit-error-report-v1\n";
+
+/// Encodes the report in the binary format: `BINARY_REPORT_MAGIC`, the number
+/// of entries, and then, for each entry, its format string, count and sample
+/// message. Numbers are LEB128 varints, and strings are prefixed with their
+/// length in bytes.
+fn encode_binary_report(map: &BTreeMap<Cow<'static, str>, ErrorReportEntry>) -> Vec<u8> {
+    let mut bytes = BINARY_REPORT_MAGIC.to_vec();
+    write_varint(&mut bytes, map.len() as u64);
+    for (fmt, entry) in map {
+        write_string(&mut bytes, fmt);
+        write_varint(&mut bytes, entry.count);
+        write_string(&mut bytes, &entry.sample_message);
+    }
+    bytes
+}
+
+fn write_varint(bytes: &mut Vec<u8>, mut value: u64) {
+    while value >= 0x80 {
+        bytes.push((value as u8) | 0x80);
+        value >>= 7;
+    }
+    bytes.push(value as u8);
+}
+
+fn write_string(bytes: &mut Vec<u8>, s: &str) {
+    write_varint(bytes, s.len() as u64);
+    bytes.extend_from_slice(s.as_bytes());
+}
+
+/// Reads the binary format written by `encode_binary_report`.
+struct BinaryReader<'a> {
+    bytes: &'a [u8],
+}
+
+impl<'a> BinaryReader<'a> {
+    fn read_varint(&mut self) -> anyhow::Result<u64> {
+        let mut value = 0u64;
+        for shift in (0..64).step_by(7) {
+            let Some((&byte, rest)) = self.bytes.split_first() else {
+                anyhow::bail!("Truncated binary error report");
+            };
+            self.bytes = rest;
+            value |= u64::from(byte & 0x7f) << shift;
+            if byte & 0x80 == 0 {
+                return Ok(value);
+            }
+        }
+        anyhow::bail!("Invalid varint in binary error report")
+    }
+
+    fn read_string(&mut self) -> anyhow::Result<String> {
+        let len = self.read_varint()?;
+        let len = usize::try_from(len).ok().filter(|&len| len <= self.bytes.len());
+        let Some(len) = len else {
+            anyhow::bail!("Truncated binary error report");
+        };
+        let (s, rest) = self.bytes.split_at(len);
+        self.bytes = rest;
+        Ok(std::str::from_utf8(s)?.to_string())
+    }
+}
+
+/// An entry of a serialized error report.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ReportedError {
+    /// The format string that the errors were reported under.
+    pub fmt: String,
+    /// The number of errors reported under `fmt`.
+    pub count: u64,
+    /// One of the formatted messages, or empty if the messages are all the
+    /// same as `fmt`.
+    pub sample_message: String,
+}
+
+/// Parses a report written by any of the `serialize_*` methods of
+/// [`ErrorReporting`] (so binary, compact JSON or pretty JSON). Empty input -
+/// as written by [`IgnoreErrors`] - is an empty report.
+pub fn parse_report(bytes: &[u8]) -> anyhow::Result<Vec<ReportedError>> {
+    if bytes.is_empty() {
+        return Ok(vec![]);
+    }
+    if let Some(bytes) = bytes.strip_prefix(BINARY_REPORT_MAGIC) {
+        let mut reader = BinaryReader { bytes };
+        let num_entries = reader.read_varint()?;
+        let mut entries = vec![];
+        for _ in 0..num_entries {
+            let fmt = reader.read_string()?;
+            let count = reader.read_varint()?;
+            let sample_message = reader.read_string()?;
+            entries.push(ReportedError { fmt, count, sample_message });
+        }
+        anyhow::ensure!(reader.bytes.is_empty(), "Trailing bytes in binary error report");
+        return Ok(entries);
+    }
+    let map: BTreeMap<String, ErrorReportEntry> = serde_json::from_slice(bytes)?;
+    Ok(map
+        .into_iter()
+        .map(|(fmt, entry)| ReportedError {
+            fmt,
+            count: entry.count,
+            sample_message: entry.sample_message,
+        })
+        .collect())
 }
 
 #[cfg(test)]
@@ -345,9 +574,7 @@ mod tests {
         assert_eq!(err.message, "abcdef");
     }
 
-    #[test]
-    fn error_report() {
-        let report = ErrorReport::new();
+    fn insert_test_errors(report: &dyn ErrorReporting) {
         report.insert(&anyhow!("abc{}", "def"));
         report.insert(&anyhow!("abc{}", "123"));
         report.insert(&anyhow!("error code: {}", 65535));
@@ -378,10 +605,9 @@ mod tests {
                 .context("context 2")
                 .context("context 3"),
         );
+    }
 
-        assert_eq!(
-            report.serialize_to_string().unwrap(),
-            r#"{
+    const EXPECTED_TEST_REPORT: &str = r#"{
   "abc{}": {
     "count": 2,
     "sample_message": "abcdef"
@@ -409,7 +635,112 @@ mod tests {
     "count": 1,
     "sample_message": "not attributed"
   }
-}"#,
+}"#;
+
+    #[test]
+    fn error_report() {
+        let report = ErrorReport::new();
+        insert_test_errors(&report);
+        assert_eq!(report.serialize_to_string().unwrap(), EXPECTED_TEST_REPORT);
+    }
+
+    #[test]
+    fn sharded_error_report() {
+        let report = ShardedErrorReport::new();
+        insert_test_errors(&report);
+        assert_eq!(report.serialize_to_string().unwrap(), EXPECTED_TEST_REPORT);
+        assert_eq!(
+            report.serialize_to_vec().unwrap(),
+            serde_json::to_vec(
+                &serde_json::from_str::<serde_json::Value>(EXPECTED_TEST_REPORT).unwrap()
+            )
+            .unwrap()
         );
     }
+
+    #[test]
+    fn parse_report_formats() {
+        let report = ErrorReport::new();
+        insert_test_errors(&report);
+        let from_binary = parse_report(&report.serialize_to_binary().unwrap()).unwrap();
+        assert_eq!(from_binary, parse_report(&report.serialize_to_vec().unwrap()).unwrap());
+        assert_eq!(
+            from_binary,
+            parse_report(report.serialize_to_string().unwrap().as_bytes()).unwrap()
+        );
+        assert_eq!(from_binary.len(), 8);
+        assert_eq!(
+            from_binary[0],
+            ReportedError {
+                fmt: "abc{}".to_string(),
+                count: 2,
+                sample_message: "abcdef".to_string()
+            }
+        );
+        assert_eq!(from_binary[6].count, 3);
+        assert_eq!(from_binary[6].sample_message, "");
+    }
+
+    #[test]
+    fn parse_report_empty() {
+        assert_eq!(parse_report(&IgnoreErrors.serialize_to_binary().unwrap()).unwrap(), []);
+        assert_eq!(parse_report(&ErrorReport::new().serialize_to_binary().unwrap()).unwrap(), []);
+    }
+
+    #[test]
+    fn parse_report_large_count() {
+        let mut map = BTreeMap::new();
+        map.insert(
+            Cow::Borrowed("fmt"),
+            ErrorReportEntry { count: u64::MAX, sample_message: String::new() },
+        );
+        assert_eq!(parse_report(&encode_binary_report(&map)).unwrap()[0].count, u64::MAX);
+    }
+
+    #[test]
+    fn parse_report_errors() {
+        let report = ErrorReport::new();
+        report.insert(&anyhow!("abc{}", "def"));
+        let binary = report.serialize_to_binary().unwrap();
+        assert!(parse_report(&binary[..binary.len() - 1]).is_err());
+        assert!(parse_report(&[binary.as_slice(), b"x"].concat()).is_err());
+        assert!(parse_report(b"not a report").is_err());
+    }
+
+    #[test]
+    fn sharded_error_report_merges_equal_format_strings() {
+        let report = ShardedErrorReport::new();
+        // Different addresses, same contents.
+        let fmt1: &'static str = Box::leak("same {}".to_string().into_boxed_str());
+        let fmt2: &'static str = Box::leak("same {}".to_string().into_boxed_str());
+        report.insert(&FormattedError::new_static(fmt1, format_args!("same {}", 1)));
+        report.insert(&FormattedError::new_static(fmt2, format_args!("same {}", 2)));
+        report.insert(&anyhow!(format!("same {{}}")));
+
+        let report: serde_json::Value =
+            serde_json::from_str(&report.serialize_to_string().unwrap()).unwrap();
+        assert_eq!(report["same {}"]["count"], 3);
+    }
+
+    #[test]
+    fn sharded_error_report_concurrent_inserts() {
+        const NUM_THREADS: u64 = 8;
+        const NUM_INSERTS: u64 = 1000;
+        let report = ShardedErrorReport::new();
+        std::thread::scope(|scope| {
+            for _ in 0..NUM_THREADS {
+                scope.spawn(|| {
+                    for i in 0..NUM_INSERTS {
+                        report.insert(&anyhow!("shared error {}", i));
+                        report.insert(&anyhow!("no parameters"));
+                    }
+                });
+            }
+        });
+
+        let report: serde_json::Value =
+            serde_json::from_str(&report.serialize_to_string().unwrap()).unwrap();
+        assert_eq!(report["shared error {}"]["count"], NUM_THREADS * NUM_INSERTS);
+        assert_eq!(report["no parameters"]["count"], NUM_THREADS * NUM_INSERTS);
+    }
 }
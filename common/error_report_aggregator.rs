@@ -0,0 +1,269 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! Merges the error reports of many targets (as written to `--error_report_out`
+//! by `rs_bindings_from_cc` or `cc_bindings_from_rs`, in any of the formats
+//! that `error_report::parse_report` reads) into a single JSON report with the
+//! total count of each format string, most frequent first.
+
+use anyhow::{Context, Result};
+use clap::Parser;
+use error_report::{parse_report, ReportedError};
+use serde::Serialize;
+use std::collections::BTreeMap;
+use std::path::PathBuf;
+
+#[derive(Debug, Parser)]
+#[clap(name = "error_report_aggregator")]
+#[clap(about = "Aggregates the error reports of many targets", long_about = None)]
+struct Cmdline {
+    /// Output path for the aggregated JSON report.
+    #[clap(long, value_parser, value_name = "FILE")]
+    out: PathBuf,
+
+    /// Number of reports to parse in parallel. Defaults to the number of cores.
+    #[clap(long, value_parser, value_name = "N")]
+    jobs: Option<usize>,
+
+    /// Maximum number of distinct sample messages to keep for each format
+    /// string.
+    #[clap(long, value_parser, value_name = "N", default_value_t = 5)]
+    max_samples: usize,
+
+    /// The reports to aggregate. `@FILE` stands for all the reports listed
+    /// (one per line) in `FILE`.
+    #[clap(value_parser, value_name = "REPORT")]
+    reports: Vec<String>,
+}
+
+/// The totals of a single format string, across all the reports.
+#[derive(Debug, Default, PartialEq, Serialize)]
+struct AggregatedError {
+    count: u64,
+    /// The number of reports that contain the format string.
+    num_reports: u64,
+    #[serde(skip_serializing_if = "Vec::is_empty")]
+    sample_messages: Vec<String>,
+}
+
+#[derive(Debug, Default)]
+struct Aggregate {
+    num_reports: u64,
+    errors: BTreeMap<String, AggregatedError>,
+}
+
+impl Aggregate {
+    fn add_report(&mut self, report: Vec<ReportedError>, max_samples: usize) {
+        self.num_reports += 1;
+        for ReportedError { fmt, count, sample_message } in report {
+            let error = self.errors.entry(fmt).or_default();
+            error.count += count;
+            error.num_reports += 1;
+            add_sample(&mut error.sample_messages, sample_message, max_samples);
+        }
+    }
+
+    /// Merges `other` into `self`. The samples of `self` are kept first.
+    fn merge(&mut self, other: Aggregate, max_samples: usize) {
+        self.num_reports += other.num_reports;
+        for (fmt, other_error) in other.errors {
+            let error = self.errors.entry(fmt).or_default();
+            error.count += other_error.count;
+            error.num_reports += other_error.num_reports;
+            for sample_message in other_error.sample_messages {
+                add_sample(&mut error.sample_messages, sample_message, max_samples);
+            }
+        }
+    }
+
+    fn serialize_to_string(&self) -> Result<String> {
+        #[derive(Serialize)]
+        struct Output<'a> {
+            num_reports: u64,
+            errors: Vec<OutputError<'a>>,
+        }
+        #[derive(Serialize)]
+        struct OutputError<'a> {
+            fmt: &'a str,
+            #[serde(flatten)]
+            error: &'a AggregatedError,
+        }
+        let mut errors =
+            self.errors.iter().map(|(fmt, error)| OutputError { fmt, error }).collect::<Vec<_>>();
+        // `sort_by_key` is stable, so equally frequent errors stay sorted by format string.
+        errors.sort_by_key(|error| std::cmp::Reverse(error.error.count));
+        Ok(serde_json::to_string_pretty(&Output { num_reports: self.num_reports, errors })?)
+    }
+}
+
+fn add_sample(samples: &mut Vec<String>, sample_message: String, max_samples: usize) {
+    if !sample_message.is_empty()
+        && samples.len() < max_samples
+        && !samples.contains(&sample_message)
+    {
+        samples.push(sample_message);
+    }
+}
+
+/// Expands the `@FILE` arguments into the reports that they list.
+fn expand_report_args(args: &[String]) -> Result<Vec<PathBuf>> {
+    let mut reports = vec![];
+    for arg in args {
+        if let Some(list) = arg.strip_prefix('@') {
+            let list = std::fs::read_to_string(list)
+                .with_context(|| format!("Error when reading the report list `{list}`"))?;
+            reports.extend(list.lines().filter(|line| !line.is_empty()).map(PathBuf::from));
+        } else {
+            reports.push(PathBuf::from(arg));
+        }
+    }
+    Ok(reports)
+}
+
+/// Parses and aggregates the `reports` on `jobs` threads. Each thread
+/// aggregates a contiguous chunk of the reports, and the chunks are merged in
+/// order, so the samples don't depend on the scheduling of the threads.
+fn aggregate(reports: &[PathBuf], jobs: usize, max_samples: usize) -> Result<Aggregate> {
+    let chunk_size = reports.len().div_ceil(jobs.max(1)).max(1);
+    let chunk_aggregates = std::thread::scope(|scope| {
+        let threads = reports
+            .chunks(chunk_size)
+            .map(|chunk| {
+                scope.spawn(move || -> Result<Aggregate> {
+                    let mut aggregate = Aggregate::default();
+                    for path in chunk {
+                        let bytes = std::fs::read(path).with_context(|| {
+                            format!("Error when reading the report `{}`", path.display())
+                        })?;
+                        let report = parse_report(&bytes).with_context(|| {
+                            format!("Error when parsing the report `{}`", path.display())
+                        })?;
+                        aggregate.add_report(report, max_samples);
+                    }
+                    Ok(aggregate)
+                })
+            })
+            .collect::<Vec<_>>();
+        threads.into_iter().map(|thread| thread.join().unwrap()).collect::<Result<Vec<_>>>()
+    })?;
+
+    let mut total = Aggregate::default();
+    for chunk_aggregate in chunk_aggregates {
+        total.merge(chunk_aggregate, max_samples);
+    }
+    Ok(total)
+}
+
+fn run(cmdline: &Cmdline) -> Result<()> {
+    let reports = expand_report_args(&cmdline.reports)?;
+    let jobs = cmdline.jobs.unwrap_or_else(|| {
+        std::thread::available_parallelism().map(|jobs| jobs.get()).unwrap_or(1)
+    });
+    let aggregate = aggregate(&reports, jobs, cmdline.max_samples)?;
+    std::fs::write(&cmdline.out, aggregate.serialize_to_string()?)
+        .with_context(|| format!("Error when writing to `{}`", cmdline.out.display()))
+}
+
+fn main() -> Result<()> {
+    run(&Cmdline::parse())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use error_report::{anyhow, ErrorReport, ErrorReporting};
+
+    /// Writes `contents` into a new file in the test's temporary directory.
+    fn write_test_file(name: &str, contents: &[u8]) -> PathBuf {
+        let path = std::env::temp_dir().join(name);
+        std::fs::write(&path, contents).unwrap();
+        path
+    }
+
+    fn parse_output(aggregate: &Aggregate) -> serde_json::Value {
+        serde_json::from_str(&aggregate.serialize_to_string().unwrap()).unwrap()
+    }
+
+    #[test]
+    fn test_aggregate_mixed_formats() {
+        let report1 = ErrorReport::new();
+        report1.insert(&anyhow!("unsupported type: {}", "int128"));
+        report1.insert(&anyhow!("no parameters"));
+        let report2 = ErrorReport::new();
+        report2.insert(&anyhow!("unsupported type: {}", "float16"));
+        report2.insert(&anyhow!("unsupported type: {}", "int128"));
+        let reports = [
+            write_test_file("mixed1.bin", &report1.serialize_to_binary().unwrap()),
+            write_test_file("mixed2.json", report2.serialize_to_string().unwrap().as_bytes()),
+            write_test_file("mixed3.json", b""),
+        ];
+
+        let output = parse_output(&aggregate(&reports, 2, 5).unwrap());
+        assert_eq!(
+            output,
+            serde_json::json!({
+                "num_reports": 3,
+                "errors": [
+                    {
+                        "fmt": "unsupported type: {}",
+                        "count": 3,
+                        "num_reports": 2,
+                        "sample_messages": [
+                            "unsupported type: int128",
+                            "unsupported type: float16",
+                        ],
+                    },
+                    {
+                        "fmt": "no parameters",
+                        "count": 1,
+                        "num_reports": 1,
+                    },
+                ],
+            })
+        );
+    }
+
+    #[test]
+    fn test_aggregate_is_independent_of_jobs() {
+        let reports = (0..10)
+            .map(|i| {
+                let report = ErrorReport::new();
+                report.insert(&anyhow!("error {}", i));
+                write_test_file(&format!("jobs{i}.bin"), &report.serialize_to_binary().unwrap())
+            })
+            .collect::<Vec<_>>();
+
+        let sequential = parse_output(&aggregate(&reports, 1, 3).unwrap());
+        for jobs in [2, 3, 16] {
+            assert_eq!(parse_output(&aggregate(&reports, jobs, 3).unwrap()), sequential);
+        }
+        assert_eq!(
+            sequential["errors"][0]["sample_messages"],
+            serde_json::json!(["error 0", "error 1", "error 2"])
+        );
+    }
+
+    #[test]
+    fn test_aggregate_no_reports() {
+        let output = parse_output(&aggregate(&[], 4, 5).unwrap());
+        assert_eq!(output, serde_json::json!({"num_reports": 0, "errors": []}));
+    }
+
+    #[test]
+    fn test_aggregate_invalid_report() {
+        let reports = [write_test_file("invalid.json", b"{")];
+        let err = aggregate(&reports, 1, 5).unwrap_err();
+        assert!(format!("{err:#}").contains("Error when parsing the report"), "{err:#}");
+    }
+
+    #[test]
+    fn test_expand_report_args() {
+        let list = write_test_file("reports.txt", b"a.json\n\nb.bin\n");
+        let args = ["first.json".to_string(), format!("@{}", list.display())];
+        assert_eq!(
+            expand_report_args(&args).unwrap(),
+            [PathBuf::from("first.json"), PathBuf::from("a.json"), PathBuf::from("b.bin")]
+        );
+    }
+}
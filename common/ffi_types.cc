@@ -4,6 +4,8 @@
 
 #include "common/ffi_types.h"
 
+#include <utility>
+
 #include "absl/strings/string_view.h"
 
 namespace crubit {
@@ -19,4 +21,16 @@ absl::string_view StringViewFromFfiU8Slice(FfiU8Slice ffi_u8_slice) {
   return absl::string_view(ffi_u8_slice.ptr, ffi_u8_slice.size);
 }
 
+RustOwnedBuffer& RustOwnedBuffer::operator=(RustOwnedBuffer&& other) noexcept {
+  if (this != &other) {
+    if (box_.ptr != nullptr) FreeFfiU8SliceBox(box_);
+    box_ = std::exchange(other.box_, {});
+  }
+  return *this;
+}
+
+RustOwnedBuffer::~RustOwnedBuffer() {
+  if (box_.ptr != nullptr) FreeFfiU8SliceBox(box_);
+}
+
 }  // namespace crubit
@@ -6,6 +6,7 @@
 #define CRUBIT_COMMON_FFI_TYPES_H_
 
 #include <cstddef>
+#include <utility>
 
 #include "absl/strings/string_view.h"
 
@@ -39,6 +40,35 @@ extern "C" FfiU8SliceBox AllocFfiU8SliceBox(FfiU8Slice ffi_u8_slice);
 // Implemented in Rust.
 extern "C" void FreeFfiU8SliceBox(FfiU8SliceBox);
 
+// Owns an `FfiU8SliceBox` (and frees it when destroyed), so that the bytes
+// returned by Rust can be used and written out where they are, without first
+// copying them into a `std::string`. Moving a `RustOwnedBuffer` doesn't move
+// the bytes, so views of them stay valid.
+class RustOwnedBuffer {
+ public:
+  // Creates an empty buffer, which owns nothing.
+  RustOwnedBuffer() = default;
+
+  // Adopts `box`, which must have been allocated by Rust.
+  explicit RustOwnedBuffer(FfiU8SliceBox box) : box_(box) {}
+
+  RustOwnedBuffer(RustOwnedBuffer&& other) noexcept
+      : box_(std::exchange(other.box_, {})) {}
+  RustOwnedBuffer& operator=(RustOwnedBuffer&& other) noexcept;
+
+  RustOwnedBuffer(const RustOwnedBuffer&) = delete;
+  RustOwnedBuffer& operator=(const RustOwnedBuffer&) = delete;
+
+  ~RustOwnedBuffer();
+
+  absl::string_view view() const {
+    return absl::string_view(box_.ptr, box_.size);
+  }
+
+ private:
+  FfiU8SliceBox box_ = {.ptr = nullptr, .size = 0};
+};
+
 // Whether or not the generated binding will have doc comments indicating their
 // source location.
 enum SourceLocationDocComment {
@@ -46,6 +76,12 @@ enum SourceLocationDocComment {
   Enabled,
 };
 
+// The format of the error report (see common/error_report.rs).
+enum class ErrorReportFormat {
+  kJson,
+  kBinary,
+};
+
 }  // namespace crubit
 
 #endif  // CRUBIT_COMMON_FFI_TYPES_H_
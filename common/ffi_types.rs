@@ -100,6 +100,16 @@ pub enum SourceLocationDocComment {
     Enabled,
 }
 
+/// The format of the error report.
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash, PartialOrd, Ord)]
+pub enum ErrorReportFormat {
+    /// Compact JSON (`ErrorReporting::serialize_to_vec`).
+    Json,
+    /// The compact binary format (`ErrorReporting::serialize_to_binary`).
+    Binary,
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -0,0 +1,42 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "common/ffi_types.h"
+
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+
+namespace crubit {
+namespace {
+
+TEST(RustOwnedBufferTest, Empty) {
+  RustOwnedBuffer buffer;
+  EXPECT_EQ(buffer.view(), "");
+}
+
+TEST(RustOwnedBufferTest, AdoptsBox) {
+  RustOwnedBuffer buffer(AllocFfiU8SliceBox(MakeFfiU8Slice("bindings")));
+  EXPECT_EQ(buffer.view(), "bindings");
+}
+
+TEST(RustOwnedBufferTest, MoveKeepsTheBytesInPlace) {
+  RustOwnedBuffer buffer(AllocFfiU8SliceBox(MakeFfiU8Slice("bindings")));
+  absl::string_view view = buffer.view();
+
+  RustOwnedBuffer moved(std::move(buffer));
+  EXPECT_EQ(moved.view().data(), view.data());
+  EXPECT_EQ(moved.view(), "bindings");
+  EXPECT_EQ(buffer.view(), "");  // NOLINT(bugprone-use-after-move)
+}
+
+TEST(RustOwnedBufferTest, MoveAssignmentFreesThePreviousBox) {
+  RustOwnedBuffer buffer(AllocFfiU8SliceBox(MakeFfiU8Slice("old")));
+  buffer = RustOwnedBuffer(AllocFfiU8SliceBox(MakeFfiU8Slice("new")));
+  EXPECT_EQ(buffer.view(), "new");
+}
+
+}  // namespace
+}  // namespace crubit
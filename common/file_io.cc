@@ -7,7 +7,9 @@
 #include <memory>
 #include <string>
 #include <system_error>
+#include <utility>
 
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -27,14 +29,33 @@ absl::StatusOr<std::string> GetFileContents(absl::string_view path) {
   return std::string((*err_or_buffer)->getBuffer());
 }
 
+absl::StatusOr<std::unique_ptr<llvm::MemoryBuffer>> MapFileContents(
+    absl::string_view path) {
+  // Only buffers that don't need a trailing null can be mapped in general.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> err_or_buffer =
+      llvm::MemoryBuffer::getFile(path, /* IsText= */ false,
+                                  /* RequiresNullTerminator= */ false);
+  if (std::error_code err = err_or_buffer.getError()) {
+    return absl::Status(absl::StatusCode::kInternal, err.message());
+  }
+  return std::move(*err_or_buffer);
+}
+
 absl::Status SetFileContents(absl::string_view path,
                              absl::string_view contents) {
+  return WriteFileContents(
+      path, [contents](llvm::raw_ostream& stream) { stream << contents; });
+}
+
+absl::Status WriteFileContents(
+    absl::string_view path,
+    absl::FunctionRef<void(llvm::raw_ostream&)> write) {
   std::error_code error_code;
   llvm::raw_fd_ostream stream(path, error_code);
   if (error_code) {
     return absl::Status(absl::StatusCode::kInternal, error_code.message());
   }
-  stream << contents;
+  write(stream);
   stream.close();
   if (stream.has_error()) {
     return absl::Status(absl::StatusCode::kInternal, stream.error().message());
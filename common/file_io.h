@@ -5,19 +5,35 @@
 #ifndef CRUBIT_COMMON_FILE_IO_H_
 #define CRUBIT_COMMON_FILE_IO_H_
 
+#include <memory>
 #include <string>
 
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 
 namespace crubit {
 
 absl::StatusOr<std::string> GetFileContents(absl::string_view path);
 
+// Like `GetFileContents`, but returns a buffer that is memory-mapped where
+// possible rather than a copy of the file, so that reading a large file does
+// not need memory for all of it up front.
+absl::StatusOr<std::unique_ptr<llvm::MemoryBuffer>> MapFileContents(
+    absl::string_view path);
+
 absl::Status SetFileContents(absl::string_view path,
                              absl::string_view contents);
 
+// Like `SetFileContents`, but the contents are whatever `write` writes to the
+// given stream, so that they don't need to be materialized as one string.
+absl::Status WriteFileContents(
+    absl::string_view path,
+    absl::FunctionRef<void(llvm::raw_ostream&)> write);
+
 }  // namespace crubit
 
 #endif  // CRUBIT_COMMON_FILE_IO_H_
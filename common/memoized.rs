@@ -21,7 +21,10 @@
 //! * Syntactic differences when initially setting up the trait and database.
 //! * In particular, there is no support for separate compilation: the trait and
 //!   its implementation are defined in the same crate.
-//! * Immutable input and no support for recomputation given mutated inputs.
+//! * Inputs are only tracked coarsely: each memoized value records which
+//!   inputs it (transitively) read, and is recomputed when any of them is
+//!   set. There is no "early cutoff" when a recomputed value turns out to be
+//!   unchanged.
 //! * Correspondingly, no requirement that the *return* types implement `Eq` or
 //!   `Hash`.
 //!
@@ -31,6 +34,8 @@
 //! going back to Salsa, or evolving towards something closer to what
 //! Salsa implements.
 
+use std::time::Duration;
+
 /// `query_group!` defines a collection of memoized functions, and the shared
 /// inputs that all of those functions can access.
 ///
@@ -48,14 +53,20 @@
 ///     // in order to access the input value. In other words, they form a sort of immutable global
 ///     // state, useful to pass immutable configuration values to _all_ of the memoized functions.
 ///     //
-///     // The inputs are immutable, and must be `Clone`. Because they are immutable and global,
-///     // they do not need to be `Eq` or `Hash`, and they are not compared when memoizing
-///     // functions.
+///     // The inputs must be `Clone`. They do not need to be `Eq` or `Hash`, and they are not
+///     // compared when memoizing functions.
 ///     //
 ///     // As a rule of thumb, anything which is a constant for the lifetime of an execution, but
 ///     // is not an actual compile time constant, should be an input.
 ///     #[input]
 ///     fn some_input(&self) -> InputType;
+///
+///     // An input can be given a setter, which replaces its value. The memoized values that were
+///     // computed from the previous value (i.e. whose computation called `db.other_input()`,
+///     // directly or through other memoized functions) are then recomputed when they are next
+///     // requested; all the other memoized values are kept.
+///     #[input(set_other_input)]
+///     fn other_input(&self) -> OtherInputType;
 ///     //...
 ///
 ///     // After all of the inputs, the actual memoized functions are specified.
@@ -93,8 +104,10 @@
 /// functions will return the corresponding values passed in to `Database::new`,
 /// and the memoized functions will call the corresponding top-level functions.
 ///
-/// For example, above, one could run `let db =
-/// Database::new(InputType::default())`.
+/// For example, above, one could run `let mut db =
+/// Database::new(InputType::default(), OtherInputType::default())`, and later
+/// `db.set_other_input(...)`. A setter takes `&mut self`, so the inputs can't
+/// change while any memoized function is running.
 ///
 /// Now, if you call `db.some_function(...)`, it will either return a cached
 /// value (if one is present), or else execute `some_function(&db as &dyn
@@ -143,13 +156,19 @@
 /// ```
 ///
 /// And so you may need to specify the lifetime in some uses.
+///
+/// # Statistics
+///
+/// `Database` also has a `query_stats()` method, which returns the
+/// `QueryStats` of each memoized function (see `print_query_stats_if_requested`
+/// for dumping them).
 #[macro_export]
 macro_rules! query_group {
   (
     $trait_vis:vis trait $trait:ident $(<$($type_param:tt),*>)?{
       $(
         $(#[doc = $input_doc:literal])*
-        #[input]
+        #[input $(($input_setter:ident))?]
         fn $input_function:ident(&self $(,)?) -> $input_type:ty;
       )*
       $(
@@ -186,8 +205,9 @@ macro_rules! query_group {
 
     // Now we can generate a database struct that contains the lookup tables.
     $struct_vis struct $database_struct $(<$($type_param),*>)? {
+      __memoized_runtime: $crate::internal::Runtime,
       $(
-        $input_function: $input_type,
+        $input_function: $crate::internal::Input<$input_type>,
       )*
       $(
         $function: $crate::internal::MemoizationTable<($($arg_type,)*), $return_type>,
@@ -198,10 +218,11 @@ macro_rules! query_group {
     impl $(<$($type_param),*>)? $trait $(<$($type_param),*>)? for $database_struct $(<$($type_param),*>)? {
       $(
         fn $input_function(&self) -> $input_type {
+          self.__memoized_runtime.report_input_read(self.$input_function.index);
           // Have to be very careful to clone whatever the top level value is.
           // In particular, if it's a reference `&T`, clone the _reference_ to get another `&T`,
-          // not the referent to get a `T`, like if we just cloned `self.$input_function`.
-          (&self.$input_function).clone()
+          // not the referent to get a `T`, like if we just cloned `self.$input_function.value`.
+          (&self.$input_function.value).clone()
         }
       )*
       $(
@@ -212,6 +233,7 @@ macro_rules! query_group {
           ),*
         ) -> $return_type {
           self.$function.internal_memoized_call(
+            &self.__memoized_runtime,
             ($(
               $arg,
             )*),
@@ -224,10 +246,16 @@ macro_rules! query_group {
         }
       )*
     }
-    // and the new() function for initialization.
+    // and the new() function for initialization, and the setters of the inputs.
     impl $(<$($type_param),*>)? $database_struct $(<$($type_param),*>)? {
       $struct_vis fn new($($input_function: $input_type),*) -> Self {
+        #[allow(unused_mut)]
+        let mut num_inputs = 0;
+        $(
+          let $input_function = $crate::internal::Input::new($input_function, &mut num_inputs);
+        )*
         Self {
+          __memoized_runtime: $crate::internal::Runtime::new(num_inputs),
           $(
             $input_function,
           )*
@@ -236,22 +264,209 @@ macro_rules! query_group {
           )*
         }
       }
+
+      /// Returns the statistics of the memoization table of each memoized function.
+      #[allow(dead_code)]
+      $struct_vis fn query_stats(&self) -> Vec<$crate::QueryStats> {
+        vec![$(
+          self.$function.stats(stringify!($function)),
+        )*]
+      }
+
+      $(
+        $(
+          $struct_vis fn $input_setter(&mut self, value: $input_type) {
+            self.$input_function.value = value;
+            self.__memoized_runtime.set_input_changed(self.$input_function.index);
+          }
+        )?
+      )*
     }
   }
 }
 
+/// The statistics of the memoization table of a memoized function.
+#[derive(Clone, Debug)]
+pub struct QueryStats {
+    pub name: &'static str,
+    /// The number of calls that returned a memoized value.
+    pub hits: u64,
+    /// The number of calls that computed their value.
+    pub misses: u64,
+    /// The time spent in computing values, not including the time spent in
+    /// the memoized functions that they called.
+    pub compute_time: Duration,
+    pub entries: usize,
+    /// An approximation of the memory used by the table: only the memoized
+    /// arguments and values themselves are counted, not the heap memory that
+    /// they point to (e.g. the contents of an `Rc`).
+    pub approximate_bytes: usize,
+}
+
+/// The environment variable that makes `print_query_stats_if_requested` print
+/// the statistics.
+pub const QUERY_STATS_ENV_VAR: &str = "CRUBIT_QUERY_STATS";
+
+/// Prints a table of `stats` to stderr (sorted by compute time, most expensive
+/// first) if the `CRUBIT_QUERY_STATS` environment variable is set.
+pub fn print_query_stats_if_requested(stats: &[QueryStats]) {
+    if std::env::var_os(QUERY_STATS_ENV_VAR).is_some() {
+        eprint!("{}", format_query_stats(stats));
+    }
+}
+
+fn format_query_stats(stats: &[QueryStats]) -> String {
+    let mut stats = stats.to_vec();
+    stats.sort_by_key(|stats| std::cmp::Reverse(stats.compute_time));
+    let mut table = format!(
+        "{:<40} {:>10} {:>10} {:>12} {:>10} {:>12}\n",
+        "query", "hits", "misses", "time (ms)", "entries", "bytes"
+    );
+    for stats in &stats {
+        table += &format!(
+            "{:<40} {:>10} {:>10} {:>12.3} {:>10} {:>12}\n",
+            stats.name,
+            stats.hits,
+            stats.misses,
+            stats.compute_time.as_secs_f64() * 1000.0,
+            stats.entries,
+            stats.approximate_bytes
+        );
+    }
+    table
+}
+
 #[doc(hidden)]
 pub mod internal {
-    use std::cell::RefCell;
+    use std::cell::{Cell, RefCell};
     use std::collections::{HashMap, HashSet};
     use std::hash::Hash;
+    use std::time::{Duration, Instant};
+
+    /// The number of times that an input of the database was set.
+    pub type Revision = u64;
+
+    /// A set of inputs of a database, as a bit mask of their indices.
+    #[derive(Clone, Copy, Default)]
+    pub struct InputSet(u64);
+
+    impl InputSet {
+        const CAPACITY: usize = u64::BITS as usize;
+
+        fn contains(self, index: usize) -> bool {
+            self.0 & (1 << index) != 0
+        }
+    }
+
+    /// An input of a database, and its index in the `InputSet`s.
+    pub struct Input<T> {
+        pub value: T,
+        pub index: usize,
+    }
+
+    impl<T> Input<T> {
+        /// Creates the input with the index `*num_inputs`, and increments
+        /// `*num_inputs`.
+        pub fn new(value: T, num_inputs: &mut usize) -> Self {
+            let index = *num_inputs;
+            *num_inputs += 1;
+            Self { value, index }
+        }
+    }
+
+    /// What a memoized call in progress has done so far.
+    #[derive(Default)]
+    struct ActiveCall {
+        reads: InputSet,
+        /// The time spent in the memoized calls that it made.
+        callee_time: Duration,
+    }
+
+    /// The state shared by all the memoization tables of a database: the
+    /// current revision, the revision in which each input was last set, and
+    /// the memoized calls in progress.
+    pub struct Runtime {
+        revision: Revision,
+        input_changed_at: Vec<Revision>,
+        active_calls: RefCell<Vec<ActiveCall>>,
+    }
+
+    impl Runtime {
+        pub fn new(num_inputs: usize) -> Self {
+            assert!(
+                num_inputs <= InputSet::CAPACITY,
+                "A query group can have at most {} inputs",
+                InputSet::CAPACITY
+            );
+            Self {
+                revision: 0,
+                input_changed_at: vec![0; num_inputs],
+                active_calls: RefCell::new(vec![]),
+            }
+        }
+
+        pub fn set_input_changed(&mut self, index: usize) {
+            self.revision += 1;
+            self.input_changed_at[index] = self.revision;
+        }
+
+        pub fn report_input_read(&self, index: usize) {
+            self.report_reads(InputSet(1 << index));
+        }
+
+        /// Adds `inputs` to the inputs read by the innermost memoized call in
+        /// progress (if any).
+        fn report_reads(&self, inputs: InputSet) {
+            if let Some(call) = self.active_calls.borrow_mut().last_mut() {
+                call.reads.0 |= inputs.0;
+            }
+        }
+
+        /// Returns whether none of the `inputs` was set after `revision`.
+        fn is_up_to_date(&self, inputs: InputSet, revision: Revision) -> bool {
+            revision == self.revision
+                || self
+                    .input_changed_at
+                    .iter()
+                    .enumerate()
+                    .all(|(index, changed_at)| !inputs.contains(index) || *changed_at <= revision)
+        }
+
+        /// Calls `f`, and returns its result together with the inputs that it
+        /// read and the time spent in it (not including the time spent in the
+        /// memoized calls that it made).
+        fn execute<R>(&self, f: impl FnOnce() -> R) -> (R, InputSet, Duration) {
+            let start = Instant::now();
+            self.active_calls.borrow_mut().push(ActiveCall::default());
+            let result = f();
+            let mut active_calls = self.active_calls.borrow_mut();
+            let call = active_calls.pop().unwrap();
+            let time = start.elapsed();
+            if let Some(caller) = active_calls.last_mut() {
+                caller.callee_time += time;
+            }
+            (result, call.reads, time.saturating_sub(call.callee_time))
+        }
+    }
+
+    struct Memo<Return> {
+        value: Return,
+        /// The inputs that were (transitively) read to compute `value`.
+        inputs: InputSet,
+        /// The latest revision in which `value` is known to be up to date.
+        verified_at: Cell<Revision>,
+    }
+
     pub struct MemoizationTable<Args, Return>
     where
         Args: Clone + Eq + Hash,
         Return: Clone,
     {
-        memoized: RefCell<HashMap<Args, Return>>,
+        memoized: RefCell<HashMap<Args, Memo<Return>>>,
         active: RefCell<HashSet<Args>>,
+        hits: Cell<u64>,
+        misses: Cell<u64>,
+        compute_time: Cell<Duration>,
     }
 
     // Separate `impl` instead of `#[derive(Default)]` because the `derive` would
@@ -262,7 +477,13 @@ pub mod internal {
         Return: Clone,
     {
         fn default() -> Self {
-            Self { memoized: RefCell::new(HashMap::new()), active: RefCell::new(HashSet::new()) }
+            Self {
+                memoized: RefCell::new(HashMap::new()),
+                active: RefCell::new(HashSet::new()),
+                hits: Cell::new(0),
+                misses: Cell::new(0),
+                compute_time: Cell::new(Duration::ZERO),
+            }
         }
     }
 
@@ -271,24 +492,49 @@ pub mod internal {
         Args: Clone + Eq + Hash,
         Return: Clone,
     {
-        pub fn internal_memoized_call<F>(&self, args: Args, f: F) -> Return
+        pub fn internal_memoized_call<F>(&self, runtime: &Runtime, args: Args, f: F) -> Return
         where
             F: FnOnce(Args) -> Return,
         {
-            if let Some(return_value) = self.memoized.borrow().get(&args) {
-                return return_value.clone();
+            if let Some(memo) = self.memoized.borrow().get(&args) {
+                if runtime.is_up_to_date(memo.inputs, memo.verified_at.get()) {
+                    memo.verified_at.set(runtime.revision);
+                    runtime.report_reads(memo.inputs);
+                    self.hits.set(self.hits.get() + 1);
+                    return memo.value.clone();
+                }
             }
             if self.active.borrow().contains(&args) {
                 panic!("Cycle detected: a memoized function depends on its own return value");
             }
             let args_cloned = args.clone();
             self.active.borrow_mut().insert(args_cloned);
-            let return_value = f(args.clone());
+            let (return_value, inputs, time) = runtime.execute(|| f(args.clone()));
             self.active.borrow_mut().remove(&args);
-            let return_value_cloned = return_value.clone();
-            self.memoized.borrow_mut().insert(args, return_value_cloned);
+            self.misses.set(self.misses.get() + 1);
+            self.compute_time.set(self.compute_time.get() + time);
+            runtime.report_reads(inputs);
+            let memo = Memo {
+                value: return_value.clone(),
+                inputs,
+                verified_at: Cell::new(runtime.revision),
+            };
+            self.memoized.borrow_mut().insert(args, memo);
             return_value
         }
+
+        pub fn stats(&self, name: &'static str) -> crate::QueryStats {
+            let memoized = self.memoized.borrow();
+            crate::QueryStats {
+                name,
+                hits: self.hits.get(),
+                misses: self.misses.get(),
+                compute_time: self.compute_time.get(),
+                entries: memoized.len(),
+                approximate_bytes: memoized.capacity()
+                    * (std::mem::size_of::<Args>() + std::mem::size_of::<Memo<Return>>()),
+            }
+        }
     }
 }
 
@@ -450,4 +696,112 @@ pub mod tests {
         assert_eq!(db.call_counter().get(), 1);
         assert!(Rc::ptr_eq(&argless_return, &argless_return_2));
     }
+
+    #[test]
+    fn test_set_input() {
+        crate::query_group! {
+          pub trait Offsets {
+            #[input]
+            fn call_counter(&self) -> Rc<Cell<i32>>;
+            #[input(set_offset)]
+            fn offset(&self) -> i32;
+            #[input(set_unrelated)]
+            fn unrelated(&self) -> i32;
+            fn add_offset(&self, arg: i32) -> i32;
+          }
+          pub struct Database;
+        }
+        fn add_offset(db: &dyn Offsets, arg: i32) -> i32 {
+            db.call_counter().set(db.call_counter().get() + 1);
+            arg + db.offset()
+        }
+        let mut db = Database::new(Rc::new(Cell::new(0)), 10, 0);
+
+        assert_eq!(db.add_offset(100), 110);
+        assert_eq!(db.call_counter().get(), 1);
+
+        // `add_offset` doesn't read `unrelated`, so it isn't recomputed.
+        db.set_unrelated(1);
+        assert_eq!(db.unrelated(), 1);
+        assert_eq!(db.add_offset(100), 110);
+        assert_eq!(db.call_counter().get(), 1);
+
+        db.set_offset(20);
+        assert_eq!(db.add_offset(100), 120);
+        assert_eq!(db.call_counter().get(), 2);
+
+        assert_eq!(db.add_offset(100), 120);
+        assert_eq!(db.call_counter().get(), 2);
+    }
+
+    /// The inputs read by a memoized function include those read by the
+    /// memoized functions that it calls, even when their values are cached.
+    #[test]
+    fn test_set_input_transitive() {
+        crate::query_group! {
+          pub trait Offsets {
+            #[input]
+            fn call_counter(&self) -> Rc<Cell<i32>>;
+            #[input(set_offset)]
+            fn offset(&self) -> i32;
+            fn add_offset(&self, arg: i32) -> i32;
+            fn add_offset_twice(&self, arg: i32) -> i32;
+          }
+          pub struct Database;
+        }
+        fn add_offset(db: &dyn Offsets, arg: i32) -> i32 {
+            db.call_counter().set(db.call_counter().get() + 1);
+            arg + db.offset()
+        }
+        fn add_offset_twice(db: &dyn Offsets, arg: i32) -> i32 {
+            db.call_counter().set(db.call_counter().get() + 1);
+            db.add_offset(db.add_offset(arg) - db.offset()) + db.add_offset(0)
+        }
+        let mut db = Database::new(Rc::new(Cell::new(0)), 10);
+
+        assert_eq!(db.add_offset(0), 10);
+        assert_eq!(db.call_counter().get(), 1);
+        // `add_offset(0)` is cached, but `add_offset_twice(5)` still depends on `offset`.
+        assert_eq!(db.add_offset_twice(5), 25);
+        assert_eq!(db.call_counter().get(), 3);
+
+        db.set_offset(100);
+        assert_eq!(db.add_offset_twice(5), 205);
+        assert_eq!(db.call_counter().get(), 6);
+    }
+
+    #[test]
+    fn test_query_stats() {
+        crate::query_group! {
+          pub trait Add10 {
+            fn add10(&self, arg: i32) -> i32;
+            fn add20(&self, arg: i32) -> i32;
+          }
+          pub struct Database;
+        }
+        fn add10(_db: &dyn Add10, arg: i32) -> i32 {
+            arg + 10
+        }
+        fn add20(db: &dyn Add10, arg: i32) -> i32 {
+            db.add10(db.add10(arg))
+        }
+        let db = Database::new();
+
+        assert_eq!(db.add20(0), 20);
+        assert_eq!(db.add20(0), 20);
+        assert_eq!(db.add10(0), 10);
+
+        let stats = db.query_stats();
+        assert_eq!(stats.len(), 2);
+        let (add10_stats, add20_stats) = (&stats[0], &stats[1]);
+        assert_eq!(add10_stats.name, "add10");
+        assert_eq!((add10_stats.hits, add10_stats.misses, add10_stats.entries), (1, 2, 2));
+        assert_eq!(add20_stats.name, "add20");
+        assert_eq!((add20_stats.hits, add20_stats.misses, add20_stats.entries), (1, 1, 1));
+        assert!(add10_stats.approximate_bytes >= 2 * std::mem::size_of::<(i32, i32)>());
+
+        let table = crate::format_query_stats(&stats);
+        assert_eq!(table.lines().count(), 3);
+        assert!(table.starts_with("query "), "{table}");
+    }
 }
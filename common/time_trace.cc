@@ -0,0 +1,82 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "common/time_trace.h"
+
+#include <mutex>  // NOLINT(build/c++11)
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/ffi_types.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/TimeProfiler.h"
+
+namespace crubit {
+namespace {
+
+// The arguments of `StartTimeTrace`, for the other threads that record spans.
+struct TraceConfig {
+  std::string process_name;
+  unsigned granularity_us;
+};
+
+std::mutex trace_config_mutex;
+std::optional<TraceConfig> trace_config;
+
+llvm::StringRef StringRefFromFfiU8Slice(FfiU8Slice slice) {
+  return llvm::StringRef(slice.ptr, slice.size);
+}
+
+}  // namespace
+
+void StartTimeTrace(absl::string_view process_name, unsigned granularity_us) {
+  std::lock_guard<std::mutex> lock(trace_config_mutex);
+  trace_config = TraceConfig{.process_name = std::string(process_name),
+                             .granularity_us = granularity_us};
+  llvm::timeTraceProfilerInitialize(granularity_us,
+                                    trace_config->process_name);
+}
+
+absl::Status FinishTimeTrace(absl::string_view path) {
+  std::lock_guard<std::mutex> lock(trace_config_mutex);
+  trace_config.reset();
+  llvm::Error error = llvm::timeTraceProfilerWrite(
+      llvm::StringRef(path.data(), path.size()), /*FallbackFileName=*/"");
+  llvm::timeTraceProfilerCleanup();
+  if (error) {
+    return absl::InternalError(absl::StrCat("Failed to write the time trace: ",
+                                            llvm::toString(std::move(error))));
+  }
+  return absl::OkStatus();
+}
+
+extern "C" void CrubitTimeTraceBegin(FfiU8Slice name, FfiU8Slice detail) {
+  if (!llvm::timeTraceProfilerEnabled()) return;
+  llvm::timeTraceProfilerBegin(StringRefFromFfiU8Slice(name),
+                               StringRefFromFfiU8Slice(detail));
+}
+
+extern "C" void CrubitTimeTraceEnd() {
+  if (!llvm::timeTraceProfilerEnabled()) return;
+  llvm::timeTraceProfilerEnd();
+}
+
+extern "C" void CrubitTimeTraceStartThread() {
+  std::lock_guard<std::mutex> lock(trace_config_mutex);
+  if (!trace_config.has_value()) return;
+  llvm::timeTraceProfilerInitialize(trace_config->granularity_us,
+                                    trace_config->process_name);
+}
+
+extern "C" void CrubitTimeTraceFinishThread() {
+  if (!llvm::timeTraceProfilerEnabled()) return;
+  llvm::timeTraceProfilerFinishThread();
+}
+
+}  // namespace crubit
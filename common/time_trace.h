@@ -0,0 +1,45 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_COMMON_TIME_TRACE_H_
+#define CRUBIT_COMMON_TIME_TRACE_H_
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "common/ffi_types.h"
+
+namespace crubit {
+
+// Starts recording a trace of the spans that last at least `granularity_us`
+// microseconds, in the style of Clang's `-ftime-trace`. The spans are begun
+// with `llvm::TimeTraceScope` in C++ (which Clang itself uses, too) and with
+// `time_trace::scope` in Rust (see common/time_trace.rs), on the current
+// thread and on the threads started with `time_trace::in_thread`.
+void StartTimeTrace(absl::string_view process_name,
+                    unsigned granularity_us = 500);
+
+// Stops recording the trace started by `StartTimeTrace` and writes it to
+// `path` in the Chrome trace event format.
+absl::Status FinishTimeTrace(absl::string_view path);
+
+// The following functions are called from Rust (see common/time_trace.rs).
+// They do nothing if no trace is being recorded.
+
+// Begins a span on the current thread.
+extern "C" void CrubitTimeTraceBegin(FfiU8Slice name, FfiU8Slice detail);
+
+// Ends the span last begun on the current thread.
+extern "C" void CrubitTimeTraceEnd();
+
+// Starts recording the spans of the current thread, which must not be the
+// thread that called `StartTimeTrace`, if a trace is being recorded.
+extern "C" void CrubitTimeTraceStartThread();
+
+// Hands the spans of the current thread over to the trace, before the thread
+// exits.
+extern "C" void CrubitTimeTraceFinishThread();
+
+}  // namespace crubit
+
+#endif  // CRUBIT_COMMON_TIME_TRACE_H_
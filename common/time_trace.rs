@@ -0,0 +1,75 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! Spans of the time trace started by `StartTimeTrace` (see
+//! common/time_trace.h). They are recorded by LLVM's `TimeTraceProfiler`,
+//! together with the spans of the C++ code that calls into Rust, so that a
+//! single trace covers both. Outside of a trace, they do nothing.
+
+use ffi_types::FfiU8Slice;
+
+extern "C" {
+    fn CrubitTimeTraceBegin(name: FfiU8Slice, detail: FfiU8Slice);
+    fn CrubitTimeTraceEnd();
+    fn CrubitTimeTraceStartThread();
+    fn CrubitTimeTraceFinishThread();
+}
+
+/// A span of the time trace, which ends when it is dropped.
+#[must_use = "the span ends when it is dropped"]
+pub struct TimeTraceScope {
+    // Spans end on the thread that began them.
+    _not_send: std::marker::PhantomData<*const ()>,
+}
+
+impl Drop for TimeTraceScope {
+    fn drop(&mut self) {
+        // SAFETY: the span was begun on this thread by `scope`.
+        unsafe { CrubitTimeTraceEnd() }
+    }
+}
+
+/// Begins a span named `name`, which ends when the returned value is dropped.
+pub fn scope(name: &str) -> TimeTraceScope {
+    scope_with_detail(name, "")
+}
+
+/// Like `scope`, with `detail` (e.g. the name of the file being processed)
+/// shown with the span.
+pub fn scope_with_detail(name: &str, detail: &str) -> TimeTraceScope {
+    // SAFETY: the slices are only borrowed during the call.
+    unsafe {
+        CrubitTimeTraceBegin(
+            FfiU8Slice::from_slice(name.as_bytes()),
+            FfiU8Slice::from_slice(detail.as_bytes()),
+        )
+    };
+    TimeTraceScope { _not_send: std::marker::PhantomData }
+}
+
+/// Runs `f`, on a thread other than the one that started the trace, recording
+/// the spans it begins.
+pub fn in_thread<R>(f: impl FnOnce() -> R) -> R {
+    // SAFETY: the spans of the thread are handed over before it exits, once
+    // they have all ended.
+    unsafe { CrubitTimeTraceStartThread() };
+    let result = f();
+    unsafe { CrubitTimeTraceFinishThread() };
+    result
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_spans_without_trace() {
+        let result = in_thread(|| {
+            let _outer = scope("outer");
+            let _inner = scope_with_detail("inner", "detail");
+            42
+        });
+        assert_eq!(result, 42);
+    }
+}
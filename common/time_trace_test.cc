@@ -0,0 +1,83 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "common/time_trace.h"
+
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "common/ffi_types.h"
+#include "common/file_io.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::Contains;
+using ::testing::IsSupersetOf;
+using ::testing::Not;
+
+// Returns the names of the complete events ("X") in `trace`.
+std::vector<std::string> SpanNames(const llvm::json::Value& trace) {
+  std::vector<std::string> names;
+  for (const llvm::json::Value& event :
+       *trace.getAsObject()->getArray("traceEvents")) {
+    const llvm::json::Object* object = event.getAsObject();
+    if (object->getString("ph") == llvm::StringRef("X")) {
+      names.push_back(object->getString("name")->str());
+    }
+  }
+  return names;
+}
+
+TEST(TimeTraceTest, RecordsSpansOfAllThreads) {
+  std::string path = absl::StrCat(testing::TempDir(), "/all_threads.json");
+  StartTimeTrace("time_trace_test", /*granularity_us=*/0);
+  CrubitTimeTraceBegin(MakeFfiU8Slice("main thread"), MakeFfiU8Slice(""));
+  std::thread thread([] {
+    CrubitTimeTraceStartThread();
+    CrubitTimeTraceBegin(MakeFfiU8Slice("other thread"),
+                         MakeFfiU8Slice("detail"));
+    CrubitTimeTraceEnd();
+    CrubitTimeTraceFinishThread();
+  });
+  thread.join();
+  CrubitTimeTraceEnd();
+  ASSERT_TRUE(FinishTimeTrace(path).ok());
+
+  absl::StatusOr<std::string> json = GetFileContents(path);
+  ASSERT_TRUE(json.ok()) << json.status();
+  llvm::Expected<llvm::json::Value> trace = llvm::json::parse(*json);
+  ASSERT_TRUE(static_cast<bool>(trace)) << llvm::toString(trace.takeError());
+  EXPECT_THAT(SpanNames(*trace), IsSupersetOf({"main thread", "other thread"}));
+}
+
+TEST(TimeTraceTest, NoSpansOutsideOfTrace) {
+  CrubitTimeTraceBegin(MakeFfiU8Slice("before"), MakeFfiU8Slice(""));
+  CrubitTimeTraceEnd();
+
+  std::string path = absl::StrCat(testing::TempDir(), "/outside.json");
+  StartTimeTrace("time_trace_test", /*granularity_us=*/0);
+  ASSERT_TRUE(FinishTimeTrace(path).ok());
+  CrubitTimeTraceStartThread();
+  CrubitTimeTraceBegin(MakeFfiU8Slice("after"), MakeFfiU8Slice(""));
+  CrubitTimeTraceEnd();
+  CrubitTimeTraceFinishThread();
+
+  absl::StatusOr<std::string> json = GetFileContents(path);
+  ASSERT_TRUE(json.ok()) << json.status();
+  llvm::Expected<llvm::json::Value> trace = llvm::json::parse(*json);
+  ASSERT_TRUE(static_cast<bool>(trace)) << llvm::toString(trace.takeError());
+  EXPECT_THAT(SpanNames(*trace), Not(Contains("before")));
+}
+
+}  // namespace
+}  // namespace crubit
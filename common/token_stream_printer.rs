@@ -4,7 +4,10 @@
 
 use anyhow::{bail, Result};
 use proc_macro2::{Delimiter, TokenStream, TokenTree};
+use std::collections::hash_map::DefaultHasher;
 use std::ffi::{OsStr, OsString};
+use std::fmt::Write as _;
+use std::hash::{Hash, Hasher};
 use std::io::Write as _;
 use std::path::{Path, PathBuf};
 use std::process::{Command, Stdio};
@@ -18,6 +21,10 @@ pub struct RustfmtConfig {
 
     /// Cmdline arguments to be passed to the `rustfmt` executable.
     cmdline_args: Vec<OsString>,
+
+    /// Path to the `rustfmt.toml` file, if any, whose contents are part of the
+    /// key under which formatted output is cached.
+    config_path: Option<PathBuf>,
 }
 
 pub const RUSTFMT_EXE_PATH_FOR_TESTING: &str =
@@ -38,6 +45,7 @@ impl RustfmtConfig {
                 None => Self::default_cmdline_args(),
                 Some(path) => Self::cmdline_args_with_custom_config_path(path),
             },
+            config_path: rustfmt_config_path.map(Path::to_path_buf),
         }
     }
 
@@ -45,6 +53,7 @@ impl RustfmtConfig {
         Self {
             exe_path: PathBuf::from(RUSTFMT_EXE_PATH_FOR_TESTING),
             cmdline_args: Self::default_cmdline_args(),
+            config_path: None,
         }
     }
 
@@ -103,6 +112,28 @@ pub fn cc_tokens_to_formatted_string_for_tests(tokens: TokenStream) -> Result<St
     clang_format(tokens_to_string(tokens)?, Path::new(CLANG_FORMAT_EXE_PATH_FOR_TESTING))
 }
 
+/// Like `rs_tokens_to_formatted_string` and `cc_tokens_to_formatted_string`
+/// combined, but running `rustfmt` and `clang-format` concurrently, so that
+/// formatting takes as long as the slower of the two rather than their sum.
+pub fn rs_and_cc_tokens_to_formatted_strings(
+    rs_tokens: TokenStream,
+    rustfmt_config: &RustfmtConfig,
+    cc_tokens: TokenStream,
+    clang_format_exe_path: &Path,
+) -> Result<(String, String)> {
+    // `TokenStream` is not `Send`, so only the unformatted strings are handed to
+    // the other thread.
+    let rs_unformatted = tokens_to_string(rs_tokens)?;
+    let cc_unformatted = tokens_to_string(cc_tokens)?;
+    std::thread::scope(|scope| {
+        let rs_formatted =
+            scope.spawn(|| time_trace::in_thread(|| rustfmt(rs_unformatted, rustfmt_config)));
+        let cc_formatted = clang_format(cc_unformatted, clang_format_exe_path);
+        let rs_formatted = rs_formatted.join().expect("rustfmt thread panicked");
+        Ok((rs_formatted?, cc_formatted?))
+    })
+}
+
 /// Produces source code out of the token stream.
 ///
 /// Notable features:
@@ -123,67 +154,175 @@ pub fn write_unformatted_tokens(
     result: &mut impl std::fmt::Write,
     tokens: TokenStream,
 ) -> Result<()> {
-    let mut it = tokens.into_iter().peekable();
-    let mut tt_prev = None;
-    while let Some(tt) = it.next() {
-        match tt {
-            TokenTree::Ident(ref tt) if tt == "__NEWLINE__" => writeln!(result)?,
-            TokenTree::Ident(ref tt) if tt == "__SPACE__" => write!(result, " ")?,
-            TokenTree::Ident(ref tt) if tt == "__HASH_TOKEN__" => write!(result, "#")?,
-
-            TokenTree::Ident(ref tt) if tt == "__COMMENT__" => {
-                if let Some(TokenTree::Literal(lit)) = it.next() {
-                    writeln!(
-                        result,
-                        "// {}",
-                        lit.to_string().trim_matches('"').replace("\\n", "\n// ")
-                    )?;
-                } else {
-                    bail!("__COMMENT__ must be followed by a literal")
+    Printer::new(result, /* line_breaks= */ false).write_tokens(tokens, true)
+}
+
+fn tokens_to_string(tokens: TokenStream) -> Result<String> {
+    let mut result = String::new();
+    write_unformatted_tokens(&mut result, tokens)?;
+    Ok(result)
+}
+
+/// Like `tokens_to_string`, but also breaking the lines after `;`, `{` and `}`
+/// (except inside parentheses, brackets and preprocessor directives), so that
+/// the output can be read and diffed line by line without being formatted.
+///
+/// This is for bindings that nobody reads, where running `rustfmt` and
+/// `clang-format` would be wasted time. The output is deterministic, but
+/// changes with the formatting of the token stream (e.g. an added
+/// `__NEWLINE__`), which the formatters would have normalized.
+pub fn tokens_to_unformatted_string(tokens: TokenStream) -> Result<String> {
+    let mut result = String::new();
+    Printer::new(&mut result, /* line_breaks= */ true).write_tokens(tokens, true)?;
+    Ok(result)
+}
+
+/// Writes token streams into `out` (see `write_unformatted_tokens`).
+struct Printer<'a, W: std::fmt::Write> {
+    out: &'a mut W,
+    /// Whether to break the lines after statements and braces.
+    line_breaks: bool,
+    /// Whether the output is inside a `__HASH_TOKEN__` preprocessor directive,
+    /// which would be ended by a line break.
+    in_directive: bool,
+    at_line_start: bool,
+    /// Whether the last thing written was a line break added by `line_break`,
+    /// which takes the place of the next `__NEWLINE__` (so that `;
+    /// __NEWLINE__` doesn't become a blank line).
+    after_line_break: bool,
+}
+
+impl<'a, W: std::fmt::Write> Printer<'a, W> {
+    fn new(out: &'a mut W, line_breaks: bool) -> Self {
+        Self { out, line_breaks, in_directive: false, at_line_start: true, after_line_break: false }
+    }
+
+    fn breaks_lines(&self) -> bool {
+        self.line_breaks && !self.in_directive
+    }
+
+    fn line_break(&mut self) -> std::fmt::Result {
+        if self.breaks_lines() && !self.at_line_start {
+            self.write_char('\n')?;
+            self.after_line_break = true;
+        }
+        Ok(())
+    }
+
+    /// Writes `tokens`. `in_statements` is whether they are at the top level or
+    /// directly inside braces (rather than inside parentheses or brackets), i.e.
+    /// whether lines can be broken after their `;` and `}`.
+    fn write_tokens(&mut self, tokens: TokenStream, in_statements: bool) -> Result<()> {
+        let mut it = tokens.into_iter().peekable();
+        // Whether the previous token was the first `:` of a `::` - which is all that
+        // `tokens_require_whitespace` needs to know about it.
+        let mut prev_is_joint_colon = false;
+        while let Some(tt) = it.next() {
+            let is_joint_colon =
+                get_colon(&tt).is_some_and(|colon| colon.spacing() == proc_macro2::Spacing::Joint);
+            match tt {
+                TokenTree::Ident(ref tt) if tt == "__NEWLINE__" => {
+                    if !std::mem::take(&mut self.after_line_break) {
+                        self.write_char('\n')?;
+                    }
                 }
-            }
-            TokenTree::Group(ref tt) => {
-                let (open_delimiter, closed_delimiter) = match tt.delimiter() {
-                    Delimiter::Parenthesis => ("(", ")"),
-                    Delimiter::Bracket => ("[", "]"),
-                    Delimiter::Brace => ("{ ", " }"),
-                    Delimiter::None => ("", ""),
-                };
-                write!(result, "{}", open_delimiter)?;
-                write_unformatted_tokens(result, tt.stream())?;
-                write!(result, "{}", closed_delimiter)?;
-            }
-            _ => {
-                write!(result, "{}", tt)?;
-
-                // Insert spaces between tokens when they are needed to separate tokens.
-                // In particular, `a b` is different than `ab`, and `: ::` is different from
-                // `:::`.
-                if let Some(tt_next) = it.peek() {
-                    if tokens_require_whitespace(tt_prev.as_ref(), &tt, tt_next) {
-                        write!(result, " ")?;
+                TokenTree::Ident(ref tt) if tt == "__SPACE__" => self.write_char(' ')?,
+                TokenTree::Ident(ref tt) if tt == "__HASH_TOKEN__" => {
+                    self.write_char('#')?;
+                    self.in_directive = true;
+                }
+
+                TokenTree::Ident(ref tt) if tt == "__COMMENT__" => {
+                    if let Some(TokenTree::Literal(lit)) = it.next() {
+                        let lit = lit.to_string();
+                        for (i, line) in lit.trim_matches('"').split("\\n").enumerate() {
+                            self.write_str(if i == 0 { "// " } else { "\n// " })?;
+                            self.write_str(line)?;
+                        }
+                        self.write_char('\n')?;
+                    } else {
+                        bail!("__COMMENT__ must be followed by a literal")
+                    }
+                }
+                TokenTree::Group(group) => {
+                    let delimiter = group.delimiter();
+                    // `Group::stream` shares the tokens with the group, and iterating over a
+                    // shared stream copies all of its tokens. Dropping the group first lets the
+                    // iteration move them out instead.
+                    let stream = group.stream();
+                    drop(group);
+                    match delimiter {
+                        Delimiter::Parenthesis => {
+                            self.write_char('(')?;
+                            self.write_tokens(stream, false)?;
+                            self.write_char(')')?;
+                        }
+                        Delimiter::Bracket => {
+                            self.write_char('[')?;
+                            self.write_tokens(stream, false)?;
+                            self.write_char(']')?;
+                        }
+                        Delimiter::Brace if self.breaks_lines() => {
+                            self.write_char('{')?;
+                            self.line_break()?;
+                            self.write_tokens(stream, true)?;
+                            self.line_break()?;
+                            self.write_char('}')?;
+                            if in_statements {
+                                self.line_break()?;
+                            }
+                        }
+                        Delimiter::Brace => {
+                            self.write_str("{ ")?;
+                            self.write_tokens(stream, true)?;
+                            self.write_str(" }")?;
+                        }
+                        Delimiter::None => self.write_tokens(stream, in_statements)?,
+                    }
+                }
+                _ => {
+                    write!(self, "{}", tt)?;
+
+                    // Insert spaces between tokens when they are needed to separate tokens.
+                    // In particular, `a b` is different than `ab`, and `: ::` is different from
+                    // `:::`.
+                    if let Some(tt_next) = it.peek() {
+                        if tokens_require_whitespace(prev_is_joint_colon, &tt, tt_next) {
+                            self.write_char(' ')?;
+                        }
+                    }
+                    if in_statements && matches!(&tt, TokenTree::Punct(p) if p.as_char() == ';') {
+                        self.line_break()?;
                     }
                 }
             }
+            prev_is_joint_colon = is_joint_colon;
         }
-        tt_prev = Some(tt);
+        Ok(())
     }
-    Ok(())
 }
 
-fn tokens_to_string(tokens: TokenStream) -> Result<String> {
-    let mut result = String::new();
-    write_unformatted_tokens(&mut result, tokens)?;
-    Ok(result)
+impl<W: std::fmt::Write> std::fmt::Write for Printer<'_, W> {
+    fn write_str(&mut self, s: &str) -> std::fmt::Result {
+        if let Some(last) = s.as_bytes().last() {
+            self.after_line_break = false;
+            self.at_line_start = *last == b'\n';
+            if self.at_line_start {
+                self.in_directive = false;
+            }
+        }
+        self.out.write_str(s)
+    }
 }
 
 /// Returns true if `current` and `next` should have whitespace between them,
-/// and false if they should not.
+/// and false if they should not. `prev_is_joint_colon` is whether the token
+/// before `current` is the first `:` of a `::`.
 ///
 /// For example, `a b` is different than `ab`, and `: ::` is different from
 /// `:::`.
 fn tokens_require_whitespace(
-    prev: Option<&TokenTree>,
+    prev_is_joint_colon: bool,
     current: &TokenTree,
     next: &TokenTree,
 ) -> bool {
@@ -195,16 +334,6 @@ fn tokens_require_whitespace(
     // A lone `:` always gets a space after it. A lone `::` doesn't.
     // So if the current character is a colon, it gets a space after it if it is not
     // the start or end of a `::`.
-    fn get_colon(tt: &TokenTree) -> Option<&proc_macro2::Punct> {
-        let TokenTree::Punct(p) = tt else {
-            return None;
-        };
-        if p.as_char() != ':' {
-            return None;
-        }
-        Some(p)
-    }
-
     let Some(current_colon) = get_colon(current) else {
         return false;
     };
@@ -212,16 +341,25 @@ fn tokens_require_whitespace(
         // This is the first `:` in `::`
         return false;
     }
-    match prev.and_then(get_colon) {
+    if prev_is_joint_colon {
         // this is the second `:` in `::`
-        Some(prev_colon) if prev_colon.spacing() == proc_macro2::Spacing::Joint => {
-            // a `::` shouldn't have a space after it, generally, but we add one if the next
-            // token is a `:` because otherwise it looks awful.
-            get_colon(next).is_some()
-        }
+        // a `::` shouldn't have a space after it, generally, but we add one if the next
+        // token is a `:` because otherwise it looks awful.
+        get_colon(next).is_some()
+    } else {
         // this is a standalone `:`.
-        _ => true,
+        true
+    }
+}
+
+fn get_colon(tt: &TokenTree) -> Option<&proc_macro2::Punct> {
+    let TokenTree::Punct(p) = tt else {
+        return None;
+    };
+    if p.as_char() != ':' {
+        return None;
     }
+    Some(p)
 }
 
 fn is_ident_or_literal(tt: &TokenTree) -> bool {
@@ -232,14 +370,108 @@ fn is_ident_or_literal(tt: &TokenTree) -> bool {
     }
 }
 
+/// Environment variable naming a directory in which formatted output is cached,
+/// so that formatting the same input again (e.g. when regenerating the bindings
+/// of an unchanged target) doesn't launch the formatter. Caching is disabled if
+/// it is unset.
+pub const FORMAT_CACHE_DIR_ENV_VAR: &str = "CRUBIT_FORMAT_CACHE_DIR";
+
+/// Returns the name of the file in which the output of running `exe_path` with
+/// `args` on `input` is cached.
+///
+/// The key covers everything the output depends on: the formatter binary
+/// (identified by its path, size, and modification time, so that updating the
+/// toolchain invalidates the cache), its arguments, the contents of its
+/// `config_files`, and the input.
+fn format_cache_file_name(
+    exe_path: &Path,
+    args: &[&OsStr],
+    config_files: &[&Path],
+    input: &str,
+) -> Option<String> {
+    let exe_metadata = std::fs::metadata(exe_path).ok()?;
+    let mut config_contents = Vec::new();
+    for path in config_files {
+        config_contents.push(std::fs::read(path).ok()?);
+    }
+    // `DefaultHasher` is deterministic for a given build of the formatter's
+    // caller, but only 64 bits wide, so two differently-salted hashes are
+    // combined to make collisions negligible.
+    let hash = |salt: u8| {
+        let mut hasher = DefaultHasher::new();
+        salt.hash(&mut hasher);
+        exe_path.hash(&mut hasher);
+        exe_metadata.len().hash(&mut hasher);
+        exe_metadata.modified().ok().hash(&mut hasher);
+        args.hash(&mut hasher);
+        config_contents.hash(&mut hasher);
+        input.hash(&mut hasher);
+        hasher.finish()
+    };
+    Some(format!("{:016x}{:016x}", hash(0), hash(1)))
+}
+
 fn pipe_string_through_process<'a>(
     input: String,
     exe_name: &str,
     exe_path: &Path,
     args: impl IntoIterator<Item = &'a OsStr>,
+    config_files: &[&Path],
+) -> Result<String> {
+    let cache_dir = std::env::var_os(FORMAT_CACHE_DIR_ENV_VAR).map(PathBuf::from);
+    pipe_string_through_process_with_cache(
+        input,
+        exe_name,
+        exe_path,
+        args,
+        config_files,
+        cache_dir.as_deref(),
+    )
+}
+
+/// Like `pipe_string_through_process`, but reading and writing cached output in
+/// `cache_dir` if it is given.
+fn pipe_string_through_process_with_cache<'a>(
+    input: String,
+    exe_name: &str,
+    exe_path: &Path,
+    args: impl IntoIterator<Item = &'a OsStr>,
+    config_files: &[&Path],
+    cache_dir: Option<&Path>,
+) -> Result<String> {
+    let args: Vec<&OsStr> = args.into_iter().collect();
+    let cache_path = cache_dir.and_then(|dir| {
+        format_cache_file_name(exe_path, &args, config_files, &input).map(|name| dir.join(name))
+    });
+    if let Some(cache_path) = &cache_path {
+        if let Ok(output) = std::fs::read_to_string(cache_path) {
+            return Ok(output);
+        }
+    }
+    let output = run_process(input, exe_name, exe_path, args)?;
+    if let Some(cache_path) = &cache_path {
+        // Write to a temporary file first so that concurrent readers never see a
+        // partially-written entry. The cache is only an optimization, so failing
+        // to write it is not an error.
+        let tmp_path = cache_path.with_extension(format!("tmp{}", std::process::id()));
+        if std::fs::create_dir_all(cache_path.parent().unwrap()).is_ok()
+            && std::fs::write(&tmp_path, &output).is_ok()
+            && std::fs::rename(&tmp_path, cache_path).is_err()
+        {
+            let _ = std::fs::remove_file(&tmp_path);
+        }
+    }
+    Ok(output)
+}
+
+fn run_process(
+    input: String,
+    exe_name: &str,
+    exe_path: &Path,
+    args: Vec<&OsStr>,
 ) -> Result<String> {
     let mut child = Command::new(exe_path)
-        .args(args.into_iter())
+        .args(args)
         .stdin(Stdio::piped())
         .stdout(Stdio::piped())
         .stderr(Stdio::piped())
@@ -262,20 +494,24 @@ fn pipe_string_through_process<'a>(
 }
 
 fn rustfmt(input: String, config: &RustfmtConfig) -> Result<String> {
+    let _span = time_trace::scope("rustfmt");
     pipe_string_through_process(
         input,
         "rustfmt",
         &config.exe_path,
         config.cmdline_args.iter().map(OsString::as_os_str),
+        config.config_path.as_deref().as_slice(),
     )
 }
 
 fn clang_format(input: String, clang_format_exe_path: &Path) -> Result<String> {
+    let _span = time_trace::scope("clang-format");
     pipe_string_through_process(
         input,
         "clang-format",
         clang_format_exe_path,
         [OsStr::new("--style=google")],
+        &[],
     )
 }
 
@@ -419,6 +655,65 @@ mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_nested_groups() -> Result<()> {
+        assert_eq!(
+            tokens_to_string(quote! { f(a[b { c :: d : e }], (x : :: y)) })?,
+            "f(a[b{ c::d: e }],(x: ::y))"
+        );
+        // The stream of a group that is still alive elsewhere is printed without being consumed.
+        let group = quote! { (a b) };
+        let tokens = quote! { #group #group };
+        assert_eq!(tokens_to_string(tokens)?, "(a b)(a b)");
+        assert_eq!(tokens_to_string(group)?, "(a b)");
+        Ok(())
+    }
+
+    #[test]
+    fn test_unformatted_string() -> Result<()> {
+        let tokens = quote! {
+            struct S { x: [u8; 4] }
+            impl S {
+                fn f(&self) -> i32 { let a = 1; for _ in (0..1) { g(|| { h(); }); } a }
+            }
+        };
+        assert_eq!(
+            tokens_to_unformatted_string(tokens)?,
+            "struct S{\nx: [u8;4]\n}\nimpl S{\nfn f(&self)->i32{\nlet a=1;\n\
+             for _ in(0..1){\ng(||{\nh();\n});\n}\na\n}\n}\n"
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn test_unformatted_string_preprocessor_directives() -> Result<()> {
+        let tokens = quote! {
+            __HASH_TOKEN__ define X { a; } __NEWLINE__
+            namespace n { __HASH_TOKEN__ pragma once __NEWLINE__ int x; }
+        };
+        assert_eq!(
+            tokens_to_unformatted_string(tokens)?,
+            "#define X{ a; }\nnamespace n{\n#pragma once\nint x;\n}\n"
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn test_unformatted_string_no_blank_lines() -> Result<()> {
+        let tokens = quote! { a; __NEWLINE__ __COMMENT__ "c" b {} };
+        assert_eq!(tokens_to_unformatted_string(tokens)?, "a;\n// c\nb{\n}\n");
+        Ok(())
+    }
+
+    #[test]
+    fn test_multiline_comment_in_group() -> Result<()> {
+        assert_eq!(
+            tokens_to_string(quote! {{ __COMMENT__ "a\nb\nc" x }})?,
+            "{ // a\n// b\n// c\nx }"
+        );
+        Ok(())
+    }
+
     #[test]
     fn test_rs_tokens_to_formatted_string_for_tests() {
         let input = quote! {
@@ -484,6 +779,62 @@ fn foo(
         Ok(())
     }
 
+    #[test]
+    fn test_rs_and_cc_tokens_to_formatted_strings() {
+        let (rs_api, rs_api_impl) = rs_and_cc_tokens_to_formatted_strings(
+            quote! { fn foo() {} },
+            &RustfmtConfig::for_testing(),
+            quote! { void foo() {} },
+            Path::new(CLANG_FORMAT_EXE_PATH_FOR_TESTING),
+        )
+        .unwrap();
+        assert_eq!(rs_api, "fn foo() {}\n");
+        assert_eq!(rs_api_impl, "void foo() {}");
+    }
+
+    #[test]
+    fn test_format_cache() -> Result<()> {
+        let cache_dir = tempdir()?;
+        let exe_path = Path::new("/bin/cat");
+        let format = |input: &str| {
+            pipe_string_through_process_with_cache(
+                input.to_string(),
+                "cat",
+                exe_path,
+                Vec::<&OsStr>::new(),
+                &[],
+                Some(cache_dir.path()),
+            )
+        };
+        assert_eq!(format("fn foo() {}")?, "fn foo() {}");
+
+        // A second run with the same input is answered from the cache, which
+        // is observable by tampering with the cached entry.
+        let cache_file = cache_dir
+            .path()
+            .join(format_cache_file_name(exe_path, &[], &[], "fn foo() {}").unwrap());
+        std::fs::write(&cache_file, "cached")?;
+        assert_eq!(format("fn foo() {}")?, "cached");
+
+        // Other input isn't.
+        assert_eq!(format("fn bar() {}")?, "fn bar() {}");
+        Ok(())
+    }
+
+    #[test]
+    fn test_format_cache_key_covers_config() -> Result<()> {
+        let tmpdir = tempdir()?;
+        let config_path = tmpdir.path().join("rustfmt.toml");
+        let key = || format_cache_file_name(Path::new("/bin/cat"), &[], &[&config_path], "x");
+        // Without the config file there is no key, so nothing is cached.
+        assert_eq!(key(), None);
+        std::fs::write(&config_path, "max_width = 80")?;
+        let key_80 = key();
+        std::fs::write(&config_path, "max_width = 100")?;
+        assert_ne!(key(), key_80);
+        Ok(())
+    }
+
     #[test]
     fn test_cc_tokens_to_formatted_string_for_tests() {
         let input = quote! {
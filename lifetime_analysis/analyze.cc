@@ -6,12 +6,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <optional>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <variant>
 #include <vector>
@@ -23,6 +27,7 @@
 #include "lifetime_analysis/lifetime_analysis.h"
 #include "lifetime_analysis/lifetime_constraints.h"
 #include "lifetime_analysis/lifetime_lattice.h"
+#include "lifetime_analysis/lifetime_summaries.h"
 #include "lifetime_analysis/object.h"
 #include "lifetime_analysis/object_repository.h"
 #include "lifetime_analysis/object_set.h"
@@ -53,9 +58,12 @@
 #include "clang/Index/USRGeneration.h"
 #include "clang/Lex/Lexer.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ErrorHandling.h"
@@ -64,19 +72,120 @@
 namespace clang {
 namespace tidy {
 namespace lifetimes {
+
+struct FunctionDebugSnapshot {
+  const clang::FunctionDecl* func = nullptr;
+  std::shared_ptr<const ObjectRepository> object_repository;
+
+  // The points-to map and constraints of the exit block.
+  PointsToMap points_to_map;
+  LifetimeConstraints constraints;
+
+  // The CFG and the lattice at the end of each of its blocks, indexed by block
+  // ID. `acfg` is null if the function has no body that was analyzed.
+  std::unique_ptr<clang::dataflow::AdornedCFG> acfg;
+  std::vector<std::optional<LifetimeLattice>> block_lattices;
+};
+
 namespace {
 
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Adds the time since `start` to the given field of the metrics of `func`, if
+// debug info is collected for it.
+void AddSecondsSince(FunctionDebugInfoMap* debug_info,
+                     const clang::FunctionDecl* func,
+                     double FunctionAnalysisMetrics::*field,
+                     Clock::time_point start) {
+  if (debug_info == nullptr) return;
+  if (const clang::FunctionDecl* definition = func->getDefinition()) {
+    func = definition;
+  }
+  auto iter = debug_info->find(func);
+  if (iter == debug_info->end()) return;
+  iter->second.metrics.*field += SecondsSince(start);
+}
+
 struct VisitedCallStackEntry {
   const clang::FunctionDecl* func;
   bool in_cycle;
   bool in_overrides_traversal;
 };
 
+// The functions being explored by `AnalyzeFunctionRecursive()`, in call order.
+//
+// Besides the entries themselves, this keeps the position of the latest entry
+// for each function, so that a call back into a function that is still on the
+// stack (i.e. a recursive cycle) is found in constant time rather than by
+// scanning the stack for every call edge, which is quadratic in the depth of
+// the call graph.
+class VisitedCallStack {
+ public:
+  bool empty() const { return entries_.empty(); }
+  size_t size() const { return entries_.size(); }
+  VisitedCallStackEntry& operator[](size_t i) { return entries_[i]; }
+  VisitedCallStackEntry& back() { return entries_.back(); }
+  llvm::ArrayRef<VisitedCallStackEntry> entries() const { return entries_; }
+
+  void push_back(const VisitedCallStackEntry& entry) {
+    auto [iter, inserted] =
+        latest_position_.try_emplace(entry.func, entries_.size());
+    // A function may be pushed again while it is on the stack during an
+    // overrides traversal; remember where it was so that popping it restores
+    // the earlier entry.
+    previous_position_.push_back(inserted ? kNotOnStack : iter->second);
+    iter->second = entries_.size();
+    entries_.push_back(entry);
+  }
+
+  // Pops entries until there are `size` left.
+  void resize(size_t size) {
+    assert(size <= entries_.size());
+    while (entries_.size() > size) {
+      const clang::FunctionDecl* func = entries_.back().func;
+      if (previous_position_.back() == kNotOnStack) {
+        latest_position_.erase(func);
+      } else {
+        latest_position_[func] = previous_position_.back();
+      }
+      previous_position_.pop_back();
+      entries_.pop_back();
+    }
+  }
+
+  // Returns the position of the latest entry for `func`, if it is on the stack.
+  std::optional<size_t> Find(const clang::FunctionDecl* func) const {
+    auto iter = latest_position_.find(func);
+    if (iter == latest_position_.end()) return std::nullopt;
+    return iter->second;
+  }
+
+ private:
+  static constexpr size_t kNotOnStack = ~size_t{0};
+
+  llvm::SmallVector<VisitedCallStackEntry> entries_;
+  // For each entry, the position of the previous entry for the same function,
+  // or `kNotOnStack`.
+  llvm::SmallVector<size_t> previous_position_;
+  llvm::DenseMap<const clang::FunctionDecl*, size_t> latest_position_;
+};
+
 // A map from base methods to overriding methods.
 using BaseToOverrides =
     llvm::DenseMap<const clang::CXXMethodDecl*,
                    llvm::SmallPtrSet<const clang::CXXMethodDecl*, 2>>;
 
+// The virtual methods whose overrides traversal has been completed: their
+// lifetimes in the `analyzed` map already include the lifetimes of all of
+// their overrides, which are themselves in the set. A later traversal that
+// reaches one of these methods can skip it, and the chain of overrides below
+// it, instead of analyzing them all again.
+using OverrideMerges = llvm::DenseSet<const clang::CXXMethodDecl*>;
+
 // Enforce the invariant that an object of static lifetime should only point at
 // other objects of static lifetime.
 llvm::Error PropagateStaticToPointees(LifetimeSubstitutions& subst,
@@ -320,9 +429,7 @@ std::string CfgBlockLabel(const clang::CFGBlock* block, const clang::CFG& cfg,
 
 std::string CreateCfgDot(
     const clang::CFG& cfg, const clang::ASTContext& ast_context,
-    const std::vector<
-        std::optional<clang::dataflow::DataflowAnalysisState<LifetimeLattice>>>&
-        block_to_output_state,
+    const std::vector<std::optional<LifetimeLattice>>& block_lattices,
     const ObjectRepository& object_repository) {
   std::string result = "digraph d {\ncompound=true;\nedge [minlen=2];\n";
 
@@ -345,15 +452,14 @@ std::string CreateCfgDot(
         id);
     absl::StrAppend(&result, "}\n");
 
-    const auto& block_state = block_to_output_state[id];
-    if (block_state) {
-      auto lattice = block_state->Lattice;
-      if (!lattice.IsError()) {
+    const auto& lattice = block_lattices[id];
+    if (lattice) {
+      if (!lattice->IsError()) {
         absl::StrAppend(&result,
-                        PointsToEdgesDot(object_repository, lattice.PointsTo(),
+                        PointsToEdgesDot(object_repository, lattice->PointsTo(),
                                          absl::StrCat("B", id, "_")));
         absl::StrAppend(&result, ConstraintsEdgesDot(
-                                     object_repository, lattice.Constraints(),
+                                     object_repository, lattice->Constraints(),
                                      absl::StrCat("B", id, "_cstr_")));
       }
     }
@@ -413,7 +519,8 @@ llvm::Error ConstrainLifetimes(FunctionLifetimes& base,
 }
 
 struct FunctionAnalysis {
-  ObjectRepository object_repository;
+  // Shared with the debug info of the function, if any.
+  std::shared_ptr<ObjectRepository> object_repository;
   PointsToMap points_to_map;
   LifetimeConstraints constraints;
   LifetimeSubstitutions subst;
@@ -540,7 +647,8 @@ llvm::Error AnalyzeFunctionBody(
         callee_lifetimes,
     const DiagnosticReporter& diag_reporter,
     ObjectRepository& object_repository, PointsToMap& points_to_map,
-    LifetimeConstraints& constraints, std::string* cfg_dot) {
+    LifetimeConstraints& constraints, FunctionDebugSnapshot* snapshot,
+    FunctionAnalysisMetrics* metrics) {
   auto acfg = clang::dataflow::AdornedCFG::build(*func);
   if (!acfg) return acfg.takeError();
 
@@ -559,6 +667,10 @@ llvm::Error AnalyzeFunctionBody(
     return maybe_block_to_output_state.takeError();
   }
   auto& block_to_output_state = *maybe_block_to_output_state;
+  if (metrics) {
+    metrics->num_cfg_blocks = acfg->getCFG().getNumBlockIDs();
+    metrics->num_transferred_elements = analysis.NumTransferredElements();
+  }
 
   const auto& exit_block_state =
       block_to_output_state[acfg->getCFG().getExit().getBlockID()];
@@ -610,9 +722,18 @@ llvm::Error AnalyzeFunctionBody(
     }
   }
 
-  if (cfg_dot) {
-    *cfg_dot = CreateCfgDot(acfg->getCFG(), func->getASTContext(),
-                            block_to_output_state, object_repository);
+  if (snapshot) {
+    // Keep only the lattices, not the rest of the dataflow state.
+    snapshot->block_lattices.reserve(block_to_output_state.size());
+    for (const auto& block_state : block_to_output_state) {
+      if (block_state) {
+        snapshot->block_lattices.emplace_back(block_state->Lattice);
+      } else {
+        snapshot->block_lattices.emplace_back(std::nullopt);
+      }
+    }
+    snapshot->acfg =
+        std::make_unique<clang::dataflow::AdornedCFG>(std::move(*acfg));
   }
 
   return llvm::Error::success();
@@ -622,12 +743,17 @@ llvm::Expected<FunctionAnalysis> AnalyzeSingleFunction(
     const clang::FunctionDecl* func,
     const FunctionLifetimesMap& callee_lifetimes,
     const DiagnosticReporter& diag_reporter, FunctionDebugInfoMap* debug_info) {
+  FunctionAnalysisMetrics metrics{.num_analyses = 1};
+  Clock::time_point start = Clock::now();
   llvm::Expected<ObjectRepository> object_repository =
       ObjectRepository::Create(func, callee_lifetimes);
+  metrics.object_repository_seconds = SecondsSince(start);
   if (auto err = object_repository.takeError()) {
     return std::move(err);
   }
-  FunctionAnalysis analysis{.object_repository = std::move(*object_repository)};
+  FunctionAnalysis analysis{
+      .object_repository =
+          std::make_shared<ObjectRepository>(std::move(*object_repository))};
 
   const auto* cxxmethod = clang::dyn_cast<clang::CXXMethodDecl>(func);
   if (cxxmethod && cxxmethod->isPureVirtual()) {
@@ -637,6 +763,12 @@ llvm::Expected<FunctionAnalysis> AnalyzeSingleFunction(
   func = func->getDefinition();
   assert(func != nullptr);
 
+  std::shared_ptr<FunctionDebugSnapshot> snapshot;
+  if (debug_info && debug_info->ShouldCollect(func)) {
+    snapshot = std::make_shared<FunctionDebugSnapshot>();
+    snapshot->func = func;
+  }
+
   // Unconditionally use our custom logic to analyze defaulted functions, even
   // if they happen to have a body (because something caused Sema to create a
   // body for them). We don't want the code path for defaulted functions to
@@ -653,37 +785,50 @@ llvm::Expected<FunctionAnalysis> AnalyzeSingleFunction(
     // Single-valued objects are only used during the analysis itself, so no
     // need to keep track of them past this point.
     ObjectSet single_valued_objects =
-        analysis.object_repository.InitialSingleValuedObjects();
+        analysis.object_repository->InitialSingleValuedObjects();
     if (llvm::Error err = AnalyzeDefaultedFunction(
-            func, callee_lifetimes, analysis.object_repository,
+            func, callee_lifetimes, *analysis.object_repository,
             analysis.points_to_map, analysis.constraints,
             single_valued_objects)) {
       return std::move(err);
     }
   } else if (func->getBody()) {
-    std::string* cfg_dot = debug_info ? &(*debug_info)[func].cfg_dot : nullptr;
+    start = Clock::now();
     if (llvm::Error err = AnalyzeFunctionBody(
-            func, callee_lifetimes, diag_reporter, analysis.object_repository,
-            analysis.points_to_map, analysis.constraints, cfg_dot)) {
+            func, callee_lifetimes, diag_reporter, *analysis.object_repository,
+            analysis.points_to_map, analysis.constraints, snapshot.get(),
+            snapshot ? &metrics : nullptr)) {
       return std::move(err);
     }
+    metrics.dataflow_seconds = SecondsSince(start);
   } else {
     return llvm::createStringError(llvm::inconvertibleErrorCode(),
                                    "Declaration-only!");
   }
 
-  if (debug_info) {
-    std::string ast;
-    llvm::raw_string_ostream os(ast);
-    func->dump(os);
-    os.flush();
-    (*debug_info)[func].ast = std::move(ast);
-    (*debug_info)[func].object_repository =
-        analysis.object_repository.DebugString();
-    (*debug_info)[func].points_to_map_dot =
-        PointsToGraphDot(analysis.object_repository, analysis.points_to_map);
-    (*debug_info)[func].constraints_dot =
-        ConstraintsDot(analysis.object_repository, analysis.constraints);
+  if (snapshot) {
+    snapshot->object_repository = analysis.object_repository;
+    snapshot->points_to_map = analysis.points_to_map;
+    snapshot->constraints = analysis.constraints;
+    for (const auto& [pointer, pointees] :
+         analysis.points_to_map.PointerPointsTos()) {
+      metrics.points_to_map_size += pointees.size();
+    }
+    FunctionDebugInfo& info = (*debug_info)[func];
+    // Keep adding up the metrics of earlier analyses of `func`. The times that
+    // aren't measured here are added to `info` directly.
+    const FunctionAnalysisMetrics& earlier = info.metrics;
+    metrics.object_repository_seconds += earlier.object_repository_seconds;
+    metrics.dataflow_seconds += earlier.dataflow_seconds;
+    metrics.constraints_seconds = earlier.constraints_seconds;
+    metrics.overrides_seconds = earlier.overrides_seconds;
+    metrics.num_analyses += earlier.num_analyses;
+    metrics.num_transferred_elements += earlier.num_transferred_elements;
+    info = FunctionDebugInfo{
+        .snapshot = std::move(snapshot),
+        .num_objects = analysis.object_repository->NumObjects(),
+        .num_constraints = analysis.constraints.AllConstraints().size(),
+        .metrics = metrics};
   }
 
   if (llvm::Error err =
@@ -758,7 +903,7 @@ llvm::Expected<FunctionLifetimes> ConstructFunctionLifetimes(
 
   FunctionLifetimes result;
 
-  result = object_repository.GetOriginalFunctionLifetimes();
+  result = object_repository->GetOriginalFunctionLifetimes();
   if (llvm::Error err = constraints.ApplyToFunctionLifetimes(result)) {
     return std::move(err);
   }
@@ -876,28 +1021,21 @@ llvm::Expected<llvm::DenseSet<const clang::FunctionDecl*>> GetCallees(
 // Looks for `func` in the `visited_call_stack`. If found it marks `func` and
 // each function that came after it as being part of the cycle. This marking is
 // stored in the `VisitedCallStackEntry`.
-bool FindAndMarkCycleWithFunc(
-    llvm::SmallVectorImpl<VisitedCallStackEntry>& visited_call_stack,
-    const clang::FunctionDecl* func) {
-  // We look for recursive cycles in a simple (but potentially slow for huge
-  // call graphs) way. If we reach a function that is already on the call stack
-  // (i.e. in `visited`), we declare `func`, and every other function after
-  // where `func` was seen in `visited` as being part of a cycle. Then a cycle
-  // graph is a contiguous set of functions in the `visited` call stack that are
-  // marked as being in a cycle.
-  bool found_cycle = false;
-  for (size_t i = visited_call_stack.size(); i > 0; --i) {
-    const auto& stack_entry = visited_call_stack[i - 1];
-    if (stack_entry.func == func) {
-      found_cycle = true;
-      for (; i <= visited_call_stack.size(); ++i) {
-        auto& mut_stack_entry = visited_call_stack[i - 1];
-        mut_stack_entry.in_cycle = true;
-      }
-      break;
-    }
-  }
-  return found_cycle;
+bool FindAndMarkCycleWithFunc(VisitedCallStack& visited_call_stack,
+                              const clang::FunctionDecl* func) {
+  // If we reach a function that is already on the call stack (i.e. in
+  // `visited`), we declare `func`, and every other function after where `func`
+  // was seen in `visited` as being part of a cycle. Then a cycle graph is a
+  // contiguous set of functions in the `visited` call stack that are marked as
+  // being in a cycle. As in Tarjan's algorithm, this is the strongly connected
+  // component of the call graph rooted at the first function of the cycle, and
+  // components are analyzed callees-first as the depth-first search unwinds.
+  std::optional<size_t> position = visited_call_stack.Find(func);
+  if (!position) return false;
+  for (size_t i = visited_call_stack.size(); i > *position; --i) {
+    visited_call_stack[i - 1].in_cycle = true;
+  }
+  return true;
 }
 
 llvm::SmallVector<const clang::FunctionDecl*> GetAllFunctionDefinitions(
@@ -954,6 +1092,17 @@ void GetBaseMethods(const clang::CXXMethodDecl* cxxmethod,
   }
 }
 
+// Removes `method` and the methods that it overrides, directly or indirectly,
+// from `override_merges`, as their merged lifetimes may include stale lifetimes
+// of `method`.
+void InvalidateOverrideMerges(const clang::CXXMethodDecl* method,
+                              OverrideMerges& override_merges) {
+  if (!override_merges.erase(method->getCanonicalDecl())) return;
+  for (const auto* base : method->overridden_methods()) {
+    InvalidateOverrideMerges(base, override_merges);
+  }
+}
+
 std::optional<FunctionLifetimes> GetFunctionLifetimesFromAnalyzed(
     const clang::FunctionDecl* canonical_func,
     const llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>&
@@ -1032,52 +1181,102 @@ llvm::Error AnalyzeRecursiveFunctions(
     analyzed[func->getCanonicalDecl()] = func_lifetimes_result.get();
   }
 
-  int64_t expected_iterations = 0;
+  // The distinct functions in the cycle, and for each the functions in the
+  // cycle whose analysis depends on its lifetimes. Only those need to be
+  // analyzed again when its lifetimes change.
+  llvm::SmallVector<const clang::FunctionDecl*> cycle;
+  llvm::DenseMap<const clang::FunctionDecl*, size_t> index_in_cycle;
   for (const auto [func, _1, _2] : funcs) {
-    expected_iterations =
-        std::max(expected_iterations, int64_t{func->getNumParams()});
+    if (index_in_cycle.try_emplace(func->getCanonicalDecl(), cycle.size())
+            .second) {
+      cycle.push_back(func);
+    }
+  }
+  std::vector<llvm::SmallVector<size_t>> dependents(cycle.size());
+  for (size_t caller = 0; caller < cycle.size(); ++caller) {
+    auto callees = GetCallees(cycle[caller]);
+    if (!callees) return callees.takeError();
+    for (const clang::FunctionDecl* callee : *callees) {
+      auto iter = index_in_cycle.find(callee->getCanonicalDecl());
+      if (iter != index_in_cycle.end()) {
+        dependents[iter->second].push_back(caller);
+      }
+    }
+  }
+  for (size_t i = 0; i < cycle.size(); ++i) {
+    // A virtual call may be resolved to an override elsewhere in the cycle
+    // without naming it, so assume everything depends on virtual methods.
+    auto* method = clang::dyn_cast<clang::CXXMethodDecl>(cycle[i]);
+    if (method && method->isVirtual()) {
+      dependents[i].clear();
+      for (size_t caller = 0; caller < cycle.size(); ++caller) {
+        dependents[i].push_back(caller);
+      }
+    }
   }
-  // Add 1 for the last iteration that sees nothing changed.
-  expected_iterations += 1;
-
-  // Analyze all lifetimes in the cycle repeatedly with dataflow analysis
-  // until they stabilize.
-  bool func_lifetimes_changed = true;
-  for (int64_t count = 0; func_lifetimes_changed; ++count) {
-    func_lifetimes_changed = false;
 
-    if (count > expected_iterations) {
+  // Each change to the lifetimes of a function must unify at least two of the
+  // lifetimes in its signature, which bounds the number of changes. Add 1 for
+  // the analysis that sees nothing changed.
+  int64_t expected_analyses = 1;
+  for (const clang::FunctionDecl* func : cycle) {
+    expected_analyses += std::get<FunctionLifetimes>(
+                             analyzed[func->getCanonicalDecl()])
+                             .AllFreeLifetimes()
+                             .size();
+  }
+  expected_analyses *= cycle.size();
+
+  // Analyze functions in the cycle with dataflow analysis until their
+  // lifetimes stabilize, starting with all of them, then only those that
+  // depend on lifetimes that changed.
+  std::deque<size_t> worklist;
+  llvm::BitVector in_worklist(cycle.size(), true);
+  for (size_t i = 0; i < cycle.size(); ++i) worklist.push_back(i);
+  for (int64_t count = 0; !worklist.empty(); ++count) {
+    if (count > expected_analyses) {
       return llvm::createStringError(
           llvm::inconvertibleErrorCode(),
           absl::StrFormat("Recursive cycle requires more than the expected "
-                          "%u iterations to resolve!",
-                          expected_iterations));
+                          "%u analyses to resolve!",
+                          expected_analyses));
     }
 
-    for (const auto [func, in_cycle, _] : funcs) {
-      auto analysis_result =
-          AnalyzeSingleFunction(func, analyzed, diag_reporter, debug_info);
-      if (!analysis_result) {
-        return analysis_result.takeError();
-      }
-      auto func_lifetimes_result = ConstructFunctionLifetimes(
-          func, std::move(analysis_result.get()), diag_reporter);
-      if (!func_lifetimes_result) {
-        return func_lifetimes_result.takeError();
-      }
-      // TODO(danakj): We can avoid this structural comparison and just do a
-      // check for equality if AnalyzeSingleFunction would reuse Lifetimes
-      // from the existing FunctionLifetime for its parameters/return/this.
-      // Currently it makes a new set of Lifetimes each time we do the analyze
-      // step, but the actual Lifetime ids aren't meaningful, only where and
-      // how often a given Lifetime repeats is meaningful.
-      FunctionLifetimesOrError& existing_result =
-          analyzed[func->getCanonicalDecl()];
-      if (std::holds_alternative<FunctionLifetimes>(existing_result) &&
-          !IsIsomorphic(std::get<FunctionLifetimes>(existing_result),
-                        func_lifetimes_result.get())) {
-        existing_result = func_lifetimes_result.get();
-        func_lifetimes_changed = true;
+    size_t index = worklist.front();
+    worklist.pop_front();
+    in_worklist.reset(index);
+    const clang::FunctionDecl* func = cycle[index];
+
+    auto analysis_result =
+        AnalyzeSingleFunction(func, analyzed, diag_reporter, debug_info);
+    if (!analysis_result) {
+      return analysis_result.takeError();
+    }
+    Clock::time_point start = Clock::now();
+    auto func_lifetimes_result = ConstructFunctionLifetimes(
+        func, std::move(analysis_result.get()), diag_reporter);
+    AddSecondsSince(debug_info, func,
+                    &FunctionAnalysisMetrics::constraints_seconds, start);
+    if (!func_lifetimes_result) {
+      return func_lifetimes_result.takeError();
+    }
+    // TODO(danakj): We can avoid this structural comparison and just do a
+    // check for equality if AnalyzeSingleFunction would reuse Lifetimes
+    // from the existing FunctionLifetime for its parameters/return/this.
+    // Currently it makes a new set of Lifetimes each time we do the analyze
+    // step, but the actual Lifetime ids aren't meaningful, only where and
+    // how often a given Lifetime repeats is meaningful.
+    FunctionLifetimesOrError& existing_result =
+        analyzed[func->getCanonicalDecl()];
+    if (std::holds_alternative<FunctionLifetimes>(existing_result) &&
+        !IsIsomorphic(std::get<FunctionLifetimes>(existing_result),
+                      func_lifetimes_result.get())) {
+      existing_result = func_lifetimes_result.get();
+      for (size_t dependent : dependents[index]) {
+        if (!in_worklist.test(dependent)) {
+          in_worklist.set(dependent);
+          worklist.push_back(dependent);
+        }
       }
     }
   }
@@ -1085,6 +1284,45 @@ llvm::Error AnalyzeRecursiveFunctions(
   return llvm::Error::success();
 }
 
+// Adds the lifetimes of `funcs`, which were analyzed together, to `summaries`
+// if they depend only on the definitions of the functions involved: none of
+// `funcs` is virtual, and every other function they call is neither virtual
+// nor defined without a summary of its own. (The lifetimes of virtual methods
+// are updated with the overrides seen in the translation unit.)
+void AddSummaries(
+    llvm::ArrayRef<const clang::FunctionDecl*> funcs,
+    const llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>&
+        analyzed,
+    LifetimeSummaryStore& summaries) {
+  auto is_virtual = [](const clang::FunctionDecl* func) {
+    auto* method = clang::dyn_cast<clang::CXXMethodDecl>(func);
+    return method != nullptr && method->isVirtual();
+  };
+  llvm::SmallPtrSet<const clang::FunctionDecl*, 4> in_funcs(funcs.begin(),
+                                                            funcs.end());
+  for (const clang::FunctionDecl* func : funcs) {
+    if (is_virtual(func)) return;
+    auto callees = GetCallees(func);
+    if (!callees) {
+      llvm::consumeError(callees.takeError());
+      return;
+    }
+    for (const clang::FunctionDecl* callee : *callees) {
+      if (in_funcs.contains(callee) || callee->getBuiltinID() != 0) continue;
+      if (is_virtual(callee) ||
+          (callee->isDefined() && !summaries.Contains(callee))) {
+        return;
+      }
+    }
+  }
+  for (const clang::FunctionDecl* func : funcs) {
+    if (std::optional<FunctionLifetimes> lifetimes =
+            GetFunctionLifetimesFromAnalyzed(func, analyzed)) {
+      summaries.Add(func, *lifetimes);
+    }
+  }
+}
+
 // The entry point for analyzing a function named by `func`.
 //
 // This function is recursive as it searches for and walks through all CallExpr
@@ -1107,11 +1345,11 @@ llvm::Error AnalyzeRecursiveFunctions(
 void AnalyzeFunctionRecursive(
     llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>&
         analyzed,
-    llvm::SmallVectorImpl<VisitedCallStackEntry>& visited,
-    const clang::FunctionDecl* func,
+    VisitedCallStack& visited, const clang::FunctionDecl* func,
     const LifetimeAnnotationContext& lifetime_context,
     const DiagnosticReporter& diag_reporter, FunctionDebugInfoMap* debug_info,
-    const BaseToOverrides& base_to_overrides) {
+    const BaseToOverrides& base_to_overrides, OverrideMerges& override_merges,
+    LifetimeSummaryStore* summaries) {
   // Make sure we're always using the canonical declaration when using the
   // function as a key in maps and sets.
   func = func->getCanonicalDecl();
@@ -1145,9 +1383,13 @@ void AnalyzeFunctionRecursive(
   if (is_analyzed && !in_overrides_traversal) {
     // This function is already analyzed and this analysis is not for an
     // overrides traversal (where repeated update may happen).
-    // TODO(kinuko): Avoid repeatedly visit the same virtual methods again and
-    // again if all the methods in the same overriding chain are already
-    // analyzed.
+    return;
+  }
+
+  if (in_overrides_traversal && is_virtual &&
+      override_merges.contains(cxxmethod)) {
+    // An earlier traversal already merged the lifetimes of this method with
+    // its overrides, and none of them has changed since.
     return;
   }
 
@@ -1168,6 +1410,16 @@ void AnalyzeFunctionRecursive(
     return;
   }
 
+  // Another translation unit may already have analyzed the same definition.
+  // Virtual methods are always analyzed, as overrides in this translation unit
+  // may change their lifetimes.
+  if (summaries != nullptr && !is_virtual && !in_overrides_traversal) {
+    if (std::optional<FunctionLifetimes> summary = summaries->Lookup(func)) {
+      analyzed[func] = *std::move(summary);
+      return;
+    }
+  }
+
   auto maybe_callees = GetCallees(func);
   if (!maybe_callees) {
     analyzed[func] = FunctionAnalysisError(maybe_callees.takeError());
@@ -1180,7 +1432,7 @@ void AnalyzeFunctionRecursive(
   // recursive cycle in the `visited` stack until we explore the whole graph and
   // then analyze it all.
   size_t func_in_visited = visited.size();
-  visited.emplace_back(VisitedCallStackEntry{
+  visited.push_back(VisitedCallStackEntry{
       .func = func, .in_cycle = false, .in_overrides_traversal = false});
 
   for (auto& callee : maybe_callees.get()) {
@@ -1188,7 +1440,8 @@ void AnalyzeFunctionRecursive(
       continue;
     }
     AnalyzeFunctionRecursive(analyzed, visited, callee, lifetime_context,
-                             diag_reporter, debug_info, base_to_overrides);
+                             diag_reporter, debug_info, base_to_overrides,
+                             override_merges, summaries);
   }
 
   llvm::DenseSet<const clang::CXXMethodDecl*> bases;
@@ -1206,7 +1459,8 @@ void AnalyzeFunctionRecursive(
       GetBaseMethods(cxxmethod, bases);
       for (const auto* base : bases) {
         AnalyzeFunctionRecursive(analyzed, visited, base, lifetime_context,
-                                 diag_reporter, debug_info, base_to_overrides);
+                                 diag_reporter, debug_info, base_to_overrides,
+                                 override_merges, summaries);
       }
     } else {
       // We are in an overrides traversal for a virtual method starting from its
@@ -1218,8 +1472,8 @@ void AnalyzeFunctionRecursive(
         overrides = iter->second;
         for (const auto* derived : overrides) {
           AnalyzeFunctionRecursive(analyzed, visited, derived, lifetime_context,
-                                   diag_reporter, debug_info,
-                                   base_to_overrides);
+                                   diag_reporter, debug_info, base_to_overrides,
+                                   override_merges, summaries);
         }
       }
     }
@@ -1265,13 +1519,19 @@ void AnalyzeFunctionRecursive(
       if (!analysis_result) {
         analyzed[func] = FunctionAnalysisError(analysis_result.takeError());
       } else {
+        Clock::time_point start = Clock::now();
         auto func_lifetimes_result = ConstructFunctionLifetimes(
             func, std::move(analysis_result.get()), diag_reporter);
+        AddSecondsSince(debug_info, func,
+                        &FunctionAnalysisMetrics::constraints_seconds, start);
         if (!func_lifetimes_result) {
           analyzed[func] =
               FunctionAnalysisError(func_lifetimes_result.takeError());
         } else {
           analyzed[func] = func_lifetimes_result.get();
+          if (summaries != nullptr) {
+            AddSummaries({func}, analyzed, *summaries);
+          }
         }
       }
     } else {
@@ -1283,23 +1543,57 @@ void AnalyzeFunctionRecursive(
     }
   } else {
     // Case 3. The entry point to a recursive cycle.
-    auto funcs_in_cycle =
-        llvm::ArrayRef<VisitedCallStackEntry>(visited).drop_front(
-            func_in_visited);
-    if (llvm::Error err = AnalyzeRecursiveFunctions(
-            funcs_in_cycle, analyzed, diag_reporter, debug_info)) {
+    auto funcs_in_cycle = visited.entries().drop_front(func_in_visited);
+    // The cycle may replace the merged lifetimes of virtual methods, in which
+    // case they and their bases need to be merged again.
+    llvm::SmallVector<std::pair<const clang::CXXMethodDecl*,
+                                std::optional<FunctionLifetimes>>>
+        merged_in_cycle;
+    for (const auto [func_in_cycle, _1, _2] : funcs_in_cycle) {
+      auto* method = clang::dyn_cast<clang::CXXMethodDecl>(func_in_cycle);
+      if (method != nullptr && override_merges.contains(method)) {
+        merged_in_cycle.push_back(
+            {method, GetFunctionLifetimesFromAnalyzed(method, analyzed)});
+      }
+    }
+    llvm::Error cycle_err = AnalyzeRecursiveFunctions(
+        funcs_in_cycle, analyzed, diag_reporter, debug_info);
+    for (const auto& [method, lifetimes] : merged_in_cycle) {
+      std::optional<FunctionLifetimes> new_lifetimes =
+          GetFunctionLifetimesFromAnalyzed(method, analyzed);
+      if (cycle_err || !lifetimes || !new_lifetimes ||
+          !IsIsomorphic(*lifetimes, *new_lifetimes)) {
+        InvalidateOverrideMerges(method, override_merges);
+      }
+    }
+    if (llvm::Error err = std::move(cycle_err)) {
       for (const auto [func_in_cycle, _1, _2] : funcs_in_cycle) {
         analyzed[func_in_cycle] = FunctionAnalysisError(err);
       }
+    } else if (summaries != nullptr) {
+      llvm::SmallVector<const clang::FunctionDecl*> cycle;
+      for (const auto [func_in_cycle, _1, _2] : funcs_in_cycle) {
+        cycle.push_back(func_in_cycle);
+      }
+      AddSummaries(cycle, analyzed, *summaries);
     }
   }
 
   // If this has overrides and we're in an overrides traversal, the lifetimes
   // need to be (recursively) updated with the results of the overrides.
   if (in_overrides_traversal) {
-    if (llvm::Error err =
-            UpdateFunctionLifetimesWithOverrides(func, analyzed, overrides)) {
+    Clock::time_point start = Clock::now();
+    llvm::Error update_err =
+        UpdateFunctionLifetimesWithOverrides(func, analyzed, overrides);
+    AddSecondsSince(debug_info, func,
+                    &FunctionAnalysisMetrics::overrides_seconds, start);
+    if (llvm::Error err = std::move(update_err)) {
       analyzed[func] = FunctionAnalysisError(err);
+    } else if (is_virtual && !visited[func_in_visited].in_cycle &&
+               llvm::all_of(overrides, [&](const auto* derived) {
+                 return override_merges.contains(derived->getCanonicalDecl());
+               })) {
+      override_merges.insert(cxxmethod);
     }
   }
 
@@ -1316,9 +1610,10 @@ AnalyzeTranslationUnitAndCollectTemplates(
     const DiagnosticReporter& diag_reporter, FunctionDebugInfoMap* debug_info,
     llvm::DenseMap<clang::FunctionTemplateDecl*, const clang::FunctionDecl*>&
         uninstantiated_templates,
-    const BaseToOverrides& base_to_overrides) {
+    const BaseToOverrides& base_to_overrides, LifetimeSummaryStore* summaries) {
   llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError> result;
-  llvm::SmallVector<VisitedCallStackEntry> visited;
+  VisitedCallStack visited;
+  OverrideMerges override_merges;
 
   for (const clang::FunctionDecl* func : GetAllFunctionDefinitions(tu)) {
     // Skip templated functions.
@@ -1344,7 +1639,8 @@ AnalyzeTranslationUnitAndCollectTemplates(
     // function before.
 
     AnalyzeFunctionRecursive(result, visited, func, lifetime_context,
-                             diag_reporter, debug_info, base_to_overrides);
+                             diag_reporter, debug_info, base_to_overrides,
+                             override_merges, summaries);
   }
 
   return result;
@@ -1361,9 +1657,27 @@ std::string GetFunctionUSRString(const clang::Decl* func) {
   return std::string(usr.data(), usr.size());
 }
 
+// Returns the function template specialization in the original ASTContext
+// that `func`, an instantiation with placeholder types in a separate
+// ASTContext, stands for, or null if `func` is not such an instantiation.
+const clang::FunctionDecl* GetOriginalTemplateFunction(
+    const clang::FunctionDecl* func,
+    const std::map<std::string, const clang::FunctionDecl*>&
+        template_usr_to_decl) {
+  if (!func->isFunctionTemplateSpecialization()) return nullptr;
+  auto* tmpl = func->getTemplateSpecializationInfo()->getTemplate();
+  auto iter = template_usr_to_decl.find(GetFunctionUSRString(tmpl));
+  if (iter == template_usr_to_decl.end()) return nullptr;
+  return iter->second;
+}
+
 // Run AnalyzeFunctionRecursive with `context`. Report results through
 // `result_callback` and update `debug_info` using USR strings to map functions
-// to the original ASTContext.
+// to the original ASTContext. The templates that `initial_result` already has
+// results for are not reported again.
+//
+// `result_callback` is called and `debug_info` accessed with `report_mutex`
+// held, so that separate ASTContexts can be analyzed on separate threads.
 void AnalyzeTemplateFunctionsInSeparateASTContext(
     const LifetimeAnnotationContext& lifetime_context,
     const llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>&
@@ -1372,43 +1686,60 @@ void AnalyzeTemplateFunctionsInSeparateASTContext(
     const DiagnosticReporter& diag_reporter, FunctionDebugInfoMap* debug_info,
     const std::map<std::string, const clang::FunctionDecl*>&
         template_usr_to_decl,
-    const BaseToOverrides& base_to_overrides, clang::ASTContext& context) {
+    const BaseToOverrides& base_to_overrides, std::mutex& report_mutex,
+    clang::ASTContext& context) {
   llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>
       inner_result;
-  llvm::SmallVector<VisitedCallStackEntry> inner_visited;
-  FunctionDebugInfoMap inner_debug_info;
+  VisitedCallStack inner_visited;
+  OverrideMerges inner_override_merges;
+  std::optional<FunctionDebugInfoMap> inner_debug_info;
+  if (debug_info) {
+    std::lock_guard<std::mutex> lock(report_mutex);
+    inner_debug_info = debug_info->CloneEmpty();
+  }
 
   for (const clang::FunctionDecl* func :
        GetAllFunctionDefinitions(context.getTranslationUnitDecl())) {
-    // Skip templated functions.
-    if (func->isTemplated()) continue;
+    // Only start from the instantiations with placeholder types. Everything
+    // else in `context` was already analyzed in the original ASTContext, and
+    // the functions that the instantiations call are analyzed on demand.
+    if (func->isTemplated() ||
+        GetOriginalTemplateFunction(func, template_usr_to_decl) == nullptr) {
+      continue;
+    }
 
+    // Functions instantiated with placeholder types are not summarized.
     AnalyzeFunctionRecursive(inner_result, inner_visited, func,
-                             lifetime_context, diag_reporter, &inner_debug_info,
-                             base_to_overrides);
+                             lifetime_context, diag_reporter,
+                             inner_debug_info ? &*inner_debug_info : nullptr,
+                             base_to_overrides, inner_override_merges,
+                             /*summaries=*/nullptr);
   }
 
   // We need to remap the results with FunctionDecl* in the
   // original ASTContext. (Because this context goes away after
   // this)
   llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>
-      merged_result = initial_result;
+      template_result;
   for (const auto& [decl, lifetimes_or_error] : inner_result) {
-    if (!decl->isFunctionTemplateSpecialization()) continue;
-    auto* tmpl = decl->getTemplateSpecializationInfo()->getTemplate();
-    auto iter = template_usr_to_decl.find(GetFunctionUSRString(tmpl));
-    if (iter != template_usr_to_decl.end()) {
-      merged_result.insert({iter->second, lifetimes_or_error});
+    const clang::FunctionDecl* original =
+        GetOriginalTemplateFunction(decl, template_usr_to_decl);
+    if (original != nullptr && !initial_result.count(original)) {
+      template_result.insert({original, lifetimes_or_error});
     }
   }
-  for (const auto& [decl, lifetimes_or_error] : merged_result) {
+  std::lock_guard<std::mutex> lock(report_mutex);
+  for (const auto& [decl, lifetimes_or_error] : template_result) {
     result_callback(decl, lifetimes_or_error);
   }
-  for (auto& [decl, info] : inner_debug_info) {
-    if (!decl->isFunctionTemplateSpecialization()) continue;
-    auto* tmpl = decl->getTemplateSpecializationInfo()->getTemplate();
-    auto iter = template_usr_to_decl.find(GetFunctionUSRString(tmpl));
-    if (iter != template_usr_to_decl.end()) (*debug_info)[iter->second] = info;
+  if (!inner_debug_info) return;
+  for (auto& [decl, info] : *inner_debug_info) {
+    if (const clang::FunctionDecl* original =
+            GetOriginalTemplateFunction(decl, template_usr_to_decl)) {
+      // The snapshot refers to `context`, so render it while it still exists.
+      info.Render();
+      (*debug_info)[original] = std::move(info);
+    }
   }
 }
 
@@ -1425,6 +1756,72 @@ DiagnosticReporter DiagReporterForDiagEngine(
 
 }  // namespace
 
+void FunctionDebugInfo::Render() {
+  if (!snapshot) return;
+  const FunctionDebugSnapshot& results = *snapshot;
+
+  ast.clear();
+  llvm::raw_string_ostream os(ast);
+  results.func->dump(os);
+  os.flush();
+  object_repository = results.object_repository->DebugString();
+  points_to_map_dot =
+      PointsToGraphDot(*results.object_repository, results.points_to_map);
+  constraints_dot =
+      ConstraintsDot(*results.object_repository, results.constraints);
+  if (results.acfg) {
+    cfg_dot = CreateCfgDot(results.acfg->getCFG(),
+                           results.func->getASTContext(),
+                           results.block_lattices, *results.object_repository);
+  }
+  snapshot = nullptr;
+}
+
+std::string FunctionDebugInfo::MetricsJson() const {
+  return absl::StrFormat(
+      "{\"num_objects\": %d, \"num_constraints\": %d, "
+      "\"object_repository_seconds\": %g, \"dataflow_seconds\": %g, "
+      "\"constraints_seconds\": %g, \"overrides_seconds\": %g, "
+      "\"num_analyses\": %d, \"num_transferred_elements\": %d, "
+      "\"num_cfg_blocks\": %d, \"points_to_map_size\": %d}",
+      num_objects, num_constraints, metrics.object_repository_seconds,
+      metrics.dataflow_seconds, metrics.constraints_seconds,
+      metrics.overrides_seconds, metrics.num_analyses,
+      metrics.num_transferred_elements, metrics.num_cfg_blocks,
+      metrics.points_to_map_size);
+}
+
+std::string SlowestFunctionsReport(const FunctionDebugInfoMap& debug_info,
+                                   size_t n) {
+  std::vector<std::pair<const clang::FunctionDecl*, const FunctionDebugInfo*>>
+      functions;
+  for (const auto& [func, info] : debug_info) {
+    functions.emplace_back(func, &info);
+  }
+  n = std::min(n, functions.size());
+  std::partial_sort(functions.begin(), functions.begin() + n, functions.end(),
+                    [](const auto& a, const auto& b) {
+                      return a.second->metrics.TotalSeconds() >
+                             b.second->metrics.TotalSeconds();
+                    });
+  std::string report;
+  for (const auto& [func, info] : llvm::ArrayRef(functions).take_front(n)) {
+    const FunctionAnalysisMetrics& metrics = info->metrics;
+    absl::StrAppendFormat(
+        &report,
+        "%.3fms %s: %d analyses, %d CFG blocks, %d elements transferred, "
+        "%d objects, %d points-to edges (repository %.3fms, dataflow %.3fms, "
+        "constraints %.3fms, overrides %.3fms)\n",
+        metrics.TotalSeconds() * 1000, func->getQualifiedNameAsString(),
+        metrics.num_analyses, metrics.num_cfg_blocks,
+        metrics.num_transferred_elements, info->num_objects,
+        metrics.points_to_map_size, metrics.object_repository_seconds * 1000,
+        metrics.dataflow_seconds * 1000, metrics.constraints_seconds * 1000,
+        metrics.overrides_seconds * 1000);
+  }
+  return report;
+}
+
 bool IsIsomorphic(const FunctionLifetimes& a, const FunctionLifetimes& b) {
   return LifetimeConstraints::ForCallableSubstitution(a, b)
              .AllConstraints()
@@ -1438,8 +1835,13 @@ FunctionLifetimesOrError AnalyzeFunction(
     const clang::FunctionDecl* func,
     const LifetimeAnnotationContext& lifetime_context,
     FunctionDebugInfo* debug_info) {
+  // Give the lifetimes of the analysis consecutive ids that don't depend on
+  // what this thread created before.
+  Lifetime::IdScope id_scope;
+
   llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError> analyzed;
-  llvm::SmallVector<VisitedCallStackEntry> visited;
+  VisitedCallStack visited;
+  OverrideMerges override_merges;
   std::optional<FunctionDebugInfoMap> debug_info_map;
   if (debug_info) {
     debug_info_map.emplace();
@@ -1448,7 +1850,8 @@ FunctionLifetimesOrError AnalyzeFunction(
       DiagReporterForDiagEngine(func->getASTContext().getDiagnostics());
   AnalyzeFunctionRecursive(
       analyzed, visited, func, lifetime_context, diag_reporter,
-      debug_info_map ? &debug_info_map.value() : nullptr, BaseToOverrides());
+      debug_info_map ? &debug_info_map.value() : nullptr, BaseToOverrides(),
+      override_merges, /*summaries=*/nullptr);
   if (debug_info) {
     *debug_info = debug_info_map->lookup(func);
   }
@@ -1459,7 +1862,9 @@ llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>
 AnalyzeTranslationUnit(const clang::TranslationUnitDecl* tu,
                        const LifetimeAnnotationContext& lifetime_context,
                        DiagnosticReporter diag_reporter,
-                       FunctionDebugInfoMap* debug_info) {
+                       FunctionDebugInfoMap* debug_info,
+                       LifetimeSummaryStore* summaries) {
+  Lifetime::IdScope id_scope;
   if (!diag_reporter) {
     diag_reporter =
         DiagReporterForDiagEngine(tu->getASTContext().getDiagnostics());
@@ -1476,16 +1881,131 @@ AnalyzeTranslationUnit(const clang::TranslationUnitDecl* tu,
   llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError> result =
       AnalyzeTranslationUnitAndCollectTemplates(
           tu, lifetime_context, diag_reporter, debug_info,
-          uninstantiated_templates, base_to_overrides);
+          uninstantiated_templates, base_to_overrides, summaries);
 
   return result;
 }
 
+void AnalyzeTranslationUnitWithCallback(
+    const clang::TranslationUnitDecl* tu,
+    const LifetimeAnnotationContext& lifetime_context,
+    const FunctionAnalysisResultCallback& result_callback,
+    DiagnosticReporter diag_reporter, FunctionDebugInfoMap* debug_info,
+    LifetimeSummaryStore* summaries) {
+  Lifetime::IdScope id_scope;
+  if (!diag_reporter) {
+    diag_reporter =
+        DiagReporterForDiagEngine(tu->getASTContext().getDiagnostics());
+  }
+
+  auto base_to_overrides = BuildBaseToOverrides(tu);
+
+  auto is_virtual = [](const clang::FunctionDecl* func) {
+    auto* method = clang::dyn_cast<clang::CXXMethodDecl>(func);
+    return method != nullptr && method->isVirtual();
+  };
+
+  // The callees of each function that will be analyzed, and the number of
+  // those functions that call each callee and haven't been reported yet. The
+  // lifetimes of a function are only needed until all its callers are
+  // analyzed.
+  llvm::DenseMap<const clang::FunctionDecl*,
+                 llvm::SmallVector<const clang::FunctionDecl*>>
+      callees_of;
+  llvm::DenseMap<const clang::FunctionDecl*, size_t> remaining_callers;
+  std::vector<const clang::FunctionDecl*> functions;
+  for (const clang::FunctionDecl* func : GetAllFunctionDefinitions(tu)) {
+    if (func->isTemplated()) continue;
+    func = func->getCanonicalDecl();
+    if (callees_of.count(func)) continue;
+    functions.push_back(func);
+    auto& callees = callees_of[func];
+    auto maybe_callees = GetCallees(func);
+    if (!maybe_callees) {
+      llvm::consumeError(maybe_callees.takeError());
+      continue;
+    }
+    for (const clang::FunctionDecl* callee : *maybe_callees) {
+      callees.push_back(callee->getCanonicalDecl());
+      ++remaining_callers[callees.back()];
+    }
+  }
+
+  llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>
+      analyzed;
+  VisitedCallStack visited;
+  OverrideMerges override_merges;
+  llvm::DenseSet<const clang::FunctionDecl*> reported;
+  // The functions that have been reached after analyzing another function.
+  llvm::DenseSet<const clang::FunctionDecl*> seen;
+
+  // Virtual methods may still be updated by the overrides traversals of other
+  // methods, so they are only reported once the whole TU is analyzed, and
+  // neither they nor their callees are released before then.
+  auto report = [&](const clang::FunctionDecl* func) {
+    if (!reported.insert(func).second) return;
+    result_callback(func, analyzed.find(func)->second);
+    if (remaining_callers.lookup(func) == 0) analyzed.erase(func);
+    auto iter = callees_of.find(func);
+    if (iter == callees_of.end()) return;
+    for (const clang::FunctionDecl* callee : iter->second) {
+      if (--remaining_callers[callee] == 0 && reported.contains(callee) &&
+          !is_virtual(callee)) {
+        analyzed.erase(callee);
+      }
+    }
+    callees_of.erase(iter);
+  };
+
+  for (const clang::FunctionDecl* func : functions) {
+    if (reported.contains(func) || analyzed.count(func)) continue;
+    AnalyzeFunctionRecursive(analyzed, visited, func, lifetime_context,
+                             diag_reporter, debug_info, base_to_overrides,
+                             override_merges, summaries);
+
+    // Report the functions that this analyzed, which are all reachable from
+    // `func` through calls and overrides, and are final now that the call
+    // stack is empty.
+    llvm::SmallVector<const clang::FunctionDecl*> worklist;
+    auto push = [&](const clang::FunctionDecl* next) {
+      next = next->getCanonicalDecl();
+      if (seen.insert(next).second) worklist.push_back(next);
+    };
+    push(func);
+    while (!worklist.empty()) {
+      const clang::FunctionDecl* next = worklist.pop_back_val();
+      if (!analyzed.count(next)) continue;
+      if (auto iter = callees_of.find(next); iter != callees_of.end()) {
+        for (const clang::FunctionDecl* callee : iter->second) push(callee);
+      }
+      if (!is_virtual(next)) {
+        report(next);
+        continue;
+      }
+      auto* method = clang::cast<clang::CXXMethodDecl>(next);
+      for (const auto* base : method->overridden_methods()) push(base);
+      if (auto iter = base_to_overrides.find(method);
+          iter != base_to_overrides.end()) {
+        for (const auto* derived : iter->second) push(derived);
+      }
+    }
+  }
+
+  // Report the virtual methods, and anything not reached above.
+  llvm::SmallVector<const clang::FunctionDecl*> unreported;
+  for (const auto& [func, _] : analyzed) {
+    if (!reported.contains(func)) unreported.push_back(func);
+  }
+  for (const clang::FunctionDecl* func : unreported) report(func);
+}
+
 void AnalyzeTranslationUnitWithTemplatePlaceholder(
     const clang::TranslationUnitDecl* tu,
     const LifetimeAnnotationContext& lifetime_context,
     const FunctionAnalysisResultCallback& result_callback,
-    DiagnosticReporter diag_reporter, FunctionDebugInfoMap* debug_info) {
+    DiagnosticReporter diag_reporter, FunctionDebugInfoMap* debug_info,
+    LifetimeSummaryStore* summaries, unsigned template_workers) {
+  Lifetime::IdScope id_scope;
   if (!diag_reporter) {
     diag_reporter =
         DiagReporterForDiagEngine(tu->getASTContext().getDiagnostics());
@@ -1502,41 +2022,102 @@ void AnalyzeTranslationUnitWithTemplatePlaceholder(
   llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>
       initial_result = AnalyzeTranslationUnitAndCollectTemplates(
           tu, lifetime_context, diag_reporter, debug_info,
-          uninstantiated_templates, base_to_overrides);
-
-  // Make a map from USRString to funcDecls in the original ASTContext.
-  std::map<std::string, const clang::FunctionDecl*> template_usr_to_decl;
+          uninstantiated_templates, base_to_overrides, summaries);
+
+  for (const auto& [func, lifetimes_or_error] : initial_result) {
+    result_callback(func, lifetimes_or_error);
+  }
+  if (uninstantiated_templates.empty()) return;
+
+  // The templates are dealt out to the chunks in the order of their USRs, so
+  // that the chunks don't depend on pointer values. Each chunk is instantiated
+  // with placeholders in a separate ASTContext, and only starts the analysis
+  // from its own templates (using a map from their USRs to the funcDecls in
+  // the original ASTContext).
+  struct TemplateChunk {
+    llvm::DenseMap<clang::FunctionTemplateDecl*, const clang::FunctionDecl*>
+        templates;
+    std::map<std::string, const clang::FunctionDecl*> template_usr_to_decl;
+    GeneratedCode code_with_placeholder;
+  };
+  std::vector<std::pair<std::string, clang::FunctionTemplateDecl*>>
+      templates_by_usr;
   for (const auto& [tmpl, func] : uninstantiated_templates) {
-    template_usr_to_decl[GetFunctionUSRString(tmpl)] = func;
+    templates_by_usr.emplace_back(GetFunctionUSRString(tmpl), tmpl);
+  }
+  llvm::sort(templates_by_usr);
+  std::vector<TemplateChunk> chunks(
+      std::clamp<size_t>(template_workers, 1, templates_by_usr.size()));
+  for (size_t i = 0; i < templates_by_usr.size(); ++i) {
+    const auto& [usr, tmpl] = templates_by_usr[i];
+    TemplateChunk& chunk = chunks[i % chunks.size()];
+    const clang::FunctionDecl* func = uninstantiated_templates.lookup(tmpl);
+    chunk.templates[tmpl] = func;
+    chunk.template_usr_to_decl[usr] = func;
   }
 
-  GeneratedCode code_with_placeholder;
-  if (llvm::Error err =
-          GenerateTemplateInstantiationCode(tu, uninstantiated_templates)
-              .moveInto(code_with_placeholder)) {
-    FunctionAnalysisError analysis_error(err);
-    for (const auto& [tmpl, func] : uninstantiated_templates) {
-      result_callback(func, analysis_error);
+  // The code is generated from the original ASTContext, so on this thread.
+  for (TemplateChunk& chunk : chunks) {
+    if (llvm::Error err =
+            GenerateTemplateInstantiationCode(tu, chunk.templates)
+                .moveInto(chunk.code_with_placeholder)) {
+      FunctionAnalysisError analysis_error(err);
+      llvm::consumeError(std::move(err));
+      for (const auto& [tmpl, func] : chunk.templates) {
+        result_callback(func, analysis_error);
+      }
+      chunk.templates.clear();
     }
-    return;
   }
 
-  // A callback to call AnalyzeFunctionRecursive again with template
-  // placeholders. This is passed to RunToolOnCodeWithOverlay below.
-  auto analyze_with_placeholder =
-      [&lifetime_context, &initial_result, &result_callback, &diag_reporter,
-       &debug_info, &template_usr_to_decl,
-       &base_to_overrides](clang::ASTContext& context) {
-        AnalyzeTemplateFunctionsInSeparateASTContext(
-            lifetime_context, initial_result, result_callback, diag_reporter,
-            debug_info, template_usr_to_decl, base_to_overrides, context);
-      };
+  // GetLifetimeAnnotations() caches the annotations it finds in the
+  // LifetimeAnnotationContext, so each chunk gets a context of its own. The
+  // cache of `lifetime_context` holds declarations of the original ASTContext,
+  // which the chunks don't look up, so only the pragmas are copied.
+  std::vector<LifetimeAnnotationContext> chunk_lifetime_contexts(chunks.size());
+  for (LifetimeAnnotationContext& chunk_context : chunk_lifetime_contexts) {
+    chunk_context.lifetime_elision_files =
+        lifetime_context.lifetime_elision_files;
+  }
+
+  std::mutex report_mutex;
+  auto analyze_chunk = [&](size_t chunk_index) {
+    const TemplateChunk& chunk = chunks[chunk_index];
+    if (chunk.templates.empty()) return;
+    // A callback to call AnalyzeFunctionRecursive again with template
+    // placeholders. This is passed to RunToolOnCodeWithOverlay below.
+    auto analyze_with_placeholder = [&](clang::ASTContext& context) {
+      // The DiagnosticBuilders of `diag_reporter` can't be shared between
+      // threads, so each worker reports to the DiagnosticsEngine of its own
+      // ASTContext (which also knows the locations in the generated code).
+      DiagnosticReporter chunk_diag_reporter =
+          chunks.size() == 1
+              ? diag_reporter
+              : DiagReporterForDiagEngine(context.getDiagnostics());
+      AnalyzeTemplateFunctionsInSeparateASTContext(
+          chunk_lifetime_contexts[chunk_index], initial_result, result_callback,
+          chunk_diag_reporter, debug_info, chunk.template_usr_to_decl,
+          base_to_overrides, report_mutex, context);
+    };
+
+    // Run `analyze_with_placeholder` in a separate ASTContext on top of an
+    // overlaid filesystem with the `code_with_placeholder` file.
+    RunToolOnCodeWithOverlay(tu->getASTContext(),
+                             chunk.code_with_placeholder.filename,
+                             chunk.code_with_placeholder.code,
+                             analyze_with_placeholder);
+  };
 
-  // Run `analyze_with_placeholder` in a separate ASTContext on top of an
-  // overlaid filesystem with the `code_with_placeholder` file.
-  RunToolOnCodeWithOverlay(tu->getASTContext(), code_with_placeholder.filename,
-                           code_with_placeholder.code,
-                           analyze_with_placeholder);
+  // The first chunk is analyzed on this thread.
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    threads.emplace_back([&, i] {
+      Lifetime::IdScope worker_id_scope;
+      analyze_chunk(i);
+    });
+  }
+  analyze_chunk(0);
+  for (std::thread& thread : threads) thread.join();
 }
 
 }  // namespace lifetimes
@@ -5,21 +5,83 @@
 #ifndef DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_ANALYZE_H_
 #define DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_ANALYZE_H_
 
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 
 #include "lifetime_analysis/lifetime_analysis.h"
+#include "lifetime_analysis/lifetime_summaries.h"
 #include "lifetime_annotations/function_lifetimes.h"
 #include "lifetime_annotations/lifetime_annotations.h"
 #include "clang/AST/Decl.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringSet.h"
 
 namespace clang {
 namespace tidy {
 namespace lifetimes {
 
+// The results of the analysis of a function that its debug info is rendered
+// from.
+struct FunctionDebugSnapshot;
+
+// Measurements of the analysis of a function. A function may be analyzed more
+// than once (e.g. as part of a recursive cycle), and the times, like
+// `num_analyses` and `num_transferred_elements`, add up all of its analyses.
+// The sizes are those at the end of the last analysis.
+struct FunctionAnalysisMetrics {
+  // The time in seconds spent creating the ObjectRepository, running the
+  // dataflow analysis (including building the CFG), turning the constraints
+  // at the exit block into lifetimes, and merging the lifetimes of overrides.
+  double object_repository_seconds = 0;
+  double dataflow_seconds = 0;
+  double constraints_seconds = 0;
+  double overrides_seconds = 0;
+
+  size_t num_analyses = 0;
+  // The number of CFG elements that the dataflow analysis transferred before
+  // reaching a fixpoint; this is a multiple of the size of the CFG that grows
+  // with the number of iterations.
+  size_t num_transferred_elements = 0;
+
+  size_t num_cfg_blocks = 0;
+  // The number of pointees of all pointers in the exit block's points-to map.
+  size_t points_to_map_size = 0;
+
+  double TotalSeconds() const {
+    return object_repository_seconds + dataflow_seconds + constraints_seconds +
+           overrides_seconds;
+  }
+};
+
 // Lifetime analysis debug info for a single function.
+//
+// Rendering the debug info is much more expensive than the analysis, and most
+// of it is never looked at, so the analysis only retains a snapshot of its
+// results. The fields below are empty until Render() is called, which must
+// happen while the function's AST still exists.
 struct FunctionDebugInfo {
+  // Fills in the fields below from `snapshot`, then releases it. Does nothing
+  // if there is no snapshot.
+  void Render();
+
+  // The analysis results that have not been rendered yet.
+  std::shared_ptr<const FunctionDebugSnapshot> snapshot;
+
+  // The number of objects the analysis created, and of constraints at the
+  // exit block. These are known without rendering.
+  size_t num_objects = 0;
+  size_t num_constraints = 0;
+
+  // Measurements of the analysis, which are also known without rendering.
+  FunctionAnalysisMetrics metrics;
+
+  // Returns the counts and `metrics` as a JSON object.
+  std::string MetricsJson() const;
+
   // Human-readable representation of the function's AST.
   std::string ast;
 
@@ -43,8 +105,38 @@ struct FunctionDebugInfo {
 bool IsIsomorphic(const FunctionLifetimes& a, const FunctionLifetimes& b);
 
 // A map from an analyzed function to the corresponding debug info.
-using FunctionDebugInfoMap =
-    llvm::DenseMap<const clang::FunctionDecl*, FunctionDebugInfo>;
+class FunctionDebugInfoMap
+    : public llvm::DenseMap<const clang::FunctionDecl*, FunctionDebugInfo> {
+ public:
+  // Collects debug info for every function analyzed.
+  FunctionDebugInfoMap() = default;
+
+  // Collects debug info only for the functions whose qualified names (e.g.
+  // "ns::S::f") are in `function_names`.
+  explicit FunctionDebugInfoMap(llvm::StringSet<> function_names)
+      : function_names_(std::move(function_names)) {}
+
+  // Returns whether debug info is collected for `func`.
+  bool ShouldCollect(const clang::FunctionDecl* func) const {
+    return !function_names_.has_value() ||
+           function_names_->contains(func->getQualifiedNameAsString());
+  }
+
+  // Returns an empty map that collects debug info for the same functions.
+  FunctionDebugInfoMap CloneEmpty() const {
+    FunctionDebugInfoMap result;
+    result.function_names_ = function_names_;
+    return result;
+  }
+
+ private:
+  std::optional<llvm::StringSet<>> function_names_;
+};
+
+// Returns a summary of the `n` functions in `debug_info` whose analysis took
+// the longest, slowest first, with one line per function.
+std::string SlowestFunctionsReport(const FunctionDebugInfoMap& debug_info,
+                                   size_t n);
 
 // Runs a static analysis on `func` and returns the result.
 FunctionLifetimesOrError AnalyzeFunction(
@@ -54,11 +146,16 @@ FunctionLifetimesOrError AnalyzeFunction(
 
 // Runs a static analysis on all function definitions in `tu`.
 // The map that is returned references functions by their canonical declaration.
+//
+// If `summaries` is given, functions with a summary for their definition are
+// not analyzed again, and the functions analyzed whose lifetimes don't depend
+// on the rest of `tu` are added to it.
 llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>
 AnalyzeTranslationUnit(const clang::TranslationUnitDecl* tu,
                        const LifetimeAnnotationContext& lifetime_context,
                        DiagnosticReporter diag_reporter = {},
-                       FunctionDebugInfoMap* debug_info = nullptr);
+                       FunctionDebugInfoMap* debug_info = nullptr,
+                       LifetimeSummaryStore* summaries = nullptr);
 
 // Callback that is used to report function analysis results.
 // Do not retain the `FunctionDecl*`, the `FunctionLifetimes`, or other objects
@@ -70,15 +167,42 @@ using FunctionAnalysisResultCallback =
     std::function<void(const clang::FunctionDecl* func,
                        const FunctionLifetimesOrError& lifetimes_or_error)>;
 
+// Runs a static analysis on all function definitions in `tu`, like
+// AnalyzeTranslationUnit(), but reports the result for each function through
+// `result_callback` as soon as it is final rather than returning them all at
+// the end. The lifetimes of a function are released once every function that
+// calls it has been reported, so memory use is bounded by the part of the call
+// graph that is still being analyzed. Virtual methods are reported last, as
+// overrides may change their lifetimes until the whole TU is analyzed.
+//
+// If `debug_info` is given, it contains the debug info for a function when the
+// function is reported, and `result_callback` may remove it.
+void AnalyzeTranslationUnitWithCallback(
+    const clang::TranslationUnitDecl* tu,
+    const LifetimeAnnotationContext& lifetime_context,
+    const FunctionAnalysisResultCallback& result_callback,
+    DiagnosticReporter diag_reporter = {},
+    FunctionDebugInfoMap* debug_info = nullptr,
+    LifetimeSummaryStore* summaries = nullptr);
+
 // Runs a static analysis on all function definitions in `tu`.
 // Analyzes and reports results for uninstantiated templates by instantiating
 // them with placeholder types, reporting results via `result_callback`.
+// `summaries` is used as by AnalyzeTranslationUnit(), except for templates.
+//
+// The templates are split into up to `template_workers` chunks, and each chunk
+// is instantiated and analyzed in its own ASTContext on its own thread (the
+// first on the calling thread). `result_callback` is then called from those
+// threads, but never concurrently. With more than one chunk, the diagnostics
+// for the instantiations are reported to the DiagnosticsEngine of their
+// ASTContext rather than through `diag_reporter`.
 void AnalyzeTranslationUnitWithTemplatePlaceholder(
     const clang::TranslationUnitDecl* tu,
     const LifetimeAnnotationContext& lifetime_context,
     const FunctionAnalysisResultCallback& result_callback,
     DiagnosticReporter diag_reporter = {},
-    FunctionDebugInfoMap* debug_info = nullptr);
+    FunctionDebugInfoMap* debug_info = nullptr,
+    LifetimeSummaryStore* summaries = nullptr, unsigned template_workers = 1);
 
 }  // namespace lifetimes
 }  // namespace tidy
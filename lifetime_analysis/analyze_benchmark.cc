@@ -0,0 +1,217 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
+#include "third_party/benchmark/include/benchmark/benchmark.h"
+#include "lifetime_analysis/analyze.h"
+#include "lifetime_annotations/function_lifetimes.h"
+#include "lifetime_annotations/lifetime_annotations.h"
+#include "lifetime_annotations/test/run_on_code.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclBase.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace clang {
+namespace tidy {
+namespace lifetimes {
+namespace {
+
+const clang::FunctionDecl* LookupFunction(llvm::StringRef name,
+                                          const clang::DeclContext& dc) {
+  auto result = dc.lookup(&dc.getParentASTContext().Idents.get(name));
+  CHECK(result.isSingleResult()) << name.str();
+  return clang::cast<clang::FunctionDecl>(result.front());
+}
+
+// Reports the objects and constraints of the functions in `debug_info`,
+// averaged over the functions, so that they're comparable across cases.
+void ReportCounts(benchmark::State& state,
+                  const FunctionDebugInfoMap& debug_info) {
+  size_t objects = 0;
+  size_t constraints = 0;
+  size_t transferred_elements = 0;
+  for (const auto& [func, info] : debug_info) {
+    objects += info.num_objects;
+    constraints += info.num_constraints;
+    transferred_elements += info.metrics.num_transferred_elements;
+  }
+  double functions = debug_info.empty() ? 1 : debug_info.size();
+  state.counters["functions"] = debug_info.size();
+  state.counters["objects"] = objects / functions;
+  state.counters["constraints"] = constraints / functions;
+  state.counters["transferred_elements"] = transferred_elements / functions;
+}
+
+void RunOnCode(llvm::StringRef code,
+               const std::function<void(clang::ASTContext&,
+                                        const LifetimeAnnotationContext&)>&
+                   operation) {
+  CHECK(runOnCodeWithLifetimeHandlers(code, operation,
+                                      {"-fsyntax-only", "-std=c++17"}));
+}
+
+// Benchmarks AnalyzeFunction() on the function named "Target" in `code`.
+void BenchmarkAnalyzeFunction(benchmark::State& state, llvm::StringRef code) {
+  RunOnCode(code, [&state](clang::ASTContext& ast_context,
+                           const LifetimeAnnotationContext& lifetime_context) {
+    const clang::FunctionDecl* target =
+        LookupFunction("Target", *ast_context.getTranslationUnitDecl());
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(AnalyzeFunction(target, lifetime_context));
+    }
+
+    // Collecting debug info has a cost of its own, so the counts are taken
+    // from a separate run.
+    FunctionDebugInfo info;
+    AnalyzeFunction(target, lifetime_context, &info);
+    FunctionDebugInfoMap debug_info;
+    debug_info[target] = info;
+    ReportCounts(state, debug_info);
+  });
+}
+
+// Benchmarks AnalyzeTranslationUnit() on `code`, or
+// AnalyzeTranslationUnitWithTemplatePlaceholder() if `with_placeholder`.
+void BenchmarkAnalyzeTranslationUnit(benchmark::State& state,
+                                     llvm::StringRef code,
+                                     bool with_placeholder = false) {
+  RunOnCode(code, [&state, with_placeholder](
+                      clang::ASTContext& ast_context,
+                      const LifetimeAnnotationContext& lifetime_context) {
+    const clang::TranslationUnitDecl* tu = ast_context.getTranslationUnitDecl();
+    auto analyze = [&](FunctionDebugInfoMap* debug_info) {
+      if (with_placeholder) {
+        AnalyzeTranslationUnitWithTemplatePlaceholder(
+            tu, lifetime_context,
+            [](const clang::FunctionDecl*,
+               const FunctionLifetimesOrError& lifetimes_or_error) {
+              benchmark::DoNotOptimize(lifetimes_or_error);
+            },
+            /*diag_reporter=*/{}, debug_info);
+      } else {
+        benchmark::DoNotOptimize(AnalyzeTranslationUnit(
+            tu, lifetime_context, /*diag_reporter=*/{}, debug_info));
+      }
+    };
+    for (auto _ : state) analyze(nullptr);
+
+    FunctionDebugInfoMap debug_info;
+    analyze(&debug_info);
+    ReportCounts(state, debug_info);
+  });
+}
+
+// Returns a function that copies pointers around `length` times.
+std::string StraightLineCode(int length) {
+  std::string code = "int* Target(int* a, int* b, bool c) {\n  int* p = a;\n";
+  for (int i = 0; i < length; ++i) {
+    absl::StrAppend(&code, "  int* v", i, " = c ? p : b;\n  p = v", i, ";\n");
+  }
+  absl::StrAppend(&code, "  return p;\n}\n");
+  return code;
+}
+
+void BM_AnalyzeStraightLine(benchmark::State& state) {
+  BenchmarkAnalyzeFunction(state, StraightLineCode(state.range(0)));
+}
+BENCHMARK(BM_AnalyzeStraightLine)->Arg(10)->Arg(100)->Arg(400);
+
+void BM_AnalyzeNestedLoops(benchmark::State& state) {
+  BenchmarkAnalyzeFunction(state, R"cpp(
+    struct Node {
+      Node* next;
+      int* value;
+    };
+    int* Target(Node* list, int* fallback, int n) {
+      int* result = fallback;
+      for (int i = 0; i < n; ++i) {
+        for (Node* node = list; node; node = node->next) {
+          for (int j = 0; j < i; ++j) {
+            if (*node->value > j) result = node->value;
+          }
+          if (!node->next) node->next = list;
+        }
+      }
+      return result;
+    }
+  )cpp");
+}
+BENCHMARK(BM_AnalyzeNestedLoops);
+
+void BM_AnalyzeRecursiveCycle(benchmark::State& state) {
+  BenchmarkAnalyzeFunction(state, R"cpp(
+    int* Odd(int* a, int* b, int n);
+    int* Even(int* a, int* b, int n) {
+      if (n == 0) return a;
+      return Odd(b, a, n - 1);
+    }
+    int* Odd(int* a, int* b, int n) {
+      if (n == 0) return b;
+      return Even(a, b, n - 1);
+    }
+    int* Target(int* a, int* b, int n) {
+      return Even(a, b, n);
+    }
+  )cpp");
+}
+BENCHMARK(BM_AnalyzeRecursiveCycle);
+
+void BM_AnalyzeVirtualOverrides(benchmark::State& state) {
+  BenchmarkAnalyzeTranslationUnit(state, R"cpp(
+    struct Base {
+      virtual ~Base() {}
+      virtual int* Get(int* a, int* b) { return a; }
+    };
+    struct Left : Base {
+      int* Get(int* a, int* b) override { return b; }
+    };
+    struct Right : Base {
+      int* Get(int* a, int* b) override { return Base::Get(a, b); }
+    };
+    struct LeftLeft : Left {
+      int* Get(int* a, int* b) override { return Left::Get(b, a); }
+    };
+    int* Target(Base* base, int* a, int* b) {
+      return base->Get(a, b);
+    }
+  )cpp");
+}
+BENCHMARK(BM_AnalyzeVirtualOverrides);
+
+void BM_AnalyzeTemplatePlaceholder(benchmark::State& state) {
+  BenchmarkAnalyzeTranslationUnit(state, R"cpp(
+    template <typename T>
+    struct Pair {
+      T first;
+      T second;
+    };
+    template <typename T>
+    T* First(Pair<T>* pair) {
+      return &pair->first;
+    }
+    template <typename T>
+    T* Pick(Pair<T>* pair, bool second) {
+      return second ? &pair->second : First(pair);
+    }
+  )cpp",
+                                  /*with_placeholder=*/true);
+}
+BENCHMARK(BM_AnalyzeTemplatePlaceholder);
+
+}  // namespace
+}  // namespace lifetimes
+}  // namespace tidy
+}  // namespace clang
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -5,19 +5,23 @@
 #include "lifetime_analysis/builtin_lifetimes.h"
 
 #include <cassert>
+#include <cstddef>
+#include <initializer_list>
 #include <optional>
 #include <string>
 
 #include "lifetime_annotations/function_lifetimes.h"
 #include "lifetime_annotations/lifetime.h"
-#include "lifetime_annotations/lifetime_annotations.h"
 #include "lifetime_annotations/type_lifetimes.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/Type.h"
 #include "clang/AST/TypeLoc.h"
 #include "clang/Basic/Builtins.h"
+#include "clang/Basic/CharInfo.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Error.h"
 
@@ -50,6 +54,78 @@ class ForwardAndMoveFactory : public FunctionLifetimeFactory {
   }
 };
 
+// The lifetimes of a builtin, as written in a lifetime annotation, with each
+// lifetime replaced by the index of its name. The annotation is only parsed
+// once; each call of the builtin then substitutes fresh lifetime variables
+// for the indices.
+struct AnnotatedBuiltin {
+  llvm::SmallVector<unsigned, 4> lifetimes;
+  unsigned num_variables = 0;
+};
+
+AnnotatedBuiltin ParseAnnotation(llvm::StringRef annotation) {
+  auto is_name_char = [](char c) {
+    return clang::isAsciiIdentifierContinue(c);
+  };
+  AnnotatedBuiltin result;
+  llvm::StringMap<unsigned> indices;
+  while (true) {
+    annotation = annotation.drop_until(is_name_char);
+    llvm::StringRef name = annotation.take_while(is_name_char);
+    if (name.empty()) break;
+    annotation = annotation.drop_front(name.size());
+    result.lifetimes.push_back(
+        indices.try_emplace(name, indices.size()).first->second);
+  }
+  result.num_variables = indices.size();
+  return result;
+}
+
+// The builtins whose lifetimes are given by an annotation, by builtin ID.
+const llvm::DenseMap<unsigned, AnnotatedBuiltin>& AnnotatedBuiltins() {
+  static const auto* builtins = [] {
+    auto* builtins = new llvm::DenseMap<unsigned, AnnotatedBuiltin>();
+    auto add = [builtins](std::initializer_list<unsigned> builtin_ids,
+                          llvm::StringRef annotation) {
+      for (unsigned builtin_id : builtin_ids) {
+        (*builtins)[builtin_id] = ParseAnnotation(annotation);
+      }
+    };
+    add({clang::Builtin::BI__builtin_addressof}, "a -> a");
+    add({clang::Builtin::BIstrtod, clang::Builtin::BIstrtof}, "a, (a, b)");
+    add({clang::Builtin::BIstrtoll, clang::Builtin::BIstrtol},
+        "a, (a, b), ()");
+    add({clang::Builtin::BI__builtin_memchr}, "a, (), () -> a");
+    add({clang::Builtin::BI__builtin_strchr,
+         clang::Builtin::BI__builtin_strrchr},
+        "a, () -> a");
+    add({clang::Builtin::BI__builtin_strstr,
+         clang::Builtin::BI__builtin_strpbrk},
+        "a, b -> a");
+    return builtins;
+  }();
+  return *builtins;
+}
+
+FunctionLifetimes InstantiateAnnotatedBuiltin(const clang::FunctionDecl* decl,
+                                              const AnnotatedBuiltin& builtin) {
+  llvm::SmallVector<Lifetime, 4> variables;
+  for (unsigned i = 0; i < builtin.num_variables; ++i) {
+    variables.push_back(Lifetime::CreateVariable());
+  }
+  size_t next = 0;
+  FunctionLifetimes result =
+      FunctionLifetimes::CreateForDecl(
+          decl, FunctionLifetimeFactorySingleCallback(
+                    [&builtin, &variables, &next](const clang::Expr*) {
+                      assert(next < builtin.lifetimes.size());
+                      return variables[builtin.lifetimes[next++]];
+                    }))
+          .get();
+  assert(next == builtin.lifetimes.size());
+  return result;
+}
+
 }  // namespace
 
 FunctionLifetimesOrError GetBuiltinLifetimes(const clang::FunctionDecl* decl) {
@@ -67,23 +143,13 @@ FunctionLifetimesOrError GetBuiltinLifetimes(const clang::FunctionDecl* decl) {
                }))
         .get();
   }
+  const llvm::DenseMap<unsigned, AnnotatedBuiltin>& annotated_builtins =
+      AnnotatedBuiltins();
+  if (auto it = annotated_builtins.find(builtin_id);
+      it != annotated_builtins.end()) {
+    return InstantiateAnnotatedBuiltin(decl, it->second);
+  }
   switch (builtin_id) {
-    case clang::Builtin::BI__builtin_addressof:
-      return ParseLifetimeAnnotations(decl, "a -> a").get();
-    case clang::Builtin::BIstrtod:
-    case clang::Builtin::BIstrtof:
-      return ParseLifetimeAnnotations(decl, "a, (a, b)").get();
-    case clang::Builtin::BIstrtoll:
-    case clang::Builtin::BIstrtol:
-      return ParseLifetimeAnnotations(decl, "a, (a, b), ()").get();
-    case clang::Builtin::BI__builtin_memchr:
-      return ParseLifetimeAnnotations(decl, "a, (), () -> a").get();
-    case clang::Builtin::BI__builtin_strchr:
-    case clang::Builtin::BI__builtin_strrchr:
-      return ParseLifetimeAnnotations(decl, "a, () -> a").get();
-    case clang::Builtin::BI__builtin_strstr:
-    case clang::Builtin::BI__builtin_strpbrk:
-      return ParseLifetimeAnnotations(decl, "a, b -> a").get();
     case clang::Builtin::BIforward:
     case clang::Builtin::BImove: {
       FunctionLifetimes result;
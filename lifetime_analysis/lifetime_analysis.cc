@@ -335,7 +335,7 @@ void TransferInitializer(const Object* dest, clang::QualType type,
 }
 
 LifetimeLattice LifetimeAnalysis::initialElement() {
-  return LifetimeLattice(object_repository_.InitialPointsToMap(),
+  return LifetimeLattice(initial_points_to_map_,
                          object_repository_.InitialSingleValuedObjects());
 }
 
@@ -351,6 +351,7 @@ bool LifetimeAnalysis::IsEqual(const LifetimeLattice& state1,
 void LifetimeAnalysis::transfer(const clang::CFGElement& elt,
                                 LifetimeLattice& state,
                                 clang::dataflow::Environment& /*environment*/) {
+  ++num_transferred_elements_;
   if (state.IsError()) return;
 
   auto cfg_stmt = elt.getAs<clang::CFGStmt>();
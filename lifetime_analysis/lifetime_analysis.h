@@ -5,6 +5,7 @@
 #ifndef DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_LIFETIME_ANALYSIS_H_
 #define DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_LIFETIME_ANALYSIS_H_
 
+#include <cstddef>
 #include <functional>
 #include <string>
 
@@ -77,7 +78,12 @@ class LifetimeAnalysis
         func_(func),
         object_repository_(object_repository),
         callee_lifetimes_(callee_lifetimes),
-        diag_reporter_(diag_reporter) {}
+        diag_reporter_(diag_reporter),
+        initial_points_to_map_(object_repository.InitialPointsToMap()) {
+    // Every lattice element is copied from this map, so they all share its
+    // expressions' object sets.
+    initial_points_to_map_.MakeExprObjectsFlowInsensitive();
+  }
 
   LifetimeLattice initialElement();
 
@@ -88,12 +94,18 @@ class LifetimeAnalysis
   void transfer(const clang::CFGElement& elt, LifetimeLattice& state,
                 clang::dataflow::Environment& environment);
 
+  // Returns the number of CFG elements transferred so far, counting each time
+  // the dataflow analysis visits an element until it reaches a fixpoint.
+  size_t NumTransferredElements() const { return num_transferred_elements_; }
+
  private:
   const clang::FunctionDecl* func_;
   ObjectRepository& object_repository_;
   const llvm::DenseMap<const clang::FunctionDecl*, FunctionLifetimesOrError>&
       callee_lifetimes_;
   const DiagnosticReporter& diag_reporter_;
+  PointsToMap initial_points_to_map_;
+  size_t num_transferred_elements_ = 0;
 };
 
 }  // namespace lifetimes
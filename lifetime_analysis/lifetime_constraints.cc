@@ -8,6 +8,7 @@
 #include <cassert>
 #include <cstddef>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #include "lifetime_annotations/lifetime.h"
@@ -17,8 +18,10 @@
 #include "clang/AST/Type.h"
 #include "clang/Analysis/FlowSensitive/DataflowLattice.h"
 #include "clang/Basic/LLVM.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Error.h"
 
 namespace clang {
@@ -58,28 +61,115 @@ class LifetimeDSU {
   llvm::DenseMap<Lifetime, Lifetime> parent_;
 };
 
-}  // namespace
 
-llvm::DenseSet<Lifetime> LifetimeConstraints::GetOutlivingLifetimes(
-    const Lifetime l) const {
-  // TODO(veluca): here we could certainly reduce complexity, for example by
-  // constructing the constraint graph instead of iterating over all constraints
-  // each time.
-  std::vector<Lifetime> stack{l};
-  llvm::DenseSet<Lifetime> visited;
-  while (!stack.empty()) {
-    Lifetime v = stack.back();
-    stack.pop_back();
-    if (visited.contains(v)) continue;
-    visited.insert(v);
-    for (auto [shorter, longer] : outlives_constraints_) {
-      if (shorter == v) {
-        stack.push_back(longer);
+// The graph of outlives constraints, with an edge from the shorter to the
+// longer lifetime of each.
+//
+// The graph is condensed into its strongly connected components, i.e. sets of
+// lifetimes that are constrained to be equal, and the lifetimes reachable from
+// each component are computed once, so that the lifetimes outliving any given
+// lifetime can be looked up without searching the graph again.
+class OutlivesGraph {
+ public:
+  explicit OutlivesGraph(
+      const llvm::DenseSet<std::pair<Lifetime, Lifetime>>& constraints) {
+    for (auto [shorter, longer] : constraints) {
+      unsigned from = GetOrAddNode(shorter);
+      unsigned to = GetOrAddNode(longer);
+      edges_[from].push_back(to);
+    }
+    index_.assign(lifetimes_.size(), kUnvisited);
+    lowlink_.resize(lifetimes_.size());
+    on_stack_.resize(lifetimes_.size());
+    component_.resize(lifetimes_.size());
+    for (unsigned node = 0; node < lifetimes_.size(); ++node) {
+      if (index_[node] == kUnvisited) Visit(node);
+    }
+  }
+
+  // Returns all the lifetimes that must outlive `l`, not including `l`.
+  llvm::DenseSet<Lifetime> GetOutlivingLifetimes(Lifetime l) const {
+    llvm::DenseSet<Lifetime> result;
+    auto iter = nodes_.find(l);
+    if (iter == nodes_.end()) return result;
+    for (unsigned node : reachable_[component_[iter->second]].set_bits()) {
+      result.insert(lifetimes_[node]);
+    }
+    result.erase(l);
+    return result;
+  }
+
+ private:
+  static constexpr unsigned kUnvisited = ~0u;
+
+  unsigned GetOrAddNode(Lifetime l) {
+    auto [iter, inserted] = nodes_.try_emplace(l, lifetimes_.size());
+    if (inserted) {
+      lifetimes_.push_back(l);
+      edges_.emplace_back();
+    }
+    return iter->second;
+  }
+
+  // Tarjan's algorithm. Components are completed after every component they
+  // reach, so their reachable sets can be computed as they are completed.
+  void Visit(unsigned node) {
+    index_[node] = lowlink_[node] = next_index_++;
+    stack_.push_back(node);
+    on_stack_[node] = true;
+    for (unsigned next : edges_[node]) {
+      if (index_[next] == kUnvisited) {
+        Visit(next);
+        lowlink_[node] = std::min(lowlink_[node], lowlink_[next]);
+      } else if (on_stack_[next]) {
+        lowlink_[node] = std::min(lowlink_[node], index_[next]);
       }
     }
+    if (lowlink_[node] != index_[node]) return;
+
+    unsigned component = reachable_.size();
+    llvm::BitVector& reachable =
+        reachable_.emplace_back(llvm::BitVector(lifetimes_.size()));
+    size_t begin = stack_.size();
+    do {
+      --begin;
+      unsigned member = stack_[begin];
+      on_stack_[member] = false;
+      component_[member] = component;
+      reachable.set(member);
+    } while (stack_[begin] != node);
+    for (size_t i = begin; i < stack_.size(); ++i) {
+      for (unsigned next : edges_[stack_[i]]) {
+        if (component_[next] != component) {
+          reachable |= reachable_[component_[next]];
+        }
+      }
+    }
+    stack_.resize(begin);
   }
-  visited.erase(l);
-  return visited;
+
+  std::vector<Lifetime> lifetimes_;
+  llvm::DenseMap<Lifetime, unsigned> nodes_;
+  std::vector<llvm::SmallVector<unsigned, 2>> edges_;
+
+  // State of Tarjan's algorithm, by node.
+  std::vector<unsigned> index_;
+  std::vector<unsigned> lowlink_;
+  std::vector<bool> on_stack_;
+  std::vector<unsigned> stack_;
+  unsigned next_index_ = 0;
+
+  // The component of each node.
+  std::vector<unsigned> component_;
+  // The nodes reachable from each component, including its own.
+  std::vector<llvm::BitVector> reachable_;
+};
+
+}  // namespace
+
+llvm::DenseSet<Lifetime> LifetimeConstraints::GetOutlivingLifetimes(
+    const Lifetime l) const {
+  return OutlivesGraph(outlives_constraints_).GetOutlivingLifetimes(l);
 }
 
 llvm::Error LifetimeConstraints::ApplyToFunctionLifetimes(
@@ -100,6 +190,7 @@ llvm::Error LifetimeConstraints::ApplyToFunctionLifetimes(
         all_interesting_lifetimes.insert(l);
       });
 
+  const OutlivesGraph graph(outlives_constraints_);
   LifetimeSubstitutions substitutions;
 
   // Keep track of which lifetimes already have their final substitutions
@@ -107,7 +198,8 @@ llvm::Error LifetimeConstraints::ApplyToFunctionLifetimes(
   llvm::DenseSet<Lifetime> already_have_substitutions;
 
   // First of all, substitute everything that outlives 'static with 'static.
-  for (Lifetime outlives_static : GetOutlivingLifetimes(Lifetime::Static())) {
+  for (Lifetime outlives_static :
+       graph.GetOutlivingLifetimes(Lifetime::Static())) {
     if (outlives_static.IsLocal()) {
       return llvm::createStringError(llvm::inconvertibleErrorCode(),
                                      "Function assigns local to static");
@@ -123,7 +215,8 @@ llvm::Error LifetimeConstraints::ApplyToFunctionLifetimes(
   }
 
   for (Lifetime lifetime : all_interesting_lifetimes) {
-    llvm::DenseSet<Lifetime> longer_lifetimes = GetOutlivingLifetimes(lifetime);
+    llvm::DenseSet<Lifetime> longer_lifetimes =
+        graph.GetOutlivingLifetimes(lifetime);
     longer_lifetimes.erase(Lifetime::Static());
 
     // If constrained to be outlived by 'local, replace the lifetime with
@@ -311,9 +404,10 @@ LifetimeConstraints LifetimeConstraints::ForCallableSubstitution(
   callable.Traverse(
       [&all_lifetimes](Lifetime l, Variance) { all_lifetimes.insert(l); });
 
+  const OutlivesGraph graph(constraints.outlives_constraints_);
   LifetimeConstraints ret;
   for (auto l : all_lifetimes) {
-    for (auto outliving : constraints.GetOutlivingLifetimes(l)) {
+    for (auto outliving : graph.GetOutlivingLifetimes(l)) {
       if (all_lifetimes.contains(outliving)) {
         ret.AddOutlivesConstraint(l, outliving);
       }
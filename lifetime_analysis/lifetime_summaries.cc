@@ -0,0 +1,189 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "lifetime_analysis/lifetime_summaries.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "lifetime_annotations/function_lifetimes.h"
+#include "lifetime_annotations/lifetime.h"
+#include "lifetime_annotations/lifetime_annotations.h"
+#include "lifetime_annotations/lifetime_symbol_table.h"
+#include "clang/AST/Decl.h"
+#include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace clang {
+namespace tidy {
+namespace lifetimes {
+
+llvm::Expected<LifetimeSummaryStore> LifetimeSummaryStore::Read(
+    llvm::StringRef path) {
+  LifetimeSummaryStore store;
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    if (buffer.getError() == std::errc::no_such_file_or_directory) {
+      return store;
+    }
+    return llvm::createStringError(
+        buffer.getError(),
+        absl::StrCat(path.str(), ": ", buffer.getError().message()));
+  }
+
+  // Each line is a key and the lifetimes, separated by a tab.
+  llvm::SmallVector<llvm::StringRef> lines;
+  (*buffer)->getBuffer().split(lines, '\n', /*MaxSplit=*/-1,
+                               /*KeepEmpty=*/false);
+  for (llvm::StringRef line : lines) {
+    auto [key, lifetimes] = line.split('\t');
+    if (key.empty() || key.size() == line.size()) {
+      return llvm::createStringError(
+          llvm::inconvertibleErrorCode(),
+          absl::StrCat(path.str(), ": malformed summary: ", line.str()));
+    }
+    store.Insert(key, lifetimes.str());
+  }
+  return store;
+}
+
+llvm::Error LifetimeSummaryStore::Write(llvm::StringRef path) const {
+  std::error_code error;
+  llvm::raw_fd_ostream os(path, error);
+  if (error) {
+    return llvm::createStringError(
+        error, absl::StrCat(path.str(), ": ", error.message()));
+  }
+  // Sort the summaries so that the same store is always written the same way.
+  std::vector<llvm::StringRef> keys;
+  for (const auto& entry : summaries_) keys.push_back(entry.getKey());
+  llvm::sort(keys);
+  for (llvm::StringRef key : keys) {
+    os << key << '\t' << summaries_.lookup(key) << '\n';
+  }
+  os.close();
+  if (os.has_error()) {
+    std::error_code write_error = os.error();
+    os.clear_error();
+    return llvm::createStringError(
+        write_error, absl::StrCat(path.str(), ": ", write_error.message()));
+  }
+  return llvm::Error::success();
+}
+
+namespace {
+
+// Returns the USR of `func`, or an empty string if it has none.
+std::string Usr(const clang::FunctionDecl* func) {
+  llvm::SmallString<128> usr;
+  if (clang::index::generateUSRForDecl(func, usr)) return "";
+  return std::string(usr.str());
+}
+
+}  // namespace
+
+void LifetimeSummaryStore::Insert(llvm::StringRef key, std::string lifetimes) {
+  // The key is the USR followed by `@` and the hash, which has no `@`.
+  llvm::StringRef usr = key.rsplit('@').first;
+  auto [iter, inserted] = declaration_summaries_.try_emplace(usr, lifetimes);
+  if (!inserted && iter->second != lifetimes) iter->second = std::nullopt;
+  summaries_[key] = std::move(lifetimes);
+}
+
+std::string LifetimeSummaryStore::Key(const clang::FunctionDecl* func) {
+  const clang::FunctionDecl* definition = nullptr;
+  if (!func->hasBody(definition)) return "";
+  std::string usr = Usr(definition);
+  if (usr.empty()) return "";
+  // getODRHash() computes the hash on first use and caches it in the decl.
+  unsigned odr_hash =
+      const_cast<clang::FunctionDecl*>(definition)->getODRHash();
+  return absl::StrCat(usr, "@", absl::Hex(odr_hash));
+}
+
+std::optional<FunctionLifetimes> LifetimeSummaryStore::Lookup(
+    const clang::FunctionDecl* func) const {
+  std::string key = Key(func);
+  if (key.empty()) return std::nullopt;
+  auto iter = summaries_.find(key);
+  if (iter == summaries_.end()) return std::nullopt;
+  llvm::Expected<FunctionLifetimes> lifetimes =
+      ParseLifetimeAnnotations(func, iter->second);
+  if (!lifetimes) {
+    llvm::consumeError(lifetimes.takeError());
+    return std::nullopt;
+  }
+  return *std::move(lifetimes);
+}
+
+std::optional<FunctionLifetimes> LifetimeSummaryStore::LookupDeclaration(
+    const clang::FunctionDecl* func, LifetimeSymbolTable* symbol_table) const {
+  std::string usr = Usr(func);
+  if (usr.empty()) return std::nullopt;
+  auto iter = declaration_summaries_.find(usr);
+  if (iter == declaration_summaries_.end() || !iter->second) {
+    return std::nullopt;
+  }
+  llvm::Expected<FunctionLifetimes> lifetimes =
+      ParseLifetimeAnnotations(func, *iter->second, symbol_table);
+  if (!lifetimes) {
+    llvm::consumeError(lifetimes.takeError());
+    return std::nullopt;
+  }
+  return *std::move(lifetimes);
+}
+
+namespace {
+
+// Writes `lifetimes` in the syntax of lifetime annotations, naming lifetime
+// variables in the order they appear.
+std::string FormatLifetimes(const FunctionLifetimes& lifetimes) {
+  LifetimeSymbolTable symbol_table;
+  return lifetimes.DebugString([&symbol_table](Lifetime l) {
+    return symbol_table.LookupLifetimeAndMaybeDeclare(l).str();
+  });
+}
+
+}  // namespace
+
+bool LifetimeSummaryStore::Add(const clang::FunctionDecl* func,
+                               const FunctionLifetimes& lifetimes) {
+  if (lifetimes.HasAny([](Lifetime l) { return l.IsLocal(); })) return false;
+  std::string key = Key(func);
+  if (key.empty()) return false;
+  std::string summary = FormatLifetimes(lifetimes);
+  // Only store lifetimes that read back the same, e.g. not those of types
+  // that annotations can't express.
+  llvm::Expected<FunctionLifetimes> parsed =
+      ParseLifetimeAnnotations(func, summary);
+  if (!parsed) {
+    llvm::consumeError(parsed.takeError());
+    return false;
+  }
+  if (FormatLifetimes(*parsed) != summary) return false;
+  Insert(key, std::move(summary));
+  return true;
+}
+
+bool LifetimeSummaryStore::Contains(const clang::FunctionDecl* func) const {
+  std::string key = Key(func);
+  return !key.empty() && summaries_.count(key);
+}
+
+}  // namespace lifetimes
+}  // namespace tidy
+}  // namespace clang
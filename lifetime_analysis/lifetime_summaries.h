@@ -0,0 +1,85 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_LIFETIME_ANALYSIS_LIFETIME_SUMMARIES_H_
+#define CRUBIT_LIFETIME_ANALYSIS_LIFETIME_SUMMARIES_H_
+
+#include <optional>
+#include <string>
+
+#include "lifetime_annotations/function_lifetimes.h"
+#include "lifetime_annotations/lifetime_symbol_table.h"
+#include "clang/AST/Decl.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+namespace clang {
+namespace tidy {
+namespace lifetimes {
+
+// A store of the lifetimes inferred for functions, which can be shared by the
+// analyses of many translation units, so that a function defined in a header
+// (e.g. an inline function) is only analyzed by the first one that includes
+// it.
+//
+// Summaries are keyed by the function's USR and the ODR hash of its
+// definition, so a function whose definition differs between translation
+// units gets a summary for each. Lifetimes are stored in the syntax of
+// lifetime annotations, e.g. "a, b -> a".
+class LifetimeSummaryStore {
+ public:
+  LifetimeSummaryStore() = default;
+
+  // Reads a store written by Write(). A file that does not exist is read as an
+  // empty store, so that the first analysis of a build can create it.
+  static llvm::Expected<LifetimeSummaryStore> Read(llvm::StringRef path);
+
+  // Writes the store to `path`, replacing it.
+  llvm::Error Write(llvm::StringRef path) const;
+
+  // Returns the key under which the summary of `func` is stored, which is
+  // empty if `func` has no definition or no USR.
+  static std::string Key(const clang::FunctionDecl* func);
+
+  // Returns the stored lifetimes of `func`, with fresh lifetime variables, if
+  // there are any for its current definition.
+  std::optional<FunctionLifetimes> Lookup(
+      const clang::FunctionDecl* func) const;
+
+  // Returns the stored lifetimes of `func` for any of its definitions, so that
+  // they can be used where `func` is only declared (e.g. by the bindings of a
+  // header whose functions are defined in a source file). Returns nullopt if
+  // there are none, or if the definitions stored disagree.
+  //
+  // The lifetime variables are named in `symbol_table`, if given, as if they
+  // had been annotated.
+  std::optional<FunctionLifetimes> LookupDeclaration(
+      const clang::FunctionDecl* func,
+      LifetimeSymbolTable* symbol_table = nullptr) const;
+
+  // Stores the lifetimes of `func`. Returns false, storing nothing, if they
+  // can't be written as annotations (e.g. because they contain local
+  // lifetimes) or `func` has no key.
+  bool Add(const clang::FunctionDecl* func, const FunctionLifetimes& lifetimes);
+
+  // Returns whether there is a summary for the current definition of `func`.
+  bool Contains(const clang::FunctionDecl* func) const;
+
+  size_t size() const { return summaries_.size(); }
+
+ private:
+  // Stores `lifetimes` under `key`, and in `declaration_summaries_`.
+  void Insert(llvm::StringRef key, std::string lifetimes);
+
+  llvm::StringMap<std::string> summaries_;
+  // The lifetimes of each USR, or nullopt if its definitions disagree.
+  llvm::StringMap<std::optional<std::string>> declaration_summaries_;
+};
+
+}  // namespace lifetimes
+}  // namespace tidy
+}  // namespace clang
+
+#endif  // CRUBIT_LIFETIME_ANALYSIS_LIFETIME_SUMMARIES_H_
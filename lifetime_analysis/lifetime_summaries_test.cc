@@ -0,0 +1,199 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "lifetime_analysis/lifetime_summaries.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lifetime_annotations/function_lifetimes.h"
+#include "lifetime_annotations/lifetime.h"
+#include "lifetime_annotations/lifetime_annotations.h"
+#include "lifetime_annotations/lifetime_symbol_table.h"
+#include "lifetime_annotations/test/run_on_code.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+
+namespace clang {
+namespace tidy {
+namespace lifetimes {
+namespace {
+
+const clang::FunctionDecl* getFunction(const clang::ASTContext& ast_context,
+                                       llvm::StringRef name) {
+  using clang::ast_matchers::functionDecl;
+  using clang::ast_matchers::hasName;
+  using clang::ast_matchers::isDefinition;
+  using clang::ast_matchers::match;
+  using clang::ast_matchers::selectFirst;
+
+  return selectFirst<clang::FunctionDecl>(
+      "func", match(functionDecl(hasName(name), isDefinition()).bind("func"),
+                    const_cast<clang::ASTContext&>(ast_context)));
+}
+
+const clang::FunctionDecl* getDeclaration(const clang::ASTContext& ast_context,
+                                          llvm::StringRef name) {
+  using clang::ast_matchers::functionDecl;
+  using clang::ast_matchers::hasName;
+  using clang::ast_matchers::match;
+  using clang::ast_matchers::selectFirst;
+
+  return selectFirst<clang::FunctionDecl>(
+      "func", match(functionDecl(hasName(name)).bind("func"),
+                    const_cast<clang::ASTContext&>(ast_context)));
+}
+
+FunctionLifetimes parse(const clang::FunctionDecl* func,
+                        llvm::StringRef lifetimes) {
+  llvm::Expected<FunctionLifetimes> result =
+      ParseLifetimeAnnotations(func, lifetimes);
+  EXPECT_TRUE(bool(result)) << llvm::toString(result.takeError());
+  return *result;
+}
+
+// Names lifetime variables in the order they appear, so that lifetimes with
+// the same structure are written the same way.
+std::string format(const FunctionLifetimes& lifetimes) {
+  LifetimeSymbolTable symbol_table;
+  return lifetimes.DebugString([&symbol_table](Lifetime l) {
+    return symbol_table.LookupLifetimeAndMaybeDeclare(l).str();
+  });
+}
+
+TEST(LifetimeSummaryStoreTest, AddAndLookup) {
+  runOnCodeWithLifetimeHandlers(
+      "int* f(int* a, int* b) { return a; }"
+      "int* g(int* a) { return a; }",
+      [](const clang::ASTContext& ast_context,
+         const LifetimeAnnotationContext&) {
+        const clang::FunctionDecl* f = getFunction(ast_context, "f");
+        const clang::FunctionDecl* g = getFunction(ast_context, "g");
+        LifetimeSummaryStore store;
+        EXPECT_FALSE(store.Lookup(f).has_value());
+
+        FunctionLifetimes lifetimes = parse(f, "a, b -> a");
+        EXPECT_TRUE(store.Add(f, lifetimes));
+        EXPECT_TRUE(store.Contains(f));
+        EXPECT_FALSE(store.Contains(g));
+        EXPECT_EQ(store.size(), 1);
+
+        std::optional<FunctionLifetimes> summary = store.Lookup(f);
+        ASSERT_TRUE(summary.has_value());
+        // The summary has fresh lifetimes, with the same structure.
+        EXPECT_EQ(format(*summary), "a, b -> a");
+        EXPECT_NE(summary->DebugString(), lifetimes.DebugString());
+      });
+}
+
+TEST(LifetimeSummaryStoreTest, KeyDependsOnDefinition) {
+  std::string f_key;
+  runOnCodeWithLifetimeHandlers(
+      "int* f(int* a, int* b) { return a; }",
+      [&f_key](const clang::ASTContext& ast_context,
+               const LifetimeAnnotationContext&) {
+        f_key = LifetimeSummaryStore::Key(getFunction(ast_context, "f"));
+      });
+  EXPECT_FALSE(f_key.empty());
+
+  runOnCodeWithLifetimeHandlers(
+      "int* f(int* a, int* b) { return a; }",
+      [&f_key](const clang::ASTContext& ast_context,
+               const LifetimeAnnotationContext&) {
+        EXPECT_EQ(LifetimeSummaryStore::Key(getFunction(ast_context, "f")),
+                  f_key);
+      });
+
+  runOnCodeWithLifetimeHandlers(
+      "int* f(int* a, int* b) { return b; }",
+      [&f_key](const clang::ASTContext& ast_context,
+               const LifetimeAnnotationContext&) {
+        EXPECT_NE(LifetimeSummaryStore::Key(getFunction(ast_context, "f")),
+                  f_key);
+      });
+}
+
+TEST(LifetimeSummaryStoreTest, LookupDeclaration) {
+  LifetimeSummaryStore store;
+  runOnCodeWithLifetimeHandlers(
+      "int* f(int* a, int* b) { return a; }"
+      "int* g(int* a, int* b) { return a; }",
+      [&store](const clang::ASTContext& ast_context,
+               const LifetimeAnnotationContext&) {
+        const clang::FunctionDecl* f = getFunction(ast_context, "f");
+        const clang::FunctionDecl* g = getFunction(ast_context, "g");
+        ASSERT_TRUE(store.Add(f, parse(f, "a, b -> a")));
+        ASSERT_TRUE(store.Add(g, parse(g, "a, b -> a")));
+      });
+  // Another definition of `g` disagrees.
+  runOnCodeWithLifetimeHandlers(
+      "int* g(int* a, int* b) { return b; }",
+      [&store](const clang::ASTContext& ast_context,
+               const LifetimeAnnotationContext&) {
+        const clang::FunctionDecl* g = getFunction(ast_context, "g");
+        ASSERT_TRUE(store.Add(g, parse(g, "a, b -> b")));
+      });
+
+  runOnCodeWithLifetimeHandlers(
+      "int* f(int* a, int* b);"
+      "int* g(int* a, int* b);",
+      [&store](const clang::ASTContext& ast_context,
+               const LifetimeAnnotationContext&) {
+        const clang::FunctionDecl* f = getDeclaration(ast_context, "f");
+        EXPECT_FALSE(store.Lookup(f).has_value());
+        LifetimeSymbolTable symbol_table;
+        std::optional<FunctionLifetimes> summary =
+            store.LookupDeclaration(f, &symbol_table);
+        ASSERT_TRUE(summary.has_value());
+        EXPECT_EQ(format(*summary), "a, b -> a");
+        EXPECT_TRUE(symbol_table.LookupName("a").has_value());
+
+        EXPECT_FALSE(store.LookupDeclaration(getDeclaration(ast_context, "g"))
+                         .has_value());
+      });
+}
+
+TEST(LifetimeSummaryStoreTest, WriteAndRead) {
+  llvm::SmallString<128> path;
+  ASSERT_FALSE(
+      llvm::sys::fs::createTemporaryFile("lifetime_summaries", "txt", path));
+  llvm::sys::fs::remove(path);
+
+  llvm::Expected<LifetimeSummaryStore> empty = LifetimeSummaryStore::Read(path);
+  ASSERT_TRUE(bool(empty)) << llvm::toString(empty.takeError());
+  EXPECT_EQ(empty->size(), 0);
+
+  runOnCodeWithLifetimeHandlers(
+      "int* f(int* a, int* b) { return a; }",
+      [&path](const clang::ASTContext& ast_context,
+              const LifetimeAnnotationContext&) {
+        const clang::FunctionDecl* f = getFunction(ast_context, "f");
+        LifetimeSummaryStore store;
+        ASSERT_TRUE(store.Add(f, parse(f, "a, b -> a")));
+        llvm::Error write_error = store.Write(path);
+        ASSERT_FALSE(bool(write_error))
+            << llvm::toString(std::move(write_error));
+
+        llvm::Expected<LifetimeSummaryStore> read =
+            LifetimeSummaryStore::Read(path);
+        ASSERT_TRUE(bool(read)) << llvm::toString(read.takeError());
+        EXPECT_EQ(read->size(), 1);
+        std::optional<FunctionLifetimes> summary = read->Lookup(f);
+        ASSERT_TRUE(summary.has_value());
+        EXPECT_EQ(format(*summary), "a, b -> a");
+      });
+  llvm::sys::fs::remove(path);
+}
+
+}  // namespace
+}  // namespace lifetimes
+}  // namespace tidy
+}  // namespace clang
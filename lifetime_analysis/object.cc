@@ -5,6 +5,7 @@
 #include "lifetime_analysis/object.h"
 
 #include <cassert>
+#include <cstddef>
 #include <optional>
 #include <ostream>
 #include <string>
@@ -21,10 +22,11 @@ namespace tidy {
 namespace lifetimes {
 
 Object::Object(Lifetime lifetime, clang::QualType type,
-               std::optional<FunctionLifetimes> func_lifetimes)
+               std::optional<FunctionLifetimes> func_lifetimes, size_t index)
     : lifetime_(lifetime),
       type_(type),
-      func_lifetimes_(std::move(func_lifetimes)) {
+      func_lifetimes_(std::move(func_lifetimes)),
+      index_(index) {
   assert(!type.isNull());
 }
 
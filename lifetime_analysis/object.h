@@ -5,6 +5,7 @@
 #ifndef DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_OBJECT_H_
 #define DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_OBJECT_H_
 
+#include <cstddef>
 #include <optional>
 #include <ostream>
 #include <string>
@@ -32,13 +33,18 @@ class Object {
   // This constructor should only be used in tests. Outside of tests, use
   // one of the ObjectRepository::CreateObject...() functions.
   Object(Lifetime lifetime, clang::QualType type,
-         std::optional<FunctionLifetimes> func_lifetimes);
+         std::optional<FunctionLifetimes> func_lifetimes, size_t index = 0);
 
   // Returns the lifetime of the object.
   Lifetime GetLifetime() const { return lifetime_; }
 
   clang::QualType Type() const { return type_; }
 
+  // Returns the position of the object among the objects created by its
+  // ObjectRepository, so that data about the objects can be kept in a vector
+  // rather than a map.
+  size_t Index() const { return index_; }
+
   // Returns a textual representation of the object for debug logging.
   std::string DebugString() const;
 
@@ -52,6 +58,7 @@ class Object {
   Lifetime lifetime_;
   clang::QualType type_;
   std::optional<FunctionLifetimes> func_lifetimes_;
+  size_t index_;
 };
 
 std::ostream& operator<<(std::ostream& os, Object object);
@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <cstddef>
+#include <memory>
 #include <optional>
 #include <string>
 #include <utility>
@@ -579,13 +580,13 @@ const Object* ObjectRepository::GetOriginalParameterValue(
 FunctionLifetimes ObjectRepository::GetOriginalFunctionLifetimes() const {
   FunctionLifetimes ret;
   auto get_initial_lifetimes_or_die = [&](const Object* object) {
-    auto iter = initial_object_lifetimes_.find(object);
-    if (iter == initial_object_lifetimes_.end()) {
+    if (object->Index() >= initial_object_lifetimes_.size() ||
+        !initial_object_lifetimes_[object->Index()].has_value()) {
       llvm::errs() << "Didn't find lifetimes for object "
                    << object->DebugString();
       llvm::report_fatal_error("Didn't find lifetimes for object");
     }
-    return iter->second;
+    return *initial_object_lifetimes_[object->Index()];
   };
   ret.return_lifetimes_ =
       get_initial_lifetimes_or_die(GetReturnObject()).GetValueLifetimes();
@@ -780,31 +781,6 @@ llvm::SmallVector<std::string> GetFieldLifetimeArguments(
   return ret;
 }
 
-template <typename CallbackField, typename CallackBase>
-void ForEachFieldAndBase(clang::QualType record_type,
-                         const ObjectLifetimes& object_lifetimes,
-                         const CallbackField& callback_field,
-                         const CallackBase& callback_base) {
-  assert(record_type->isRecordType());
-  for (clang::FieldDecl* f :
-       record_type->getAs<clang::RecordType>()->getDecl()->fields()) {
-    ObjectLifetimes field_lifetimes = object_lifetimes.GetFieldOrBaseLifetimes(
-        f->getType(), GetFieldLifetimeArguments(f));
-    callback_field(field_lifetimes, f);
-  }
-  if (auto* cxxrecord = clang::dyn_cast<clang::CXXRecordDecl>(
-          record_type->getAs<clang::RecordType>()->getDecl())) {
-    for (const clang::CXXBaseSpecifier& base : cxxrecord->bases()) {
-      clang::QualType base_type = base.getType();
-      auto base_object_lifetimes = object_lifetimes.GetFieldOrBaseLifetimes(
-          base_type, GetLifetimeParameters(base_type));
-      callback_base(base_object_lifetimes, &*base_type.getCanonicalType());
-      ForEachFieldAndBase(base.getType(), base_object_lifetimes, callback_field,
-                          callback_base);
-    }
-  }
-}
-
 }  // namespace
 
 class ObjectRepository::ObjectCreator {
@@ -834,7 +810,7 @@ class ObjectRepository::ObjectCreator {
         function_lifetimes);
     object_cache_[object_lifetimes] = obj;
 
-    object_repository_.initial_object_lifetimes_[obj] = object_lifetimes;
+    object_repository_.SetInitialObjectLifetimes(obj, object_lifetimes);
 
     if (type->isIncompleteType()) {
       // Nothing we can do.
@@ -873,6 +849,29 @@ class ObjectRepository::ObjectCreator {
   }
 
  private:
+  template <typename CallbackField, typename CallbackBase>
+  void ForEachFieldAndBase(clang::QualType record_type,
+                           const ObjectLifetimes& object_lifetimes,
+                           const CallbackField& callback_field,
+                           const CallbackBase& callback_base) {
+    assert(record_type->isRecordType());
+    const RecordLayout& layout =
+        object_repository_.GetRecordLayout(record_type);
+    for (const RecordLayout::Field& field : layout.fields) {
+      ObjectLifetimes field_lifetimes =
+          object_lifetimes.GetFieldOrBaseLifetimes(field.field->getType(),
+                                                   field.lifetime_args);
+      callback_field(field_lifetimes, field.field);
+    }
+    for (const RecordLayout::Base& base : layout.bases) {
+      auto base_object_lifetimes = object_lifetimes.GetFieldOrBaseLifetimes(
+          base.type, base.lifetime_params);
+      callback_base(base_object_lifetimes, &*base.type.getCanonicalType());
+      ForEachFieldAndBase(base.type, base_object_lifetimes, callback_field,
+                          callback_base);
+    }
+  }
+
   ObjectRepository& object_repository_;
   PointsToMap& points_to_map_;
   // We re-use the same Object for all the sub-objects with the same type and
@@ -880,6 +879,26 @@ class ObjectRepository::ObjectCreator {
   llvm::DenseMap<ObjectLifetimes, const Object*> object_cache_;
 };
 
+const ObjectRepository::RecordLayout& ObjectRepository::GetRecordLayout(
+    clang::QualType record_type) {
+  std::unique_ptr<RecordLayout>& layout =
+      record_layouts_[record_type.getCanonicalType().getTypePtr()];
+  if (layout) return *layout;
+  layout = std::make_unique<RecordLayout>();
+  const clang::RecordDecl* record_decl =
+      record_type->getAs<clang::RecordType>()->getDecl();
+  for (const clang::FieldDecl* f : record_decl->fields()) {
+    layout->fields.push_back({f, GetFieldLifetimeArguments(f)});
+  }
+  if (auto* cxxrecord = clang::dyn_cast<clang::CXXRecordDecl>(record_decl)) {
+    for (const clang::CXXBaseSpecifier& base : cxxrecord->bases()) {
+      layout->bases.push_back(
+          {base.getType(), GetLifetimeParameters(base.getType())});
+    }
+  }
+  return *layout;
+}
+
 const Object* ObjectRepository::CreateObject(
     const ObjectLifetimes& object_lifetimes, PointsToMap& points_to_map) {
   ObjectCreator object_creator(*this, points_to_map);
@@ -897,7 +916,15 @@ const Object* ObjectRepository::CreateObject(clang::QualType type,
 
 template <typename... Args>
 const Object* ObjectRepository::ConstructObject(Args&&... args) {
-  return new (object_allocator_.Allocate()) Object(args...);
+  return new (object_allocator_.Allocate()) Object(args..., num_objects_++);
+}
+
+void ObjectRepository::SetInitialObjectLifetimes(
+    const Object* object, const ObjectLifetimes& object_lifetimes) {
+  if (object->Index() >= initial_object_lifetimes_.size()) {
+    initial_object_lifetimes_.resize(num_objects_);
+  }
+  initial_object_lifetimes_[object->Index()] = object_lifetimes;
 }
 
 // Clones an object and its base classes and fields, if any.
@@ -914,7 +941,11 @@ const Object* ObjectRepository::CloneObject(const Object* object) {
     return new_obj;
   };
   const Object* new_root = clone(object);
-  initial_object_lifetimes_[new_root] = initial_object_lifetimes_[object];
+  if (object->Index() < initial_object_lifetimes_.size() &&
+      initial_object_lifetimes_[object->Index()].has_value()) {
+    SetInitialObjectLifetimes(new_root,
+                              *initial_object_lifetimes_[object->Index()]);
+  }
   std::vector<ObjectPair> object_stack{{object, new_root}};
   while (!object_stack.empty()) {
     auto [orig_object, new_object] = object_stack.back();
@@ -6,9 +6,11 @@
 #define DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_OBJECT_REPOSITORY_H_
 
 #include <cstddef>
+#include <memory>
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "lifetime_analysis/object.h"
 #include "lifetime_analysis/object_set.h"
@@ -96,6 +98,9 @@ class ObjectRepository {
   // Returns a human-readable representation of the mapping.
   std::string DebugString() const;
 
+  // Returns the number of objects that have been created.
+  size_t NumObjects() const { return num_objects_; }
+
   const_iterator begin() const { return object_repository_.begin(); }
   const_iterator end() const { return object_repository_.end(); }
 
@@ -244,11 +249,35 @@ class ObjectRepository {
 
   const Object* CloneObject(const Object* object);
 
+  void SetInitialObjectLifetimes(const Object* object,
+                                 const ObjectLifetimes& object_lifetimes);
+
+  // The fields and bases of a record type, with the lifetime arguments that
+  // ObjectLifetimes::GetFieldOrBaseLifetimes() needs for each of them. These
+  // come from attributes that are costly to evaluate, so they are computed
+  // once per record type rather than for every object of the type.
+  struct RecordLayout {
+    struct Field {
+      const clang::FieldDecl* field;
+      llvm::SmallVector<std::string> lifetime_args;
+    };
+    struct Base {
+      clang::QualType type;
+      llvm::SmallVector<std::string> lifetime_params;
+    };
+    llvm::SmallVector<Field> fields;
+    llvm::SmallVector<Base> bases;
+  };
+
+  const RecordLayout& GetRecordLayout(clang::QualType record_type);
+
   std::optional<const Object*> GetFieldObjectInternal(
       const Object* struct_object, const clang::FieldDecl* field) const;
 
-  // Owns all the `const Object*` members of the object repository.
+  // Owns all the `const Object*` members of the object repository. The
+  // objects are allocated contiguously and numbered in order of creation.
   llvm::SpecificBumpPtrAllocator<Object> object_allocator_;
+  size_t num_objects_ = 0;
 
   // Map from each variable declaration to the object which it declares.
   MapType object_repository_;
@@ -295,7 +324,14 @@ class ObjectRepository {
 
   const clang::FunctionDecl* func_ = nullptr;
 
-  llvm::DenseMap<const Object*, ObjectLifetimes> initial_object_lifetimes_;
+  // The lifetimes that each object was created with, indexed by
+  // `Object::Index()`.
+  std::vector<std::optional<ObjectLifetimes>> initial_object_lifetimes_;
+
+  // Keyed by canonical record type. The layouts are allocated separately so
+  // that references to them stay valid while the layouts of bases are added.
+  llvm::DenseMap<const clang::Type*, std::unique_ptr<RecordLayout>>
+      record_layouts_;
 
   class ObjectCreator;
 };
@@ -5,22 +5,29 @@
 #ifndef DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_OBJECT_SET_H_
 #define DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_OBJECT_SET_H_
 
+#include <algorithm>
 #include <cstddef>
+#include <functional>
 #include <initializer_list>
+#include <iterator>
 #include <ostream>
 #include <string>
 
 #include "lifetime_analysis/object.h"
-#include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/SmallVector.h"
 
 namespace clang {
 namespace tidy {
 namespace lifetimes {
 
 // A set of `Object`s.
+//
+// The objects are kept in a vector sorted by address, so that membership is a
+// binary search over contiguous memory, and set operations are linear merges
+// rather than a lookup per element.
 class ObjectSet {
  public:
-  using const_iterator = llvm::SmallSet<const Object*, 2>::const_iterator;
+  using const_iterator = llvm::SmallVector<const Object*, 2>::const_iterator;
   using value_type = const Object*;
 
   ObjectSet() = default;
@@ -33,7 +40,7 @@ class ObjectSet {
   // Initializes the object set with `objects`.
   ObjectSet(std::initializer_list<const Object*> objects) {
     for (const Object* object : objects) {
-      objects_.insert(object);
+      Add(object);
     }
   }
 
@@ -50,25 +57,25 @@ class ObjectSet {
 
   // Returns whether this set contains `object`.
   bool Contains(const Object* object) const {
-    return objects_.contains(object);
+    return std::binary_search(objects_.begin(), objects_.end(), object,
+                              Less());
   }
 
   // Returns whether this set contains all objects in `other`, i.e. whether
   // this set is a superset of `other`.
   bool Contains(const ObjectSet& other) const {
-    for (const Object* object : other) {
-      if (!Contains(object)) {
-        return false;
-      }
-    }
-    return true;
+    return std::includes(objects_.begin(), objects_.end(),
+                         other.objects_.begin(), other.objects_.end(), Less());
   }
 
   // Returns a `ObjectSet` containing the union of the pointees from this
   // `ObjectSet` and `other`.
   ObjectSet Union(const ObjectSet& other) const {
-    ObjectSet result = *this;
-    result.Add(other);
+    ObjectSet result;
+    result.objects_.reserve(objects_.size() + other.objects_.size());
+    std::set_union(objects_.begin(), objects_.end(), other.objects_.begin(),
+                   other.objects_.end(), std::back_inserter(result.objects_),
+                   Less());
     return result;
   }
 
@@ -76,18 +83,29 @@ class ObjectSet {
   // `ObjectSet` and `other`.
   ObjectSet Intersection(const ObjectSet& other) const {
     ObjectSet result;
-    for (const Object* obj : *this) {
-      if (other.Contains(obj)) result.Add(obj);
-    }
+    std::set_intersection(objects_.begin(), objects_.end(),
+                          other.objects_.begin(), other.objects_.end(),
+                          std::back_inserter(result.objects_), Less());
     return result;
   }
 
   // Adds `object` to this object set.
-  void Add(const Object* object) { objects_.insert(object); }
+  void Add(const Object* object) {
+    auto iter =
+        std::lower_bound(objects_.begin(), objects_.end(), object, Less());
+    if (iter == objects_.end() || *iter != object) {
+      objects_.insert(iter, object);
+    }
+  }
 
   // Adds the `other` objects to this object set.
   void Add(const ObjectSet& other) {
-    objects_.insert(other.objects_.begin(), other.objects_.end());
+    if (other.empty() || Contains(other)) return;
+    if (empty()) {
+      objects_ = other.objects_;
+      return;
+    }
+    *this = Union(other);
   }
 
   bool operator==(const ObjectSet& other) const {
@@ -96,12 +114,15 @@ class ObjectSet {
   bool operator!=(const ObjectSet& other) const { return !(*this == other); }
 
  private:
+  using Less = std::less<const Object*>;
+
   friend std::ostream& operator<<(std::ostream& os,
                                   const ObjectSet& object_set) {
     return os << object_set.DebugString();
   }
 
-  llvm::SmallSet<const Object*, 2> objects_;
+  // Sorted by `Less`, without duplicates.
+  llvm::SmallVector<const Object*, 2> objects_;
 };
 
 }  // namespace lifetimes
@@ -78,6 +78,25 @@ TEST(ObjectSet, Union) {
       {});
 }
 
+TEST(ObjectSet, Intersection) {
+  runOnCodeWithLifetimeHandlers(
+      "",
+      [](const clang::ASTContext& ast_context,
+         const LifetimeAnnotationContext&) {
+        Object o1(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        Object o2(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        Object o3(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+
+        EXPECT_THAT(ObjectSet({&o3, &o1, &o2}).Intersection({&o2, &o3}),
+                    UnorderedElementsAre(&o2, &o3));
+        EXPECT_THAT(ObjectSet({&o1}).Intersection({&o2, &o3}),
+                    UnorderedElementsAre());
+        EXPECT_EQ(ObjectSet({&o1, &o2}).Intersection({&o2, &o1}),
+                  ObjectSet({&o2, &o1}));
+      },
+      {});
+}
+
 TEST(ObjectSet, Add) {
   runOnCodeWithLifetimeHandlers(
       "",
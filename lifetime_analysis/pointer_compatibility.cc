@@ -34,6 +34,12 @@ bool PointeesCompatible(clang::QualType pointee_type,
   pointee_type = pointee_type.getCanonicalType();
   object_type = object_type.getCanonicalType();
 
+  // The common case, which hasSimilarType() would also accept after the checks
+  // below.
+  if (pointee_type.getUnqualifiedType() == object_type.getUnqualifiedType()) {
+    return true;
+  }
+
   // `void *`, `char *`, `unsigned char *` and `std::byte *` are allowed to
   // point at anything.
   if (pointee_type->isVoidType() || pointee_type->isCharType() ||
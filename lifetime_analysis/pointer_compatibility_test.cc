@@ -80,6 +80,10 @@ TEST(PointerCompatibilityTest, MayPointTo) {
 
         // Trivial case: A pointer can point to its exact pointee type.
         EXPECT_TRUE(MayPointTo(pointer_to(base_type), base_type, ast_context));
+        EXPECT_TRUE(MayPointTo(pointer_to(base_type.withConst()), base_type,
+                               ast_context));
+        EXPECT_TRUE(MayPointTo(pointer_to(base_type), base_type.withConst(),
+                               ast_context));
 
         // void pointers and character pointers may point to anything.
         EXPECT_TRUE(MayPointTo(pointer_to(void_type), base_type, ast_context));
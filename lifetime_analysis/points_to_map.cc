@@ -4,7 +4,9 @@
 
 #include "lifetime_analysis/points_to_map.h"
 
+#include <algorithm>
 #include <cassert>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -16,6 +18,7 @@
 #include "lifetime_annotations/lifetime.h"
 #include "clang/AST/Expr.h"
 #include "clang/Basic/LLVM.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -23,18 +26,59 @@ namespace clang {
 namespace tidy {
 namespace lifetimes {
 
+namespace {
+
+// Returns the union of the maps `a` and `b` from entities to object sets,
+// sharing the contents of `a` or `b` if that is the union.
+template <typename Map>
+std::shared_ptr<Map> UnionMaps(const std::shared_ptr<Map>& a,
+                               const std::shared_ptr<Map>& b) {
+  if (a == b || !b || b->empty()) return a;
+  if (!a || a->empty()) return b;
+  // At a fixpoint, `a` typically subsumes `b` already.
+  bool a_subsumes_b = llvm::all_of(*b, [&a](const auto& entry) {
+    auto iter = a->find(entry.first);
+    return iter != a->end() && iter->second.Contains(entry.second);
+  });
+  if (a_subsumes_b) return a;
+  auto result = std::make_shared<Map>(*a);
+  for (const auto& [key, objects] : *b) {
+    (*result)[key].Add(objects);
+  }
+  return result;
+}
+
+// Returns whether the maps `a` and `b` have the same contents, where null is
+// the empty map.
+template <typename Map>
+bool MapsEqual(const std::shared_ptr<Map>& a, const std::shared_ptr<Map>& b) {
+  if (a == b) return true;
+  if (!a) return b->empty();
+  if (!b) return a->empty();
+  return *a == *b;
+}
+
+}  // namespace
+
 bool PointsToMap::operator==(const PointsToMap& other) const {
-  return pointer_points_tos_ == other.pointer_points_tos_ &&
-         expr_objects_ == other.expr_objects_;
+  if (!MapsEqual(pointer_points_tos_, other.pointer_points_tos_)) return false;
+  if (flow_insensitive_exprs_ &&
+      flow_insensitive_exprs_ == other.flow_insensitive_exprs_) {
+    return expr_generation_ == other.expr_generation_;
+  }
+  if (flow_insensitive_exprs_ || other.flow_insensitive_exprs_) {
+    return ExprObjects() == other.ExprObjects();
+  }
+  return MapsEqual(expr_objects_, other.expr_objects_);
 }
 
 std::string PointsToMap::DebugString() const {
   std::vector<std::string> parts;
-  for (const auto& [pointer, points_to] : pointer_points_tos_) {
+  for (const auto& [pointer, points_to] : Get(pointer_points_tos_)) {
     parts.push_back(absl::StrFormat("%s -> %s", pointer->DebugString(),
                                     points_to.DebugString()));
   }
-  for (const auto& [expr, objects] : expr_objects_) {
+  for (const auto& [expr, objects] : ExprObjects()) {
     parts.push_back(absl::StrFormat("%s (%p) -> %s", expr->getStmtClassName(),
                                     expr, objects.DebugString()));
   }
@@ -43,32 +87,53 @@ std::string PointsToMap::DebugString() const {
 
 PointsToMap PointsToMap::Union(const PointsToMap& other) const {
   PointsToMap result;
-
-  result.pointer_points_tos_ = pointer_points_tos_;
-  for (const auto& [pointer, points_to] : other.pointer_points_tos_) {
-    result.pointer_points_tos_[pointer].Add(points_to);
+  result.pointer_points_tos_ =
+      UnionMaps(pointer_points_tos_, other.pointer_points_tos_);
+  if (result.pointer_points_tos_ == pointer_points_tos_) {
+    result.lifetime_index_ = lifetime_index_;
+  } else if (result.pointer_points_tos_ == other.pointer_points_tos_) {
+    result.lifetime_index_ = other.lifetime_index_;
   }
   // TODO(mboehme): Do we even need to perform a union on expression object
   // sets?
-  result.expr_objects_ = expr_objects_;
-  for (const auto& [expr, objects] : other.expr_objects_) {
-    result.expr_objects_[expr].Add(objects);
+  if (flow_insensitive_exprs_ &&
+      flow_insensitive_exprs_ == other.flow_insensitive_exprs_) {
+    result.flow_insensitive_exprs_ = flow_insensitive_exprs_;
+    result.expr_generation_ =
+        std::max(expr_generation_, other.expr_generation_);
+  } else if (flow_insensitive_exprs_ || other.flow_insensitive_exprs_) {
+    // Maps from different analyses; this doesn't happen within one.
+    ExprMap& expr_objects = GetMutable(result.expr_objects_);
+    expr_objects = ExprObjects();
+    for (const auto& [expr, objects] : other.ExprObjects()) {
+      expr_objects[expr].Add(objects);
+    }
+  } else {
+    result.expr_objects_ = UnionMaps(expr_objects_, other.expr_objects_);
   }
-
   return result;
 }
 
 ObjectSet PointsToMap::GetPointerPointsToSet(const Object* pointer) const {
-  auto iter = pointer_points_tos_.find(pointer);
-  if (iter == pointer_points_tos_.end()) {
+  const PointerMap& pointer_points_tos = Get(pointer_points_tos_);
+  auto iter = pointer_points_tos.find(pointer);
+  if (iter == pointer_points_tos.end()) {
     return ObjectSet();
   }
   return iter->second;
 }
 
+ObjectSet& PointsToMap::GetMutablePointsToSet(const Object* pointer) {
+  auto [iter, inserted] = GetMutable(pointer_points_tos_).try_emplace(pointer);
+  if (inserted) {
+    lifetime_index_.reset();
+  }
+  return iter->second;
+}
+
 void PointsToMap::SetPointerPointsToSet(const Object* pointer,
                                         ObjectSet points_to) {
-  pointer_points_tos_[pointer] = std::move(points_to);
+  GetMutablePointsToSet(pointer) = std::move(points_to);
 }
 
 void PointsToMap::SetPointerPointsToSet(const ObjectSet& pointers,
@@ -80,15 +145,21 @@ void PointsToMap::SetPointerPointsToSet(const ObjectSet& pointers,
 
 void PointsToMap::ExtendPointerPointsToSet(const Object* pointer,
                                            const ObjectSet& points_to) {
-  ObjectSet& set = pointer_points_tos_[pointer];
-  set.Add(points_to);
+  const PointerMap& pointer_points_tos = Get(pointer_points_tos_);
+  auto iter = pointer_points_tos.find(pointer);
+  // Avoid unsharing the map if there is nothing to add.
+  if (iter != pointer_points_tos.end() && iter->second.Contains(points_to)) {
+    return;
+  }
+  GetMutablePointsToSet(pointer).Add(points_to);
 }
 
 ObjectSet PointsToMap::GetPointerPointsToSet(const ObjectSet& pointers) const {
+  const PointerMap& pointer_points_tos = Get(pointer_points_tos_);
   ObjectSet result;
   for (const Object* pointer : pointers) {
-    auto iter = pointer_points_tos_.find(pointer);
-    if (iter != pointer_points_tos_.end()) {
+    auto iter = pointer_points_tos.find(pointer);
+    if (iter != pointer_points_tos.end()) {
       result.Add(iter->second);
     }
   }
@@ -107,8 +178,9 @@ ObjectSet PointsToMap::GetExprObjectSet(const clang::Expr* expr) const {
          expr->getType()->isArrayType() || expr->getType()->isFunctionType() ||
          expr->getType()->isBuiltinType());
 
-  auto iter = expr_objects_.find(expr);
-  if (iter == expr_objects_.end()) {
+  const ExprMap& expr_objects = ExprObjects();
+  auto iter = expr_objects.find(expr);
+  if (iter == expr_objects.end()) {
     llvm::errs() << "Didn't find object set for expression:\n";
     expr->dump();
     llvm::report_fatal_error("Didn't find object set for expression");
@@ -117,25 +189,47 @@ ObjectSet PointsToMap::GetExprObjectSet(const clang::Expr* expr) const {
 }
 
 bool PointsToMap::ExprHasObjectSet(const clang::Expr* expr) const {
-  auto iter = expr_objects_.find(expr->IgnoreParens());
-  return (iter != expr_objects_.end());
+  const ExprMap& expr_objects = ExprObjects();
+  auto iter = expr_objects.find(expr->IgnoreParens());
+  return (iter != expr_objects.end());
 }
 
 void PointsToMap::SetExprObjectSet(const clang::Expr* expr, ObjectSet objects) {
   assert(expr->isGLValue() || expr->getType()->isPointerType() ||
          expr->getType()->isArrayType() || expr->getType()->isBuiltinType());
-  expr_objects_[expr] = std::move(objects);
+  if (!flow_insensitive_exprs_) {
+    GetMutable(expr_objects_)[expr] = std::move(objects);
+    return;
+  }
+  auto [iter, inserted] = flow_insensitive_exprs_->objects.try_emplace(expr);
+  if (inserted || !iter->second.Contains(objects)) {
+    iter->second.Add(objects);
+    expr_generation_ = ++flow_insensitive_exprs_->generation;
+  }
+}
+
+void PointsToMap::MakeExprObjectsFlowInsensitive() {
+  if (flow_insensitive_exprs_) return;
+  flow_insensitive_exprs_ = std::make_shared<FlowInsensitiveExprObjects>();
+  flow_insensitive_exprs_->objects = Get(expr_objects_);
+  expr_objects_.reset();
+  expr_generation_ = 0;
 }
 
 std::vector<const Object*> PointsToMap::GetAllPointersWithLifetime(
     Lifetime lifetime) const {
-  std::vector<const Object*> result;
-  for (const auto& [pointer, _] : pointer_points_tos_) {
-    if (pointer->GetLifetime() == lifetime) {
-      result.push_back(pointer);
+  if (!lifetime_index_) {
+    auto index = std::make_shared<LifetimeIndex>();
+    for (const auto& [pointer, _] : Get(pointer_points_tos_)) {
+      (*index)[pointer->GetLifetime()].push_back(pointer);
     }
+    lifetime_index_ = std::move(index);
   }
-  return result;
+  auto iter = lifetime_index_->find(lifetime);
+  if (iter == lifetime_index_->end()) {
+    return {};
+  }
+  return iter->second;
 }
 
 }  // namespace lifetimes
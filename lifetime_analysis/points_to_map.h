@@ -5,6 +5,8 @@
 #ifndef DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_POINTS_TO_MAP_H_
 #define DEVTOOLS_RUST_CC_INTEROP_LIFETIME_ANALYSIS_POINTS_TO_MAP_H_
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -37,6 +39,11 @@ namespace lifetimes {
 // The PointsToMap class does not enforce these type relationships because we
 // intend to allow type punning (at least within the implementations of
 // functions).
+//
+// The maps are shared between copies of a `PointsToMap` until one of them is
+// changed, so copying a `PointsToMap` (as the lattice does for every CFG
+// block) is cheap, and joins and comparisons of maps that still share their
+// contents don't need to look at the entries.
 class PointsToMap {
  public:
   PointsToMap() = default;
@@ -53,7 +60,7 @@ class PointsToMap {
   std::string DebugString() const;
 
   const llvm::DenseMap<const Object*, ObjectSet>& PointerPointsTos() const {
-    return pointer_points_tos_;
+    return Get(pointer_points_tos_);
   }
 
   // Returns a `PointsToMap` containing the union of mappings from this map and
@@ -90,19 +97,85 @@ class PointsToMap {
   // expressions.
   ObjectSet GetExprObjectSet(const clang::Expr* expr) const;
 
-  // Associates `expr` with the given object set.
+  // Associates `expr` with the given object set. If expression object sets are
+  // flow-insensitive, adds `objects` to the object set of `expr` instead.
   void SetExprObjectSet(const clang::Expr* expr, ObjectSet objects);
 
+  // Makes the object sets of expressions flow-insensitive: this map and all
+  // copies made from it from now on share a single table of them, which
+  // SetExprObjectSet() only ever adds to.
+  //
+  // This is how the dataflow analysis keeps expression object sets out of the
+  // per-block lattice. Each expression is evaluated at a single program point,
+  // so the union of its object sets over all iterations is its object set at
+  // the fixpoint. So that the analysis still iterates until the table stops
+  // growing, a map compares unequal to one that has not seen the same growth.
+  void MakeExprObjectsFlowInsensitive();
+
   // Returns if `expr` has an object set.
   bool ExprHasObjectSet(const clang::Expr* expr) const;
 
   // Returns all the pointers (not objects) with the given `lifetime`.
+  // The pointers are indexed by lifetime on the first call, so later calls on
+  // this map (and on copies made from it since) don't scan all the pointers
+  // until one is added.
   std::vector<const Object*> GetAllPointersWithLifetime(
       Lifetime lifetime) const;
 
  private:
-  llvm::DenseMap<const Object*, ObjectSet> pointer_points_tos_;
-  llvm::DenseMap<const clang::Expr*, ObjectSet> expr_objects_;
+  using PointerMap = llvm::DenseMap<const Object*, ObjectSet>;
+  using ExprMap = llvm::DenseMap<const clang::Expr*, ObjectSet>;
+  using LifetimeIndex = llvm::DenseMap<Lifetime, std::vector<const Object*>>;
+
+  // Returns the points-to set of `pointer` for modification, adding it with an
+  // empty set if it has none.
+  ObjectSet& GetMutablePointsToSet(const Object* pointer);
+
+  // Returns the contents of `map`, which is empty if `map` is null.
+  template <typename Map>
+  static const Map& Get(const std::shared_ptr<Map>& map) {
+    static const Map* const kEmpty = new Map();
+    return map ? *map : *kEmpty;
+  }
+
+  // Returns `map` for modification, first copying its contents if they are
+  // shared with another `PointsToMap`.
+  template <typename Map>
+  static Map& GetMutable(std::shared_ptr<Map>& map) {
+    if (!map) {
+      map = std::make_shared<Map>();
+    } else if (map.use_count() > 1) {
+      map = std::make_shared<Map>(*map);
+    }
+    return *map;
+  }
+
+  // A table of expression object sets shared by all maps of one analysis; see
+  // MakeExprObjectsFlowInsensitive().
+  struct FlowInsensitiveExprObjects {
+    ExprMap objects;
+    // The number of times an object set in the table has grown.
+    uint64_t generation = 0;
+  };
+
+  // Returns the object sets of expressions, wherever they are stored.
+  const ExprMap& ExprObjects() const {
+    return flow_insensitive_exprs_ ? flow_insensitive_exprs_->objects
+                                   : Get(expr_objects_);
+  }
+
+  // Null if empty.
+  std::shared_ptr<PointerMap> pointer_points_tos_;
+  // The pointers in `pointer_points_tos_` by lifetime, or null if not built
+  // yet. Only adding a pointer invalidates it, as the lifetime of an object
+  // never changes. Shared like `pointer_points_tos_`.
+  mutable std::shared_ptr<const LifetimeIndex> lifetime_index_;
+  // Null if empty or if expression object sets are flow-insensitive.
+  std::shared_ptr<ExprMap> expr_objects_;
+  // Null unless expression object sets are flow-insensitive.
+  std::shared_ptr<FlowInsensitiveExprObjects> flow_insensitive_exprs_;
+  // The generation of `flow_insensitive_exprs_` that this map has seen.
+  uint64_t expr_generation_ = 0;
 };
 
 }  // namespace lifetimes
@@ -5,6 +5,7 @@
 #include "lifetime_analysis/points_to_map.h"
 
 #include <optional>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "lifetime_analysis/object.h"
@@ -90,6 +91,79 @@ TEST(PointsToMapTest, Union) {
       {});
 }
 
+TEST(PointsToMapTest, CopiesAreIndependent) {
+  runOnCodeWithLifetimeHandlers(
+      "int *return_int_ptr();"
+      "int* p = return_int_ptr();",
+      [](const clang::ASTContext& ast_context,
+         const LifetimeAnnotationContext&) {
+        Object p1(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        Object p2(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        Object p3(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        const clang::CallExpr* expr = getFirstCallExpr(ast_context);
+
+        PointsToMap map;
+        map.SetPointerPointsToSet(&p1, {&p2});
+        map.SetExprObjectSet(expr, {&p2});
+
+        PointsToMap copy = map;
+        copy.ExtendPointerPointsToSet(&p1, {&p3});
+        copy.SetExprObjectSet(expr, {&p3});
+        EXPECT_EQ(map.GetPointerPointsToSet(&p1), ObjectSet({&p2}));
+        EXPECT_EQ(map.GetExprObjectSet(expr), ObjectSet({&p2}));
+        EXPECT_EQ(copy.GetPointerPointsToSet(&p1), ObjectSet({&p2, &p3}));
+        EXPECT_EQ(copy.GetExprObjectSet(expr), ObjectSet({&p3}));
+
+        // A union that adds nothing is equal to the original.
+        EXPECT_EQ(copy.Union(map).GetPointerPointsToSet(&p1),
+                  ObjectSet({&p2, &p3}));
+        EXPECT_EQ(map.Union(PointsToMap()), map);
+        EXPECT_EQ(PointsToMap().Union(map), map);
+      },
+      {});
+}
+
+TEST(PointsToMapTest, FlowInsensitiveExprObjects) {
+  runOnCodeWithLifetimeHandlers(
+      "int *return_int_ptr();"
+      "int* p = return_int_ptr();",
+      [](const clang::ASTContext& ast_context,
+         const LifetimeAnnotationContext&) {
+        Object p1(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        Object p2(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        Object p3(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        const clang::CallExpr* expr = getFirstCallExpr(ast_context);
+
+        PointsToMap map;
+        map.SetExprObjectSet(expr, {&p1});
+        map.MakeExprObjectsFlowInsensitive();
+
+        // Copies share the object sets of expressions, which are only ever
+        // added to.
+        PointsToMap copy = map;
+        copy.SetExprObjectSet(expr, {&p2});
+        EXPECT_EQ(map.GetExprObjectSet(expr), ObjectSet({&p1, &p2}));
+        EXPECT_EQ(copy.GetExprObjectSet(expr), ObjectSet({&p1, &p2}));
+
+        // The copy that saw an object set grow compares unequal until the
+        // other has joined with it.
+        EXPECT_NE(map, copy);
+        PointsToMap joined = map.Union(copy);
+        EXPECT_EQ(joined, copy);
+
+        // Setting an object set without growing it changes nothing.
+        PointsToMap unchanged = joined;
+        unchanged.SetExprObjectSet(expr, {&p1});
+        EXPECT_EQ(unchanged, joined);
+
+        // Pointer points-to sets are still flow-sensitive.
+        unchanged.SetPointerPointsToSet(&p1, {&p3});
+        EXPECT_NE(unchanged, joined);
+        EXPECT_EQ(joined.GetPointerPointsToSet(&p1), ObjectSet());
+      },
+      {});
+}
+
 TEST(PointsToMapTest, GetPointerPointsToSet) {
   runOnCodeWithLifetimeHandlers(
       "",
@@ -137,6 +211,46 @@ TEST(PointsToMapTest, ExtendPointerPointsToSet) {
       {});
 }
 
+TEST(PointsToMapTest, GetAllPointersWithLifetime) {
+  runOnCodeWithLifetimeHandlers(
+      "",
+      [](const clang::ASTContext& ast_context,
+         const LifetimeAnnotationContext&) {
+        Object p1(Lifetime::Static(), ast_context.IntTy, std::nullopt);
+        Object p2(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+        Object p3(Lifetime::Static(), ast_context.IntTy, std::nullopt);
+        Object p4(Lifetime::CreateLocal(), ast_context.IntTy, std::nullopt);
+
+        PointsToMap map;
+        EXPECT_TRUE(map.GetAllPointersWithLifetime(Lifetime::Static()).empty());
+
+        map.SetPointerPointsToSet(&p1, {&p2});
+        map.SetPointerPointsToSet(&p2, {&p4});
+        EXPECT_EQ(map.GetAllPointersWithLifetime(Lifetime::Static()),
+                  std::vector<const Object*>({&p1}));
+        EXPECT_EQ(map.GetAllPointersWithLifetime(p2.GetLifetime()),
+                  std::vector<const Object*>({&p2}));
+
+        // Adding a pointer to a copy doesn't affect the original.
+        PointsToMap copy = map;
+        copy.ExtendPointerPointsToSet(&p3, {&p4});
+        EXPECT_EQ(copy.GetAllPointersWithLifetime(Lifetime::Static()).size(),
+                  2u);
+        EXPECT_EQ(map.GetAllPointersWithLifetime(Lifetime::Static()),
+                  std::vector<const Object*>({&p1}));
+        EXPECT_EQ(map.Union(copy)
+                      .GetAllPointersWithLifetime(Lifetime::Static())
+                      .size(),
+                  2u);
+
+        // Changing the points-to set of a pointer doesn't change the result.
+        map.SetPointerPointsToSet(&p1, {&p4});
+        EXPECT_EQ(map.GetAllPointersWithLifetime(Lifetime::Static()),
+                  std::vector<const Object*>({&p1}));
+      },
+      {});
+}
+
 TEST(PointsToMapTest, GetExprObjectSet) {
   runOnCodeWithLifetimeHandlers(
       "int *return_int_ptr();"
@@ -496,6 +496,56 @@ TEST_F(LifetimeAnalysisTest, StructDoubleCall) {
                             {"target", "(a, b), a -> a"}}));
 }
 
+TEST_F(LifetimeAnalysisTest, ResultsReportedThroughCallback) {
+  GetLifetimesOptions options;
+  options.with_callback = true;
+  // `f` is released after `g` and `target` are reported, and `target` is
+  // analyzed before it is reached in the TU.
+  EXPECT_THAT(GetLifetimes(R"(
+    int* target(int* a, int* b);
+    int* f(int* a) {
+      return a;
+    }
+    int* g(int* a, int* b) {
+      return f(b);
+    }
+    int* h(int* a, int* b) {
+      return target(a, b);
+    }
+    int* target(int* a, int* b) {
+      return g(a, f(b));
+    }
+  )",
+                           options),
+              LifetimesAre({{"f", "a -> a"},
+                            {"g", "a, b -> b"},
+                            {"h", "a, b -> b"},
+                            {"target", "a, b -> b"}}));
+}
+
+TEST_F(LifetimeAnalysisTest, VirtualResultsReportedThroughCallback) {
+  GetLifetimesOptions options;
+  options.with_callback = true;
+  EXPECT_THAT(GetLifetimes(R"(
+    struct Base {
+      virtual ~Base() {}
+      virtual int* f(int* a, int* b) { return a; }
+    };
+    int* call(Base* base, int* a, int* b) {
+      return base->f(a, b);
+    }
+    struct Derived : public Base {
+      int* f(int* a, int* b) override { return b; }
+    };
+  )",
+                           options),
+              LifetimesContain({
+                  {"Base::f", "b: a, a -> a"},
+                  {"Derived::f", "c: a, b -> b"},
+                  {"call", "a, b, b -> b"},
+              }));
+}
+
 }  // namespace
 }  // namespace lifetimes
 }  // namespace tidy
@@ -74,6 +74,35 @@ TEST_F(LifetimeAnalysisTest, FunctionTemplatePtrWithMultipleFunctions) {
                   {{"target", "a -> a"}, {"target2", "a -> a"}, {"foo", "a"}}));
 }
 
+TEST_F(LifetimeAnalysisTest, FunctionTemplatePtrInParallelChunks) {
+  GetLifetimesOptions options;
+  options.with_template_placeholder = true;
+  options.template_workers = 2;
+  EXPECT_THAT(GetLifetimes(R"(
+    template <typename T>
+    T* target(T* t) {
+      return t;
+    }
+    template <typename T, typename U>
+    T* target2(T* t, U* u1, U& u2) {
+      u1 = &u2;
+      return t;
+    }
+    template <typename T>
+    T* target3(T* t, T* u) {
+      return target(t) ? t : u;
+    }
+    int* foo(int* a) {
+      return a;
+    }
+  )",
+                           options),
+              LifetimesAre({{"target", "a -> a"},
+                            {"target2", "a, b, c -> a"},
+                            {"target3", "a, a -> a"},
+                            {"foo", "a -> a"}}));
+}
+
 TEST_F(LifetimeAnalysisTest, FunctionTemplateCall) {
   EXPECT_THAT(GetLifetimes(R"(
     template <typename T>
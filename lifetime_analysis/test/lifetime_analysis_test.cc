@@ -58,6 +58,17 @@ void SaveDotFile(absl::string_view dot, absl::string_view filename_base,
   }
 }
 
+void SaveMetricsFile(absl::string_view json, absl::string_view filename_base,
+                     absl::string_view test_name) {
+  std::string path = absl::StrCat(testing::TempDir(), "/", test_name, ".",
+                                  filename_base, ".json");
+  std::ofstream out(path);
+  out << json << "\n";
+  if (!out) {
+    llvm::errs() << "Error writing metrics file: " << strerror(errno) << "\n";
+  }
+}
+
 }  // namespace
 
 void LifetimeAnalysisTest::TearDown() {
@@ -78,6 +89,8 @@ void LifetimeAnalysisTest::TearDown() {
                   "Constraint set at exit block");
       SaveDotFile(debug_info.cfg_dot, absl::StrCat(func, "_cfg"), test_name,
                   "Control-flow graph");
+      SaveMetricsFile(debug_info.MetricsJson(),
+                      absl::StrCat(func, "_metrics"), test_name);
     }
     std::cerr << "Debug graphs can be found in " << testing::TempDir()
               << std::endl;
@@ -147,6 +160,12 @@ NamedFuncLifetimes LifetimeAnalysisTest::GetLifetimes(
         analysis_result;
     if (options.with_template_placeholder) {
       AnalyzeTranslationUnitWithTemplatePlaceholder(
+          ast_context.getTranslationUnitDecl(), lifetime_context,
+          result_callback,
+          /*diag_reporter=*/{}, &func_ptr_debug_info_map,
+          /*summaries=*/nullptr, options.template_workers);
+    } else if (options.with_callback) {
+      AnalyzeTranslationUnitWithCallback(
           ast_context.getTranslationUnitDecl(), lifetime_context,
           result_callback,
           /*diag_reporter=*/{}, &func_ptr_debug_info_map);
@@ -161,6 +180,8 @@ NamedFuncLifetimes LifetimeAnalysisTest::GetLifetimes(
     }
 
     for (auto& [func, debug_info] : func_ptr_debug_info_map) {
+      // Render now, as the AST is gone by the time the test is torn down.
+      debug_info.Render();
       debug_info_map_.try_emplace(func->getDeclName().getAsString(),
                                   std::move(debug_info));
     }
@@ -24,9 +24,17 @@ class LifetimeAnalysisTest : public testing::Test {
 
   struct GetLifetimesOptions {
     GetLifetimesOptions()
-        : with_template_placeholder(false), include_implicit_methods(false) {}
+        : with_template_placeholder(false),
+          include_implicit_methods(false),
+          with_callback(false),
+          template_workers(1) {}
     bool with_template_placeholder;
     bool include_implicit_methods;
+    // Use AnalyzeTranslationUnitWithCallback() rather than
+    // AnalyzeTranslationUnit().
+    bool with_callback;
+    // Passed to AnalyzeTranslationUnitWithTemplatePlaceholder().
+    unsigned template_workers;
   };
 
   NamedFuncLifetimes GetLifetimes(
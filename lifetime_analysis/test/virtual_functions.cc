@@ -75,6 +75,36 @@ struct Derived2 : public Base {
               }));
 }
 
+TEST_F(LifetimeAnalysisTest, FunctionVirtualInheritanceWithTwoBases) {
+  // Derived::f() is reached by the overrides traversals of both bases, and
+  // both need its lifetimes.
+  EXPECT_THAT(GetLifetimes(R"(
+struct Base1 {
+  virtual ~Base1() {}
+  virtual int* f(int* a, int* b) = 0;
+};
+
+struct Base2 {
+  virtual ~Base2() {}
+  virtual int* f(int* a, int* b) { return a; }
+};
+
+struct Derived : public Base1, public Base2 {
+  int* f(int* a, int* b) override { return b; }
+};
+
+struct MoreDerived : public Derived {
+  int* f(int* a, int* b) override { return a; }
+};
+  )"),
+              LifetimesContain({
+                  {"Base1::f", "b: a, a -> a"},
+                  {"Base2::f", "b: a, a -> a"},
+                  {"Derived::f", "b: a, a -> a"},
+                  {"MoreDerived::f", "c: a, b -> a"},
+              }));
+}
+
 TEST_F(LifetimeAnalysisTest, FunctionVirtualInheritanceWithBaseReturnStatic) {
   EXPECT_THAT(GetLifetimes(R"(
 struct Base {
@@ -240,8 +240,15 @@ void FunctionLifetimes::Traverse(
 
 void FunctionLifetimes::Traverse(
     std::function<void(const Lifetime&, Variance)> visitor) const {
-  const_cast<FunctionLifetimes*>(this)->Traverse(
-      [visitor](Lifetime& l, Variance v) { visitor(l, v); });
+  // Not implemented in terms of the non-const overload, which would copy any
+  // lifetimes that ValueLifetimes share with their copies.
+  for (const auto& param : param_lifetimes_) {
+    param.Traverse(visitor);
+  }
+  return_lifetimes_.Traverse(visitor);
+  if (this_lifetimes_.has_value()) {
+    this_lifetimes_->Traverse(visitor);
+  }
 }
 
 std::string FunctionLifetimes::DebugString(LifetimeFormatter formatter) const {
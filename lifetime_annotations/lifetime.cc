@@ -21,17 +21,64 @@ constexpr int STATIC_LIFETIME_ID = -1;
 constexpr int FIRST_VARIABLE_LIFETIME_ID = 2;
 constexpr int FIRST_LOCAL_LIFETIME_ID = -2;
 
+// The number of ids that a thread reserves from the shared counters at a time.
+constexpr int LIFETIME_ID_BLOCK_SIZE = 1024;
+
 std::atomic<int> Lifetime::next_variable_id_{FIRST_VARIABLE_LIFETIME_ID};
 
 std::atomic<int> Lifetime::next_local_id_{FIRST_LOCAL_LIFETIME_ID};
 
+namespace {
+// The ids in the block that this thread last reserved which it has not yet
+// used. Variable ids count up and local ids count down, so for local ids
+// `next` > `end`.
+struct IdBlock {
+  int next = 0;
+  int end = 0;
+};
+thread_local IdBlock variable_ids;
+thread_local IdBlock local_ids;
+}  // namespace
+
 Lifetime::Lifetime() : id_(INVALID_LIFETIME_ID_EMPTY) {}
 
-Lifetime Lifetime::CreateVariable() { return Lifetime(next_variable_id_++); }
+// Ids are reserved in blocks so that threads creating lifetimes concurrently
+// don't contend on the shared counters for each one, and so that the ids a
+// thread creates within a block are consecutive regardless of what other
+// threads do. On a single thread, the blocks are contiguous, so ids are the
+// same as if they were taken from the counters one at a time.
+Lifetime Lifetime::CreateVariable() {
+  if (variable_ids.next == variable_ids.end) {
+    variable_ids.next = next_variable_id_.fetch_add(LIFETIME_ID_BLOCK_SIZE);
+    variable_ids.end = variable_ids.next + LIFETIME_ID_BLOCK_SIZE;
+  }
+  return Lifetime(variable_ids.next++);
+}
 
 Lifetime Lifetime::Static() { return Lifetime(STATIC_LIFETIME_ID); }
 
-Lifetime Lifetime::CreateLocal() { return Lifetime(next_local_id_--); }
+Lifetime::IdScope::IdScope()
+    : outer_variable_next_(variable_ids.next),
+      outer_variable_end_(variable_ids.end),
+      outer_local_next_(local_ids.next),
+      outer_local_end_(local_ids.end) {
+  // Make the next lifetimes reserve new blocks.
+  variable_ids = IdBlock();
+  local_ids = IdBlock();
+}
+
+Lifetime::IdScope::~IdScope() {
+  variable_ids = {.next = outer_variable_next_, .end = outer_variable_end_};
+  local_ids = {.next = outer_local_next_, .end = outer_local_end_};
+}
+
+Lifetime Lifetime::CreateLocal() {
+  if (local_ids.next == local_ids.end) {
+    local_ids.next = next_local_id_.fetch_sub(LIFETIME_ID_BLOCK_SIZE);
+    local_ids.end = local_ids.next - LIFETIME_ID_BLOCK_SIZE;
+  }
+  return Lifetime(local_ids.next--);
+}
 
 bool Lifetime::IsVariable() const {
   assert(IsValid());
@@ -64,6 +64,28 @@ class Lifetime {
 
   bool operator!=(Lifetime other) const { return !(*this == other); }
 
+  // While an IdScope exists, the current thread creates lifetimes from id
+  // blocks that are reserved for the scope, so the ids of the lifetimes created
+  // in the scope are consecutive from the start of a block (unless the scope
+  // creates more than a block's worth), whatever the thread created before.
+  // The blocks that were in use before the scope are used again after it.
+  // Ids remain unique across scopes and threads, as lifetimes created in
+  // different scopes may still be compared.
+  class IdScope {
+   public:
+    IdScope();
+    ~IdScope();
+
+    IdScope(const IdScope&) = delete;
+    IdScope& operator=(const IdScope&) = delete;
+
+   private:
+    int outer_variable_next_;
+    int outer_variable_end_;
+    int outer_local_next_;
+    int outer_local_end_;
+  };
+
  private:
   explicit Lifetime(int id);
 
@@ -336,11 +336,49 @@ llvm::Expected<FunctionLifetimes> GetLifetimeAnnotations(
       source_manager.getFileID(func->getSourceRange().getBegin());
   bool elision_enabled = context.lifetime_elision_files.contains(file_id);
 
-  LifetimeSymbolTable throw_away_symbol_table;
-  if (!symbol_table) {
-    symbol_table = &throw_away_symbol_table;
+  // Names that are already in `symbol_table` may be used by the annotations,
+  // so the result only depends on `func` if it is empty.
+  if (symbol_table && !symbol_table->GetMapping().empty()) {
+    return GetLifetimeAnnotationsInternal(func, *symbol_table, elision_enabled);
+  }
+
+  if (context.annotation_cache_context != &func->getASTContext()) {
+    context.annotation_cache.clear();
+    context.annotation_cache_context = &func->getASTContext();
+  }
+  if (auto iter = context.annotation_cache.find(func);
+      iter != context.annotation_cache.end()) {
+    const CachedLifetimeAnnotations& cached = iter->second;
+    if (!cached.lifetimes.has_value()) {
+      return llvm::make_error<LifetimeError>(cached.error_type,
+                                             cached.error_message);
+    }
+    if (symbol_table) *symbol_table = cached.symbol_table;
+    return *cached.lifetimes;
+  }
+
+  CachedLifetimeAnnotations cached;
+  llvm::Expected<FunctionLifetimes> lifetimes = GetLifetimeAnnotationsInternal(
+      func, cached.symbol_table, elision_enabled);
+  if (!lifetimes) {
+    bool is_lifetime_error = false;
+    llvm::Error err = llvm::handleErrors(
+        lifetimes.takeError(),
+        [&](std::unique_ptr<LifetimeError> lifetime_err) -> llvm::Error {
+          is_lifetime_error = true;
+          cached.error_type = lifetime_err->type();
+          cached.error_message = lifetime_err->message();
+          return llvm::Error(std::move(lifetime_err));
+        });
+    if (is_lifetime_error) {
+      context.annotation_cache[func] = std::move(cached);
+    }
+    return err;
   }
-  return GetLifetimeAnnotationsInternal(func, *symbol_table, elision_enabled);
+  if (symbol_table) *symbol_table = cached.symbol_table;
+  cached.lifetimes = *lifetimes;
+  context.annotation_cache[func] = std::move(cached);
+  return lifetimes;
 }
 
 llvm::Expected<FunctionLifetimes> ParseLifetimeAnnotations(
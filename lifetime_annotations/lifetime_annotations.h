@@ -6,13 +6,17 @@
 #define CRUBIT_LIFETIME_ANNOTATIONS_LIFETIME_ANNOTATIONS_H_
 
 #include <memory>
+#include <optional>
 #include <string>
 
 #include "lifetime_annotations/function_lifetimes.h"
+#include "lifetime_annotations/lifetime_error.h"
 #include "lifetime_annotations/lifetime_symbol_table.h"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/Support/Error.h"
 
@@ -20,10 +24,29 @@ namespace clang {
 namespace tidy {
 namespace lifetimes {
 
+// The result of GetLifetimeAnnotations() for a function declaration.
+struct CachedLifetimeAnnotations {
+  std::optional<FunctionLifetimes> lifetimes;
+  LifetimeSymbolTable symbol_table;
+  // The error that was returned if `lifetimes` is empty.
+  LifetimeError::Type error_type = LifetimeError::Type::Other;
+  std::string error_message;
+};
+
 // Context that is required to obtain lifetime annotations for a function.
 struct LifetimeAnnotationContext {
   // Files in which the `lifetime_elision` pragma was specified.
   llvm::DenseSet<clang::FileID> lifetime_elision_files;
+
+  // The annotations that GetLifetimeAnnotations() has determined so far, which
+  // depend only on the declaration once its file has been parsed. Only holds
+  // declarations of `annotation_cache_context`, and is cleared when
+  // annotations are requested for a declaration of another ASTContext. The
+  // cache isn't synchronized, so threads that get annotations at the same time
+  // need contexts of their own.
+  mutable llvm::DenseMap<const clang::FunctionDecl*, CachedLifetimeAnnotations>
+      annotation_cache;
+  mutable const clang::ASTContext* annotation_cache_context = nullptr;
 };
 
 // Returns the lifetimes annotated on `func`.
@@ -37,6 +60,10 @@ struct LifetimeAnnotationContext {
 // The names of annotated function lifetimes as well as autogenerated names for
 // elided lifetimes are added to `symbol_table`.
 //
+// Unless `symbol_table` already contains names, the result is cached in
+// `context`, and later calls for the same declaration return the same
+// lifetimes.
+//
 // Returns structured error information as a `LifetimeError`.
 llvm::Expected<FunctionLifetimes> GetLifetimeAnnotations(
     const clang::FunctionDecl* func, const LifetimeAnnotationContext& context,
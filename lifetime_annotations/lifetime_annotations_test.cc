@@ -21,6 +21,7 @@
 #include "lifetime_annotations/test/named_func_lifetimes.h"
 #include "lifetime_annotations/test/run_on_code.h"
 #include "lifetime_annotations/type_lifetimes.h"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
@@ -867,6 +868,60 @@ TEST_F(LifetimeAnnotationsTest, LifetimeAnnotation_ReturnFunctionPtr) {
               IsOkAndHolds(LifetimesAre({{"f", "a -> (b -> b)"}})));
 }
 
+TEST(LifetimeAnnotationsCacheTest, RepeatedCallsReturnCachedAnnotations) {
+  EXPECT_TRUE(runOnCodeWithLifetimeHandlers(
+      R"(
+        [[clang::annotate("lifetimes", "a -> a")]]
+        int* annotated(int*);
+        int* unannotated(int*);
+      )",
+      [](clang::ASTContext& ast_context,
+         const LifetimeAnnotationContext& lifetime_context) {
+        auto lookup = [&ast_context](llvm::StringRef name) {
+          auto result = ast_context.getTranslationUnitDecl()->lookup(
+              &ast_context.Idents.get(name));
+          return clang::cast<clang::FunctionDecl>(result.front());
+        };
+        const clang::FunctionDecl* annotated = lookup("annotated");
+
+        LifetimeSymbolTable first_table;
+        llvm::Expected<FunctionLifetimes> first =
+            GetLifetimeAnnotations(annotated, lifetime_context, &first_table);
+        ASSERT_TRUE(bool(first));
+        LifetimeSymbolTable second_table;
+        llvm::Expected<FunctionLifetimes> second =
+            GetLifetimeAnnotations(annotated, lifetime_context, &second_table);
+        ASSERT_TRUE(bool(second));
+        EXPECT_EQ(
+            second->GetReturnLifetimes().GetPointeeLifetimes().GetLifetime(),
+            first->GetReturnLifetimes().GetPointeeLifetimes().GetLifetime());
+        EXPECT_EQ(second_table.LookupName("a"), first_table.LookupName("a"));
+
+        // A name that is already in the symbol table is used for the
+        // annotation rather than the cached lifetime.
+        LifetimeSymbolTable existing_table;
+        Lifetime existing = existing_table.LookupNameAndMaybeDeclare("a");
+        llvm::Expected<FunctionLifetimes> with_existing =
+            GetLifetimeAnnotations(annotated, lifetime_context,
+                                   &existing_table);
+        ASSERT_TRUE(bool(with_existing));
+        EXPECT_EQ(with_existing->GetReturnLifetimes()
+                      .GetPointeeLifetimes()
+                      .GetLifetime(),
+                  existing);
+
+        // Errors are cached too.
+        for (int i = 0; i < 2; ++i) {
+          EXPECT_THAT(
+              FormatErrorString(
+                  GetLifetimeAnnotations(lookup("unannotated"),
+                                         lifetime_context)
+                      .takeError()),
+              StartsWith("ERROR(ElisionNotEnabled): "));
+        }
+      }));
+}
+
 }  // namespace
 }  // namespace lifetimes
 }  // namespace tidy
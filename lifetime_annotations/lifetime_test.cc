@@ -4,6 +4,9 @@
 
 #include "lifetime_annotations/lifetime.h"
 
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace clang {
@@ -58,6 +61,41 @@ TEST(Lifetime, Copy) {
   EXPECT_EQ(l1, l3);
 }
 
+TEST(Lifetime, IdsAreConsecutiveWithinThread) {
+  // Lifetimes created concurrently on other threads don't take ids from
+  // between those created on this one.
+  std::vector<Lifetime> other;
+  std::thread thread([&] {
+    for (int i = 0; i < 100; ++i) other.push_back(Lifetime::CreateVariable());
+  });
+  Lifetime first = Lifetime::CreateVariable();
+  Lifetime second = Lifetime::CreateVariable();
+  thread.join();
+  EXPECT_EQ(second.Id(), first.Id() + 1);
+  for (Lifetime l : other) {
+    EXPECT_NE(l, first);
+    EXPECT_NE(l, second);
+  }
+}
+
+TEST(Lifetime, IdScopeStartsNewBlock) {
+  // Start with a new block, so that `before` isn't at its end.
+  Lifetime::IdScope outer_scope;
+  Lifetime before = Lifetime::CreateVariable();
+  Lifetime in_scope;
+  Lifetime second_in_scope;
+  {
+    Lifetime::IdScope scope;
+    in_scope = Lifetime::CreateVariable();
+    second_in_scope = Lifetime::CreateVariable();
+  }
+  Lifetime after = Lifetime::CreateVariable();
+  EXPECT_NE(in_scope.Id(), before.Id() + 1);
+  EXPECT_EQ(second_in_scope.Id(), in_scope.Id() + 1);
+  // The block that was in use before the scope is used again.
+  EXPECT_EQ(after.Id(), before.Id() + 1);
+}
+
 }  // namespace
 }  // namespace lifetimes
 }  // namespace tidy
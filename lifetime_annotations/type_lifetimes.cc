@@ -174,25 +174,26 @@ llvm::SmallVector<std::string> GetLifetimeParameters(clang::QualType type) {
   return ret;
 }
 
-ValueLifetimes::ValueLifetimes(const ValueLifetimes& other) { *this = other; }
+ValueLifetimes::ValueLifetimes(const ValueLifetimes& other) = default;
 
 ValueLifetimes& ValueLifetimes::operator=(const ValueLifetimes& other) {
-  type_ = other.type_;
-  template_argument_lifetimes_ = other.template_argument_lifetimes_;
-  lifetime_parameters_by_name_ = other.lifetime_parameters_by_name_;
-  auto pointee_lifetimes =
-      other.pointee_lifetimes_
-          ? std::make_unique<ObjectLifetimes>(*other.pointee_lifetimes_)
-          : nullptr;
-  auto function_lifetimes =
-      other.function_lifetimes_
-          ? std::make_unique<FunctionLifetimes>(*other.function_lifetimes_)
-          : nullptr;
   // Note: because ValueLifetimes is a recursive type (pointee_lifetimes_
-  // contains a ValueLifetimes), the following line can destroy `other`.
-  // (Thus the temporary local variables before we perform the assignment.)
+  // contains a ValueLifetimes), assigning any of the pointers can destroy
+  // `other`. (Thus the temporary local variables before we perform the
+  // assignment.)
+  clang::QualType type = other.type_;
+  LifetimeSymbolTable lifetime_parameters_by_name =
+      other.lifetime_parameters_by_name_;
+  std::shared_ptr<ObjectLifetimes> pointee_lifetimes = other.pointee_lifetimes_;
+  std::shared_ptr<FunctionLifetimes> function_lifetimes =
+      other.function_lifetimes_;
+  std::shared_ptr<TemplateArgumentLifetimes> template_argument_lifetimes =
+      other.template_argument_lifetimes_;
+  type_ = type;
+  lifetime_parameters_by_name_ = std::move(lifetime_parameters_by_name);
   pointee_lifetimes_ = std::move(pointee_lifetimes);
   function_lifetimes_ = std::move(function_lifetimes);
+  template_argument_lifetimes_ = std::move(template_argument_lifetimes);
   return *this;
 }
 
@@ -292,7 +293,7 @@ ValueLifetimes ValueLifetimes::PointerTo(const clang::QualType pointer_type,
   ret.type_ = pointer_type;
   assert(pointer_type->getPointeeType().getCanonicalType() ==
          obj.Type().getCanonicalType());
-  ret.pointee_lifetimes_ = std::make_unique<ObjectLifetimes>(obj);
+  ret.pointee_lifetimes_ = std::make_shared<ObjectLifetimes>(obj);
   return ret;
 }
 
@@ -329,7 +330,7 @@ llvm::Expected<ValueLifetimes> ValueLifetimes::Create(
       return std::move(err);
     }
     ret.function_lifetimes_ =
-        std::make_unique<FunctionLifetimes>(std::move(fn_lftm));
+        std::make_shared<FunctionLifetimes>(std::move(fn_lftm));
     return ret;
   }
 
@@ -370,11 +371,13 @@ llvm::Expected<ValueLifetimes> ValueLifetimes::Create(
                 return err;
               }
             }
-            if (ret.template_argument_lifetimes_.size() <= depth) {
-              ret.template_argument_lifetimes_.resize(depth + 1);
+            TemplateArgumentLifetimes& template_argument_lifetimes =
+                ret.MutableTemplateArgumentLifetimes();
+            if (template_argument_lifetimes.size() <= depth) {
+              template_argument_lifetimes.resize(depth + 1);
             }
-            ret.template_argument_lifetimes_[depth].push_back(
-                maybe_template_arg_lifetime);
+            template_argument_lifetimes[depth].push_back(
+                std::move(maybe_template_arg_lifetime));
             return llvm::Error::success();
           })) {
     return std::move(err);
@@ -430,7 +433,7 @@ llvm::Expected<ValueLifetimes> ValueLifetimes::Create(
     }
   }
   ret.pointee_lifetimes_ =
-      std::make_unique<ObjectLifetimes>(object_lifetime, value_lifetimes);
+      std::make_shared<ObjectLifetimes>(object_lifetime, value_lifetimes);
   return ret;
 }
 
@@ -444,7 +447,7 @@ ValueLifetimes ValueLifetimes::ForPointerLikeType(
   assert(!PointeeType(type).isNull());
   ValueLifetimes result(type);
   result.pointee_lifetimes_ =
-      std::make_unique<ObjectLifetimes>(object_lifetimes);
+      std::make_shared<ObjectLifetimes>(object_lifetimes);
   return result;
 }
 
@@ -460,7 +463,11 @@ ValueLifetimes ValueLifetimes::ForRecord(
            template_argument_lifetimes[depth].size());
   }
   ValueLifetimes result(type);
-  result.template_argument_lifetimes_ = std::move(template_argument_lifetimes);
+  if (!template_argument_lifetimes.empty()) {
+    result.template_argument_lifetimes_ =
+        std::make_shared<TemplateArgumentLifetimes>(
+            std::move(template_argument_lifetimes));
+  }
   result.lifetime_parameters_by_name_ = lifetime_parameters;
   return result;
 }
@@ -489,7 +496,7 @@ std::string ValueLifetimes::DebugString(
   }
 
   std::vector<std::vector<std::string>> tmpl_lifetimes;
-  for (auto& tmpl_arg_at_depth : template_argument_lifetimes_) {
+  for (auto& tmpl_arg_at_depth : AllTemplateArgumentLifetimes()) {
     tmpl_lifetimes.emplace_back();
     for (const std::optional<ValueLifetimes>& tmpl_arg : tmpl_arg_at_depth) {
       if (tmpl_arg) {
@@ -555,7 +562,7 @@ const FunctionLifetimes& ValueLifetimes::GetFuncLifetimes() const {
 
 bool ValueLifetimes::HasAny(
     const std::function<bool(Lifetime)>& predicate) const {
-  for (const auto& tmpl_arg_at_depth : template_argument_lifetimes_) {
+  for (const auto& tmpl_arg_at_depth : AllTemplateArgumentLifetimes()) {
     for (const std::optional<ValueLifetimes>& tmpl_arg : tmpl_arg_at_depth) {
       if (tmpl_arg && tmpl_arg->HasAny(predicate)) {
         return true;
@@ -580,15 +587,17 @@ bool ValueLifetimes::HasAny(
 }
 
 void ValueLifetimes::SubstituteLifetimes(const LifetimeSubstitutions& subst) {
-  for (auto& tmpl_arg_at_depth : template_argument_lifetimes_) {
-    for (std::optional<ValueLifetimes>& tmpl_arg : tmpl_arg_at_depth) {
-      if (tmpl_arg) {
-        tmpl_arg->SubstituteLifetimes(subst);
+  if (template_argument_lifetimes_) {
+    for (auto& tmpl_arg_at_depth : MutableTemplateArgumentLifetimes()) {
+      for (std::optional<ValueLifetimes>& tmpl_arg : tmpl_arg_at_depth) {
+        if (tmpl_arg) {
+          tmpl_arg->SubstituteLifetimes(subst);
+        }
       }
     }
   }
   if (pointee_lifetimes_) {
-    pointee_lifetimes_->SubstituteLifetimes(subst);
+    MutablePointeeLifetimes().SubstituteLifetimes(subst);
   }
   for (const auto& lftm_arg : GetLifetimeParameters(type_)) {
     std::optional<Lifetime> lifetime =
@@ -597,21 +606,23 @@ void ValueLifetimes::SubstituteLifetimes(const LifetimeSubstitutions& subst) {
     lifetime_parameters_by_name_.Rebind(lftm_arg, subst.Substitute(*lifetime));
   }
   if (function_lifetimes_) {
-    function_lifetimes_->SubstituteLifetimes(subst);
+    MutableFuncLifetimes().SubstituteLifetimes(subst);
   }
 }
 
 void ValueLifetimes::Traverse(std::function<void(Lifetime&, Variance)> visitor,
                               Variance variance) {
-  for (auto& tmpl_arg_at_depth : template_argument_lifetimes_) {
-    for (std::optional<ValueLifetimes>& tmpl_arg : tmpl_arg_at_depth) {
-      if (tmpl_arg) {
-        tmpl_arg->Traverse(visitor, kInvariant);
+  if (template_argument_lifetimes_) {
+    for (auto& tmpl_arg_at_depth : MutableTemplateArgumentLifetimes()) {
+      for (std::optional<ValueLifetimes>& tmpl_arg : tmpl_arg_at_depth) {
+        if (tmpl_arg) {
+          tmpl_arg->Traverse(visitor, kInvariant);
+        }
       }
     }
   }
   if (pointee_lifetimes_) {
-    pointee_lifetimes_->Traverse(visitor, variance, Type());
+    MutablePointeeLifetimes().Traverse(visitor, variance, Type());
   }
   for (const auto& lftm_arg : GetLifetimeParameters(type_)) {
     std::optional<Lifetime> lifetime =
@@ -630,19 +641,80 @@ void ValueLifetimes::Traverse(std::function<void(Lifetime&, Variance)> visitor,
     }
   }
   if (function_lifetimes_) {
-    function_lifetimes_->Traverse(visitor);
+    MutableFuncLifetimes().Traverse(visitor);
   }
 }
 
+// Mirrors the non-const overload, but doesn't call the `Mutable` accessors, so
+// that no shared lifetimes are copied.
 void ValueLifetimes::Traverse(
     std::function<void(const Lifetime&, Variance)> visitor,
     Variance variance) const {
-  const_cast<ValueLifetimes*>(this)->Traverse(
-      [&visitor](Lifetime& l, Variance v) { visitor(l, v); }, variance);
+  for (const auto& tmpl_arg_at_depth : AllTemplateArgumentLifetimes()) {
+    for (const std::optional<ValueLifetimes>& tmpl_arg : tmpl_arg_at_depth) {
+      if (tmpl_arg) {
+        tmpl_arg->Traverse(visitor, kInvariant);
+      }
+    }
+  }
+  if (pointee_lifetimes_) {
+    const ObjectLifetimes& pointee_lifetimes = *pointee_lifetimes_;
+    pointee_lifetimes.Traverse(visitor, variance, Type());
+  }
+  for (const auto& lftm_arg : GetLifetimeParameters(type_)) {
+    std::optional<Lifetime> lifetime =
+        lifetime_parameters_by_name_.LookupName(lftm_arg);
+    assert(lifetime.has_value());
+    visitor(*lifetime, variance);
+  }
+  if (function_lifetimes_) {
+    const FunctionLifetimes& function_lifetimes = *function_lifetimes_;
+    function_lifetimes.Traverse(visitor);
+  }
 }
 
 ValueLifetimes::ValueLifetimes(clang::QualType type) : type_(type) {}
 
+const ValueLifetimes::TemplateArgumentLifetimes&
+ValueLifetimes::AllTemplateArgumentLifetimes() const {
+  static const TemplateArgumentLifetimes* const kEmpty =
+      new TemplateArgumentLifetimes();
+  return template_argument_lifetimes_ ? *template_argument_lifetimes_
+                                      : *kEmpty;
+}
+
+namespace {
+
+// Returns `*ptr` for modification, first replacing it with a copy if it is
+// shared.
+template <typename T>
+T& Unshare(std::shared_ptr<T>& ptr) {
+  assert(ptr != nullptr);
+  if (ptr.use_count() > 1) {
+    ptr = std::make_shared<T>(*ptr);
+  }
+  return *ptr;
+}
+
+}  // namespace
+
+ObjectLifetimes& ValueLifetimes::MutablePointeeLifetimes() {
+  return Unshare(pointee_lifetimes_);
+}
+
+FunctionLifetimes& ValueLifetimes::MutableFuncLifetimes() {
+  return Unshare(function_lifetimes_);
+}
+
+ValueLifetimes::TemplateArgumentLifetimes&
+ValueLifetimes::MutableTemplateArgumentLifetimes() {
+  if (!template_argument_lifetimes_) {
+    template_argument_lifetimes_ =
+        std::make_shared<TemplateArgumentLifetimes>();
+  }
+  return Unshare(template_argument_lifetimes_);
+}
+
 llvm::SmallVector<llvm::ArrayRef<clang::TemplateArgument>> GetTemplateArgs(
     clang::QualType type) {
   llvm::SmallVector<llvm::ArrayRef<clang::TemplateArgument>> result;
@@ -952,9 +1024,14 @@ void ObjectLifetimes::Traverse(std::function<void(Lifetime&, Variance)> visitor,
 void ObjectLifetimes::Traverse(
     std::function<void(const Lifetime&, Variance)> visitor, Variance variance,
     clang::QualType indirection_type) const {
-  const_cast<ObjectLifetimes*>(this)->Traverse(
-      [&visitor](Lifetime& l, Variance v) { visitor(l, v); }, variance,
-      indirection_type);
+  assert(indirection_type.isNull() ||
+         StripAttributes(indirection_type->getPointeeType().IgnoreParens()) ==
+             Type());
+  value_lifetimes_.Traverse(
+      visitor, indirection_type.isNull() || indirection_type.isConstQualified()
+                   ? kCovariant
+                   : kInvariant);
+  visitor(lifetime_, variance);
 }
 
 llvm::Expected<llvm::StringRef> EvaluateAsStringLiteral(
@@ -997,32 +1074,35 @@ bool DenseMapInfo<clang::tidy::lifetimes::ValueLifetimes>::isEqual(
   if (lhs.type_ != rhs.type_) {
     return false;
   }
+  // Lifetimes shared between copies are equal without comparing them.
   if ((lhs.pointee_lifetimes_ == nullptr) !=
       (rhs.pointee_lifetimes_ == nullptr)) {
     return false;
   }
-  if (lhs.pointee_lifetimes_ &&
+  if (lhs.pointee_lifetimes_ != rhs.pointee_lifetimes_ &&
       !DenseMapInfo<clang::tidy::lifetimes::ObjectLifetimes>::isEqual(
           *lhs.pointee_lifetimes_, *rhs.pointee_lifetimes_)) {
     return false;
   }
-  if (lhs.template_argument_lifetimes_.size() !=
-      rhs.template_argument_lifetimes_.size()) {
-    return false;
-  }
-  for (size_t i = 0; i < lhs.template_argument_lifetimes_.size(); i++) {
-    if (lhs.template_argument_lifetimes_[i].size() !=
-        rhs.template_argument_lifetimes_[i].size()) {
+  if (lhs.template_argument_lifetimes_ != rhs.template_argument_lifetimes_) {
+    const auto& lhs_args = lhs.AllTemplateArgumentLifetimes();
+    const auto& rhs_args = rhs.AllTemplateArgumentLifetimes();
+    if (lhs_args.size() != rhs_args.size()) {
       return false;
     }
-    for (size_t j = 0; j < lhs.template_argument_lifetimes_[i].size(); j++) {
-      const auto& alhs = lhs.template_argument_lifetimes_[i][j];
-      const auto& arhs = rhs.template_argument_lifetimes_[i][j];
-      if (alhs.has_value() != arhs.has_value()) {
+    for (size_t i = 0; i < lhs_args.size(); i++) {
+      if (lhs_args[i].size() != rhs_args[i].size()) {
         return false;
       }
-      if (alhs.has_value() && !isEqual(*alhs, *arhs)) {
-        return false;
+      for (size_t j = 0; j < lhs_args[i].size(); j++) {
+        const auto& alhs = lhs_args[i][j];
+        const auto& arhs = rhs_args[i][j];
+        if (alhs.has_value() != arhs.has_value()) {
+          return false;
+        }
+        if (alhs.has_value() && !isEqual(*alhs, *arhs)) {
+          return false;
+        }
       }
     }
   }
@@ -1041,7 +1121,7 @@ unsigned DenseMapInfo<clang::tidy::lifetimes::ValueLifetimes>::getHashValue(
         *value_lifetimes.pointee_lifetimes_);
   }
   for (const auto& lifetimes_at_depth :
-       value_lifetimes.template_argument_lifetimes_) {
+       value_lifetimes.AllTemplateArgumentLifetimes()) {
     for (const auto& tmpl_lifetime : lifetimes_at_depth) {
       if (tmpl_lifetime) {
         hash = hash_combine(hash, getHashValue(*tmpl_lifetime));
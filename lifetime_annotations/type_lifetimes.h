@@ -71,6 +71,10 @@ class FunctionLifetimes;
 // Represents the lifetimes of a value; these may be 0 for non-reference-like
 // types, 1 for pointers/references, and an arbitrary number for structs with
 // template arguments/lifetime parameters.
+//
+// Copies share the lifetimes of pointees, functions and template arguments
+// until one of them is modified, so copying is cheap even for deeply nested
+// types.
 class ValueLifetimes {
  public:
   // Creates an invalid ValueLifetimes, which should not be used. This is
@@ -149,20 +153,20 @@ class ValueLifetimes {
   const std::optional<ValueLifetimes>& GetTemplateArgumentLifetimes(
       size_t depth, size_t index) const {
     assert(type_->isRecordType());
-    return template_argument_lifetimes_.at(depth).at(index);
+    return AllTemplateArgumentLifetimes().at(depth).at(index);
   }
 
   // Returns the number of template nesting levels.
   size_t GetNumTemplateNestingLevels() const {
     assert(type_->isRecordType());
-    return template_argument_lifetimes_.size();
+    return AllTemplateArgumentLifetimes().size();
   }
 
   // Returns the number of template arguments at a given nesting `depth` (see
   // `GetTemplateArgumentLifetimes` for details).
   size_t GetNumTemplateArgumentsAtDepth(size_t depth) const {
     assert(type_->isRecordType());
-    return template_argument_lifetimes_.at(depth).size();
+    return AllTemplateArgumentLifetimes().at(depth).size();
   }
 
   // Returns the lifetime associated with the given named lifetime parameter.
@@ -176,7 +180,7 @@ class ValueLifetimes {
   bool HasLifetimes() const {
     return pointee_lifetimes_ != nullptr || function_lifetimes_ != nullptr ||
            !lifetime_parameters_by_name_.GetMapping().empty() ||
-           !template_argument_lifetimes_.empty();
+           template_argument_lifetimes_ != nullptr;
   }
 
   // Returns true if `predicate` returns true for any lifetime that appears in
@@ -201,14 +205,30 @@ class ValueLifetimes {
                 Variance variance = kCovariant) const;
 
  private:
+  using TemplateArgumentLifetimes =
+      std::vector<std::vector<std::optional<ValueLifetimes>>>;
+
   explicit ValueLifetimes(clang::QualType type);
 
+  // Returns the lifetimes of all template arguments, indexed as for
+  // `GetTemplateArgumentLifetimes`.
+  const TemplateArgumentLifetimes& AllTemplateArgumentLifetimes() const;
+
+  // Return the pointee, function or template argument lifetimes for
+  // modification, first copying them if they are shared with another
+  // ValueLifetimes. The corresponding member must be non-null.
+  ObjectLifetimes& MutablePointeeLifetimes();
+  FunctionLifetimes& MutableFuncLifetimes();
+  TemplateArgumentLifetimes& MutableTemplateArgumentLifetimes();
+
   // Note: only one of `pointee_lifetimes_`, `function_lifetimes_` or
-  // `template_argument_lifetimes_` is non-empty.
-  std::unique_ptr<ObjectLifetimes> pointee_lifetimes_;
-  std::unique_ptr<FunctionLifetimes> function_lifetimes_;
-  std::vector<std::vector<std::optional<ValueLifetimes>>>
-      template_argument_lifetimes_;
+  // `template_argument_lifetimes_` is non-null. Each may be shared with copies
+  // of this ValueLifetimes, and must only be modified through the `Mutable`
+  // accessors above.
+  std::shared_ptr<ObjectLifetimes> pointee_lifetimes_;
+  std::shared_ptr<FunctionLifetimes> function_lifetimes_;
+  // Null if the type has no template arguments.
+  std::shared_ptr<TemplateArgumentLifetimes> template_argument_lifetimes_;
   clang::QualType type_;
 
   // Tracks the mapping from the names of the lifetimes on the struct/class
@@ -0,0 +1,134 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "migrator/rs_from_cc/conversion_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "common/file_io.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/xxhash.h"
+
+namespace crubit_rs_from_cc {
+namespace {
+
+// The first line of a serialized manifest. Bump the version when changing the
+// format (or the hash function).
+constexpr absl::string_view kHeader = "rs_from_cc conversion manifest v1";
+
+constexpr absl::string_view kCommandLinePrefix = "command_line ";
+
+uint64_t Hash(absl::string_view bytes) {
+  return llvm::xxh3_64bits(llvm::arrayRefFromStringRef(
+      llvm::StringRef(bytes.data(), bytes.size())));
+}
+
+uint64_t HashCommandLine(absl::Span<const std::string> command_line) {
+  // The arguments can't contain null characters, so joining them with null
+  // characters keeps them apart.
+  return Hash(absl::StrJoin(command_line, absl::string_view("\0", 1)));
+}
+
+absl::StatusOr<uint64_t> HashFile(absl::string_view path) {
+  absl::StatusOr<std::unique_ptr<llvm::MemoryBuffer>> contents =
+      crubit::MapFileContents(path);
+  if (!contents.ok()) return contents.status();
+  return Hash(absl::string_view((*contents)->getBufferStart(),
+                                (*contents)->getBufferSize()));
+}
+
+absl::StatusOr<uint64_t> ParseHash(absl::string_view hex) {
+  uint64_t hash;
+  if (!absl::SimpleHexAtoi(hex, &hash)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid hash in the conversion manifest: `", hex, "`"));
+  }
+  return hash;
+}
+
+std::string FormatHash(uint64_t hash) {
+  return llvm::utohexstr(hash, /*LowerCase=*/true, /*Width=*/16);
+}
+
+}  // namespace
+
+absl::StatusOr<ConversionManifest> ConversionManifest::Create(
+    absl::Span<const std::string> command_line,
+    absl::Span<const std::string> input_files) {
+  std::vector<std::pair<std::string, uint64_t>> file_hashes;
+  file_hashes.reserve(input_files.size());
+  for (const std::string& path : input_files) {
+    absl::StatusOr<uint64_t> hash = HashFile(path);
+    if (!hash.ok()) return hash.status();
+    file_hashes.emplace_back(path, *hash);
+  }
+  return ConversionManifest(HashCommandLine(command_line),
+                            std::move(file_hashes));
+}
+
+absl::StatusOr<ConversionManifest> ConversionManifest::Parse(
+    absl::string_view text) {
+  std::vector<absl::string_view> lines =
+      absl::StrSplit(text, '\n', absl::SkipEmpty());
+  if (lines.size() < 2 || lines[0] != kHeader ||
+      !absl::StartsWith(lines[1], kCommandLinePrefix)) {
+    return absl::InvalidArgumentError("Invalid conversion manifest header");
+  }
+  absl::StatusOr<uint64_t> command_line_hash =
+      ParseHash(lines[1].substr(kCommandLinePrefix.size()));
+  if (!command_line_hash.ok()) return command_line_hash.status();
+
+  std::vector<std::pair<std::string, uint64_t>> file_hashes;
+  file_hashes.reserve(lines.size() - 2);
+  for (absl::string_view line : absl::MakeConstSpan(lines).subspan(2)) {
+    // Paths may contain spaces, but hashes don't.
+    std::pair<absl::string_view, absl::string_view> hash_and_path =
+        absl::StrSplit(line, absl::MaxSplits(' ', 1));
+    absl::StatusOr<uint64_t> hash = ParseHash(hash_and_path.first);
+    if (!hash.ok()) return hash.status();
+    if (hash_and_path.second.empty()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Missing path in the conversion manifest: `", line, "`"));
+    }
+    file_hashes.emplace_back(std::string(hash_and_path.second), *hash);
+  }
+  return ConversionManifest(*command_line_hash, std::move(file_hashes));
+}
+
+std::string ConversionManifest::Serialize() const {
+  std::string text =
+      absl::StrCat(kHeader, "\n", kCommandLinePrefix,
+                   FormatHash(command_line_hash_), "\n");
+  for (const auto& [path, hash] : file_hashes_) {
+    absl::StrAppend(&text, FormatHash(hash), " ", path, "\n");
+  }
+  return text;
+}
+
+bool ConversionManifest::IsUpToDate(
+    absl::Span<const std::string> command_line) const {
+  if (HashCommandLine(command_line) != command_line_hash_) return false;
+  for (const auto& [path, hash] : file_hashes_) {
+    absl::StatusOr<uint64_t> current_hash = HashFile(path);
+    if (!current_hash.ok() || *current_hash != hash) return false;
+  }
+  return true;
+}
+
+}  // namespace crubit_rs_from_cc
@@ -0,0 +1,60 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_MIGRATOR_RS_FROM_CC_CONVERSION_CACHE_H_
+#define CRUBIT_MIGRATOR_RS_FROM_CC_CONVERSION_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace crubit_rs_from_cc {
+
+// Records what a Rust file was converted from: a hash of the Clang command
+// line, and a hash of the contents of each input file (the C++ source file and
+// all the headers that it transitively includes). When re-running the
+// migrator, the conversion of a C++ file can be skipped (and the previously
+// converted Rust file reused) if its manifest is still up to date.
+//
+// Like in ccache's "direct mode", the include closure is not recomputed when
+// checking the manifest - so a new header that shadows one of the input files
+// (e.g. in an earlier include directory) goes unnoticed.
+class ConversionManifest {
+ public:
+  // Creates the manifest of a conversion with the given Clang `command_line`,
+  // by hashing the current contents of the `input_files`.
+  static absl::StatusOr<ConversionManifest> Create(
+      absl::Span<const std::string> command_line,
+      absl::Span<const std::string> input_files);
+
+  // Parses a manifest that was written by `Serialize`.
+  static absl::StatusOr<ConversionManifest> Parse(absl::string_view text);
+
+  std::string Serialize() const;
+
+  // Returns whether a conversion with the given Clang `command_line` would
+  // have the same inputs as this manifest, i.e. whether the command line is
+  // the same and none of the input files changed (or was deleted).
+  bool IsUpToDate(absl::Span<const std::string> command_line) const;
+
+ private:
+  ConversionManifest(uint64_t command_line_hash,
+                     std::vector<std::pair<std::string, uint64_t>> file_hashes)
+      : command_line_hash_(command_line_hash),
+        file_hashes_(std::move(file_hashes)) {}
+
+  uint64_t command_line_hash_;
+
+  // Pairs of a path and the hash of the contents of the file.
+  std::vector<std::pair<std::string, uint64_t>> file_hashes_;
+};
+
+}  // namespace crubit_rs_from_cc
+
+#endif  // CRUBIT_MIGRATOR_RS_FROM_CC_CONVERSION_CACHE_H_
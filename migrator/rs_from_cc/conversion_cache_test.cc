@@ -0,0 +1,124 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "migrator/rs_from_cc/conversion_cache.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/file_io.h"
+#include "common/status_test_matchers.h"
+
+namespace crubit_rs_from_cc {
+namespace {
+
+using crubit::StatusIs;
+
+// Writes `contents` into `file_name` in the test's temporary directory, and
+// returns the path of the file.
+std::string WriteTestFile(absl::string_view file_name,
+                          absl::string_view contents) {
+  std::string path = absl::StrCat(testing::TempDir(), "/", file_name);
+  CHECK_OK(crubit::SetFileContents(path, contents));
+  return path;
+}
+
+const std::vector<std::string> kCommandLine = {"clang", "-std=c++17",
+                                               "file.cc"};
+
+TEST(ConversionManifestTest, UpToDate) {
+  std::vector<std::string> input_files = {
+      WriteTestFile("up_to_date.cc", "#include \"up_to_date.h\""),
+      WriteTestFile("up_to_date.h", "void f();"),
+  };
+  ASSERT_OK_AND_ASSIGN(ConversionManifest manifest,
+                       ConversionManifest::Create(kCommandLine, input_files));
+
+  EXPECT_TRUE(manifest.IsUpToDate(kCommandLine));
+}
+
+TEST(ConversionManifestTest, ChangedHeader) {
+  std::vector<std::string> input_files = {
+      WriteTestFile("changed_header.cc", "#include \"changed_header.h\""),
+      WriteTestFile("changed_header.h", "void f();"),
+  };
+  ASSERT_OK_AND_ASSIGN(ConversionManifest manifest,
+                       ConversionManifest::Create(kCommandLine, input_files));
+
+  WriteTestFile("changed_header.h", "void g();");
+  EXPECT_FALSE(manifest.IsUpToDate(kCommandLine));
+}
+
+TEST(ConversionManifestTest, DeletedInputFile) {
+  std::vector<std::string> input_files = {
+      WriteTestFile("deleted_input_file.cc", "void f();"),
+      absl::StrCat(testing::TempDir(), "/deleted_input_file.h"),
+  };
+  WriteTestFile("deleted_input_file.h", "");
+  ASSERT_OK_AND_ASSIGN(ConversionManifest manifest,
+                       ConversionManifest::Create(kCommandLine, input_files));
+
+  ASSERT_EQ(std::remove(input_files[1].c_str()), 0);
+  EXPECT_FALSE(manifest.IsUpToDate(kCommandLine));
+}
+
+TEST(ConversionManifestTest, ChangedCommandLine) {
+  std::vector<std::string> input_files = {
+      WriteTestFile("changed_command_line.cc", "void f();"),
+  };
+  ASSERT_OK_AND_ASSIGN(ConversionManifest manifest,
+                       ConversionManifest::Create(kCommandLine, input_files));
+
+  EXPECT_FALSE(manifest.IsUpToDate({"clang", "-std=c++20", "file.cc"}));
+  // The arguments are hashed separately, not just concatenated.
+  EXPECT_FALSE(manifest.IsUpToDate({"clang", "-std=c++1", "7file.cc"}));
+}
+
+TEST(ConversionManifestTest, MissingInputFile) {
+  EXPECT_THAT(ConversionManifest::Create(
+                  kCommandLine,
+                  {absl::StrCat(testing::TempDir(), "/missing_input.cc")}),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(ConversionManifestTest, SerializeAndParse) {
+  std::vector<std::string> input_files = {
+      WriteTestFile("serialize and parse.cc", "void f();"),
+  };
+  ASSERT_OK_AND_ASSIGN(ConversionManifest manifest,
+                       ConversionManifest::Create(kCommandLine, input_files));
+
+  ASSERT_OK_AND_ASSIGN(ConversionManifest parsed,
+                       ConversionManifest::Parse(manifest.Serialize()));
+  EXPECT_EQ(parsed.Serialize(), manifest.Serialize());
+  EXPECT_TRUE(parsed.IsUpToDate(kCommandLine));
+
+  WriteTestFile("serialize and parse.cc", "void g();");
+  EXPECT_FALSE(parsed.IsUpToDate(kCommandLine));
+}
+
+TEST(ConversionManifestTest, ParseErrors) {
+  EXPECT_THAT(ConversionManifest::Parse(""),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ConversionManifest::Parse("rs_from_cc conversion manifest v0\n"
+                                        "command_line 0123456789abcdef\n"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ConversionManifest::Parse("rs_from_cc conversion manifest v1\n"
+                                        "command_line xyz\n"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ConversionManifest::Parse("rs_from_cc conversion manifest v1\n"
+                                        "command_line 0123456789abcdef\n"
+                                        "0123456789abcdef\n"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace crubit_rs_from_cc
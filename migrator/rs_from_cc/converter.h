@@ -37,6 +37,10 @@ class Converter {
   class Invocation {
    public:
     std::string rs_code_;
+
+    // Absolute paths of the main C++ file and of all the headers that it
+    // (transitively) includes, i.e. all the files that `rs_code_` depends on.
+    std::vector<std::string> input_files_;
   };
 
   explicit Converter(Invocation& invocation, clang::ASTContext& ctx)
@@ -5,16 +5,43 @@
 #include "migrator/rs_from_cc/frontend_action.h"
 
 #include <memory>
+#include <string>
 
 #include "migrator/rs_from_cc/ast_consumer.h"
 #include "clang/AST/ASTConsumer.h"
+#include "clang/Basic/FileManager.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/Utils.h"
+#include "llvm/ADT/SmallString.h"
 
 namespace crubit_rs_from_cc {
+namespace {
+
+// Unlike the base class, also collects the system headers: the Rust code
+// depends on them as much as on the other headers.
+class AllDependenciesCollector : public clang::DependencyCollector {
+ public:
+  bool needSystemDependencies() override { return true; }
+};
+
+}  // namespace
 
 std::unique_ptr<clang::ASTConsumer> FrontendAction::CreateASTConsumer(
     clang::CompilerInstance& instance, llvm::StringRef) {
+  dependencies_ = std::make_shared<AllDependenciesCollector>();
+  dependencies_->attachToPreprocessor(instance.getPreprocessor());
   return std::make_unique<AstConsumer>(instance, invocation_);
 }
 
+void FrontendAction::EndSourceFileAction() {
+  // The paths are relative to the working directory of the compilation (which
+  // is not necessarily the working directory of the process).
+  clang::FileManager& file_manager = getCompilerInstance().getFileManager();
+  for (const std::string& dependency : dependencies_->getDependencies()) {
+    llvm::SmallString<256> path(dependency);
+    file_manager.makeAbsolutePath(path);
+    invocation_.input_files_.push_back(std::string(path));
+  }
+}
+
 }  // namespace crubit_rs_from_cc
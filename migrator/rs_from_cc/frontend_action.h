@@ -6,17 +6,20 @@
 #define CRUBIT_MIGRATOR_RS_FROM_CC_FRONTEND_ACTION_H_
 
 #include <memory>
+#include <utility>
 
 #include "lifetime_annotations/lifetime_annotations.h"
 #include "migrator/rs_from_cc/converter.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/Utils.h"
 
 namespace crubit_rs_from_cc {
 
 // Creates an `ASTConsumer` that generates the Rust code in the invocation
-// object.
+// object, and records the files that the Rust code is generated from in
+// `Converter::Invocation::input_files_`.
 class FrontendAction : public clang::ASTFrontendAction {
  public:
   explicit FrontendAction(Converter::Invocation& invocation)
@@ -25,8 +28,11 @@ class FrontendAction : public clang::ASTFrontendAction {
   std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
       clang::CompilerInstance& instance, llvm::StringRef) override;
 
+  void EndSourceFileAction() override;
+
  private:
   Converter::Invocation& invocation_;
+  std::shared_ptr<clang::DependencyCollector> dependencies_;
 };
 
 }  // namespace crubit_rs_from_cc
@@ -0,0 +1,236 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Generates equivalent Rust source files for many C++ files at once, using the
+// command lines from a compilation database (`compile_commands.json`):
+//
+//   rs_from_cc_batch --compilation_database_dir=build/ --rs_out_dir=out/ \
+//       [--cc_root=src/] [--jobs=32] [file.cc ...]
+//
+// With no C++ files on the command line, all files in the compilation
+// database are converted. The Rust file for `<cc_root>/dir/file.cc` is written
+// to `<rs_out_dir>/dir/file.rs` as soon as it has been converted.
+//
+// With --cache_dir, a `ConversionManifest` of each conversion is written to
+// `<cache_dir>/dir/file.manifest`, and the files whose command line, contents
+// and included headers didn't change since the previous run are not converted
+// again (their previous Rust files are kept).
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/file_io.h"
+#include "migrator/rs_from_cc/conversion_cache.h"
+#include "migrator/rs_from_cc/rs_from_cc_lib.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+ABSL_FLAG(std::string, compilation_database_dir, "",
+          "directory containing the compile_commands.json file with the Clang "
+          "command lines of the C++ files");
+ABSL_FLAG(std::string, rs_out_dir, "",
+          "output directory for the Rust source files; existing files will be "
+          "overwritten");
+ABSL_FLAG(std::string, cc_root, "",
+          "root directory of the C++ files, whose directory structure is "
+          "mirrored in --rs_out_dir; defaults to the current directory");
+ABSL_FLAG(std::string, cache_dir, "",
+          "directory for the manifests of the conversions, used to skip the "
+          "files that didn't change since the previous run; if empty, all "
+          "files are converted");
+ABSL_FLAG(int, jobs, 0,
+          "number of files to convert in parallel; defaults to the number of "
+          "cores");
+
+namespace crubit_rs_from_cc {
+namespace {
+
+// Returns the absolute version of `path`.
+std::string MakeAbsolute(absl::string_view path) {
+  llvm::SmallString<256> absolute(path);
+  llvm::sys::fs::make_absolute(absolute);
+  llvm::sys::path::remove_dots(absolute, /*remove_dot_dot=*/true);
+  return std::string(absolute);
+}
+
+// Returns the path of the file in `out_dir` that corresponds to
+// `cc_file_name` in `cc_root` (with the extension replaced by `extension`).
+absl::StatusOr<std::string> GetOutputFileName(absl::string_view cc_file_name,
+                                              absl::string_view cc_root,
+                                              absl::string_view out_dir,
+                                              absl::string_view extension) {
+  llvm::SmallString<256> file_name(MakeAbsolute(cc_file_name));
+  if (!llvm::sys::path::replace_path_prefix(file_name, cc_root, out_dir)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("`", cc_file_name, "` is not in `", cc_root, "`"));
+  }
+  llvm::sys::path::replace_extension(file_name, extension);
+  return std::string(file_name);
+}
+
+absl::Status WriteOutputFile(absl::string_view file_name,
+                             absl::string_view contents) {
+  if (std::error_code error = llvm::sys::fs::create_directories(
+          llvm::sys::path::parent_path(file_name))) {
+    return absl::InternalError(
+        absl::StrCat("Could not create the directory of `", file_name,
+                     "`: ", error.message()));
+  }
+  return crubit::SetFileContents(file_name, contents);
+}
+
+// Returns the command lines of `cc_file_name` (including the directories that
+// they run in), which the Rust code depends on as much as on the C++ code.
+std::vector<std::string> GetCommandLines(
+    const clang::tooling::CompilationDatabase& compilations,
+    absl::string_view cc_file_name) {
+  std::vector<std::string> command_lines;
+  for (const clang::tooling::CompileCommand& command :
+       compilations.getCompileCommands(cc_file_name)) {
+    command_lines.push_back(command.Directory);
+    command_lines.insert(command_lines.end(), command.CommandLine.begin(),
+                         command.CommandLine.end());
+  }
+  return command_lines;
+}
+
+// Returns whether the Rust file of `cc_file_name` and the manifest of its
+// conversion (`manifest_file_name`) exist, and whether the manifest is still
+// up to date.
+bool IsRsFileUpToDate(const clang::tooling::CompilationDatabase& compilations,
+                      absl::string_view cc_file_name,
+                      absl::string_view rs_file_name,
+                      absl::string_view manifest_file_name) {
+  if (!llvm::sys::fs::exists(rs_file_name)) return false;
+  absl::StatusOr<std::string> manifest_text =
+      crubit::GetFileContents(manifest_file_name);
+  if (!manifest_text.ok()) return false;
+  absl::StatusOr<ConversionManifest> manifest =
+      ConversionManifest::Parse(*manifest_text);
+  return manifest.ok() &&
+         manifest->IsUpToDate(GetCommandLines(compilations, cc_file_name));
+}
+
+}  // namespace
+}  // namespace crubit_rs_from_cc
+
+int main(int argc, char* argv[]) {
+  using crubit_rs_from_cc::ConversionManifest;
+  using crubit_rs_from_cc::GetCommandLines;
+  using crubit_rs_from_cc::GetOutputFileName;
+  using crubit_rs_from_cc::IsRsFileUpToDate;
+  using crubit_rs_from_cc::MakeAbsolute;
+  using crubit_rs_from_cc::RsFromCcOutput;
+  using crubit_rs_from_cc::WriteOutputFile;
+
+  std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+
+  auto compilation_database_dir = absl::GetFlag(FLAGS_compilation_database_dir);
+  if (compilation_database_dir.empty()) {
+    std::cerr << "please specify --compilation_database_dir" << std::endl;
+    return 1;
+  }
+  auto rs_out_dir = absl::GetFlag(FLAGS_rs_out_dir);
+  if (rs_out_dir.empty()) {
+    std::cerr << "please specify --rs_out_dir" << std::endl;
+    return 1;
+  }
+  rs_out_dir = MakeAbsolute(rs_out_dir);
+  std::string cc_root = MakeAbsolute(absl::GetFlag(FLAGS_cc_root));
+  std::string cache_dir = absl::GetFlag(FLAGS_cache_dir);
+  if (!cache_dir.empty()) cache_dir = MakeAbsolute(cache_dir);
+
+  std::string error_message;
+  std::unique_ptr<clang::tooling::CompilationDatabase> compilations =
+      clang::tooling::CompilationDatabase::loadFromDirectory(
+          compilation_database_dir, error_message);
+  if (compilations == nullptr) {
+    std::cerr << error_message << std::endl;
+    return 1;
+  }
+
+  // Skip $0.
+  std::vector<std::string> cc_file_names(args.begin() + 1, args.end());
+  if (cc_file_names.empty()) cc_file_names = compilations->getAllFiles();
+
+  std::mutex error_mutex;
+  std::atomic<int> num_failures = 0;
+  std::atomic<int> num_up_to_date = 0;
+  auto report_error = [&](absl::string_view cc_file_name,
+                          const absl::Status& status) {
+    ++num_failures;
+    std::lock_guard<std::mutex> lock(error_mutex);
+    std::cerr << cc_file_name << ": " << status << std::endl;
+  };
+  auto should_convert = [&](absl::string_view cc_file_name) {
+    if (cache_dir.empty()) return true;
+    absl::StatusOr<std::string> rs_file_name =
+        GetOutputFileName(cc_file_name, cc_root, rs_out_dir, "rs");
+    absl::StatusOr<std::string> manifest_file_name =
+        GetOutputFileName(cc_file_name, cc_root, cache_dir, "manifest");
+    // Errors are reported when the file is converted.
+    if (!rs_file_name.ok() || !manifest_file_name.ok()) return true;
+    if (!IsRsFileUpToDate(*compilations, cc_file_name, *rs_file_name,
+                          *manifest_file_name)) {
+      return true;
+    }
+    ++num_up_to_date;
+    return false;
+  };
+  auto write_output = [&](absl::string_view cc_file_name,
+                          const RsFromCcOutput& output) -> absl::Status {
+    absl::StatusOr<std::string> rs_file_name =
+        GetOutputFileName(cc_file_name, cc_root, rs_out_dir, "rs");
+    if (!rs_file_name.ok()) return rs_file_name.status();
+    if (absl::Status status = WriteOutputFile(*rs_file_name, output.rs_code);
+        !status.ok()) {
+      return status;
+    }
+    if (cache_dir.empty()) return absl::OkStatus();
+
+    // The manifest is written after the Rust file, so that when the migrator
+    // is interrupted in between, the file is converted again on the next run.
+    absl::StatusOr<std::string> manifest_file_name =
+        GetOutputFileName(cc_file_name, cc_root, cache_dir, "manifest");
+    if (!manifest_file_name.ok()) return manifest_file_name.status();
+    absl::StatusOr<ConversionManifest> manifest = ConversionManifest::Create(
+        GetCommandLines(*compilations, cc_file_name), output.input_files);
+    if (!manifest.ok()) return manifest.status();
+    return WriteOutputFile(*manifest_file_name, manifest->Serialize());
+  };
+  crubit_rs_from_cc::RsFromCcBatch(
+      *compilations, cc_file_names, absl::GetFlag(FLAGS_jobs), should_convert,
+      [&](absl::string_view cc_file_name,
+          absl::StatusOr<RsFromCcOutput> output) {
+        if (!output.ok()) {
+          report_error(cc_file_name, output.status());
+          return;
+        }
+        if (absl::Status status = write_output(cc_file_name, *output);
+            !status.ok()) {
+          report_error(cc_file_name, status);
+        }
+      });
+
+  std::cerr << "Converted "
+            << cc_file_names.size() - num_failures.load() -
+                   num_up_to_date.load()
+            << " of " << cc_file_names.size() << " files ("
+            << num_up_to_date.load() << " were up to date)" << std::endl;
+  return num_failures == 0 ? 0 : 1;
+}
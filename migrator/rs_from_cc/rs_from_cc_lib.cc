@@ -4,12 +4,16 @@
 
 #include "migrator/rs_from_cc/rs_from_cc_lib.h"
 
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -19,17 +23,75 @@
 #include "migrator/rs_from_cc/frontend_action.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/FileSystemOptions.h"
+#include "clang/Frontend/CompilerInvocation.h"
 #include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
 
 namespace crubit_rs_from_cc {
 
+namespace {
+
+// Parse non-doc comments that are used as documention
+constexpr absl::string_view kParseAllCommentsArg = "-fparse-all-comments";
+
+absl::Status CompilationError() {
+  return absl::Status(absl::StatusCode::kInvalidArgument,
+                      "Could not compile source file contents");
+}
+
+// Creates a `FrontendAction` for each file converted by a `ClangTool`, and
+// reports the result of the conversion to `on_result` as soon as the file has
+// been converted.
+class BatchActionFactory : public clang::tooling::FrontendActionFactory {
+ public:
+  explicit BatchActionFactory(
+      absl::FunctionRef<void(absl::string_view,
+                             absl::StatusOr<RsFromCcOutput>)>
+          on_result)
+      : on_result_(on_result) {}
+
+  std::unique_ptr<clang::FrontendAction> create() override {
+    return std::make_unique<FrontendAction>(invocation_);
+  }
+
+  bool runInvocation(
+      std::shared_ptr<clang::CompilerInvocation> compiler_invocation,
+      clang::FileManager* files,
+      std::shared_ptr<clang::PCHContainerOperations> pch_container_ops,
+      clang::DiagnosticConsumer* diag_consumer) override {
+    std::string cc_file_name =
+        compiler_invocation->getFrontendOpts().Inputs.front().getFile().str();
+    invocation_ = Converter::Invocation();
+    bool success = FrontendActionFactory::runInvocation(
+        std::move(compiler_invocation), files, std::move(pch_container_ops),
+        diag_consumer);
+    if (success) {
+      on_result_(cc_file_name,
+                 RsFromCcOutput{.rs_code = std::move(invocation_.rs_code_),
+                                .input_files =
+                                    std::move(invocation_.input_files_)});
+    } else {
+      on_result_(cc_file_name, CompilationError());
+    }
+    return success;
+  }
+
+ private:
+  absl::FunctionRef<void(absl::string_view, absl::StatusOr<RsFromCcOutput>)>
+      on_result_;
+
+  // The invocation of the file that is currently being converted.
+  Converter::Invocation invocation_;
+};
+
+}  // namespace
+
 absl::StatusOr<std::string> RsFromCc(const absl::string_view cc_file_content,
                                      const absl::string_view cc_file_name,
                                      absl::Span<const absl::string_view> args) {
-  std::vector<std::string> args_as_strings{
-      // Parse non-doc comments that are used as documention
-      "-fparse-all-comments"};
+  std::vector<std::string> args_as_strings{std::string(kParseAllCommentsArg)};
   args_as_strings.insert(args_as_strings.end(), args.begin(), args.end());
 
   Converter::Invocation invocation;
@@ -40,9 +102,68 @@ absl::StatusOr<std::string> RsFromCc(const absl::string_view cc_file_content,
           clang::tooling::FileContentMappings())) {
     return invocation.rs_code_;
   } else {
-    return absl::Status(absl::StatusCode::kInvalidArgument,
-                        "Could not compile source file contents");
+    return CompilationError();
+  }
+}
+
+void RsFromCcBatch(
+    const clang::tooling::CompilationDatabase& compilations,
+    absl::Span<const std::string> cc_file_names, int jobs,
+    absl::FunctionRef<bool(absl::string_view cc_file_name)> should_convert,
+    absl::FunctionRef<void(absl::string_view cc_file_name,
+                           absl::StatusOr<RsFromCcOutput> output)>
+        on_result) {
+  // `ClangTool` would skip (with just a warning) the files without a command
+  // line.
+  std::vector<std::string> files_to_convert;
+  for (const std::string& cc_file_name : cc_file_names) {
+    if (compilations.getCompileCommands(cc_file_name).empty()) {
+      on_result(cc_file_name,
+                absl::NotFoundError(absl::Substitute(
+                    "No command line found for `$0`", cc_file_name)));
+    } else {
+      files_to_convert.push_back(cc_file_name);
+    }
+  }
+
+  size_t num_workers = jobs > 0 ? static_cast<size_t>(jobs)
+                                : std::thread::hardware_concurrency();
+  if (num_workers == 0) num_workers = 1;
+  if (num_workers > files_to_convert.size()) {
+    num_workers = files_to_convert.size();
+  }
+
+  // The files are distributed round-robin, rather than in contiguous chunks,
+  // so that each worker gets a similar mix of (e.g.) big and small
+  // directories.
+  std::vector<std::vector<std::string>> files_by_worker(num_workers);
+  for (size_t i = 0; i < files_to_convert.size(); ++i) {
+    files_by_worker[i % num_workers].push_back(std::move(files_to_convert[i]));
+  }
+
+  auto run_worker = [&](const std::vector<std::string>& worker_files) {
+    std::vector<std::string> files;
+    for (const std::string& file : worker_files) {
+      if (should_convert(file)) files.push_back(file);
+    }
+    if (files.empty()) return;
+
+    // A `ClangTool` uses the same `FileManager` for all of its files.
+    clang::tooling::ClangTool tool(compilations, files);
+    tool.appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+        kParseAllCommentsArg.data(),
+        clang::tooling::ArgumentInsertPosition::BEGIN));
+    BatchActionFactory factory(on_result);
+    // The failures have already been reported to `on_result`.
+    tool.run(&factory);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t worker = 1; worker < num_workers; ++worker) {
+    threads.emplace_back(run_worker, std::cref(files_by_worker[worker]));
   }
+  if (num_workers > 0) run_worker(files_by_worker[0]);
+  for (std::thread& thread : threads) thread.join();
 }
 
 }  // namespace crubit_rs_from_cc
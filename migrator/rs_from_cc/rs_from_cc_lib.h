@@ -6,11 +6,14 @@
 #define CRUBIT_MIGRATOR_RS_FROM_CC_RS_FROM_CC_LIB_H_
 
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "clang/Tooling/CompilationDatabase.h"
 
 namespace crubit_rs_from_cc {
 
@@ -27,6 +30,47 @@ absl::StatusOr<std::string> RsFromCc(
     absl::string_view cc_file_name = "testing/file_name.cc",
     absl::Span<const absl::string_view> args = {});
 
+// The result of converting a C++ source file in `RsFromCcBatch`.
+struct RsFromCcOutput {
+  std::string rs_code;
+
+  // Absolute paths of the C++ source file and of all the headers that it
+  // (transitively) includes, i.e. all the files that `rs_code` depends on.
+  std::vector<std::string> input_files;
+};
+
+// Converts many C++ source files into Rust, like `RsFromCc`, but with the
+// Clang command lines of the files from `compilations`.
+//
+// The files are split between `jobs` worker threads (one per core if `jobs` is
+// 0). Each worker converts its files one after another, reusing one
+// `clang::FileManager`, so that the headers included by many of its files are
+// only looked up once.
+//
+// Parameters:
+// * `compilations`: the Clang command lines of the files to convert.
+// * `cc_file_names`: names of the C++ files to convert.
+// * `jobs`: the number of worker threads.
+// * `should_convert`: called (concurrently from the worker threads, so it must
+//   be thread-safe) with the name of each C++ file before converting it. The
+//   file is skipped if it returns false, e.g. because the Rust code from a
+//   previous conversion is still up to date.
+// * `on_result`: called with the name of each C++ file and the Rust code that
+//   it was converted into (or the error that prevented the conversion), as
+//   soon as the file has been converted, so that the results don't need to be
+//   kept in memory. It is called concurrently from the worker threads (and
+//   with the files in no particular order), so it must be thread-safe. For
+//   files with multiple command lines in `compilations`, it is called once
+//   for each command line.
+//
+void RsFromCcBatch(
+    const clang::tooling::CompilationDatabase& compilations,
+    absl::Span<const std::string> cc_file_names, int jobs,
+    absl::FunctionRef<bool(absl::string_view cc_file_name)> should_convert,
+    absl::FunctionRef<void(absl::string_view cc_file_name,
+                           absl::StatusOr<RsFromCcOutput> output)>
+        on_result);
+
 }  // namespace crubit_rs_from_cc
 
 #endif  // CRUBIT_MIGRATOR_RS_FROM_CC_RS_FROM_CC_LIB_H_
@@ -4,21 +4,35 @@
 
 #include "migrator/rs_from_cc/rs_from_cc_lib.h"
 
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
 #include <variant>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/log/check.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "common/file_io.h"
 #include "common/status_test_matchers.h"
 #include "clang/AST/ASTContext.h"
+#include "clang/Tooling/CompilationDatabase.h"
 
 namespace crubit_rs_from_cc {
 namespace {
 
+using crubit::IsOkAndHolds;
 using crubit::StatusIs;
 using ::testing::Eq;
+using ::testing::HasSubstr;
 using ::testing::IsEmpty;
+using ::testing::Key;
+using ::testing::UnorderedElementsAre;
 
 TEST(RsFromCcTest, Noop) {
   // Nothing interesting there, but also not empty, so that the header gets
@@ -50,5 +64,109 @@ TEST(RsFromCcTest, FunctionDeclaration) {
 )end_of_string"));
 }
 
+// Writes `cc_file_content` into a new file in the test's temporary directory,
+// and returns the path of the file.
+std::string WriteTestFile(absl::string_view file_name,
+                          absl::string_view cc_file_content) {
+  std::string path = absl::StrCat(testing::TempDir(), "/", file_name);
+  CHECK_OK(crubit::SetFileContents(path, cc_file_content));
+  return path;
+}
+
+// Runs `RsFromCcBatch` on `cc_file_names` (except `files_to_skip`), and
+// returns the results by file name.
+std::map<std::string, absl::StatusOr<RsFromCcOutput>> RunRsFromCcBatch(
+    const std::vector<std::string>& cc_file_names, int jobs,
+    const std::set<std::string>& files_to_skip = {}) {
+  clang::tooling::FixedCompilationDatabase compilations(testing::TempDir(),
+                                                        {"-std=c++17"});
+  std::mutex mutex;
+  std::map<std::string, absl::StatusOr<RsFromCcOutput>> results;
+  RsFromCcBatch(
+      compilations, cc_file_names, jobs,
+      [&](absl::string_view cc_file_name) {
+        return !files_to_skip.contains(std::string(cc_file_name));
+      },
+      [&](absl::string_view cc_file_name,
+          absl::StatusOr<RsFromCcOutput> output) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto [it, inserted] =
+            results.emplace(std::string(cc_file_name), std::move(output));
+        EXPECT_TRUE(inserted) << "Duplicate result: " << it->first;
+      });
+  return results;
+}
+
+// Returns the Rust code of `output`.
+absl::StatusOr<std::string> RsCode(
+    const absl::StatusOr<RsFromCcOutput>& output) {
+  if (!output.ok()) return output.status();
+  return output->rs_code;
+}
+
+TEST(RsFromCcBatchTest, ConvertsAllFiles) {
+  std::vector<std::string> cc_file_names;
+  for (int i = 0; i < 5; ++i) {
+    cc_file_names.push_back(WriteTestFile(absl::StrCat("batch_", i, ".cc"),
+                                          absl::StrCat("void f", i, "() {}")));
+  }
+
+  std::map<std::string, absl::StatusOr<RsFromCcOutput>> results =
+      RunRsFromCcBatch(cc_file_names, /*jobs=*/2);
+
+  ASSERT_EQ(results.size(), cc_file_names.size());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_THAT(RsCode(results[cc_file_names[i]]),
+                IsOkAndHolds(HasSubstr(absl::StrCat(" f", i, " 'void ()'"))));
+  }
+}
+
+TEST(RsFromCcBatchTest, ReusesHeadersAcrossFiles) {
+  std::string header =
+      WriteTestFile("batch_shared.h", "// A header shared by both files");
+  std::string a = WriteTestFile("batch_with_header_a.cc",
+                                "#include \"batch_shared.h\"\nvoid a() {}");
+  std::string b = WriteTestFile("batch_with_header_b.cc",
+                                "#include \"batch_shared.h\"\nvoid b() {}");
+
+  std::map<std::string, absl::StatusOr<RsFromCcOutput>> results =
+      RunRsFromCcBatch({a, b}, /*jobs=*/1);
+
+  EXPECT_THAT(RsCode(results[a]), IsOkAndHolds(HasSubstr("FunctionDecl")));
+  EXPECT_THAT(RsCode(results[b]), IsOkAndHolds(HasSubstr("FunctionDecl")));
+  ASSERT_OK(results[a]);
+  EXPECT_THAT(results[a]->input_files, UnorderedElementsAre(a, header));
+  ASSERT_OK(results[b]);
+  EXPECT_THAT(results[b]->input_files, UnorderedElementsAre(b, header));
+}
+
+TEST(RsFromCcBatchTest, SkipsFiles) {
+  std::string converted = WriteTestFile("batch_converted.cc", "void f() {}");
+  std::string skipped = WriteTestFile("batch_skipped.cc", "void f() {}");
+
+  std::map<std::string, absl::StatusOr<RsFromCcOutput>> results =
+      RunRsFromCcBatch({converted, skipped}, /*jobs=*/2,
+                       /*files_to_skip=*/{skipped});
+
+  EXPECT_THAT(results, UnorderedElementsAre(Key(converted)));
+}
+
+TEST(RsFromCcBatchTest, ReportsErrorsPerFile) {
+  std::string valid = WriteTestFile("batch_valid.cc", "    ");
+  std::string invalid =
+      WriteTestFile("batch_invalid.cc", "int foo(); But this is not C++");
+
+  std::map<std::string, absl::StatusOr<RsFromCcOutput>> results =
+      RunRsFromCcBatch({valid, invalid}, /*jobs=*/0);
+
+  EXPECT_THAT(results, UnorderedElementsAre(Key(valid), Key(invalid)));
+  EXPECT_THAT(RsCode(results[valid]), IsOkAndHolds(IsEmpty()));
+  EXPECT_THAT(results[invalid], StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(RsFromCcBatchTest, NoFiles) {
+  EXPECT_THAT(RunRsFromCcBatch({}, /*jobs=*/4), IsEmpty());
+}
+
 }  // namespace
 }  // namespace crubit_rs_from_cc
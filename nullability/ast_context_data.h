@@ -0,0 +1,57 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_NULLABILITY_AST_CONTEXT_DATA_H_
+#define CRUBIT_NULLABILITY_AST_CONTEXT_DATA_H_
+
+#include <memory>
+
+#include "clang/AST/ASTContext.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace clang::tidy::nullability {
+
+/// Returns the `T` attached to `Ctx`, which is default-constructed on first use
+/// and destroyed together with `Ctx`.
+///
+/// This is for memoizing facts about the declarations of a TU in functions that
+/// are called all over (e.g. `isSupportedSmartPointerType()`) and so can't be
+/// handed a cache by their callers.
+///
+/// An `ASTContext` is used and destroyed on a single thread (tools that analyze
+/// TUs in parallel parse each on its own thread), so each thread keeps the data
+/// of its own contexts, and the data needs no locking.
+template <typename T>
+T &getASTContextData(const ASTContext &Ctx) {
+  struct PerThread {
+    llvm::DenseMap<const ASTContext *, std::unique_ptr<T>> ByContext;
+    // The context of the last lookup, which is almost always the context of
+    // the next one, too.
+    const ASTContext *LastContext = nullptr;
+    T *LastData = nullptr;
+  };
+  static thread_local PerThread State;
+
+  if (&Ctx == State.LastContext) return *State.LastData;
+  auto [It, Inserted] = State.ByContext.try_emplace(&Ctx);
+  if (Inserted) {
+    It->second = std::make_unique<T>();
+    Ctx.AddDeallocation(
+        [](void *Ctx) {
+          State.ByContext.erase(static_cast<const ASTContext *>(Ctx));
+          if (State.LastContext == Ctx) {
+            State.LastContext = nullptr;
+            State.LastData = nullptr;
+          }
+        },
+        const_cast<ASTContext *>(&Ctx));
+  }
+  State.LastContext = &Ctx;
+  State.LastData = It->second.get();
+  return *State.LastData;
+}
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_AST_CONTEXT_DATA_H_
@@ -0,0 +1,55 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/ast_context_data.h"
+
+#include <optional>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/Testing/TestAST.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+
+namespace clang::tidy::nullability {
+namespace {
+
+struct Counter {
+  int Value = 0;
+};
+
+// Counts the instances that are alive.
+struct Tracked {
+  static int Alive;
+  Tracked() { ++Alive; }
+  ~Tracked() { --Alive; }
+};
+int Tracked::Alive = 0;
+
+TEST(ASTContextDataTest, DataIsPerContext) {
+  TestAST First("");
+  TestAST Second("");
+
+  ++getASTContextData<Counter>(First.context()).Value;
+  ++getASTContextData<Counter>(First.context()).Value;
+  ++getASTContextData<Counter>(Second.context()).Value;
+
+  EXPECT_EQ(getASTContextData<Counter>(First.context()).Value, 2);
+  EXPECT_EQ(getASTContextData<Counter>(Second.context()).Value, 1);
+}
+
+TEST(ASTContextDataTest, DataIsDestroyedWithContext) {
+  std::optional<TestAST> AST(std::in_place, "");
+  getASTContextData<Tracked>(AST->context());
+  EXPECT_EQ(Tracked::Alive, 1);
+
+  AST.reset();
+  EXPECT_EQ(Tracked::Alive, 0);
+
+  // A new context (which may be allocated at the same address) gets new data.
+  TestAST Other("");
+  ++getASTContextData<Counter>(Other.context()).Value;
+  EXPECT_EQ(getASTContextData<Counter>(Other.context()).Value, 1);
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
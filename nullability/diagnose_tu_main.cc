@@ -0,0 +1,271 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// diagnose_tu_main runs the nullability checks over whole translation units,
+// and prints the findings in source order.
+//
+// With -jobs=N, declarations are diagnosed on N threads, each of which parses
+// its own copy of the TU. The output is the same for any N.
+//
+// -solver-corpus-dir records the solver queries that time out or take longer
+// than -solver-corpus-min-ms, for replaying with solver_corpus_benchmark.
+//
+// -memory-stats prints what the analysis of each function retained (see
+// `AnalysisMemoryStats`), to find the functions and structures that dominate
+// memory use.
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/base/nullability.h"
+#include "absl/log/check.h"
+#include "nullability/pointer_nullability_analysis.h"
+#include "nullability/pointer_nullability_diagnosis.h"
+#include "nullability/pragma.h"
+#include "nullability/solver_corpus.h"
+#include "nullability/type_nullability.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/Execution.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+llvm::cl::OptionCategory Opts("diagnose_tu_main options");
+llvm::cl::opt<unsigned> Jobs{
+    "jobs",
+    llvm::cl::desc("Number of threads to diagnose on. Each thread parses its "
+                   "own copy of the input"),
+    llvm::cl::init(1),
+};
+llvm::cl::opt<unsigned> WidenAfter{
+    "widen-after",
+    llvm::cl::desc("Widen the null state of pointers that change in a loop to "
+                   "Top after this many visits to the loop head (0: never)"),
+    llvm::cl::init(0),
+};
+llvm::cl::opt<unsigned> FunctionTimeoutMs{
+    "function-timeout-ms",
+    llvm::cl::desc("Stop analyzing a function after this many milliseconds, "
+                   "and report it as not fully checked (0: no limit)"),
+    llvm::cl::init(0),
+};
+llvm::cl::opt<unsigned> TimeoutMs{
+    "timeout-ms",
+    llvm::cl::desc("Stop analyzing functions this many milliseconds after "
+                   "parsing the TU, and report the rest as not fully checked "
+                   "(0: no limit)"),
+    llvm::cl::init(0),
+};
+llvm::cl::opt<bool> SummarizeFunctions{
+    "summarize-functions",
+    llvm::cl::desc("Check calls to unannotated functions of the TU against "
+                   "summaries of what their bodies do"),
+    llvm::cl::init(false),
+};
+llvm::cl::opt<unsigned> ReleaseStateAfterBlocks{
+    "release-state-after-blocks",
+    llvm::cl::desc("Release the analysis state shared by the functions of the "
+                   "TU after analyzing a function with at least this many CFG "
+                   "blocks, to bound memory use (0: never)"),
+    llvm::cl::init(0),
+};
+llvm::cl::opt<std::string> SolverCorpusDir{
+    "solver-corpus-dir",
+    llvm::cl::desc("Directory to record expensive solver queries to"),
+};
+llvm::cl::opt<unsigned> SolverCorpusMinMs{
+    "solver-corpus-min-ms",
+    llvm::cl::desc("Record solver queries that take at least this many "
+                   "milliseconds, as well as those that time out"),
+    llvm::cl::init(1000),
+};
+llvm::cl::opt<bool> PrintStats{
+    "stats",
+    llvm::cl::desc("Print the number of functions analyzed and skipped"),
+    llvm::cl::init(false),
+};
+llvm::cl::opt<bool> PrintMemoryStats{
+    "memory-stats",
+    llvm::cl::desc("Print the environments, atoms and other state that the "
+                   "analysis of each function retained"),
+    llvm::cl::init(false),
+};
+
+namespace clang::tidy::nullability {
+namespace {
+
+// Prints the memory measures of analyzing `Func` to stderr. Several workers may
+// call this at once.
+void printMemoryStats(const FunctionDecl &Func,
+                      const AnalysisMemoryStats &Stats) {
+  static std::mutex Mutex;
+  std::lock_guard<std::mutex> Lock(Mutex);
+  llvm::errs() << Func.getQualifiedNameAsString() << ": "
+               << Stats.RetainedEnvironments << " environments, "
+               << Stats.ArenaAtoms << " atoms, " << Stats.ExprNullabilityEntries
+               << " expression nullabilities, " << Stats.TopStorageLocations
+               << " top storage locations, " << Stats.ConstMethodReturnValues
+               << " const method return values (at most "
+               << Stats.MaxConstMethodReturnValues << " per block)\n";
+}
+
+// The solvers to diagnose with, which record their expensive queries if
+// -solver-corpus-dir is set.
+const SolverFactory &solverFactory() {
+  static const SolverFactory *const Factory = [] {
+    if (SolverCorpusDir.empty())
+      return new SolverFactory(makeDefaultSolverForDiagnosis);
+    std::error_code EC = llvm::sys::fs::create_directories(SolverCorpusDir);
+    QCHECK(!EC) << SolverCorpusDir << ": " << EC.message();
+    auto *Recorder = new SolverCorpusRecorder(
+        SolverCorpusDir, std::chrono::milliseconds(SolverCorpusMinMs));
+    return new SolverFactory(Recorder->wrap(makeDefaultSolverForDiagnosis));
+  }();
+  return *Factory;
+}
+
+// Parses the TU again on a worker thread, and runs `Diagnose` on the result.
+void parseForWorker(const CompilerInvocation &Invocation,
+                    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> VFS,
+                    TUDiagnoser Diagnose) {
+  class WorkerAction : public SyntaxOnlyAction {
+    TUDiagnoser Diagnose;
+    NullabilityPragmas Pragmas;
+
+   public:
+    WorkerAction(TUDiagnoser Diagnose) : Diagnose(Diagnose) {}
+
+   private:
+    absl::Nonnull<std::unique_ptr<ASTConsumer>> CreateASTConsumer(
+        CompilerInstance &CI, llvm::StringRef) override {
+      registerPragmaHandler(CI.getPreprocessor(), Pragmas);
+      class Consumer : public ASTConsumer {
+       public:
+        TUDiagnoser Diagnose;
+        NullabilityPragmas &Pragmas;
+        Consumer(TUDiagnoser Diagnose, NullabilityPragmas &Pragmas)
+            : Diagnose(Diagnose), Pragmas(Pragmas) {}
+
+       private:
+        void HandleTranslationUnit(ASTContext &Ctx) override {
+          Diagnose(Ctx, Pragmas);
+        }
+      };
+      return std::make_unique<Consumer>(Diagnose, Pragmas);
+    }
+  };
+
+  CompilerInstance CI;
+  CI.setInvocation(std::make_shared<CompilerInvocation>(Invocation));
+  // The main parse already reported any diagnostics.
+  CI.createDiagnostics(new IgnoringDiagConsumer(), /*ShouldOwnClient=*/true);
+  CI.createFileManager(std::move(VFS));
+  WorkerAction Action(Diagnose);
+  CI.ExecuteAction(Action);
+}
+
+class Action : public SyntaxOnlyAction {
+  NullabilityPragmas Pragmas;
+  std::shared_ptr<CompilerInvocation> Invocation;
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> VFS;
+
+  absl::Nonnull<std::unique_ptr<ASTConsumer>> CreateASTConsumer(
+      CompilerInstance &CI, llvm::StringRef) override {
+    registerPragmaHandler(CI.getPreprocessor(), Pragmas);
+    if (Jobs > 1) {
+      // Workers reparse from the same invocation and (virtual) files.
+      Invocation = std::make_shared<CompilerInvocation>(CI.getInvocation());
+      VFS = CI.getFileManager().getVirtualFileSystemPtr();
+    }
+
+    class Consumer : public ASTConsumer {
+     public:
+      Action &Parent;
+      Consumer(Action &Parent) : Parent(Parent) {}
+
+     private:
+      void HandleTranslationUnit(ASTContext &Ctx) override {
+        DiagnosisStats Stats;
+        DiagnosisOptions Options;
+        Options.WideningThreshold = WidenAfter;
+        Options.SummarizeFunctions = SummarizeFunctions;
+        Options.ReleaseStateAfterBlocks = ReleaseStateAfterBlocks;
+        if (PrintMemoryStats) Options.MemoryStats = printMemoryStats;
+        if (FunctionTimeoutMs)
+          Options.FunctionTimeLimit =
+              std::chrono::milliseconds(FunctionTimeoutMs);
+        if (TimeoutMs)
+          Options.Deadline = std::chrono::steady_clock::now() +
+                             std::chrono::milliseconds(TimeoutMs);
+        if (Jobs <= 1) {
+          diagnoseTranslationUnit(
+              Ctx, Parent.Pragmas,
+              [](const ValueDecl &VD,
+                 llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+                     Diags) {
+                llvm::outs() << renderDiagnoses(VD, std::move(Diags));
+              },
+              solverFactory(), &Stats, Options);
+        } else {
+          llvm::Expected<std::vector<std::string>> Results =
+              diagnoseTranslationUnitInParallel(
+                  Jobs,
+                  [&](unsigned Worker, TUDiagnoser Diagnose) {
+                    if (Worker == 0)
+                      Diagnose(Ctx, Parent.Pragmas);
+                    else
+                      parseForWorker(*Parent.Invocation, Parent.VFS,
+                                     Diagnose);
+                  },
+                  renderDiagnoses, solverFactory(), &Stats, Options);
+          QCHECK(Results) << toString(Results.takeError());
+          for (const std::string &Out : *Results) llvm::outs() << Out;
+        }
+        if (PrintStats)
+          llvm::errs() << "Analyzed " << Stats.AnalyzedFunctions
+                       << " functions (" << Stats.FailedFunctions
+                       << " did not converge, "
+                       << Stats.BudgetExceededFunctions
+                       << " ran out of time), skipped "
+                       << Stats.SkippedFunctions << " without pointers\n";
+      }
+    };
+    return std::make_unique<Consumer>(*this);
+  }
+};
+
+}  // namespace
+}  // namespace clang::tidy::nullability
+
+int main(int argc, absl::Nonnull<const char **> argv) {
+  using namespace clang::tooling;
+  auto Exec = createExecutorFromCommandLineArgs(argc, argv, Opts);
+  QCHECK(Exec) << toString(Exec.takeError());
+
+  clang::tidy::nullability::enableSmartPointers(true);
+
+  auto Err = (*Exec)->execute(
+      newFrontendActionFactory<clang::tidy::nullability::Action>(),
+      getInsertArgumentAdjuster({"-w"}, ArgumentInsertPosition::BEGIN));
+  QCHECK(!Err) << toString(std::move(Err));
+}
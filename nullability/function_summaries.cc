@@ -0,0 +1,218 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/function_summaries.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/base/nullability.h"
+#include "nullability/pointer_nullability.h"
+#include "nullability/pointer_nullability_analysis.h"
+#include "nullability/pointer_nullability_lattice.h"
+#include "nullability/pragma.h"
+#include "nullability/type_nullability.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclBase.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "clang/Analysis/CFG.h"
+#include "clang/Analysis/CallGraph.h"
+#include "clang/Analysis/FlowSensitive/AdornedCFG.h"
+#include "clang/Analysis/FlowSensitive/DataflowAnalysis.h"
+#include "clang/Analysis/FlowSensitive/DataflowAnalysisContext.h"
+#include "clang/Analysis/FlowSensitive/DataflowEnvironment.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "clang/Analysis/FlowSensitive/WatchedLiteralsSolver.h"
+#include "clang/Basic/Specifiers.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/Error.h"
+
+namespace clang::tidy::nullability {
+namespace {
+
+// The raw pointer that `S` dereferences, if it is a dereference.
+absl::Nullable<const Expr *> dereferencedPointer(const Stmt &S) {
+  if (const auto *UO = dyn_cast<UnaryOperator>(&S);
+      UO && UO->getOpcode() == UO_Deref &&
+      isSupportedRawPointerType(UO->getSubExpr()->getType()))
+    return UO->getSubExpr();
+  if (const auto *ME = dyn_cast<MemberExpr>(&S);
+      ME && ME->isArrow() &&
+      isSupportedRawPointerType(ME->getBase()->getType()))
+    return ME->getBase();
+  if (const auto *ASE = dyn_cast<ArraySubscriptExpr>(&S);
+      ASE && isSupportedRawPointerType(ASE->getBase()->getType()))
+    return ASE->getBase();
+  return nullptr;
+}
+
+// Whether the written or pragma-given top-level nullability is unspecified.
+bool isUnannotated(const TypeNullability &N) {
+  return !N.empty() && !N.front().isSymbolic() &&
+         N.front().concrete() == NullabilityKind::Unspecified;
+}
+
+// What the analysis of a function body found.
+struct BodyFacts {
+  bool SawPointerReturn = false;
+  bool AnyNullableReturn = false;
+  bool AllNonnullReturns = true;
+  // Indices of the parameters dereferenced without a null check.
+  llvm::SmallVector<unsigned> DereferencedParams;
+};
+
+// Analyzes the body of `Def`, with the summaries of the functions it calls.
+// Only the parameters in `Params` are checked for dereferences.
+llvm::Error analyzeBody(const FunctionDecl &Def,
+                        llvm::ArrayRef<const ParmVarDecl *> Params,
+                        const NullabilityPragmas &Pragmas,
+                        const SolverFactory &MakeSolver,
+                        TypeNullabilityCache &TypeCache,
+                        const FunctionSummaries &Summaries, BodyFacts &Facts) {
+  // The same bound on the analysis as for diagnosis.
+  constexpr std::int32_t MaxBlockVisits = 20'000;
+
+  ASTContext &Ctx = Def.getASTContext();
+  auto ACFG = dataflow::AdornedCFG::build(Def);
+  if (!ACFG) return ACFG.takeError();
+
+  std::unique_ptr<dataflow::Solver> Solver = MakeSolver();
+  dataflow::DataflowAnalysisContext AnalysisContext(*Solver);
+  dataflow::Environment Env(AnalysisContext, Def);
+  PointerNullabilityAnalysis Analysis(Ctx, Env, Pragmas, &TypeCache);
+  Analysis.assignNullabilityOverride(
+      [&Summaries](const Decl &D) { return Summaries.returnOverride(D); });
+
+  dataflow::CFGEltCallbacks<PointerNullabilityAnalysis> Callbacks;
+  Callbacks.Before =
+      [&](const CFGElement &Elt,
+          const dataflow::DataflowAnalysisState<PointerNullabilityLattice>
+              &State) {
+        std::optional<CFGStmt> CS = Elt.getAs<CFGStmt>();
+        if (!CS) return;
+        const Stmt &S = *CS->getStmt();
+        if (const Expr *Pointer = dereferencedPointer(S)) {
+          // A parameter that the function checks for null (or assigns a
+          // nonnull value to) is nonnull at the dereference.
+          const auto *DRE =
+              dyn_cast<DeclRefExpr>(Pointer->IgnoreParenImpCasts());
+          const auto *Param =
+              DRE ? dyn_cast<ParmVarDecl>(DRE->getDecl()) : nullptr;
+          if (!Param || !llvm::is_contained(Params, Param) ||
+              getNullability(Pointer, State.Env) == NullabilityKind::NonNull)
+            return;
+          unsigned Index = Param->getFunctionScopeIndex();
+          if (!llvm::is_contained(Facts.DereferencedParams, Index))
+            Facts.DereferencedParams.push_back(Index);
+          return;
+        }
+        if (const auto *RS = dyn_cast<ReturnStmt>(&S);
+            RS && RS->getRetValue() &&
+            isSupportedRawPointerType(RS->getRetValue()->getType())) {
+          Facts.SawPointerReturn = true;
+          NullabilityKind Returned =
+              getNullability(RS->getRetValue(), State.Env);
+          if (Returned == NullabilityKind::Nullable)
+            Facts.AnyNullableReturn = true;
+          if (Returned != NullabilityKind::NonNull)
+            Facts.AllNonnullReturns = false;
+        }
+      };
+  if (auto Result = dataflow::runDataflowAnalysis(*ACFG, Analysis, Env,
+                                                  Callbacks, MaxBlockVisits);
+      !Result)
+    return Result.takeError();
+  if (Solver->reachedLimit())
+    return llvm::createStringError(llvm::errc::interrupted,
+                                   "SAT solver reached iteration limit");
+  return llvm::Error::success();
+}
+
+}  // namespace
+
+std::unique_ptr<dataflow::Solver> makeDefaultSolverForSummaries() {
+  // Summaries are best-effort, so a function that needs more than this is
+  // left unsummarized rather than holding up the diagnosis of the TU.
+  constexpr std::int64_t MaxSATIterations = 200'000;
+  return std::make_unique<dataflow::WatchedLiteralsSolver>(MaxSATIterations);
+}
+
+FunctionSummaries FunctionSummaries::compute(ASTContext &Ctx,
+                                             const NullabilityPragmas &Pragmas,
+                                             const SolverFactory &MakeSolver) {
+  FunctionSummaries Summaries;
+  TypeNullabilityCache TypeCache;
+  TypeNullabilityDefaults Defaults(Ctx, Pragmas);
+  Defaults.Cache = &TypeCache;
+
+  CallGraph Graph;
+  Graph.addToCallGraph(Ctx.getTranslationUnitDecl());
+  // The strongly connected components are visited callees first.
+  for (auto SCC = llvm::scc_begin(&Graph); !SCC.isAtEnd(); ++SCC) {
+    for (const CallGraphNode *Node : *SCC) {
+      const auto *Func = dyn_cast_or_null<FunctionDecl>(Node->getDecl());
+      const FunctionDecl *Def = nullptr;
+      if (!Func || !Func->hasBody(Def) || Def->isTemplated()) continue;
+      if (const auto *Method = dyn_cast<CXXMethodDecl>(Def);
+          Method && Method->isVirtual())
+        continue;
+
+      bool SummarizeReturn =
+          isSupportedRawPointerType(Def->getReturnType()) &&
+          isUnannotated(getTypeNullability(*Def, Defaults));
+      llvm::SmallVector<const ParmVarDecl *> Params;
+      for (const ParmVarDecl *Param : Def->parameters())
+        if (isSupportedRawPointerType(Param->getType()) &&
+            isUnannotated(getTypeNullability(*Param, Defaults)))
+          Params.push_back(Param);
+      if (!SummarizeReturn && Params.empty()) continue;
+
+      BodyFacts Facts;
+      if (llvm::Error Err = analyzeBody(*Def, Params, Pragmas, MakeSolver,
+                                        TypeCache, Summaries, Facts)) {
+        // Without a complete analysis, nothing is known about the function.
+        llvm::consumeError(std::move(Err));
+        continue;
+      }
+
+      const FunctionDecl *Canonical = Def->getCanonicalDecl();
+      Summaries.Summarized.insert(Canonical);
+      if (SummarizeReturn && Facts.AnyNullableReturn)
+        Summaries.Returns[Canonical] = NullabilityKind::Nullable;
+      else if (SummarizeReturn && Facts.SawPointerReturn &&
+               Facts.AllNonnullReturns)
+        Summaries.Returns[Canonical] = NullabilityKind::NonNull;
+      for (unsigned Param : Facts.DereferencedParams)
+        Summaries.NonnullParams.insert({Canonical, Param});
+    }
+  }
+  return Summaries;
+}
+
+std::optional<NullabilityKind> FunctionSummaries::returnNullability(
+    const FunctionDecl &Func) const {
+  auto It = Returns.find(Func.getCanonicalDecl());
+  if (It == Returns.end()) return std::nullopt;
+  return It->second;
+}
+
+std::optional<const PointerTypeNullability *> FunctionSummaries::returnOverride(
+    const Decl &D) const {
+  static const PointerTypeNullability Nonnull = NullabilityKind::NonNull;
+  static const PointerTypeNullability Nullable = NullabilityKind::Nullable;
+  const auto *Func = dyn_cast<FunctionDecl>(&D);
+  if (!Func) return std::nullopt;
+  std::optional<NullabilityKind> Returned = returnNullability(*Func);
+  if (!Returned) return std::nullopt;
+  return *Returned == NullabilityKind::NonNull ? &Nonnull : &Nullable;
+}
+
+}  // namespace clang::tidy::nullability
@@ -0,0 +1,85 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_NULLABILITY_FUNCTION_SUMMARIES_H_
+#define CRUBIT_NULLABILITY_FUNCTION_SUMMARIES_H_
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "nullability/pointer_nullability_analysis.h"
+#include "nullability/pragma.h"
+#include "nullability/type_nullability.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclBase.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "clang/Basic/Specifiers.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
+namespace clang::tidy::nullability {
+
+/// Creates a solver with default parameters that is suitable for passing to
+/// `FunctionSummaries::compute()`.
+std::unique_ptr<dataflow::Solver> makeDefaultSolverForSummaries();
+
+/// Facts about the behavior of the functions defined in a TU, which stand in
+/// for the nullability of their unannotated return types and parameters when
+/// diagnosing their callers.
+///
+/// A function is summarized as:
+/// - returning Nullable if some value it returns is nullable (e.g. a literal
+///   `nullptr`), or else returning Nonnull if every value it returns is
+///   nonnull, and
+/// - requiring a Nonnull parameter if it dereferences the parameter's value
+///   without checking it for null first.
+///
+/// Summaries are computed bottom-up over the TU's call graph, so that each
+/// function is analyzed once, after its callees, with their summaries. (Within
+/// a cycle of recursive calls, some callees are analyzed without the summaries
+/// of others.) This gives some of the cross-function precision of inference at
+/// a fraction of the cost of iterating it to convergence.
+///
+/// Only slots with no declared nullability (by annotation or pragma) are
+/// summarized, and virtual methods are not, as their overrides may behave
+/// differently.
+class FunctionSummaries {
+ public:
+  /// Summarizes the functions defined in `Ctx`.
+  static FunctionSummaries compute(
+      ASTContext &Ctx, const NullabilityPragmas &Pragmas,
+      const SolverFactory &MakeSolver = makeDefaultSolverForSummaries);
+
+  /// The summarized nullability of the value that `Func` returns, if any.
+  std::optional<NullabilityKind> returnNullability(
+      const FunctionDecl &Func) const;
+
+  /// Whether `Func` dereferences its parameter `Param` without checking it for
+  /// null, so that the parameter should be treated as Nonnull.
+  bool requiresNonnullParam(const FunctionDecl &Func, unsigned Param) const {
+    return NonnullParams.contains({Func.getCanonicalDecl(), Param});
+  }
+
+  /// Returns the summarized nullability of the result of calls to the function
+  /// `D`, in the form of `PointerNullabilityAnalysis::assignNullabilityOverride`
+  /// callbacks. The pointee remains valid for the lifetime of the summaries.
+  std::optional<const PointerTypeNullability *> returnOverride(
+      const Decl &D) const;
+
+  /// The number of summarized functions.
+  size_t size() const { return Summarized.size(); }
+
+ private:
+  // Keyed by canonical declaration.
+  llvm::DenseMap<const FunctionDecl *, NullabilityKind> Returns;
+  llvm::DenseSet<std::pair<const FunctionDecl *, unsigned>> NonnullParams;
+  llvm::DenseSet<const FunctionDecl *> Summarized;
+};
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_FUNCTION_SUMMARIES_H_
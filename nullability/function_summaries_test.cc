@@ -0,0 +1,156 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/function_summaries.h"
+
+#include <optional>
+
+#include "absl/base/nullability.h"
+#include "nullability/pragma.h"
+#include "nullability/type_nullability.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclBase.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/Basic/LLVM.h"
+#include "clang/Basic/Specifiers.h"
+#include "clang/Testing/TestAST.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+
+namespace clang::tidy::nullability {
+namespace {
+
+absl::Nonnull<const FunctionDecl *> lookupFunction(StringRef Name,
+                                                   const DeclContext &DC) {
+  auto Result = DC.lookup(&DC.getParentASTContext().Idents.get(Name));
+  EXPECT_TRUE(Result.isSingleResult()) << Name;
+  return cast<FunctionDecl>(Result.front());
+}
+
+class FunctionSummariesTest : public ::testing::Test {
+ protected:
+  // Summarizes the functions in `Code`.
+  void summarize(llvm::StringRef Code) {
+    AST.emplace(Code);
+    Summaries.emplace(FunctionSummaries::compute(AST->context(), Pragmas));
+  }
+
+  const FunctionDecl &function(StringRef Name) {
+    return *lookupFunction(Name, *AST->context().getTranslationUnitDecl());
+  }
+
+  NullabilityPragmas Pragmas;
+  std::optional<TestAST> AST;
+  std::optional<FunctionSummaries> Summaries;
+};
+
+TEST_F(FunctionSummariesTest, ReturnsNull) {
+  summarize(R"cc(
+    int *target(bool b) {
+      static int x;
+      if (b) return &x;
+      return nullptr;
+    }
+  )cc");
+  EXPECT_EQ(Summaries->returnNullability(function("target")),
+            NullabilityKind::Nullable);
+}
+
+TEST_F(FunctionSummariesTest, ReturnsNonnull) {
+  summarize(R"cc(
+    int *target() {
+      static int x;
+      return &x;
+    }
+  )cc");
+  EXPECT_EQ(Summaries->returnNullability(function("target")),
+            NullabilityKind::NonNull);
+}
+
+TEST_F(FunctionSummariesTest, ReturnsUnknown) {
+  summarize(R"cc(
+    int *unknown();
+    int *target() { return unknown(); }
+  )cc");
+  EXPECT_EQ(Summaries->returnNullability(function("target")), std::nullopt);
+}
+
+TEST_F(FunctionSummariesTest, CalleesAreSummarizedFirst) {
+  summarize(R"cc(
+    int *callee() {
+      static int x;
+      return &x;
+    }
+    int *target() { return callee(); }
+  )cc");
+  EXPECT_EQ(Summaries->returnNullability(function("target")),
+            NullabilityKind::NonNull);
+}
+
+TEST_F(FunctionSummariesTest, UncheckedDereferenceRequiresNonnull) {
+  summarize(R"cc(
+    struct S {
+      int i;
+    };
+    int target(int *p, int *q, S *s, int *unused) { return *p + q[0] + s->i; }
+  )cc");
+  const FunctionDecl &Target = function("target");
+  EXPECT_TRUE(Summaries->requiresNonnullParam(Target, 0));
+  EXPECT_TRUE(Summaries->requiresNonnullParam(Target, 1));
+  EXPECT_TRUE(Summaries->requiresNonnullParam(Target, 2));
+  EXPECT_FALSE(Summaries->requiresNonnullParam(Target, 3));
+}
+
+TEST_F(FunctionSummariesTest, CheckedDereferenceDoesNotRequireNonnull) {
+  summarize(R"cc(
+    int target(int *p) {
+      if (p == nullptr) return 0;
+      return *p;
+    }
+  )cc");
+  EXPECT_FALSE(Summaries->requiresNonnullParam(function("target"), 0));
+}
+
+TEST_F(FunctionSummariesTest, AnnotatedSlotsAreNotSummarized) {
+  summarize(R"cc(
+    int *_Nonnull target(int *_Nullable p) {
+      *p;
+      return nullptr;
+    }
+  )cc");
+  EXPECT_EQ(Summaries->returnNullability(function("target")), std::nullopt);
+  EXPECT_FALSE(Summaries->requiresNonnullParam(function("target"), 0));
+  EXPECT_EQ(Summaries->size(), 0u);
+}
+
+TEST_F(FunctionSummariesTest, VirtualMethodsAreNotSummarized) {
+  summarize(R"cc(
+    struct Base {
+      virtual int *target(int *p) {
+        *p;
+        return nullptr;
+      }
+    };
+  )cc");
+  TranslationUnitDecl &TU = *AST->context().getTranslationUnitDecl();
+  auto &Base = *cast<CXXRecordDecl>(
+      TU.lookup(&AST->context().Idents.get("Base")).front());
+  const FunctionDecl &Target = *lookupFunction("target", Base);
+  EXPECT_EQ(Summaries->returnNullability(Target), std::nullopt);
+  EXPECT_FALSE(Summaries->requiresNonnullParam(Target, 0));
+}
+
+TEST_F(FunctionSummariesTest, ReturnOverride) {
+  summarize(R"cc(
+    int *nullable() { return nullptr; }
+    int *unknown();
+  )cc");
+  std::optional<const PointerTypeNullability *> Override =
+      Summaries->returnOverride(function("nullable"));
+  ASSERT_TRUE(Override.has_value());
+  EXPECT_EQ((*Override)->concrete(), NullabilityKind::Nullable);
+  EXPECT_EQ(Summaries->returnOverride(function("unknown")), std::nullopt);
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
@@ -0,0 +1,146 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/inference/annotate.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "nullability/inference/eligible_ranges.h"
+#include "nullability/inference/inference.proto.h"
+#include "clang/Basic/CharInfo.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace clang::tidy::nullability {
+
+AnnotationsByFile planAnnotations(llvm::ArrayRef<Inference> Inferences,
+                                  const TypeLocRangesIndex &Ranges) {
+  AnnotationsByFile Result;
+  for (const Inference &I : Inferences) {
+    const SymbolTypeLocRanges *Symbol =
+        findTypeLocRanges(Ranges, I.symbol().usr());
+    if (!Symbol) continue;
+    for (const auto &Slot : I.slot_inference()) {
+      if (Slot.trivial() || Slot.conflict()) continue;
+      if (Slot.nullability() != Nullability::NULLABLE &&
+          Slot.nullability() != Nullability::NONNULL)
+        continue;
+      for (const TypeLocRanges &Decl : Symbol->decl()) {
+        for (const SlotRange &Range : Decl.range()) {
+          if (!Range.has_slot() || Range.slot() != Slot.slot()) continue;
+          if (Range.has_existing_annotation()
+                  ? Range.existing_annotation() != Nullability::UNKNOWN
+                  : Decl.has_pragma_nullability() &&
+                        Decl.pragma_nullability() == Slot.nullability())
+            continue;
+          Result[Decl.path()].push_back({Range, Slot.nullability()});
+        }
+      }
+    }
+  }
+  return Result;
+}
+
+namespace {
+// The text replaced by an annotation: the written type, and the existing
+// annotation around it, if any.
+uint64_t replacedBegin(const SlotRange &R) {
+  return R.begin() -
+         std::min<uint64_t>(R.existing_annotation_pre_range_length(),
+                            R.begin());
+}
+uint64_t replacedEnd(const SlotRange &R) {
+  return R.end() + R.existing_annotation_post_range_length();
+}
+
+bool inBounds(const SlotRange &R, llvm::StringRef Contents) {
+  if (R.existing_annotation_pre_range_length() > R.begin()) return false;
+  if (R.end() < R.begin() || replacedEnd(R) > Contents.size()) return false;
+  return llvm::all_of(R.complex_declarator_ranges().removal(),
+                      [&](const RemovalRange &Removal) {
+                        return R.begin() <= Removal.begin() &&
+                               Removal.begin() <= Removal.end() &&
+                               Removal.end() <= R.end();
+                      });
+}
+
+// The written type in `R`, without the parts of a complex declarator that are
+// moved after the annotation.
+std::string typeText(llvm::StringRef Contents, const SlotRange &R) {
+  std::vector<std::pair<uint64_t, uint64_t>> Removals;
+  for (const RemovalRange &Removal : R.complex_declarator_ranges().removal())
+    Removals.push_back({Removal.begin(), Removal.end()});
+  llvm::sort(Removals);
+
+  std::string Text;
+  uint64_t Pos = R.begin();
+  for (auto [Begin, End] : Removals) {
+    if (Begin < Pos) continue;  // Overlaps the previous removal.
+    Text += Contents.slice(Pos, Begin);
+    Pos = End;
+  }
+  Text += Contents.slice(Pos, R.end());
+  return Text;
+}
+}  // namespace
+
+AnnotatedFile annotateFile(llvm::StringRef Contents,
+                           std::vector<SlotAnnotation> Annotations,
+                           const AnnotationSpelling &Spelling) {
+  auto Extent = [](const SlotAnnotation &A) {
+    return std::make_tuple(replacedBegin(A.Range), replacedEnd(A.Range));
+  };
+  llvm::stable_sort(Annotations,
+                    [&](const SlotAnnotation &L, const SlotAnnotation &R) {
+                      return Extent(L) < Extent(R);
+                    });
+
+  AnnotatedFile Result;
+  Result.Contents.reserve(Contents.size());
+  // The end of the text that has been copied or replaced so far.
+  uint64_t Pos = 0;
+  const SlotAnnotation *Last = nullptr;
+  for (const SlotAnnotation &A : Annotations) {
+    // The same declaration may be recorded by several TUs.
+    if (Last && Extent(*Last) == Extent(A) &&
+        Last->Nullability == A.Nullability)
+      continue;
+    uint64_t Begin = replacedBegin(A.Range), End = replacedEnd(A.Range);
+    if (!inBounds(A.Range, Contents) || Begin < Pos) {
+      ++Result.Skipped;
+      continue;
+    }
+
+    Result.Contents += Contents.slice(Pos, Begin);
+    Result.Contents += A.Nullability == Nullability::NULLABLE
+                           ? Spelling.Nullable
+                           : Spelling.Nonnull;
+    Result.Contents += '<';
+    Result.Contents += typeText(Contents, A.Range);
+    Result.Contents += '>';
+    llvm::StringRef Following =
+        A.Range.complex_declarator_ranges().following_annotation();
+    if (!Following.empty()) {
+      Result.Contents += ' ';
+      Result.Contents += Following;
+    }
+    // e.g. `int *p` becomes `absl::Nullable<int *> p`.
+    if (End < Contents.size() && isAsciiIdentifierContinue(Contents[End]))
+      Result.Contents += ' ';
+
+    Pos = End;
+    Last = &A;
+    ++Result.Applied;
+  }
+  Result.Contents += Contents.substr(Pos);
+  return Result;
+}
+
+}  // namespace clang::tidy::nullability
@@ -0,0 +1,74 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Turns inference results into nullability annotations in the source code.
+//
+// This is done in two steps, neither of which needs to parse the code again:
+//  - planAnnotations() finds the ranges of the types to annotate, using the
+//    eligible ranges recorded when evidence was collected (see
+//    getInferenceRangesIndex()), and groups them by file.
+//  - annotateFile() rewrites one file's contents. Files are independent, so
+//    this can be done for many files in parallel.
+
+#ifndef CRUBIT_NULLABILITY_INFERENCE_ANNOTATE_H_
+#define CRUBIT_NULLABILITY_INFERENCE_ANNOTATE_H_
+
+#include <string>
+#include <vector>
+
+#include "nullability/inference/inference.proto.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace clang::tidy::nullability {
+
+// A written type to annotate with its inferred nullability.
+struct SlotAnnotation {
+  SlotRange Range;
+  Nullability Nullability;
+};
+
+// The annotations to make in each file, keyed by the file's path as recorded
+// in its TypeLocRanges.
+using AnnotationsByFile = llvm::StringMap<std::vector<SlotAnnotation>>;
+
+// Finds the written types to annotate for the non-trivial, conflict-free
+// Nullable and Nonnull inferences in `Inferences`, in every declaration of
+// their symbols in `Ranges`.
+//
+// Types that are already annotated Nullable or Nonnull are left alone, as are
+// those whose inferred nullability is the default set by their file's pragma.
+// Existing NullabilityUnknown annotations are replaced.
+AnnotationsByFile planAnnotations(llvm::ArrayRef<Inference> Inferences,
+                                  const TypeLocRangesIndex &Ranges);
+
+// The names of the annotation templates to write.
+struct AnnotationSpelling {
+  std::string Nullable = "absl::Nullable";
+  std::string Nonnull = "absl::Nonnull";
+};
+
+struct AnnotatedFile {
+  std::string Contents;
+  // The number of annotations written.
+  unsigned Applied = 0;
+  // The number of annotations not written because their range overlapped that
+  // of another annotation (other than an identical duplicate), or was not
+  // within the file. This is expected to be rare, e.g. after the file was
+  // changed since its ranges were recorded.
+  unsigned Skipped = 0;
+};
+
+// Applies `Annotations` (in any order) to the contents of one file.
+//
+// Where annotations overlap, the one starting first (or, for the same start,
+// the shorter one) is applied and the others are skipped.
+AnnotatedFile annotateFile(llvm::StringRef Contents,
+                           std::vector<SlotAnnotation> Annotations,
+                           const AnnotationSpelling &Spelling = {});
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_INFERENCE_ANNOTATE_H_
@@ -0,0 +1,208 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// annotate_main writes inferred nullability annotations into the source code.
+//
+// It takes the Inferences written by `merge_main -finalize`, and the eligible
+// ranges of the declarations written by `collect_evidence_main -write-ranges`
+// and merged by `merge_main -ranges`, so no code needs to be parsed:
+//
+//   annotate_main inferences -ranges=ranges -base-dir=/src -jobs=32
+//
+// Each file is rewritten independently, so files are processed in parallel.
+// Files are replaced atomically, and only if they change. With -dry-run, the
+// number of annotations for each file is printed instead.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/nullability.h"
+#include "absl/log/check.h"
+#include "nullability/inference/annotate.h"
+#include "nullability/inference/inference.proto.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+llvm::cl::list<std::string> InferenceFiles{
+    llvm::cl::Positional,
+    llvm::cl::desc("<files of Inferences>"),
+    llvm::cl::OneOrMore,
+};
+llvm::cl::opt<std::string> RangesFile{
+    "ranges",
+    llvm::cl::desc("TypeLocRangesIndex of the declarations to annotate"),
+    llvm::cl::Required,
+};
+llvm::cl::opt<std::string> BaseDir{
+    "base-dir",
+    llvm::cl::desc("Directory that relative paths in the ranges are relative "
+                   "to (default: the working directory)"),
+};
+llvm::cl::opt<std::string> NullableSpelling{
+    "nullable",
+    llvm::cl::desc("Template to annotate Nullable types with"),
+    llvm::cl::init("absl::Nullable"),
+};
+llvm::cl::opt<std::string> NonnullSpelling{
+    "nonnull",
+    llvm::cl::desc("Template to annotate Nonnull types with"),
+    llvm::cl::init("absl::Nonnull"),
+};
+llvm::cl::opt<unsigned> Jobs{
+    "jobs",
+    llvm::cl::desc("Number of files to rewrite in parallel (0: one per core)"),
+    llvm::cl::init(0),
+};
+llvm::cl::opt<bool> DryRun{
+    "dry-run",
+    llvm::cl::desc("Report the annotations to make without writing them"),
+    llvm::cl::init(false),
+};
+
+namespace clang::tidy::nullability {
+namespace {
+
+std::unique_ptr<llvm::MemoryBuffer> readFile(llvm::StringRef Path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buffer =
+      llvm::MemoryBuffer::getFile(Path);
+  QCHECK(Buffer) << Path.str() << ": " << Buffer.getError().message();
+  return std::move(*Buffer);
+}
+
+void readInferences(llvm::StringRef Path, std::vector<Inference> &Out) {
+  auto Buffer = readFile(Path);
+  const uint8_t *Pos = Buffer->getBuffer().bytes_begin();
+  const uint8_t *End = Buffer->getBuffer().bytes_end();
+  while (Pos != End) {
+    unsigned Length = 0;
+    const char *Error = nullptr;
+    uint64_t Size = llvm::decodeULEB128(Pos, &Length, End, &Error);
+    QCHECK(!Error) << Path.str() << ": " << Error;
+    Pos += Length;
+    QCHECK_LE(Size, static_cast<uint64_t>(End - Pos)) << Path.str();
+    QCHECK(Out.emplace_back().ParseFromArray(Pos, Size))
+        << Path.str() << ": bad Inference";
+    Pos += Size;
+  }
+}
+
+// Writes `Contents` to a temporary file beside `Path`, then moves it into
+// place, so that an interrupted run never leaves a file partially written.
+bool replaceFile(llvm::StringRef Path, llvm::StringRef Contents) {
+  int FD;
+  llvm::SmallString<256> TempPath;
+  if (std::error_code EC =
+          llvm::sys::fs::createUniqueFile(Path + ".annotate-%%%%%%", FD,
+                                          TempPath)) {
+    llvm::errs() << Path << ": " << EC.message() << "\n";
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Contents;
+    if (OS.has_error()) {
+      llvm::errs() << TempPath << ": " << OS.error().message() << "\n";
+      OS.clear_error();
+      llvm::sys::fs::remove(TempPath);
+      return false;
+    }
+  }
+  if (std::error_code EC = llvm::sys::fs::rename(TempPath, Path)) {
+    llvm::errs() << Path << ": " << EC.message() << "\n";
+    llvm::sys::fs::remove(TempPath);
+    return false;
+  }
+  return true;
+}
+
+// Annotates one file. Returns false if it could not be rewritten.
+bool annotate(llvm::StringRef RelativePath,
+              std::vector<SlotAnnotation> Annotations,
+              const AnnotationSpelling &Spelling) {
+  llvm::SmallString<256> Path(RelativePath);
+  if (!BaseDir.empty()) llvm::sys::fs::make_absolute(BaseDir, Path);
+
+  // Large files are memory-mapped rather than read.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buffer =
+      llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (!Buffer) {
+    llvm::errs() << Path << ": " << Buffer.getError().message() << "\n";
+    return false;
+  }
+  AnnotatedFile Result =
+      annotateFile((*Buffer)->getBuffer(), std::move(Annotations), Spelling);
+  // Each file's message is written at once, so that those of different
+  // workers don't interleave.
+  std::string Message;
+  llvm::raw_string_ostream(Message)
+      << Path << ": " << Result.Applied << " annotations"
+      << (Result.Skipped ? ", " + std::to_string(Result.Skipped) +
+                               " overlapping or out of range"
+                         : "")
+      << "\n";
+  llvm::errs() << Message;
+  if (DryRun || Result.Applied == 0) return true;
+  return replaceFile(Path, Result.Contents);
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
+
+int main(int argc, absl::Nonnull<const char **> argv) {
+  using namespace clang::tidy::nullability;
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  std::vector<Inference> Inferences;
+  for (const auto &Path : InferenceFiles) readInferences(Path, Inferences);
+  TypeLocRangesIndex Ranges;
+  {
+    auto Buffer = readFile(RangesFile);
+    QCHECK(Ranges.ParseFromArray(Buffer->getBufferStart(),
+                                 Buffer->getBufferSize()))
+        << RangesFile << ": bad TypeLocRangesIndex";
+  }
+  AnnotationsByFile ByFile = planAnnotations(Inferences, Ranges);
+  Inferences.clear();
+  Ranges.Clear();
+
+  std::vector<llvm::StringMapEntry<std::vector<SlotAnnotation>> *> Files;
+  for (auto &Entry : ByFile) Files.push_back(&Entry);
+  AnnotationSpelling Spelling{NullableSpelling, NonnullSpelling};
+
+  unsigned Workers = Jobs ? Jobs : std::thread::hardware_concurrency();
+  if (Workers == 0) Workers = 1;
+  std::atomic<size_t> Next = 0;
+  std::atomic<unsigned> Failures = 0;
+  auto RunWorker = [&] {
+    for (size_t I = Next++; I < Files.size(); I = Next++) {
+      if (!annotate(Files[I]->getKey(), std::move(Files[I]->getValue()),
+                    Spelling))
+        ++Failures;
+    }
+  };
+  std::vector<std::thread> Threads;
+  for (unsigned Worker = 1; Worker < Workers; ++Worker)
+    Threads.emplace_back(RunWorker);
+  RunWorker();
+  for (auto &Thread : Threads) Thread.join();
+
+  llvm::errs() << "Annotated " << Files.size() - Failures << " of "
+               << Files.size() << " files\n";
+  return Failures ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/inference/annotate.h"
+
+#include <vector>
+
+#include "absl/log/check.h"
+#include "nullability/inference/inference.proto.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Testing/Annotations/Annotations.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+#include "third_party/protobuf/text_format.h"
+
+namespace clang::tidy::nullability {
+namespace {
+using ::llvm::Annotations;
+using ::testing::ElementsAre;
+using ::testing::UnorderedElementsAre;
+
+template <typename T>
+T proto(llvm::StringRef Text) {
+  T Result;
+  CHECK(proto2::TextFormat::ParseFromString(Text, &Result));
+  return Result;
+}
+
+SlotAnnotation annotation(Annotations::Range R, Nullability N) {
+  SlotAnnotation Result;
+  Result.Range.set_begin(R.Begin);
+  Result.Range.set_end(R.End);
+  Result.Nullability = N;
+  return Result;
+}
+
+MATCHER_P3(annotationOf, Begin, End, N, "") {
+  return arg.Range.begin() == Begin && arg.Range.end() == End &&
+         arg.Nullability == N;
+}
+
+TEST(PlanAnnotationsTest, AnnotatesSlotsInEveryDeclaration) {
+  auto Ranges = proto<TypeLocRangesIndex>(R"pb(
+    symbol {
+      usr: "f"
+      decl {
+        path: "f.h"
+        range { slot: 0 begin: 0 end: 5 }
+        range { slot: 1 begin: 10 end: 15 }
+        range { slot: 2 begin: 20 end: 25 existing_annotation: NONNULL }
+        range { slot: 3 begin: 30 end: 35 existing_annotation: UNKNOWN }
+        range { begin: 31 end: 34 }
+      }
+      decl {
+        path: "f.cc"
+        range { slot: 1 begin: 40 end: 45 }
+        pragma_nullability: NONNULL
+      }
+    }
+  )pb");
+  auto F = proto<Inference>(R"pb(
+    symbol { usr: "f" }
+    slot_inference { slot: 0 nullability: NULLABLE conflict: true }
+    slot_inference { slot: 1 nullability: NONNULL }
+    slot_inference { slot: 2 nullability: NONNULL trivial: true }
+    slot_inference { slot: 3 nullability: NULLABLE }
+  )pb");
+  auto Unknown = proto<Inference>(R"pb(
+    symbol { usr: "unknown" }
+    slot_inference { slot: 0 nullability: NULLABLE }
+  )pb");
+
+  AnnotationsByFile Plan = planAnnotations({F, Unknown}, Ranges);
+  // Conflicting and trivial inferences are not written, and neither is one
+  // that is the default from the file's pragma.
+  EXPECT_THAT(Plan.keys(), ElementsAre("f.h"));
+  EXPECT_THAT(Plan["f.h"],
+              UnorderedElementsAre(
+                  annotationOf(10, 15, Nullability::NONNULL),
+                  annotationOf(30, 35, Nullability::NULLABLE)));
+}
+
+TEST(AnnotateFileTest, Annotates) {
+  Annotations Code("void f($p[[int *]]p, $q[[char **]] q, int *r);");
+  AnnotatedFile Result = annotateFile(
+      Code.code(), {annotation(Code.range("q"), Nullability::NONNULL),
+                    annotation(Code.range("p"), Nullability::NULLABLE)});
+  EXPECT_EQ(Result.Contents,
+            "void f(absl::Nullable<int *> p, absl::Nonnull<char **> q, "
+            "int *r);");
+  EXPECT_EQ(Result.Applied, 2u);
+  EXPECT_EQ(Result.Skipped, 0u);
+}
+
+TEST(AnnotateFileTest, Spelling) {
+  Annotations Code("[[int *]]p;");
+  AnnotatedFile Result = annotateFile(
+      Code.code(), {annotation(Code.range(), Nullability::NONNULL)},
+      {"Nullable", "Nonnull"});
+  EXPECT_EQ(Result.Contents, "Nonnull<int *> p;");
+}
+
+TEST(AnnotateFileTest, ReplacesExistingAnnotation) {
+  Annotations Code("absl::NullabilityUnknown<[[int *]]> p;");
+  SlotAnnotation A = annotation(Code.range(), Nullability::NULLABLE);
+  A.Range.set_existing_annotation(Nullability::UNKNOWN);
+  A.Range.set_existing_annotation_pre_range_length(
+      llvm::StringRef("absl::NullabilityUnknown<").size());
+  A.Range.set_existing_annotation_post_range_length(1);
+  EXPECT_EQ(annotateFile(Code.code(), {A}).Contents,
+            "absl::Nullable<int *> p;");
+}
+
+TEST(AnnotateFileTest, ComplexDeclarator) {
+  Annotations Code("void f($whole[[int (*$name[[g]])(int)]]);");
+  SlotAnnotation A = annotation(Code.range("whole"), Nullability::NONNULL);
+  auto &Complex = *A.Range.mutable_complex_declarator_ranges();
+  Complex.set_following_annotation("g");
+  auto &Removal = *Complex.add_removal();
+  Removal.set_begin(Code.range("name").Begin);
+  Removal.set_end(Code.range("name").End);
+  EXPECT_EQ(annotateFile(Code.code(), {A}).Contents,
+            "void f(absl::Nonnull<int (*)(int)> g);");
+}
+
+TEST(AnnotateFileTest, ResolvesOverlaps) {
+  Annotations Code("$outer[[$inner[[int *]]*]]p;");
+  AnnotatedFile Result = annotateFile(
+      Code.code(), {annotation(Code.range("outer"), Nullability::NONNULL),
+                    annotation(Code.range("inner"), Nullability::NULLABLE),
+                    // A duplicate, e.g. from a header seen by two TUs.
+                    annotation(Code.range("inner"), Nullability::NULLABLE),
+                    annotation({0, 100}, Nullability::NULLABLE)});
+  // Of the annotations starting at the same place, the shorter is applied, and
+  // those overlapping it are not.
+  EXPECT_EQ(Result.Contents, "absl::Nullable<int *>*p;");
+  EXPECT_EQ(Result.Applied, 1u);
+  EXPECT_EQ(Result.Skipped, 2u);
+}
+
+TEST(AnnotateFileTest, NoAnnotations) {
+  AnnotatedFile Result = annotateFile("int *p;", {});
+  EXPECT_EQ(Result.Contents, "int *p;");
+  EXPECT_EQ(Result.Applied, 0u);
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
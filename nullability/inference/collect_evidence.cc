@@ -6,11 +6,14 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <shared_mutex>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -34,8 +37,10 @@
 #include "clang/AST/DeclBase.h"
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/DeclGroup.h"
+#include "clang/AST/DeclTemplate.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/ExprCXX.h"
+#include "clang/AST/ODRHash.h"
 #include "clang/AST/OperationKinds.h"
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/AST/Stmt.h"
@@ -54,18 +59,29 @@
 #include "clang/Analysis/FlowSensitive/Value.h"
 #include "clang/Analysis/FlowSensitive/WatchedLiteralsSolver.h"
 #include "clang/Basic/Builtins.h"
+#include "clang/Basic/FileManager.h"
 #include "clang/Basic/LLVM.h"
 #include "clang/Basic/OperatorKinds.h"
 #include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Basic/Specifiers.h"
 #include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/FunctionExtras.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 
 namespace clang::tidy::nullability {
 using ::clang::dataflow::DataflowAnalysisContext;
@@ -78,15 +94,257 @@ using ConcreteNullabilityCache =
     absl::flat_hash_map<const Decl *,
                         std::optional<const PointerTypeNullability>>;
 
-std::string_view getOrGenerateUSR(USRCache &Cache, const Decl &Decl) {
-  auto [It, Inserted] = Cache.try_emplace(&Decl);
+/// Whether the inference of a function's slot is decided already, so that no
+/// evidence need be collected for it from call sites.
+using DecidedSlotPredicate =
+    llvm::function_ref<bool(const FunctionDecl &, Slot)>;
+
+// Whether D is, or is declared within, a template instantiation or
+// specialization, whose USR depends on the template arguments.
+static bool inTemplateSpecialization(const Decl &D) {
+  for (const Decl *Cur = &D; Cur != nullptr;) {
+    if (isa<ClassTemplateSpecializationDecl, VarTemplateSpecializationDecl>(
+            Cur))
+      return true;
+    if (const auto *FD = dyn_cast<FunctionDecl>(Cur);
+        FD && FD->getTemplateSpecializationKind() != TSK_Undeclared)
+      return true;
+    const DeclContext *DC = Cur->getDeclContext();
+    Cur = DC ? Decl::castFromDeclContext(DC) : nullptr;
+  }
+  return false;
+}
+
+// Where D is written in a header, which is the same in every TU that includes
+// it, or nullopt if D is implicit, in the main file or named by a macro
+// expansion. Fields are separated by tabs, which the saved file format of
+// SharedUSRCache relies on.
+static std::optional<std::string> headerLocationKey(const Decl &D) {
+  if (D.isImplicit()) return std::nullopt;
+  const SourceManager &SM = D.getASTContext().getSourceManager();
+  SourceLocation Loc = D.getLocation();
+  if (Loc.isInvalid() || !Loc.isFileID() || SM.isInMainFile(Loc))
+    return std::nullopt;
+  auto [FID, Offset] = SM.getDecomposedLoc(Loc);
+  OptionalFileEntryRef File = SM.getFileEntryRefForID(FID);
+  if (!File) return std::nullopt;
+  // The same relative name may refer to different files in different TUs.
+  llvm::SmallString<256> Path(File->getFileEntry().tryGetRealPathName());
+  if (Path.empty()) {
+    Path = File->getName();
+    SM.getFileManager().makeAbsolutePath(Path);
+  }
+  if (Path.contains('\t') || Path.contains('\n')) return std::nullopt;
+  std::string Key;
+  llvm::raw_string_ostream OS(Key);
+  OS << Path << '\t' << File->getSize() << '\t'
+     << File->getModificationTime() << '\t' << Offset << '\t'
+     << static_cast<unsigned>(D.getKind());
+  return Key;
+}
+
+// The key of D in a SharedUSRCache, or nullopt if D's USR shouldn't be shared.
+static std::optional<std::string> sharedUSRKey(const Decl &D) {
+  if (inTemplateSpecialization(D)) return std::nullopt;
+  return headerLocationKey(D);
+}
+
+bool SharedUSRCache::getOrGenerate(const Decl &D,
+                                   llvm::SmallVectorImpl<char> &USR) {
+  std::optional<std::string> Key = sharedUSRKey(D);
+  if (!Key) return !index::generateUSRForDecl(&D, USR);
+  {
+    std::shared_lock Lock(Mu);
+    if (auto It = USRs.find(*Key); It != USRs.end()) {
+      ++Hits;
+      USR.assign(It->second.begin(), It->second.end());
+      return true;
+    }
+  }
+  // Declarations without USRs are rare, so are not remembered.
+  if (index::generateUSRForDecl(&D, USR)) return false;
+  std::unique_lock Lock(Mu);
+  USRs.try_emplace(*Key, llvm::StringRef(USR.data(), USR.size()));
+  return true;
+}
+
+llvm::Error SharedUSRCache::load(llvm::StringRef Path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buffer =
+      llvm::MemoryBuffer::getFile(Path);
+  if (!Buffer) return llvm::errorCodeToError(Buffer.getError());
+  llvm::SmallVector<llvm::StringRef> Lines;
+  (*Buffer)->getBuffer().split(Lines, '\n', /*MaxSplit=*/-1,
+                               /*KeepEmpty=*/false);
+  std::unique_lock Lock(Mu);
+  for (llvm::StringRef Line : Lines) {
+    // The USR is the last field; the others form the key.
+    auto [Key, USR] = Line.rsplit('\t');
+    if (Key.empty() || USR.empty())
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "malformed USR cache entry: " + Line);
+    USRs.try_emplace(Key, USR.str());
+  }
+  return llvm::Error::success();
+}
+
+llvm::Error SharedUSRCache::save(llvm::StringRef Path) const {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  if (EC) return llvm::errorCodeToError(EC);
+  std::shared_lock Lock(Mu);
+  for (const auto &Entry : USRs) {
+    llvm::StringRef USR = Entry.getValue();
+    // Such a USR couldn't be read back.
+    if (USR.contains('\t') || USR.contains('\n')) continue;
+    OS << Entry.getKey() << '\t' << USR << '\n';
+  }
+  OS.close();
+  if (OS.has_error()) return llvm::errorCodeToError(OS.error());
+  return llvm::Error::success();
+}
+
+size_t SharedUSRCache::size() const {
+  std::shared_lock Lock(Mu);
+  return USRs.size();
+}
+
+std::optional<uint64_t> evidenceSiteFingerprint(const Decl &D, bool Definition,
+                                                USRCache &USRCache) {
+  const auto *VD = dyn_cast<ValueDecl>(&D);
+  if (VD == nullptr || !VD->isExternallyVisible()) return std::nullopt;
+  std::optional<std::string> Key = headerLocationKey(D);
+  if (!Key) return std::nullopt;
+  std::string_view USR = getOrGenerateUSR(USRCache, D);
+  if (USR.empty()) return std::nullopt;
+
+  // The location identifies the text of the declaration, but not its meaning
+  // in the TU, e.g. after macro expansion.
+  ODRHash Hash;
+  Hash.AddQualType(VD->getType());
+  if (Definition) {
+    if (const auto *FD = dyn_cast<FunctionDecl>(VD)) {
+      if (const Stmt *Body = FD->getBody()) Hash.AddStmt(Body);
+      if (const auto *Ctor = dyn_cast<CXXConstructorDecl>(FD))
+        for (const CXXCtorInitializer *Init : Ctor->inits())
+          if (const Expr *E = Init->getInit()) Hash.AddStmt(E);
+    } else if (const auto *Var = dyn_cast<VarDecl>(VD)) {
+      if (const Expr *Init = Var->getInit()) Hash.AddStmt(Init);
+    }
+  }
+
+  llvm::SmallString<256> Fingerprinted(*Key);
+  Fingerprinted += '\0';
+  Fingerprinted += USR;
+  Fingerprinted += Definition ? "\0d\0" : "\0s\0";
+  Fingerprinted += llvm::utohexstr(Hash.CalculateHash());
+  return llvm::xxh3_64bits(Fingerprinted);
+}
+
+// The previous inferences of a slot that evidence collection may depend on.
+static uint8_t previousInferenceBits(SlotFingerprint F,
+                                     const PreviousInferences &Previous) {
+  return (Previous.isNullable(F) ? 1 : 0) | (Previous.isNonnull(F) ? 2 : 0) |
+         (Previous.isDecided(F) ? 4 : 0);
+}
+
+bool AnalyzedDefinitions::contains(uint64_t Fingerprint,
+                                   const PreviousInferences &Previous) {
+  std::shared_lock Lock(Mu);
+  auto It = Entries.find(Fingerprint);
+  if (It == Entries.end()) return false;
+  for (const auto &[Slot, Bits] : It->second)
+    if (previousInferenceBits(Slot, Previous) != Bits) return false;
+  ++Hits;
+  return true;
+}
+
+void AnalyzedDefinitions::insert(
+    uint64_t Fingerprint, const llvm::DenseSet<SlotFingerprint> &Consulted,
+    const PreviousInferences &Previous) {
+  ConsultedSlots Slots;
+  Slots.reserve(Consulted.size());
+  for (SlotFingerprint Slot : Consulted)
+    Slots.emplace_back(Slot, previousInferenceBits(Slot, Previous));
+  std::unique_lock Lock(Mu);
+  Entries.insert_or_assign(Fingerprint, std::move(Slots));
+}
+
+llvm::Error AnalyzedDefinitions::load(llvm::StringRef Path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buffer =
+      llvm::MemoryBuffer::getFile(Path);
+  if (!Buffer) return llvm::errorCodeToError(Buffer.getError());
+  llvm::SmallVector<llvm::StringRef> Lines;
+  (*Buffer)->getBuffer().split(Lines, '\n', /*MaxSplit=*/-1,
+                               /*KeepEmpty=*/false);
+  auto Malformed = [](llvm::StringRef Line) {
+    return llvm::createStringError(
+        llvm::inconvertibleErrorCode(),
+        "malformed analyzed definitions entry: " + Line);
+  };
+  std::unique_lock Lock(Mu);
+  for (llvm::StringRef Line : Lines) {
+    // The fingerprint, then a `slot:bits` field for each consulted slot, all
+    // separated by spaces.
+    llvm::SmallVector<llvm::StringRef> Fields;
+    Line.split(Fields, ' ');
+    uint64_t Fingerprint;
+    if (Fields[0].getAsInteger(16, Fingerprint)) return Malformed(Line);
+    ConsultedSlots Slots;
+    for (llvm::StringRef Field : llvm::drop_begin(Fields)) {
+      auto [SlotText, BitsText] = Field.split(':');
+      SlotFingerprint Slot;
+      uint8_t Bits;
+      if (SlotText.getAsInteger(16, Slot) || BitsText.getAsInteger(10, Bits))
+        return Malformed(Line);
+      Slots.emplace_back(Slot, Bits);
+    }
+    Entries.try_emplace(Fingerprint, std::move(Slots));
+  }
+  return llvm::Error::success();
+}
+
+llvm::Error AnalyzedDefinitions::save(llvm::StringRef Path) const {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  if (EC) return llvm::errorCodeToError(EC);
+  std::shared_lock Lock(Mu);
+  for (const auto &[Fingerprint, Slots] : Entries) {
+    OS << llvm::utohexstr(Fingerprint);
+    for (const auto &[Slot, Bits] : Slots)
+      OS << ' ' << llvm::utohexstr(Slot) << ':' << static_cast<unsigned>(Bits);
+    OS << '\n';
+  }
+  OS.close();
+  if (OS.has_error()) return llvm::errorCodeToError(OS.error());
+  return llvm::Error::success();
+}
+
+size_t AnalyzedDefinitions::size() const {
+  std::shared_lock Lock(Mu);
+  return Entries.size();
+}
+
+std::optional<SymbolId> USRCache::getOrCreateId(const Decl &D) {
+  auto [It, Inserted] = Ids.try_emplace(&D);
   if (Inserted) {
     llvm::SmallString<128> USR;
-    if (!index::generateUSRForDecl(&Decl, USR)) It->second = USR.str();
+    bool Generated = Shared ? Shared->getOrGenerate(D, USR)
+                            : !index::generateUSRForDecl(&D, USR);
+    if (Generated) {
+      auto [USRIt, NewUSR] = IdsByUSR.try_emplace(USR, USRs.size());
+      if (NewUSR) USRs.push_back(&*USRIt);
+      It->second = USRIt->second;
+    }
   }
   return It->second;
 }
 
+std::string_view getOrGenerateUSR(USRCache &Cache, const Decl &Decl) {
+  if (std::optional<SymbolId> Id = Cache.getOrCreateId(Decl))
+    return Cache.usr(*Id);
+  return {};
+}
+
 static llvm::DenseSet<const CXXMethodDecl *> getOverridden(
     const CXXMethodDecl *Derived) {
   llvm::DenseSet<const CXXMethodDecl *> Overridden;
@@ -114,9 +372,17 @@ struct EvidenceLocationsWalker : public RecursiveASTVisitor<Derived> {
   bool shouldVisitImplicitCode() const { return true; }
 };
 
-using VirtualMethodOverridesMap =
-    absl::flat_hash_map<const CXXMethodDecl *,
-                        llvm::DenseSet<const CXXMethodDecl *>>;
+/// Records the methods MD overrides, and MD as an override of each of them.
+static void addVirtualMethodOverrides(const CXXMethodDecl *MD,
+                                      VirtualMethodOverridesMap &Out) {
+  if (MD->isVirtual()) {
+    llvm::DenseSet<const CXXMethodDecl *> Overridden = getOverridden(MD);
+    for (const auto *O : Overridden) {
+      Out[O].Overriders.insert(MD);
+    }
+    Out[MD].Overridden = std::move(Overridden);
+  }
+}
 
 /// Collect a map from virtual methods to a set of their overrides.
 static VirtualMethodOverridesMap getVirtualMethodOverrides(ASTContext &Ctx) {
@@ -124,11 +390,7 @@ static VirtualMethodOverridesMap getVirtualMethodOverrides(ASTContext &Ctx) {
     VirtualMethodOverridesMap Out;
 
     bool VisitCXXMethodDecl(const CXXMethodDecl *MD) {
-      if (MD->isVirtual()) {
-        for (const auto *O : getOverridden(MD)) {
-          Out[O].insert(MD);
-        }
-      }
+      addVirtualMethodOverrides(MD, Out);
       return true;
     }
   };
@@ -181,38 +443,28 @@ static VirtualMethodEvidenceFlowDirection getFlowDirection(Evidence::Kind Kind,
   }
 }
 
-static llvm::DenseSet<const CXXMethodDecl *>
-getAdditionalTargetsForVirtualMethod(
-    const CXXMethodDecl *MD, Evidence::Kind Kind, bool ForReturnSlot,
-    const VirtualMethodOverridesMap &OverridesMap) {
-  VirtualMethodEvidenceFlowDirection FlowDirection =
-      getFlowDirection(Kind, ForReturnSlot);
-  switch (FlowDirection) {
-    case kFromBaseToDerived:
-      if (auto It = OverridesMap.find(MD); It != OverridesMap.end())
-        return It->second;
-      return {};
-    case kFromDerivedToBase:
-      return getOverridden(MD);
-    case kBoth:
-      llvm::DenseSet<const CXXMethodDecl *> Results = getOverridden(MD);
-      if (auto It = OverridesMap.find(MD); It != OverridesMap.end())
-        Results.insert(It->second.begin(), It->second.end());
-      return Results;
-  }
-}
-
-llvm::unique_function<EvidenceEmitter> evidenceEmitter(
-    llvm::unique_function<void(const Evidence &) const> Emit,
-    USRCache &USRCache, ASTContext &Ctx) {
+namespace {
+// Reports evidence with the target symbol identified by its id.
+// The Evidence may be modified by the callback (e.g. to set its symbol).
+using SymbolEvidenceCallback = void(SymbolId, Evidence &) const;
+
+llvm::unique_function<EvidenceEmitter> makeEvidenceEmitter(
+    llvm::unique_function<SymbolEvidenceCallback> Emit, USRCache &USRCache,
+    ASTContext &Ctx,
+    absl::Nullable<const VirtualMethodOverridesMap *> Overrides) {
   class EvidenceEmitterImpl {
    public:
     EvidenceEmitterImpl(
-        llvm::unique_function<void(const Evidence &) const> Emit,
-        nullability::USRCache &USRCache, ASTContext &Ctx)
-        : Emit(std::move(Emit)),
-          USRCache(USRCache),
-          OverridesMap(getVirtualMethodOverrides(Ctx)) {}
+        llvm::unique_function<SymbolEvidenceCallback> Emit,
+        nullability::USRCache &USRCache, ASTContext &Ctx,
+        absl::Nullable<const VirtualMethodOverridesMap *> Overrides)
+        : Emit(std::move(Emit)), USRCache(USRCache), OverridesMap(Overrides) {
+      if (!OverridesMap) {
+        OwnedOverridesMap = std::make_unique<const VirtualMethodOverridesMap>(
+            getVirtualMethodOverrides(Ctx));
+        OverridesMap = OwnedOverridesMap.get();
+      }
+    }
 
     void operator()(const Decl &Target, Slot S, Evidence::Kind Kind,
                     SourceLocation Loc) const {
@@ -226,9 +478,8 @@ llvm::unique_function<EvidenceEmitter> evidenceEmitter(
       E.set_slot(S);
       E.set_kind(Kind);
 
-      std::string_view USR = getOrGenerateUSR(USRCache, Target);
-      if (USR.empty()) return;  // Can't emit without a USR
-      E.mutable_symbol()->set_usr(USR);
+      std::optional<SymbolId> Symbol = USRCache.getOrCreateId(Target);
+      if (!Symbol) return;  // Can't emit without a USR
 
       // TODO: make collecting and propagating location information optional?
       auto &SM =
@@ -238,29 +489,95 @@ llvm::unique_function<EvidenceEmitter> evidenceEmitter(
       if (Loc = SM.getFileLoc(Loc); Loc.isValid())
         E.set_location(Loc.printToString(SM));
 
-      Emit(E);
+      Emit(*Symbol, E);
 
       // Virtual methods and their overrides constrain each other's
       // nullabilities, so propagate evidence in the appropriate direction based
       // on the evidence kind and whether the evidence is for the return type or
       // a parameter type.
       if (auto *MD = dyn_cast<CXXMethodDecl>(&Target); MD && MD->isVirtual()) {
-        for (const auto *O : getAdditionalTargetsForVirtualMethod(
-                 MD, Kind, S == SLOT_RETURN_TYPE, OverridesMap)) {
-          USR = getOrGenerateUSR(USRCache, *O);
-          if (USR.empty()) return;  // Can't emit without a USR
-          E.mutable_symbol()->set_usr(USR);
-          Emit(E);
+        auto It = OverridesMap->find(MD);
+        if (It == OverridesMap->end()) return;
+        const OverrideClosure &Closure = It->second;
+        switch (getFlowDirection(Kind, S == SLOT_RETURN_TYPE)) {
+          case kFromBaseToDerived:
+            emitFor(Closure.Overriders, E);
+            return;
+          case kFromDerivedToBase:
+            emitFor(Closure.Overridden, E);
+            return;
+          case kBoth:
+            if (emitFor(Closure.Overridden, E)) emitFor(Closure.Overriders, E);
+            return;
         }
       }
     }
 
    private:
-    llvm::unique_function<void(const Evidence &) const> Emit;
+    // Emits `E` for each of `Methods`. Returns false if it stopped at a method
+    // with no USR.
+    bool emitFor(const llvm::DenseSet<const CXXMethodDecl *> &Methods,
+                 Evidence &E) const {
+      for (const CXXMethodDecl *O : Methods) {
+        std::optional<SymbolId> Symbol = USRCache.getOrCreateId(*O);
+        if (!Symbol) return false;  // Can't emit without a USR
+        Emit(*Symbol, E);
+      }
+      return true;
+    }
+
+    llvm::unique_function<SymbolEvidenceCallback> Emit;
     nullability::USRCache &USRCache;
-    const VirtualMethodOverridesMap OverridesMap;
+    // Owned by the emitter if they were not provided. Held by pointer so that
+    // the emitter can be moved.
+    std::unique_ptr<const VirtualMethodOverridesMap> OwnedOverridesMap;
+    absl::Nonnull<const VirtualMethodOverridesMap *> OverridesMap;
   };
-  return EvidenceEmitterImpl(std::move(Emit), USRCache, Ctx);
+  return EvidenceEmitterImpl(std::move(Emit), USRCache, Ctx, Overrides);
+}
+}  // namespace
+
+llvm::unique_function<EvidenceEmitter> evidenceEmitter(
+    llvm::unique_function<void(const Evidence &) const> Emit,
+    USRCache &USRCache, ASTContext &Ctx,
+    absl::Nullable<const VirtualMethodOverridesMap *> Overrides) {
+  return makeEvidenceEmitter(
+      [Emit = std::move(Emit), &USRCache](SymbolId Symbol, Evidence &E) {
+        E.mutable_symbol()->set_usr(USRCache.usr(Symbol));
+        Emit(E);
+      },
+      USRCache, Ctx, Overrides);
+}
+
+llvm::unique_function<EvidenceEmitter> symbolEvidenceEmitter(
+    llvm::unique_function<void(SymbolId, const Evidence &) const> Emit,
+    USRCache &USRCache, ASTContext &Ctx,
+    absl::Nullable<const VirtualMethodOverridesMap *> Overrides) {
+  return makeEvidenceEmitter(
+      [Emit = std::move(Emit)](SymbolId Symbol, Evidence &E) {
+        Emit(Symbol, E);
+      },
+      USRCache, Ctx, Overrides);
+}
+
+void EvidenceDeduplicator::operator()(const Decl &Target, Slot S,
+                                      Evidence::Kind Kind,
+                                      SourceLocation Loc) {
+  Occurrences &O = Buffered[std::make_tuple(&Target, static_cast<unsigned>(S),
+                                            static_cast<unsigned>(Kind))];
+  if (O.Count++ == 0) O.First = Loc;
+}
+
+unsigned EvidenceDeduplicator::flush() {
+  unsigned Dropped = 0;
+  for (const auto &[Key, O] : Buffered) {
+    const auto &[Target, S, Kind] = Key;
+    Emit(*Target, static_cast<Slot>(S), static_cast<Evidence::Kind>(Kind),
+         O.First);
+    Dropped += O.Count - 1;
+  }
+  Buffered.clear();
+  return Dropped;
 }
 
 namespace {
@@ -321,11 +638,13 @@ static const Formula &getInferableSlotsAsInferredOrUnknownConstraint(
   for (auto &IS : InferableSlots) {
     std::string_view USR = getOrGenerateUSR(USRCache, IS.getInferenceTarget());
     SlotFingerprint Fingerprint = fingerprint(USR, IS.getTargetSlot());
+    if (PreviousInferences.Consulted)
+      PreviousInferences.Consulted->insert(Fingerprint);
     auto Nullability = IS.getSymbolicNullability();
-    const Formula &Nullable = PreviousInferences.Nullable.contains(Fingerprint)
+    const Formula &Nullable = PreviousInferences.isNullable(Fingerprint)
                                   ? Nullability.isNullable(A)
                                   : A.makeNot(Nullability.isNullable(A));
-    const Formula &Nonnull = PreviousInferences.Nonnull.contains(Fingerprint)
+    const Formula &Nonnull = PreviousInferences.isNonnull(Fingerprint)
                                  ? Nullability.isNonnull(A)
                                  : A.makeNot(Nullability.isNonnull(A));
     Constraint = &A.makeAnd(*Constraint, A.makeAnd(Nullable, Nonnull));
@@ -369,7 +688,8 @@ static TypeNullability getReturnTypeNullabilityAnnotations(
   // FunctionTypeLoc, such as those with attributes, would need excavation of
   // the function's FunctionTypeLoc before being able to retrieve the return
   // TypeLoc.
-  return getTypeNullability(D.getReturnType(), getGoverningFile(&D), Defaults);
+  return getTypeNullability(D.getReturnType(), getGoverningFile(&D, Defaults),
+                            Defaults);
 }
 
 static TypeNullability getReturnTypeNullabilityAnnotationsWithOverrides(
@@ -458,11 +778,13 @@ class DefinitionEvidenceCollector {
   static void collect(std::vector<InferableSlot> &InferableSlots,
                       const Formula &InferableSlotsConstraint,
                       llvm::function_ref<EvidenceEmitter> Emit,
+                      DecidedSlotPredicate IsDecided,
                       const CFGElement &CFGElem,
                       const PointerNullabilityLattice &Lattice,
                       const Environment &Env) {
-    DefinitionEvidenceCollector Collector(
-        InferableSlots, InferableSlotsConstraint, Emit, Lattice, Env);
+    DefinitionEvidenceCollector Collector(InferableSlots,
+                                          InferableSlotsConstraint, Emit,
+                                          IsDecided, Lattice, Env);
     if (auto CFGStmt = CFGElem.getAs<clang::CFGStmt>()) {
       const Stmt *S = CFGStmt->getStmt();
       if (!S) return;
@@ -482,11 +804,13 @@ class DefinitionEvidenceCollector {
   DefinitionEvidenceCollector(std::vector<InferableSlot> &InferableSlots,
                               const Formula &InferableSlotsConstraint,
                               llvm::function_ref<EvidenceEmitter> Emit,
+                              DecidedSlotPredicate IsDecided,
                               const PointerNullabilityLattice &Lattice,
                               const Environment &Env)
       : InferableSlots(InferableSlots),
         InferableSlotsConstraint(InferableSlotsConstraint),
         Emit(Emit),
+        IsDecided(IsDecided),
         Lattice(Lattice),
         Env(Env) {}
 
@@ -672,7 +996,8 @@ class DefinitionEvidenceCollector {
                              ArgLoc);
       }
 
-      if (CollectEvidenceForCallee) {
+      if (CollectEvidenceForCallee &&
+          !IsDecided(CalleeDecl, paramSlot(Iter.paramIdx()))) {
         // Emit evidence of the parameter's nullability. First, calculate that
         // nullability based on InferableSlots for the caller being assigned to
         // Unknown or their previously-inferred value, to reflect the current
@@ -1221,6 +1546,7 @@ class DefinitionEvidenceCollector {
   const std::vector<InferableSlot> &InferableSlots;
   const Formula &InferableSlotsConstraint;
   llvm::function_ref<EvidenceEmitter> Emit;
+  DecidedSlotPredicate IsDecided;
   const PointerNullabilityLattice &Lattice;
   const Environment &Env;
 };
@@ -1256,9 +1582,11 @@ static auto getConcreteNullabilityOverrideFromPreviousInferences(
       if (!FingerprintedDecl) return std::nullopt;
       auto Fingerprint =
           fingerprint(getOrGenerateUSR(USRCache, **FingerprintedDecl), Slot);
-      if (PreviousInferences.Nullable.contains(Fingerprint)) {
+      if (PreviousInferences.Consulted)
+        PreviousInferences.Consulted->insert(Fingerprint);
+      if (PreviousInferences.isNullable(Fingerprint)) {
         It->second.emplace(NullabilityKind::Nullable);
-      } else if (PreviousInferences.Nonnull.contains(Fingerprint)) {
+      } else if (PreviousInferences.isNonnull(Fingerprint)) {
         It->second.emplace(NullabilityKind::NonNull);
       } else {
         It->second = std::nullopt;
@@ -1281,11 +1609,138 @@ static bool hasAnyInferenceTargets(dataflow::ReferencedDecls &RD) {
          hasAnyInferenceTargets(RD.Functions);
 }
 
+namespace {
+// Finds whether code mentions any inference target, and so whether analyzing
+// it could produce evidence. This errs on the side of finding one: a mention of
+// the code's own parameters is not counted, but one of a structured binding or
+// of a default argument or member initializer (whose code is elsewhere) is.
+class InferenceTargetFinder
+    : public RecursiveASTVisitor<InferenceTargetFinder> {
+ public:
+  bool shouldVisitImplicitCode() const { return true; }
+
+  bool VisitDeclRefExpr(const DeclRefExpr *E) { return check(E->getDecl()); }
+  bool VisitMemberExpr(const MemberExpr *E) {
+    return check(E->getMemberDecl());
+  }
+  bool VisitCallExpr(const CallExpr *E) { return check(E->getCalleeDecl()); }
+  bool VisitCXXConstructExpr(const CXXConstructExpr *E) {
+    return check(E->getConstructor());
+  }
+  bool VisitCXXInheritedCtorInitExpr(const CXXInheritedCtorInitExpr *E) {
+    return check(E->getConstructor());
+  }
+  bool VisitCXXDefaultArgExpr(const CXXDefaultArgExpr *) { return found(); }
+  bool VisitCXXDefaultInitExpr(const CXXDefaultInitExpr *) { return found(); }
+
+  // Whether an inference target was found. Traversal stops once one is.
+  bool Found = false;
+
+ private:
+  bool check(absl::Nullable<const Decl *> D) {
+    if (D && (isa<BindingDecl>(D) || isInferenceTarget(*D))) return found();
+    return true;
+  }
+  bool found() {
+    Found = true;
+    return false;
+  }
+};
+}  // namespace
+
+// Whether analyzing the body of `Func` could produce any evidence.
+//
+// Most evidence is about the inference targets that the body mentions, so the
+// many small functions (accessors, wrappers of APIs taking no pointers) that
+// mention none can be skipped without building a CFG or running the analysis.
+static bool mayProduceEvidence(const FunctionDecl &Func) {
+  // A function's own slots get evidence from its body, and constructors also
+  // give evidence for fields they leave default-initialized, even unmentioned.
+  if (isInferenceTarget(Func) || isa<CXXConstructorDecl>(Func)) return true;
+  InferenceTargetFinder Finder;
+  Finder.TraverseStmt(Func.getBody());
+  return Finder.Found;
+}
+
 std::unique_ptr<dataflow::Solver> makeDefaultSolverForInference() {
   constexpr std::int64_t MaxSATIterations = 200'000;
   return std::make_unique<dataflow::WatchedLiteralsSolver>(MaxSATIterations);
 }
 
+namespace {
+// Forwards to another solver, counting the queries made.
+class CountingSolver : public dataflow::Solver {
+ public:
+  explicit CountingSolver(std::unique_ptr<dataflow::Solver> Inner)
+      : Inner(std::move(Inner)) {}
+
+  Result solve(llvm::ArrayRef<const dataflow::Formula *> Vals) override {
+    ++Calls;
+    return Inner->solve(Vals);
+  }
+
+  bool reachedLimit() const override { return Inner->reachedLimit(); }
+
+  uint64_t calls() const { return Calls; }
+
+ private:
+  std::unique_ptr<dataflow::Solver> Inner;
+  uint64_t Calls = 0;
+};
+}  // namespace
+
+// Forwards to the solver of the definition being analyzed, which changes
+// while the context that refers to this solver lives on.
+class AnalysisContextPool::ForwardingSolver : public dataflow::Solver {
+ public:
+  Result solve(llvm::ArrayRef<const dataflow::Formula *> Vals) override {
+    return Inner->solve(Vals);
+  }
+
+  bool reachedLimit() const override { return Inner->reachedLimit(); }
+
+  absl::Nullable<dataflow::Solver *> Inner = nullptr;
+};
+
+AnalysisContextPool::AnalysisContextPool(uint64_t MaxAtoms)
+    : MaxAtoms(MaxAtoms), Solver(std::make_unique<ForwardingSolver>()) {}
+
+AnalysisContextPool::~AnalysisContextPool() = default;
+
+DataflowAnalysisContext &AnalysisContextPool::acquire(
+    dataflow::Solver &DefinitionSolver, ASTContext &Ctx,
+    const NullabilityPragmas &Pragmas,
+    absl::Nullable<TypeNullabilityCache *> TypeCache,
+    const dataflow::FieldSet &Fields) {
+  Solver->Inner = &DefinitionSolver;
+  // The fields of another AST can't be modeled in a context for this one.
+  if (&Ctx != AnalysisCtx) ContextFields.clear();
+  if (Context && (nullabilityAtomsCreated() - ContextAtomsStart >= MaxAtoms ||
+                  &Ctx != AnalysisCtx || &Pragmas != AnalysisPragmas ||
+                  TypeCache != AnalysisTypeCache ||
+                  !ContextFields.covers(Fields))) {
+    // The analysis refers to the context's arena.
+    Analysis.reset();
+    Context.reset();
+  }
+  if (Context) {
+    Analysis->resetForNextTarget();
+  } else {
+    Context = std::make_unique<DataflowAnalysisContext>(*Solver);
+    Environment Env(*Context);
+    Analysis = std::make_unique<PointerNullabilityAnalysis>(Ctx, Env, Pragmas,
+                                                            TypeCache);
+    // After the analysis has set up the synthetic fields.
+    ContextFields.seed(*Context, Ctx, Fields);
+    AnalysisCtx = &Ctx;
+    AnalysisPragmas = &Pragmas;
+    AnalysisTypeCache = TypeCache;
+    ContextAtomsStart = nullabilityAtomsCreated();
+    ++Created;
+  }
+  return *Context;
+}
+
 // If D is a constructor definition, collect ASSIGNED_FROM_NULLABLE evidence for
 // smart pointer fields implicitly default-initialized and left nullable in the
 // exit block of the constructor body.
@@ -1339,11 +1794,16 @@ static void collectEvidenceFromConstructorExitBlock(
   }
 }
 
-llvm::Error collectEvidenceFromDefinition(
+// Implements collectEvidenceFromDefinition, except for the measurements that
+// cover the whole call (symbol, wall time, and failure), which the caller
+// records.
+static llvm::Error collectEvidenceFromDefinitionImpl(
     const Decl &Definition, llvm::function_ref<EvidenceEmitter> Emit,
     USRCache &USRCache, const NullabilityPragmas &Pragmas,
     const PreviousInferences PreviousInferences,
-    const SolverFactory &MakeSolver) {
+    const SolverFactory &MakeSolver, DefinitionStats *Stats,
+    TypeNullabilityCache *TypeCache, unsigned WideningThreshold,
+    AnalysisContextPool *ContextPool) {
   ASTContext &Ctx = Definition.getASTContext();
   dataflow::ReferencedDecls ReferencedDecls;
   Stmt *TargetStmt = nullptr;
@@ -1354,6 +1814,10 @@ llvm::Error collectEvidenceFromDefinition(
       return llvm::createStringError(llvm::inconvertibleErrorCode(),
                                      "Function definitions must have a body.");
     }
+    if (!mayProduceEvidence(*TargetAsFunc)) {
+      if (Stats) Stats->set_no_inference_targets(true);
+      return llvm::Error::success();
+    }
     TargetStmt = TargetAsFunc->getBody();
     ReferencedDecls = dataflow::getReferencedDecls(*TargetAsFunc);
   } else if (auto *Var = dyn_cast<VarDecl>(&Definition)) {
@@ -1375,6 +1839,7 @@ llvm::Error collectEvidenceFromDefinition(
       // If this variable is not an inference target and the initializer does
       // not reference any inference targets, we won't be able to collect any
       // useful evidence from the initializer.
+      if (Stats) Stats->set_no_inference_targets(true);
       return llvm::Error::success();
     }
   } else {
@@ -1391,19 +1856,29 @@ llvm::Error collectEvidenceFromDefinition(
       dataflow::AdornedCFG::build(Definition, *TargetStmt, Ctx);
   if (!ACFG) return ACFG.takeError();
 
-  std::unique_ptr<dataflow::Solver> Solver = MakeSolver();
-  DataflowAnalysisContext AnalysisContext(*Solver);
+  CountingSolver Solver(MakeSolver());
+  std::optional<DataflowAnalysisContext> OwnedContext;
+  DataflowAnalysisContext &AnalysisContext =
+      ContextPool ? ContextPool->acquire(Solver, Ctx, Pragmas, TypeCache,
+                                         ReferencedDecls.Fields)
+                  : OwnedContext.emplace(Solver);
+  const uint64_t AtomsBefore = nullabilityAtomsCreated();
   Environment Env = TargetAsFunc ? Environment(AnalysisContext, *TargetAsFunc)
                                  : Environment(AnalysisContext, *TargetStmt);
-  PointerNullabilityAnalysis Analysis(Ctx, Env, Pragmas);
+  std::optional<PointerNullabilityAnalysis> OwnedAnalysis;
+  PointerNullabilityAnalysis &Analysis =
+      ContextPool ? ContextPool->analysis()
+                  : OwnedAnalysis.emplace(Ctx, Env, Pragmas, TypeCache);
+  Analysis.setWideningThreshold(WideningThreshold);
 
   TypeNullabilityDefaults Defaults = TypeNullabilityDefaults(Ctx, Pragmas);
+  Defaults.Cache = TypeCache;
 
   std::vector<InferableSlot> InferableSlots;
   if (TargetAsFunc && isInferenceTarget(*TargetAsFunc)) {
     auto Parameters = TargetAsFunc->parameters();
     for (auto I = 0; I < Parameters.size(); ++I) {
-      if (hasInferable(Parameters[I]->getType().getNonReferenceType()) &&
+      if (isInferableSlot(*TargetAsFunc, paramSlot(I)) &&
           !evidenceKindFromDeclaredTypeLoc(
               Parameters[I]->getTypeSourceInfo()->getTypeLoc(), Defaults)) {
         InferableSlots.emplace_back(Analysis.assignNullabilityVariable(
@@ -1433,7 +1908,7 @@ llvm::Error collectEvidenceFromDefinition(
   }
   for (const FunctionDecl *Function : ReferencedDecls.Functions) {
     if (isInferenceTarget(*Function) &&
-        hasInferable(Function->getReturnType()) &&
+        isInferableSlot(*Function, SLOT_RETURN_TYPE) &&
         !evidenceKindFromDeclaredReturnType(*Function, Defaults)) {
       InferableSlots.emplace_back(
           Analysis.assignNullabilityVariable(Function, AnalysisContext.arena()),
@@ -1451,6 +1926,25 @@ llvm::Error collectEvidenceFromDefinition(
       getConcreteNullabilityOverrideFromPreviousInferences(
           ConcreteNullabilityCache, USRCache, PreviousInferences));
 
+  llvm::DenseMap<std::pair<const FunctionDecl *, unsigned>, bool> DecidedSlots;
+  auto IsDecided = [&](const FunctionDecl &Fn, Slot S) {
+    if (!PreviousInferences.hasDecided()) return false;
+    // Evidence for a virtual method's parameters is also evidence for those of
+    // its overrides, which may not be decided.
+    if (auto *Method = dyn_cast<CXXMethodDecl>(&Fn);
+        Method && Method->isVirtual())
+      return false;
+    auto [It, Inserted] = DecidedSlots.try_emplace({Fn.getCanonicalDecl(), S});
+    if (Inserted) {
+      SlotFingerprint Fingerprint =
+          fingerprint(getOrGenerateUSR(USRCache, Fn), S);
+      if (PreviousInferences.Consulted)
+        PreviousInferences.Consulted->insert(Fingerprint);
+      It->second = PreviousInferences.isDecided(Fingerprint);
+    }
+    return It->second;
+  };
+
   std::vector<
       std::optional<dataflow::DataflowAnalysisState<PointerNullabilityLattice>>>
       Results;
@@ -1459,16 +1953,26 @@ llvm::Error collectEvidenceFromDefinition(
       [&](const CFGElement &Element,
           const dataflow::DataflowAnalysisState<PointerNullabilityLattice>
               &State) {
-        DefinitionEvidenceCollector::collect(InferableSlots,
-                                             InferableSlotsConstraint, Emit,
-                                             Element, State.Lattice, State.Env);
+        DefinitionEvidenceCollector::collect(
+            InferableSlots, InferableSlotsConstraint, Emit, IsDecided, Element,
+            State.Lattice, State.Env);
       };
-  if (llvm::Error Error = dataflow::runDataflowAnalysis(*ACFG, Analysis, Env,
-                                                        PostAnalysisCallbacks)
-                              .moveInto(Results))
-    return Error;
+  llvm::Error Error = dataflow::runDataflowAnalysis(*ACFG, Analysis, Env,
+                                                   PostAnalysisCallbacks)
+                          .moveInto(Results);
+  if (Stats) {
+    Stats->set_cfg_blocks(ACFG->getCFG().getNumBlockIDs());
+    Stats->set_transferred_elements(Analysis.transferredElements());
+    Stats->set_solver_calls(Solver.calls());
+    Stats->set_reached_sat_limit(Solver.reachedLimit());
+    Stats->set_forced_widenings(Analysis.forcedWidenings());
+    // The arena only grows while the definition is analyzed, so this is also
+    // its peak for the definition.
+    Stats->set_arena_atoms(nullabilityAtomsCreated() - AtomsBefore);
+  }
+  if (Error) return Error;
 
-  if (Solver->reachedLimit()) {
+  if (Solver.reachedLimit()) {
     return llvm::createStringError(llvm::errc::interrupted,
                                    "SAT solver reached iteration limit");
   }
@@ -1483,6 +1987,31 @@ llvm::Error collectEvidenceFromDefinition(
   return llvm::Error::success();
 }
 
+llvm::Error collectEvidenceFromDefinition(
+    const Decl &Definition, llvm::function_ref<EvidenceEmitter> Emit,
+    USRCache &USRCache, const NullabilityPragmas &Pragmas,
+    const PreviousInferences PreviousInferences,
+    const SolverFactory &MakeSolver, DefinitionStats *Stats,
+    TypeNullabilityCache *TypeCache, unsigned WideningThreshold,
+    AnalysisContextPool *ContextPool) {
+  if (!Stats)
+    return collectEvidenceFromDefinitionImpl(
+        Definition, Emit, USRCache, Pragmas, PreviousInferences, MakeSolver,
+        /*Stats=*/nullptr, TypeCache, WideningThreshold, ContextPool);
+
+  auto Start = std::chrono::steady_clock::now();
+  llvm::Error Err = collectEvidenceFromDefinitionImpl(
+      Definition, Emit, USRCache, Pragmas, PreviousInferences, MakeSolver,
+      Stats, TypeCache, WideningThreshold, ContextPool);
+  Stats->set_wall_time_micros(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - Start)
+          .count());
+  Stats->mutable_symbol()->set_usr(getOrGenerateUSR(USRCache, Definition));
+  Stats->set_failed(static_cast<bool>(Err));
+  return Err;
+}
+
 static void collectEvidenceFromDefaultArgument(
     const clang::FunctionDecl &Fn, const clang::ParmVarDecl &ParamDecl,
     Slot ParamSlot, llvm::function_ref<EvidenceEmitter> Emit) {
@@ -1616,6 +2145,11 @@ EvidenceSites EvidenceSites::discover(ASTContext &Ctx) {
       return true;
     }
 
+    bool VisitCXXMethodDecl(absl::Nonnull<const CXXMethodDecl *> MD) {
+      addVirtualMethodOverrides(MD, Out.VirtualMethodOverrides);
+      return true;
+    }
+
     bool VisitFieldDecl(absl::Nonnull<const FieldDecl *> FD) {
       if (isInferenceTarget(*FD)) Out.Declarations.insert(FD);
       return true;
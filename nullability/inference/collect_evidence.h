@@ -5,10 +5,21 @@
 #ifndef CRUBIT_NULLABILITY_INFERENCE_COLLECT_EVIDENCE_H_
 #define CRUBIT_NULLABILITY_INFERENCE_COLLECT_EVIDENCE_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
 
+#include "absl/base/nullability.h"
+#include "absl/container/flat_hash_map.h"
+#include "nullability/inference/fingerprint_index.h"
 #include "nullability/inference/inference.proto.h"
 #include "nullability/inference/slot_fingerprint.h"
 #include "nullability/pointer_nullability_analysis.h"
@@ -16,38 +27,305 @@
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/AST/DeclCXX.h"
+#include "clang/Analysis/FlowSensitive/DataflowAnalysisContext.h"
 #include "clang/Analysis/FlowSensitive/Solver.h"
 #include "clang/Basic/SourceLocation.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/FunctionExtras.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Error.h"
 
 namespace clang::tidy::nullability {
 
-using USRCache = llvm::DenseMap<const Decl *, std::string>;
+/// Identifies a symbol by the index of its USR in a USRCache.
+using SymbolId = uint32_t;
 
-std::string_view getOrGenerateUSR(USRCache &Cache, const Decl &);
+/// The USRs of declarations in headers, shared by the `USRCache`s of all the
+/// TUs a process analyzes (e.g. on different threads), and optionally saved
+/// for later runs.
+///
+/// A header's declarations have the same USRs in every TU that includes it,
+/// so they are keyed on where they are written (the file, with its size and
+/// modification time, the offset in it, and the kind of declaration) rather
+/// than generated in each TU. Declarations whose USR may depend on the TU are
+/// not shared: those in the main file, implicit ones, those named by macro
+/// expansions, and template instantiations and specializations.
+///
+/// Thread-safe.
+class SharedUSRCache {
+ public:
+  /// Sets `USR` to D's USR, generating and storing it if it isn't known.
+  /// Returns false if no USR can be generated for D.
+  bool getOrGenerate(const Decl &D, llvm::SmallVectorImpl<char> &USR);
+
+  /// Adds the entries saved by `save()` in the file at `Path`.
+  llvm::Error load(llvm::StringRef Path);
+  /// Writes all entries to the file at `Path`.
+  llvm::Error save(llvm::StringRef Path) const;
+
+  /// The number of stored USRs.
+  size_t size() const;
+  /// Lookups answered from stored USRs.
+  uint64_t hits() const { return Hits; }
+
+ private:
+  mutable std::shared_mutex Mu;
+  llvm::StringMap<std::string> USRs;
+  std::atomic<uint64_t> Hits = 0;
+};
+
+/// Caches USR generation, and interns the resulting USRs.
+///
+/// Each distinct USR (e.g. shared by all redeclarations of a function) is
+/// stored once, and is assigned a dense SymbolId that can be used in its place
+/// until the USR itself is needed, e.g. for serialization.
+class USRCache {
+ public:
+  /// `Shared`, if provided, is consulted before generating a USR, and must
+  /// outlive this cache.
+  explicit USRCache(SharedUSRCache *Shared = nullptr) : Shared(Shared) {}
+
+  /// Returns the id of D's USR, or nullopt if no USR can be generated for it.
+  std::optional<SymbolId> getOrCreateId(const Decl &D);
+
+  /// Returns the USR of a symbol previously returned by getOrCreateId.
+  llvm::StringRef usr(SymbolId Id) const { return USRs[Id]->getKey(); }
+
+  /// The number of distinct USRs interned so far.
+  size_t size() const { return USRs.size(); }
+
+ private:
+  llvm::DenseMap<const Decl *, std::optional<SymbolId>> Ids;
+  llvm::StringMap<SymbolId> IdsByUSR;
+  std::vector<const llvm::StringMapEntry<SymbolId> *> USRs;
+  SharedUSRCache *Shared;
+};
+
+/// Returns D's USR, or an empty string if none can be generated.
+std::string_view getOrGenerateUSR(USRCache &Cache, const Decl &D);
+
+/// The methods that a virtual method is related to by overriding, directly or
+/// indirectly, which its evidence is propagated to.
+struct OverrideClosure {
+  /// The methods that override it.
+  llvm::DenseSet<const CXXMethodDecl *> Overriders;
+  /// The methods that it overrides.
+  llvm::DenseSet<const CXXMethodDecl *> Overridden;
+};
+
+/// Maps virtual methods to their override closures. Computed once per AST, so
+/// that emitting evidence for a method in a deep hierarchy needn't walk it.
+using VirtualMethodOverridesMap =
+    absl::flat_hash_map<const CXXMethodDecl *, OverrideClosure>;
 
 /// Callback used to report collected nullability evidence.
 using EvidenceEmitter = void(const Decl &Target, Slot, Evidence::Kind,
                              SourceLocation);
 /// Creates an EvidenceEmitter that serializes the evidence as Evidence protos.
 /// This emitter caches USR generation, and should be reused for the whole AST.
+///
+/// Evidence for virtual methods is also emitted for their overrides. These are
+/// found by walking the AST, unless `Overrides` (e.g. from
+/// `EvidenceSites::discover()`) is provided; it must outlive the emitter.
 llvm::unique_function<EvidenceEmitter> evidenceEmitter(
     llvm::unique_function<void(const Evidence &) const>, USRCache &USRCache,
-    ASTContext &Ctx);
+    ASTContext &Ctx,
+    absl::Nullable<const VirtualMethodOverridesMap *> Overrides = nullptr);
+/// As above, but identifies the symbol by its id in `USRCache` instead of
+/// copying its USR into each Evidence, whose `symbol` field is left unset.
+llvm::unique_function<EvidenceEmitter> symbolEvidenceEmitter(
+    llvm::unique_function<void(SymbolId, const Evidence &) const>,
+    USRCache &USRCache, ASTContext &Ctx,
+    absl::Nullable<const VirtualMethodOverridesMap *> Overrides = nullptr);
+
+/// Collapses repeated evidence from one definition, which is common in hot
+/// code: e.g. each dereference of a pointer in a loop body is evidence of the
+/// same kind for the same slot.
+///
+/// Evidence passed to the deduplicator is buffered, and `flush()` forwards each
+/// distinct (target, slot, kind) to the underlying emitter once, with the
+/// location of its first occurrence. Inference only depends on which kinds of
+/// evidence a slot has, not how often they occur, so this doesn't change the
+/// inferred nullability, while reducing the evidence to be serialized and
+/// merged. Deduplication is opt-in, as occurrence counts in merged partials
+/// then count definitions rather than occurrences.
+class EvidenceDeduplicator {
+ public:
+  explicit EvidenceDeduplicator(llvm::function_ref<EvidenceEmitter> Emit)
+      : Emit(Emit) {}
+
+  void operator()(const Decl &Target, Slot, Evidence::Kind, SourceLocation);
+
+  /// Forwards the buffered evidence, e.g. at the end of each definition.
+  /// Evidence still buffered when the deduplicator is destroyed is lost.
+  /// Returns the number of pieces of evidence that were dropped as duplicates.
+  unsigned flush();
+
+ private:
+  struct Occurrences {
+    SourceLocation First;
+    unsigned Count = 0;
+  };
+
+  llvm::function_ref<EvidenceEmitter> Emit;
+  // Kept in order of first occurrence, so that output order is deterministic.
+  llvm::MapVector<std::tuple<const Decl *, unsigned, unsigned>, Occurrences>
+      Buffered;
+};
 
 struct PreviousInferences {
   const llvm::DenseSet<SlotFingerprint> &Nullable = {};
   const llvm::DenseSet<SlotFingerprint> &Nonnull = {};
+  /// If set, records every slot whose previous inference was looked up, i.e.
+  /// the slots that the collected evidence may depend on.
+  llvm::DenseSet<SlotFingerprint> *Consulted = nullptr;
+  /// Optional on-disk alternatives to (or extensions of) the sets above, for
+  /// inference results too large to load into every worker.
+  const SlotFingerprintIndex *NullableIndex = nullptr;
+  const SlotFingerprintIndex *NonnullIndex = nullptr;
+  /// Optional slots whose inference is already decided by annotations (the
+  /// trivial inferences), which take precedence over all other evidence.
+  /// Evidence from the arguments passed for these parameters could not change
+  /// their inference, so is not collected, saving the analysis queries to find
+  /// the arguments' nullability and the merging of the evidence, which is
+  /// plentiful for widely-called functions.
+  const llvm::DenseSet<SlotFingerprint> *Decided = nullptr;
+  const SlotFingerprintIndex *DecidedIndex = nullptr;
+
+  bool isNullable(SlotFingerprint F) const {
+    return Nullable.contains(F) ||
+           (NullableIndex && NullableIndex->contains(F));
+  }
+  bool isNonnull(SlotFingerprint F) const {
+    return Nonnull.contains(F) || (NonnullIndex && NonnullIndex->contains(F));
+  }
+  bool isDecided(SlotFingerprint F) const {
+    return (Decided && Decided->contains(F)) ||
+           (DecidedIndex && DecidedIndex->contains(F));
+  }
+  bool hasDecided() const { return Decided || DecidedIndex; }
+};
+
+/// Identifies the evidence that collecting from a declaration in a header (see
+/// `collectEvidenceFromTargetDeclaration()`) or, if `Definition`, from its
+/// definition (see `collectEvidenceFromDefinition()`) produces, so that it
+/// needn't be collected again from each TU that includes the header.
+///
+/// The fingerprint combines where D is written (as for `SharedUSRCache`), its
+/// USR, and a hash of its type and, for a definition, of its body or
+/// initializer. Template instantiations are included, as their USRs identify
+/// the template arguments. Returns nullopt for declarations whose evidence may
+/// depend on the TU: those in the main file, implicit ones, and those without
+/// external linkage, e.g. instantiations with TU-local template arguments.
+///
+/// The evidence also depends on the previous inferences of the slots that the
+/// analysis consults, which `AnalyzedDefinitions` tracks.
+std::optional<uint64_t> evidenceSiteFingerprint(const Decl &D, bool Definition,
+                                                USRCache &USRCache);
+
+/// The header declarations and definitions whose evidence has been collected,
+/// by `evidenceSiteFingerprint()`, shared by the TUs whose evidence is merged
+/// together (e.g. the shards of one round of inference), so that each emits
+/// the evidence of a header's inline functions and templates once rather than
+/// in every TU that includes it.
+///
+/// The previous inferences of the slots that an analysis consulted are kept
+/// with its fingerprint, and it only counts as analyzed when they are the same.
+///
+/// Thread-safe.
+class AnalyzedDefinitions {
+ public:
+  /// Whether evidence for `Fingerprint` was collected with the same previous
+  /// inferences of the consulted slots as `Previous`.
+  bool contains(uint64_t Fingerprint, const PreviousInferences &Previous);
+  /// Records that evidence for `Fingerprint` has been collected, consulting
+  /// the previous inferences of the slots in `Consulted`.
+  void insert(uint64_t Fingerprint,
+              const llvm::DenseSet<SlotFingerprint> &Consulted,
+              const PreviousInferences &Previous);
+
+  /// Adds the entries saved by `save()` in the file at `Path`.
+  llvm::Error load(llvm::StringRef Path);
+  /// Writes all entries to the file at `Path`.
+  llvm::Error save(llvm::StringRef Path) const;
+
+  /// The number of stored fingerprints.
+  size_t size() const;
+  /// Lookups answered by stored fingerprints.
+  uint64_t hits() const { return Hits; }
+
+ private:
+  /// The previous inferences of a consulted slot, as a bitmask.
+  using ConsultedSlots = std::vector<std::pair<SlotFingerprint, uint8_t>>;
+
+  mutable std::shared_mutex Mu;
+  absl::flat_hash_map<uint64_t, ConsultedSlots> Entries;
+  std::atomic<uint64_t> Hits = 0;
 };
 
 /// Creates a solver with default parameters that is suitable for passing to
 /// `collectEvidenceFromDefinition()`.
 std::unique_ptr<dataflow::Solver> makeDefaultSolverForInference();
 
+/// A `DataflowAnalysisContext` (and with it, the formula arena) that is reused
+/// by the definitions analyzed on one thread, rather than each allocating and
+/// freeing its own.
+///
+/// The analysis sets up the synthetic fields of its context, which can only be
+/// done before the context creates any records, so each context comes with one
+/// analysis. The analysis is reset between definitions.
+///
+/// The arena can't free the formulas of one definition without the others, so
+/// the context is replaced once the analysis has created `MaxAtoms` atoms in
+/// it (see `nullabilityAtomsCreated()`), which bounds the memory held. It is
+/// also replaced for a definition that refers to fields it doesn't model (see
+/// `SharedContextFields`), or that is analyzed with another AST, pragmas or
+/// type cache.
+///
+/// Not thread-safe: each thread should use its own pool.
+class AnalysisContextPool {
+ public:
+  explicit AnalysisContextPool(uint64_t MaxAtoms = 1'000'000);
+  ~AnalysisContextPool();
+
+  /// Returns the context to analyze the next definition in, which refers to
+  /// `Fields` (see `dataflow::ReferencedDecls`). Its queries go to `Solver`
+  /// until the next call.
+  dataflow::DataflowAnalysisContext &acquire(
+      dataflow::Solver &Solver, ASTContext &Ctx,
+      const NullabilityPragmas &Pragmas,
+      absl::Nullable<TypeNullabilityCache *> TypeCache,
+      const dataflow::FieldSet &Fields);
+
+  /// The analysis for the context that `acquire()` returned last, reset for
+  /// the definition.
+  PointerNullabilityAnalysis &analysis() { return *Analysis; }
+
+  /// The number of contexts created so far.
+  unsigned created() const { return Created; }
+
+ private:
+  class ForwardingSolver;
+
+  uint64_t MaxAtoms;
+  std::unique_ptr<ForwardingSolver> Solver;
+  std::unique_ptr<dataflow::DataflowAnalysisContext> Context;
+  std::unique_ptr<PointerNullabilityAnalysis> Analysis;
+  SharedContextFields ContextFields;
+  // What `Analysis` was created with.
+  const ASTContext *AnalysisCtx = nullptr;
+  const NullabilityPragmas *AnalysisPragmas = nullptr;
+  const TypeNullabilityCache *AnalysisTypeCache = nullptr;
+  // `nullabilityAtomsCreated()` when `Context` was created.
+  uint64_t ContextAtomsStart = 0;
+  unsigned Created = 0;
+};
+
 /// Analyze code (such as a function body or variable initializer) to infer
 /// nullability.
 ///
@@ -57,11 +335,28 @@ std::unique_ptr<dataflow::Solver> makeDefaultSolverForInference();
 ///
 /// It is up to the caller to ensure the definition is eligible for inference
 /// (function has a body, is not dependent, etc).
+///
+/// If `Stats` is provided, it is filled with measurements of the analysis,
+/// including when an error is returned. Its `iteration` is left unset.
+///
+/// `TypeCache`, if provided, should be shared by all definitions analyzed in
+/// the TU with the same `Pragmas`.
+///
+/// A nonzero `WideningThreshold` bounds how often loops are revisited before
+/// the null state of pointers is widened to Top (see
+/// `PointerNullabilityAnalysis::setWideningThreshold()`).
+///
+/// `ContextPool`, if provided, supplies the analysis context and analysis
+/// instead of new ones being created for the definition. The evidence is the
+/// same either way.
 llvm::Error collectEvidenceFromDefinition(
     const Decl &, llvm::function_ref<EvidenceEmitter>, USRCache &USRCache,
     const NullabilityPragmas &Pragmas,
     PreviousInferences PreviousInferences = {},
-    const SolverFactory &MakeSolver = makeDefaultSolverForInference);
+    const SolverFactory &MakeSolver = makeDefaultSolverForInference,
+    DefinitionStats *Stats = nullptr,
+    TypeNullabilityCache *TypeCache = nullptr, unsigned WideningThreshold = 0,
+    AnalysisContextPool *ContextPool = nullptr);
 
 /// Gathers evidence of a symbol's nullability from a declaration of it.
 ///
@@ -84,6 +379,9 @@ struct EvidenceSites {
   /// This will always be concrete code, not a template pattern. These may be
   /// passed to collectEvidenceFromDefinition().
   llvm::DenseSet<const Decl *> Definitions;
+  /// The overrides of virtual methods, which evidence emitters need. These are
+  /// found in the same traversal, so that it needn't be repeated.
+  VirtualMethodOverridesMap VirtualMethodOverrides;
 
   /// Find the evidence sites within the provided AST.
   static EvidenceSites discover(ASTContext &);
@@ -0,0 +1,194 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Benchmarks for collectEvidenceFromDefinition(), which runs the nullability
+// analysis with symbolic nullability for the slots being inferred, and so
+// typically makes many more solver queries than diagnosis does.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/base/nullability.h"
+#include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "third_party/benchmark/include/benchmark/benchmark.h"
+#include "nullability/inference/augmented_test_inputs.h"
+#include "nullability/inference/collect_evidence.h"
+#include "nullability/inference/inference.proto.h"
+#include "nullability/pragma.h"
+#include "nullability/type_nullability.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclBase.h"
+#include "clang/Basic/LLVM.h"
+#include "clang/Testing/TestAST.h"
+#include "llvm/Support/Error.h"
+
+namespace clang::tidy::nullability {
+namespace {
+
+absl::Nonnull<NamedDecl *> lookup(absl::string_view Name,
+                                  const DeclContext &DC) {
+  auto Result = DC.lookup(&DC.getParentASTContext().Idents.get(Name));
+  CHECK(Result.isSingleResult()) << Name;
+  return Result.front();
+}
+
+void benchmarkInferenceOnCode(benchmark::State &State, llvm::StringRef Code) {
+  NullabilityPragmas Pragmas;
+  TestAST AST(getAugmentedTestInputs(Code, Pragmas));
+  auto *Target = cast<FunctionDecl>(
+      lookup("Target", *AST.context().getTranslationUnitDecl()));
+  USRCache USRCache;
+
+  int64_t NumEvidence = 0;
+  int64_t SolverCalls = 0;
+  int64_t SATLimitReached = 0;
+  for (auto _ : State) {
+    DefinitionStats Stats;
+    llvm::Error Err = collectEvidenceFromDefinition(
+        *Target,
+        [&](const Decl &, Slot, Evidence::Kind, SourceLocation) {
+          ++NumEvidence;
+        },
+        USRCache, Pragmas, /*PreviousInferences=*/{},
+        makeDefaultSolverForInference, &Stats);
+    llvm::consumeError(std::move(Err));
+    SolverCalls += Stats.solver_calls();
+    SATLimitReached += Stats.reached_sat_limit();
+  }
+
+  State.counters["evidence"] =
+      benchmark::Counter(NumEvidence, benchmark::Counter::kAvgIterations);
+  State.counters["solver_calls"] =
+      benchmark::Counter(SolverCalls, benchmark::Counter::kAvgIterations);
+  State.counters["sat_limit_reached"] =
+      benchmark::Counter(SATLimitReached, benchmark::Counter::kAvgIterations);
+}
+
+void BM_InferenceBranchesAndLoops(benchmark::State &State) {
+  benchmarkInferenceOnCode(State, R"cpp(
+    int *next(int);
+    bool cond(int);
+    int Target(int *a, int *b, int *c, int *d) {
+      int sum = 0;
+      for (int i = 0; i < 10; ++i) {
+        int *p = next(i);
+        if (p) sum += *p;
+        int *q = cond(i) ? a : b;
+        for (int j = 0; j < 10; ++j) {
+          if (c != nullptr && cond(j)) sum += *c;
+          sum += *q + *d;
+          if (cond(sum)) q = p;
+        }
+      }
+      return sum;
+    }
+  )cpp");
+}
+BENCHMARK(BM_InferenceBranchesAndLoops);
+
+void BM_InferenceSmartPointers(benchmark::State &State) {
+  benchmarkInferenceOnCode(State, R"cpp(
+#include <memory>
+    struct Base {
+      virtual ~Base();
+      int x;
+    };
+    struct Derived : Base {
+      int y;
+    };
+    bool cond();
+
+    int Target(std::shared_ptr<Base> base, std::weak_ptr<Base> weak,
+               std::unique_ptr<Derived> owned) {
+      int sum = 0;
+      if (owned) sum += owned->y;
+      for (int i = 0; i < 10; ++i) {
+        if (std::shared_ptr<Base> locked = weak.lock()) sum += locked->x;
+        std::shared_ptr<Derived> derived =
+            std::dynamic_pointer_cast<Derived>(base);
+        if (derived) sum += derived->y;
+        sum += base->x;
+      }
+      return sum;
+    }
+  )cpp");
+}
+BENCHMARK(BM_InferenceSmartPointers);
+
+void BM_InferenceCheckMacros(benchmark::State &State) {
+  std::string Code = R"cpp(
+#define CHECK(x) (x)
+#define CHECK_NE(a, b) (a, b)
+    struct Node {
+      Node *next;
+      int *value;
+    };
+    int Target(Node *n, int *p) {
+      int sum = 0;
+  )cpp";
+  for (int I = 0; I < 20; ++I)
+    absl::StrAppend(&Code, "CHECK_NE(n, nullptr); CHECK_NE(n->value, nullptr);",
+                    "CHECK(p); sum += *n->value + *p; n = n->next;\n");
+  absl::StrAppend(&Code, "return sum; }");
+  benchmarkInferenceOnCode(State, Code);
+}
+BENCHMARK(BM_InferenceCheckMacros);
+
+void BM_InferenceLargeSwitch(benchmark::State &State) {
+  std::string Code = R"cpp(
+    int *next(int);
+    int Target(int k, int *a, int *b) {
+      int *p = a;
+      switch (k) {
+  )cpp";
+  for (int I = 0; I < 64; ++I) {
+    if (I % 2 == 0)
+      absl::StrAppend(&Code, "case ", I, ": p = next(", I, "); break;\n");
+    else
+      absl::StrAppend(&Code, "case ", I, ": if (b) p = b; break;\n");
+  }
+  absl::StrAppend(&Code, "default: break; } return *p; }");
+  benchmarkInferenceOnCode(State, Code);
+}
+BENCHMARK(BM_InferenceLargeSwitch);
+
+void BM_InferenceAccessorChains(benchmark::State &State) {
+  benchmarkInferenceOnCode(State, R"cpp(
+    struct Leaf {
+      int *value() const;
+    };
+    struct Inner {
+      const Leaf &leaf() const;
+      const Leaf *maybe_leaf() const;
+    };
+    struct Outer {
+      const Inner &inner() const;
+      const Inner *maybe_inner() const;
+    };
+    int Target(const Outer &o) {
+      int sum = 0;
+      for (int i = 0; i < 10; ++i) {
+        if (o.inner().leaf().value() != nullptr)
+          sum += *o.inner().leaf().value();
+        if (o.maybe_inner() && o.maybe_inner()->maybe_leaf())
+          sum += *o.maybe_inner()->maybe_leaf()->value();
+      }
+      return sum;
+    }
+  )cpp");
+}
+BENCHMARK(BM_InferenceAccessorChains);
+
+}  // namespace
+}  // namespace clang::tidy::nullability
+
+int main(int argc, absl::Nonnull<char **> argv) {
+  clang::tidy::nullability::enableSmartPointers(true);
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
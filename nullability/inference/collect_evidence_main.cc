@@ -0,0 +1,404 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// collect_evidence_main collects nullability evidence from many translation
+// units of a compilation database, and writes one evidence shard per TU (see
+// evidence_shard.h). This is the "map" step of whole-project inference; the
+// shards are then combined by merge_main:
+//
+//   collect_evidence_main -p build/ -output-dir=shards -jobs=32
+//   merge_main -evidence=shards/a-1234.shard,... -finalize -output=inferences
+//
+// With no source files on the command line, all files in the compilation
+// database are analyzed. TUs are parsed in parallel (-jobs=N), and the workers
+// share a cache of file contents and status, so that headers common to many
+// TUs are only read from disk once.
+//
+// With -write-ranges, the eligible ranges of the declarations in each TU are
+// also written (see getInferenceRangesIndex()), so that inferred annotations
+// can be applied without parsing the code again. merge_main can combine them.
+//
+// For further rounds of inference, -nullable-index and -nonnull-index take the
+// indexes written by `merge_main -finalize`.
+//
+// -dedup-evidence shrinks the shards by writing evidence repeated within a
+// definition once. This doesn't affect the inferred nullability, but the
+// evidence counts in merged partials then count definitions.
+//
+// -skip-analyzed-definitions writes the evidence from the inline functions,
+// templates and declarations of headers to the shard of one TU that includes
+// them, rather than to each one's. The shards of the run must then be merged
+// together. -analyzed-definitions extends this to later runs of the same round
+// whose shards are merged with this run's.
+//
+// -solver-corpus-dir records the solver queries that time out or take longer
+// than -solver-corpus-min-ms, for replaying with solver_corpus_benchmark.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/nullability.h"
+#include "absl/log/check.h"
+#include "nullability/inference/collect_evidence.h"
+#include "nullability/inference/eligible_ranges.h"
+#include "nullability/inference/ctn_replacement_macros.h"
+#include "nullability/inference/evidence_shard.h"
+#include "nullability/inference/fingerprint_index.h"
+#include "nullability/inference/infer_tu.h"
+#include "nullability/inference/inference.proto.h"
+#include "nullability/inference/replace_macros.h"
+#include "nullability/inference/slot_fingerprint.h"
+#include "nullability/pointer_nullability_analysis.h"
+#include "nullability/pragma.h"
+#include "nullability/solver_corpus.h"
+#include "nullability/type_nullability.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/DependencyScanning/DependencyScanningFilesystem.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+using ::clang::tidy::nullability::ReplacementMacrosHeaderFileName;
+
+llvm::cl::OptionCategory Opts("collect_evidence_main options");
+llvm::cl::opt<std::string> OutputDir{
+    "output-dir",
+    llvm::cl::desc("Directory to write an evidence shard for each TU to"),
+    llvm::cl::Required,
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<unsigned> Jobs{
+    "jobs",
+    llvm::cl::desc("Number of TUs to analyze in parallel (0: one per core)"),
+    llvm::cl::init(0),
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<unsigned> WidenAfter{
+    "widen-after",
+    llvm::cl::desc("Widen the null state of pointers that change in a loop to "
+                   "Top after this many visits to the loop head (0: never)"),
+    llvm::cl::init(0),
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<bool> DedupEvidence{
+    "dedup-evidence",
+    llvm::cl::desc("Write repeated evidence (same symbol, slot and kind) from "
+                   "each definition once, with its first location"),
+    llvm::cl::init(false),
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<bool> WriteRanges{
+    "write-ranges",
+    llvm::cl::desc("Also write the eligible ranges of each TU's declarations, "
+                   "as a TypeLocRangesIndex next to its shard"),
+    llvm::cl::init(false),
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<std::string> NullableIndex{
+    "nullable-index",
+    llvm::cl::desc("Index of the slots inferred Nullable in a previous round"),
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<std::string> NonnullIndex{
+    "nonnull-index",
+    llvm::cl::desc("Index of the slots inferred Nonnull in a previous round"),
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<std::string> DecidedIndex{
+    "decided-index",
+    llvm::cl::desc("Index of the slots whose nullability was decided by "
+                   "annotations in a previous round. Evidence from arguments "
+                   "passed for these parameters is not collected"),
+    llvm::cl::cat(Opts),
+};
+
+llvm::cl::opt<std::string> USRCacheFile{
+    "usr-cache",
+    llvm::cl::desc("File that keeps the USRs of header declarations between "
+                   "runs. It is read at startup if it exists, and rewritten "
+                   "with all the USRs known at the end"),
+    llvm::cl::cat(Opts),
+};
+
+llvm::cl::opt<bool> SkipAnalyzedDefinitions{
+    "skip-analyzed-definitions",
+    llvm::cl::desc("Collect the evidence from each header declaration and "
+                   "definition in one TU, rather than in every TU that "
+                   "includes the header"),
+    llvm::cl::init(false),
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<std::string> AnalyzedDefinitionsFile{
+    "analyzed-definitions",
+    llvm::cl::desc("File that keeps the header declarations and definitions "
+                   "that evidence was collected from, for runs whose shards "
+                   "are merged with this run's. It is read at startup if it "
+                   "exists, and rewritten at the end. Implies "
+                   "-skip-analyzed-definitions"),
+    llvm::cl::cat(Opts),
+};
+
+llvm::cl::opt<std::string> SolverCorpusDir{
+    "solver-corpus-dir",
+    llvm::cl::desc("Directory to record expensive solver queries to"),
+    llvm::cl::cat(Opts),
+};
+llvm::cl::opt<unsigned> SolverCorpusMinMs{
+    "solver-corpus-min-ms",
+    llvm::cl::desc("Record solver queries that take at least this many "
+                   "milliseconds, as well as those that time out"),
+    llvm::cl::init(1000),
+    llvm::cl::cat(Opts),
+};
+
+namespace clang::tidy::nullability {
+namespace {
+
+// Returns the path of the output file with `Extension` (e.g. the shard) for
+// the TU with main file `File`.
+// The name includes a hash of the full path, as the base name may not be
+// unique within the project.
+std::string outputPath(llvm::StringRef File, llvm::StringRef Extension) {
+  llvm::SmallString<256> Path(OutputDir);
+  llvm::sys::path::append(
+      Path, llvm::sys::path::stem(File) + "-" +
+                llvm::utohexstr(llvm::xxh3_64bits(File), /*LowerCase=*/true) +
+                Extension);
+  return std::string(Path);
+}
+
+bool writeFile(llvm::StringRef Path, llvm::StringRef Contents) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  if (EC) {
+    llvm::errs() << Path << ": " << EC.message() << "\n";
+    return false;
+  }
+  OS << Contents;
+  return true;
+}
+
+// Collects the evidence from a TU and writes it to its shard.
+class CollectAction : public SyntaxOnlyAction {
+  NullabilityPragmas Pragmas;
+  PreviousInferences Previous;
+  SharedUSRCache &SharedUSRs;
+  AnalyzedDefinitions *Analyzed;
+  const SolverFactory &MakeSolver;
+
+ public:
+  CollectAction(PreviousInferences Previous, SharedUSRCache &SharedUSRs,
+                AnalyzedDefinitions *Analyzed, const SolverFactory &MakeSolver)
+      : Previous(Previous),
+        SharedUSRs(SharedUSRs),
+        Analyzed(Analyzed),
+        MakeSolver(MakeSolver) {}
+
+ private:
+  absl::Nonnull<std::unique_ptr<ASTConsumer>> CreateASTConsumer(
+      CompilerInstance &, llvm::StringRef File) override {
+    class Consumer : public ASTConsumer {
+     public:
+      CollectAction &Parent;
+      std::string File;
+      Consumer(CollectAction &Parent, llvm::StringRef File)
+          : Parent(Parent), File(File) {}
+
+     private:
+      void HandleTranslationUnit(ASTContext &Ctx) override {
+        EvidenceShardWriter Shard;
+        collectTUEvidence(
+            Ctx, Parent.Pragmas, [&](const Evidence &E) { Shard.add(E); },
+            Parent.Previous, /*Filter=*/nullptr, /*Stats=*/nullptr,
+            WidenAfter, DedupEvidence, &Parent.SharedUSRs, Parent.Analyzed,
+            Parent.MakeSolver);
+        size_t Size = Shard.size();
+        if (!writeFile(outputPath(File, ".shard"), Shard.finish())) return;
+        if (WriteRanges &&
+            !writeFile(outputPath(File, ".ranges"),
+                       getInferenceRangesIndex(
+                           Ctx, TypeNullabilityDefaults(Ctx, Parent.Pragmas))
+                           .SerializeAsString()))
+          return;
+        llvm::errs() << File << ": " << Size << " pieces of evidence\n";
+      }
+    };
+    return std::make_unique<Consumer>(*this, File);
+  }
+
+  bool BeginSourceFileAction(CompilerInstance &CI) override {
+    if (!ASTFrontendAction::BeginSourceFileAction(CI)) return false;
+    if (!CI.getLangOpts().CPlusPlus) return false;
+    registerPragmaHandler(CI.getPreprocessor(), Pragmas);
+    CI.getPreprocessor().addPPCallbacks(
+        std::make_unique<ReplaceMacrosCallbacks>(CI.getPreprocessor()));
+    return true;
+  }
+};
+
+class CollectActionFactory : public tooling::FrontendActionFactory {
+  PreviousInferences Previous;
+  // Shared by the TUs of all workers.
+  SharedUSRCache &SharedUSRs;
+  AnalyzedDefinitions *Analyzed;
+  SolverFactory MakeSolver;
+
+ public:
+  CollectActionFactory(PreviousInferences Previous, SharedUSRCache &SharedUSRs,
+                       AnalyzedDefinitions *Analyzed, SolverFactory MakeSolver)
+      : Previous(Previous),
+        SharedUSRs(SharedUSRs),
+        Analyzed(Analyzed),
+        MakeSolver(std::move(MakeSolver)) {}
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::make_unique<CollectAction>(Previous, SharedUSRs, Analyzed,
+                                           MakeSolver);
+  }
+};
+
+std::optional<SlotFingerprintIndex> openIndex(llvm::StringRef Path) {
+  if (Path.empty()) return std::nullopt;
+  auto Index = SlotFingerprintIndex::open(Path);
+  QCHECK(Index) << Path.str() << ": " << llvm::toString(Index.takeError());
+  return std::move(*Index);
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
+
+int main(int argc, absl::Nonnull<const char **> argv) {
+  using namespace clang::tidy::nullability;
+  using namespace clang::tooling;
+  auto Options =
+      CommonOptionsParser::create(argc, argv, Opts, llvm::cl::ZeroOrMore);
+  QCHECK(Options) << llvm::toString(Options.takeError());
+  const CompilationDatabase &Compilations = Options->getCompilations();
+  std::vector<std::string> Files = Options->getSourcePathList();
+  if (Files.empty()) Files = Compilations.getAllFiles();
+
+  std::error_code EC = llvm::sys::fs::create_directories(OutputDir);
+  QCHECK(!EC) << OutputDir << ": " << EC.message();
+
+  CHECK_EQ(ctn_replacement_macros_size(), 1);
+  llvm::StringRef MacroReplacementText =
+      ctn_replacement_macros_create()[0].data;
+
+  enableSmartPointers(true);
+
+  std::optional<SlotFingerprintIndex> Nullable = openIndex(NullableIndex);
+  std::optional<SlotFingerprintIndex> Nonnull = openIndex(NonnullIndex);
+  std::optional<SlotFingerprintIndex> Decided = openIndex(DecidedIndex);
+  SharedUSRCache SharedUSRs;
+  if (!USRCacheFile.empty() && llvm::sys::fs::exists(USRCacheFile)) {
+    llvm::Error Err = SharedUSRs.load(USRCacheFile);
+    QCHECK(!Err) << USRCacheFile << ": " << llvm::toString(std::move(Err));
+  }
+  AnalyzedDefinitions Analyzed;
+  bool SkipAnalyzed =
+      SkipAnalyzedDefinitions || !AnalyzedDefinitionsFile.empty();
+  if (!AnalyzedDefinitionsFile.empty() &&
+      llvm::sys::fs::exists(AnalyzedDefinitionsFile)) {
+    llvm::Error Err = Analyzed.load(AnalyzedDefinitionsFile);
+    QCHECK(!Err) << AnalyzedDefinitionsFile << ": "
+                 << llvm::toString(std::move(Err));
+  }
+  std::optional<SolverCorpusRecorder> Recorder;
+  SolverFactory MakeSolver = makeDefaultSolverForInference;
+  if (!SolverCorpusDir.empty()) {
+    EC = llvm::sys::fs::create_directories(SolverCorpusDir);
+    QCHECK(!EC) << SolverCorpusDir << ": " << EC.message();
+    Recorder.emplace(SolverCorpusDir,
+                     std::chrono::milliseconds(SolverCorpusMinMs));
+    MakeSolver = Recorder->wrap(makeDefaultSolverForInference);
+  }
+  const llvm::DenseSet<SlotFingerprint> NoInferences;
+  CollectActionFactory Factory(
+      {NoInferences, NoInferences, /*Consulted=*/nullptr,
+       Nullable ? &*Nullable : nullptr, Nonnull ? &*Nonnull : nullptr,
+       /*Decided=*/nullptr, Decided ? &*Decided : nullptr},
+      SharedUSRs, SkipAnalyzed ? &Analyzed : nullptr, std::move(MakeSolver));
+
+  // Sources and headers are read through one cache, which is thread-safe.
+  // Each worker has its own view of it (and its own file manager and AST).
+  clang::tooling::dependencies::DependencyScanningFilesystemSharedCache
+      SharedCache;
+  unsigned Workers = Jobs ? Jobs : std::thread::hardware_concurrency();
+  if (Workers == 0) Workers = 1;
+  std::atomic<size_t> Next = 0;
+  std::atomic<unsigned> Failures = 0;
+  auto RunWorker = [&] {
+    auto FS = llvm::makeIntrusiveRefCnt<
+        clang::tooling::dependencies::DependencyScanningWorkerFilesystem>(
+        SharedCache, llvm::vfs::createPhysicalFileSystem());
+    for (size_t I = Next++; I < Files.size(); I = Next++) {
+      ClangTool Tool(Compilations, {Files[I]},
+                     std::make_shared<clang::PCHContainerOperations>(), FS);
+      Tool.mapVirtualFile(ReplacementMacrosHeaderFileName,
+                          MacroReplacementText);
+      Tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
+          {// Warnings from many TUs would drown out the progress output.
+           "-w",
+           // Include the file containing macro replacements that enable
+           // additional inference.
+           "-include", std::string(ReplacementMacrosHeaderFileName)},
+          ArgumentInsertPosition::BEGIN));
+      if (Tool.run(&Factory) != 0) ++Failures;
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  for (unsigned Worker = 1; Worker < Workers; ++Worker)
+    Threads.emplace_back(RunWorker);
+  RunWorker();
+  for (auto &Thread : Threads) Thread.join();
+
+  llvm::errs() << "Collected evidence from " << Files.size() - Failures
+               << " of " << Files.size() << " TUs\n";
+  llvm::errs() << "Reused " << SharedUSRs.hits() << " USRs of "
+               << SharedUSRs.size() << " header declarations\n";
+  if (!USRCacheFile.empty()) {
+    if (llvm::Error Err = SharedUSRs.save(USRCacheFile))
+      llvm::errs() << USRCacheFile << ": " << llvm::toString(std::move(Err))
+                   << "\n";
+  }
+  if (SkipAnalyzed)
+    llvm::errs() << "Skipped " << Analyzed.hits()
+                 << " repeats of header declarations and definitions, of "
+                 << Analyzed.size() << " analyzed\n";
+  if (Recorder)
+    llvm::errs() << "Recorded " << Recorder->recorded() << " solver queries to "
+                 << SolverCorpusDir << "\n";
+  if (!AnalyzedDefinitionsFile.empty()) {
+    if (llvm::Error Err = Analyzed.save(AnalyzedDefinitionsFile))
+      llvm::errs() << AnalyzedDefinitionsFile << ": "
+                   << llvm::toString(std::move(Err)) << "\n";
+  }
+  return Failures ? 1 : 0;
+}
@@ -5,8 +5,11 @@
 #include "nullability/inference/collect_evidence.h"
 
 #include <cassert>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "nullability/inference/augmented_test_inputs.h"
@@ -25,7 +28,9 @@
 #include "third_party/llvm/llvm-project/clang/unittests/Analysis/FlowSensitive/TestingSupport.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Testing/Support/Error.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"  // IWYU pragma: keep
@@ -47,10 +52,13 @@ using ::clang::ast_matchers::varDecl;
 using ::testing::_;
 using ::testing::AllOf;
 using ::testing::Contains;
+using ::testing::Each;
 using ::testing::ElementsAre;
 using ::testing::IsEmpty;
 using ::testing::IsSupersetOf;
+using ::testing::Ne;
 using ::testing::Not;
+using ::testing::Pair;
 using ::testing::ResultOf;
 using ::testing::SizeIs;
 using ::testing::UnorderedElementsAre;
@@ -3060,6 +3068,43 @@ TEST(CollectEvidenceFromDefinitionTest,
                         functionNamed("target"))));
 }
 
+TEST(CollectEvidenceFromDefinitionTest, RecordsConsultedPreviousInferences) {
+  static constexpr llvm::StringRef Src = R"cc(
+    void takesToBeNonnull(int* a);
+    void unrelated(int* b);
+    void target(int* q) { takesToBeNonnull(q); }
+  )cc";
+  llvm::DenseSet<SlotFingerprint> Consulted;
+  collectFromTargetFuncDefinition(Src, {.Consulted = &Consulted});
+  EXPECT_TRUE(Consulted.contains(
+      fingerprint("c:@F@takesToBeNonnull#*I#", paramSlot(0))));
+  EXPECT_TRUE(Consulted.contains(fingerprint("c:@F@target#*I#", paramSlot(0))));
+  EXPECT_FALSE(
+      Consulted.contains(fingerprint("c:@F@unrelated#*I#", paramSlot(0))));
+}
+
+TEST(CollectEvidenceFromDefinitionTest, SkipsArgumentsForDecidedParameters) {
+  static constexpr llvm::StringRef Src = R"cc(
+    void decided(int* a, int* b);
+    void target(int* p) {
+      decided(p, nullptr);
+      *p;
+    }
+  )cc";
+  llvm::DenseSet<SlotFingerprint> Decided = {
+      fingerprint("c:@F@decided#*I#S0_#", paramSlot(1))};
+  llvm::DenseSet<SlotFingerprint> Consulted;
+  EXPECT_THAT(
+      collectFromTargetFuncDefinition(
+          Src, {.Consulted = &Consulted, .Decided = &Decided}),
+      UnorderedElementsAre(
+          evidence(paramSlot(0), Evidence::UNKNOWN_ARGUMENT,
+                   functionNamed("decided")),
+          evidence(paramSlot(0), Evidence::UNCHECKED_DEREFERENCE)));
+  EXPECT_TRUE(Consulted.contains(
+      fingerprint("c:@F@decided#*I#S0_#", paramSlot(1))));
+}
+
 TEST(CollectEvidenceFromDefinitionTest, Pragma) {
   static constexpr llvm::StringRef Src = R"cc(
 #pragma nullability file_default nonnull
@@ -3126,6 +3171,187 @@ TEST(CollectEvidenceFromDefinitionTest, SolverLimitReached) {
   EXPECT_THAT(Results, SizeIs(1));
 }
 
+TEST(CollectEvidenceFromDefinitionTest, SolverLimitReachedStats) {
+  static constexpr llvm::StringRef Src = R"cc(
+    void target(int* p, int* q) {
+      *p;
+      *q;
+    }
+  )cc";
+  NullabilityPragmas Pragmas;
+  clang::TestAST AST(getAugmentedTestInputs(Src, Pragmas));
+  USRCache UsrCache;
+  DefinitionStats Stats;
+  EXPECT_THAT_ERROR(
+      collectEvidenceFromDefinition(
+          *cast<FunctionDecl>(
+              dataflow::test::findValueDecl(AST.context(), "target")),
+          evidenceEmitter([&](const Evidence& E) {}, UsrCache, AST.context()),
+          UsrCache, Pragmas, /*PreviousInferences=*/{},
+          []() {
+            return std::make_unique<dataflow::WatchedLiteralsSolver>(
+                /*MaxSATIterations=*/100);
+          },
+          &Stats),
+      llvm::Failed());
+  EXPECT_EQ(Stats.symbol().usr(), "c:@F@target#*I#S0_#");
+  EXPECT_GT(Stats.cfg_blocks(), 0);
+  EXPECT_GT(Stats.transferred_elements(), 0);
+  EXPECT_GT(Stats.solver_calls(), 0);
+  EXPECT_TRUE(Stats.reached_sat_limit());
+  EXPECT_TRUE(Stats.failed());
+}
+
+TEST(CollectEvidenceFromDefinitionTest, NoInferenceTargetsStats) {
+  static constexpr llvm::StringRef Src = R"cc(
+    struct S {
+      S(int* p);
+      int f(int* p);
+    };
+    int noTargets(int x) {
+      int* p = &x;
+      return *p;
+    }
+    void callsConstructor(int x) { S s(&x); }
+    int callsMethod(S& s, int x) { return s.f(&x); }
+  )cc";
+  NullabilityPragmas Pragmas;
+  clang::TestAST AST(getAugmentedTestInputs(Src, Pragmas));
+  USRCache UsrCache;
+  auto Collect = [&](llvm::StringRef Name, std::vector<Evidence>& Results) {
+    DefinitionStats Stats;
+    EXPECT_THAT_ERROR(
+        collectEvidenceFromDefinition(
+            *dataflow::test::findValueDecl(AST.context(), Name),
+            evidenceEmitter([&](const Evidence& E) { Results.push_back(E); },
+                            UsrCache, AST.context()),
+            UsrCache, Pragmas, /*PreviousInferences=*/{},
+            makeDefaultSolverForInference, &Stats),
+        llvm::Succeeded());
+    return Stats;
+  };
+
+  std::vector<Evidence> Results;
+  DefinitionStats Stats = Collect("noTargets", Results);
+  EXPECT_TRUE(Stats.no_inference_targets());
+  EXPECT_EQ(Stats.cfg_blocks(), 0);
+  EXPECT_THAT(Results, IsEmpty());
+
+  Stats = Collect("callsConstructor", Results);
+  EXPECT_FALSE(Stats.no_inference_targets());
+  EXPECT_THAT(Results, UnorderedElementsAre(evidence(
+                           paramSlot(0), Evidence::NONNULL_ARGUMENT,
+                           functionNamed("S"))));
+
+  Results.clear();
+  Stats = Collect("callsMethod", Results);
+  EXPECT_FALSE(Stats.no_inference_targets());
+  EXPECT_THAT(Results, UnorderedElementsAre(evidence(
+                           paramSlot(0), Evidence::NONNULL_ARGUMENT,
+                           functionNamed("f"))));
+}
+
+TEST(CollectEvidenceFromDefinitionTest, PooledContextGivesSameEvidence) {
+  static constexpr llvm::StringRef Src = R"cc(
+    void first(int* p, int* q) {
+      if (q) *q;
+      *p;
+    }
+    int* second(int* p) { return p ? p : nullptr; }
+  )cc";
+  NullabilityPragmas Pragmas;
+  clang::TestAST AST(getAugmentedTestInputs(Src, Pragmas));
+  USRCache UsrCache;
+  auto Collect = [&](AnalysisContextPool* Pool, DefinitionStats& Stats) {
+    std::vector<Evidence> Results;
+    for (llvm::StringRef Name : {"first", "second"}) {
+      EXPECT_THAT_ERROR(
+          collectEvidenceFromDefinition(
+              *dataflow::test::findValueDecl(AST.context(), Name),
+              evidenceEmitter([&](const Evidence& E) { Results.push_back(E); },
+                              UsrCache, AST.context()),
+              UsrCache, Pragmas, /*PreviousInferences=*/{},
+              makeDefaultSolverForInference, &Stats, /*TypeCache=*/nullptr,
+              /*WideningThreshold=*/0, Pool),
+          llvm::Succeeded());
+    }
+    std::vector<std::string> Printed;
+    for (const Evidence& E : Results) Printed.push_back(E.DebugString());
+    return Printed;
+  };
+
+  DefinitionStats Stats;
+  std::vector<std::string> Unpooled = Collect(nullptr, Stats);
+  EXPECT_GT(Stats.arena_atoms(), 0);
+
+  AnalysisContextPool Pool;
+  DefinitionStats PooledStats;
+  EXPECT_EQ(Collect(&Pool, PooledStats), Unpooled);
+  EXPECT_EQ(Pool.created(), 1u);
+  // Atoms from earlier definitions in the pooled arena are not counted.
+  EXPECT_GT(PooledStats.arena_atoms(), 0);
+  EXPECT_LE(PooledStats.arena_atoms(), Stats.arena_atoms());
+
+  // A pool that is full after each definition makes a context for each.
+  AnalysisContextPool SmallPool(/*MaxAtoms=*/1);
+  EXPECT_EQ(Collect(&SmallPool, PooledStats), Unpooled);
+  EXPECT_EQ(SmallPool.created(), 2u);
+}
+
+TEST(CollectEvidenceFromDefinitionTest, PooledContextWithRecords) {
+  static constexpr llvm::StringRef Src = R"cc(
+#include <memory>
+    struct S {
+      int* a;
+      int* b;
+    };
+    S global;
+    void first(std::unique_ptr<int> p, S s) {
+      *p;
+      *s.a;
+      *global.a;
+    }
+    void second(int* q) {
+      *global.b;
+      if (q) *q;
+    }
+    void third(std::unique_ptr<int> r) {
+      *r;
+      *global.a;
+    }
+  )cc";
+  NullabilityPragmas Pragmas;
+  clang::TestAST AST(getAugmentedTestInputs(Src, Pragmas));
+  USRCache UsrCache;
+  auto Collect = [&](AnalysisContextPool* Pool) {
+    std::vector<std::string> Printed;
+    for (llvm::StringRef Name : {"first", "second", "third"}) {
+      EXPECT_THAT_ERROR(
+          collectEvidenceFromDefinition(
+              *dataflow::test::findValueDecl(AST.context(), Name),
+              evidenceEmitter(
+                  [&](const Evidence& E) {
+                    Printed.push_back(E.DebugString());
+                  },
+                  UsrCache, AST.context()),
+              UsrCache, Pragmas, /*PreviousInferences=*/{},
+              makeDefaultSolverForInference, /*Stats=*/nullptr,
+              /*TypeCache=*/nullptr, /*WideningThreshold=*/0, Pool),
+          llvm::Succeeded());
+    }
+    return Printed;
+  };
+
+  std::vector<std::string> Unpooled = Collect(nullptr);
+  ASSERT_THAT(Unpooled, Not(IsEmpty()));
+  AnalysisContextPool Pool;
+  EXPECT_EQ(Collect(&Pool), Unpooled);
+  // `global` was created without `b` while analyzing `first`, so `second` is
+  // analyzed in a new context, which models both `a` and `b`. `third` reuses
+  // that one, in which `second` has already created records.
+  EXPECT_EQ(Pool.created(), 2u);
+}
+
 TEST(CollectEvidenceFromDeclarationTest, GlobalVariable) {
   llvm::StringLiteral Src = R"cc(
     Nullable<int *> target;
@@ -3624,6 +3850,268 @@ TEST(EvidenceSitesTest, Templates) {
                                    declNamed("Unused")));
 }
 
+TEST(EvidenceSitesTest, VirtualMethodOverrides) {
+  TestAST AST(R"cc(
+    struct Base {
+      virtual void f(int*);
+      virtual void g(int*);
+    };
+    struct Derived : Base {
+      void f(int*) override;
+    };
+    struct MoreDerived : Derived {
+      void f(int*) override;
+      void g(int*) override;
+    };
+  )cc");
+  auto Sites = EvidenceSites::discover(AST.context());
+  std::vector<std::pair<std::string, std::string>> Overrides;
+  std::vector<std::pair<std::string, std::string>> Overridden;
+  for (const auto& [Method, Closure] : Sites.VirtualMethodOverrides) {
+    for (const CXXMethodDecl* Overrider : Closure.Overriders)
+      Overrides.push_back({Method->getQualifiedNameAsString(),
+                           Overrider->getQualifiedNameAsString()});
+    for (const CXXMethodDecl* Base : Closure.Overridden)
+      Overridden.push_back({Method->getQualifiedNameAsString(),
+                            Base->getQualifiedNameAsString()});
+  }
+  // The closures are transitive.
+  EXPECT_THAT(Overrides,
+              UnorderedElementsAre(Pair("Base::f", "Derived::f"),
+                                   Pair("Base::f", "MoreDerived::f"),
+                                   Pair("Derived::f", "MoreDerived::f"),
+                                   Pair("Base::g", "MoreDerived::g")));
+  EXPECT_THAT(Overridden,
+              UnorderedElementsAre(Pair("Derived::f", "Base::f"),
+                                   Pair("MoreDerived::f", "Derived::f"),
+                                   Pair("MoreDerived::f", "Base::f"),
+                                   Pair("MoreDerived::g", "Base::g")));
+
+  // Emitters given the overrides propagate evidence as if they found them.
+  const auto* BaseG = cast<CXXMethodDecl>(
+      dataflow::test::findValueDecl(AST.context(), "Base::g"));
+  std::vector<std::string> Targets;
+  USRCache USRCache;
+  evidenceEmitter(
+      [&](const Evidence& E) { Targets.push_back(E.symbol().usr()); },
+      USRCache, AST.context(), &Sites.VirtualMethodOverrides)(
+      *BaseG, paramSlot(0), Evidence::NULLABLE_ARGUMENT, BaseG->getLocation());
+  EXPECT_THAT(Targets, SizeIs(2));
+}
+
+TEST(SharedUSRCacheTest, SharesHeaderUSRsBetweenTUs) {
+  TestInputs Inputs(R"cc(
+#include "header.h"
+    void inMain(int* p);
+    void instantiate(int* p) { tmpl(p); }
+  )cc");
+  Inputs.ExtraFiles["header.h"] = R"cc(
+    void inHeader(int* p);
+    template <typename T>
+    void tmpl(T* p) {}
+  )cc";
+  TestAST First(Inputs);
+  TestAST Second(Inputs);
+  auto Instantiation = [](TestAST& AST) {
+    return selectFirst<FunctionDecl>(
+        "f", match(functionDecl(hasName("tmpl"), isTemplateInstantiation())
+                       .bind("f"),
+                   AST.context()));
+  };
+
+  SharedUSRCache Shared;
+  auto USRsOf = [&](TestAST& AST) {
+    USRCache Cache(&Shared);
+    std::vector<std::string> USRs;
+    for (llvm::StringRef Name : {"inHeader", "inMain"})
+      USRs.emplace_back(getOrGenerateUSR(
+          Cache, *dataflow::test::findValueDecl(AST.context(), Name)));
+    USRs.emplace_back(getOrGenerateUSR(Cache, *Instantiation(AST)));
+    return USRs;
+  };
+
+  std::vector<std::string> FirstUSRs = USRsOf(First);
+  // Neither the main file's declarations nor instantiations are shared.
+  EXPECT_EQ(Shared.size(), 1u);
+  EXPECT_EQ(Shared.hits(), 0u);
+  EXPECT_EQ(USRsOf(Second), FirstUSRs);
+  EXPECT_EQ(Shared.hits(), 1u);
+
+  USRCache Unshared;
+  EXPECT_EQ(getOrGenerateUSR(Unshared, *dataflow::test::findValueDecl(
+                                           Second.context(), "inHeader")),
+            FirstUSRs[0]);
+}
+
+TEST(SharedUSRCacheTest, SavesAndLoads) {
+  TestInputs Inputs(R"cc(
+#include "header.h"
+  )cc");
+  Inputs.ExtraFiles["header.h"] = R"cc(
+    void inHeader(int* p);
+  )cc";
+  TestAST AST(Inputs);
+  const ValueDecl& InHeader =
+      *dataflow::test::findValueDecl(AST.context(), "inHeader");
+  std::string Expected;
+  {
+    SharedUSRCache Shared;
+    USRCache Cache(&Shared);
+    Expected = std::string(getOrGenerateUSR(Cache, InHeader));
+  }
+
+  llvm::SmallString<128> Path;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("usrs", "txt", Path));
+  SharedUSRCache Saved;
+  {
+    USRCache Cache(&Saved);
+    getOrGenerateUSR(Cache, InHeader);
+  }
+  ASSERT_THAT_ERROR(Saved.save(Path), llvm::Succeeded());
+
+  SharedUSRCache Loaded;
+  ASSERT_THAT_ERROR(Loaded.load(Path), llvm::Succeeded());
+  EXPECT_EQ(Loaded.size(), 1u);
+  USRCache Cache(&Loaded);
+  EXPECT_EQ(getOrGenerateUSR(Cache, InHeader), Expected);
+  EXPECT_EQ(Loaded.hits(), 1u);
+  llvm::sys::fs::remove(Path);
+}
+
+TEST(EvidenceSiteFingerprintTest, SameInEveryTUIncludingTheHeader) {
+  TestInputs Inputs(R"cc(
+#include "header.h"
+    void inMain(int* p) {}
+    void instantiate(int* p) { tmpl(p); }
+  )cc");
+  Inputs.ExtraFiles["header.h"] = R"cc(
+    inline void inHeader(int* p) { p = nullptr; }
+    template <typename T>
+    void tmpl(T* p) {}
+  )cc";
+  TestAST First(Inputs);
+  TestAST Second(Inputs);
+  auto Fingerprints = [](TestAST& AST) {
+    USRCache Cache;
+    const Decl& InHeader =
+        *dataflow::test::findValueDecl(AST.context(), "inHeader");
+    const Decl& Instantiation = *selectFirst<FunctionDecl>(
+        "f", match(functionDecl(hasName("tmpl"), isTemplateInstantiation())
+                       .bind("f"),
+                   AST.context()));
+    return std::vector<std::optional<uint64_t>>{
+        evidenceSiteFingerprint(InHeader, /*Definition=*/false, Cache),
+        evidenceSiteFingerprint(InHeader, /*Definition=*/true, Cache),
+        evidenceSiteFingerprint(Instantiation, /*Definition=*/true, Cache)};
+  };
+
+  std::vector<std::optional<uint64_t>> FirstFingerprints = Fingerprints(First);
+  EXPECT_THAT(FirstFingerprints, Each(Ne(std::nullopt)));
+  EXPECT_NE(FirstFingerprints[0], FirstFingerprints[1]);
+  EXPECT_EQ(Fingerprints(Second), FirstFingerprints);
+
+  USRCache Cache;
+  EXPECT_EQ(evidenceSiteFingerprint(
+                *dataflow::test::findValueDecl(First.context(), "inMain"),
+                /*Definition=*/true, Cache),
+            std::nullopt);
+}
+
+TEST(EvidenceSiteFingerprintTest, DependsOnTheDefinition) {
+  TestInputs Inputs(R"cc(
+#include "header.h"
+  )cc");
+  Inputs.ExtraFiles["header.h"] = R"cc(
+    inline void inHeader(int* p) { BODY; }
+  )cc";
+  Inputs.ExtraArgs = {"-DBODY=*p"};
+  TestAST Deref(Inputs);
+  Inputs.ExtraArgs = {"-DBODY=p = nullptr"};
+  TestAST Assign(Inputs);
+  auto Fingerprint = [](TestAST& AST) {
+    USRCache Cache;
+    return evidenceSiteFingerprint(
+        *dataflow::test::findValueDecl(AST.context(), "inHeader"),
+        /*Definition=*/true, Cache);
+  };
+  EXPECT_NE(Fingerprint(Deref), Fingerprint(Assign));
+}
+
+TEST(AnalyzedDefinitionsTest, DependsOnConsultedPreviousInferences) {
+  const llvm::DenseSet<SlotFingerprint> None;
+  const llvm::DenseSet<SlotFingerprint> Nullable = {1};
+  PreviousInferences Previous = {Nullable, None};
+  PreviousInferences NoPrevious = {None, None};
+
+  AnalyzedDefinitions Analyzed;
+  Analyzed.insert(/*Fingerprint=*/10, /*Consulted=*/{1}, Previous);
+  Analyzed.insert(/*Fingerprint=*/20, /*Consulted=*/{2}, Previous);
+  EXPECT_EQ(Analyzed.size(), 2u);
+  EXPECT_TRUE(Analyzed.contains(10, Previous));
+  EXPECT_FALSE(Analyzed.contains(10, NoPrevious));
+  // Slots that weren't consulted don't matter.
+  EXPECT_TRUE(Analyzed.contains(20, NoPrevious));
+  EXPECT_FALSE(Analyzed.contains(30, Previous));
+  EXPECT_EQ(Analyzed.hits(), 2u);
+}
+
+TEST(AnalyzedDefinitionsTest, SavesAndLoads) {
+  const llvm::DenseSet<SlotFingerprint> None;
+  const llvm::DenseSet<SlotFingerprint> Nonnull = {0xabc};
+  PreviousInferences Previous = {None, Nonnull};
+  PreviousInferences NoPrevious = {None, None};
+  llvm::SmallString<128> Path;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("analyzed", "txt", Path));
+  AnalyzedDefinitions Saved;
+  Saved.insert(/*Fingerprint=*/0xfedcba9876543210, /*Consulted=*/{0xabc, 7},
+               Previous);
+  Saved.insert(/*Fingerprint=*/1, /*Consulted=*/{}, Previous);
+  ASSERT_THAT_ERROR(Saved.save(Path), llvm::Succeeded());
+
+  AnalyzedDefinitions Loaded;
+  ASSERT_THAT_ERROR(Loaded.load(Path), llvm::Succeeded());
+  EXPECT_EQ(Loaded.size(), 2u);
+  EXPECT_TRUE(Loaded.contains(0xfedcba9876543210, Previous));
+  EXPECT_FALSE(Loaded.contains(0xfedcba9876543210, NoPrevious));
+  EXPECT_TRUE(Loaded.contains(1, NoPrevious));
+  llvm::sys::fs::remove(Path);
+}
+
+TEST(EvidenceDeduplicatorTest, CollapsesRepeatedEvidence) {
+  TestAST AST(R"cc(
+    void target(int* p, int* q);
+  )cc");
+  const auto* Target = dataflow::test::findValueDecl(AST.context(), "target");
+  ASSERT_NE(Target, nullptr);
+  SourceLocation Loc = Target->getLocation();
+
+  std::vector<std::pair<Evidence::Kind, SourceLocation>> Emitted;
+  auto Emit = [&](const Decl&, Slot, Evidence::Kind Kind, SourceLocation L) {
+    Emitted.push_back({Kind, L});
+  };
+  EvidenceDeduplicator Deduplicator(Emit);
+  Deduplicator(*Target, paramSlot(0), Evidence::UNCHECKED_DEREFERENCE, Loc);
+  Deduplicator(*Target, paramSlot(0), Evidence::UNCHECKED_DEREFERENCE,
+               Loc.getLocWithOffset(1));
+  Deduplicator(*Target, paramSlot(0), Evidence::ARITHMETIC, Loc);
+  Deduplicator(*Target, paramSlot(1), Evidence::UNCHECKED_DEREFERENCE, Loc);
+  Deduplicator(*Target, paramSlot(0), Evidence::UNCHECKED_DEREFERENCE, Loc);
+  EXPECT_THAT(Emitted, IsEmpty());
+
+  // Each distinct piece is emitted once, with its first location.
+  EXPECT_EQ(Deduplicator.flush(), 2u);
+  EXPECT_THAT(Emitted,
+              ElementsAre(Pair(Evidence::UNCHECKED_DEREFERENCE, Loc),
+                          Pair(Evidence::ARITHMETIC, Loc),
+                          Pair(Evidence::UNCHECKED_DEREFERENCE, Loc)));
+
+  // Evidence is only deduplicated between flushes.
+  Emitted.clear();
+  Deduplicator(*Target, paramSlot(0), Evidence::UNCHECKED_DEREFERENCE, Loc);
+  EXPECT_EQ(Deduplicator.flush(), 0u);
+  EXPECT_THAT(Emitted, SizeIs(1));
+}
+
 TEST(EvidenceEmitterTest, NotInferenceTarget) {
   TestAST AST(R"cc(
     template <int I>
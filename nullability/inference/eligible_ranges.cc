@@ -17,9 +17,11 @@
 #include "nullability/inference/inference.proto.h"
 #include "nullability/type_nullability.h"
 #include "third_party/llvm/llvm-project/clang-tools-extra/clang-tidy/utils/LexerUtils.h"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/AST/NestedNameSpecifier.h"
+#include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/AST/TemplateBase.h"
 #include "clang/AST/Type.h"
 #include "clang/AST/TypeLoc.h"
@@ -35,6 +37,10 @@
 #include "clang/Lex/Lexer.h"
 #include "clang/Lex/Token.h"
 #include "clang/Tooling/Transformer/SourceCode.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Path.h"
 
@@ -498,4 +504,91 @@ std::optional<TypeLocRanges> getInferenceRanges(
   return getEligibleRanges(D, Defaults);
 }
 
+namespace {
+// Finds every declarator declaration in a TU. Implicit code and template
+// instantiations are skipped, as their types aren't written where they're
+// declared.
+class DeclaratorCollector : public RecursiveASTVisitor<DeclaratorCollector> {
+ public:
+  std::vector<const DeclaratorDecl *> Decls;
+
+  bool VisitDeclaratorDecl(DeclaratorDecl *D) {
+    Decls.push_back(D);
+    return true;
+  }
+};
+
+bool lessByUSR(const SymbolTypeLocRanges &L, const SymbolTypeLocRanges &R) {
+  return L.usr() < R.usr();
+}
+
+// Distinct declarations never share the location of their first range.
+bool sameDecl(const TypeLocRanges &L, const TypeLocRanges &R) {
+  return L.path() == R.path() && L.range(0).begin() == R.range(0).begin();
+}
+}  // namespace
+
+TypeLocRangesIndex getInferenceRangesIndex(
+    ASTContext &Ctx, const TypeNullabilityDefaults &Defaults) {
+  DeclaratorCollector Collector;
+  Collector.TraverseAST(Ctx);
+
+  llvm::StringMap<SymbolTypeLocRanges> BySymbol;
+  llvm::SmallString<128> USR;
+  for (const DeclaratorDecl *D : Collector.Decls) {
+    std::optional<TypeLocRanges> Ranges = getInferenceRanges(*D, Defaults);
+    if (!Ranges) continue;
+    USR.clear();
+    if (index::generateUSRForDecl(D, USR)) continue;
+    *BySymbol[USR].add_decl() = *std::move(Ranges);
+  }
+
+  TypeLocRangesIndex Result;
+  Result.mutable_symbol()->Reserve(BySymbol.size());
+  for (auto &Entry : BySymbol) {
+    SymbolTypeLocRanges &Symbol = *Result.add_symbol();
+    Symbol = std::move(Entry.second);
+    Symbol.set_usr(Entry.first());
+  }
+  llvm::sort(*Result.mutable_symbol(), lessByUSR);
+  return Result;
+}
+
+void mergeTypeLocRangesIndex(TypeLocRangesIndex &Into,
+                             const TypeLocRangesIndex &From) {
+  TypeLocRangesIndex Merged;
+  Merged.mutable_symbol()->Reserve(Into.symbol_size() + From.symbol_size());
+  auto L = Into.mutable_symbol()->begin(), LEnd = Into.mutable_symbol()->end();
+  auto R = From.symbol().begin(), REnd = From.symbol().end();
+  while (L != LEnd || R != REnd) {
+    if (R == REnd || (L != LEnd && lessByUSR(*L, *R))) {
+      *Merged.add_symbol() = std::move(*L++);
+    } else if (L == LEnd || lessByUSR(*R, *L)) {
+      *Merged.add_symbol() = *R++;
+    } else {
+      SymbolTypeLocRanges &Symbol = *Merged.add_symbol();
+      Symbol = std::move(*L++);
+      for (const TypeLocRanges &Decl : R->decl()) {
+        if (llvm::none_of(Symbol.decl(), [&](const TypeLocRanges &Existing) {
+              return sameDecl(Existing, Decl);
+            }))
+          *Symbol.add_decl() = Decl;
+      }
+      ++R;
+    }
+  }
+  Into = std::move(Merged);
+}
+
+absl::Nullable<const SymbolTypeLocRanges *> findTypeLocRanges(
+    const TypeLocRangesIndex &Index, llvm::StringRef USR) {
+  auto It = llvm::partition_point(Index.symbol(),
+                                  [&](const SymbolTypeLocRanges &S) {
+                                    return llvm::StringRef(S.usr()) < USR;
+                                  });
+  if (It == Index.symbol().end() || llvm::StringRef(It->usr()) != USR)
+    return nullptr;
+  return &*It;
+}
+
 }  // namespace clang::tidy::nullability
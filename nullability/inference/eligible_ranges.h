@@ -7,9 +7,12 @@
 
 #include <optional>
 
+#include "absl/base/nullability.h"
 #include "nullability/inference/inference.proto.h"
 #include "nullability/type_nullability.h"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclBase.h"
+#include "llvm/ADT/StringRef.h"
 
 namespace clang::tidy::nullability {
 
@@ -28,6 +31,25 @@ std::optional<TypeLocRanges> getEligibleRanges(
 std::optional<TypeLocRanges> getInferenceRanges(
     const Decl& D, const TypeNullabilityDefaults& Defaults);
 
+/// Collects the ranges of getInferenceRanges() for every declaration written
+/// in the TU, grouped by the USR of the declared symbol.
+///
+/// This lets eligible ranges be computed alongside inference and stored (e.g.
+/// as a serialized TypeLocRangesIndex), rather than reparsing each header to
+/// find the ranges of its declarations when applying inferred annotations.
+TypeLocRangesIndex getInferenceRangesIndex(
+    ASTContext& Ctx, const TypeNullabilityDefaults& Defaults);
+
+/// Adds the symbols and declarations in `From` to `Into`, e.g. to combine the
+/// indexes of several TUs. Declarations found by more than one TU (e.g. in a
+/// shared header) are kept once.
+void mergeTypeLocRangesIndex(TypeLocRangesIndex& Into,
+                             const TypeLocRangesIndex& From);
+
+/// Returns the ranges of the symbol with the given USR, if any.
+absl::Nullable<const SymbolTypeLocRanges*> findTypeLocRanges(
+    const TypeLocRangesIndex& Index, llvm::StringRef USR);
+
 }  // namespace clang::tidy::nullability
 
 #endif  // CRUBIT_NULLABILITY_INFERENCE_ELIGIBLE_RANGES_H_
@@ -18,6 +18,7 @@
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/Basic/LLVM.h"
 #include "clang/Testing/TestAST.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Testing/Annotations/Annotations.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"  // IWYU pragma: keep
@@ -33,6 +34,7 @@ using ::clang::ast_matchers::selectFirst;
 using ::clang::ast_matchers::varDecl;
 using ::llvm::Annotations;
 using ::testing::AllOf;
+using ::testing::ElementsAre;
 using ::testing::ExplainMatchResult;
 using ::testing::Optional;
 using ::testing::Pointwise;
@@ -1155,5 +1157,66 @@ TEST(ComplexDeclaratorTest, PointerToArrayOfFunctionPointers) {
                                                      Input.point("2"))}))))));
 }
 
+TEST(InferenceRangesIndexTest, CollectsDeclarationsBySymbol) {
+  auto Input = Annotations(R"(
+    struct S {
+      $field[[int *]]field;
+    };
+    void target($decl[[int *]]p);
+    void target($def[[int *]]p) {}
+    void noPointers(int i);
+    template <typename T>
+    void tmpl($tmpl[[T *]]p);
+  )");
+  NullabilityPragmas Pragmas;
+  TestAST TU(getAugmentedTestInputs(Input.code(), Pragmas));
+  TypeLocRangesIndex Index = getInferenceRangesIndex(
+      TU.context(), TypeNullabilityDefaults(TU.context(), Pragmas));
+
+  // The field and the two declarations of `target`; templates are not
+  // inference targets.
+  std::vector<std::string> MainFileSymbols;
+  for (const auto &Symbol : Index.symbol())
+    if (Symbol.decl(0).path() == MainFileName)
+      MainFileSymbols.push_back(Symbol.usr());
+  EXPECT_THAT(MainFileSymbols,
+              ElementsAre("c:@F@target#*I#", "c:@S@S@FI@field"));
+  EXPECT_TRUE(llvm::is_sorted(Index.symbol(), [](const auto &L, const auto &R) {
+    return L.usr() < R.usr();
+  }));
+
+  auto *Target = findTypeLocRanges(Index, "c:@F@target#*I#");
+  ASSERT_NE(Target, nullptr);
+  EXPECT_THAT(
+      Target->decl(),
+      UnorderedElementsAre(
+          TypeLocRanges(MainFileName, UnorderedElementsAre(
+                                          SlotRange(1, Input.range("decl")))),
+          TypeLocRanges(MainFileName, UnorderedElementsAre(
+                                          SlotRange(1, Input.range("def"))))));
+  auto *Field = findTypeLocRanges(Index, "c:@S@S@FI@field");
+  ASSERT_NE(Field, nullptr);
+  EXPECT_THAT(Field->decl(),
+              UnorderedElementsAre(TypeLocRanges(
+                  MainFileName, UnorderedElementsAre(
+                                    SlotRange(0, Input.range("field"))))));
+  EXPECT_EQ(findTypeLocRanges(Index, "c:@F@noPointers#I#"), nullptr);
+
+  // Merging in the same declarations, e.g. from another TU including the same
+  // header, doesn't duplicate them.
+  TypeLocRangesIndex Merged = Index;
+  mergeTypeLocRangesIndex(Merged, Index);
+  EXPECT_EQ(Merged.SerializeAsString(), Index.SerializeAsString());
+
+  TypeLocRangesIndex Other;
+  SymbolTypeLocRanges &OtherSymbol = *Other.add_symbol();
+  OtherSymbol.set_usr("c:@F@other#");
+  *OtherSymbol.add_decl() = Target->decl(0);
+  mergeTypeLocRangesIndex(Merged, Other);
+  EXPECT_EQ(Merged.symbol_size(), Index.symbol_size() + 1);
+  EXPECT_NE(findTypeLocRanges(Merged, "c:@F@other#"), nullptr);
+  EXPECT_NE(findTypeLocRanges(Merged, "c:@F@target#*I#"), nullptr);
+}
+
 }  // namespace
 }  // namespace clang::tidy::nullability
@@ -0,0 +1,167 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/inference/evidence_shard.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nullability/inference/inference.proto.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace clang::tidy::nullability {
+namespace {
+constexpr llvm::StringLiteral Magic = "NEV1";
+
+llvm::Error malformed(llvm::StringRef What) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 llvm::Twine("Malformed evidence shard: ") +
+                                     What);
+}
+
+void writeTable(llvm::ArrayRef<llvm::StringRef> Table, llvm::raw_ostream &OS) {
+  llvm::encodeULEB128(Table.size(), OS);
+  for (llvm::StringRef S : Table) {
+    llvm::encodeULEB128(S.size(), OS);
+    OS << S;
+  }
+}
+
+void writeColumn(llvm::ArrayRef<uint32_t> Column, llvm::raw_ostream &OS) {
+  for (uint32_t V : Column) llvm::encodeULEB128(V, OS);
+}
+
+// Consumes encoded values from the front of a buffer.
+class Reader {
+ public:
+  explicit Reader(llvm::StringRef Data) : Data(Data) {}
+
+  llvm::Expected<uint64_t> readInt() {
+    unsigned Length = 0;
+    const char *Error = nullptr;
+    uint64_t Value = llvm::decodeULEB128(Data.bytes_begin(), &Length,
+                                         Data.bytes_end(), &Error);
+    if (Error) return malformed(Error);
+    Data = Data.drop_front(Length);
+    return Value;
+  }
+
+  llvm::Expected<std::vector<llvm::StringRef>> readTable() {
+    llvm::Expected<uint64_t> Size = readInt();
+    if (!Size) return Size.takeError();
+    // Each entry takes at least one byte, which bounds the allocation.
+    if (*Size > Data.size()) return malformed("table too large");
+    std::vector<llvm::StringRef> Table;
+    Table.reserve(*Size);
+    for (uint64_t I = 0; I < *Size; ++I) {
+      llvm::Expected<uint64_t> Length = readInt();
+      if (!Length) return Length.takeError();
+      if (*Length > Data.size()) return malformed("string too long");
+      Table.push_back(Data.take_front(*Length));
+      Data = Data.drop_front(*Length);
+    }
+    return Table;
+  }
+
+  llvm::Expected<std::vector<uint32_t>> readColumn(uint64_t Size,
+                                                   uint64_t Limit) {
+    std::vector<uint32_t> Column;
+    Column.reserve(Size);
+    for (uint64_t I = 0; I < Size; ++I) {
+      llvm::Expected<uint64_t> V = readInt();
+      if (!V) return V.takeError();
+      if (*V >= Limit) return malformed("value out of range");
+      Column.push_back(*V);
+    }
+    return Column;
+  }
+
+  bool consume(llvm::StringRef Prefix) { return Data.consume_front(Prefix); }
+  size_t remaining() const { return Data.size(); }
+
+ private:
+  llvm::StringRef Data;
+};
+}  // namespace
+
+uint32_t EvidenceShardWriter::intern(llvm::StringRef S,
+                                     llvm::StringMap<uint32_t> &Index,
+                                     std::vector<llvm::StringRef> &Table) {
+  auto [It, Inserted] = Index.try_emplace(S, Table.size());
+  if (Inserted) Table.push_back(It->getKey());
+  return It->second;
+}
+
+void EvidenceShardWriter::add(llvm::StringRef USR, uint32_t Slot,
+                              Evidence::Kind Kind, llvm::StringRef Location) {
+  Symbols.push_back(intern(USR, SymbolIndex, SymbolTable));
+  Slots.push_back(Slot);
+  Kinds.push_back(Kind);
+  Locations.push_back(
+      Location.empty() ? 0 : intern(Location, LocationIndex, LocationTable) + 1);
+}
+
+std::string EvidenceShardWriter::finish() {
+  std::string Result;
+  llvm::raw_string_ostream OS(Result);
+  OS << Magic;
+  writeTable(SymbolTable, OS);
+  writeTable(LocationTable, OS);
+  llvm::encodeULEB128(Symbols.size(), OS);
+  writeColumn(Symbols, OS);
+  writeColumn(Slots, OS);
+  writeColumn(Kinds, OS);
+  writeColumn(Locations, OS);
+  OS.flush();
+  *this = EvidenceShardWriter();
+  return Result;
+}
+
+llvm::Error readEvidenceShard(llvm::StringRef Data,
+                              llvm::function_ref<void(const Evidence &)> Emit) {
+  Reader R(Data);
+  if (!R.consume(Magic)) return malformed("bad magic");
+  auto SymbolTable = R.readTable();
+  if (!SymbolTable) return SymbolTable.takeError();
+  auto LocationTable = R.readTable();
+  if (!LocationTable) return LocationTable.takeError();
+  auto Size = R.readInt();
+  if (!Size) return Size.takeError();
+  // Each value takes at least one byte in each of the four columns.
+  if (*Size > R.remaining() / 4) return malformed("too many entries");
+
+  auto Symbols = R.readColumn(*Size, SymbolTable->size());
+  if (!Symbols) return Symbols.takeError();
+  auto Slots = R.readColumn(*Size, UINT32_MAX);
+  if (!Slots) return Slots.takeError();
+  // Kinds are contiguous, so this only admits valid ones.
+  auto Kinds = R.readColumn(*Size, Evidence::Kind_MAX + 1);
+  if (!Kinds) return Kinds.takeError();
+  auto Locations = R.readColumn(*Size, LocationTable->size() + 1);
+  if (!Locations) return Locations.takeError();
+  if (R.remaining() != 0) return malformed("trailing data");
+
+  Evidence E;
+  for (uint64_t I = 0; I < *Size; ++I) {
+    E.mutable_symbol()->set_usr((*SymbolTable)[(*Symbols)[I]]);
+    E.set_slot((*Slots)[I]);
+    E.set_kind(static_cast<Evidence::Kind>((*Kinds)[I]));
+    if (uint32_t Loc = (*Locations)[I])
+      E.set_location((*LocationTable)[Loc - 1]);
+    else
+      E.clear_location();
+    Emit(E);
+  }
+  return llvm::Error::success();
+}
+
+}  // namespace clang::tidy::nullability
@@ -0,0 +1,73 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// A compact serialization of many pieces of Evidence, used to move evidence
+// between the "map" and "reduce" phases of inference (see inference.proto).
+//
+// Serializing each Evidence proto repeats the symbol's USR and the location
+// for every piece of evidence. A shard instead stores each distinct USR and
+// location once, and the evidence as columns of varint-encoded indices:
+//
+//   magic "NEV1"
+//   symbol table:   count, then (length, bytes) per USR
+//   location table: count, then (length, bytes) per location
+//   evidence count
+//   column of symbol indices
+//   column of slots
+//   column of kinds
+//   column of location indices + 1 (0 means no location)
+//
+// All integers are ULEB128. The format is not stable across versions, and is
+// intended only for data passed between phases of the same inference run.
+
+#ifndef CRUBIT_NULLABILITY_INFERENCE_EVIDENCE_SHARD_H_
+#define CRUBIT_NULLABILITY_INFERENCE_EVIDENCE_SHARD_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nullability/inference/inference.proto.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+namespace clang::tidy::nullability {
+
+// Accumulates evidence to be written as a shard.
+class EvidenceShardWriter {
+ public:
+  void add(const Evidence &E) {
+    add(E.symbol().usr(), E.slot(), E.kind(),
+        E.has_location() ? llvm::StringRef(E.location()) : llvm::StringRef());
+  }
+  // An empty Location is treated as absent.
+  void add(llvm::StringRef USR, uint32_t Slot, Evidence::Kind Kind,
+           llvm::StringRef Location = {});
+
+  // The number of pieces of evidence added so far.
+  size_t size() const { return Symbols.size(); }
+
+  // Returns the serialized shard. The writer is left empty.
+  std::string finish();
+
+ private:
+  static uint32_t intern(llvm::StringRef S, llvm::StringMap<uint32_t> &Index,
+                         std::vector<llvm::StringRef> &Table);
+
+  llvm::StringMap<uint32_t> SymbolIndex, LocationIndex;
+  std::vector<llvm::StringRef> SymbolTable, LocationTable;
+  // Columns, one entry per piece of evidence.
+  std::vector<uint32_t> Symbols, Slots, Kinds, Locations;
+};
+
+// Decodes a shard, calling `Emit` on each piece of evidence in the order it
+// was added to the writer. Fails if the data is not a well-formed shard.
+llvm::Error readEvidenceShard(llvm::StringRef Data,
+                              llvm::function_ref<void(const Evidence &)> Emit);
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_INFERENCE_EVIDENCE_SHARD_H_
@@ -0,0 +1,101 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/inference/evidence_shard.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "nullability/inference/inference.proto.h"
+#include "nullability/proto_matchers.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Testing/Support/Error.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+#include "third_party/protobuf/text_format.h"
+
+namespace clang::tidy::nullability {
+namespace {
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+Evidence evidence(llvm::StringRef Text) {
+  Evidence Result;
+  CHECK(proto2::TextFormat::ParseFromString(Text, &Result));
+  return Result;
+}
+
+std::vector<Evidence> read(llvm::StringRef Data) {
+  std::vector<Evidence> Result;
+  EXPECT_THAT_ERROR(
+      readEvidenceShard(Data, [&](const Evidence &E) { Result.push_back(E); }),
+      llvm::Succeeded());
+  return Result;
+}
+
+TEST(EvidenceShardTest, RoundTrip) {
+  EvidenceShardWriter Writer;
+  Writer.add(evidence(R"pb(
+    symbol { usr: "c:@F@f#*I#" } slot: 1 kind: UNCHECKED_DEREFERENCE
+    location: "a.cc:1:2"
+  )pb"));
+  Writer.add(evidence(R"pb(
+    symbol { usr: "c:@F@g" } slot: 0 kind: NULLABLE_RETURN
+  )pb"));
+  Writer.add(evidence(R"pb(
+    symbol { usr: "c:@F@f#*I#" } slot: 1 kind: NONNULL_ARGUMENT
+    location: "a.cc:1:2"
+  )pb"));
+  EXPECT_EQ(Writer.size(), 3u);
+  std::string Data = Writer.finish();
+  EXPECT_EQ(Writer.size(), 0u);
+
+  EXPECT_THAT(read(Data), ElementsAre(EqualsProto(R"pb(
+                                        symbol { usr: "c:@F@f#*I#" }
+                                        slot: 1
+                                        kind: UNCHECKED_DEREFERENCE
+                                        location: "a.cc:1:2"
+                                      )pb"),
+                                      EqualsProto(R"pb(
+                                        symbol { usr: "c:@F@g" }
+                                        slot: 0
+                                        kind: NULLABLE_RETURN
+                                      )pb"),
+                                      EqualsProto(R"pb(
+                                        symbol { usr: "c:@F@f#*I#" }
+                                        slot: 1
+                                        kind: NONNULL_ARGUMENT
+                                        location: "a.cc:1:2"
+                                      )pb")));
+}
+
+TEST(EvidenceShardTest, RepeatedStringsStoredOnce) {
+  EvidenceShardWriter Writer;
+  std::string USR(100, 'x');
+  for (unsigned I = 0; I < 10; ++I)
+    Writer.add(USR, I, Evidence::UNCHECKED_DEREFERENCE, "loc");
+  EXPECT_LT(Writer.finish().size(), 2 * USR.size());
+}
+
+TEST(EvidenceShardTest, Empty) {
+  EXPECT_THAT(read(EvidenceShardWriter().finish()), IsEmpty());
+}
+
+TEST(EvidenceShardTest, Malformed) {
+  EvidenceShardWriter Writer;
+  Writer.add("c:@F@f", 0, Evidence::NULLABLE_RETURN, "a.cc:1:2");
+  std::string Data = Writer.finish();
+  auto Ignore = [](const Evidence &) {};
+
+  EXPECT_THAT_ERROR(readEvidenceShard("not a shard", Ignore), llvm::Failed());
+  for (unsigned Length = 0; Length < Data.size(); ++Length)
+    EXPECT_THAT_ERROR(
+        readEvidenceShard(llvm::StringRef(Data).take_front(Length), Ignore),
+        llvm::Failed());
+  EXPECT_THAT_ERROR(readEvidenceShard(Data + "x", Ignore), llvm::Failed());
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
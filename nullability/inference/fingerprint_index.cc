@@ -0,0 +1,98 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/inference/fingerprint_index.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nullability/inference/slot_fingerprint.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace clang::tidy::nullability {
+namespace {
+constexpr llvm::StringLiteral Magic = "NFP1";
+constexpr size_t VersionOffset = 4;
+constexpr size_t CountOffset = 8;
+constexpr size_t HeaderSize = 16;
+
+llvm::Error malformed(const llvm::Twine &What) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "Malformed fingerprint index: " + What);
+}
+}  // namespace
+
+std::string SlotFingerprintIndex::serialize(
+    std::vector<SlotFingerprint> Fingerprints, FingerprintVersion Version) {
+  llvm::sort(Fingerprints);
+  Fingerprints.erase(llvm::unique(Fingerprints), Fingerprints.end());
+
+  std::string Result;
+  llvm::raw_string_ostream OS(Result);
+  llvm::support::endian::Writer W(OS, llvm::endianness::little);
+  OS << Magic;
+  W.write<uint32_t>(static_cast<uint32_t>(Version));
+  W.write<uint64_t>(Fingerprints.size());
+  for (SlotFingerprint F : Fingerprints) W.write<uint64_t>(F);
+  OS.flush();
+  return Result;
+}
+
+llvm::Expected<SlotFingerprintIndex> SlotFingerprintIndex::open(
+    llvm::StringRef Path, FingerprintVersion Expected) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buffer =
+      llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (!Buffer) return llvm::errorCodeToError(Buffer.getError());
+  return fromBuffer(std::move(*Buffer), Expected);
+}
+
+llvm::Expected<SlotFingerprintIndex> SlotFingerprintIndex::fromBuffer(
+    std::unique_ptr<llvm::MemoryBuffer> Buffer, FingerprintVersion Expected) {
+  llvm::StringRef Data = Buffer->getBuffer();
+  if (!Data.starts_with(Magic) || Data.size() < HeaderSize)
+    return malformed("bad header");
+  if (reinterpret_cast<uintptr_t>(Data.data()) % alignof(uint64_t) != 0)
+    return malformed("buffer is not aligned");
+  uint32_t Version =
+      llvm::support::endian::read32le(Data.data() + VersionOffset);
+  if (Version != static_cast<uint32_t>(Expected))
+    return malformed("fingerprint version " + llvm::Twine(Version) +
+                     ", expected " +
+                     llvm::Twine(static_cast<uint32_t>(Expected)));
+  uint64_t Count = llvm::support::endian::read64le(Data.data() + CountOffset);
+  if (Count != (Data.size() - HeaderSize) / sizeof(uint64_t) ||
+      (Data.size() - HeaderSize) % sizeof(uint64_t) != 0)
+    return malformed("size does not match count");
+
+  SlotFingerprintIndex Result;
+  Result.Fingerprints = llvm::ArrayRef(
+      reinterpret_cast<const llvm::support::ulittle64_t *>(Data.data() +
+                                                           HeaderSize),
+      Count);
+  Result.Buffer = std::move(Buffer);
+  return Result;
+}
+
+bool SlotFingerprintIndex::contains(SlotFingerprint F) const {
+  // Searches the mapped data in place; nothing is copied or built on load.
+  auto It = std::lower_bound(
+      Fingerprints.begin(), Fingerprints.end(), F,
+      [](llvm::support::ulittle64_t L, SlotFingerprint R) { return L < R; });
+  return It != Fingerprints.end() && *It == F;
+}
+
+}  // namespace clang::tidy::nullability
@@ -0,0 +1,62 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// A read-only, on-disk set of SlotFingerprints.
+//
+// With ~100M inference targets, building a DenseSet of previous inferences in
+// every worker is expensive. The index is instead written once (e.g. by the
+// reduce phase), and each worker maps the file into memory and queries it in
+// place.
+//
+// The file is the magic "NFP1", the little-endian uint32 FingerprintVersion
+// and uint64 count, followed by that many little-endian uint64 fingerprints in
+// increasing order.
+
+#ifndef CRUBIT_NULLABILITY_INFERENCE_FINGERPRINT_INDEX_H_
+#define CRUBIT_NULLABILITY_INFERENCE_FINGERPRINT_INDEX_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nullability/inference/slot_fingerprint.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace clang::tidy::nullability {
+
+class SlotFingerprintIndex {
+ public:
+  // Returns the contents of an index file containing `Fingerprints`, which
+  // were produced with `Version`. Duplicates are removed.
+  static std::string serialize(
+      std::vector<SlotFingerprint> Fingerprints,
+      FingerprintVersion Version = DefaultFingerprintVersion);
+
+  // Maps an index file into memory.
+  // Fails unless the index holds fingerprints of the expected version, as
+  // queries would silently find nothing otherwise.
+  static llvm::Expected<SlotFingerprintIndex> open(
+      llvm::StringRef Path,
+      FingerprintVersion Expected = DefaultFingerprintVersion);
+  // Uses an index held in `Buffer`, which must be 8-byte aligned.
+  static llvm::Expected<SlotFingerprintIndex> fromBuffer(
+      std::unique_ptr<llvm::MemoryBuffer> Buffer,
+      FingerprintVersion Expected = DefaultFingerprintVersion);
+
+  bool contains(SlotFingerprint F) const;
+  size_t size() const { return Fingerprints.size(); }
+
+ private:
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  llvm::ArrayRef<llvm::support::ulittle64_t> Fingerprints;
+};
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_INFERENCE_FINGERPRINT_INDEX_H_
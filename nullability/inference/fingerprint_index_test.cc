@@ -0,0 +1,68 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/inference/fingerprint_index.h"
+
+#include <memory>
+#include <string>
+
+#include "nullability/inference/slot_fingerprint.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Testing/Support/Error.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+
+namespace clang::tidy::nullability {
+namespace {
+
+std::unique_ptr<llvm::MemoryBuffer> buffer(const std::string &Data) {
+  // Copies into a suitably aligned buffer.
+  return llvm::MemoryBuffer::getMemBufferCopy(Data);
+}
+
+TEST(SlotFingerprintIndexTest, Contains) {
+  auto Index = SlotFingerprintIndex::fromBuffer(
+      buffer(SlotFingerprintIndex::serialize({fingerprint("a", 0),
+                                              fingerprint("b", 1),
+                                              fingerprint("a", 0)})));
+  ASSERT_THAT_EXPECTED(Index, llvm::Succeeded());
+  EXPECT_EQ(Index->size(), 2u);
+  EXPECT_TRUE(Index->contains(fingerprint("a", 0)));
+  EXPECT_TRUE(Index->contains(fingerprint("b", 1)));
+  EXPECT_FALSE(Index->contains(fingerprint("a", 1)));
+  EXPECT_FALSE(Index->contains(fingerprint("c", 0)));
+}
+
+TEST(SlotFingerprintIndexTest, Empty) {
+  auto Index = SlotFingerprintIndex::fromBuffer(
+      buffer(SlotFingerprintIndex::serialize({})));
+  ASSERT_THAT_EXPECTED(Index, llvm::Succeeded());
+  EXPECT_EQ(Index->size(), 0u);
+  EXPECT_FALSE(Index->contains(0));
+}
+
+TEST(SlotFingerprintIndexTest, Version) {
+  std::string Data = SlotFingerprintIndex::serialize(
+      {fingerprint("a", 0, FingerprintVersion::MD5)}, FingerprintVersion::MD5);
+  EXPECT_THAT_EXPECTED(SlotFingerprintIndex::fromBuffer(
+                           buffer(Data), FingerprintVersion::XXH3),
+                       llvm::Failed());
+  auto Index =
+      SlotFingerprintIndex::fromBuffer(buffer(Data), FingerprintVersion::MD5);
+  ASSERT_THAT_EXPECTED(Index, llvm::Succeeded());
+  EXPECT_TRUE(Index->contains(fingerprint("a", 0, FingerprintVersion::MD5)));
+}
+
+TEST(SlotFingerprintIndexTest, Malformed) {
+  std::string Data = SlotFingerprintIndex::serialize({1, 2, 3});
+  EXPECT_THAT_EXPECTED(SlotFingerprintIndex::fromBuffer(buffer("garbage")),
+                       llvm::Failed());
+  EXPECT_THAT_EXPECTED(
+      SlotFingerprintIndex::fromBuffer(buffer(Data.substr(0, Data.size() - 8))),
+      llvm::Failed());
+  EXPECT_THAT_EXPECTED(SlotFingerprintIndex::fromBuffer(buffer(Data + "x")),
+                       llvm::Failed());
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
@@ -4,6 +4,13 @@
 
 #include "nullability/inference/infer_tu.h"
 
+#include <algorithm>
+#include <barrier>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -11,121 +18,590 @@
 #include "nullability/inference/inference.proto.h"
 #include "nullability/inference/merge.h"
 #include "nullability/inference/slot_fingerprint.h"
+#include "nullability/pointer_nullability_analysis.h"
 #include "nullability/pragma.h"
+#include "nullability/solver_cache.h"
+#include "nullability/type_nullability.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclBase.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/Analysis/CallGraph.h"
+#include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/SourceManager.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/raw_ostream.h"
 
 namespace clang::tidy::nullability {
 namespace {
 
+// Non-trivial inferences from one round, to be fed into the next.
+struct InferenceSets {
+  llvm::DenseSet<SlotFingerprint> Nullable;
+  llvm::DenseSet<SlotFingerprint> Nonnull;
+};
+
+InferenceSets getNonTrivialInferences(llvm::ArrayRef<Inference> AllInference) {
+  InferenceSets Result;
+  for (const auto& Inference : AllInference) {
+    SymbolFingerprinter Fingerprint(Inference.symbol().usr());
+    for (const auto& SlotInference : Inference.slot_inference()) {
+      if (SlotInference.trivial() || SlotInference.conflict()) continue;
+      switch (SlotInference.nullability()) {
+        case Nullability::NULLABLE:
+          Result.Nullable.insert(Fingerprint(SlotInference.slot()));
+          break;
+        case Nullability::NONNULL:
+          Result.Nonnull.insert(Fingerprint(SlotInference.slot()));
+          break;
+        default:
+          break;
+      }
+    }
+  }
+  return Result;
+}
+
+// Combines evidence into a Partial per symbol as it is emitted, so that memory
+// is proportional to the number of symbols rather than the amount of evidence.
+//
+// Symbols are identified by their interned id in a USRCache; the USR is only
+// attached once the partials leave the worker that produced them.
+class SymbolPartials {
+ public:
+  SymbolPartials() = default;
+  explicit SymbolPartials(const USRCache& Symbols) : Symbols(&Symbols) {}
+
+  // Adds evidence for `Symbol`. The evidence's own `symbol` is ignored.
+  void add(SymbolId Symbol, const Evidence& E) {
+    auto [It, Inserted] = Partials.try_emplace(Symbol);
+    if (Inserted)
+      It->second = partialFromEvidence(E);
+    else
+      mergePartials(It->second, partialFromEvidence(E));
+  }
+
+  // Adds the partials from `Other`, which must use the same USRCache.
+  void addAll(const SymbolPartials& Other) {
+    for (const auto& [Symbol, P] : Other.Partials) {
+      auto [It, Inserted] = Partials.try_emplace(Symbol, P);
+      if (!Inserted) mergePartials(It->second, P);
+    }
+  }
+
+  // The partial for `Symbol`, if there is any evidence for it.
+  const Partial* find(SymbolId Symbol) const {
+    auto It = Partials.find(Symbol);
+    return It == Partials.end() ? nullptr : &It->second;
+  }
+
+  // Moves the partials into `Out`, merging with those for the same USR.
+  void moveInto(PartialsBySymbol& Out) && {
+    for (auto& [Symbol, P] : Partials) {
+      P.mutable_symbol()->set_usr(Symbols->usr(Symbol));
+      Out.add(std::move(P));
+    }
+    Partials.clear();
+  }
+
+ private:
+  const USRCache* Symbols = nullptr;
+  llvm::DenseMap<SymbolId, Partial> Partials;
+};
+
+bool isCPlusPlus(ASTContext& Ctx) {
+  if (Ctx.getLangOpts().CPlusPlus) return true;
+  llvm::errs() << "Skipping non-C++ input file: "
+               << Ctx.getSourceManager()
+                      .getFileEntryRefForID(
+                          Ctx.getSourceManager().getMainFileID())
+                      ->getName()
+               << "\n";
+  return false;
+}
+
+// Orders `Definitions` callees first, by the TU's call graph. Definitions that
+// are not functions in the call graph (e.g. variable initializers) come last.
+std::vector<const Decl*> bottomUpOrder(
+    ASTContext& Ctx, const llvm::DenseSet<const Decl*>& Definitions) {
+  llvm::DenseMap<const Decl*, const Decl*> ByCanonical;
+  for (const Decl* D : Definitions) ByCanonical[D->getCanonicalDecl()] = D;
+
+  std::vector<const Decl*> Order;
+  Order.reserve(Definitions.size());
+  llvm::DenseSet<const Decl*> Placed;
+  CallGraph Graph;
+  Graph.addToCallGraph(Ctx.getTranslationUnitDecl());
+  // The strongly connected components are visited callees first.
+  for (auto SCC = llvm::scc_begin(&Graph); !SCC.isAtEnd(); ++SCC) {
+    for (const CallGraphNode* Node : *SCC) {
+      if (!Node->getDecl()) continue;  // The root.
+      auto It = ByCanonical.find(Node->getDecl()->getCanonicalDecl());
+      if (It != ByCanonical.end() && Placed.insert(It->second).second)
+        Order.push_back(It->second);
+    }
+  }
+  for (const Decl* D : Definitions)
+    if (Placed.insert(D).second) Order.push_back(D);
+  return Order;
+}
+
+// The first round to run, given where a run is resumed from.
+unsigned firstIteration(const RoundCheckpoints& Checkpoints) {
+  return Checkpoints.Resume ? Checkpoints.ResumeAfter + 1 : 0;
+}
+
+// Hands one round of a worker's evidence to the merge step, and returns the
+// inferences formed from the evidence of all workers for that round.
+// The result stays valid until the worker's next call.
+using EvidenceExchange =
+    llvm::function_ref<const std::vector<Inference>&(SymbolPartials)>;
+
 class InferenceManager {
  public:
   InferenceManager(ASTContext& Ctx, unsigned Iterations,
                    llvm::function_ref<bool(const Decl&)> Filter,
-                   const NullabilityPragmas& Pragmas)
-      : Ctx(Ctx), Iterations(Iterations), Filter(Filter), Pragmas(Pragmas) {}
-
-  std::vector<Inference> inferenceRound(
-      EvidenceSites Sites, USRCache USRCache,
-      PreviousInferences InferencesFromLastRound) const {
-    std::vector<Inference> AllInference;
-    std::vector<Evidence> AllEvidence;
-
-    // Collect all evidence.
-    auto Emitter = evidenceEmitter([&](auto& E) { AllEvidence.push_back(E); },
-                                   USRCache, Ctx);
+                   const NullabilityPragmas& Pragmas,
+                   std::vector<DefinitionStats>* Stats,
+                   unsigned WideningThreshold,
+                   const RoundCheckpoints& Checkpoints, bool BottomUp,
+                   unsigned Shard = 0, unsigned NumShards = 1)
+      : Ctx(Ctx),
+        Iterations(Iterations),
+        Filter(Filter),
+        Pragmas(Pragmas),
+        Stats(Stats),
+        WideningThreshold(WideningThreshold),
+        Checkpoints(Checkpoints),
+        BottomUp(BottomUp),
+        Shard(Shard),
+        NumShards(NumShards) {}
+
+  void iterativelyInfer(EvidenceExchange Exchange) const {
+    auto Sites = EvidenceSites::discover(Ctx);
+    USRCache USRCache;
+    // Definitions in a TU often make the same queries, e.g. from shared inline
+    // helpers and macros.
+    SolverCache SolverCache;
+    SolverFactory MakeSolver = SolverCache.wrap(makeDefaultSolverForInference);
+    TypeNullabilityCache TypeCache;
+    AnalysisContextPool ContextPool;
+
+    // Evidence from declarations doesn't depend on previous inferences, so is
+    // collected once.
+    SymbolPartials DeclarationPartials(USRCache);
+    // Where the emitter currently sends evidence. The emitter is expensive to
+    // create, so is shared by all sites.
+    SymbolPartials* Sink = &DeclarationPartials;
+    auto Emitter = symbolEvidenceEmitter(
+        [&](SymbolId Symbol, const Evidence& E) { Sink->add(Symbol, E); },
+        USRCache, Ctx, &Sites.VirtualMethodOverrides);
     for (const auto* Decl : Sites.Declarations) {
       if (Filter && !Filter(*Decl)) continue;
+      if (!inShard(*Decl, USRCache)) continue;
       collectEvidenceFromTargetDeclaration(*Decl, Emitter, Pragmas);
     }
-    for (const auto* Impl : Sites.Definitions) {
+
+    std::vector<const Decl*> Order;
+    if (BottomUp)
+      Order = bottomUpOrder(Ctx, Sites.Definitions);
+    else
+      Order.assign(Sites.Definitions.begin(), Sites.Definitions.end());
+
+    llvm::DenseMap<const Decl*, DefinitionResult> Definitions;
+    InferenceSets FromLastRound;
+    // Slots decided early in the last round after some definition had already
+    // consulted them, whose readers must be analyzed again.
+    llvm::DenseSet<SlotFingerprint> RevisedAfterUse;
+    // When resuming, the definitions' evidence from the saved round is not
+    // known, so all are analyzed in the first round run.
+    const std::vector<Inference>* AllInference = Checkpoints.Resume;
+    for (unsigned Iteration = firstIteration(Checkpoints);
+         Iteration == 0 || Iteration < Iterations; ++Iteration) {
+      InferenceSets FromThisRound;
+      std::optional<llvm::DenseSet<SlotFingerprint>> Changed;
+      if (AllInference) {
+        FromThisRound = getNonTrivialInferences(*AllInference);
+        Changed = getChangedSlots(FromLastRound, FromThisRound);
+        Changed->insert(RevisedAfterUse.begin(), RevisedAfterUse.end());
+      }
+      RevisedAfterUse.clear();
+      collectFromDefinitions(Iteration, Order, USRCache, MakeSolver, TypeCache,
+                             ContextPool, Emitter, Sink, DeclarationPartials,
+                             FromThisRound, Changed ? &*Changed : nullptr,
+                             RevisedAfterUse, Definitions);
+
+      SymbolPartials Partials = DeclarationPartials;
+      for (const auto* Impl : Sites.Definitions)
+        if (auto It = Definitions.find(Impl); It != Definitions.end())
+          Partials.addAll(It->second.Partials);
+      AllInference = &Exchange(std::move(Partials));
+      // Every shard has the same inferences, so one saves them.
+      if (Checkpoints.Save && Shard == 0)
+        Checkpoints.Save(Iteration, *AllInference);
+      FromLastRound = std::move(FromThisRound);
+    }
+  }
+
+ private:
+  // The evidence collected from one definition, and the previous inferences
+  // it was collected with.
+  struct DefinitionResult {
+    SymbolPartials Partials;
+    llvm::DenseSet<SlotFingerprint> Dependencies;
+  };
+
+  // Slots whose inferred nullability differs between the two rounds.
+  static llvm::DenseSet<SlotFingerprint> getChangedSlots(
+      const InferenceSets& Before, const InferenceSets& After) {
+    llvm::DenseSet<SlotFingerprint> Changed;
+    auto AddSymmetricDifference = [&](const llvm::DenseSet<SlotFingerprint>& A,
+                                      const llvm::DenseSet<SlotFingerprint>& B) {
+      for (SlotFingerprint F : A)
+        if (!B.contains(F)) Changed.insert(F);
+      for (SlotFingerprint F : B)
+        if (!A.contains(F)) Changed.insert(F);
+    };
+    AddSymmetricDifference(Before.Nullable, After.Nullable);
+    AddSymmetricDifference(Before.Nonnull, After.Nonnull);
+    return Changed;
+  }
+
+  // (Re)collects evidence from the definitions in `Order`, pointing `Sink`
+  // (the destination of `Emit`) at each definition's result in turn.
+  // If `Changed` is set, definitions in `Results` that consulted none of the
+  // changed slots are kept as they are rather than analyzed again.
+  //
+  // In bottom-up mode, the slots of each definition's symbol are also decided
+  // early (see decideEarly) into `Inferences`, for the definitions after it.
+  // The slots that had already been consulted are added to `RevisedAfterUse`.
+  void collectFromDefinitions(
+      unsigned Iteration, llvm::ArrayRef<const Decl*> Order,
+      USRCache& USRCache, const SolverFactory& MakeSolver,
+      TypeNullabilityCache& TypeCache, AnalysisContextPool& ContextPool,
+      llvm::function_ref<EvidenceEmitter> Emit, SymbolPartials*& Sink,
+      const SymbolPartials& DeclarationPartials, InferenceSets& Inferences,
+      const llvm::DenseSet<SlotFingerprint>* Changed,
+      llvm::DenseSet<SlotFingerprint>& RevisedAfterUse,
+      llvm::DenseMap<const Decl*, DefinitionResult>& Results) const {
+    // The slots consulted and those decided early so far in this round.
+    llvm::DenseSet<SlotFingerprint> Consulted;
+    llvm::DenseSet<SlotFingerprint> Revised;
+    for (const auto* Impl : Order) {
       if (Filter && !Filter(*Impl)) continue;
+      if (!inShard(*Impl, USRCache)) continue;
+      auto [It, Inserted] = Results.try_emplace(Impl);
+      DefinitionResult& Result = It->second;
+      if (!Inserted && Changed &&
+          llvm::none_of(Result.Dependencies, [&](SlotFingerprint F) {
+            return Changed->contains(F) || Revised.contains(F);
+          })) {
+        if (BottomUp)
+          Consulted.insert(Result.Dependencies.begin(),
+                           Result.Dependencies.end());
+        continue;
+      }
+
+      Result.Partials = SymbolPartials(USRCache);
+      Result.Dependencies.clear();
+      Sink = &Result.Partials;
+      DefinitionStats* DefStats = nullptr;
+      if (Stats) {
+        DefStats = &Stats->emplace_back();
+        DefStats->set_iteration(Iteration);
+      }
       if (auto Err = collectEvidenceFromDefinition(
-              *Impl, Emitter, USRCache, Pragmas, InferencesFromLastRound)) {
+              *Impl, Emit, USRCache, Pragmas,
+              {Inferences.Nullable, Inferences.Nonnull, &Result.Dependencies},
+              MakeSolver, DefStats, &TypeCache, WideningThreshold,
+              &ContextPool)) {
         llvm::errs() << "Error in evidence collection: "
                      << toString(std::move(Err)) << "\n";
       }
+      if (!BottomUp) continue;
+      Consulted.insert(Result.Dependencies.begin(), Result.Dependencies.end());
+      for (SlotFingerprint F :
+           decideEarly(*Impl, USRCache, DeclarationPartials, Result.Partials,
+                       Inferences)) {
+        Revised.insert(F);
+        if (Consulted.contains(F)) RevisedAfterUse.insert(F);
+      }
     }
-    // Group by symbol.
-    llvm::sort(AllEvidence, [&](const Evidence& L, const Evidence& R) {
-      return L.symbol().usr() < R.symbol().usr();
-    });
-    // For each symbol, combine evidence into an inference.
-    llvm::ArrayRef<Evidence> RemainingEvidence = AllEvidence;
-
-    while (!RemainingEvidence.empty()) {
-      auto Batch = RemainingEvidence.take_while([&](const Evidence& E) {
-        return E.symbol().usr() == RemainingEvidence.front().symbol().usr();
-      });
-      RemainingEvidence = RemainingEvidence.drop_front(Batch.size());
-      AllInference.push_back(mergeEvidence(Batch));
-    }
-    return AllInference;
-  }
-
-  std::vector<Inference> iterativelyInfer() const {
-    if (!Ctx.getLangOpts().CPlusPlus) {
-      llvm::errs() << "Skipping non-C++ input file: "
-                   << Ctx.getSourceManager()
-                          .getFileEntryRefForID(
-                              Ctx.getSourceManager().getMainFileID())
-                          ->getName()
-                   << "\n";
-      return std::vector<Inference>();
-    }
-    auto Sites = EvidenceSites::discover(Ctx);
-    USRCache USRCache;
+  }
 
-    std::vector<Inference> AllInference = inferenceRound(Sites, USRCache, {});
-
-    for (unsigned Iteration = 1; Iteration < Iterations; ++Iteration) {
-      llvm::DenseSet<SlotFingerprint> NullableFromLastRound;
-      llvm::DenseSet<SlotFingerprint> NonnullFromLastRound;
-
-      for (const auto& Inference : AllInference) {
-        for (const auto& SlotInference : Inference.slot_inference()) {
-          if (SlotInference.trivial() || SlotInference.conflict()) continue;
-          switch (SlotInference.nullability()) {
-            case Nullability::NULLABLE:
-              NullableFromLastRound.insert(
-                  fingerprint(Inference.symbol().usr(), SlotInference.slot()));
-              break;
-            case Nullability::NONNULL:
-              NonnullFromLastRound.insert(
-                  fingerprint(Inference.symbol().usr(), SlotInference.slot()));
-              break;
-            default:
-              break;
-          }
-        }
-      }
+  // Decides the slots of the symbol defined by `Impl` from its declarations'
+  // evidence and its definition's, which in bottom-up order precede the
+  // analyses of its callers. Returns the slots newly inferred.
+  //
+  // The decisions go into `Inferences` at once, so the definitions analyzed
+  // after `Impl` in this same round (its callers, in bottom-up order) read
+  // them as previous inferences and collect their evidence with them, rather
+  // than waiting for the next round.
+  //
+  // The evidence from callers is not yet collected, so only slots with no
+  // previous inference are decided, rather than undoing an inference formed
+  // from all of the evidence. At the end of the round, the inferences merged
+  // from all of the evidence replace these decisions.
+  static llvm::SmallVector<SlotFingerprint> decideEarly(
+      const Decl& Impl, USRCache& USRCache,
+      const SymbolPartials& DeclarationPartials,
+      const SymbolPartials& DefinitionPartials, InferenceSets& Inferences) {
+    llvm::SmallVector<SlotFingerprint> Decided;
+    std::optional<SymbolId> Symbol = USRCache.getOrCreateId(Impl);
+    if (!Symbol) return Decided;
+    const Partial* FromDefinition = DefinitionPartials.find(*Symbol);
+    if (!FromDefinition) return Decided;
+    Partial P = *FromDefinition;
+    if (const Partial* FromDeclarations = DeclarationPartials.find(*Symbol))
+      mergePartials(P, *FromDeclarations, SampleReservoir{/*Size=*/0});
 
-      AllInference = inferenceRound(
-          Sites, USRCache, {NullableFromLastRound, NonnullFromLastRound});
+    SymbolFingerprinter Fingerprint(USRCache.usr(*Symbol));
+    for (const auto& Slot : finalize(P).slot_inference()) {
+      if (Slot.trivial() || Slot.conflict()) continue;
+      SlotFingerprint F = Fingerprint(Slot.slot());
+      if (Inferences.Nullable.contains(F) || Inferences.Nonnull.contains(F))
+        continue;
+      switch (Slot.nullability()) {
+        case Nullability::NULLABLE:
+          Inferences.Nullable.insert(F);
+          break;
+        case Nullability::NONNULL:
+          Inferences.Nonnull.insert(F);
+          break;
+        default:
+          continue;
+      }
+      Decided.push_back(F);
     }
-    return AllInference;
+    return Decided;
+  }
+
+  // Whether the evidence site D is assigned to this shard.
+  // Hashing the USR gives the same assignment in every parse of the TU.
+  bool inShard(const Decl& D, USRCache& USRCache) const {
+    if (NumShards <= 1) return true;
+    return fingerprint(getOrGenerateUSR(USRCache, D), 0) % NumShards == Shard;
   }
 
- private:
   ASTContext& Ctx;
   unsigned Iterations;
   llvm::function_ref<bool(const Decl&)> Filter;
   const NullabilityPragmas& Pragmas;
+  std::vector<DefinitionStats>* Stats;
+  unsigned WideningThreshold;
+  const RoundCheckpoints& Checkpoints;
+  bool BottomUp;
+  unsigned Shard;
+  unsigned NumShards;
+};
+
+// Gathers each round's evidence from all workers, and merges it once every
+// worker has contributed.
+class ShardedRounds {
+ public:
+  explicit ShardedRounds(unsigned Workers)
+      : WorkerPartials(Workers), Barrier(Workers, MergeStep{this}) {}
+
+  const std::vector<Inference>& exchange(unsigned Worker,
+                                         SymbolPartials Partials) {
+    WorkerPartials[Worker] = std::move(Partials);
+    Barrier.arrive_and_wait();
+    return Merged;
+  }
+
+  std::vector<Inference> takeResult() && { return std::move(Merged); }
+
+ private:
+  // Runs on one thread, once all workers have arrived. No worker reads
+  // `Merged` from the previous round after arriving, so it is safe to replace.
+  void merge() {
+    PartialsBySymbol AllPartials;
+    for (auto& Partials : WorkerPartials)
+      std::exchange(Partials, {}).moveInto(AllPartials);
+    Merged = AllPartials.finalize();
+  }
+
+  struct MergeStep {
+    ShardedRounds* Rounds;
+    void operator()() noexcept { Rounds->merge(); }
+  };
+
+  std::vector<SymbolPartials> WorkerPartials;
+  std::vector<Inference> Merged;
+  std::barrier<MergeStep> Barrier;
 };
 }  // namespace
 
 std::vector<Inference> inferTU(ASTContext& Ctx,
                                const NullabilityPragmas& Pragmas,
                                unsigned Iterations,
-                               llvm::function_ref<bool(const Decl&)> Filter) {
-  return InferenceManager(Ctx, Iterations, Filter, Pragmas).iterativelyInfer();
+                               llvm::function_ref<bool(const Decl&)> Filter,
+                               std::vector<DefinitionStats>* Stats,
+                               unsigned WideningThreshold,
+                               const RoundCheckpoints& Checkpoints,
+                               bool BottomUp) {
+  if (!isCPlusPlus(Ctx)) return std::vector<Inference>();
+  if (Checkpoints.Resume &&
+      firstIteration(Checkpoints) >= std::max(Iterations, 1u))
+    return *Checkpoints.Resume;
+  std::vector<Inference> Merged;
+  InferenceManager(Ctx, Iterations, Filter, Pragmas, Stats, WideningThreshold,
+                   Checkpoints, BottomUp)
+      .iterativelyInfer(
+          [&](SymbolPartials Partials) -> const std::vector<Inference>& {
+            PartialsBySymbol BySymbol;
+            std::move(Partials).moveInto(BySymbol);
+            Merged = BySymbol.finalize();
+            return Merged;
+          });
+  return Merged;
+}
+
+void collectTUEvidence(ASTContext& Ctx, const NullabilityPragmas& Pragmas,
+                       llvm::function_ref<void(const Evidence&)> Emit,
+                       PreviousInferences Previous,
+                       llvm::function_ref<bool(const Decl&)> Filter,
+                       std::vector<DefinitionStats>* Stats,
+                       unsigned WideningThreshold, bool Deduplicate,
+                       SharedUSRCache* SharedUSRs,
+                       AnalyzedDefinitions* Analyzed,
+                       const SolverFactory& MakeSolver) {
+  if (!isCPlusPlus(Ctx)) return;
+  auto Sites = EvidenceSites::discover(Ctx);
+  USRCache USRCache(SharedUSRs);
+  SolverCache SolverCache;
+  SolverFactory MakeCachingSolver = SolverCache.wrap(MakeSolver);
+  TypeNullabilityCache TypeCache;
+  AnalysisContextPool ContextPool;
+  auto Emitter = evidenceEmitter([&](const Evidence& E) { Emit(E); }, USRCache,
+                                 Ctx, &Sites.VirtualMethodOverrides);
+  // Whether the site being collected from emitted evidence for a virtual
+  // method, which is also emitted for its overrides in this TU.
+  bool EmittedForVirtual = false;
+  auto TrackingEmitter = [&](const clang::Decl& Target, Slot S,
+                             Evidence::Kind Kind, SourceLocation Loc) {
+    if (const auto* MD = dyn_cast<CXXMethodDecl>(&Target);
+        MD && MD->isVirtual())
+      EmittedForVirtual = true;
+    Emitter(Target, S, Kind, Loc);
+  };
+  llvm::function_ref<EvidenceEmitter> SiteEmitter = Emitter;
+  if (Analyzed) SiteEmitter = TrackingEmitter;
+  // Whether to collect evidence from the site, which is not the case if it's
+  // in a header and was already analyzed with the same previous inferences.
+  // Sets `Fingerprint`, for recording the site once it's analyzed.
+  auto ToAnalyze = [&](const clang::Decl& D, bool Definition,
+                       std::optional<uint64_t>& Fingerprint) {
+    if (!Analyzed) return true;
+    Fingerprint = evidenceSiteFingerprint(D, Definition, USRCache);
+    EmittedForVirtual = false;
+    return !Fingerprint || !Analyzed->contains(*Fingerprint, Previous);
+  };
+
+  for (const auto* Decl : Sites.Declarations) {
+    if (Filter && !Filter(*Decl)) continue;
+    std::optional<uint64_t> Fingerprint;
+    if (!ToAnalyze(*Decl, /*Definition=*/false, Fingerprint)) continue;
+    collectEvidenceFromTargetDeclaration(*Decl, SiteEmitter, Pragmas);
+    if (Fingerprint && !EmittedForVirtual)
+      Analyzed->insert(*Fingerprint, /*Consulted=*/{}, Previous);
+  }
+  EvidenceDeduplicator Deduplicator(SiteEmitter);
+  llvm::DenseSet<SlotFingerprint> Consulted;
+  PreviousInferences DefinitionPrevious = Previous;
+  if (Analyzed) DefinitionPrevious.Consulted = &Consulted;
+  for (const auto* Impl : Sites.Definitions) {
+    if (Filter && !Filter(*Impl)) continue;
+    std::optional<uint64_t> Fingerprint;
+    if (!ToAnalyze(*Impl, /*Definition=*/true, Fingerprint)) continue;
+    DefinitionStats* DefStats = Stats ? &Stats->emplace_back() : nullptr;
+    llvm::function_ref<EvidenceEmitter> DefinitionEmitter = SiteEmitter;
+    if (Deduplicate) DefinitionEmitter = Deduplicator;
+    Consulted.clear();
+    bool Failed = false;
+    if (auto Err = collectEvidenceFromDefinition(
+            *Impl, DefinitionEmitter, USRCache, Pragmas, DefinitionPrevious,
+            MakeCachingSolver, DefStats, &TypeCache, WideningThreshold,
+            &ContextPool)) {
+      llvm::errs() << "Error in evidence collection: "
+                   << toString(std::move(Err)) << "\n";
+      Failed = true;
+    }
+    // Evidence from a failed analysis is still emitted, as without
+    // deduplication.
+    if (unsigned Dropped = Deduplicator.flush(); DefStats && Dropped)
+      DefStats->set_deduplicated_evidence(Dropped);
+    if (!Analyzed) continue;
+    if (Previous.Consulted)
+      Previous.Consulted->insert(Consulted.begin(), Consulted.end());
+    // Another TU may complete a failed analysis, e.g. within its limits.
+    if (Fingerprint && !Failed && !EmittedForVirtual)
+      Analyzed->insert(*Fingerprint, Consulted, Previous);
+  }
+}
+
+llvm::Expected<std::vector<Inference>> inferTUInParallel(
+    unsigned Workers,
+    llvm::function_ref<void(unsigned Worker, TUAnalyzer)> ParseTU,
+    unsigned Iterations, std::vector<DefinitionStats>* Stats,
+    unsigned WideningThreshold, const RoundCheckpoints& Checkpoints) {
+  if (Workers == 0) Workers = 1;
+  if (Iterations == 0) Iterations = 1;
+  if (Checkpoints.Resume && firstIteration(Checkpoints) >= Iterations)
+    return *Checkpoints.Resume;
+  ShardedRounds Rounds(Workers);
+  std::vector<std::vector<DefinitionStats>> WorkerStats(Workers);
+  // Whether each worker got an AST. (Not a `std::vector<bool>`, whose elements
+  // can't be written from different threads.)
+  std::vector<char> Parsed(Workers, false);
+
+  auto RunWorker = [&](unsigned Worker) {
+    bool Analyzed = false;
+    ParseTU(Worker, [&](ASTContext& Ctx, const NullabilityPragmas& Pragmas,
+                        llvm::function_ref<bool(const Decl&)> Filter) {
+      Parsed[Worker] = true;
+      if (Analyzed || !isCPlusPlus(Ctx)) return;
+      Analyzed = true;
+      InferenceManager(Ctx, Iterations, Filter, Pragmas,
+                       Stats ? &WorkerStats[Worker] : nullptr,
+                       WideningThreshold, Checkpoints, /*BottomUp=*/false,
+                       Worker, Workers)
+          .iterativelyInfer(
+              [&](SymbolPartials Partials) -> const std::vector<Inference>& {
+                return Rounds.exchange(Worker, std::move(Partials));
+              });
+    });
+    // Other workers wait on every round, so take part even without an AST.
+    if (!Analyzed)
+      for (unsigned Iteration = firstIteration(Checkpoints);
+           Iteration < Iterations; ++Iteration)
+        Rounds.exchange(Worker, {});
+  };
+
+  std::vector<std::thread> Threads;
+  for (unsigned Worker = 1; Worker < Workers; ++Worker)
+    Threads.emplace_back(RunWorker, Worker);
+  RunWorker(0);
+  for (auto& Thread : Threads) Thread.join();
+  for (unsigned Worker = 0; Worker < Workers; ++Worker) {
+    if (!Parsed[Worker])
+      return llvm::createStringError(
+          llvm::inconvertibleErrorCode(),
+          "worker " + std::to_string(Worker) +
+              " could not parse the translation unit, so the evidence of its "
+              "share is missing");
+  }
+  if (Stats)
+    for (auto& One : WorkerStats)
+      Stats->insert(Stats->end(), std::make_move_iterator(One.begin()),
+                    std::make_move_iterator(One.end()));
+  return std::move(Rounds).takeResult();
 }
 
 }  // namespace clang::tidy::nullability
@@ -7,14 +7,33 @@
 
 #include <vector>
 
+#include "nullability/inference/collect_evidence.h"
 #include "nullability/inference/inference.proto.h"
 #include "nullability/pragma.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclBase.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/Support/Error.h"
 
 namespace clang::tidy::nullability {
-struct EvidenceSites;
+
+// Saves and restores the state between rounds of inference, so that a long
+// run that is interrupted can resume after its last completed round rather
+// than start again.
+//
+// The state is the inferences formed at the end of the round. The evidence
+// collected from each definition is not saved, so the first resumed round
+// analyzes every definition again, but the results are the same as those of
+// an uninterrupted run.
+struct RoundCheckpoints {
+  // If set, called with the inferences formed by each round that is run.
+  llvm::function_ref<void(unsigned Iteration, llvm::ArrayRef<Inference>)> Save;
+  // If set, the inferences saved from round `ResumeAfter` of an earlier run on
+  // the same inputs. That round and those before it are not run again.
+  const std::vector<Inference> *Resume = nullptr;
+  unsigned ResumeAfter = 0;
+};
 
 // Performs nullability inference within the scope of a single translation unit.
 //
@@ -23,9 +42,86 @@ struct EvidenceSites;
 // It also lets us write tests for the whole inference system.
 //
 // If Filter is provided, only considers decls that return true.
+// If Stats is provided, a DefinitionStats is appended to it for each analysis
+// of a definition, in every round.
+// WideningThreshold is passed to collectEvidenceFromDefinition.
+//
+// Checkpoints, if provided, save each round's inferences or resume a run from
+// a saved round.
+//
+// If BottomUp is set, definitions are analyzed callees first, by the TU's call
+// graph, and the slots of each are decided from the evidence so far before its
+// callers are analyzed. Facts then travel up a call chain within a round rather
+// than a call per round, so fewer Iterations reach the same inferences.
 std::vector<Inference> inferTU(
     ASTContext &, const NullabilityPragmas &, unsigned Iterations = 1,
-    llvm::function_ref<bool(const Decl &)> Filter = nullptr);
+    llvm::function_ref<bool(const Decl &)> Filter = nullptr,
+    std::vector<DefinitionStats> *Stats = nullptr,
+    unsigned WideningThreshold = 0, const RoundCheckpoints &Checkpoints = {},
+    bool BottomUp = false);
+
+// Runs inference over one worker's copy of the translation unit.
+// The Filter, if provided, must only be used on this worker's thread.
+using TUAnalyzer = llvm::function_ref<void(
+    ASTContext &, const NullabilityPragmas &,
+    llvm::function_ref<bool(const Decl &)> Filter)>;
+
+// Performs the same inference as inferTU, with evidence collection sharded
+// across `Workers` threads.
+//
+// The AST is not safe to share between threads, so each worker analyzes its
+// own parse of the translation unit. `ParseTU(Worker, Analyze)` is called
+// once on each worker's thread (worker 0 runs on the calling thread), and
+// should parse the TU and pass the result to `Analyze`. If parsing fails, it
+// may return without calling `Analyze`. The other workers still finish their
+// rounds, but the result is then an error, as the inferences would lack the
+// evidence of the failed worker's share of the TU.
+//
+// Evidence sites are assigned to workers by a hash of their USR, so that the
+// assignment agrees between the separate parses. Each worker collects into
+// its own buffer, and the buffers are merged in worker order after every
+// round.
+//
+// Stats are gathered as for inferTU, and are grouped by worker.
+llvm::Expected<std::vector<Inference>> inferTUInParallel(
+    unsigned Workers, llvm::function_ref<void(unsigned Worker, TUAnalyzer)>,
+    unsigned Iterations = 1, std::vector<DefinitionStats> *Stats = nullptr,
+    unsigned WideningThreshold = 0, const RoundCheckpoints &Checkpoints = {});
+
+// Collects the evidence from all evidence sites in the translation unit, as the
+// first round of inferTU does, and passes each piece to `Emit` rather than
+// merging it.
+//
+// This is the "map" step of inference across many TUs: each TU's evidence is
+// written out (e.g. as an evidence shard), and is merged with the others' later
+// (see merge_main). `Previous` holds the inferences of an earlier round, if
+// any. Filter, Stats and WideningThreshold are as for inferTU.
+//
+// If Deduplicate is set, repeated evidence from each definition is emitted once
+// (see EvidenceDeduplicator).
+//
+// SharedUSRs, if provided, spares generating the USRs of header declarations
+// that other TUs have already needed.
+//
+// Analyzed, if provided, skips the header declarations and definitions whose
+// evidence other TUs have already emitted, and records those whose evidence
+// this TU emits. It must only be shared by TUs whose evidence is merged
+// together. Sites whose evidence is propagated to the overrides of virtual
+// methods, which depend on the TU, are never skipped.
+//
+// MakeSolver supplies the solvers for the definitions, e.g. to record their
+// expensive queries (see SolverCorpusRecorder). Results are cached across the
+// TU's definitions.
+void collectTUEvidence(
+    ASTContext &, const NullabilityPragmas &,
+    llvm::function_ref<void(const Evidence &)> Emit,
+    PreviousInferences Previous = {},
+    llvm::function_ref<bool(const Decl &)> Filter = nullptr,
+    std::vector<DefinitionStats> *Stats = nullptr,
+    unsigned WideningThreshold = 0, bool Deduplicate = false,
+    SharedUSRCache *SharedUSRs = nullptr,
+    AnalyzedDefinitions *Analyzed = nullptr,
+    const SolverFactory &MakeSolver = makeDefaultSolverForInference);
 
 }  // namespace clang::tidy::nullability
 
@@ -6,21 +6,60 @@
 //
 // By default (-diagnostics=1) it shows findings as diagnostics.
 // It can optionally (-protos=1) print the Inference proto.
+// With -metrics=1 (the default) it summarizes the results and the cost of
+// analyzing each definition; -stats-protos=1 prints the DefinitionStats protos.
+//
+// With -jobs=N, evidence collection is split across N threads, each of which
+// parses its own copy of the TU.
+//
+// In batch runs over many TUs, the macro replacements header (and commonly
+// included project headers) can be precompiled once and reused:
+//
+//   infer_tu_main -emit-preamble=p.pch -preamble-headers=base.h,util.h a.cc
+//   infer_tu_main -preamble=p.pch -preamble-headers=base.h,util.h a.cc b.cc
+//
+// The preamble is compiled with the flags of the one given TU, and can only be
+// used by TUs with compatible flags. The same -preamble-headers must be passed
+// when it is used, as clang checks that its inputs are unchanged. Preamble
+// headers must not contain `#pragma nullability`, as pragmas are only recorded
+// as they are parsed.
+//
+// With -checkpoint-dir, the inferences of each round are saved, so that a long
+// multi-round run that is interrupted can be restarted from the last saved
+// round with -resume-after:
+//
+//   infer_tu_main -iterations=6 -checkpoint-dir=ckpt a.cc
+//   infer_tu_main -iterations=6 -checkpoint-dir=ckpt -resume-after=3 a.cc
+//
+// Each round is saved as USR-sorted inference shards (see inference_shards.h),
+// with SlotFingerprintIndexes of its Nullable and Nonnull inferences beside
+// them, for use as previous inferences by collect_evidence_main.
 //
 // This is not the intended way to fully analyze a real codebase.
 // e.g. it can't jointly inspect all callsites of a function (in different TUs).
+// For that, collect evidence from each TU with collect_evidence_main, and merge
+// it with merge_main.
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
+#include <system_error>
 #include <utility>
+#include <vector>
 
 #include "absl/base/nullability.h"
 #include "absl/log/check.h"
 #include "absl/strings/str_cat.h"
 #include "nullability/inference/ctn_replacement_macros.h"
+#include "nullability/inference/fingerprint_index.h"
 #include "nullability/inference/infer_tu.h"
 #include "nullability/inference/inference.proto.h"
+#include "nullability/inference/inference_shards.h"
 #include "nullability/inference/replace_macros.h"
+#include "nullability/inference/slot_fingerprint.h"
 #include "nullability/pragma.h"
 #include "nullability/type_nullability.h"
 #include "clang/AST/ASTConsumer.h"
@@ -29,7 +68,9 @@
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/Basic/LLVM.h"
 #include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/Diagnostic.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/Index/USRGeneration.h"
@@ -38,16 +79,22 @@
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/Regex.h"
+#include "llvm/Support/VirtualFileSystem.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 
 using ::clang::tidy::nullability::ReplacementMacrosHeaderFileName;
 
@@ -72,6 +119,16 @@ llvm::cl::opt<bool> PrintMetrics{
     llvm::cl::desc("Print inference metrics"),
     llvm::cl::init(true),
 };
+llvm::cl::opt<bool> PrintStatsProtos{
+    "stats-protos",
+    llvm::cl::desc("Print the DefinitionStats proto of each analysis"),
+    llvm::cl::init(false),
+};
+llvm::cl::opt<unsigned> SlowestDefinitions{
+    "slowest",
+    llvm::cl::desc("Number of slowest definitions to list (requires -metrics)"),
+    llvm::cl::init(5),
+};
 llvm::cl::opt<bool> IncludeTrivial{
     "trivial",
     llvm::cl::desc("Include trivial inferences (annotated, no conflicts)"),
@@ -92,10 +149,60 @@ llvm::cl::opt<unsigned> Iterations{
     llvm::cl::desc("Number of inference iterations"),
     llvm::cl::init(1),
 };
+llvm::cl::opt<unsigned> WidenAfter{
+    "widen-after",
+    llvm::cl::desc("Widen the null state of pointers that change in a loop to "
+                   "Top after this many visits to the loop head (0: never)"),
+    llvm::cl::init(0),
+};
+llvm::cl::opt<unsigned> Jobs{
+    "jobs",
+    llvm::cl::desc("Number of threads to collect evidence on. Each thread "
+                   "parses its own copy of the input"),
+    llvm::cl::init(1),
+};
+llvm::cl::opt<bool> BottomUp{
+    "bottom-up",
+    llvm::cl::desc("Analyze definitions callees first, deciding each one's "
+                   "slots before its callers' analysis (ignored with -jobs)"),
+    llvm::cl::init(false),
+};
+llvm::cl::opt<std::string> CheckpointDir{
+    "checkpoint-dir",
+    llvm::cl::desc("Directory to save the inferences of each round in, so that "
+                   "an interrupted run can be resumed"),
+};
+llvm::cl::opt<int> ResumeAfter{
+    "resume-after",
+    llvm::cl::desc("Resume a run after this round (counting from 0), whose "
+                   "inferences were saved in -checkpoint-dir"),
+    llvm::cl::init(-1),
+};
+
+llvm::cl::opt<std::string> EmitPreamble{
+    "emit-preamble",
+    llvm::cl::desc("Instead of running inference, write a precompiled header "
+                   "of the macro replacements and -preamble-headers here"),
+};
+llvm::cl::list<std::string> PreambleHeaders{
+    "preamble-headers",
+    llvm::cl::desc("Headers to precompile with -emit-preamble, as written in "
+                   "#include directives (without quotes)"),
+    llvm::cl::CommaSeparated,
+};
+llvm::cl::opt<std::string> Preamble{
+    "preamble",
+    llvm::cl::desc("Precompiled header written by -emit-preamble, to use in "
+                   "place of the macro replacements header"),
+};
 
 namespace clang::tidy::nullability {
 namespace {
 
+// The main file of the preamble, which includes the -preamble-headers.
+constexpr llvm::StringRef PreambleHeaderFileName =
+    "clang_tidy_nullability_preamble.h";
+
 // Walks the AST looking for declarations of symbols we inferred.
 // When it finds them, prints the inference as diagnostics.
 class DiagnosticPrinter : public RecursiveASTVisitor<DiagnosticPrinter> {
@@ -210,21 +317,274 @@ struct DeclFilter {
   };
 };
 
+// Installs the preprocessor hooks that inference relies on.
+bool beginInferenceSourceFile(CompilerInstance &CI,
+                              NullabilityPragmas &Pragmas) {
+  if (!CI.getLangOpts().CPlusPlus) return false;
+  registerPragmaHandler(CI.getPreprocessor(), Pragmas);
+  CI.getPreprocessor().addPPCallbacks(std::make_unique<ReplaceMacrosCallbacks>(
+      CI.getPreprocessor(), /*ReplacementsInPreamble=*/!Preamble.empty()));
+  return true;
+}
+
+// Precompiles the macro replacements header and the -preamble-headers, for use
+// with -preamble.
+class PreambleAction : public GeneratePCHAction {
+  NullabilityPragmas Pragmas;
+
+  bool BeginInvocation(CompilerInstance &CI) override {
+    CI.getFrontendOpts().OutputFile = EmitPreamble;
+    return GeneratePCHAction::BeginInvocation(CI);
+  }
+
+  bool BeginSourceFileAction(CompilerInstance &CI) override {
+    return GeneratePCHAction::BeginSourceFileAction(CI) &&
+           beginInferenceSourceFile(CI, Pragmas);
+  }
+
+  void EndSourceFileAction() override {
+    GeneratePCHAction::EndSourceFileAction();
+    // The pragmas wouldn't be recorded for TUs using the preamble.
+    if (!Pragmas.empty()) {
+      DiagnosticsEngine &Diags = getCompilerInstance().getDiagnostics();
+      Diags.Report(Diags.getCustomDiagID(
+          DiagnosticsEngine::Error,
+          "preamble headers must not contain '#pragma nullability'"));
+    }
+  }
+};
+
+// Compiles the preamble header in place of the TU's main file, with its flags.
+tooling::ArgumentsAdjuster compilePreambleInstead() {
+  return [](const tooling::CommandLineArguments &Args,
+            llvm::StringRef Filename) {
+    tooling::CommandLineArguments Result;
+    bool Replaced = false;
+    for (const auto &Arg : Args) {
+      if (Arg == Filename) {
+        Result.push_back("-xc++-header");
+        Result.push_back(std::string(PreambleHeaderFileName));
+        Replaced = true;
+      } else {
+        Result.push_back(Arg);
+      }
+    }
+    if (!Replaced) {
+      llvm::errs() << Filename << ": not found in its compile command\n";
+      // Fail with "no input files" rather than precompile the TU itself.
+      Result.resize(std::min<size_t>(Result.size(), 1));
+    }
+    return Result;
+  };
+}
+
+std::string preambleHeaderText() {
+  std::string Text;
+  for (const auto &Header : PreambleHeaders)
+    Text += "#include \"" + Header + "\"\n";
+  return Text;
+}
+
+// Parses the TU again on a worker thread, and runs `Analyze` on the result.
+// ASTs cannot be shared between threads, so each worker needs its own.
+void parseForWorker(const CompilerInvocation &Invocation,
+                    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> VFS,
+                    TUAnalyzer Analyze) {
+  class WorkerAction : public SyntaxOnlyAction {
+    TUAnalyzer Analyze;
+    NullabilityPragmas Pragmas;
+
+   public:
+    WorkerAction(TUAnalyzer Analyze) : Analyze(Analyze) {}
+
+   private:
+    absl::Nonnull<std::unique_ptr<ASTConsumer>> CreateASTConsumer(
+        CompilerInstance &, llvm::StringRef) override {
+      class Consumer : public ASTConsumer {
+       public:
+        TUAnalyzer Analyze;
+        NullabilityPragmas &Pragmas;
+        Consumer(TUAnalyzer Analyze, NullabilityPragmas &Pragmas)
+            : Analyze(Analyze), Pragmas(Pragmas) {}
+
+       private:
+        void HandleTranslationUnit(ASTContext &Ctx) override {
+          Analyze(Ctx, Pragmas, DeclFilter());
+        }
+      };
+      return std::make_unique<Consumer>(Analyze, Pragmas);
+    }
+
+    bool BeginSourceFileAction(clang::CompilerInstance &CI) override {
+      return ASTFrontendAction::BeginSourceFileAction(CI) &&
+             beginInferenceSourceFile(CI, Pragmas);
+    }
+  };
+
+  CompilerInstance CI;
+  CI.setInvocation(std::make_shared<CompilerInvocation>(Invocation));
+  // The main parse already reported any diagnostics.
+  CI.createDiagnostics(new IgnoringDiagConsumer(), /*ShouldOwnClient=*/true);
+  CI.createFileManager(std::move(VFS));
+  WorkerAction Action(Analyze);
+  CI.ExecuteAction(Action);
+}
+
+// The path of the checkpoint of round `Iteration` of inference on `File`.
+std::string checkpointPath(llvm::StringRef File, unsigned Iteration) {
+  llvm::SmallString<256> Path(CheckpointDir);
+  llvm::sys::path::append(
+      Path, llvm::sys::path::stem(File) + "-" +
+                llvm::utohexstr(llvm::xxh3_64bits(File), /*LowerCase=*/true) +
+                ".round" + llvm::Twine(Iteration));
+  return std::string(Path);
+}
+
+void writeFile(llvm::StringRef Path, llvm::StringRef Contents) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  QCHECK(!EC) << Path.str() << ": " << EC.message();
+  OS << Contents;
+}
+
+void saveCheckpoint(llvm::StringRef File, unsigned Iteration,
+                    llvm::ArrayRef<Inference> Results) {
+  std::string Path = checkpointPath(File, Iteration);
+  std::vector<SlotFingerprint> Nullable, Nonnull;
+  for (const auto &I : Results) {
+    SymbolFingerprinter Fingerprint(I.symbol().usr());
+    for (const auto &Slot : I.slot_inference()) {
+      if (Slot.trivial() || Slot.conflict()) continue;
+      if (Slot.nullability() == Nullability::NULLABLE)
+        Nullable.push_back(Fingerprint(Slot.slot()));
+      else if (Slot.nullability() == Nullability::NONNULL)
+        Nonnull.push_back(Fingerprint(Slot.slot()));
+    }
+  }
+  writeFile(Path + ".nullable",
+            SlotFingerprintIndex::serialize(std::move(Nullable)));
+  writeFile(Path + ".nonnull",
+            SlotFingerprintIndex::serialize(std::move(Nonnull)));
+
+  // One TU's inferences fit in one shard.
+  InferenceShards Shards =
+      shardInferences(std::vector<Inference>(Results.begin(), Results.end()),
+                      std::numeric_limits<unsigned>::max());
+  for (unsigned I = 0; I < Shards.Shards.size(); ++I)
+    writeFile(inferenceShardPath(Path, I, Shards.Shards.size()),
+              Shards.Shards[I]);
+  // The index is written last, so that a checkpoint interrupted while being
+  // written is not read.
+  writeFile(Path, Shards.Index.SerializeAsString());
+}
+
+std::vector<Inference> loadCheckpoint(llvm::StringRef File,
+                                      unsigned Iteration) {
+  std::string Path = checkpointPath(File, Iteration);
+  llvm::Expected<InferenceShardReader> Reader =
+      InferenceShardReader::open(Path);
+  QCHECK(Reader) << Path << ": " << toString(Reader.takeError());
+  std::vector<Inference> Results;
+  llvm::Error Err =
+      Reader->forEach([&](const Inference &I) { Results.push_back(I); });
+  QCHECK(!Err) << Path << ": " << toString(std::move(Err));
+  return Results;
+}
+
+// Summarizes the cost of analyzing definitions, and lists the slowest.
+void printDefinitionMetrics(llvm::ArrayRef<DefinitionStats> Stats) {
+  uint64_t TotalMicros = 0;
+  uint64_t SolverCalls = 0;
+  uint64_t ForcedWidenings = 0;
+  uint64_t PeakArenaAtoms = 0;
+  unsigned ReachedLimit = 0;
+  unsigned Failed = 0;
+  for (const auto &S : Stats) {
+    TotalMicros += S.wall_time_micros();
+    SolverCalls += S.solver_calls();
+    ForcedWidenings += S.forced_widenings();
+    PeakArenaAtoms = std::max(PeakArenaAtoms, S.arena_atoms());
+    if (S.reached_sat_limit()) ++ReachedLimit;
+    if (S.failed()) ++Failed;
+  }
+  llvm::outs() << "Analyzed " << Stats.size() << " definitions in "
+               << llvm::format("%0.3f", TotalMicros / 1e6) << "s\n";
+  llvm::outs() << "Solver calls: " << SolverCalls << "\n";
+  llvm::outs() << "Reached SAT limit: " << ReachedLimit << "\n";
+  llvm::outs() << "Failed (including at the SAT limit): " << Failed << "\n";
+  llvm::outs() << "Converged: " << Stats.size() - Failed << "\n";
+  llvm::outs() << "Forced widenings: " << ForcedWidenings << "\n";
+  llvm::outs() << "Peak arena atoms: " << PeakArenaAtoms << "\n";
+
+  std::vector<const DefinitionStats *> Slowest;
+  for (const auto &S : Stats) Slowest.push_back(&S);
+  unsigned N = std::min<size_t>(SlowestDefinitions, Slowest.size());
+  std::partial_sort(Slowest.begin(), Slowest.begin() + N, Slowest.end(),
+                    [](const DefinitionStats *A, const DefinitionStats *B) {
+                      return A->wall_time_micros() > B->wall_time_micros();
+                    });
+  for (const DefinitionStats *S : llvm::ArrayRef(Slowest).take_front(N)) {
+    llvm::outs() << llvm::format("%10.3f", S->wall_time_micros() / 1e3)
+                 << "ms  blocks=" << S->cfg_blocks()
+                 << " transfers=" << S->transferred_elements()
+                 << " solver=" << S->solver_calls()
+                 << " atoms=" << S->arena_atoms()
+                 << (S->reached_sat_limit() ? " SAT-LIMIT" : "") << "  "
+                 << S->symbol().usr() << "\n";
+  }
+}
+
 class Action : public SyntaxOnlyAction {
   NullabilityPragmas Pragmas;
+  std::shared_ptr<CompilerInvocation> Invocation;
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> VFS;
 
   absl::Nonnull<std::unique_ptr<ASTConsumer>> CreateASTConsumer(
-      CompilerInstance &, llvm::StringRef) override {
+      CompilerInstance &, llvm::StringRef InFile) override {
     class Consumer : public ASTConsumer {
      public:
-      NullabilityPragmas &Pragmas;
-      Consumer(NullabilityPragmas &Pragmas) : Pragmas(Pragmas) {}
+      Action &Parent;
+      std::string File;
+      Consumer(Action &Parent, llvm::StringRef File)
+          : Parent(Parent), File(File) {}
 
      private:
+      std::vector<Inference> infer(ASTContext &Ctx,
+                                   std::vector<DefinitionStats> *Stats) {
+        auto Save = [&](unsigned Iteration, llvm::ArrayRef<Inference> Results) {
+          saveCheckpoint(File, Iteration, Results);
+        };
+        std::vector<Inference> Resumed;
+        RoundCheckpoints Checkpoints;
+        if (!CheckpointDir.empty()) Checkpoints.Save = Save;
+        if (ResumeAfter >= 0) {
+          Resumed = loadCheckpoint(File, ResumeAfter);
+          Checkpoints.Resume = &Resumed;
+          Checkpoints.ResumeAfter = ResumeAfter;
+        }
+
+        if (Jobs <= 1)
+          return inferTU(Ctx, Parent.Pragmas, Iterations, DeclFilter(), Stats,
+                         WidenAfter, Checkpoints, BottomUp);
+        llvm::Expected<std::vector<Inference>> Results = inferTUInParallel(
+            Jobs,
+            [&](unsigned Worker, TUAnalyzer Analyze) {
+              if (Worker == 0)
+                Analyze(Ctx, Parent.Pragmas, DeclFilter());
+              else
+                parseForWorker(*Parent.Invocation, Parent.VFS, Analyze);
+            },
+            Iterations, Stats, WidenAfter, Checkpoints);
+        QCHECK(Results) << File << ": " << toString(Results.takeError());
+        return *std::move(Results);
+      }
+
       void HandleTranslationUnit(ASTContext &Ctx) override {
         llvm::errs() << "Running inference...\n";
 
-        auto Results = inferTU(Ctx, Pragmas, Iterations, DeclFilter());
+        std::vector<DefinitionStats> Stats;
+        bool WantStats = PrintMetrics || PrintStatsProtos;
+        auto Results = infer(Ctx, WantStats ? &Stats : nullptr);
         if (!IncludeTrivial)
           llvm::erase_if(Results, [](Inference &I) {
             llvm::erase_if(
@@ -234,6 +594,8 @@ class Action : public SyntaxOnlyAction {
           });
         if (PrintProtos)
           for (const auto &I : Results) llvm::outs() << absl::StrCat(I) << "\n";
+        if (PrintStatsProtos)
+          for (const auto &S : Stats) llvm::outs() << absl::StrCat(S) << "\n";
         if (PrintMetrics) {
           unsigned Nonnull = 0;
           unsigned Nullable = 0;
@@ -269,22 +631,25 @@ class Action : public SyntaxOnlyAction {
                                                     (Nonnull + Nullable +
                                                      Unknown + Conflict))
                        << "%\n";
+          printDefinitionMetrics(Stats);
         }
         if (Diagnostics)
           DiagnosticPrinter(Results, Ctx.getDiagnostics()).TraverseAST(Ctx);
       }
     };
-    return std::make_unique<Consumer>(Pragmas);
+    return std::make_unique<Consumer>(*this, InFile);
   }
 
   bool BeginSourceFileAction(clang::CompilerInstance &CI) override {
     if (!ASTFrontendAction::BeginSourceFileAction(CI) ||
-        !CI.getLangOpts().CPlusPlus)
+        !beginInferenceSourceFile(CI, Pragmas))
       return false;
 
-    registerPragmaHandler(CI.getPreprocessor(), Pragmas);
-    CI.getPreprocessor().addPPCallbacks(
-        std::make_unique<ReplaceMacrosCallbacks>(CI.getPreprocessor()));
+    if (Jobs > 1) {
+      // Workers reparse from the same invocation and (virtual) files.
+      Invocation = std::make_shared<CompilerInvocation>(CI.getInvocation());
+      VFS = CI.getFileManager().getVirtualFileSystemPtr();
+    }
     return true;
   }
 };
@@ -305,14 +670,42 @@ int main(int argc, absl::Nonnull<const char **> argv) {
 
   clang::tidy::nullability::enableSmartPointers(true);
 
+  QCHECK(ResumeAfter < 0 || !CheckpointDir.empty())
+      << "-resume-after requires -checkpoint-dir";
+  QCHECK(EmitPreamble.empty() || Preamble.empty())
+      << "-emit-preamble and -preamble are exclusive";
+  // Disable warnings, test cases are full of unused expressions etc.
+  std::vector<std::string> ExtraArgs = {"-w"};
+  if (Preamble.empty()) {
+    // Include the file containing macro replacements that enable additional
+    // inference.
+    ExtraArgs.push_back("-include");
+    ExtraArgs.push_back(std::string(ReplacementMacrosHeaderFileName));
+  } else {
+    // The preamble starts with the macro replacements.
+    ExtraArgs.push_back("-include-pch");
+    ExtraArgs.push_back(Preamble);
+  }
+  // The preamble's main file is checked when it is used, so is needed in both
+  // modes.
+  if (!EmitPreamble.empty() || !Preamble.empty())
+    (*Exec)->mapVirtualFile(clang::tidy::nullability::PreambleHeaderFileName,
+                            clang::tidy::nullability::preambleHeaderText());
+  ArgumentsAdjuster Adjuster =
+      getInsertArgumentAdjuster(ExtraArgs, ArgumentInsertPosition::BEGIN);
+
+  if (!EmitPreamble.empty()) {
+    auto Err = (*Exec)->execute(
+        newFrontendActionFactory<clang::tidy::nullability::PreambleAction>(),
+        combineAdjusters(
+            Adjuster, clang::tidy::nullability::compilePreambleInstead()));
+    // Don't leave a preamble that may be incomplete.
+    if (Err) llvm::sys::fs::remove(EmitPreamble);
+    QCHECK(!Err) << toString(std::move(Err));
+    return 0;
+  }
+
   auto Err = (*Exec)->execute(
-      newFrontendActionFactory<clang::tidy::nullability::Action>(),
-      getInsertArgumentAdjuster(
-          {// Disable warnings, test cases are full of unused expressions etc.
-           "-w",
-           // Include the file containing macro replacements that enable
-           // additional inference.
-           "-include", std::string(ReplacementMacrosHeaderFileName)},
-          ArgumentInsertPosition::BEGIN));
+      newFrontendActionFactory<clang::tidy::nullability::Action>(), Adjuster);
   QCHECK(!Err) << toString(std::move(Err));
 }
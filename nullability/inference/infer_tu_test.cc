@@ -4,11 +4,18 @@
 
 #include "nullability/inference/infer_tu.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "nullability/inference/augmented_test_inputs.h"
+#include "nullability/inference/collect_evidence.h"
 #include "nullability/inference/inference.proto.h"
+#include "nullability/inference/merge.h"
 #include "nullability/pragma.h"
 #include "nullability/proto_matchers.h"
 #include "nullability/type_nullability.h"
@@ -19,8 +26,11 @@
 #include "clang/Basic/LLVM.h"
 #include "clang/Index/USRGeneration.h"
 #include "clang/Testing/TestAST.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Testing/Support/Error.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
 
@@ -30,6 +40,7 @@ using ast_matchers::hasName;
 using testing::_;
 using testing::ElementsAre;
 using testing::IsSupersetOf;
+using testing::SizeIs;
 using testing::UnorderedElementsAre;
 
 test::EnableSmartPointers Enable;
@@ -487,6 +498,318 @@ TEST_F(InferTUTest, IterationsPropagateInferences) {
                     {inferredSlot(1, Nullability::NONNULL)})));
 }
 
+TEST_F(InferTUTest, BottomUpPropagatesInferencesInFewerIterations) {
+  build(R"cc(
+    void takesToBeNonnull(int* x) { *x; }
+    int* returnsToBeNonnull(int* a) { return a; }
+    int* target(int* p, int* q, int* r) {
+      *p;
+      takesToBeNonnull(q);
+      q = r;
+      return returnsToBeNonnull(p);
+    }
+  )cc");
+  auto InferBottomUp = [&](unsigned Iterations) {
+    return inferTU(AST->context(), Pragmas, Iterations, nullptr, nullptr,
+                   /*WideningThreshold=*/0, /*Checkpoints=*/{},
+                   /*BottomUp=*/true);
+  };
+  // takesToBeNonnull is analyzed first, so `q` is passed to a Nonnull
+  // parameter already in the first round.
+  EXPECT_THAT(
+      InferBottomUp(1),
+      UnorderedElementsAre(
+          inference(hasName("target"), {inferredSlot(0, Nullability::UNKNOWN),
+                                        inferredSlot(1, Nullability::NONNULL),
+                                        inferredSlot(2, Nullability::NONNULL)}),
+          inference(hasName("returnsToBeNonnull"),
+                    {inferredSlot(0, Nullability::UNKNOWN),
+                     inferredSlot(1, Nullability::UNKNOWN)}),
+          inference(hasName("takesToBeNonnull"),
+                    {inferredSlot(1, Nullability::NONNULL)})));
+  // The fixpoint that takes four rounds in definition order.
+  EXPECT_THAT(
+      InferBottomUp(3),
+      UnorderedElementsAre(
+          inference(hasName("target"), {inferredSlot(0, Nullability::NONNULL),
+                                        inferredSlot(1, Nullability::NONNULL),
+                                        inferredSlot(2, Nullability::NONNULL),
+                                        inferredSlot(3, Nullability::NONNULL)}),
+          inference(hasName("returnsToBeNonnull"),
+                    {inferredSlot(0, Nullability::NONNULL),
+                     inferredSlot(1, Nullability::NONNULL)}),
+          inference(hasName("takesToBeNonnull"),
+                    {inferredSlot(1, Nullability::NONNULL)})));
+}
+
+TEST_F(InferTUTest, DefinitionStats) {
+  build(R"cc(
+    void takesToBeNonnull(int* x) { *x; }
+    void target(int* p) {
+      if (p) takesToBeNonnull(p);
+    }
+  )cc");
+  std::vector<DefinitionStats> Stats;
+  inferTU(AST->context(), Pragmas, /*Iterations=*/2, nullptr, &Stats);
+  std::vector<DefinitionStats> FirstRound;
+  for (const auto &S : Stats)
+    if (S.iteration() == 0) FirstRound.push_back(S);
+  ASSERT_THAT(FirstRound, SizeIs(2));
+  for (const auto &S : FirstRound) {
+    EXPECT_THAT(S.symbol().usr(), testing::StartsWith("c:@F@"));
+    EXPECT_GT(S.cfg_blocks(), 0);
+    EXPECT_GT(S.transferred_elements(), 0);
+    EXPECT_FALSE(S.reached_sat_limit());
+    EXPECT_FALSE(S.failed());
+  }
+  // Checking `p` for null and passing it on both need the solver.
+  auto Target = llvm::find_if(FirstRound, [](const DefinitionStats &S) {
+    return S.symbol().usr() == "c:@F@target#*I#";
+  });
+  ASSERT_NE(Target, FirstRound.end());
+  EXPECT_GT(Target->solver_calls(), 0);
+}
+
+TEST_F(InferTUTest, ResumeFromCheckpoint) {
+  build(R"cc(
+    void takesToBeNonnull(int* x) { *x; }
+    int* returnsToBeNonnull(int* a) { return a; }
+    int* target(int* p, int* q, int* r) {
+      *p;
+      takesToBeNonnull(q);
+      q = r;
+      return returnsToBeNonnull(p);
+    }
+  )cc");
+  auto Serialize = [](llvm::ArrayRef<Inference> Results) {
+    std::vector<std::string> Serialized;
+    for (const auto& I : Results) Serialized.push_back(I.SerializeAsString());
+    return Serialized;
+  };
+  std::vector<std::vector<Inference>> Saved;
+  auto SaveRound = [&](unsigned Iteration, llvm::ArrayRef<Inference> Results) {
+    EXPECT_EQ(Iteration, Saved.size());
+    Saved.emplace_back(Results.begin(), Results.end());
+  };
+  RoundCheckpoints Save;
+  Save.Save = SaveRound;
+  std::vector<Inference> Uninterrupted =
+      inferTU(AST->context(), Pragmas, /*Iterations=*/4, nullptr, nullptr,
+              /*WideningThreshold=*/0, Save);
+  ASSERT_THAT(Saved, SizeIs(4));
+  EXPECT_EQ(Serialize(Saved.back()), Serialize(Uninterrupted));
+
+  RoundCheckpoints Resume;
+  Resume.Resume = &Saved[1];
+  Resume.ResumeAfter = 1;
+  std::vector<DefinitionStats> Stats;
+  EXPECT_EQ(Serialize(inferTU(AST->context(), Pragmas, /*Iterations=*/4,
+                              nullptr, &Stats, /*WideningThreshold=*/0,
+                              Resume)),
+            Serialize(Uninterrupted));
+  ASSERT_THAT(Stats, testing::Not(testing::IsEmpty()));
+  for (const auto& S : Stats) EXPECT_GE(S.iteration(), 2);
+
+  // Resuming after the last round runs nothing.
+  Resume.Resume = &Saved[3];
+  Resume.ResumeAfter = 3;
+  Stats.clear();
+  EXPECT_EQ(Serialize(inferTU(AST->context(), Pragmas, /*Iterations=*/4,
+                              nullptr, &Stats, /*WideningThreshold=*/0,
+                              Resume)),
+            Serialize(Uninterrupted));
+  EXPECT_THAT(Stats, testing::IsEmpty());
+}
+
+TEST_F(InferTUTest, ParallelWorkersMatchSingleWorker) {
+  llvm::StringRef Code = R"cc(
+    void takesToBeNonnull(int* x) { *x; }
+    int* returnsToBeNonnull(int* a) { return a; }
+    int* target(int* p, int* q, int* r) {
+      *p;
+      takesToBeNonnull(q);
+      q = r;
+      return returnsToBeNonnull(p);
+    }
+    void nullable(int* n) { n = nullptr; }
+  )cc";
+  build(Code);
+  auto Parse = [&](unsigned Worker, TUAnalyzer Analyze) {
+    NullabilityPragmas WorkerPragmas;
+    TestAST WorkerAST(getAugmentedTestInputs(Code, WorkerPragmas));
+    Analyze(WorkerAST.context(), WorkerPragmas, nullptr);
+  };
+  EXPECT_THAT_EXPECTED(
+      inferTUInParallel(/*Workers=*/3, Parse, /*Iterations=*/4),
+      llvm::HasValue(UnorderedElementsAre(
+          inference(hasName("target"), {inferredSlot(0, Nullability::NONNULL),
+                                        inferredSlot(1, Nullability::NONNULL),
+                                        inferredSlot(2, Nullability::NONNULL),
+                                        inferredSlot(3, Nullability::NONNULL)}),
+          inference(hasName("returnsToBeNonnull"),
+                    {inferredSlot(0, Nullability::NONNULL),
+                     inferredSlot(1, Nullability::NONNULL)}),
+          inference(hasName("takesToBeNonnull"),
+                    {inferredSlot(1, Nullability::NONNULL)}),
+          inference(hasName("nullable"),
+                    {inferredSlot(1, Nullability::NULLABLE)}))));
+}
+
+TEST_F(InferTUTest, ParallelWorkerWithoutAST) {
+  llvm::StringRef Code = R"cc(
+    void target(int* p) { *p; }
+  )cc";
+  // The worker whose parse fails still takes part in every round, so the
+  // others finish, but its share of the evidence is missing.
+  auto Parse = [&](unsigned Worker, TUAnalyzer Analyze) {
+    if (Worker == 1) return;
+    NullabilityPragmas WorkerPragmas;
+    TestAST WorkerAST(getAugmentedTestInputs(Code, WorkerPragmas));
+    Analyze(WorkerAST.context(), WorkerPragmas, nullptr);
+  };
+  EXPECT_THAT_EXPECTED(
+      inferTUInParallel(/*Workers=*/2, Parse, /*Iterations=*/2),
+      llvm::FailedWithMessage(testing::HasSubstr("worker 1")));
+}
+
+TEST_F(InferTUTest, CollectedEvidenceMergesToInferences) {
+  build(R"cc(
+    void takesToBeNonnull(int* x) { *x; }
+    void target(int* p, int* q) {
+      takesToBeNonnull(p);
+      q = nullptr;
+    }
+  )cc");
+  PartialsBySymbol Partials;
+  std::vector<DefinitionStats> Stats;
+  collectTUEvidence(
+      AST->context(), Pragmas, [&](const Evidence& E) { Partials.add(E); },
+      /*Previous=*/{}, /*Filter=*/nullptr, &Stats);
+  EXPECT_THAT(Stats, SizeIs(2));
+
+  // Merging the evidence gives the same conclusions as one round of inferTU.
+  auto Summarize = [](const std::vector<Inference>& Results) {
+    std::vector<std::tuple<std::string, uint32_t, Nullability, bool>> Slots;
+    for (const auto& I : Results)
+      for (const auto& Slot : I.slot_inference())
+        Slots.emplace_back(I.symbol().usr(), Slot.slot(), Slot.nullability(),
+                           Slot.conflict());
+    return Slots;
+  };
+  std::vector<Inference> Merged = Partials.finalize();
+  EXPECT_EQ(Summarize(Merged), Summarize(infer()));
+  EXPECT_THAT(Merged, testing::Contains(inference(
+                          hasName("takesToBeNonnull"),
+                          {inferredSlot(1, Nullability::NONNULL)})));
+}
+
+TEST_F(InferTUTest, DeduplicatedEvidenceMergesToSameInferences) {
+  build(R"cc(
+    void target(int* p, int* q, int n) {
+      for (int i = 0; i < n; ++i) *p += *p;
+      *p;
+      q = nullptr;
+      q = nullptr;
+    }
+  )cc");
+  auto Collect = [&](bool Deduplicate, std::vector<DefinitionStats>& Stats) {
+    PartialsBySymbol Partials;
+    unsigned Count = 0;
+    collectTUEvidence(
+        AST->context(), Pragmas,
+        [&](const Evidence& E) {
+          ++Count;
+          Partials.add(E);
+        },
+        /*Previous=*/{}, /*Filter=*/nullptr, &Stats,
+        /*WideningThreshold=*/0, Deduplicate);
+    return std::make_pair(Count, Partials.finalize());
+  };
+  std::vector<DefinitionStats> Stats, DeduplicatedStats;
+  auto [Count, Inferences] = Collect(false, Stats);
+  auto [DeduplicatedCount, DeduplicatedInferences] =
+      Collect(true, DeduplicatedStats);
+
+  EXPECT_LT(DeduplicatedCount, Count);
+  ASSERT_THAT(DeduplicatedStats, SizeIs(1));
+  EXPECT_EQ(DeduplicatedStats.front().deduplicated_evidence(),
+            Count - DeduplicatedCount);
+  EXPECT_FALSE(Stats.front().has_deduplicated_evidence());
+  EXPECT_THAT(DeduplicatedInferences,
+              ElementsAre(inference(
+                  hasName("target"),
+                  {inferredSlot(1, Nullability::NONNULL),
+                   inferredSlot(2, Nullability::NULLABLE)})));
+  ASSERT_THAT(Inferences, SizeIs(1));
+  EXPECT_EQ(DeduplicatedInferences.front().slot_inference_size(),
+            Inferences.front().slot_inference_size());
+  for (int I = 0; I < Inferences.front().slot_inference_size(); ++I)
+    EXPECT_EQ(DeduplicatedInferences.front().slot_inference(I).nullability(),
+              Inferences.front().slot_inference(I).nullability());
+}
+
+TEST_F(InferTUTest, AnalyzedHeaderDefinitionsAreSkippedInOtherTUs) {
+  // Returns the number of pieces of evidence from the header.
+  auto Collect = [](llvm::StringRef Main, PartialsBySymbol& Partials,
+                    AnalyzedDefinitions* Analyzed) {
+    NullabilityPragmas Pragmas;
+    TestInputs Inputs = getAugmentedTestInputs(Main, Pragmas);
+    Inputs.ExtraFiles["inline_definitions.h"] = R"cc(
+      void annotated(int* _Nonnull p);
+      inline void inHeader(int* p) { *p; }
+    )cc";
+    TestAST AST(Inputs);
+    unsigned FromHeader = 0;
+    collectTUEvidence(
+        AST.context(), Pragmas,
+        [&](const Evidence& E) {
+          if (llvm::StringRef(E.location()).contains("inline_definitions.h"))
+            ++FromHeader;
+          Partials.add(E);
+        },
+        /*Previous=*/{}, /*Filter=*/nullptr, /*Stats=*/nullptr,
+        /*WideningThreshold=*/0, /*Deduplicate=*/false, /*SharedUSRs=*/nullptr,
+        Analyzed);
+    return FromHeader;
+  };
+  llvm::StringRef First = R"cc(
+#include "inline_definitions.h"
+    void first(int* q) {
+      inHeader(q);
+      annotated(q);
+    }
+  )cc";
+  llvm::StringRef Second = R"cc(
+#include "inline_definitions.h"
+    void second(int* r) { inHeader(r); }
+  )cc";
+
+  PartialsBySymbol Unshared;
+  unsigned FromHeader = Collect(First, Unshared, nullptr);
+  EXPECT_GT(FromHeader, 0u);
+  EXPECT_EQ(Collect(Second, Unshared, nullptr), FromHeader);
+
+  AnalyzedDefinitions Analyzed;
+  PartialsBySymbol Shared;
+  EXPECT_EQ(Collect(First, Shared, &Analyzed), FromHeader);
+  EXPECT_EQ(Analyzed.hits(), 0u);
+  EXPECT_EQ(Collect(Second, Shared, &Analyzed), 0u);
+  EXPECT_GE(Analyzed.hits(), 2u);
+
+  auto Nullabilities = [](PartialsBySymbol& Partials) {
+    std::vector<std::tuple<std::string, uint32_t, Nullability>> Slots;
+    for (const auto& I : Partials.finalize())
+      for (const auto& Slot : I.slot_inference())
+        Slots.emplace_back(I.symbol().usr(), Slot.slot(), Slot.nullability());
+    std::sort(Slots.begin(), Slots.end());
+    return Slots;
+  };
+  auto Merged = Nullabilities(Shared);
+  EXPECT_EQ(Merged, Nullabilities(Unshared));
+  EXPECT_THAT(Merged, testing::Contains(testing::FieldsAre(
+                          _, 1, Nullability::NONNULL)));
+}
+
 TEST_F(InferTUTest, Pragma) {
   build(R"cc(
 #pragma nullability file_default nonnull
@@ -4,12 +4,16 @@
 
 #include "nullability/inference/inferable.h"
 
+#include "nullability/ast_context_data.h"
 #include "nullability/type_nullability.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/LLVM.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallBitVector.h"
 
 namespace clang::tidy::nullability {
 
@@ -17,24 +21,7 @@ bool hasInferable(QualType T) {
   return isSupportedPointerType(T.getNonReferenceType());
 }
 
-int countInferableSlots(const Decl& D) {
-  if (const auto* Func = dyn_cast<FunctionDecl>(&D)) {
-    int Slots = 0;
-    if (hasInferable(Func->getReturnType())) ++Slots;
-    for (auto* P : Func->parameters())
-      if (hasInferable(P->getType())) ++Slots;
-    return Slots;
-  }
-  if (const auto* Field = dyn_cast<FieldDecl>(&D)) {
-    return hasInferable(Field->getType()) ? 1 : 0;
-  }
-  if (const auto* Var = dyn_cast<VarDecl>(&D)) {
-    return hasInferable(Var->getType()) ? 1 : 0;
-  }
-  return 0;
-}
-
-bool isInferenceTarget(const Decl& D) {
+static bool computeIsInferenceTarget(const Decl& D) {
   if (const auto* Func = dyn_cast<FunctionDecl>(&D)) {
     return
         // Function templates are in principle inferable.
@@ -83,4 +70,64 @@ bool isInferenceTarget(const Decl& D) {
   return false;
 }
 
+namespace {
+// What is inferable about a declaration, which is the same for all of its
+// redeclarations and doesn't change once it is declared.
+struct InferableInfo {
+  bool IsTarget = false;
+  // Whether each slot is inferable: for a function, the return type and then
+  // each parameter; for a field or variable, its type.
+  llvm::SmallBitVector Slots;
+};
+
+// The InferableInfo of the declarations of a TU, keyed by canonical decl.
+// Computing it walks the declaration's type, and the same declarations are
+// queried many times: when discovering evidence sites, setting up each
+// analysis of a definition that references them and finding eligible ranges.
+struct InferableMemo {
+  llvm::DenseMap<const Decl*, InferableInfo> ByDecl;
+};
+}  // namespace
+
+static InferableInfo computeInfo(const Decl& D) {
+  InferableInfo Info;
+  Info.IsTarget = computeIsInferenceTarget(D);
+  if (const auto* Func = dyn_cast<FunctionDecl>(&D)) {
+    Info.Slots.resize(Func->getNumParams() + 1);
+    Info.Slots[0] = hasInferable(Func->getReturnType());
+    for (auto [I, P] : llvm::enumerate(Func->parameters()))
+      Info.Slots[I + 1] = hasInferable(P->getType());
+  } else if (const auto* Field = dyn_cast<FieldDecl>(&D)) {
+    Info.Slots.resize(1, hasInferable(Field->getType()));
+  } else if (const auto* Var = dyn_cast<VarDecl>(&D)) {
+    Info.Slots.resize(1, hasInferable(Var->getType()));
+  }
+  return Info;
+}
+
+// Returns null for kinds of declarations that are never inference targets.
+static const InferableInfo* getInfo(const Decl& D) {
+  if (!isa<FunctionDecl, FieldDecl, VarDecl>(D)) return nullptr;
+  const Decl* Canonical = D.getCanonicalDecl();
+  auto& Memo = getASTContextData<InferableMemo>(D.getASTContext()).ByDecl;
+  auto [It, Inserted] = Memo.try_emplace(Canonical);
+  if (Inserted) It->second = computeInfo(*Canonical);
+  return &It->second;
+}
+
+int countInferableSlots(const Decl& D) {
+  const InferableInfo* Info = getInfo(D);
+  return Info ? Info->Slots.count() : 0;
+}
+
+bool isInferableSlot(const Decl& D, unsigned Slot) {
+  const InferableInfo* Info = getInfo(D);
+  return Info && Slot < Info->Slots.size() && Info->Slots[Slot];
+}
+
+bool isInferenceTarget(const Decl& D) {
+  const InferableInfo* Info = getInfo(D);
+  return Info && Info->IsTarget;
+}
+
 }  // namespace clang::tidy::nullability
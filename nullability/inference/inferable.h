@@ -13,6 +13,9 @@ namespace clang::tidy::nullability {
 // Are there inferable slots in this type?
 bool hasInferable(QualType T);
 
+// The functions below compute their facts about a declaration once for all of
+// its redeclarations, and remember them for the lifetime of its ASTContext.
+
 /// Should we attempt to deduce nullability for this symbol?
 bool isInferenceTarget(const Decl &);
 
@@ -22,6 +25,11 @@ bool isInferenceTarget(const Decl &);
 /// inner nullability, we may support only inferring outer.
 int countInferableSlots(const clang::Decl &);
 
+/// Whether slot `Slot` of this symbol's type can be inferred: for a function,
+/// slot 0 is the return type and slot I + 1 is parameter I; for a field or
+/// variable, slot 0 is its type.
+bool isInferableSlot(const clang::Decl &, unsigned Slot);
+
 }  // namespace clang::tidy::nullability
 
 #endif  // THIRD_PARTY_CRUBIT_NULLABILITY_INFERENCE_INFERRABLE_H_
@@ -255,5 +255,31 @@ TEST(InferableTest, CountInferableSlots) {
   EXPECT_EQ(0, countInferableSlots(lookup("h3", Ctx)));
 }
 
+TEST(InferableTest, IsInferableSlot) {
+  TestAST AST((SmartPointerHeader + R"cc(
+                int* func(int, int*, std::unique_ptr<int>&);
+                int* func(int, int* P, std::unique_ptr<int>& Q) { return P; }
+                int* Field;
+                int NonPtr;
+              )cc")
+                  .str());
+  auto &Ctx = AST.context();
+  auto &Func = *cast<FunctionDecl>(
+      Ctx.getTranslationUnitDecl()->lookup(&Ctx.Idents.get("func")).front());
+  // Slots are shared by redeclarations.
+  for (const FunctionDecl *Redecl : Func.redecls()) {
+    EXPECT_TRUE(isInferenceTarget(*Redecl));
+    EXPECT_EQ(3, countInferableSlots(*Redecl));
+    EXPECT_TRUE(isInferableSlot(*Redecl, 0));
+    EXPECT_FALSE(isInferableSlot(*Redecl, 1));
+    EXPECT_TRUE(isInferableSlot(*Redecl, 2));
+    EXPECT_TRUE(isInferableSlot(*Redecl, 3));
+    EXPECT_FALSE(isInferableSlot(*Redecl, 4));
+  }
+  EXPECT_TRUE(isInferableSlot(lookup("Field", Ctx), 0));
+  EXPECT_FALSE(isInferableSlot(lookup("Field", Ctx), 1));
+  EXPECT_FALSE(isInferableSlot(lookup("NonPtr", Ctx), 0));
+}
+
 }  // namespace
 }  // namespace clang::tidy::nullability
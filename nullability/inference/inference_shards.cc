@@ -0,0 +1,183 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/inference/inference_shards.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nullability/inference/inference.proto.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace clang::tidy::nullability {
+namespace {
+
+llvm::Error malformed(const llvm::Twine &What) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "Malformed inference shards: " + What);
+}
+
+// Parses the inference at `Offset` in `Data`, and advances `Offset` past it.
+llvm::Error readInference(llvm::StringRef Data, uint64_t &Offset,
+                          Inference &Out) {
+  unsigned Length = 0;
+  const char *Error = nullptr;
+  uint64_t Size = llvm::decodeULEB128(Data.bytes_begin() + Offset, &Length,
+                                      Data.bytes_end(), &Error);
+  if (Error) return malformed(Error);
+  Offset += Length;
+  if (Size > Data.size() - Offset) return malformed("inference too long");
+  if (!Out.ParseFromArray(Data.data() + Offset, Size))
+    return malformed("bad Inference");
+  Offset += Size;
+  return llvm::Error::success();
+}
+
+}  // namespace
+
+InferenceShards shardInferences(std::vector<Inference> Inferences,
+                                unsigned ShardSize, unsigned Interval) {
+  ShardSize = std::max(ShardSize, 1u);
+  Interval = std::max(Interval, 1u);
+  llvm::sort(Inferences, [](const Inference &L, const Inference &R) {
+    return llvm::StringRef(L.symbol().usr()) < R.symbol().usr();
+  });
+
+  InferenceShards Result;
+  Result.Index.set_interval(Interval);
+  for (size_t Begin = 0; Begin < Inferences.size(); Begin += ShardSize) {
+    size_t End = std::min(Begin + ShardSize, Inferences.size());
+    auto &Shard = *Result.Index.add_shard();
+    Shard.set_size(End - Begin);
+    std::string &Contents = Result.Shards.emplace_back();
+    llvm::raw_string_ostream OS(Contents);
+    for (size_t I = Begin; I < End; ++I) {
+      if ((I - Begin) % Interval == 0) {
+        auto &Entry = *Shard.add_entry();
+        Entry.set_usr(Inferences[I].symbol().usr());
+        Entry.set_offset(OS.tell());
+      }
+      std::string Bytes = Inferences[I].SerializeAsString();
+      llvm::encodeULEB128(Bytes.size(), OS);
+      OS << Bytes;
+    }
+    OS.flush();
+  }
+  return Result;
+}
+
+std::string inferenceShardPath(llvm::StringRef IndexPath, unsigned Shard,
+                               unsigned NumShards) {
+  std::string Result = IndexPath.str();
+  llvm::raw_string_ostream(Result)
+      << llvm::format("-%05u-of-%05u", Shard, NumShards);
+  return Result;
+}
+
+llvm::Expected<InferenceShardReader> InferenceShardReader::open(
+    llvm::StringRef IndexPath) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> IndexBuffer =
+      llvm::MemoryBuffer::getFile(IndexPath);
+  if (!IndexBuffer) return llvm::errorCodeToError(IndexBuffer.getError());
+  InferenceShardIndex Index;
+  if (!Index.ParseFromArray((*IndexBuffer)->getBufferStart(),
+                            (*IndexBuffer)->getBufferSize()))
+    return malformed("bad index");
+
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> Shards;
+  for (int I = 0; I < Index.shard_size(); ++I) {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Shard =
+        llvm::MemoryBuffer::getFile(
+            inferenceShardPath(IndexPath, I, Index.shard_size()),
+            /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!Shard) return llvm::errorCodeToError(Shard.getError());
+    Shards.push_back(std::move(*Shard));
+  }
+  return fromBuffers(std::move(Index), std::move(Shards));
+}
+
+llvm::Expected<InferenceShardReader> InferenceShardReader::fromBuffers(
+    InferenceShardIndex Index,
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> Shards) {
+  if (Index.interval() == 0) return malformed("no interval");
+  if (Shards.size() != static_cast<size_t>(Index.shard_size()))
+    return malformed("wrong number of shards");
+  // Check what lookup() relies on, so that it needs no bounds checks beyond
+  // those that parsing does anyway.
+  InferenceShardReader Result;
+  for (int I = 0; I < Index.shard_size(); ++I) {
+    const auto &Shard = Index.shard(I);
+    if (Shard.size() == 0 ||
+        static_cast<uint64_t>(Shard.entry_size()) !=
+            (Shard.size() + Index.interval() - 1) / Index.interval())
+      return malformed("shard " + llvm::Twine(I) + " has the wrong entries");
+    for (int E = 0; E < Shard.entry_size(); ++E) {
+      uint64_t Offset = Shard.entry(E).offset();
+      if ((E == 0 ? Offset != 0 : Offset <= Shard.entry(E - 1).offset()) ||
+          Offset >= Shards[I]->getBufferSize())
+        return malformed("shard " + llvm::Twine(I) + " has a bad offset");
+    }
+    Result.Size += Shard.size();
+  }
+  Result.Index = std::move(Index);
+  Result.Shards = std::move(Shards);
+  return Result;
+}
+
+llvm::Expected<std::optional<Inference>> InferenceShardReader::lookup(
+    llvm::StringRef USR) const {
+  // The last shard, and then the last entry, starting at or before USR.
+  auto StartsAtOrBefore = [&](const InferenceShardIndex::Entry &E) {
+    return llvm::StringRef(E.usr()) <= USR;
+  };
+  auto Shard = llvm::partition_point(
+      Index.shard(), [&](const InferenceShardIndex::Shard &S) {
+        return StartsAtOrBefore(S.entry(0));
+      });
+  if (Shard == Index.shard().begin()) return std::nullopt;
+  --Shard;
+  auto Entry = llvm::partition_point(Shard->entry(), StartsAtOrBefore);
+  --Entry;
+
+  llvm::StringRef Data = Shards[Shard - Index.shard().begin()]->getBuffer();
+  uint64_t Offset = Entry->offset();
+  Inference Result;
+  for (unsigned I = 0; I < Index.interval() && Offset < Data.size(); ++I) {
+    if (llvm::Error Err = readInference(Data, Offset, Result))
+      return std::move(Err);
+    int Order = llvm::StringRef(Result.symbol().usr()).compare(USR);
+    if (Order == 0) return Result;
+    if (Order > 0) break;
+  }
+  return std::nullopt;
+}
+
+llvm::Error InferenceShardReader::forEach(
+    llvm::function_ref<void(const Inference &)> Visit) const {
+  Inference I;
+  for (const auto &Shard : Shards) {
+    llvm::StringRef Data = Shard->getBuffer();
+    for (uint64_t Offset = 0; Offset < Data.size();) {
+      if (llvm::Error Err = readInference(Data, Offset, I)) return Err;
+      Visit(I);
+    }
+  }
+  return llvm::Error::success();
+}
+
+}  // namespace clang::tidy::nullability
@@ -0,0 +1,76 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Inference results split into shards sorted by USR, with a sparse index.
+//
+// Later rounds of inference and other tools join inferences against data
+// keyed by USR. Rather than loading every inference into a map, they can
+// merge-join against the shards in order, or look up single symbols.
+//
+// Each shard is a sequence of Inference protos, each preceded by its
+// ULEB128-encoded length (as merge_main writes them), in increasing USR order.
+// The InferenceShardIndex records the USR and offset of the first inference
+// in each shard and of every `interval`th one after it, so a lookup searches
+// the index and then parses at most `interval` inferences of one shard.
+//
+// The shards of an index written to `Path` are in the same directory, at
+// inferenceShardPath(Path, I, N).
+
+#ifndef CRUBIT_NULLABILITY_INFERENCE_INFERENCE_SHARDS_H_
+#define CRUBIT_NULLABILITY_INFERENCE_INFERENCE_SHARDS_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "nullability/inference/inference.proto.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace clang::tidy::nullability {
+
+struct InferenceShards {
+  InferenceShardIndex Index;
+  // The contents of each shard.
+  std::vector<std::string> Shards;
+};
+
+// Sorts `Inferences`, whose USRs must be distinct, and splits them into shards
+// of at most `ShardSize` inferences each.
+InferenceShards shardInferences(std::vector<Inference> Inferences,
+                                unsigned ShardSize, unsigned Interval = 64);
+
+// The path of shard `Shard` of `NumShards` of the index at `IndexPath`.
+std::string inferenceShardPath(llvm::StringRef IndexPath, unsigned Shard,
+                               unsigned NumShards);
+
+// Reads inferences from sharded files, which are memory-mapped.
+class InferenceShardReader {
+ public:
+  // Opens the index at `IndexPath` and its shards.
+  static llvm::Expected<InferenceShardReader> open(llvm::StringRef IndexPath);
+  // Uses shards held in memory, which must match `Index`.
+  static llvm::Expected<InferenceShardReader> fromBuffers(
+      InferenceShardIndex Index,
+      std::vector<std::unique_ptr<llvm::MemoryBuffer>> Shards);
+
+  // Finds the inference for `USR`, if there is one.
+  llvm::Expected<std::optional<Inference>> lookup(llvm::StringRef USR) const;
+  // Calls `Visit` on every inference, in order of USR.
+  llvm::Error forEach(llvm::function_ref<void(const Inference &)> Visit) const;
+
+  size_t size() const { return Size; }
+
+ private:
+  InferenceShardIndex Index;
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> Shards;
+  size_t Size = 0;
+};
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_INFERENCE_INFERENCE_SHARDS_H_
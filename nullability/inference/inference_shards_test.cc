@@ -0,0 +1,119 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/inference/inference_shards.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nullability/inference/inference.proto.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Testing/Support/Error.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+
+namespace clang::tidy::nullability {
+namespace {
+using ::testing::ElementsAre;
+
+Inference inference(llvm::StringRef USR, Nullability N) {
+  Inference I;
+  I.mutable_symbol()->set_usr(USR);
+  auto &Slot = *I.add_slot_inference();
+  Slot.set_slot(0);
+  Slot.set_nullability(N);
+  return I;
+}
+
+llvm::Expected<InferenceShardReader> reader(InferenceShards Shards) {
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> Buffers;
+  for (const std::string &Shard : Shards.Shards)
+    Buffers.push_back(llvm::MemoryBuffer::getMemBufferCopy(Shard));
+  return InferenceShardReader::fromBuffers(std::move(Shards.Index),
+                                           std::move(Buffers));
+}
+
+TEST(InferenceShardsTest, LookupAndForEach) {
+  std::vector<Inference> Inferences;
+  for (llvm::StringRef USR : {"g", "c", "a", "e", "f", "b", "d"})
+    Inferences.push_back(inference(USR, Nullability::NONNULL));
+  InferenceShards Shards =
+      shardInferences(std::move(Inferences), /*ShardSize=*/3, /*Interval=*/2);
+  ASSERT_EQ(Shards.Shards.size(), 3u);
+  std::vector<std::vector<std::string>> EntryUSRs;
+  std::vector<uint64_t> Sizes;
+  for (const auto &Shard : Shards.Index.shard()) {
+    Sizes.push_back(Shard.size());
+    EXPECT_EQ(Shard.entry(0).offset(), 0u);
+    auto &USRs = EntryUSRs.emplace_back();
+    for (const auto &Entry : Shard.entry()) USRs.push_back(Entry.usr());
+  }
+  EXPECT_THAT(Sizes, ElementsAre(3, 3, 1));
+  EXPECT_THAT(EntryUSRs, ElementsAre(ElementsAre("a", "c"),
+                                     ElementsAre("d", "f"), ElementsAre("g")));
+
+  auto Reader = reader(std::move(Shards));
+  ASSERT_THAT_EXPECTED(Reader, llvm::Succeeded());
+  EXPECT_EQ(Reader->size(), 7u);
+  for (llvm::StringRef USR : {"a", "b", "c", "d", "e", "f", "g"}) {
+    llvm::Expected<std::optional<Inference>> Found = Reader->lookup(USR);
+    ASSERT_THAT_EXPECTED(Found, llvm::Succeeded());
+    ASSERT_TRUE(Found->has_value()) << USR.str();
+    EXPECT_EQ((*Found)->SerializeAsString(),
+              inference(USR, Nullability::NONNULL).SerializeAsString());
+  }
+  for (llvm::StringRef USR : {"", "a0", "cc", "z"}) {
+    llvm::Expected<std::optional<Inference>> Found = Reader->lookup(USR);
+    ASSERT_THAT_EXPECTED(Found, llvm::Succeeded());
+    EXPECT_EQ(*Found, std::nullopt) << USR.str();
+  }
+
+  std::vector<std::string> Visited;
+  EXPECT_THAT_ERROR(Reader->forEach([&](const Inference &I) {
+    Visited.push_back(I.symbol().usr());
+  }),
+                    llvm::Succeeded());
+  EXPECT_THAT(Visited, ElementsAre("a", "b", "c", "d", "e", "f", "g"));
+}
+
+TEST(InferenceShardsTest, Empty) {
+  InferenceShards Shards = shardInferences({}, /*ShardSize=*/10);
+  EXPECT_TRUE(Shards.Shards.empty());
+  auto Reader = reader(std::move(Shards));
+  ASSERT_THAT_EXPECTED(Reader, llvm::Succeeded());
+  llvm::Expected<std::optional<Inference>> Found = Reader->lookup("a");
+  ASSERT_THAT_EXPECTED(Found, llvm::Succeeded());
+  EXPECT_EQ(*Found, std::nullopt);
+}
+
+TEST(InferenceShardsTest, Malformed) {
+  InferenceShards Shards = shardInferences(
+      {inference("a", Nullability::NULLABLE)}, /*ShardSize=*/10);
+  InferenceShards Missing = Shards;
+  Missing.Shards.clear();
+  EXPECT_THAT_EXPECTED(reader(std::move(Missing)), llvm::Failed());
+
+  InferenceShards BadOffset = Shards;
+  BadOffset.Index.mutable_shard(0)->mutable_entry(0)->set_offset(1000);
+  EXPECT_THAT_EXPECTED(reader(std::move(BadOffset)), llvm::Failed());
+
+  InferenceShards Truncated = Shards;
+  Truncated.Shards[0].pop_back();
+  auto Reader = reader(std::move(Truncated));
+  ASSERT_THAT_EXPECTED(Reader, llvm::Succeeded());
+  EXPECT_THAT_EXPECTED(Reader->lookup("a"), llvm::Failed());
+}
+
+TEST(InferenceShardsTest, ShardPath) {
+  EXPECT_EQ(inferenceShardPath("out/inferences", 3, 12),
+            "out/inferences-00003-of-00012");
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
@@ -4,36 +4,90 @@
 
 #include "nullability/inference/merge.h"
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <optional>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "nullability/inference/inference.proto.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/xxhash.h"
 
 namespace clang::tidy::nullability {
 namespace {
 
-static void mergeSampleLocations(Partial::SampleLocations &LHS,
-                                 const Partial::SampleLocations &RHS) {
-  static constexpr unsigned Limit = 3;
+// Adds counts, saturating at the largest value rather than wrapping.
+// This is branch-free so that loops over arrays of counts vectorize.
+static uint32_t addCounts(uint32_t L, uint32_t R) {
+  uint32_t Sum = L + R;
+  return Sum | -static_cast<uint32_t>(Sum < L);
+}
+
+// Orders the locations kept by hash: by hash, then by text to break ties.
+static std::pair<uint64_t, llvm::StringRef> sampleKey(llvm::StringRef Loc) {
+  return {llvm::xxh3_64bits(Loc), Loc};
+}
+
+static void addSampleLocation(Partial::SampleLocations &Samples,
+                              const std::string &Loc,
+                              SampleReservoir Reservoir) {
+  auto &Locations = *Samples.mutable_location();
+  if (!Reservoir.ByHash && Locations.size() >= Reservoir.Size) return;
   // We don't care which we pick, but they should be unique.
   // Multiple instantiations of the same template are not interesting.
-  for (const auto &Loc : RHS.location()) {
-    if (LHS.location_size() >= Limit) break;
-    // Linear scan is fine because Limit is tiny.
-    if (!llvm::is_contained(LHS.location(), Loc)) LHS.add_location(Loc);
+  // Linear scan is fine because the reservoir is tiny.
+  if (llvm::is_contained(Locations, Loc)) return;
+  if (!Reservoir.ByHash) {
+    Samples.add_location(Loc);
+    return;
   }
+
+  // The locations are kept sorted by key, so the last is evicted first.
+  auto Key = sampleKey(Loc);
+  if (Locations.size() >= Reservoir.Size) {
+    if (Reservoir.Size == 0 ||
+        !(Key < sampleKey(Locations.Get(Locations.size() - 1))))
+      return;
+    Locations.RemoveLast();
+  }
+  Samples.add_location(Loc);
+  for (int I = Locations.size() - 1;
+       I > 0 && Key < sampleKey(Locations.Get(I - 1)); --I)
+    Locations.SwapElements(I, I - 1);
 }
 
 static void mergeSlotPartials(Partial::SlotPartial &LHS,
-                              const Partial::SlotPartial &RHS) {
-  for (auto [Kind, Count] : RHS.kind_count())
-    (*LHS.mutable_kind_count())[Kind] += Count;
-  for (const auto &[Kind, Samples] : RHS.kind_samples())
-    mergeSampleLocations((*LHS.mutable_kind_samples())[Kind], Samples);
+                              const Partial::SlotPartial &RHS,
+                              SampleReservoir Samples) {
+  for (auto [Kind, Count] : RHS.kind_count()) {
+    uint32_t &LHSCount = (*LHS.mutable_kind_count())[Kind];
+    LHSCount = addCounts(LHSCount, Count);
+  }
+  if (Samples.Size == 0) return;
+  for (const auto &[Kind, RHSSamples] : RHS.kind_samples()) {
+    auto &LHSSamples = (*LHS.mutable_kind_samples())[Kind];
+    for (const auto &Loc : RHSSamples.location())
+      addSampleLocation(LHSSamples, Loc, Samples);
+  }
+}
+
+static void addEvidence(Partial &P, const Evidence &E,
+                        SampleReservoir Samples) {
+  // We want to update P.slot[E.slot], so populate previous slots.
+  while (P.slot_size() <= E.slot()) P.add_slot();
+  auto &S = *P.mutable_slot(E.slot());
+  uint32_t &Count = (*S.mutable_kind_count())[E.kind()];
+  Count = addCounts(Count, 1);
+  if (E.has_location() && Samples.Size > 0)
+    addSampleLocation((*S.mutable_kind_samples())[E.kind()], E.location(),
+                      Samples);
 }
 
 }  // namespace
@@ -41,21 +95,165 @@ static void mergeSlotPartials(Partial::SlotPartial &LHS,
 Partial partialFromEvidence(const Evidence &E) {
   Partial P;
   *P.mutable_symbol() = E.symbol();
-  // We want to set P.slot[E.slot], so populate previous slots.
-  while (P.slot_size() < E.slot()) P.add_slot();
-  auto *S = P.add_slot();
-  ++(*S->mutable_kind_count())[E.kind()];
-  if (E.has_location())
-    (*S->mutable_kind_samples())[E.kind()].add_location(E.location());
+  addEvidence(P, E, {});
   return P;
 }
 
-void mergePartials(Partial &LHS, const Partial &RHS) {
+void mergePartials(Partial &LHS, const Partial &RHS, SampleReservoir Samples) {
   CHECK_EQ(LHS.symbol().usr(), RHS.symbol().usr());
   auto *Slots = LHS.mutable_slot();
   while (RHS.slot_size() > Slots->size()) Slots->Add();
   for (unsigned I = 0; I < RHS.slot_size(); ++I)
-    mergeSlotPartials(*LHS.mutable_slot(I), RHS.slot(I));
+    mergeSlotPartials(*LHS.mutable_slot(I), RHS.slot(I), Samples);
+}
+
+void PartialsBySymbol::add(const Evidence &E) {
+  auto [It, Inserted] = Partials.try_emplace(E.symbol().usr());
+  if (Inserted) *It->second.mutable_symbol() = E.symbol();
+  addEvidence(It->second, E, Samples);
+}
+
+void PartialsBySymbol::add(Partial P) {
+  auto [It, Inserted] = Partials.try_emplace(P.symbol().usr());
+  if (Inserted)
+    It->second = std::move(P);
+  else
+    mergePartials(It->second, P, Samples);
+}
+
+void PartialsBySymbol::addAll(PartialsBySymbol Other) {
+  for (auto &Entry : Other.Partials) add(std::move(Entry.getValue()));
+}
+
+CompactPartial::CompactPartial(const Partial &P) {
+  resize(P.slot_size());
+  for (unsigned I = 0; I < P.slot_size(); ++I) {
+    uint32_t *Counts = &Slots[I * NumKinds];
+    for (auto [Kind, Count] : P.slot(I).kind_count()) {
+      if (Kind >= NumKinds) continue;  // From a newer version of the enum.
+      Counts[Kind] = addCounts(Counts[Kind], Count);
+    }
+  }
+}
+
+void CompactPartial::resize(unsigned SlotCount) {
+  if (SlotCount > slotCount()) Slots.resize(SlotCount * NumKinds);
+}
+
+void CompactPartial::add(const Evidence &E) {
+  resize(E.slot() + 1);
+  uint32_t &Count = Slots[E.slot() * NumKinds + E.kind()];
+  Count = addCounts(Count, 1);
+}
+
+void CompactPartial::merge(const CompactPartial &Other) {
+  resize(Other.slotCount());
+  for (size_t I = 0, N = Other.Slots.size(); I < N; ++I)
+    Slots[I] = addCounts(Slots[I], Other.Slots[I]);
+}
+
+Partial CompactPartial::toPartial(const Symbol &Symbol) const {
+  Partial P;
+  *P.mutable_symbol() = Symbol;
+  for (unsigned I = 0; I < slotCount(); ++I) {
+    auto &KindCount = *P.add_slot()->mutable_kind_count();
+    for (auto [Kind, Count] : llvm::enumerate(counts(I)))
+      if (Count) KindCount[Kind] = Count;
+  }
+  return P;
+}
+
+// Returns pointers to the entries of a StringMap, ordered by key.
+template <typename MapT>
+static auto sortedEntries(MapT &Map) {
+  std::vector<decltype(&*Map.begin())> Entries;
+  Entries.reserve(Map.size());
+  for (auto &Entry : Map) Entries.push_back(&Entry);
+  llvm::sort(Entries, [](const auto *L, const auto *R) {
+    return L->getKey() < R->getKey();
+  });
+  return Entries;
+}
+
+std::vector<Partial> PartialsBySymbol::take() {
+  std::vector<Partial> Result;
+  Result.reserve(Partials.size());
+  for (auto *Entry : sortedEntries(Partials))
+    Result.push_back(std::move(Entry->getValue()));
+  Partials.clear();
+  return Result;
+}
+
+static void setInference(Inference::SlotInference &Slot,
+                         const InferResult &Result) {
+  Slot.set_nullability(Result.Nullability);
+  if (Result.Conflict) Slot.set_conflict(true);
+  if (Result.Trivial) Slot.set_trivial(true);
+}
+
+// Adds the inference for slot I of P to Result, with the sample evidence but
+// not yet the decision.
+static Inference::SlotInference &addSlotInference(Inference &Result,
+                                                  const Partial &P,
+                                                  unsigned I) {
+  auto &Slot = *Result.add_slot_inference();
+  Slot.set_slot(I);
+
+  // Reconstitute samples, if we have them.
+  for (const auto &[Kind, Samples] : P.slot(I).kind_samples()) {
+    for (const auto &Loc : Samples.location()) {
+      auto *Sample = Slot.add_sample_evidence();
+      Sample->set_location(Loc);
+      Sample->set_kind(static_cast<Evidence::Kind>(Kind));
+    }
+  }
+  llvm::stable_sort(*Slot.mutable_sample_evidence(), [&](auto &L, auto &R) {
+    return std::forward_as_tuple(L.kind(), L.location()) <
+           std::forward_as_tuple(R.kind(), R.location());
+  });
+  return Slot;
+}
+
+std::vector<Inference> PartialsBySymbol::finalize() const {
+  // The slots of many symbols are decided together by inferBatch, a block at
+  // a time so that the counts matrix stays in cache.
+  constexpr size_t BlockSize = 1024;
+  constexpr unsigned NumKinds = CompactPartial::NumKinds;
+  std::vector<uint32_t> Counts(NumKinds * BlockSize);
+  std::vector<PackedInferResult> Decisions(BlockSize);
+  // The inferences awaiting decisions, one per column of Counts. These stay
+  // valid as more are added: Result doesn't reallocate, and each SlotInference
+  // is allocated separately.
+  std::vector<Inference::SlotInference *> Pending;
+  Pending.reserve(BlockSize);
+  auto Decide = [&] {
+    // The unused columns of a partial block are all zero, and are ignored.
+    inferBatch(Counts, BlockSize, Decisions);
+    for (auto [Slot, Decision] : llvm::zip(Pending, Decisions))
+      setInference(*Slot, Decision.unpack());
+    Pending.clear();
+    std::fill(Counts.begin(), Counts.end(), 0);
+  };
+
+  std::vector<Inference> Result;
+  Result.reserve(Partials.size());
+  for (const auto *Entry : sortedEntries(Partials)) {
+    const Partial &P = Entry->getValue();
+    Inference &Inferred = Result.emplace_back();
+    *Inferred.mutable_symbol() = P.symbol();
+    for (unsigned I = 0; I < P.slot_size(); ++I) {
+      if (P.slot(I).kind_count_size() == 0) continue;
+      size_t Column = Pending.size();
+      for (auto [Kind, Count] : P.slot(I).kind_count()) {
+        if (Kind >= NumKinds) continue;  // From a newer version of the enum.
+        Counts[Kind * BlockSize + Column] = Count;
+      }
+      Pending.push_back(&addSlotInference(Inferred, P, I));
+      if (Pending.size() == BlockSize) Decide();
+    }
+  }
+  if (!Pending.empty()) Decide();
+  return Result;
 }
 
 // Form nullability conclusions from a set of evidence.
@@ -64,28 +262,26 @@ Inference finalize(const Partial &P) {
   *Result.mutable_symbol() = P.symbol();
   for (unsigned I = 0; I < P.slot_size(); ++I) {
     if (P.slot(I).kind_count_size() == 0) continue;
-    auto &Slot = *Result.add_slot_inference();
-    Slot.set_slot(I);
-
-    // Reconstitute samples, if we have them.
-    for (const auto &[Kind, Samples] : P.slot(I).kind_samples()) {
-      for (const auto &Loc : Samples.location()) {
-        auto *Sample = Slot.add_sample_evidence();
-        Sample->set_location(Loc);
-        Sample->set_kind(static_cast<Evidence::Kind>(Kind));
-      }
-    }
-    llvm::stable_sort(*Slot.mutable_sample_evidence(), [&](auto &L, auto &R) {
-      return std::forward_as_tuple(L.kind(), L.location()) <
-             std::forward_as_tuple(R.kind(), R.location());
-    });
-
+    auto &Slot = addSlotInference(Result, P, I);
     std::array<unsigned, Evidence::Kind_MAX + 1> KindCounts = {};
     for (auto [Kind, Count] : P.slot(I).kind_count()) KindCounts[Kind] = Count;
-    auto Result = infer(KindCounts);
-    Slot.set_nullability(Result.Nullability);
-    if (Result.Conflict) Slot.set_conflict(true);
-    if (Result.Trivial) Slot.set_trivial(true);
+    setInference(Slot, infer(KindCounts));
+  }
+  return Result;
+}
+
+Inference finalize(const Symbol &Symbol, const CompactPartial &P) {
+  Inference Result;
+  *Result.mutable_symbol() = Symbol;
+  for (unsigned I = 0; I < P.slotCount(); ++I) {
+    llvm::ArrayRef<uint32_t> Counts = P.counts(I);
+    if (llvm::all_of(Counts, [](uint32_t Count) { return Count == 0; }))
+      continue;
+    auto &Slot = *Result.add_slot_inference();
+    Slot.set_slot(I);
+    std::array<unsigned, CompactPartial::NumKinds> KindCounts;
+    std::copy(Counts.begin(), Counts.end(), KindCounts.begin());
+    setInference(Slot, infer(KindCounts));
   }
   return Result;
 }
@@ -158,4 +354,121 @@ InferResult infer(llvm::ArrayRef<unsigned> Counts) {
   return {Nullability::UNKNOWN};
 }
 
+namespace {
+// inferBatch tests the kinds of evidence present in a slot as a bitmask, with
+// one bit per kind. The kinds of the mandatory rules have the low bits, in
+// the order that infer() applies the rules, so the lowest bit set is the rule
+// that decides the nullability.
+constexpr std::array<Evidence::Kind, 12> MandatoryKinds = {
+    Evidence::UNCHECKED_DEREFERENCE,
+    Evidence::NULLABLE_ARGUMENT,
+    Evidence::NULLABLE_REFERENCE_ARGUMENT,
+    Evidence::NONNULL_REFERENCE_ARGUMENT,
+    Evidence::ASSIGNED_FROM_NULLABLE,
+    Evidence::NULLABLE_RETURN,
+    Evidence::NULLABLE_REFERENCE_RETURN,
+    Evidence::NONNULL_REFERENCE_RETURN,
+    Evidence::ASSIGNED_TO_NONNULL,
+    Evidence::ASSIGNED_TO_MUTABLE_NULLABLE,
+    Evidence::ABORT_IF_NULL,
+    Evidence::ARITHMETIC,
+};
+constexpr unsigned NumKinds = CompactPartial::NumKinds;
+static_assert(NumKinds <= 32, "kinds of evidence must fit in a mask");
+
+// The bit of each kind in the masks.
+constexpr std::array<uint8_t, NumKinds> KindBits = [] {
+  std::array<uint8_t, NumKinds> Bits = {};
+  std::array<bool, NumKinds> Assigned = {};
+  for (unsigned I = 0; I < MandatoryKinds.size(); ++I) {
+    Bits[MandatoryKinds[I]] = I;
+    Assigned[MandatoryKinds[I]] = true;
+  }
+  uint8_t Next = MandatoryKinds.size();
+  for (unsigned Kind = 0; Kind < NumKinds; ++Kind)
+    if (!Assigned[Kind]) Bits[Kind] = Next++;
+  return Bits;
+}();
+
+constexpr uint32_t bit(Evidence::Kind Kind) {
+  return uint32_t{1} << KindBits[Kind];
+}
+
+constexpr uint32_t MandatoryNonnull =
+    bit(Evidence::UNCHECKED_DEREFERENCE) |
+    bit(Evidence::NONNULL_REFERENCE_ARGUMENT) |
+    bit(Evidence::NONNULL_REFERENCE_RETURN) |
+    bit(Evidence::ASSIGNED_TO_NONNULL) | bit(Evidence::ABORT_IF_NULL) |
+    bit(Evidence::ARITHMETIC);
+constexpr uint32_t MandatoryNullable =
+    bit(Evidence::NULLABLE_ARGUMENT) |
+    bit(Evidence::NULLABLE_REFERENCE_ARGUMENT) |
+    bit(Evidence::ASSIGNED_FROM_NULLABLE) | bit(Evidence::NULLABLE_RETURN) |
+    bit(Evidence::NULLABLE_REFERENCE_RETURN) |
+    bit(Evidence::ASSIGNED_TO_MUTABLE_NULLABLE);
+
+// infer(), for the kinds of evidence present in `Present`.
+// Each rule is computed unconditionally and the results selected, so that this
+// compiles to straight-line code.
+uint8_t decide(uint32_t Present) {
+  using Packed = PackedInferResult;
+  const uint32_t Mandatory = Present & (MandatoryNonnull | MandatoryNullable);
+  const uint32_t First = Mandatory & (0u - Mandatory);
+  const bool MandatoryConflict = ((Present & MandatoryNonnull) != 0) &
+                                 ((Present & MandatoryNullable) != 0);
+  const uint8_t FromMandatory =
+      ((First & MandatoryNonnull) ? Nullability::NONNULL
+                                  : Nullability::NULLABLE) |
+      (MandatoryConflict ? Packed::ConflictBit : 0);
+
+  const bool SoftNonnull =
+      ((Present & bit(Evidence::GCC_NONNULL_ATTRIBUTE)) != 0) |
+      (((Present & (bit(Evidence::NULLABLE_RETURN) |
+                    bit(Evidence::UNKNOWN_RETURN))) == 0) &
+       ((Present & bit(Evidence::NONNULL_RETURN)) != 0)) |
+      (((Present & (bit(Evidence::NULLABLE_ARGUMENT) |
+                    bit(Evidence::UNKNOWN_ARGUMENT))) == 0) &
+       ((Present & bit(Evidence::NONNULL_ARGUMENT)) != 0));
+  const uint8_t FromSoft =
+      SoftNonnull ? Nullability::NONNULL
+      : (Present & bit(Evidence::NULLPTR_DEFAULT_MEMBER_INITIALIZER))
+          ? Nullability::NULLABLE
+          : Nullability::UNKNOWN;
+
+  const bool AnnotatedNonnull =
+      (Present & bit(Evidence::ANNOTATED_NONNULL)) != 0;
+  const bool AnnotatedNullable =
+      (Present & bit(Evidence::ANNOTATED_NULLABLE)) != 0;
+  const uint8_t FromAnnotation =
+      (AnnotatedNonnull & AnnotatedNullable)
+          ? (Nullability::UNKNOWN | Packed::ConflictBit)
+          : ((AnnotatedNonnull ? Nullability::NONNULL : Nullability::NULLABLE) |
+             Packed::TrivialBit);
+
+  return (AnnotatedNonnull | AnnotatedNullable) ? FromAnnotation
+         : Mandatory                            ? FromMandatory
+                                                : FromSoft;
+}
+}  // namespace
+
+void inferBatch(llvm::ArrayRef<uint32_t> Counts, size_t NumSlots,
+                llvm::MutableArrayRef<PackedInferResult> Out) {
+  CHECK_EQ(Counts.size(), NumKinds * NumSlots);
+  CHECK_GE(Out.size(), NumSlots);
+  // The masks are built a row of the matrix at a time, for a block of slots
+  // small enough that they stay in registers or L1.
+  constexpr size_t BlockSize = 256;
+  std::array<uint32_t, BlockSize> Present;
+  for (size_t Begin = 0; Begin < NumSlots; Begin += BlockSize) {
+    const size_t N = std::min(BlockSize, NumSlots - Begin);
+    std::fill_n(Present.begin(), N, 0);
+    for (unsigned Kind = 0; Kind < NumKinds; ++Kind) {
+      const uint32_t *Row = &Counts[Kind * NumSlots + Begin];
+      const uint32_t Bit = uint32_t{1} << KindBits[Kind];
+      for (size_t S = 0; S < N; ++S) Present[S] |= Row[S] != 0 ? Bit : 0;
+    }
+    for (size_t S = 0; S < N; ++S) Out[Begin + S].Bits = decide(Present[S]);
+  }
+}
+
 }  // namespace clang::tidy::nullability
@@ -13,19 +13,39 @@
 #ifndef CRUBIT_NULLABILITY_INFERENCE_MERGE_H_
 #define CRUBIT_NULLABILITY_INFERENCE_MERGE_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include "nullability/inference/inference.proto.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
 
 namespace clang::tidy::nullability {
 
+// Bounds the sample locations that a Partial keeps for each slot and kind of
+// evidence. The counts of evidence are exact regardless, so inference doesn't
+// depend on the samples, which are for debugging only.
+struct SampleReservoir {
+  // The most locations kept. 0 keeps none.
+  unsigned Size = 3;
+  // By default the first distinct locations merged in are kept, so which are
+  // kept depends on the order of merging. If set, the locations with the
+  // smallest hashes are kept instead: a pseudo-random sample that is the same
+  // however the evidence is grouped and ordered (e.g. across the reducers of a
+  // mapreduce), for symbols with millions of pieces of evidence.
+  // All partials merged this way must have been built this way, too.
+  bool ByHash = false;
+};
+
 // Build a Partial representing a single piece of evidence.
 Partial partialFromEvidence(const Evidence &);
 // Update LHS to include the evidence from RHS.
 // The two must describe the same symbol.
-// The merging of partials is commutative and associative.
-void mergePartials(Partial &LHS, const Partial &RHS);
+// The merging of partials is commutative and associative (in the samples, too,
+// if they are kept by hash).
+void mergePartials(Partial &LHS, const Partial &RHS,
+                   SampleReservoir Samples = {});
 // Form nullability conclusions from a set of evidence.
 Inference finalize(const Partial &);
 
@@ -38,11 +58,111 @@ struct InferResult {
 // TODO: once this interface sticks, move to a dedicated file.
 InferResult infer(llvm::ArrayRef<unsigned> EventCounts);
 
+// The InferResult of one slot, packed into a byte: the Nullability in the low
+// two bits, then the conflict and trivial bits.
+struct PackedInferResult {
+  static constexpr uint8_t NullabilityMask = 0x3;
+  static constexpr uint8_t ConflictBit = 0x4;
+  static constexpr uint8_t TrivialBit = 0x8;
+
+  uint8_t Bits = 0;
+
+  Nullability nullability() const {
+    return static_cast<Nullability>(Bits & NullabilityMask);
+  }
+  bool conflict() const { return Bits & ConflictBit; }
+  bool trivial() const { return Bits & TrivialBit; }
+  InferResult unpack() const { return {nullability(), conflict(), trivial()}; }
+};
+// The same decisions as infer(), for many slots at once.
+//
+// `Counts` is a matrix of the evidence counts of NumSlots slots, stored by
+// kind: the count of Evidence::Kind K for slot S is Counts[K * NumSlots + S].
+// The decision for slot S is written to Out[S], so Out must hold NumSlots.
+//
+// The rules are evaluated without branches on bitmasks of the kinds present,
+// so the loops over slots vectorize, and deciding costs little more than
+// reading the counts.
+void inferBatch(llvm::ArrayRef<uint32_t> Counts, size_t NumSlots,
+                llvm::MutableArrayRef<PackedInferResult> Out);
+
+// The evidence counts of a Partial, without its symbol or sample locations,
+// in a fixed-width form that is cheap to merge.
+//
+// The counts for each slot are a contiguous array with one counter per
+// Evidence::Kind, and the slots are stored back to back, so merging is an
+// elementwise add over one flat array that the compiler can vectorize.
+// Counters saturate rather than wrapping: inference only depends on which
+// kinds of evidence are present, so a saturated count is never wrong.
+class CompactPartial {
+ public:
+  static constexpr unsigned NumKinds = Evidence::Kind_MAX + 1;
+
+  CompactPartial() = default;
+  explicit CompactPartial(const Partial &);
+
+  // Adds one piece of evidence to the counts, ignoring its symbol.
+  void add(const Evidence &);
+  // Adds the counts from Other. Like mergePartials, this is commutative and
+  // associative, so partials can be combined in any grouping.
+  void merge(const CompactPartial &Other);
+
+  unsigned slotCount() const { return Slots.size() / NumKinds; }
+  // The count of each Evidence::Kind for `Slot`, which must be < slotCount().
+  llvm::ArrayRef<uint32_t> counts(unsigned Slot) const {
+    return llvm::ArrayRef<uint32_t>(Slots).slice(Slot * NumKinds, NumKinds);
+  }
+
+  // Converts back to a Partial for `Symbol`, which has no sample locations.
+  Partial toPartial(const Symbol &Symbol) const;
+
+ private:
+  void resize(unsigned SlotCount);
+
+  // Slots.size() is a multiple of NumKinds.
+  std::vector<uint32_t> Slots;
+};
+// Form nullability conclusions from evidence counts. Like finalize(Partial),
+// but with no sample evidence.
+Inference finalize(const Symbol &, const CompactPartial &);
+
+// Accumulates Partials for many symbols, keyed by USR.
+//
+// Because merging is commutative and associative, evidence can be folded in as
+// it is produced (a map-side "combiner"), and the resulting partials merged
+// again in any grouping (e.g. a tree of reducers) before being finalized.
+// Memory use is proportional to the number of symbols, not pieces of evidence.
+class PartialsBySymbol {
+ public:
+  PartialsBySymbol() = default;
+  explicit PartialsBySymbol(SampleReservoir Samples) : Samples(Samples) {}
+
+  // Folds the evidence into its symbol's partial in place, so that the many
+  // pieces of evidence of a popular symbol each cost a counter increment and
+  // (rarely) an update of the samples.
+  void add(const Evidence &E);
+  void add(Partial P);
+  void addAll(PartialsBySymbol Other);
+
+  // The number of distinct symbols seen.
+  size_t size() const { return Partials.size(); }
+
+  // Returns the partials, ordered by USR. The collection is left empty.
+  std::vector<Partial> take();
+  // Returns an inference for each symbol, ordered by USR.
+  std::vector<Inference> finalize() const;
+
+ private:
+  SampleReservoir Samples;
+  llvm::StringMap<Partial> Partials;
+};
+
 // Combines local evidence about symbol nullability to form a global conclusion.
 // All evidence must for be the same symbol, and there must be some.
 //
 // This signature fundamentally limits the scalability of merging: we must see
-// all the evidence for a symbol at once.
+// all the evidence for a symbol at once. Prefer PartialsBySymbol for large
+// amounts of evidence.
 inline Inference mergeEvidence(llvm::ArrayRef<Evidence> Ev) {
   Partial P = partialFromEvidence(Ev.front());
   for (const auto &E : Ev.drop_front())
@@ -0,0 +1,339 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// merge_main combines evidence or Partials into Partials or Inferences.
+//
+// This is a building block for a distributed reduce: evidence shards from
+// map tasks are folded into Partials, and files of Partials can be merged
+// again in any grouping (e.g. a tree, so that hot symbols are not all merged
+// on one machine), until a final step with -finalize produces Inferences.
+//
+//   merge_main -evidence=a.shard,b.shard -output=ab.partials
+//   merge_main ab.partials cd.partials -finalize -output=inferences
+//
+// With -finalize, -nullable-index and -nonnull-index also write the
+// non-trivial inferences as SlotFingerprintIndex files, for use as
+// PreviousInferences in the next round of inference.
+//
+// With -finalize and -shard-size, the Inferences are instead sorted by USR and
+// split into shards, and -output is their sparse index (see
+// inference_shards.h), so that later steps can join against them by USR.
+//
+// -ranges combines the TypeLocRangesIndex files written by
+// `collect_evidence_main -write-ranges` into one, written to -ranges-output.
+//
+// The inputs are memory-mapped and read by -jobs threads, each folding them
+// into its own Partials, which are combined at the end. For merges whose
+// Partials don't fit in memory, -partitions=N splits the symbols into N groups
+// by a hash of their USR, and merges one group per pass over the inputs, so
+// that only about 1/N of the symbols are held at once:
+//
+//   merge_main *.partials -finalize -partitions=16 -jobs=64 -output=inferences
+//
+// The output is then ordered by USR within each pass rather than overall, and
+// the indexes cover all passes. -partitions can't be used with -shard-size,
+// which sorts all the Inferences together.
+//
+// Files of Partials and Inferences are sequences of binary protos, each
+// preceded by its ULEB128-encoded length.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/nullability.h"
+#include "absl/log/check.h"
+#include "nullability/inference/eligible_ranges.h"
+#include "nullability/inference/evidence_shard.h"
+#include "nullability/inference/fingerprint_index.h"
+#include "nullability/inference/inference.proto.h"
+#include "nullability/inference/inference_shards.h"
+#include "nullability/inference/merge.h"
+#include "nullability/inference/slot_fingerprint.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+llvm::cl::list<std::string> PartialsFiles{
+    llvm::cl::Positional,
+    llvm::cl::desc("<files of Partials>"),
+};
+llvm::cl::list<std::string> EvidenceFiles{
+    "evidence",
+    llvm::cl::desc("Evidence shards to fold in"),
+    llvm::cl::CommaSeparated,
+};
+llvm::cl::opt<std::string> Output{
+    "output",
+    llvm::cl::desc("File to write the merged Partials (or Inferences) to"),
+    llvm::cl::Required,
+};
+llvm::cl::list<std::string> RangesFiles{
+    "ranges",
+    llvm::cl::desc("TypeLocRangesIndex files to merge"),
+    llvm::cl::CommaSeparated,
+};
+llvm::cl::opt<std::string> RangesOutput{
+    "ranges-output",
+    llvm::cl::desc("File to write the merged TypeLocRangesIndex to"),
+};
+llvm::cl::opt<bool> Finalize{
+    "finalize",
+    llvm::cl::desc("Write Inferences rather than Partials"),
+    llvm::cl::init(false),
+};
+llvm::cl::opt<unsigned> ShardSize{
+    "shard-size",
+    llvm::cl::desc("With -finalize, write the Inferences as USR-sorted shards "
+                   "of this many, with -output as their index"),
+    llvm::cl::init(0),
+};
+llvm::cl::opt<unsigned> MaxSamples{
+    "max-samples",
+    llvm::cl::desc("Sample locations to keep for each symbol, slot and kind of "
+                   "evidence (counts are exact regardless)"),
+    llvm::cl::init(3),
+};
+llvm::cl::opt<bool> SamplesByHash{
+    "samples-by-hash",
+    llvm::cl::desc("Keep the sample locations with the smallest hashes, which "
+                   "doesn't depend on the order of the inputs. All -partials "
+                   "must have been merged this way, too"),
+    llvm::cl::init(false),
+};
+llvm::cl::opt<std::string> DecidedIndex{
+    "decided-index",
+    llvm::cl::desc("With -finalize, file to write an index of the slots whose "
+                   "nullability is decided by annotations to"),
+};
+llvm::cl::opt<std::string> NullableIndex{
+    "nullable-index",
+    llvm::cl::desc("With -finalize, file to write an index of the slots "
+                   "inferred Nullable to"),
+};
+llvm::cl::opt<std::string> NonnullIndex{
+    "nonnull-index",
+    llvm::cl::desc("With -finalize, file to write an index of the slots "
+                   "inferred Nonnull to"),
+};
+llvm::cl::opt<unsigned> Jobs{
+    "jobs",
+    llvm::cl::desc("Number of input files to read in parallel (0: one per "
+                   "core)"),
+    llvm::cl::init(0),
+};
+llvm::cl::opt<unsigned> Partitions{
+    "partitions",
+    llvm::cl::desc("Merge the symbols in this many passes over the inputs, "
+                   "each holding a disjoint subset of them in memory"),
+    llvm::cl::init(1),
+};
+
+namespace clang::tidy::nullability {
+namespace {
+
+std::unique_ptr<llvm::MemoryBuffer> readFile(llvm::StringRef Path) {
+  // Without the need for a null terminator, large files are mapped rather
+  // than copied.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buffer =
+      llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  QCHECK(Buffer) << Path.str() << ": " << Buffer.getError().message();
+  return std::move(*Buffer);
+}
+
+// Whether the symbol `USR` is merged in the pass over `Partition`.
+bool inPartition(llvm::StringRef USR, unsigned Partition) {
+  return Partitions <= 1 || llvm::xxh3_64bits(USR) % Partitions == Partition;
+}
+
+void readEvidence(llvm::StringRef Path, unsigned Partition,
+                  PartialsBySymbol &Out) {
+  auto Buffer = readFile(Path);
+  llvm::Error Err =
+      readEvidenceShard(Buffer->getBuffer(), [&](const Evidence &E) {
+        if (inPartition(E.symbol().usr(), Partition)) Out.add(E);
+      });
+  QCHECK(!Err) << Path.str() << ": " << toString(std::move(Err));
+}
+
+void readPartials(llvm::StringRef Path, unsigned Partition,
+                  PartialsBySymbol &Out) {
+  auto Buffer = readFile(Path);
+  const uint8_t *Pos = Buffer->getBuffer().bytes_begin();
+  const uint8_t *End = Buffer->getBuffer().bytes_end();
+  while (Pos != End) {
+    unsigned Length = 0;
+    const char *Error = nullptr;
+    uint64_t Size = llvm::decodeULEB128(Pos, &Length, End, &Error);
+    QCHECK(!Error) << Path.str() << ": " << Error;
+    Pos += Length;
+    QCHECK_LE(Size, static_cast<uint64_t>(End - Pos)) << Path.str();
+    Partial P;
+    QCHECK(P.ParseFromArray(Pos, Size)) << Path.str() << ": bad Partial";
+    Pos += Size;
+    if (inPartition(P.symbol().usr(), Partition)) Out.add(std::move(P));
+  }
+}
+
+// Reads the evidence and Partials of the symbols in `Partition` from all the
+// inputs, spread across -jobs threads.
+PartialsBySymbol readInputs(unsigned Partition) {
+  struct Input {
+    llvm::StringRef Path;
+    bool IsEvidence;
+  };
+  std::vector<Input> Inputs;
+  for (const auto &Path : EvidenceFiles) Inputs.push_back({Path, true});
+  for (const auto &Path : PartialsFiles) Inputs.push_back({Path, false});
+
+  unsigned Workers = Jobs ? Jobs : std::thread::hardware_concurrency();
+  if (Workers > Inputs.size()) Workers = Inputs.size();
+  if (Workers == 0) Workers = 1;
+  std::vector<PartialsBySymbol> WorkerPartials;
+  for (unsigned W = 0; W < Workers; ++W)
+    WorkerPartials.emplace_back(
+        SampleReservoir{.Size = MaxSamples, .ByHash = SamplesByHash});
+  std::atomic<size_t> Next = 0;
+  auto RunWorker = [&](PartialsBySymbol &Out) {
+    for (size_t I = Next++; I < Inputs.size(); I = Next++) {
+      if (Inputs[I].IsEvidence)
+        readEvidence(Inputs[I].Path, Partition, Out);
+      else
+        readPartials(Inputs[I].Path, Partition, Out);
+    }
+  };
+  std::vector<std::thread> Threads;
+  for (unsigned W = 1; W < Workers; ++W)
+    Threads.emplace_back([&, W] { RunWorker(WorkerPartials[W]); });
+  RunWorker(WorkerPartials[0]);
+  for (auto &Thread : Threads) Thread.join();
+
+  PartialsBySymbol Merged = std::move(WorkerPartials[0]);
+  for (unsigned W = 1; W < Workers; ++W)
+    Merged.addAll(std::move(WorkerPartials[W]));
+  return Merged;
+}
+
+void writeFile(llvm::StringRef Path, llvm::StringRef Contents) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  QCHECK(!EC) << Path.str() << ": " << EC.message();
+  OS << Contents;
+}
+
+void mergeRanges() {
+  TypeLocRangesIndex Merged;
+  for (const auto &Path : RangesFiles) {
+    auto Buffer = readFile(Path);
+    TypeLocRangesIndex Index;
+    QCHECK(Index.ParseFromArray(Buffer->getBufferStart(),
+                                Buffer->getBufferSize()))
+        << Path << ": bad TypeLocRangesIndex";
+    mergeTypeLocRangesIndex(Merged, Index);
+  }
+  writeFile(RangesOutput, Merged.SerializeAsString());
+}
+
+// The slots with non-trivial Nullable/Nonnull inferences, and those with
+// trivial ones, collected over all partitions.
+struct SlotIndexes {
+  std::vector<SlotFingerprint> Nullable, Nonnull, Decided;
+
+  void add(llvm::ArrayRef<Inference> Inferences);
+  // Writes the indexes requested by the flags.
+  void write();
+};
+
+void SlotIndexes::add(llvm::ArrayRef<Inference> Inferences) {
+  for (const auto &I : Inferences) {
+    SymbolFingerprinter Fingerprint(I.symbol().usr());
+    for (const auto &Slot : I.slot_inference()) {
+      if (Slot.conflict()) continue;
+      if (Slot.trivial()) {
+        Decided.push_back(Fingerprint(Slot.slot()));
+        continue;
+      }
+      if (Slot.nullability() == Nullability::NULLABLE)
+        Nullable.push_back(Fingerprint(Slot.slot()));
+      else if (Slot.nullability() == Nullability::NONNULL)
+        Nonnull.push_back(Fingerprint(Slot.slot()));
+    }
+  }
+}
+
+void SlotIndexes::write() {
+  if (!NullableIndex.empty())
+    writeFile(NullableIndex,
+              SlotFingerprintIndex::serialize(std::move(Nullable)));
+  if (!NonnullIndex.empty())
+    writeFile(NonnullIndex, SlotFingerprintIndex::serialize(std::move(Nonnull)));
+  if (!DecidedIndex.empty())
+    writeFile(DecidedIndex,
+              SlotFingerprintIndex::serialize(std::move(Decided)));
+}
+
+template <typename ProtoT>
+void writeDelimited(const ProtoT &Proto, llvm::raw_ostream &OS) {
+  std::string Bytes = Proto.SerializeAsString();
+  llvm::encodeULEB128(Bytes.size(), OS);
+  OS << Bytes;
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
+
+int main(int argc, absl::Nonnull<const char **> argv) {
+  using namespace clang::tidy::nullability;
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  QCHECK(RangesFiles.empty() || !RangesOutput.empty())
+      << "-ranges requires -ranges-output";
+  if (!RangesOutput.empty()) mergeRanges();
+
+  QCHECK(Finalize || ShardSize == 0) << "-shard-size requires -finalize";
+  QCHECK_GE(Partitions, 1u) << "-partitions must be positive";
+  QCHECK(Partitions == 1 || ShardSize == 0)
+      << "-shard-size can't be used with -partitions";
+  SlotIndexes Indexes;
+  if (Finalize && ShardSize) {
+    std::vector<Inference> AllInference = readInputs(0).finalize();
+    Indexes.add(AllInference);
+    Indexes.write();
+    InferenceShards Shards =
+        shardInferences(std::move(AllInference), ShardSize);
+    for (unsigned I = 0; I < Shards.Shards.size(); ++I)
+      writeFile(inferenceShardPath(Output, I, Shards.Shards.size()),
+                Shards.Shards[I]);
+    writeFile(Output, Shards.Index.SerializeAsString());
+    return 0;
+  }
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Output, EC);
+  QCHECK(!EC) << Output << ": " << EC.message();
+  for (unsigned Partition = 0; Partition < Partitions; ++Partition) {
+    PartialsBySymbol Partials = readInputs(Partition);
+    if (Finalize) {
+      std::vector<Inference> Inferences = Partials.finalize();
+      for (const auto &I : Inferences) writeDelimited(I, OS);
+      Indexes.add(Inferences);
+    } else {
+      for (const auto &P : Partials.take()) writeDelimited(P, OS);
+    }
+  }
+  if (Finalize) Indexes.write();
+}
@@ -5,10 +5,17 @@
 #include "nullability/inference/merge.h"
 
 #include <array>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "nullability/inference/inference.proto.h"
 #include "nullability/proto_matchers.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
@@ -89,6 +96,51 @@ TEST(MergeEvidenceTest, MergePartials) {
               )pb"));
 }
 
+// Evidence for one slot and kind of "func", with a distinct location each.
+std::vector<Evidence> evidenceAt(unsigned Count) {
+  std::vector<Evidence> Result;
+  for (unsigned I = 0; I < Count; ++I) {
+    Evidence &E = Result.emplace_back(proto<Evidence>(R"pb(
+      symbol { usr: "func" } slot: 0 kind: NONNULL_ARGUMENT
+    )pb"));
+    E.set_location("loc" + std::to_string(I));
+  }
+  return Result;
+}
+
+TEST(MergeEvidenceTest, SamplesByHashIndependentOfOrder) {
+  static constexpr SampleReservoir Samples = {.Size = 2, .ByHash = true};
+  std::vector<Evidence> Ev = evidenceAt(20);
+
+  PartialsBySymbol Forward(Samples);
+  for (const auto &E : Ev) Forward.add(E);
+  // The same evidence, in reverse and merged as two groups.
+  PartialsBySymbol Odd(Samples), Even(Samples);
+  for (unsigned I = Ev.size(); I-- > 0;) (I % 2 ? Odd : Even).add(Ev[I]);
+  Even.addAll(std::move(Odd));
+
+  std::vector<Partial> ForwardPartials = Forward.take();
+  std::vector<Partial> GroupedPartials = Even.take();
+  ASSERT_EQ(ForwardPartials.size(), 1u);
+  ASSERT_EQ(GroupedPartials.size(), 1u);
+  EXPECT_THAT(GroupedPartials[0],
+              EqualsProto(ForwardPartials[0].DebugString()));
+  const auto &Slot = ForwardPartials[0].slot(0);
+  EXPECT_EQ(Slot.kind_count().at(Evidence::NONNULL_ARGUMENT), 20u);
+  EXPECT_EQ(Slot.kind_samples().at(Evidence::NONNULL_ARGUMENT).location_size(),
+            2);
+}
+
+TEST(MergeEvidenceTest, NoSamples) {
+  PartialsBySymbol Partials(SampleReservoir{.Size = 0});
+  for (const auto &E : evidenceAt(3)) Partials.add(E);
+  Partials.add(partialFromEvidence(evidenceAt(1).front()));
+  EXPECT_THAT(Partials.take(), testing::ElementsAre(EqualsProto(R"pb(
+                symbol { usr: "func" }
+                slot { kind_count { key: 5 value: 4 } }
+              )pb")));
+}
+
 TEST(MergeEvidenceTest, Finalize) {
   EXPECT_THAT(finalize(proto<Partial>(R"pb(
                 symbol { usr: "func" }
@@ -179,6 +231,115 @@ TEST(MergeEvidenceTest, TreeShapedMerge) {
       IsExpected);
 }
 
+TEST(PartialsBySymbolTest, GroupsBySymbol) {
+  PartialsBySymbol Map;
+  Map.add(proto<Evidence>(R"pb(
+    symbol { usr: "b" } slot: 0 kind: ANNOTATED_NULLABLE
+  )pb"));
+  Map.add(proto<Evidence>(R"pb(
+    symbol { usr: "a" } slot: 1 kind: UNCHECKED_DEREFERENCE
+  )pb"));
+  Map.add(proto<Evidence>(R"pb(
+    symbol { usr: "b" } slot: 0 kind: ANNOTATED_NULLABLE
+  )pb"));
+  EXPECT_EQ(Map.size(), 2u);
+
+  // A second level of merging, as a reducer would do.
+  PartialsBySymbol Reduced;
+  Reduced.add(partialFromEvidence(proto<Evidence>(R"pb(
+    symbol { usr: "a" } slot: 1 kind: NULLABLE_ARGUMENT
+  )pb")));
+  Reduced.addAll(std::move(Map));
+
+  EXPECT_THAT(Reduced.finalize(),
+              testing::ElementsAre(EqualsProto(R"pb(
+                                     symbol { usr: "a" }
+                                     slot_inference {
+                                       slot: 1
+                                       nullability: NONNULL
+                                       conflict: true
+                                     }
+                                   )pb"),
+                                   EqualsProto(R"pb(
+                                     symbol { usr: "b" }
+                                     slot_inference {
+                                       slot: 0
+                                       nullability: NULLABLE
+                                       trivial: true
+                                     }
+                                   )pb")));
+
+  std::vector<Partial> Taken = Reduced.take();
+  EXPECT_EQ(Reduced.size(), 0u);
+  ASSERT_EQ(Taken.size(), 2u);
+  EXPECT_EQ(Taken[0].symbol().usr(), "a");
+  EXPECT_THAT(Taken[1], EqualsProto(R"pb(
+                symbol { usr: "b" }
+                slot { kind_count { key: 1 value: 2 } }
+              )pb"));
+}
+
+TEST(CompactPartialTest, MatchesPartials) {
+  auto L = proto<Partial>(R"pb(
+    symbol { usr: "func" }
+    slot {
+      kind_count { key: 1 value: 1 }
+      kind_samples {
+        key: 1
+        value { location: "a" }
+      }
+    }
+    slot { kind_count { key: 3 value: 2 } }
+  )pb");
+  auto R = proto<Partial>(R"pb(
+    symbol { usr: "func" }
+    slot { kind_count { key: 1 value: 2 } }
+    slot {}
+    slot { kind_count { key: 0 value: 1 } }
+  )pb");
+
+  CompactPartial Compact(L);
+  Compact.merge(CompactPartial(R));
+  Compact.add(proto<Evidence>("slot: 4 kind: ANNOTATED_NULLABLE"));
+  Partial Merged = L;
+  mergePartials(Merged, R);
+  mergePartials(Merged, partialFromEvidence(proto<Evidence>(R"pb(
+                  symbol { usr: "func" } slot: 4 kind: ANNOTATED_NULLABLE
+                )pb")));
+
+  EXPECT_EQ(Compact.slotCount(), 5u);
+  EXPECT_THAT(Compact.toPartial(L.symbol()), EqualsProto(R"pb(
+                symbol { usr: "func" }
+                slot { kind_count { key: 1 value: 3 } }
+                slot { kind_count { key: 3 value: 2 } }
+                slot { kind_count { key: 0 value: 1 } }
+                slot {}
+                slot { kind_count { key: 1 value: 1 } }
+              )pb"));
+  // The same conclusions, other than the sample evidence.
+  Inference Expected = finalize(Merged);
+  for (auto &Slot : *Expected.mutable_slot_inference())
+    Slot.clear_sample_evidence();
+  EXPECT_EQ(finalize(L.symbol(), Compact).SerializeAsString(),
+            Expected.SerializeAsString());
+}
+
+TEST(CompactPartialTest, Saturates) {
+  Partial P;
+  (*P.add_slot()->mutable_kind_count())[Evidence::UNCHECKED_DEREFERENCE] =
+      std::numeric_limits<uint32_t>::max() - 1;
+  CompactPartial Compact(P);
+  Compact.merge(CompactPartial(P));
+  Compact.add(proto<Evidence>("slot: 0 kind: UNCHECKED_DEREFERENCE"));
+  EXPECT_EQ(Compact.counts(0)[Evidence::UNCHECKED_DEREFERENCE],
+            std::numeric_limits<uint32_t>::max());
+
+  Partial Copy = P;
+  mergePartials(P, Copy);
+  EXPECT_EQ(P.slot(0).kind_count().at(Evidence::UNCHECKED_DEREFERENCE),
+            std::numeric_limits<uint32_t>::max());
+}
+
 class InferTest : public ::testing::Test {
   std::array<unsigned, Evidence::Kind_MAX + 1> Counts = {};
 
@@ -282,5 +443,67 @@ TEST_F(InferTest, NullableDefaultMemberInitializer) {
   EXPECT_EQ(Nullability::NONNULL, infer());
 }
 
+// Checks inferBatch against infer() for slots with the kinds in each mask.
+void expectBatchMatchesInfer(llvm::ArrayRef<uint32_t> Masks) {
+  constexpr unsigned NumKinds = Evidence::Kind_MAX + 1;
+  const size_t NumSlots = Masks.size();
+  std::vector<uint32_t> Counts(NumKinds * NumSlots);
+  for (size_t S = 0; S < NumSlots; ++S)
+    for (unsigned Kind = 0; Kind < NumKinds; ++Kind)
+      if (Masks[S] & (1u << Kind)) Counts[Kind * NumSlots + S] = Kind + S + 1;
+  std::vector<PackedInferResult> Batch(NumSlots);
+  inferBatch(Counts, NumSlots, Batch);
+
+  for (size_t S = 0; S < NumSlots; ++S) {
+    std::array<unsigned, NumKinds> SlotCounts;
+    for (unsigned Kind = 0; Kind < NumKinds; ++Kind)
+      SlotCounts[Kind] = Counts[Kind * NumSlots + S];
+    InferResult Expected = infer(SlotCounts);
+    InferResult Actual = Batch[S].unpack();
+    EXPECT_EQ(Actual.Nullability, Expected.Nullability) << Masks[S];
+    EXPECT_EQ(Actual.Conflict, Expected.Conflict) << Masks[S];
+    EXPECT_EQ(Actual.Trivial, Expected.Trivial) << Masks[S];
+  }
+}
+
+TEST(InferBatchTest, MatchesInferForEachKindAndPair) {
+  constexpr unsigned NumKinds = Evidence::Kind_MAX + 1;
+  std::vector<uint32_t> Masks = {0};
+  for (unsigned I = 0; I < NumKinds; ++I)
+    for (unsigned J = I; J < NumKinds; ++J)
+      Masks.push_back((1u << I) | (1u << J));
+  expectBatchMatchesInfer(Masks);
+}
+
+TEST(InferBatchTest, MatchesInferForRandomKinds) {
+  // More slots than inferBatch decides at once, and not a multiple of them.
+  std::mt19937 Random(/*seed=*/42);
+  std::vector<uint32_t> Masks(10'007);
+  for (uint32_t &Mask : Masks)
+    Mask = Random() & ((1u << (Evidence::Kind_MAX + 1)) - 1);
+  expectBatchMatchesInfer(Masks);
+}
+
+TEST(InferBatchTest, PartialsBySymbolMatchesFinalize) {
+  PartialsBySymbol BySymbol;
+  std::mt19937 Random(/*seed=*/7);
+  // Enough slots to fill several blocks of decisions.
+  for (int I = 0; I < 3000; ++I) {
+    Evidence E;
+    E.mutable_symbol()->set_usr("symbol" + std::to_string(Random() % 500));
+    E.set_slot(Random() % 4);
+    E.set_kind(
+        static_cast<Evidence::Kind>(Random() % (Evidence::Kind_MAX + 1)));
+    BySymbol.add(E);
+  }
+
+  std::vector<Inference> Batched = BySymbol.finalize();
+  std::vector<Partial> Partials = BySymbol.take();
+  ASSERT_EQ(Batched.size(), Partials.size());
+  for (size_t I = 0; I < Partials.size(); ++I)
+    EXPECT_EQ(Batched[I].SerializeAsString(),
+              finalize(Partials[I]).SerializeAsString());
+}
+
 }  // namespace
 }  // namespace clang::tidy::nullability
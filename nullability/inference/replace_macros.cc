@@ -45,6 +45,24 @@ void ReplaceMacrosCallbacks::FileChanged(SourceLocation Loc,
   }
 }
 
+const clang::MacroDirective *
+ReplaceMacrosCallbacks::findReplacementInPreamble(
+    IdentifierInfo *II, const clang::MacroDirective *MD) {
+  // Replaced macros have a copy, which is defined (if only as a placeholder) by
+  // the replacement macros header.
+  if (II->getName().starts_with(CopyPrefix) ||
+      !PP.isMacroDefined((CopyPrefix + II->getName()).str()))
+    return nullptr;
+  // As the PCH ends with the replacement definition in effect, that is the
+  // definition being overridden.
+  const clang::MacroDirective *Previous = MD->getPrevious();
+  if (!Previous || !Previous->getMacroInfo() ||
+      !Previous->getMacroInfo()->isFromASTFile())
+    return nullptr;
+  Replacements.insert({II, Previous});
+  return Previous;
+}
+
 void ReplaceMacrosCallbacks::MacroDefined(const clang::Token &MacroNameTok,
                                           const clang::MacroDirective *MD) {
   auto *IIForCurrentMacro = MacroNameTok.getIdentifierInfo();
@@ -64,10 +82,12 @@ void ReplaceMacrosCallbacks::MacroDefined(const clang::Token &MacroNameTok,
     return;
   }
 
-  if (auto It = Replacements.find(IIForCurrentMacro);
-      It != Replacements.end()) {
-    const clang::MacroDirective *ReplacementDef = It->second;
-
+  const clang::MacroDirective *ReplacementDef = nullptr;
+  if (auto It = Replacements.find(IIForCurrentMacro); It != Replacements.end())
+    ReplacementDef = It->second;
+  else if (ReplacementsInPreamble)
+    ReplacementDef = findReplacementInPreamble(IIForCurrentMacro, MD);
+  if (ReplacementDef) {
     IdentifierInfo *CopyII =
         PP.getIdentifierInfo((CopyPrefix + IIForCurrentMacro->getName()).str());
 
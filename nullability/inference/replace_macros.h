@@ -29,13 +29,24 @@ constexpr llvm::StringRef ReplacementMacrosHeaderFileName =
 
 class ReplaceMacrosCallbacks : public clang::PPCallbacks {
  public:
-  explicit ReplaceMacrosCallbacks(clang::Preprocessor &PP) : PP(PP) {}
+  // If `ReplacementsInPreamble` is set, the replacement macros header was
+  // instead compiled into a precompiled header (PCH) that the TU uses, so is
+  // never seen by these callbacks. The replacement for a macro is then the
+  // definition it had at the end of the PCH.
+  explicit ReplaceMacrosCallbacks(clang::Preprocessor &PP,
+                                  bool ReplacementsInPreamble = false)
+      : PP(PP), ReplacementsInPreamble(ReplacementsInPreamble) {}
 
  private:
   clang::Preprocessor &PP;
+  bool ReplacementsInPreamble;
   llvm::DenseMap<clang::IdentifierInfo *, const clang::MacroDirective *>
       Replacements;
 
+  // Finds the replacement of a macro being redefined by `MD` after the PCH.
+  const clang::MacroDirective *findReplacementInPreamble(
+      clang::IdentifierInfo *II, const clang::MacroDirective *MD);
+
   enum class State {
     HaveNotSeenReplacementFile,
     InReplacementFile,
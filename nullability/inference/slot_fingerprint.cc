@@ -10,17 +10,49 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/bit.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MD5.h"
+#include "llvm/Support/xxhash.h"
 
 namespace clang::tidy::nullability {
 
-SlotFingerprint fingerprint(llvm::StringRef USR, uint32_t SlotIndex) {
-  // MD5 is an arbitrary choice of hash function.
-  llvm::MD5 Hash;
-  Hash.update(USR);
-  Hash.update(llvm::bit_cast<std::array<uint8_t, 4>>(SlotIndex));
-  llvm::MD5::MD5Result Result;
-  Hash.final(Result);
-  return Result.low();
+SlotFingerprint fingerprint(llvm::StringRef USR, uint32_t SlotIndex,
+                            FingerprintVersion Version) {
+  return SymbolFingerprinter(USR, Version)(SlotIndex);
 }
+
+SymbolFingerprinter::SymbolFingerprinter(llvm::StringRef USR,
+                                         FingerprintVersion Version)
+    : Version(Version) {
+  switch (Version) {
+    case FingerprintVersion::MD5:
+      // MD5 is an arbitrary choice of hash function.
+      USRState.update(USR);
+      break;
+    case FingerprintVersion::XXH3:
+      USRHash = llvm::xxh3_64bits(llvm::arrayRefFromStringRef(USR));
+      break;
+  }
+}
+
+SlotFingerprint SymbolFingerprinter::operator()(uint32_t SlotIndex) const {
+  switch (Version) {
+    case FingerprintVersion::MD5: {
+      llvm::MD5 Hash = USRState;
+      Hash.update(llvm::bit_cast<std::array<uint8_t, 4>>(SlotIndex));
+      llvm::MD5::MD5Result Result;
+      Hash.final(Result);
+      return Result.low();
+    }
+    case FingerprintVersion::XXH3: {
+      std::array<uint8_t, 12> Bytes;
+      llvm::support::endian::write64le(Bytes.data(), USRHash);
+      llvm::support::endian::write32le(Bytes.data() + 8, SlotIndex);
+      return llvm::xxh3_64bits(Bytes);
+    }
+  }
+  llvm_unreachable("unknown FingerprintVersion");
+}
+
 }  // namespace clang::tidy::nullability
@@ -12,6 +12,7 @@
 #include <cstdint>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MD5.h"
 
 namespace clang::tidy::nullability {
 
@@ -22,7 +23,39 @@ namespace clang::tidy::nullability {
 // (we expect ~100M inference targets).
 using SlotFingerprint = uint64_t;
 
-SlotFingerprint fingerprint(llvm::StringRef USR, uint32_t SlotIndex);
+// The hash function used to produce fingerprints. Fingerprints of different
+// versions are unrelated, so stored fingerprints record their version.
+enum class FingerprintVersion : uint32_t {
+  // The low 64 bits of MD5(USR, slot).
+  MD5 = 1,
+  // XXH3-64 of (XXH3-64(USR), slot). Much faster than MD5.
+  XXH3 = 2,
+};
+inline constexpr FingerprintVersion DefaultFingerprintVersion =
+    FingerprintVersion::XXH3;
+
+SlotFingerprint fingerprint(
+    llvm::StringRef USR, uint32_t SlotIndex,
+    FingerprintVersion Version = DefaultFingerprintVersion);
+
+// Produces fingerprints for several slots of one symbol, hashing its USR only
+// once. SymbolFingerprinter(USR)(Slot) == fingerprint(USR, Slot).
+class SymbolFingerprinter {
+ public:
+  explicit SymbolFingerprinter(
+      llvm::StringRef USR,
+      FingerprintVersion Version = DefaultFingerprintVersion);
+
+  SlotFingerprint operator()(uint32_t SlotIndex) const;
+
+ private:
+  FingerprintVersion Version;
+  // The hash state after consuming the USR, for MD5.
+  llvm::MD5 USRState;
+  // The hash of the USR, for XXH3.
+  uint64_t USRHash = 0;
+};
+
 }  // namespace clang::tidy::nullability
 
 #endif  // CRUBIT_NULLABILITY_INFERENCE_SLOT_FINGERPRINT_H_
@@ -4,6 +4,8 @@
 
 #include "nullability/inference/slot_fingerprint.h"
 
+#include <cstdint>
+
 #include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
 
 namespace clang::tidy::nullability {
@@ -19,5 +21,20 @@ TEST(SlotFingerprintTest, ProducesDistinctValue) {
   EXPECT_NE(fingerprint("usr1", 1), fingerprint("usr2", 0));
 }
 
+TEST(SlotFingerprintTest, VersionsDiffer) {
+  EXPECT_NE(fingerprint("usr1", 1, FingerprintVersion::MD5),
+            fingerprint("usr1", 1, FingerprintVersion::XXH3));
+  EXPECT_NE(fingerprint("usr1", 1, FingerprintVersion::MD5),
+            fingerprint("usr1", 0, FingerprintVersion::MD5));
+}
+
+TEST(SlotFingerprintTest, SymbolFingerprinterMatchesFingerprint) {
+  for (auto Version : {FingerprintVersion::MD5, FingerprintVersion::XXH3}) {
+    SymbolFingerprinter Fingerprinter("usr1", Version);
+    for (uint32_t Slot = 0; Slot < 4; ++Slot)
+      EXPECT_EQ(Fingerprinter(Slot), fingerprint("usr1", Slot, Version));
+  }
+}
+
 }  // namespace
 }  // namespace clang::tidy::nullability
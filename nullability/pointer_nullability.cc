@@ -109,8 +109,8 @@ static bool tryCreatePointerNullState(
     absl::Nullable<const Formula *> FromNullable = nullptr,
     absl::Nullable<const Formula *> IsNull = nullptr) {
   if (hasPointerNullState(PointerVal)) return false;
-  if (!FromNullable) FromNullable = &A.makeAtomRef(A.makeAtom());
-  if (!IsNull) IsNull = &A.makeAtomRef(A.makeAtom());
+  if (!FromNullable) FromNullable = &A.makeAtomRef(makeNullabilityAtom(A));
+  if (!IsNull) IsNull = &A.makeAtomRef(makeNullabilityAtom(A));
   PointerVal.setProperty(kFromNullable, A.makeBoolValue(*FromNullable));
   PointerVal.setProperty(kNull, A.makeBoolValue(*IsNull));
   return true;
@@ -5,6 +5,7 @@
 #include "nullability/pointer_nullability_analysis.h"
 
 #include <cassert>
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <optional>
@@ -13,12 +14,14 @@
 
 #include "absl/base/nullability.h"
 #include "absl/log/check.h"
+#include "nullability/ast_context_data.h"
 #include "nullability/ast_helpers.h"
 #include "nullability/macro_arg_capture.h"
 #include "nullability/pointer_nullability.h"
 #include "nullability/pointer_nullability_lattice.h"
 #include "nullability/pointer_nullability_matchers.h"
 #include "nullability/pragma.h"
+#include "nullability/stmt_class_match_switch.h"
 #include "nullability/type_nullability.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
@@ -31,6 +34,7 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/Analysis/CFG.h"
+#include "clang/Analysis/FlowSensitive/ASTOps.h"
 #include "clang/Analysis/FlowSensitive/Arena.h"
 #include "clang/Analysis/FlowSensitive/CFGMatchSwitch.h"
 #include "clang/Analysis/FlowSensitive/DataflowAnalysis.h"
@@ -43,8 +47,11 @@
 #include "clang/Basic/Builtins.h"
 #include "clang/Basic/IdentifierTable.h"
 #include "clang/Basic/LLVM.h"
+#include "clang/Basic/LangOptions.h"
 #include "clang/Basic/OperatorKinds.h"
+#include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/Specifiers.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Debug.h"
@@ -55,8 +62,8 @@ namespace clang::tidy::nullability {
 using ast_matchers::anyOf;
 using ast_matchers::MatchFinder;
 using dataflow::Arena;
+using dataflow::Atom;
 using dataflow::BoolValue;
-using dataflow::CFGMatchSwitchBuilder;
 using dataflow::ComparisonResult;
 using dataflow::DataflowAnalysisContext;
 using dataflow::Environment;
@@ -74,7 +81,9 @@ using dataflow::WidenResult;
 namespace {
 
 TypeNullability prepend(NullabilityKind Head, const TypeNullability &Tail) {
-  TypeNullability Result = {Head};
+  TypeNullability Result;
+  Result.reserve(Tail.size() + 1);
+  Result.push_back(Head);
   Result.insert(Result.end(), Tail.begin(), Tail.end());
   return Result;
 }
@@ -331,9 +340,9 @@ absl::Nullable<PointerValue *> unpackPointerValue(StorageLocation &PointerLoc,
   auto &A = Env.getDataflowAnalysisContext().arena();
 
   if (NullState.FromNullable == nullptr)
-    NullState.FromNullable = &A.makeAtomRef(A.makeAtom());
+    NullState.FromNullable = &A.makeAtomRef(makeNullabilityAtom(A));
   if (NullState.IsNull == nullptr)
-    NullState.IsNull = &A.makeAtomRef(A.makeAtom());
+    NullState.IsNull = &A.makeAtomRef(makeNullabilityAtom(A));
 
   auto &NewPointerVal = Env.create<PointerValue>(PointerVal->getPointeeLoc());
   initPointerNullState(NewPointerVal, Env.getDataflowAnalysisContext(),
@@ -921,11 +930,13 @@ void initializeOutputParameter(absl::Nonnull<const Expr *> Arg,
   }
 }
 
-// `D` is declared somewhere in `absl` or `util`, either directly or nested.
-bool isDeclaredInAbseilOrUtil(const Decl &D) {
-  const auto *DC = D.getDeclContext();
-  if (DC == nullptr || DC->isTranslationUnit()) return false;
+// Whether the `DeclContext`s of an `ASTContext` are in `absl` or `util`.
+struct AbseilOrUtilContexts {
+  llvm::DenseMap<const DeclContext *, bool> IsInAbseilOrUtil;
+};
 
+// `DC` is `absl` or `util`, or nested in it.
+bool isAbseilOrUtilContext(const DeclContext *DC) {
   // Find the topmost, non-TU DeclContext.
   const DeclContext *Parent = DC->getParent();
   while (Parent != nullptr && !Parent->isTranslationUnit()) {
@@ -939,6 +950,17 @@ bool isDeclaredInAbseilOrUtil(const Decl &D) {
          (NS->getName() == "absl" || NS->getName() == "util");
 }
 
+// `D` is declared somewhere in `absl` or `util`, either directly or nested.
+bool isDeclaredInAbseilOrUtil(const Decl &D) {
+  const auto *DC = D.getDeclContext();
+  if (DC == nullptr || DC->isTranslationUnit()) return false;
+
+  auto &Contexts = getASTContextData<AbseilOrUtilContexts>(D.getASTContext());
+  auto [It, Inserted] = Contexts.IsInAbseilOrUtil.try_emplace(DC);
+  if (Inserted) It->second = isAbseilOrUtilContext(DC);
+  return It->second;
+}
+
 // Models the `GetReferenceableValue` functions used in Abseil logging and
 // elsewhere.
 void modelGetReferenceableValue(const CallExpr &CE, Environment &Env) {
@@ -1529,7 +1551,8 @@ void transferType_ThisExpr(absl::Nonnull<const CXXThisExpr *> TE,
 }
 
 auto buildTypeTransferer() {
-  return CFGMatchSwitchBuilder<TransferState<PointerNullabilityLattice>>()
+  return StmtClassCFGMatchSwitchBuilder<
+             TransferState<PointerNullabilityLattice>>()
       .CaseOfCFGStmt<DeclRefExpr>(ast_matchers::declRefExpr(),
                                   transferType_DeclRefExpr)
       .CaseOfCFGStmt<MemberExpr>(ast_matchers::memberExpr(),
@@ -1567,7 +1590,8 @@ auto buildValueTransferer() {
   // - and the Expr has a supported pointer type
   // - and the Expr's value is modeled by the framework (or this analysis)
   // - then the PointerValue has nullability properties (is_null/from_nullable)
-  return CFGMatchSwitchBuilder<TransferState<PointerNullabilityLattice>>()
+  return StmtClassCFGMatchSwitchBuilder<
+             TransferState<PointerNullabilityLattice>>()
       // Handles initialization of the null states of pointers.
       .CaseOfCFGStmt<Expr>(isAddrOf(), transferValue_NotNullPointer)
       // TODO(mboehme): I believe we should be able to move handling of null
@@ -1654,8 +1678,34 @@ void ensureSmartPointerInitialized(
 
 }  // namespace
 
+void SharedContextFields::seed(dataflow::DataflowAnalysisContext &DACtx,
+                               ASTContext &Ctx,
+                               const dataflow::FieldSet &Fields) {
+  for (const FieldDecl *Field : Fields) {
+    if (!Modeled.insert(Field).second) continue;
+    // The context models the fields that the code it's initialized for refers
+    // to. These references are never evaluated, so they refer to the fields of
+    // an object that doesn't exist.
+    auto *Object = new (Ctx) OpaqueValueExpr(
+        Field->getLocation(), Ctx.getRecordType(Field->getParent()),
+        VK_LValue);
+    References.push_back(MemberExpr::CreateImplicit(
+        Ctx, Object, /*IsArrow=*/false, const_cast<FieldDecl *>(Field),
+        Field->getType().getNonReferenceType(), VK_LValue,
+        Field->isBitField() ? OK_BitField : OK_Ordinary));
+  }
+  if (References.empty()) return;
+  CompoundStmt *AllReferences = CompoundStmt::Create(
+      Ctx, References, FPOptionsOverride(), SourceLocation(), SourceLocation());
+  // Models the fields, and creates nothing else, as the references name no
+  // globals, functions or parameters.
+  Environment Env(DACtx, *AllReferences);
+  Env.initialize();
+}
+
 PointerNullabilityAnalysis::PointerNullabilityAnalysis(
-    ASTContext &Context, Environment &Env, const NullabilityPragmas &Pragmas)
+    ASTContext &Context, Environment &Env, const NullabilityPragmas &Pragmas,
+    absl::Nullable<TypeNullabilityCache *> TypeCache)
     : DataflowAnalysis<PointerNullabilityAnalysis, PointerNullabilityLattice>(
           Context),
       TypeTransferer(buildTypeTransferer()),
@@ -1667,6 +1717,15 @@ PointerNullabilityAnalysis::PointerNullabilityAnalysis(
         return {{PtrField, RawPointerTy}};
       });
   NFS.Defaults = TypeNullabilityDefaults(Context, Pragmas);
+  NFS.Defaults.Cache = TypeCache;
+}
+
+void PointerNullabilityAnalysis::resetForNextTarget() {
+  NFS.ExprToNullability.clear();
+  NFS.DeclTopLevelNullability.clear();
+  NFS.ConcreteNullabilityOverride = [](const Decl &) { return std::nullopt; };
+  TransferredElements = 0;
+  ForcedWidenings = 0;
 }
 
 PointerTypeNullability PointerNullabilityAnalysis::assignNullabilityVariable(
@@ -1680,6 +1739,7 @@ PointerTypeNullability PointerNullabilityAnalysis::assignNullabilityVariable(
 void PointerNullabilityAnalysis::transfer(const CFGElement &Elt,
                                           PointerNullabilityLattice &Lattice,
                                           Environment &Env) {
+  ++TransferredElements;
   TransferState<PointerNullabilityLattice> State(Lattice, Env);
 
   TypeTransferer(Elt, getASTContext(), State);
@@ -1688,16 +1748,9 @@ void PointerNullabilityAnalysis::transfer(const CFGElement &Elt,
   ensureSmartPointerInitialized(Elt, State);
 }
 
-static absl::Nullable<const Formula *> mergeFormulas(
-    absl::Nullable<const Formula *> Bool1, const Environment &Env1,
-    absl::Nullable<const Formula *> Bool2, const Environment &Env2,
-    Environment &MergedEnv) {
-  if (Bool1 == Bool2) {
-    return Bool1;
-  }
-
-  if (Bool1 == nullptr || Bool2 == nullptr) return nullptr;
-
+static absl::Nullable<const Formula *> mergeDistinctFormulas(
+    const Formula *Bool1, const Environment &Env1, const Formula *Bool2,
+    const Environment &Env2, Environment &MergedEnv) {
   auto &A = MergedEnv.arena();
 
   // If `Bool1` and `Bool2` is constrained to the same true / false value, that
@@ -1712,7 +1765,7 @@ static absl::Nullable<const Formula *> mergeFormulas(
     return &A.makeLiteral(false);
   }
 
-  auto &MergedBool = A.makeAtomRef(A.makeAtom());
+  auto &MergedBool = A.makeAtomRef(makeNullabilityAtom(A));
   // TODO(b/233582219): Flow conditions are not necessarily mutually
   // exclusive, a fix is in order: https://reviews.llvm.org/D130270. Update
   // this section when the patch is commited.
@@ -1724,6 +1777,47 @@ static absl::Nullable<const Formula *> mergeFormulas(
   return &MergedBool;
 }
 
+absl::Nullable<const Formula *> PointerNullabilityAnalysis::mergeFormulas(
+    absl::Nullable<const Formula *> Bool1, const Environment &Env1,
+    absl::Nullable<const Formula *> Bool2, const Environment &Env2,
+    Environment &MergedEnv) {
+  if (Bool1 == Bool2) {
+    return Bool1;
+  }
+
+  if (Bool1 == nullptr || Bool2 == nullptr) return nullptr;
+
+  // The merged formulas of a previous join are forgotten as soon as anything
+  // else happens to (or in place of) its merged environment.
+  Atom FC1 = Env1.getFlowConditionToken();
+  Atom FC2 = Env2.getFlowConditionToken();
+  if (&MergedEnv != MergedFormulasEnv || FC1 != JoinedFC1 ||
+      FC2 != JoinedFC2 || MergedEnv.getFlowConditionToken() != MergedFC) {
+    MergedFormulas.clear();
+    MergedFormulasEnv = &MergedEnv;
+    JoinedFC1 = FC1;
+    JoinedFC2 = FC2;
+  }
+  if (auto It = MergedFormulas.find({Bool1, Bool2});
+      It != MergedFormulas.end())
+    return It->second;
+  const Formula *Merged =
+      mergeDistinctFormulas(Bool1, Env1, Bool2, Env2, MergedEnv);
+  MergedFormulas[{Bool1, Bool2}] = Merged;
+  MergedFC = MergedEnv.getFlowConditionToken();
+  return Merged;
+}
+
+std::optional<PointerNullState> PointerNullabilityAnalysis::getNullState(
+    const PointerValue &PointerVal) {
+  if (auto It = NullStates.find(&PointerVal); It != NullStates.end())
+    return It->second;
+  if (!hasPointerNullState(PointerVal)) return std::nullopt;
+  PointerNullState State = getPointerNullState(PointerVal);
+  NullStates[&PointerVal] = State;
+  return State;
+}
+
 void PointerNullabilityAnalysis::join(QualType Type, const Value &Val1,
                                       const Environment &Env1,
                                       const Value &Val2,
@@ -1731,8 +1825,11 @@ void PointerNullabilityAnalysis::join(QualType Type, const Value &Val1,
                                       Environment &MergedEnv) {
   if (!isSupportedRawPointerType(Type)) return;
 
-  if (!hasPointerNullState(cast<PointerValue>(Val1)) ||
-      !hasPointerNullState(cast<PointerValue>(Val2))) {
+  std::optional<PointerNullState> Nullability1 =
+      getNullState(cast<PointerValue>(Val1));
+  std::optional<PointerNullState> Nullability2 =
+      getNullState(cast<PointerValue>(Val2));
+  if (!Nullability1 || !Nullability2) {
     // It can happen that we merge pointers without null state, if either or
     // both of the pointers has not appeared in an expression (and has not
     // otherwise been initialized with nullability properties) before the merge.
@@ -1742,13 +1839,10 @@ void PointerNullabilityAnalysis::join(QualType Type, const Value &Val1,
     return;
   }
 
-  auto Nullability1 = getPointerNullState(cast<PointerValue>(Val1));
-  auto Nullability2 = getPointerNullState(cast<PointerValue>(Val2));
-
   auto *FromNullable =
-      mergeFormulas(Nullability1.FromNullable, Env1, Nullability2.FromNullable,
-                    Env2, MergedEnv);
-  auto *Null = mergeFormulas(Nullability1.IsNull, Env1, Nullability2.IsNull,
+      mergeFormulas(Nullability1->FromNullable, Env1,
+                    Nullability2->FromNullable, Env2, MergedEnv);
+  auto *Null = mergeFormulas(Nullability1->IsNull, Env1, Nullability2->IsNull,
                              Env2, MergedEnv);
 
   initPointerNullState(cast<PointerValue>(MergedVal),
@@ -1767,18 +1861,17 @@ ComparisonResult PointerNullabilityAnalysis::compare(QualType Type,
     if (&PointerVal1->getPointeeLoc() != &PointerVal2.getPointeeLoc())
       return ComparisonResult::Different;
 
-    if (hasPointerNullState(*PointerVal1) != hasPointerNullState(PointerVal2))
+    std::optional<PointerNullState> Nullability1 = getNullState(*PointerVal1);
+    std::optional<PointerNullState> Nullability2 = getNullState(PointerVal2);
+    if (Nullability1.has_value() != Nullability2.has_value())
       return ComparisonResult::Different;
 
-    if (!hasPointerNullState(*PointerVal1)) return ComparisonResult::Same;
-
-    auto Nullability1 = getPointerNullState(*PointerVal1);
-    auto Nullability2 = getPointerNullState(PointerVal2);
+    if (!Nullability1) return ComparisonResult::Same;
 
     // Ideally, we would be checking for equivalence of formulas, but that's
     // expensive, so we simply check for identity instead.
-    return Nullability1.FromNullable == Nullability2.FromNullable &&
-                   Nullability1.IsNull == Nullability2.IsNull
+    return Nullability1->FromNullable == Nullability2->FromNullable &&
+                   Nullability1->IsNull == Nullability2->IsNull
                ? ComparisonResult::Same
                : ComparisonResult::Different;
   }
@@ -1793,14 +1886,20 @@ ComparisonResult PointerNullabilityAnalysis::compare(QualType Type,
 // be proven equivalent. Otherwise, (`Prev` and `Cur` are provably equivalent),
 // returns `Cur`. Returns `Cur`, if `Prev` is equivalent to `Cur`. Otherwise,
 // returns `Top`.
+// If `Force`, distinct formulas are widened to Top without checking whether
+// they are equivalent, and `Forced` is incremented.
 static std::pair<absl::Nullable<const Formula *>, LatticeEffect>
 widenNullabilityProperty(absl::Nullable<const Formula *> Prev,
                          const Environment &PrevEnv,
                          absl::Nullable<const Formula *> Cur,
-                         Environment &CurEnv) {
+                         Environment &CurEnv, bool Force, uint64_t &Forced) {
   if (Prev == Cur) return {Cur, LatticeEffect::Unchanged};
   if (Prev == nullptr) return {nullptr, LatticeEffect::Unchanged};
   if (Cur == nullptr) return {nullptr, LatticeEffect::Changed};
+  if (Force) {
+    ++Forced;
+    return {nullptr, LatticeEffect::Changed};
+  }
 
   Arena &A = CurEnv.arena();
 
@@ -1834,16 +1933,20 @@ std::optional<WidenResult> PointerNullabilityAnalysis::widen(
   // value to be outside the scope. TODO: we should consider all pointers in
   // scope and handle this case accordingly. We will widen the pointer location,
   // but (always) return a pointer value with no null state.
-  if (!hasPointerNullState(*PrevPtr) || !hasPointerNullState(CurPtr))
-    return std::nullopt;
+  std::optional<PointerNullState> PrevState = getNullState(*PrevPtr);
+  std::optional<PointerNullState> CurState = getNullState(CurPtr);
+  if (!PrevState || !CurState) return std::nullopt;
 
-  auto [FromNullablePrev, NullPrev] = getPointerNullState(*PrevPtr);
-  auto [FromNullableCur, NullCur] = getPointerNullState(CurPtr);
+  auto [FromNullablePrev, NullPrev] = *PrevState;
+  auto [FromNullableCur, NullCur] = *CurState;
 
-  auto [FromNullableWidened, FNWEffect] = widenNullabilityProperty(
-      FromNullablePrev, PrevEnv, FromNullableCur, CurrentEnv);
-  auto [NullWidened, NWEffect] =
-      widenNullabilityProperty(NullPrev, PrevEnv, NullCur, CurrentEnv);
+  bool Force = WideningThreshold > 0 &&
+               countLoopHeadVisit(PrevEnv, CurrentEnv) >= WideningThreshold;
+  auto [FromNullableWidened, FNWEffect] =
+      widenNullabilityProperty(FromNullablePrev, PrevEnv, FromNullableCur,
+                               CurrentEnv, Force, ForcedWidenings);
+  auto [NullWidened, NWEffect] = widenNullabilityProperty(
+      NullPrev, PrevEnv, NullCur, CurrentEnv, Force, ForcedWidenings);
 
   if (LocUnchanged && FNWEffect == LatticeEffect::Unchanged &&
       NWEffect == LatticeEffect::Unchanged)
@@ -1868,6 +1971,19 @@ std::optional<WidenResult> PointerNullabilityAnalysis::widen(
   return WidenResult{&WidenedPtr, Effect};
 }
 
+unsigned PointerNullabilityAnalysis::countLoopHeadVisit(
+    const Environment &PrevEnv, const Environment &CurrentEnv) {
+  // The framework widens the new state of a loop head against its state from
+  // the previous visit, so this visit's count is one more than that one's.
+  Atom Token = CurrentEnv.getFlowConditionToken();
+  if (auto It = LoopHeadVisits.find(Token); It != LoopHeadVisits.end())
+    return It->second;
+  unsigned Visits =
+      LoopHeadVisits.lookup(PrevEnv.getFlowConditionToken()) + 1;
+  LoopHeadVisits[Token] = Visits;
+  return Visits;
+}
+
 StorageLocation &PointerNullabilityAnalysis::getTopStorageLocation(
     DataflowAnalysisContext &DACtx, QualType Ty) {
   auto [It, Inserted] = TopStorageLocations.try_emplace(Ty, nullptr);
@@ -5,23 +5,34 @@
 #ifndef CRUBIT_NULLABILITY_POINTER_NULLABILITY_ANALYSIS_H_
 #define CRUBIT_NULLABILITY_POINTER_NULLABILITY_ANALYSIS_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "absl/base/nullability.h"
+#include "nullability/pointer_nullability.h"
 #include "nullability/pointer_nullability_lattice.h"
 #include "nullability/pragma.h"
 #include "nullability/type_nullability.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
+#include "clang/AST/Stmt.h"
 #include "clang/AST/Type.h"
+#include "clang/Analysis/FlowSensitive/ASTOps.h"
 #include "clang/Analysis/FlowSensitive/Arena.h"
 #include "clang/Analysis/FlowSensitive/CFGMatchSwitch.h"
 #include "clang/Analysis/FlowSensitive/DataflowAnalysis.h"
+#include "clang/Analysis/FlowSensitive/DataflowAnalysisContext.h"
 #include "clang/Analysis/FlowSensitive/DataflowEnvironment.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
 #include "clang/Analysis/FlowSensitive/Value.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/FunctionExtras.h"
+#include "llvm/ADT/STLExtras.h"
 
 namespace clang {
 namespace tidy {
@@ -30,6 +41,41 @@ namespace nullability {
 /// Factory function for creating a solver implementation.
 using SolverFactory = std::function<std::unique_ptr<dataflow::Solver>()>;
 
+/// The fields modeled by a `DataflowAnalysisContext` that several functions
+/// are analyzed in, one after another.
+///
+/// The context creates the storage locations of globals (and the "top" storage
+/// locations of the analysis) once, with the fields that it models at the
+/// time. A function that refers to other fields would see these locations
+/// without them, so it has to be analyzed in a new context.
+class SharedContextFields {
+ public:
+  /// Whether code that refers to `Fields` (see `dataflow::ReferencedDecls`)
+  /// can be analyzed in the context.
+  bool covers(const dataflow::FieldSet &Fields) const {
+    return llvm::all_of(Fields, [this](const FieldDecl *Field) {
+      return Modeled.contains(Field);
+    });
+  }
+  /// Makes `DACtx`, a new context that replaces the previous one, model
+  /// `Fields` and the fields of the previous context. Otherwise, functions
+  /// that alternate between sets of fields would each need a new context.
+  ///
+  /// Must be called before `DACtx` creates any record storage locations.
+  void seed(dataflow::DataflowAnalysisContext &DACtx, ASTContext &Ctx,
+            const dataflow::FieldSet &Fields);
+  /// Forgets the fields, for when the next context is for another AST.
+  void clear() {
+    Modeled.clear();
+    References.clear();
+  }
+
+ private:
+  llvm::DenseSet<const FieldDecl *> Modeled;
+  // A reference to each of the `Modeled` fields, allocated in the AST once.
+  std::vector<Stmt *> References;
+};
+
 /// Analyzes constructs in the source code to collect nullability information
 /// about pointers at each program point. This analysis and the corresponding
 /// lattice were based on the gradual analysis in 'Estep, Sam, Jenna Wise,
@@ -43,9 +89,12 @@ class PointerNullabilityAnalysis
   PointerNullabilityLattice::NonFlowSensitiveState NFS;
 
  public:
-  explicit PointerNullabilityAnalysis(ASTContext &Context,
-                                      dataflow::Environment &Env,
-                                      const NullabilityPragmas &Pragmas);
+  // If `TypeCache` is provided, it memoizes type nullability across all
+  // analyses that share it (see TypeNullabilityCache).
+  explicit PointerNullabilityAnalysis(
+      ASTContext &Context, dataflow::Environment &Env,
+      const NullabilityPragmas &Pragmas,
+      absl::Nullable<TypeNullabilityCache *> TypeCache = nullptr);
 
   PointerNullabilityLattice initialElement() {
     return PointerNullabilityLattice(NFS);
@@ -87,9 +136,35 @@ class PointerNullabilityAnalysis
     NFS.ConcreteNullabilityOverride = std::move(Override);
   }
 
+  // Prepares the analysis to analyze other code in the same context, as if it
+  // were new: forgets the variables and overrides assigned above and the
+  // nullability of expressions (which depends on them), and resets the counts
+  // below. What only depends on the context, such as the "top" storage
+  // locations and the null states of its values, is kept.
+  void resetForNextTarget();
+
   void transfer(const CFGElement &Elt, PointerNullabilityLattice &Lattice,
                 dataflow::Environment &Env);
 
+  // The number of times `transfer()` has been called, i.e. the number of CFG
+  // elements processed, counting each revisit of a block until convergence.
+  uint64_t transferredElements() const { return TransferredElements; }
+
+  // After `Visits` visits to a loop head, widens the null state of pointers
+  // that changed since the previous visit straight to Top, without checking
+  // whether the old and new states are equivalent. This gives up some
+  // precision to bound the number of iterations (and SAT queries) that loops
+  // take to converge. 0, the default, never forces widening.
+  void setWideningThreshold(unsigned Visits) { WideningThreshold = Visits; }
+
+  // The number of null state properties widened to Top by the threshold.
+  uint64_t forcedWidenings() const { return ForcedWidenings; }
+
+  // The sizes of the state that is not flow-sensitive. It is shared by all the
+  // functions analyzed with this object, and only grows.
+  size_t exprNullabilityEntries() const { return NFS.ExprToNullability.size(); }
+  size_t topStorageLocations() const { return TopStorageLocations.size(); }
+
   void join(QualType Type, const dataflow::Value &Val1,
             const dataflow::Environment &Env1, const dataflow::Value &Val2,
             const dataflow::Environment &Env2, dataflow::Value &MergedVal,
@@ -115,6 +190,26 @@ class PointerNullabilityAnalysis
   dataflow::StorageLocation &getTopStorageLocation(
       dataflow::DataflowAnalysisContext &DACtx, QualType Ty);
 
+  // Returns how many times the loop head whose state is `CurrentEnv` has been
+  // visited, given its state from the previous visit.
+  unsigned countLoopHeadVisit(const dataflow::Environment &PrevEnv,
+                              const dataflow::Environment &CurrentEnv);
+
+  // Returns the null state of `PointerVal`, or nullopt if it has none. A null
+  // state never changes once set, so it is looked up once per value.
+  std::optional<PointerNullState> getNullState(
+      const dataflow::PointerValue &PointerVal);
+
+  // Joins a null state property of two pointers into `MergedEnv`. Pointers
+  // joined into the same environment with the same properties on both sides
+  // (e.g. copies of one pointer) share the merged formula, rather than each
+  // adding an atom and a flow condition clause (see `MergedFormulas`).
+  absl::Nullable<const dataflow::Formula *> mergeFormulas(
+      absl::Nullable<const dataflow::Formula *> Bool1,
+      const dataflow::Environment &Env1,
+      absl::Nullable<const dataflow::Formula *> Bool2,
+      const dataflow::Environment &Env2, dataflow::Environment &MergedEnv);
+
   // Transfers (non-flow-sensitive) type properties through statements.
   dataflow::CFGMatchSwitch<dataflow::TransferState<PointerNullabilityLattice>>
       TypeTransferer;
@@ -125,6 +220,28 @@ class PointerNullabilityAnalysis
 
   // Storage locations that represent "top" for each given type.
   llvm::DenseMap<QualType, dataflow::StorageLocation *> TopStorageLocations;
+
+  uint64_t TransferredElements = 0;
+
+  unsigned WideningThreshold = 0;
+  // The visit count of each loop head state, keyed by its flow condition
+  // token (which is unique to each visit).
+  llvm::DenseMap<dataflow::Atom, unsigned> LoopHeadVisits;
+  uint64_t ForcedWidenings = 0;
+
+  llvm::DenseMap<const dataflow::PointerValue *, PointerNullState> NullStates;
+
+  // The formulas that `mergeFormulas()` merged each pair of formulas into, in
+  // the join of the environments whose flow condition tokens are `JoinedFC1`
+  // and `JoinedFC2` into `MergedFormulasEnv`. They are only reused while the
+  // flow condition of `MergedFormulasEnv` is still `MergedFC`, i.e. contains
+  // the clauses that define the merged atoms.
+  using FormulaPair =
+      std::pair<const dataflow::Formula *, const dataflow::Formula *>;
+  llvm::DenseMap<FormulaPair, absl::Nullable<const dataflow::Formula *>>
+      MergedFormulas;
+  const dataflow::Environment *MergedFormulasEnv = nullptr;
+  dataflow::Atom JoinedFC1 = {}, JoinedFC2 = {}, MergedFC = {};
 };
 }  // namespace nullability
 }  // namespace tidy
@@ -3,6 +3,8 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
 #include <cstdint>
+#include <memory>
+#include <string>
 
 #include "absl/base/nullability.h"
 #include "absl/log/check.h"
@@ -12,12 +14,16 @@
 #include "nullability/pointer_nullability_analysis.h"
 #include "nullability/pointer_nullability_diagnosis.h"
 #include "nullability/pragma.h"
+#include "nullability/type_nullability.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/Analysis/FlowSensitive/DataflowAnalysis.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
 #include "clang/Basic/LLVM.h"
 #include "clang/Testing/TestAST.h"
+#include "llvm/ADT/ArrayRef.h"
 
 namespace clang::tidy::nullability {
 namespace {
@@ -29,13 +35,49 @@ absl::Nonnull<NamedDecl *> lookup(absl::string_view Name,
   return Result.front();
 }
 
+// Counts the queries made of the default solver, and those that ran out of
+// SAT iterations.
+class CountingSolver : public dataflow::Solver {
+ public:
+  CountingSolver(int64_t &Calls, int64_t &TimedOut)
+      : Inner(makeDefaultSolverForDiagnosis()),
+        Calls(Calls),
+        TimedOut(TimedOut) {}
+
+  Result solve(llvm::ArrayRef<const dataflow::Formula *> Vals) override {
+    ++Calls;
+    Result R = Inner->solve(Vals);
+    if (R.getStatus() == Result::Status::TimedOut) ++TimedOut;
+    return R;
+  }
+
+  bool reachedLimit() const override { return Inner->reachedLimit(); }
+
+ private:
+  std::unique_ptr<dataflow::Solver> Inner;
+  int64_t &Calls;
+  int64_t &TimedOut;
+};
+
 void benchmarkAnalysisOnCode(benchmark::State &State, llvm::StringRef Code) {
   TestAST AST(Code);
   auto *Target = cast<FunctionDecl>(
       lookup("Target", *AST.context().getTranslationUnitDecl()));
   NullabilityPragmas NoPragmas;
 
-  for (auto _ : State) (void)diagnosePointerNullability(Target, NoPragmas);
+  int64_t SolverCalls = 0;
+  int64_t SolverTimeouts = 0;
+  auto MakeSolver = [&] {
+    return std::make_unique<CountingSolver>(SolverCalls, SolverTimeouts);
+  };
+  for (auto _ : State)
+    (void)diagnosePointerNullability(Target, NoPragmas, MakeSolver);
+
+  // Reported per iteration, so that they're comparable across runs.
+  State.counters["solver_calls"] =
+      benchmark::Counter(SolverCalls, benchmark::Counter::kAvgIterations);
+  State.counters["solver_timeouts"] =
+      benchmark::Counter(SolverTimeouts, benchmark::Counter::kAvgIterations);
 }
 
 void BM_PointerAnalysisCopyPointer(benchmark::State &State) {
@@ -217,10 +259,237 @@ void BM_PointerAnalysisCallInLoop(benchmark::State &State) {
 }
 BENCHMARK(BM_PointerAnalysisCallInLoop);
 
+// Many pointers that are checked and dereferenced at every level of a deep
+// loop nest.
+void BM_PointerAnalysisNestedLoops(benchmark::State &State) {
+  benchmarkAnalysisOnCode(State, R"cpp(
+    int *_Nullable next(int);
+    bool cond(int);
+    int Target(int *a, int *b, int *c, int *d, int *_Nullable e) {
+      int sum = 0;
+      for (int i = 0; i < 10; ++i) {
+        int *p = next(i);
+        for (int j = 0; j < 10; ++j) {
+          if (p) sum += *p;
+          int *q = cond(j) ? a : b;
+          for (int k = 0; k < 10; ++k) {
+            int *r = next(k);
+            if (r == nullptr) r = c;
+            for (int l = 0; l < 10; ++l) {
+              if (e != nullptr && cond(l)) sum += *e;
+              sum += *q + *r + *d;
+              if (cond(sum)) q = r;
+            }
+          }
+        }
+      }
+      return sum;
+    }
+  )cpp");
+}
+BENCHMARK(BM_PointerAnalysisNestedLoops);
+
+constexpr inline char SmartPointerPreamble[] = R"cpp(
+  namespace std {
+  template <class T>
+  struct remove_reference {
+    using type = T;
+  };
+  template <class T>
+  struct remove_reference<T &> {
+    using type = T;
+  };
+  template <class T>
+  typename remove_reference<T>::type &&move(T &&);
+
+  template <class T>
+  class unique_ptr {
+   public:
+    unique_ptr();
+    unique_ptr(T *);
+    unique_ptr(unique_ptr &&);
+    ~unique_ptr();
+    unique_ptr &operator=(unique_ptr &&);
+    T &operator*() const;
+    T *operator->() const;
+    T *get() const;
+    T *release();
+    void reset(T *p = nullptr);
+    explicit operator bool() const;
+  };
+
+  template <class T>
+  class weak_ptr;
+
+  template <class T>
+  class shared_ptr {
+   public:
+    shared_ptr();
+    shared_ptr(const shared_ptr &);
+    template <class U>
+    shared_ptr(unique_ptr<U> &&);
+    ~shared_ptr();
+    shared_ptr &operator=(const shared_ptr &);
+    T &operator*() const;
+    T *operator->() const;
+    T *get() const;
+    explicit operator bool() const;
+  };
+
+  template <class T>
+  class weak_ptr {
+   public:
+    weak_ptr(const shared_ptr<T> &);
+    shared_ptr<T> lock() const;
+  };
+
+  template <class T, class... Args>
+  unique_ptr<T> make_unique(Args &&...);
+  template <class T, class... Args>
+  shared_ptr<T> make_shared(Args &&...);
+  template <class DestT, class SrcT>
+  shared_ptr<DestT> static_pointer_cast(const shared_ptr<SrcT> &);
+  template <class DestT, class SrcT>
+  shared_ptr<DestT> dynamic_pointer_cast(const shared_ptr<SrcT> &);
+  }  // namespace std
+)cpp";
+
+// Smart pointers are modeled through their storage locations, and each
+// method call is a separate transfer, so this is much more work than the
+// equivalent raw pointer code.
+void BM_PointerAnalysisSmartPointers(benchmark::State &State) {
+  absl::string_view Code = R"cpp(
+    struct Base {
+      virtual ~Base();
+      int x;
+    };
+    struct Derived : Base {
+      int y;
+    };
+    bool cond();
+
+    int Target(std::shared_ptr<Base> base, std::weak_ptr<Base> weak) {
+      int sum = 0;
+      std::unique_ptr<Derived> owned = std::make_unique<Derived>();
+      if (cond()) owned.reset();
+      if (owned) sum += owned->y;
+      std::shared_ptr<Base> shared = std::move(owned);
+      for (int i = 0; i < 10; ++i) {
+        if (std::shared_ptr<Base> locked = weak.lock()) sum += locked->x;
+        std::shared_ptr<Derived> derived =
+            std::dynamic_pointer_cast<Derived>(base);
+        if (derived) {
+          sum += derived->y;
+          base = std::static_pointer_cast<Base>(derived);
+        } else if (shared) {
+          sum += shared->x;
+          base = shared;
+        }
+        if (base.get() != nullptr) sum += (*base).x;
+      }
+      return sum;
+    }
+  )cpp";
+  benchmarkAnalysisOnCode(State, absl::StrCat(SmartPointerPreamble, Code));
+}
+BENCHMARK(BM_PointerAnalysisSmartPointers);
+
+// A long sequence of CHECK-style assertions, each of which expands to a branch
+// that terminates, as is common at the top of functions.
+void BM_PointerAnalysisCheckMacros(benchmark::State &State) {
+  std::string Code = R"cpp(
+    [[noreturn]] void fail(const char *);
+    #define CHECK(x) ((x) ? (void)0 : fail(#x))
+    #define CHECK_NE(a, b) CHECK((a) != (b))
+    struct Node {
+      Node *_Nullable next;
+      int *_Nullable value;
+    };
+    int Target(Node *_Nullable n, int *_Nullable p) {
+      int sum = 0;
+  )cpp";
+  for (int I = 0; I < 20; ++I)
+    absl::StrAppend(&Code, "CHECK_NE(n, nullptr); CHECK_NE(n->value, nullptr);",
+                    "CHECK(p); sum += *n->value + *p; n = n->next;\n");
+  absl::StrAppend(&Code, "return sum; }");
+  benchmarkAnalysisOnCode(State, Code);
+}
+BENCHMARK(BM_PointerAnalysisCheckMacros);
+
+// A large switch with a different pointer operation in each case.
+void BM_PointerAnalysisLargeSwitch(benchmark::State &State) {
+  std::string Code = R"cpp(
+    int *_Nullable next(int);
+    int Target(int k, int *a, int *_Nullable b) {
+      int *p = a;
+      switch (k) {
+  )cpp";
+  for (int I = 0; I < 64; ++I) {
+    switch (I % 4) {
+      case 0:
+        absl::StrAppend(&Code, "case ", I, ": p = next(", I, "); break;\n");
+        break;
+      case 1:
+        absl::StrAppend(&Code, "case ", I, ": if (b) p = b; break;\n");
+        break;
+      case 2:
+        absl::StrAppend(&Code, "case ", I, ": p = nullptr; [[fallthrough]];\n");
+        break;
+      case 3:
+        absl::StrAppend(&Code, "case ", I, ": if (!p) return ", I,
+                        "; break;\n");
+        break;
+    }
+  }
+  absl::StrAppend(&Code, "default: break; } return p ? *p : 0; }");
+  benchmarkAnalysisOnCode(State, Code);
+}
+BENCHMARK(BM_PointerAnalysisLargeSwitch);
+
+// Chains of const accessors, in the style of generated protobuf code: each
+// pointer-returning const method call is modeled as stable between
+// modifications of the object.
+void BM_PointerAnalysisAccessorChains(benchmark::State &State) {
+  absl::string_view Code = R"cpp(
+    struct Leaf {
+      int *_Nullable value() const;
+      bool has_value() const;
+    };
+    struct Inner {
+      const Leaf &leaf() const;
+      Leaf *_Nullable mutable_leaf();
+      const Leaf *_Nullable maybe_leaf() const;
+    };
+    struct Outer {
+      const Inner &inner() const;
+      const Inner *_Nullable maybe_inner() const;
+      void clear();
+    };
+    int Target(Outer &o) {
+      int sum = 0;
+      for (int i = 0; i < 10; ++i) {
+        if (o.inner().leaf().value() != nullptr)
+          sum += *o.inner().leaf().value();
+        if (o.maybe_inner() && o.maybe_inner()->maybe_leaf() &&
+            o.maybe_inner()->maybe_leaf()->value())
+          sum += *o.maybe_inner()->maybe_leaf()->value();
+        if (const Leaf *l = o.inner().maybe_leaf()) {
+          if (l->value()) sum += *l->value();
+        }
+        if (sum > 100) o.clear();
+      }
+      return sum;
+    }
+  )cpp";
+  benchmarkAnalysisOnCode(State, Code);
+}
+BENCHMARK(BM_PointerAnalysisAccessorChains);
+
 }  // namespace
 }  // namespace clang::tidy::nullability
 
 int main(int argc, absl::Nonnull<char **> argv) {
+  clang::tidy::nullability::enableSmartPointers(true);
   benchmark::Initialize(&argc, argv);
   benchmark::RunSpecifiedBenchmarks();
   return 0;
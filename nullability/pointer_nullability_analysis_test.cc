@@ -30,6 +30,7 @@
 #include "clang/Testing/CommandLineArgs.h"
 #include "clang/Testing/TestAST.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Testing/Support/Error.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
 
@@ -42,6 +43,7 @@ using ::clang::ast_matchers::hasName;
 using ::clang::ast_matchers::match;
 using ::clang::ast_matchers::selectFirst;
 using ::clang::ast_matchers::to;
+using ::clang::ast_matchers::varDecl;
 using ::testing::ElementsAre;
 using ::testing::Pointee;
 
@@ -166,5 +168,82 @@ TEST(PointerNullabilityAnalysis,
                           concreteNullability(NullabilityKind::Unspecified))));
 }
 
+TEST(PointerNullabilityAnalysis, WideningThreshold) {
+  const llvm::StringRef Src = R"cpp(
+    bool cond();
+    void target(int *_Nullable a, int *_Nonnull b) {
+      int *p = a;
+      while (cond()) {
+        if (cond()) p = b;
+        else if (p) p = a;
+      }
+    }
+  )cpp";
+  TestAST AST(Src);
+  auto *Target = cast<FunctionDecl>(
+      lookup("target", *AST.context().getTranslationUnitDecl()));
+  NullabilityPragmas NoPragmas;
+
+  auto Run = [&](unsigned Threshold) {
+    dataflow::DataflowAnalysisContext DACtx(
+        std::make_unique<dataflow::WatchedLiteralsSolver>());
+    auto ACFG = dataflow::AdornedCFG::build(*Target);
+    dataflow::Environment Env(DACtx, *Target);
+    PointerNullabilityAnalysis Analysis(AST.context(), Env, NoPragmas);
+    Analysis.setWideningThreshold(Threshold);
+    EXPECT_THAT_EXPECTED(
+        dataflow::runDataflowAnalysis(*ACFG, Analysis, std::move(Env)),
+        llvm::Succeeded());
+    return Analysis.forcedWidenings();
+  };
+  EXPECT_EQ(Run(0), 0);
+  EXPECT_GT(Run(1), 0);
+}
+
+TEST(PointerNullabilityAnalysis, JoinSharesMergedNullStates) {
+  const llvm::StringRef Src = R"cpp(
+    bool cond();
+    void target(int *_Nullable a, int *_Nullable b) {
+      int *p, *q;
+      if (cond()) {
+        p = a;
+        q = a;
+      } else {
+        p = b;
+        q = b;
+      }
+    }
+  )cpp";
+  TestAST AST(Src);
+  auto *Target = cast<FunctionDecl>(
+      lookup("target", *AST.context().getTranslationUnitDecl()));
+
+  dataflow::DataflowAnalysisContext DACtx(
+      std::make_unique<dataflow::WatchedLiteralsSolver>());
+  auto ACFG = dataflow::AdornedCFG::build(*Target);
+  dataflow::Environment Env(DACtx, *Target);
+  NullabilityPragmas NoPragmas;
+  PointerNullabilityAnalysis Analysis(AST.context(), Env, NoPragmas);
+  auto ExitState = std::move(
+      cantFail(dataflow::runDataflowAnalysis(*ACFG, Analysis, std::move(Env)))
+          .front());
+  ASSERT_TRUE(ExitState.has_value());
+
+  auto Var = [&](llvm::StringRef Name) {
+    return selectFirst<VarDecl>(
+        "v", match(varDecl(hasName(Name)).bind("v"), AST.context()));
+  };
+  auto *P = ExitState->Env.get<dataflow::PointerValue>(*Var("p"));
+  auto *Q = ExitState->Env.get<dataflow::PointerValue>(*Var("q"));
+  ASSERT_NE(P, nullptr);
+  ASSERT_NE(Q, nullptr);
+  ASSERT_TRUE(hasPointerNullState(*P));
+  ASSERT_TRUE(hasPointerNullState(*Q));
+  // `p` and `q` have the same null state on both sides of the join, so they
+  // share the merged atom.
+  EXPECT_NE(getPointerNullState(*P).IsNull, nullptr);
+  EXPECT_EQ(getPointerNullState(*P).IsNull, getPointerNullState(*Q).IsNull);
+}
+
 }  // namespace
 }  // namespace clang::tidy::nullability
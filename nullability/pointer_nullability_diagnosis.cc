@@ -4,15 +4,23 @@
 
 #include "nullability/pointer_nullability_diagnosis.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "absl/base/nullability.h"
 #include "absl/log/check.h"
+#include "nullability/function_summaries.h"
 #include "nullability/pointer_nullability.h"
 #include "nullability/pointer_nullability_analysis.h"
 #include "nullability/pointer_nullability_lattice.h"
@@ -24,6 +32,9 @@
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/ExprCXX.h"
+#include "clang/AST/ODRHash.h"
+#include "clang/AST/OperationKinds.h"
+#include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/AST/Stmt.h"
 #include "clang/AST/Type.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
@@ -35,6 +46,7 @@
 #include "clang/Analysis/FlowSensitive/DataflowAnalysis.h"
 #include "clang/Analysis/FlowSensitive/DataflowAnalysisContext.h"
 #include "clang/Analysis/FlowSensitive/DataflowEnvironment.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
 #include "clang/Analysis/FlowSensitive/MatchSwitch.h"
 #include "clang/Analysis/FlowSensitive/Solver.h"
 #include "clang/Analysis/FlowSensitive/StorageLocation.h"
@@ -42,13 +54,20 @@
 #include "clang/Analysis/FlowSensitive/WatchedLiteralsSolver.h"
 #include "clang/Basic/LLVM.h"
 #include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Basic/Specifiers.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 
 #define DEBUG_TYPE "nullability-diagnostic"
 
@@ -331,9 +350,12 @@ SmallVector<PointerNullabilityDiagnostic> diagnoseAssertNullabilityCall(
            CharSourceRange::getTokenRange(CE->getSourceRange())}};
 }
 
+// `Summaries`, if provided, stand in for the unannotated parameter types of
+// the callee.
 SmallVector<PointerNullabilityDiagnostic> diagnoseCallExpr(
     absl::Nonnull<const CallExpr *> CE, const MatchFinder::MatchResult &Result,
-    const DiagTransferState &State) {
+    const DiagTransferState &State,
+    absl::Nullable<const FunctionSummaries *> Summaries) {
   // __assert_nullability is a special-case.
   if (auto *FD = CE->getDirectCallee()) {
     if (FD->getDeclName().isIdentifier() &&
@@ -386,6 +408,25 @@ SmallVector<PointerNullabilityDiagnostic> diagnoseCallExpr(
   ArrayRef<ParmVarDecl *> Params;
   if (auto *DC = CE->getDirectCallee()) Params = DC->parameters();
 
+  // A callee that dereferences a parameter without checking it needs a nonnull
+  // argument, even if the parameter isn't annotated.
+  SmallVector<PointerTypeNullability> SummarizedParamNullability;
+  if (const FunctionDecl *DC = CE->getDirectCallee(); DC && Summaries) {
+    SummarizedParamNullability.assign(ParamNullability.begin(),
+                                      ParamNullability.end());
+    unsigned Offset = 0;
+    for (unsigned I = 0; I < CalleeType->getNumParams(); ++I) {
+      if (Offset < SummarizedParamNullability.size() &&
+          Summaries->requiresNonnullParam(*DC, I)) {
+        PointerTypeNullability &N = SummarizedParamNullability[Offset];
+        if (!N.isSymbolic() && N.concrete() == NullabilityKind::Unspecified)
+          N = NullabilityKind::NonNull;
+      }
+      Offset += countPointersInType(CalleeType->getParamType(I));
+    }
+    ParamNullability = SummarizedParamNullability;
+  }
+
   return diagnoseArgumentCompatibility(
       *CalleeType, ParamNullability, Params, Args,
       dyn_cast_or_null<FunctionDecl>(CE->getCalleeDecl()), State.Env,
@@ -482,6 +523,7 @@ SmallVector<PointerNullabilityDiagnostic> diagnoseMovedFromNonnullSmartPointer(
 /// state even if the smart pointer is annotated nonnull.
 class AllowedMovedFromNonnullSmartPointerExprs {
  public:
+  AllowedMovedFromNonnullSmartPointerExprs() = default;
   explicit AllowedMovedFromNonnullSmartPointerExprs(const FunctionDecl *Func) {
     for (const BoundNodes &Node :
          match(findAll(expr(anyOf(
@@ -588,7 +630,8 @@ void checkAnnotationsConsistent(
   }
 }
 
-DiagTransferFunc pointerNullabilityDiagnoserBefore() {
+DiagTransferFunc pointerNullabilityDiagnoserBefore(
+    absl::Nullable<const FunctionSummaries *> Summaries) {
   // Almost all diagnosis callbacks should be run before the transfer function
   // has been applied because we want to check preconditions for the operation
   // performed by the `CFGElement`.
@@ -616,7 +659,13 @@ DiagTransferFunc pointerNullabilityDiagnoserBefore() {
       .CaseOfCFGStmt<CXXMemberCallExpr>(isSmartPointerMethodCall("reset"),
                                         diagnoseSmartPointerReset)
       // Check compatibility of parameter assignments and return values.
-      .CaseOfCFGStmt<CallExpr>(callExpr(), diagnoseCallExpr)
+      .CaseOfCFGStmt<CallExpr>(
+          callExpr(),
+          [Summaries](absl::Nonnull<const CallExpr *> CE,
+                      const MatchFinder::MatchResult &Result,
+                      const DiagTransferState &State) {
+            return diagnoseCallExpr(CE, Result, State, Summaries);
+          })
       .CaseOfCFGStmt<CXXConstructExpr>(cxxConstructExpr(),
                                        diagnoseConstructExpr)
       .CaseOfCFGStmt<ReturnStmt>(isPointerReturn(), diagnoseReturn)
@@ -658,10 +707,380 @@ std::unique_ptr<dataflow::Solver> makeDefaultSolverForDiagnosis() {
   return std::make_unique<dataflow::WatchedLiteralsSolver>(MaxSATIterations);
 }
 
+namespace {
+// The text of a function definition, which must be written in one file.
+struct FunctionText {
+  FileID File;
+  unsigned Offset;
+  llvm::StringRef Text;
+};
+
+std::optional<FunctionText> getFunctionText(const FunctionDecl &Func) {
+  const ASTContext &Ctx = Func.getASTContext();
+  const SourceManager &SM = Ctx.getSourceManager();
+  CharSourceRange Range = Lexer::makeFileCharRange(
+      CharSourceRange::getTokenRange(Func.getSourceRange()), SM,
+      Ctx.getLangOpts());
+  if (Range.isInvalid()) return std::nullopt;
+  auto [File, Begin] = SM.getDecomposedLoc(Range.getBegin());
+  auto [EndFile, End] = SM.getDecomposedLoc(Range.getEnd());
+  if (File != EndFile || End < Begin) return std::nullopt;
+  bool Invalid = false;
+  llvm::StringRef Buffer = SM.getBufferData(File, &Invalid);
+  if (Invalid) return std::nullopt;
+  return FunctionText{File, Begin, Buffer.slice(Begin, End)};
+}
+
+// Collects the declarations that a function definition refers to, in the
+// order of traversal, which is the same for each parse of the same code.
+class ReferencedDeclCollector
+    : public RecursiveASTVisitor<ReferencedDeclCollector> {
+ public:
+  std::vector<const ValueDecl *> Decls;
+
+  bool shouldVisitImplicitCode() const { return true; }
+
+  bool VisitValueDecl(const ValueDecl *D) {
+    Decls.push_back(D);
+    return true;
+  }
+  bool VisitDeclRefExpr(const DeclRefExpr *E) {
+    Decls.push_back(E->getDecl());
+    return true;
+  }
+  bool VisitMemberExpr(const MemberExpr *E) {
+    Decls.push_back(E->getMemberDecl());
+    return true;
+  }
+  bool VisitCallExpr(const CallExpr *E) {
+    if (const auto *Callee = dyn_cast_or_null<ValueDecl>(E->getCalleeDecl()))
+      Decls.push_back(Callee);
+    return true;
+  }
+  bool VisitCXXConstructExpr(const CXXConstructExpr *E) {
+    Decls.push_back(E->getConstructor());
+    return true;
+  }
+  bool TraverseConstructorInitializer(CXXCtorInitializer *Init) {
+    if (const FieldDecl *Member = Init->getAnyMember()) Decls.push_back(Member);
+    return RecursiveASTVisitor::TraverseConstructorInitializer(Init);
+  }
+};
+
+std::vector<const ValueDecl *> getReferencedDecls(const FunctionDecl &Func) {
+  ReferencedDeclCollector Collector;
+  Collector.TraverseDecl(const_cast<FunctionDecl *>(&Func));
+  return std::move(Collector.Decls);
+}
+}  // namespace
+
+std::optional<uint64_t> DiagnosisCache::key(
+    const FunctionDecl &Func, const TypeNullabilityDefaults &Defaults,
+    unsigned WideningThreshold) {
+  std::optional<FunctionText> Text = getFunctionText(Func);
+  if (!Text) return std::nullopt;
+  ASTContext &Ctx = Func.getASTContext();
+
+  // The text doesn't show what the macros it uses expand to, or which
+  // specialization this is.
+  ODRHash Hash;
+  if (const auto *Ctor = dyn_cast<CXXConstructorDecl>(&Func))
+    for (const CXXCtorInitializer *Init : Ctor->inits())
+      if (const Expr *E = Init->getInit()) Hash.AddStmt(E);
+  Hash.AddStmt(Func.getBody());
+
+  std::string Key(Text->Text);
+  llvm::raw_string_ostream OS(Key);
+  OS << '\0' << Hash.CalculateHash() << ' ' << WideningThreshold << ' '
+     << static_cast<int>(Defaults.get(Text->File)) << ' ';
+  Func.getNameForDiagnostic(OS, Ctx.getPrintingPolicy(), /*Qualified=*/true);
+  for (const ValueDecl *D : getReferencedDecls(Func)) {
+    OS << '\0';
+    D->printQualifiedName(OS);
+    OS << ": "
+       << printWithNullability(D->getType(), getTypeNullability(*D, Defaults),
+                               Ctx);
+  }
+  return llvm::xxh3_64bits(Key);
+}
+
+bool DiagnosisCache::lookup(
+    uint64_t Key, const FunctionDecl &Func,
+    llvm::SmallVectorImpl<PointerNullabilityDiagnostic> &Diags) {
+  std::optional<std::vector<CachedDiagnostic>> Cached;
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (auto It = Entries.find(Key); It != Entries.end()) Cached = It->second;
+  }
+  std::optional<FunctionText> Text = getFunctionText(Func);
+  if (!Cached || !Text) {
+    ++Misses;
+    return false;
+  }
+
+  ASTContext &Ctx = Func.getASTContext();
+  SourceLocation Start =
+      Ctx.getSourceManager().getComposedLoc(Text->File, Text->Offset);
+  auto Decode = [&](const CachedRange &R) {
+    if (!R.Valid) return CharSourceRange();
+    return CharSourceRange(SourceRange(Start.getLocWithOffset(R.Begin),
+                                       Start.getLocWithOffset(R.End)),
+                           R.TokenRange);
+  };
+  std::vector<const ValueDecl *> Referenced;
+  if (llvm::any_of(*Cached, [](const CachedDiagnostic &C) {
+        return C.Callee.has_value();
+      }))
+    Referenced = getReferencedDecls(Func);
+
+  llvm::SmallVector<PointerNullabilityDiagnostic> Found;
+  for (const CachedDiagnostic &C : *Cached) {
+    PointerNullabilityDiagnostic &Diag = Found.emplace_back();
+    Diag.Code = C.Code;
+    Diag.Ctx = C.Ctx;
+    Diag.Range = Decode(C.Range);
+    Diag.NoteRange = Decode(C.NoteRange);
+    if (C.Callee) {
+      // The referenced declarations are part of the key, so this only fails
+      // on a hash collision.
+      if (*C.Callee >= Referenced.size()) {
+        ++Misses;
+        return false;
+      }
+      Diag.Callee = Referenced[*C.Callee];
+    }
+    if (C.ParamName) Diag.ParamName = &Ctx.Idents.get(*C.ParamName);
+  }
+  llvm::move(Found, std::back_inserter(Diags));
+  ++Hits;
+  return true;
+}
+
+void DiagnosisCache::insert(
+    uint64_t Key, const FunctionDecl &Func,
+    llvm::ArrayRef<PointerNullabilityDiagnostic> Diags) {
+  std::optional<FunctionText> Text = getFunctionText(Func);
+  if (!Text) return;
+  const SourceManager &SM = Func.getASTContext().getSourceManager();
+  // Fails for a range outside of the definition, whose text is not part of
+  // the key.
+  auto Encode = [&](CharSourceRange R) -> std::optional<CachedRange> {
+    if (R.isInvalid()) return CachedRange();
+    if (!R.getBegin().isFileID() || !R.getEnd().isFileID()) return std::nullopt;
+    auto [BeginFile, Begin] = SM.getDecomposedLoc(R.getBegin());
+    auto [EndFile, End] = SM.getDecomposedLoc(R.getEnd());
+    if (BeginFile != Text->File || EndFile != Text->File ||
+        Begin < Text->Offset || End < Begin ||
+        End > Text->Offset + Text->Text.size())
+      return std::nullopt;
+    return CachedRange{true, R.isTokenRange(), Begin - Text->Offset,
+                       End - Text->Offset};
+  };
+
+  std::vector<const ValueDecl *> Referenced;
+  std::vector<CachedDiagnostic> Cached;
+  for (const PointerNullabilityDiagnostic &Diag : Diags) {
+    std::optional<CachedRange> Range = Encode(Diag.Range);
+    std::optional<CachedRange> NoteRange = Encode(Diag.NoteRange);
+    if (!Range || !NoteRange) return;
+    CachedDiagnostic &C = Cached.emplace_back();
+    C.Code = Diag.Code;
+    C.Ctx = Diag.Ctx;
+    C.Range = *Range;
+    C.NoteRange = *NoteRange;
+    if (Diag.Callee) {
+      if (Referenced.empty()) Referenced = getReferencedDecls(Func);
+      auto It = llvm::find(Referenced, Diag.Callee);
+      if (It == Referenced.end()) return;
+      C.Callee = It - Referenced.begin();
+    }
+    if (Diag.ParamName) C.ParamName = Diag.ParamName->getName().str();
+  }
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+  if (Entries.size() >= MaxEntries) Entries.clear();
+  Entries.insert_or_assign(Key, std::move(Cached));
+}
+
+namespace {
+// Finds an expression that diagnosis may have something to say about: one of
+// supported pointer type, or a null pointer constant (which may initialize a
+// pointer without an implicit conversion, e.g. in a member initializer).
+class PointerExprFinder : public RecursiveASTVisitor<PointerExprFinder> {
+ public:
+  bool shouldVisitImplicitCode() const { return true; }
+
+  // Returns false, stopping the traversal, on the first expression found.
+  bool VisitExpr(const Expr *E) {
+    QualType T = E->getType();
+    if (T.isNull() || !(T->isNullPtrType() || isSupportedPointerType(T)))
+      return true;
+    // A decayed string literal is never null, and can only cause a diagnostic
+    // once it is stored in or passed through something else of pointer type.
+    if (const auto *Cast = dyn_cast<ImplicitCastExpr>(E);
+        Cast && Cast->getCastKind() == CK_ArrayToPointerDecay &&
+        isa<StringLiteral, PredefinedExpr>(Cast->getSubExpr()->IgnoreParens()))
+      return true;
+    return false;
+  }
+};
+
+// Returns whether the body (or constructor initializers) of `Func` contain any
+// pointer expressions. If not, the dataflow analysis can't find anything to
+// diagnose, and needn't be run.
+bool involvesPointers(const FunctionDecl &Func) {
+  PointerExprFinder Finder;
+  if (const auto *Ctor = dyn_cast<CXXConstructorDecl>(&Func))
+    for (const CXXCtorInitializer *Init : Ctor->inits())
+      if (!Finder.TraverseStmt(Init->getInit())) return true;
+  return !Finder.TraverseStmt(Func.getBody());
+}
+
+// Forwards to a solver that can be replaced between analyses. This lets the
+// functions diagnosed with one `DataflowAnalysisContext` each have a fresh
+// solver, and so their own SAT iteration budget.
+//
+// Once past the deadline (if any), queries time out without reaching the inner
+// solver, so that the rest of the analysis finishes quickly. A query that is
+// already running is not interrupted.
+class ReplaceableSolver : public dataflow::Solver {
+ public:
+  void reset(std::unique_ptr<dataflow::Solver> S,
+             std::optional<std::chrono::steady_clock::time_point> D) {
+    Inner = std::move(S);
+    Deadline = D;
+    PassedDeadline = false;
+  }
+
+  Result solve(llvm::ArrayRef<const dataflow::Formula *> Vals) override {
+    if (Deadline && std::chrono::steady_clock::now() >= *Deadline)
+      PassedDeadline = true;
+    if (PassedDeadline) return Result::TimedOut();
+    return Inner->solve(Vals);
+  }
+
+  bool reachedLimit() const override { return Inner->reachedLimit(); }
+
+  bool passedDeadline() const { return PassedDeadline; }
+
+ private:
+  std::unique_ptr<dataflow::Solver> Inner;
+  std::optional<std::chrono::steady_clock::time_point> Deadline;
+  bool PassedDeadline = false;
+};
+
+// The state that diagnosis of a function doesn't depend on, and can be shared
+// by the diagnosis of the declarations of a TU.
+//
+// This includes the arena (and the rest of the `DataflowAnalysisContext`), the
+// analysis and its non-flow-sensitive state (e.g. the nullability of each
+// expression and its "top" storage locations), the nullability of types, and
+// the diagnosers.
+class DiagnosisState {
+ public:
+  DiagnosisState(ASTContext &Ctx, const NullabilityPragmas &Pragmas,
+                 const SolverFactory &MakeSolver,
+                 const DiagnosisOptions &Options)
+      : Ctx(Ctx),
+        Pragmas(Pragmas),
+        MakeSolver(MakeSolver),
+        Options(Options),
+        Defaults(Ctx, Pragmas) {
+    Defaults.Cache = &TypeCache;
+  }
+
+  llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>> diagnose(
+      const ValueDecl *VD);
+
+  const DiagnosisStats &stats() const { return Stats; }
+
+ private:
+  // The time by which analysis of a function starting now must be done.
+  std::optional<std::chrono::steady_clock::time_point> functionDeadline() const;
+
+  // Creates the state needed to analyze a function body that refers to
+  // `Fields`, if not done already or if it has to be released first.
+  void initAnalysis(const dataflow::FieldSet &Fields) {
+    // The globals that earlier functions created in the shared context only
+    // have the fields that the context modeled then.
+    if (Analysis && !ContextFields.covers(Fields)) ReleaseAnalysis = true;
+    if (ReleaseAnalysis) {
+      // The analysis refers to the context's arena.
+      Analysis.reset();
+      AnalysisContext.reset();
+      ReleaseAnalysis = false;
+      ++Stats.ReleasedStates;
+    }
+    if (Analysis) return;
+    AnalysisContext =
+        std::make_unique<dataflow::DataflowAnalysisContext>(Solver);
+    Environment Env(*AnalysisContext);
+    Analysis = std::make_unique<PointerNullabilityAnalysis>(Ctx, Env, Pragmas,
+                                                            &TypeCache);
+    // After the analysis has set up the synthetic fields.
+    ContextFields.seed(*AnalysisContext, Ctx, Fields);
+    Analysis->setWideningThreshold(Options.WideningThreshold);
+    if (Options.SummarizeFunctions) {
+      // The summaries don't refer to the state released above.
+      if (!Summaries) Summaries = FunctionSummaries::compute(Ctx, Pragmas);
+      Analysis->assignNullabilityOverride([this](const Decl &D) {
+        return Summaries->returnOverride(D);
+      });
+    }
+    DiagnoserBefore =
+        pointerNullabilityDiagnoserBefore(Summaries ? &*Summaries : nullptr);
+    DiagnoserAfter = pointerNullabilityDiagnoserAfter(AllowedMovedFromNonnull);
+  }
+
+  ASTContext &Ctx;
+  const NullabilityPragmas &Pragmas;
+  const SolverFactory &MakeSolver;
+  DiagnosisOptions Options;
+  TypeNullabilityCache TypeCache;
+  TypeNullabilityDefaults Defaults;
+
+  ReplaceableSolver Solver;
+  std::unique_ptr<dataflow::DataflowAnalysisContext> AnalysisContext;
+  std::unique_ptr<PointerNullabilityAnalysis> Analysis;
+  // The fields that `AnalysisContext` models.
+  SharedContextFields ContextFields;
+  // Set after analyzing a function of at least
+  // `Options.ReleaseStateAfterBlocks` blocks, or before one that refers to
+  // fields that `AnalysisContext` doesn't model, to release `AnalysisContext`
+  // and `Analysis` before analyzing it.
+  bool ReleaseAnalysis = false;
+  // Set if `Options.SummarizeFunctions`.
+  std::optional<FunctionSummaries> Summaries;
+  // Reassigned for each function; `DiagnoserAfter` refers to it.
+  AllowedMovedFromNonnullSmartPointerExprs AllowedMovedFromNonnull;
+  DiagTransferFunc DiagnoserBefore;
+  DiagTransferFunc DiagnoserAfter;
+
+  DiagnosisStats Stats;
+};
+
+void addStats(const DiagnosisStats &From, DiagnosisStats &To) {
+  To.AnalyzedFunctions += From.AnalyzedFunctions;
+  To.SkippedFunctions += From.SkippedFunctions;
+  To.FailedFunctions += From.FailedFunctions;
+  To.BudgetExceededFunctions += From.BudgetExceededFunctions;
+  To.CachedFunctions += From.CachedFunctions;
+  To.ReleasedStates += From.ReleasedStates;
+}
+
+std::optional<std::chrono::steady_clock::time_point>
+DiagnosisState::functionDeadline() const {
+  std::optional<std::chrono::steady_clock::time_point> Result =
+      Options.Deadline;
+  if (Options.FunctionTimeLimit) {
+    auto End = std::chrono::steady_clock::now() + *Options.FunctionTimeLimit;
+    if (!Result || End < *Result) Result = End;
+  }
+  return Result;
+}
+
 llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
-diagnosePointerNullability(const ValueDecl *VD,
-                           const NullabilityPragmas &Pragmas,
-                           const SolverFactory &MakeSolver) {
+DiagnosisState::diagnose(const ValueDecl *VD) {
   // This limit is set based on empirical observations. Mostly, it is a rough
   // proxy for a line between "finite" and "effectively infinite", rather than a
   // strict limit on resource use.
@@ -670,9 +1089,6 @@ diagnosePointerNullability(const ValueDecl *VD,
   llvm::SmallVector<PointerNullabilityDiagnostic> Diags;
   if (VD->isTemplated()) return Diags;
 
-  ASTContext &Ctx = VD->getASTContext();
-  TypeNullabilityDefaults Defaults{Ctx, Pragmas};
-
   checkAnnotationsConsistent(VD, Diags, Defaults);
 
   const auto *Func = dyn_cast<FunctionDecl>(VD);
@@ -685,45 +1101,271 @@ diagnosePointerNullability(const ValueDecl *VD,
   // analyze forward-declared functions only once.
   if (!Func->doesThisDeclarationHaveABody()) return Diags;
 
-  AllowedMovedFromNonnullSmartPointerExprs AllowedMovedFromNonnull(Func);
+  // Skip building the CFG and setting up the analysis if there's nothing
+  // for them to check.
+  if (!involvesPointers(*Func)) {
+    ++Stats.SkippedFunctions;
+    return Diags;
+  }
+
+  // An unchanged function has the same findings as before, unless they depend
+  // on the bodies of other functions.
+  std::optional<uint64_t> CacheKey;
+  if (Options.Cache && !Options.SummarizeFunctions) {
+    CacheKey = DiagnosisCache::key(*Func, Defaults, Options.WideningThreshold);
+    if (CacheKey && Options.Cache->lookup(*CacheKey, *Func, Diags)) {
+      ++Stats.CachedFunctions;
+      return Diags;
+    }
+  }
+  ++Stats.AnalyzedFunctions;
+
+  // Findings from the analysis are dropped if it runs out of time, but the
+  // ones above don't depend on it.
+  const size_t NumDiagsBeforeAnalysis = Diags.size();
+  auto BudgetExceeded = [&] {
+    ++Stats.BudgetExceededFunctions;
+    Diags.truncate(NumDiagsBeforeAnalysis);
+    Diags.push_back({PointerNullabilityDiagnostic::ErrorCode::BudgetExceeded,
+                     PointerNullabilityDiagnostic::Context::Other,
+                     CharSourceRange::getTokenRange(Func->getSourceRange())});
+    return Diags;
+  };
+  std::optional<std::chrono::steady_clock::time_point> Deadline =
+      functionDeadline();
+  if (Deadline && std::chrono::steady_clock::now() >= *Deadline)
+    return BudgetExceeded();
+
+  initAnalysis(dataflow::getReferencedDecls(*Func).Fields);
+  AllowedMovedFromNonnull = AllowedMovedFromNonnullSmartPointerExprs(Func);
 
   // TODO(b/332565018): it would be nice to have some common pieces (limits,
   // adorning, error-handling) reused. diagnoseFunction() is too restrictive.
   auto CFG = dataflow::AdornedCFG::build(*Func);
   if (!CFG) return CFG.takeError();
-
-  std::unique_ptr<dataflow::Solver> Solver = MakeSolver();
-  dataflow::DataflowAnalysisContext AnalysisContext(*Solver);
-  Environment Env(AnalysisContext, *Func);
-
-  PointerNullabilityAnalysis Analysis(Ctx, Env, Pragmas);
+  // Whether or not the analysis succeeds, the environments of a large function
+  // leave many formulas in the arena.
+  if (Options.ReleaseStateAfterBlocks &&
+      CFG->getCFG().size() >= Options.ReleaseStateAfterBlocks)
+    ReleaseAnalysis = true;
+
+  Solver.reset(MakeSolver(), Deadline);
+  Environment Env(*AnalysisContext, *Func);
+  AnalysisMemoryStats MemoryStats;
+  const uint64_t AtomsBefore = nullabilityAtomsCreated();
+  if (Options.MemoryStats) {
+    MemoryStats.ExprNullabilityEntries = Analysis->exprNullabilityEntries();
+    MemoryStats.TopStorageLocations = Analysis->topStorageLocations();
+  }
 
   dataflow::CFGEltCallbacks<PointerNullabilityAnalysis> PostAnalysisCallbacks;
   PostAnalysisCallbacks.Before =
-      [&, Diagnoser = pointerNullabilityDiagnoserBefore()](
-          const CFGElement &Elt,
+      [&](const CFGElement &Elt,
           const dataflow::DataflowAnalysisState<PointerNullabilityLattice>
-              &State) mutable {
-        auto EltDiagnostics = Diagnoser(Elt, Ctx, {State.Lattice, State.Env});
+              &State) {
+        auto EltDiagnostics =
+            DiagnoserBefore(Elt, Ctx, {State.Lattice, State.Env});
         llvm::move(EltDiagnostics, std::back_inserter(Diags));
       };
   PostAnalysisCallbacks.After =
-      [&,
-       Diagnoser = pointerNullabilityDiagnoserAfter(AllowedMovedFromNonnull)](
-          const CFGElement &Elt,
+      [&](const CFGElement &Elt,
           const dataflow::DataflowAnalysisState<PointerNullabilityLattice>
-              &State) mutable {
-        auto EltDiagnostics = Diagnoser(Elt, Ctx, {State.Lattice, State.Env});
+              &State) {
+        auto EltDiagnostics =
+            DiagnoserAfter(Elt, Ctx, {State.Lattice, State.Env});
         llvm::move(EltDiagnostics, std::back_inserter(Diags));
       };
   auto Result = dataflow::runDataflowAnalysis(
-      *CFG, Analysis, Env, PostAnalysisCallbacks, MaxBlockVisits);
-  if (!Result) return Result.takeError();
-  if (Solver->reachedLimit())
+      *CFG, *Analysis, Env, PostAnalysisCallbacks, MaxBlockVisits);
+  // Timed-out queries make the findings unreliable, whether or not the
+  // analysis converged.
+  if (Solver.passedDeadline()) {
+    llvm::consumeError(Result.takeError());
+    return BudgetExceeded();
+  }
+  if (!Result) {
+    ++Stats.FailedFunctions;
+    return Result.takeError();
+  }
+  if (Solver.reachedLimit()) {
+    ++Stats.FailedFunctions;
     return llvm::createStringError(llvm::errc::interrupted,
                                    "SAT solver timed out");
+  }
+  if (Options.MemoryStats) {
+    for (const auto &BlockState : *Result) {
+      if (!BlockState) continue;
+      ++MemoryStats.RetainedEnvironments;
+      unsigned Values = BlockState->Lattice.constMethodReturnValues();
+      MemoryStats.ConstMethodReturnValues += Values;
+      MemoryStats.MaxConstMethodReturnValues =
+          std::max(MemoryStats.MaxConstMethodReturnValues, Values);
+    }
+    MemoryStats.ArenaAtoms = nullabilityAtomsCreated() - AtomsBefore;
+    MemoryStats.ExprNullabilityEntries =
+        Analysis->exprNullabilityEntries() - MemoryStats.ExprNullabilityEntries;
+    MemoryStats.TopStorageLocations =
+        Analysis->topStorageLocations() - MemoryStats.TopStorageLocations;
+    Options.MemoryStats(*Func, MemoryStats);
+  }
 
+  if (CacheKey)
+    Options.Cache->insert(*CacheKey, *Func,
+                          llvm::ArrayRef<PointerNullabilityDiagnostic>(Diags)
+                              .drop_front(NumDiagsBeforeAnalysis));
   return Diags;
 }
 
+// Finds the declarations to diagnose in a TU, in source order.
+class DiagnosableDeclFinder
+    : public RecursiveASTVisitor<DiagnosableDeclFinder> {
+ public:
+  std::vector<const ValueDecl *> Decls;
+
+  bool shouldVisitTemplateInstantiations() const { return true; }
+
+  bool VisitValueDecl(const ValueDecl *VD) {
+    // Parameters are checked as part of their function.
+    if (!isa<ParmVarDecl>(VD)) Decls.push_back(VD);
+    return true;
+  }
+};
+}  // namespace
+
+llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+diagnosePointerNullability(const ValueDecl *VD,
+                           const NullabilityPragmas &Pragmas,
+                           const SolverFactory &MakeSolver,
+                           const DiagnosisOptions &Options) {
+  return DiagnosisState(VD->getASTContext(), Pragmas, MakeSolver, Options)
+      .diagnose(VD);
+}
+
+void diagnosePointerNullability(llvm::ArrayRef<const ValueDecl *> Decls,
+                                const NullabilityPragmas &Pragmas,
+                                DiagnosisCallback Callback,
+                                const SolverFactory &MakeSolver,
+                                DiagnosisStats *Stats,
+                                const DiagnosisOptions &Options) {
+  if (Decls.empty()) return;
+  DiagnosisState State(Decls.front()->getASTContext(), Pragmas, MakeSolver,
+                       Options);
+  for (const ValueDecl *VD : Decls) Callback(*VD, State.diagnose(VD));
+  if (Stats) addStats(State.stats(), *Stats);
+}
+
+void diagnoseTranslationUnit(ASTContext &Ctx,
+                             const NullabilityPragmas &Pragmas,
+                             DiagnosisCallback Callback,
+                             const SolverFactory &MakeSolver,
+                             DiagnosisStats *Stats,
+                             const DiagnosisOptions &Options) {
+  DiagnosableDeclFinder Finder;
+  Finder.TraverseAST(Ctx);
+  diagnosePointerNullability(Finder.Decls, Pragmas, Callback, MakeSolver,
+                             Stats, Options);
+}
+
+llvm::Expected<std::vector<std::string>> diagnoseTranslationUnitInParallel(
+    unsigned Workers,
+    llvm::function_ref<void(unsigned Worker, TUDiagnoser)> ParseTU,
+    DiagnosisRenderer Render, const SolverFactory &MakeSolver,
+    DiagnosisStats *Stats, const DiagnosisOptions &Options) {
+  if (Workers == 0) Workers = 1;
+
+  std::mutex Mu;
+  // The number of declarations, as found by the first worker to finish parsing.
+  std::optional<size_t> NumDecls;
+  // Sized once `NumDecls` is set. Each element is then written by only the
+  // worker that took its index from `Next`.
+  std::vector<std::string> Results;
+  std::atomic<size_t> Next = 0;
+  // Whether each worker got an AST. (Not a `std::vector<bool>`, whose elements
+  // can't be written from different threads.)
+  std::vector<char> Parsed(Workers, false);
+
+  auto RunWorker = [&](unsigned Worker) {
+    ParseTU(Worker, [&](ASTContext &Ctx, const NullabilityPragmas &Pragmas) {
+      Parsed[Worker] = true;
+      DiagnosableDeclFinder Finder;
+      Finder.TraverseAST(Ctx);
+      {
+        std::lock_guard<std::mutex> Lock(Mu);
+        if (!NumDecls) {
+          NumDecls = Finder.Decls.size();
+          Results.resize(*NumDecls);
+        } else if (*NumDecls != Finder.Decls.size()) {
+          // Indices would not refer to the same declarations.
+          llvm::errs() << "Worker " << Worker << " found "
+                       << Finder.Decls.size() << " declarations rather than "
+                       << *NumDecls << ", skipping\n";
+          return;
+        }
+      }
+      DiagnosisState State(Ctx, Pragmas, MakeSolver, Options);
+      for (size_t I = Next++; I < Finder.Decls.size(); I = Next++) {
+        const ValueDecl *VD = Finder.Decls[I];
+        Results[I] = Render(*VD, State.diagnose(VD));
+      }
+      if (Stats) {
+        std::lock_guard<std::mutex> Lock(Mu);
+        addStats(State.stats(), *Stats);
+      }
+    });
+  };
+
+  std::vector<std::thread> Threads;
+  for (unsigned Worker = 1; Worker < Workers; ++Worker)
+    Threads.emplace_back(RunWorker, Worker);
+  RunWorker(0);
+  for (auto &Thread : Threads) Thread.join();
+  for (unsigned Worker = 0; Worker < Workers; ++Worker) {
+    if (!Parsed[Worker])
+      return llvm::createStringError(
+          llvm::inconvertibleErrorCode(),
+          "worker " + std::to_string(Worker) +
+              " could not parse the translation unit");
+  }
+  return Results;
+}
+
+namespace {
+llvm::StringRef describe(PointerNullabilityDiagnostic::ErrorCode Code) {
+  switch (Code) {
+    case PointerNullabilityDiagnostic::ErrorCode::ExpectedNonnull:
+      return "expected nonnull";
+    case PointerNullabilityDiagnostic::ErrorCode::InconsistentAnnotations:
+      return "inconsistent annotations";
+    case PointerNullabilityDiagnostic::ErrorCode::
+        AccessingMovedFromNonnullPointer:
+      return "accessing moved-from nonnull pointer";
+    case PointerNullabilityDiagnostic::ErrorCode::Untracked:
+      return "untracked pointer";
+    case PointerNullabilityDiagnostic::ErrorCode::AssertFailed:
+      return "nullability assertion failed";
+    case PointerNullabilityDiagnostic::ErrorCode::BudgetExceeded:
+      return "analysis budget exceeded";
+  }
+  llvm_unreachable("unknown error code");
+}
+}  // namespace
+
+std::string renderDiagnoses(
+    const ValueDecl &VD,
+    llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>> Diags) {
+  const SourceManager &SM = VD.getASTContext().getSourceManager();
+  std::string Out;
+  llvm::raw_string_ostream OS(Out);
+  if (!Diags) {
+    OS << VD.getLocation().printToString(SM) << ": error: "
+       << VD.getQualifiedNameAsString() << ": "
+       << llvm::toString(Diags.takeError()) << "\n";
+    return Out;
+  }
+  for (const auto &Diag : *Diags)
+    OS << Diag.Range.getBegin().printToString(SM)
+       << ": warning: " << describe(Diag.Code) << "\n";
+  return Out;
+}
+
 }  // namespace clang::tidy::nullability
@@ -5,18 +5,31 @@
 #ifndef CRUBIT_NULLABILITY_POINTER_NULLABILITY_DIAGNOSIS_H_
 #define CRUBIT_NULLABILITY_POINTER_NULLABILITY_DIAGNOSIS_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/base/nullability.h"
+#include "absl/container/flat_hash_map.h"
 #include "nullability/pointer_nullability_analysis.h"
 #include "nullability/pragma.h"
+#include "nullability/type_nullability.h"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/Analysis/FlowSensitive/Solver.h"
 #include "clang/Basic/IdentifierTable.h"
 #include "clang/Basic/SourceLocation.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Error.h"
 
 namespace clang {
 namespace tidy {
@@ -36,6 +49,9 @@ struct PointerNullabilityDiagnostic {
     Untracked,
     /// A nullability assertion was violated.
     AssertFailed,
+    /// The function's analysis ran out of time (see `DiagnosisOptions`), so
+    /// its body was not fully checked. `Range` covers the function.
+    BudgetExceeded,
   };
   ErrorCode Code;
   /// Context in which the error occurred.
@@ -69,6 +85,133 @@ struct PointerNullabilityDiagnostic {
 /// `diagnosePointerNullability()`.
 std::unique_ptr<dataflow::Solver> makeDefaultSolverForDiagnosis();
 
+/// The findings of the analysis of function bodies, kept between diagnoses of
+/// successive parses of the same code (e.g. as an editor re-checks a file after
+/// each change), so that only the functions affected by a change are analyzed
+/// again.
+///
+/// A function's findings are keyed on the text of its definition, its body
+/// after macro expansion, the default nullability of its file (i.e. its
+/// pragma), and the type and nullability of each declaration it refers to.
+/// Their locations are stored relative to the start of the definition, so
+/// edits elsewhere in the file don't invalidate them. Findings that point
+/// outside of the definition (e.g. into a macro), and analyses that fail or
+/// run out of time, are not cached.
+///
+/// Thread-safe: it may be shared by the workers of
+/// `diagnoseTranslationUnitInParallel()`.
+class DiagnosisCache {
+ public:
+  /// `MaxEntries` bounds memory use; once it is reached, the cache is emptied,
+  /// as most entries are then for versions of functions that have since been
+  /// edited.
+  explicit DiagnosisCache(size_t MaxEntries = 1 << 14)
+      : MaxEntries(MaxEntries) {}
+
+  /// Returns the key of the findings for the body of `Func`, or nullopt if they
+  /// can't be cached (e.g. the definition is spelled by a macro).
+  static std::optional<uint64_t> key(const FunctionDecl &Func,
+                                     const TypeNullabilityDefaults &Defaults,
+                                     unsigned WideningThreshold);
+
+  /// If findings are cached under `Key`, appends them to `Diags`, located in
+  /// the AST of `Func`, and returns true.
+  bool lookup(uint64_t Key, const FunctionDecl &Func,
+              llvm::SmallVectorImpl<PointerNullabilityDiagnostic> &Diags);
+
+  /// Caches `Diags`, the findings for the body of `Func`, under `Key`.
+  void insert(uint64_t Key, const FunctionDecl &Func,
+              llvm::ArrayRef<PointerNullabilityDiagnostic> Diags);
+
+  uint64_t hits() const { return Hits; }
+  uint64_t misses() const { return Misses; }
+  size_t size() const {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return Entries.size();
+  }
+
+ private:
+  // A source range, as offsets from the start of the function definition.
+  struct CachedRange {
+    bool Valid = false;
+    bool TokenRange = false;
+    unsigned Begin = 0;
+    unsigned End = 0;
+  };
+  struct CachedDiagnostic {
+    PointerNullabilityDiagnostic::ErrorCode Code;
+    PointerNullabilityDiagnostic::Context Ctx;
+    CachedRange Range;
+    CachedRange NoteRange;
+    // The index of `Callee` among the declarations the function refers to.
+    std::optional<unsigned> Callee;
+    std::optional<std::string> ParamName;
+  };
+
+  size_t MaxEntries;
+  mutable std::mutex Mutex;
+  absl::flat_hash_map<uint64_t, std::vector<CachedDiagnostic>> Entries;
+  std::atomic<uint64_t> Hits = 0;
+  std::atomic<uint64_t> Misses = 0;
+};
+
+/// Measures of the memory that the analysis of one function body used, to tell
+/// which of its structures dominate on large functions.
+struct AnalysisMemoryStats {
+  /// Blocks whose state (an `Environment` and lattice element) was retained
+  /// until the analysis converged.
+  unsigned RetainedEnvironments = 0;
+  /// Atoms created in the arena for nullability by the analysis (see
+  /// `nullabilityAtomsCreated()`). The arena doesn't count the formulas that
+  /// it creates.
+  uint64_t ArenaAtoms = 0;
+  /// Entries added to the expression nullability map, and "top" storage
+  /// locations created. This state is shared by the functions of a batch, so
+  /// only the ones new to this function are counted.
+  size_t ExprNullabilityEntries = 0;
+  size_t TopStorageLocations = 0;
+  /// The const method return values tracked by the retained block states: in
+  /// total, and by the largest one.
+  size_t ConstMethodReturnValues = 0;
+  unsigned MaxConstMethodReturnValues = 0;
+};
+
+/// Settings that bound the work done by diagnosis.
+struct DiagnosisOptions {
+  /// A nonzero `WideningThreshold` bounds how often loops are revisited before
+  /// the null state of pointers is widened to Top (see
+  /// `PointerNullabilityAnalysis::setWideningThreshold()`).
+  unsigned WideningThreshold = 0;
+  /// The wall-clock time allowed for analyzing each function body.
+  std::optional<std::chrono::steady_clock::duration> FunctionTimeLimit;
+  /// A wall-clock time by which all diagnosis should be done, e.g. for a whole
+  /// TU. Function bodies reached after this are not analyzed.
+  std::optional<std::chrono::steady_clock::time_point> Deadline;
+  /// Whether to summarize the functions defined in the TU (see
+  /// `FunctionSummaries`), so that calls to them are checked against what
+  /// their bodies do when they aren't annotated. This analyzes every function
+  /// of the TU once more up front, so it pays off only when diagnosing a batch
+  /// of declarations or the whole TU.
+  bool SummarizeFunctions = false;
+  /// If set, the findings for function bodies are reused from and stored in
+  /// `Cache`. It is not used with `SummarizeFunctions`, as the findings then
+  /// depend on the bodies of other functions.
+  absl::Nullable<DiagnosisCache *> Cache = nullptr;
+  /// If nonzero, the state shared by the functions of a batch (the arena with
+  /// the formulas of all the environments analyzed so far, and the
+  /// non-flow-sensitive state of the analysis) is released after analyzing a
+  /// function whose CFG has at least this many blocks. What a large (e.g.
+  /// generated) function created then doesn't stay alive, and add to the peak
+  /// memory, while the rest of the batch is diagnosed. The findings don't
+  /// change, but the state is created again for the next function.
+  unsigned ReleaseStateAfterBlocks = 0;
+  /// If set, receives the memory measures of each function body whose analysis
+  /// converged. `diagnoseTranslationUnitInParallel()` calls it from several
+  /// threads at once.
+  std::function<void(const FunctionDecl &, const AnalysisMemoryStats &)>
+      MemoryStats;
+};
+
 /// Checks that nullable pointers are used safely, using nullability information
 /// that is collected by `PointerNullabilityAnalysis`.
 ///
@@ -80,10 +223,105 @@ std::unique_ptr<dataflow::Solver> makeDefaultSolverForDiagnosis();
 /// are consistent with the annotations on its canonical declaration.
 ///
 /// Returns an empty vector when no issues are found in the code.
+///
+/// If the analysis of a function body runs past the time limits in `Options`,
+/// it stops early, and its findings are replaced by a single `BudgetExceeded`
+/// diagnostic. This is not an error: the checks that don't need the analysis
+/// (e.g. of annotation consistency) are still reported.
 llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
 diagnosePointerNullability(
     const ValueDecl *VD, const NullabilityPragmas &Pragmas,
-    const SolverFactory &MakeSolver = makeDefaultSolverForDiagnosis);
+    const SolverFactory &MakeSolver = makeDefaultSolverForDiagnosis,
+    const DiagnosisOptions &Options = {});
+
+/// Counts of the work done by diagnosis of a batch of declarations.
+struct DiagnosisStats {
+  /// Function definitions that were analyzed with the dataflow framework.
+  unsigned AnalyzedFunctions = 0;
+  /// Function definitions whose bodies involve no pointers, and so were
+  /// checked without running the analysis.
+  unsigned SkippedFunctions = 0;
+  /// Analyzed functions whose analysis did not converge within its limits
+  /// (or timed out in the solver), and so produced an error.
+  unsigned FailedFunctions = 0;
+  /// Analyzed functions whose analysis was stopped by the time limits.
+  unsigned BudgetExceededFunctions = 0;
+  /// Function definitions whose findings were reused from
+  /// `DiagnosisOptions::Cache` instead of being analyzed.
+  unsigned CachedFunctions = 0;
+  /// Times the shared analysis state was released: after a large function (see
+  /// `DiagnosisOptions::ReleaseStateAfterBlocks`), or before a function that
+  /// refers to fields that weren't modeled when the storage locations of the
+  /// globals were created.
+  unsigned ReleasedStates = 0;
+};
+
+/// Receives the result of diagnosing one declaration.
+using DiagnosisCallback = llvm::function_ref<void(
+    const ValueDecl &,
+    llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>)>;
+
+/// Diagnoses each of `Decls`, which must belong to the same TU, passing the
+/// results to `Callback` in order as they become available.
+///
+/// The results are the same as calling `diagnosePointerNullability()` on each
+/// declaration, but work that doesn't depend on the function being analyzed
+/// (such as building the diagnosers, and the type-based nullability of shared
+/// expressions) is done once. Memory used by the shared arena is only freed
+/// at the end, so very large batches should be split up.
+///
+/// If `Stats` is provided, the counts for this batch are added to it.
+void diagnosePointerNullability(
+    llvm::ArrayRef<const ValueDecl *> Decls, const NullabilityPragmas &Pragmas,
+    DiagnosisCallback Callback,
+    const SolverFactory &MakeSolver = makeDefaultSolverForDiagnosis,
+    DiagnosisStats *Stats = nullptr, const DiagnosisOptions &Options = {});
+
+/// Diagnoses all declarations in the TU (including template instantiations), as
+/// by the batch overload of `diagnosePointerNullability()`.
+void diagnoseTranslationUnit(
+    ASTContext &, const NullabilityPragmas &Pragmas, DiagnosisCallback Callback,
+    const SolverFactory &MakeSolver = makeDefaultSolverForDiagnosis,
+    DiagnosisStats *Stats = nullptr, const DiagnosisOptions &Options = {});
+
+/// Diagnoses one worker's copy of a translation unit.
+using TUDiagnoser =
+    llvm::function_ref<void(ASTContext &, const NullabilityPragmas &)>;
+
+/// Turns the result of diagnosing a declaration into text that doesn't refer
+/// to the worker's AST, e.g. by printing source locations.
+using DiagnosisRenderer = llvm::function_ref<std::string(
+    const ValueDecl &,
+    llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>)>;
+
+/// Renders the result of diagnosing `VD` as diagnose_tu_main prints it: one
+/// `<location>: warning: <description>` line per diagnostic, or an `error:`
+/// line if `VD` could not be analyzed. A `DiagnosisRenderer`.
+std::string renderDiagnoses(
+    const ValueDecl &VD,
+    llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>> Diags);
+
+/// Diagnoses the same declarations as `diagnoseTranslationUnit()`, spread
+/// across `Workers` threads.
+///
+/// The AST is not safe to share between threads, so each worker analyzes its
+/// own parse of the TU. `ParseTU(Worker, Diagnose)` is called once on each
+/// worker's thread (worker 0 runs on the calling thread), and should parse the
+/// TU and pass the result to `Diagnose`. If parsing fails, it may return
+/// without calling `Diagnose`. The other workers still take on its share, but
+/// the result is then an error, as the failure would otherwise go unnoticed.
+///
+/// Workers take declarations from a shared queue, and each has its own solver
+/// and arena. `Render` is called on the worker's thread, and `MakeSolver` may
+/// be called from several threads at once. The rendered results are returned
+/// in source order, so the output does not depend on scheduling. `Stats`, if
+/// provided, receives the totals over all workers.
+llvm::Expected<std::vector<std::string>> diagnoseTranslationUnitInParallel(
+    unsigned Workers,
+    llvm::function_ref<void(unsigned Worker, TUDiagnoser)> ParseTU,
+    DiagnosisRenderer Render,
+    const SolverFactory &MakeSolver = makeDefaultSolverForDiagnosis,
+    DiagnosisStats *Stats = nullptr, const DiagnosisOptions &Options = {});
 
 }  // namespace nullability
 }  // namespace tidy
@@ -5,7 +5,9 @@
 #include "nullability/pointer_nullability_lattice.h"
 
 #include <cassert>
+#include <cstddef>
 #include <functional>
+#include <iterator>
 #include <optional>
 
 #include "absl/base/nullability.h"
@@ -20,6 +22,7 @@
 #include "clang/Analysis/FlowSensitive/StorageLocation.h"
 #include "clang/Analysis/FlowSensitive/Value.h"
 #include "clang/Basic/LLVM.h"
+#include "llvm/ADT/Hashing.h"
 
 namespace clang::tidy::nullability {
 namespace {
@@ -45,19 +48,30 @@ absl::Nullable<const PointerTypeNullability *> getDeclNullability(
 }
 }  // namespace
 
+size_t TypeNullabilityInterner::Hash::operator()(
+    const TypeNullability &N) const {
+  llvm::hash_code Result = llvm::hash_value(N.size());
+  for (const PointerTypeNullability &P : N) {
+    Result = llvm::hash_combine(Result, P.concrete());
+    if (P.isSymbolic())
+      Result = llvm::hash_combine(Result, P.nonnullAtom(), P.nullableAtom());
+  }
+  return Result;
+}
+
 const TypeNullability &PointerNullabilityLattice::insertExprNullabilityIfAbsent(
     absl::Nonnull<const Expr *> E,
     const std::function<TypeNullability()> &GetNullability) {
   E = &dataflow::ignoreCFGOmittedNodes(*E);
   if (auto It = NFS.ExprToNullability.find(E);
       It != NFS.ExprToNullability.end())
-    return It->second;
+    return *It->second;
   // Deliberately perform a separate lookup after calling GetNullability.
   // It may invalidate iterators, e.g. inserting missing vectors for children.
-  auto [Iterator, Inserted] =
-      NFS.ExprToNullability.insert({E, GetNullability()});
+  const TypeNullability &Interned = NFS.Nullabilities.intern(GetNullability());
+  auto [Iterator, Inserted] = NFS.ExprToNullability.insert({E, &Interned});
   CHECK(Inserted) << "GetNullability inserted same " << E->getStmtClassName();
-  return Iterator->second;
+  return Interned;
 }
 
 absl::Nullable<dataflow::Value *>
@@ -65,16 +79,35 @@ PointerNullabilityLattice::getConstMethodReturnValue(
     const dataflow::RecordStorageLocation &RecordLoc,
     absl::Nonnull<const CallExpr *> CE, dataflow::Environment &Env) {
   assert(CE->getType()->isPointerType() || CE->getType()->isBooleanType());
-  auto &ObjMap = ConstMethodReturnValues[&RecordLoc];
   const FunctionDecl *DirectCallee = CE->getDirectCallee();
   if (DirectCallee == nullptr) return nullptr;
-  auto it = ObjMap.find(DirectCallee);
-  if (it != ObjMap.end()) return it->second;
+  MethodReturnValues Methods = NFS.MethodReturnValuesFactory.getEmptyMap();
+  if (const MethodReturnValues *Existing =
+          ConstMethodReturnValues.lookup(&RecordLoc)) {
+    if (Value *const *Val = Existing->lookup(DirectCallee)) return *Val;
+    Methods = *Existing;
+  }
   dataflow::Value *Val = Env.createValue(CE->getType());
-  if (Val != nullptr) ObjMap.insert({DirectCallee, Val});
+  if (Val != nullptr &&
+      NumConstMethodReturnValues < NFS.MaxConstMethodReturnValues) {
+    Methods = NFS.MethodReturnValuesFactory.add(Methods, DirectCallee, Val);
+    ConstMethodReturnValues = NFS.ConstMethodReturnValuesFactory.add(
+        ConstMethodReturnValues, &RecordLoc, Methods);
+    ++NumConstMethodReturnValues;
+  }
   return Val;
 }
 
+void PointerNullabilityLattice::clearConstMethodReturnValues(
+    const dataflow::RecordStorageLocation &RecordLoc) {
+  const MethodReturnValues *Methods =
+      ConstMethodReturnValues.lookup(&RecordLoc);
+  if (Methods == nullptr) return;
+  NumConstMethodReturnValues -= std::distance(Methods->begin(), Methods->end());
+  ConstMethodReturnValues = NFS.ConstMethodReturnValuesFactory.remove(
+      ConstMethodReturnValues, &RecordLoc);
+}
+
 void PointerNullabilityLattice::overrideNullabilityFromDecl(
     absl::Nullable<const Decl *> D, TypeNullability &N) const {
   // For now, overrides are always for pointer values only, and override only
@@ -91,28 +124,46 @@ LatticeJoinEffect PointerNullabilityLattice::join(
   // are non-identical but equivalent. This is likely to be sufficient in
   // practice, and it reduces implementation complexity considerably.
 
-  ConstMethodReturnValuesType JoinedMap;
+  // Maps are canonicalized by their factories, so when neither side has
+  // diverged we don't need to look at the entries at all.
+  if (ConstMethodReturnValues.getRootWithoutRetain() ==
+      Other.ConstMethodReturnValues.getRootWithoutRetain())
+    return LatticeJoinEffect::Unchanged;
+
+  ConstMethodReturnValuesType Joined = ConstMethodReturnValues;
   LatticeJoinEffect Effect = LatticeJoinEffect::Unchanged;
 
-  for (auto &[Loc, DeclToVal] : ConstMethodReturnValues) {
-    auto It = Other.ConstMethodReturnValues.find(Loc);
-    if (It == Other.ConstMethodReturnValues.end()) {
+  for (const auto &[Loc, Methods] : ConstMethodReturnValues) {
+    const MethodReturnValues *OtherMethods =
+        Other.ConstMethodReturnValues.lookup(Loc);
+    if (OtherMethods == nullptr) {
+      NumConstMethodReturnValues -=
+          std::distance(Methods.begin(), Methods.end());
+      Joined = NFS.ConstMethodReturnValuesFactory.remove(Joined, Loc);
       Effect = LatticeJoinEffect::Changed;
       continue;
     }
-    const auto &OtherDeclToVal = It->second;
-    auto &JoinedDeclToVal = JoinedMap[Loc];
-    for (auto [Func, Val] : DeclToVal) {
-      Value *OtherVal = OtherDeclToVal.lookup(Func);
-      if (OtherVal == nullptr || OtherVal != Val) {
+    if (Methods.getRootWithoutRetain() == OtherMethods->getRootWithoutRetain())
+      continue;
+
+    MethodReturnValues JoinedMethods = Methods;
+    for (const auto &[Func, Val] : Methods) {
+      Value *const *OtherVal = OtherMethods->lookup(Func);
+      if (OtherVal == nullptr || *OtherVal != Val) {
+        JoinedMethods =
+            NFS.MethodReturnValuesFactory.remove(JoinedMethods, Func);
+        --NumConstMethodReturnValues;
         Effect = LatticeJoinEffect::Changed;
-        continue;
       }
-      JoinedDeclToVal.insert({Func, Val});
     }
+    if (JoinedMethods.isEmpty())
+      Joined = NFS.ConstMethodReturnValuesFactory.remove(Joined, Loc);
+    else
+      Joined = NFS.ConstMethodReturnValuesFactory.add(Joined, Loc,
+                                                      JoinedMethods);
   }
 
-  ConstMethodReturnValues = JoinedMap;
+  ConstMethodReturnValues = Joined;
 
   return Effect;
 }
@@ -5,12 +5,15 @@
 #ifndef CRUBIT_NULLABILITY_POINTER_NULLABILITY_LATTICE_H_
 #define CRUBIT_NULLABILITY_POINTER_NULLABILITY_LATTICE_H_
 
+#include <cstddef>
 #include <functional>
 #include <optional>
 #include <ostream>
+#include <utility>
 
 #include "absl/base/nullability.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_set.h"
 #include "absl/log/check.h"
 #include "nullability/type_nullability.h"
 #include "clang/AST/DeclCXX.h"
@@ -22,15 +25,54 @@
 #include "clang/Analysis/FlowSensitive/Value.h"
 #include "clang/Basic/LLVM.h"
 #include "llvm/ADT/FunctionExtras.h"
+#include "llvm/ADT/ImmutableMap.h"
 
 namespace clang::tidy::nullability {
+
+/// Hash-consed storage for nullability vectors.
+///
+/// Most expressions have the same handful of nullability vectors (`[]`,
+/// `[Unspecified]`, ...), so each distinct vector is stored once and handed out
+/// by reference. References remain valid for the lifetime of the interner.
+class TypeNullabilityInterner {
+ public:
+  /// Returns the stored vector equal to `N`, adding it if it is new.
+  const TypeNullability &intern(TypeNullability N) {
+    return *Storage.insert(std::move(N)).first;
+  }
+
+  /// The number of distinct vectors stored.
+  size_t size() const { return Storage.size(); }
+
+ private:
+  struct Hash {
+    size_t operator()(const TypeNullability &N) const;
+  };
+
+  absl::node_hash_set<TypeNullability, Hash> Storage;
+};
+
 class PointerNullabilityLattice {
  public:
+  // Maps a record storage location and const method to the value to return
+  // from that const method.
+  //
+  // These are persistent maps, so that copying a lattice element is O(1) and
+  // copies share structure until they diverge.
+  using MethodReturnValues =
+      llvm::ImmutableMap<const FunctionDecl *, dataflow::Value *>;
+  using ConstMethodReturnValuesType =
+      llvm::ImmutableMap<const dataflow::RecordStorageLocation *,
+                         MethodReturnValues>;
+
   struct NonFlowSensitiveState {
     // Nullability interpretation of types as set e.g. by per-file #pragmas.
     TypeNullabilityDefaults Defaults;
 
-    absl::flat_hash_map<const Expr *, TypeNullability> ExprToNullability;
+    // Owns the vectors that ExprToNullability points to.
+    TypeNullabilityInterner Nullabilities;
+    absl::flat_hash_map<const Expr *, absl::Nonnull<const TypeNullability *>>
+        ExprToNullability;
     // Overridden symbolic nullability for pointer-typed decls.
     // These are set by PointerNullabilityAnalysis::assignNullabilityVariable,
     // and take precedence over the declared type and over any result from
@@ -44,20 +86,33 @@ class PointerNullabilityLattice {
     llvm::unique_function<std::optional<const PointerTypeNullability *>(
         const Decl &) const>
         ConcreteNullabilityOverride = [](const Decl &) { return std::nullopt; };
+
+    // The most const method return values tracked by one lattice element.
+    // Beyond this, calls return fresh values each time, as they would if the
+    // method weren't const. This bounds the cost of joins in code that calls
+    // many accessors.
+    unsigned MaxConstMethodReturnValues = 1024;
+    // Allocate the nodes of all lattice elements' ConstMethodReturnValues.
+    MethodReturnValues::Factory MethodReturnValuesFactory;
+    ConstMethodReturnValuesType::Factory ConstMethodReturnValuesFactory;
   };
 
-  PointerNullabilityLattice(NonFlowSensitiveState &NFS) : NFS(NFS) {}
+  PointerNullabilityLattice(NonFlowSensitiveState &NFS)
+      : NFS(NFS),
+        ConstMethodReturnValues(
+            NFS.ConstMethodReturnValuesFactory.getEmptyMap()) {}
 
   absl::Nullable<const TypeNullability *> getTypeNullability(
       absl::Nonnull<const Expr *> E) const {
     auto I = NFS.ExprToNullability.find(&dataflow::ignoreCFGOmittedNodes(*E));
-    return I == NFS.ExprToNullability.end() ? nullptr : &I->second;
+    return I == NFS.ExprToNullability.end() ? nullptr : I->second;
   }
 
   // If the `ExprToNullability` map already contains an entry for `E`, does
   // nothing. Otherwise, inserts a new entry with key `E` and value computed by
   // the provided GetNullability.
-  // Returns the (cached or computed) nullability.
+  // Returns the (cached or computed) nullability, which remains valid for the
+  // lifetime of the NonFlowSensitiveState.
   const TypeNullability &insertExprNullabilityIfAbsent(
       absl::Nonnull<const Expr *> E,
       const std::function<TypeNullability()> &GetNullability);
@@ -70,9 +125,7 @@ class PointerNullabilityLattice {
       absl::Nonnull<const CallExpr *> CE, dataflow::Environment &Env);
 
   void clearConstMethodReturnValues(
-      const dataflow::RecordStorageLocation &RecordLoc) {
-    ConstMethodReturnValues.erase(&RecordLoc);
-  }
+      const dataflow::RecordStorageLocation &RecordLoc);
 
   // If nullability for the decl D has been overridden, patch N to reflect it.
   // (N is the nullability of an access to D).
@@ -85,17 +138,19 @@ class PointerNullabilityLattice {
 
   const TypeNullabilityDefaults &defaults() const { return NFS.Defaults; }
 
+  // The number of const method return values tracked by this element.
+  unsigned constMethodReturnValues() const {
+    return NumConstMethodReturnValues;
+  }
+
  private:
   // Owned by the PointerNullabilityAnalysis object, shared by all lattice
   // elements within one analysis run.
   NonFlowSensitiveState &NFS;
 
-  // Maps a record storage location and const method to the value to return
-  // from that const method.
-  using ConstMethodReturnValuesType = llvm::SmallDenseMap<
-      const dataflow::RecordStorageLocation *,
-      llvm::SmallDenseMap<const FunctionDecl *, dataflow::Value *>>;
   ConstMethodReturnValuesType ConstMethodReturnValues;
+  // The number of entries in all of the inner maps.
+  unsigned NumConstMethodReturnValues = 0;
 };
 
 inline std::ostream &operator<<(std::ostream &OS,
@@ -8,6 +8,7 @@
 #include <memory>
 
 #include "absl/base/nullability.h"
+#include "nullability/type_nullability.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/AST/DeclCXX.h"
@@ -21,6 +22,7 @@
 #include "clang/Analysis/FlowSensitive/Value.h"
 #include "clang/Analysis/FlowSensitive/WatchedLiteralsSolver.h"
 #include "clang/Basic/LLVM.h"
+#include "clang/Basic/Specifiers.h"
 #include "clang/Testing/TestAST.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
 
@@ -90,5 +92,103 @@ TEST_F(PointerNullabilityLatticeTest, ConstMethodProducesNewValueAfterJoin) {
   EXPECT_NE(ValAfterJoin, Val2);
 }
 
+TEST_F(PointerNullabilityLatticeTest, ConstMethodValuesSharedByCopies) {
+  TestAST AST(R"cpp(
+    struct S {
+      int *property() const;
+      int *other() const;
+    };
+    void target() {
+      S s;
+      s.property();
+      s.other();
+    }
+  )cpp");
+
+  auto *SDecl =
+      cast<CXXRecordDecl>(lookup("S", *AST.context().getTranslationUnitDecl()));
+  QualType SType = AST.context().getRecordType(SDecl);
+  auto CallTo = [&](llvm::StringRef Name) {
+    return selectFirst<CallExpr>(
+        "call", match(cxxMemberCallExpr(callee(functionDecl(hasName(Name))))
+                          .bind("call"),
+                      AST.context()));
+  };
+  const CallExpr *Property = CallTo("property");
+  const CallExpr *Other = CallTo("other");
+  RecordStorageLocation Loc(SType, RecordStorageLocation::FieldToLoc(), {});
+
+  PointerNullabilityLattice Lattice1(NFS);
+  Value *Val = Lattice1.getConstMethodReturnValue(Loc, Property, Env);
+  PointerNullabilityLattice Lattice2 = Lattice1;
+  EXPECT_EQ(Lattice2.getConstMethodReturnValue(Loc, Property, Env), Val);
+
+  // An entry added to one copy only is dropped by the join, but the shared
+  // entry survives.
+  Lattice2.getConstMethodReturnValue(Loc, Other, Env);
+  EXPECT_EQ(Lattice1.join(Lattice2), LatticeJoinEffect::Unchanged);
+  EXPECT_EQ(Lattice2.join(Lattice1), LatticeJoinEffect::Changed);
+  EXPECT_EQ(Lattice2.getConstMethodReturnValue(Loc, Property, Env), Val);
+
+  Lattice1.clearConstMethodReturnValues(Loc);
+  EXPECT_NE(Lattice1.getConstMethodReturnValue(Loc, Property, Env), Val);
+}
+
+TEST_F(PointerNullabilityLatticeTest, ConstMethodValuesAreBounded) {
+  TestAST AST(R"cpp(
+    struct S {
+      int *property() const;
+    };
+    void target() {
+      S s;
+      s.property();
+    }
+  )cpp");
+
+  auto *SDecl =
+      cast<CXXRecordDecl>(lookup("S", *AST.context().getTranslationUnitDecl()));
+  QualType SType = AST.context().getRecordType(SDecl);
+  auto *CE = selectFirst<CallExpr>(
+      "call", match(cxxMemberCallExpr(callee(functionDecl(hasName("property"))))
+                        .bind("call"),
+                    AST.context()));
+  RecordStorageLocation Loc1(SType, RecordStorageLocation::FieldToLoc(), {});
+  RecordStorageLocation Loc2(SType, RecordStorageLocation::FieldToLoc(), {});
+
+  NFS.MaxConstMethodReturnValues = 1;
+  PointerNullabilityLattice Lattice(NFS);
+  Value *Val1 = Lattice.getConstMethodReturnValue(Loc1, CE, Env);
+  EXPECT_EQ(Lattice.getConstMethodReturnValue(Loc1, CE, Env), Val1);
+  // Over the limit, values are no longer remembered.
+  Value *Val2 = Lattice.getConstMethodReturnValue(Loc2, CE, Env);
+  EXPECT_NE(Lattice.getConstMethodReturnValue(Loc2, CE, Env), Val2);
+}
+
+TEST_F(PointerNullabilityLatticeTest, InternsEqualNullability) {
+  TestAST AST(R"cpp(
+    void target(int *P, int *Q) {
+      P;
+      Q;
+    }
+  )cpp");
+  auto Refs = match(ast_matchers::declRefExpr().bind("ref"), AST.context());
+  ASSERT_EQ(Refs.size(), 2);
+  const auto *P = Refs[0].getNodeAs<Expr>("ref");
+  const auto *Q = Refs[1].getNodeAs<Expr>("ref");
+
+  PointerNullabilityLattice Lattice(NFS);
+  const TypeNullability &PN = Lattice.insertExprNullabilityIfAbsent(
+      P, [] { return TypeNullability{NullabilityKind::Nullable}; });
+  const TypeNullability &QN = Lattice.insertExprNullabilityIfAbsent(
+      Q, [] { return TypeNullability{NullabilityKind::Nullable}; });
+  EXPECT_EQ(&PN, &QN);
+  EXPECT_EQ(Lattice.getTypeNullability(P), &PN);
+  EXPECT_EQ(NFS.Nullabilities.size(), 1);
+
+  NFS.Nullabilities.intern({NullabilityKind::NonNull});
+  EXPECT_EQ(NFS.Nullabilities.size(), 2);
+  EXPECT_EQ(PN, TypeNullability{NullabilityKind::Nullable});
+}
+
 }  // namespace
 }  // namespace clang::tidy::nullability
@@ -0,0 +1,134 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/solver_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nullability/pointer_nullability_analysis.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace clang::tidy::nullability {
+namespace {
+using dataflow::Atom;
+using dataflow::Formula;
+using Result = dataflow::Solver::Result;
+
+// Marks a query's root formula in the key, rather than a node.
+// This is never a valid Formula::Kind.
+constexpr uint32_t RootMarker = ~uint32_t{0};
+
+// Serializes a query into a key that is independent of the numbering of atoms
+// and of the addresses of formulas.
+//
+// Each distinct formula node is written once, after its operands, as its kind
+// followed by its payload (a canonical atom number, a literal value, or the
+// node numbers of its operands). Shared subformulas are referenced by node
+// number, so the key stays linear in the size of the formula DAG.
+class Canonicalizer {
+ public:
+  explicit Canonicalizer(llvm::ArrayRef<const Formula *> Vals) {
+    for (const Formula *F : Vals) {
+      uint32_t Node = visit(*F);
+      push(RootMarker);
+      push(Node);
+    }
+  }
+
+  llvm::StringRef key() const { return Key; }
+
+  // The number of `A` in the key, if it occurs in the query.
+  std::optional<uint32_t> canonicalAtom(Atom A) const {
+    auto It = AtomIds.find(A);
+    if (It == AtomIds.end()) return std::nullopt;
+    return It->second;
+  }
+
+  // The atom in the query with canonical number `Id`.
+  Atom atom(uint32_t Id) const { return Atoms[Id]; }
+
+ private:
+  uint32_t visit(const Formula &F) {
+    if (auto It = NodeIds.find(&F); It != NodeIds.end()) return It->second;
+
+    llvm::SmallVector<uint32_t, 2> Operands;
+    for (const Formula *Operand : F.operands())
+      Operands.push_back(visit(*Operand));
+
+    push(static_cast<uint32_t>(F.kind()));
+    switch (F.kind()) {
+      case Formula::AtomRef: {
+        auto [It, Inserted] = AtomIds.try_emplace(F.getAtom(), Atoms.size());
+        if (Inserted) Atoms.push_back(F.getAtom());
+        push(It->second);
+        break;
+      }
+      case Formula::Literal:
+        push(F.literal());
+        break;
+      default:
+        for (uint32_t Operand : Operands) push(Operand);
+        break;
+    }
+    uint32_t Id = NodeIds.size();
+    NodeIds[&F] = Id;
+    return Id;
+  }
+
+  void push(uint32_t Word) {
+    Key.append(reinterpret_cast<const char *>(&Word), sizeof(Word));
+  }
+
+  std::string Key;
+  llvm::DenseMap<const Formula *, uint32_t> NodeIds;
+  llvm::DenseMap<Atom, uint32_t> AtomIds;
+  std::vector<Atom> Atoms;
+};
+}  // namespace
+
+SolverFactory SolverCache::wrap(SolverFactory Inner) {
+  return [this, Inner = std::move(Inner)]() {
+    return std::make_unique<CachingSolver>(*this, Inner());
+  };
+}
+
+Result CachingSolver::solve(llvm::ArrayRef<const Formula *> Vals) {
+  Canonicalizer Query(Vals);
+  if (auto It = Cache.Entries.find(Query.key()); It != Cache.Entries.end()) {
+    ++Cache.Hits;
+    const SolverCache::Entry &Cached = It->second;
+    if (Cached.Status == Result::Status::Unsatisfiable)
+      return Result::Unsatisfiable();
+    llvm::DenseMap<Atom, Result::Assignment> Solution;
+    for (const auto &[Id, Value] : Cached.Solution)
+      Solution[Query.atom(Id)] = Value;
+    return Result::Satisfiable(std::move(Solution));
+  }
+
+  ++Cache.Misses;
+  Result R = Inner->solve(Vals);
+  if (R.getStatus() == Result::Status::TimedOut ||
+      Cache.Entries.size() >= Cache.MaxEntries)
+    return R;
+
+  SolverCache::Entry Entry{R.getStatus(), {}};
+  if (const auto &Solution = R.getSolution())
+    for (const auto &[A, Value] : *Solution)
+      if (auto Id = Query.canonicalAtom(A))
+        Entry.Solution.push_back({*Id, Value});
+  Cache.Entries.try_emplace(Query.key(), std::move(Entry));
+  return R;
+}
+
+}  // namespace clang::tidy::nullability
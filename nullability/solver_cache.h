@@ -0,0 +1,89 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_NULLABILITY_SOLVER_CACHE_H_
+#define CRUBIT_NULLABILITY_SOLVER_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "nullability/pointer_nullability_analysis.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+
+namespace clang::tidy::nullability {
+
+/// Results of solver queries, shared between the solvers used for the
+/// different definitions in a translation unit.
+///
+/// Code that inlines the same helpers or macros produces the same queries in
+/// many functions. Each definition has its own `Arena`, so queries are keyed on
+/// a canonical form of their formulas in which atoms are numbered in order of
+/// first appearance. Queries that differ only in the naming of their atoms
+/// share an entry, and solutions are translated back into the atoms of the
+/// query being answered.
+///
+/// Not thread-safe: each thread should use its own cache.
+class SolverCache {
+ public:
+  /// `MaxEntries` bounds memory use; once it is reached, new results are no
+  /// longer stored (but existing ones are still used).
+  explicit SolverCache(size_t MaxEntries = 1 << 16) : MaxEntries(MaxEntries) {}
+
+  /// Returns a factory for solvers that consult this cache before deferring to
+  /// a solver from `Inner`. The cache must outlive the solvers.
+  ///
+  /// Each solver gets its own inner solver, so that resource limits (such as
+  /// the SAT iteration budget) still apply per definition.
+  SolverFactory wrap(SolverFactory Inner);
+
+  uint64_t hits() const { return Hits; }
+  uint64_t misses() const { return Misses; }
+  size_t size() const { return Entries.size(); }
+  /// The fraction of queries answered from the cache, or 0 if there were none.
+  double hitRate() const {
+    uint64_t Total = Hits + Misses;
+    return Total ? static_cast<double>(Hits) / Total : 0;
+  }
+
+ private:
+  friend class CachingSolver;
+
+  struct Entry {
+    dataflow::Solver::Result::Status Status;
+    /// For satisfiable queries, the assignment of each canonical atom.
+    std::vector<std::pair<uint32_t, dataflow::Solver::Result::Assignment>>
+        Solution;
+  };
+
+  size_t MaxEntries;
+  llvm::StringMap<Entry> Entries;
+  uint64_t Hits = 0;
+  uint64_t Misses = 0;
+};
+
+/// A solver that answers queries from a `SolverCache` where possible.
+/// Timed-out queries are never cached, as retrying them may succeed.
+class CachingSolver : public dataflow::Solver {
+ public:
+  CachingSolver(SolverCache &Cache, std::unique_ptr<dataflow::Solver> Inner)
+      : Cache(Cache), Inner(std::move(Inner)) {}
+
+  Result solve(llvm::ArrayRef<const dataflow::Formula *> Vals) override;
+
+  bool reachedLimit() const override { return Inner->reachedLimit(); }
+
+ private:
+  SolverCache &Cache;
+  std::unique_ptr<dataflow::Solver> Inner;
+};
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_SOLVER_CACHE_H_
@@ -0,0 +1,149 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/solver_cache.h"
+
+#include <memory>
+#include <vector>
+
+#include "clang/Analysis/FlowSensitive/Arena.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "clang/Analysis/FlowSensitive/WatchedLiteralsSolver.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+
+namespace clang::tidy::nullability {
+namespace {
+using dataflow::Arena;
+using dataflow::Atom;
+using dataflow::Formula;
+using Result = dataflow::Solver::Result;
+
+// Builds `(A & !B)` in `Arena`, burning `Skip` atoms first so that the atoms
+// are numbered differently in each arena.
+std::vector<const Formula *> query(Arena &Arena, unsigned Skip, Atom &A,
+                                   Atom &B) {
+  for (unsigned I = 0; I < Skip; ++I) Arena.makeAtom();
+  A = Arena.makeAtom();
+  B = Arena.makeAtom();
+  return {&Arena.makeAnd(Arena.makeAtomRef(A),
+                         Arena.makeNot(Arena.makeAtomRef(B)))};
+}
+
+SolverFactory watchedLiterals() {
+  return [] { return std::make_unique<dataflow::WatchedLiteralsSolver>(); };
+}
+
+// Counts its calls, and always times out.
+class TimingOutSolver : public dataflow::Solver {
+ public:
+  explicit TimingOutSolver(unsigned &Calls) : Calls(Calls) {}
+  Result solve(llvm::ArrayRef<const Formula *>) override {
+    ++Calls;
+    return Result::TimedOut();
+  }
+  bool reachedLimit() const override { return Calls > 0; }
+
+ private:
+  unsigned &Calls;
+};
+
+TEST(SolverCacheTest, SharesResultsAcrossArenas) {
+  SolverCache Cache;
+  SolverFactory MakeSolver = Cache.wrap(watchedLiterals());
+
+  Arena Arena1;
+  Atom A1, B1;
+  auto Query1 = query(Arena1, /*Skip=*/0, A1, B1);
+  Result R1 = MakeSolver()->solve(Query1);
+  ASSERT_EQ(R1.getStatus(), Result::Status::Satisfiable);
+  EXPECT_EQ(Cache.hits(), 0);
+  EXPECT_EQ(Cache.misses(), 1);
+
+  Arena Arena2;
+  Atom A2, B2;
+  auto Query2 = query(Arena2, /*Skip=*/3, A2, B2);
+  Result R2 = MakeSolver()->solve(Query2);
+  ASSERT_EQ(R2.getStatus(), Result::Status::Satisfiable);
+  EXPECT_EQ(Cache.hits(), 1);
+  EXPECT_EQ(Cache.misses(), 1);
+  EXPECT_EQ(Cache.size(), 1);
+  EXPECT_DOUBLE_EQ(Cache.hitRate(), 0.5);
+
+  // The cached solution is given in terms of the second query's atoms.
+  ASSERT_TRUE(R2.getSolution().has_value());
+  EXPECT_EQ(R2.getSolution()->lookup(A2), Result::Assignment::AssignedTrue);
+  EXPECT_EQ(R2.getSolution()->lookup(B2), Result::Assignment::AssignedFalse);
+}
+
+TEST(SolverCacheTest, CachesUnsatisfiable) {
+  SolverCache Cache;
+  SolverFactory MakeSolver = Cache.wrap(watchedLiterals());
+  for (int I = 0; I < 2; ++I) {
+    Arena Arena;
+    const Formula &X = Arena.makeAtomRef(Arena.makeAtom());
+    const Formula *Query[] = {&X, &Arena.makeNot(X)};
+    EXPECT_EQ(MakeSolver()->solve(Query).getStatus(),
+              Result::Status::Unsatisfiable);
+  }
+  EXPECT_EQ(Cache.hits(), 1);
+  EXPECT_EQ(Cache.misses(), 1);
+}
+
+TEST(SolverCacheTest, DistinguishesStructure) {
+  SolverCache Cache;
+  SolverFactory MakeSolver = Cache.wrap(watchedLiterals());
+  Arena Arena;
+  const Formula &X = Arena.makeAtomRef(Arena.makeAtom());
+  const Formula &Y = Arena.makeAtomRef(Arena.makeAtom());
+  const Formula *And[] = {&Arena.makeAnd(X, Y)};
+  const Formula *Or[] = {&Arena.makeOr(X, Y)};
+  // The same atom twice is not the same as two different atoms.
+  const Formula *SameAtom[] = {&Arena.makeAnd(X, Arena.makeNot(X))};
+  const Formula *DifferentAtoms[] = {&Arena.makeAnd(X, Arena.makeNot(Y))};
+  auto Solver = MakeSolver();
+  Solver->solve(And);
+  Solver->solve(Or);
+  EXPECT_EQ(Solver->solve(SameAtom).getStatus(), Result::Status::Unsatisfiable);
+  EXPECT_EQ(Solver->solve(DifferentAtoms).getStatus(),
+            Result::Status::Satisfiable);
+  EXPECT_EQ(Cache.hits(), 0);
+  EXPECT_EQ(Cache.size(), 4);
+}
+
+TEST(SolverCacheTest, DoesNotCacheTimeouts) {
+  SolverCache Cache;
+  unsigned Calls = 0;
+  SolverFactory MakeSolver = Cache.wrap(
+      [&] { return std::make_unique<TimingOutSolver>(Calls); });
+  Arena Arena;
+  const Formula *Query[] = {&Arena.makeAtomRef(Arena.makeAtom())};
+  auto Solver = MakeSolver();
+  EXPECT_EQ(Solver->solve(Query).getStatus(), Result::Status::TimedOut);
+  EXPECT_EQ(Solver->solve(Query).getStatus(), Result::Status::TimedOut);
+  EXPECT_EQ(Calls, 2);
+  EXPECT_TRUE(Solver->reachedLimit());
+  EXPECT_EQ(Cache.size(), 0);
+}
+
+TEST(SolverCacheTest, StopsStoringAtCapacity) {
+  SolverCache Cache(/*MaxEntries=*/1);
+  SolverFactory MakeSolver = Cache.wrap(watchedLiterals());
+  Arena Arena;
+  const Formula &X = Arena.makeAtomRef(Arena.makeAtom());
+  const Formula *First[] = {&X};
+  const Formula *Second[] = {&Arena.makeNot(X)};
+  auto Solver = MakeSolver();
+  Solver->solve(First);
+  Solver->solve(Second);
+  Solver->solve(Second);
+  Solver->solve(First);
+  EXPECT_EQ(Cache.size(), 1);
+  EXPECT_EQ(Cache.hits(), 1);
+  EXPECT_EQ(Cache.misses(), 3);
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
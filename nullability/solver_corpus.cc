@@ -0,0 +1,281 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/solver_corpus.h"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "nullability/pointer_nullability_analysis.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+namespace clang::tidy::nullability {
+namespace {
+using dataflow::Atom;
+using dataflow::Formula;
+using Result = dataflow::Solver::Result;
+
+// The code of a node of kind `K` in the query format.
+char kindCode(Formula::Kind K) {
+  switch (K) {
+    case Formula::AtomRef:
+      return 'v';
+    case Formula::Literal:
+      llvm_unreachable("literals are written as `t` or `f`");
+    case Formula::Not:
+      return 'n';
+    case Formula::And:
+      return 'a';
+    case Formula::Or:
+      return 'o';
+    case Formula::Implies:
+      return 'i';
+    case Formula::Equal:
+      return 'e';
+  }
+  llvm_unreachable("unknown formula kind");
+}
+
+llvm::StringRef statusName(Result::Status Status) {
+  switch (Status) {
+    case Result::Status::Satisfiable:
+      return "satisfiable";
+    case Result::Status::Unsatisfiable:
+      return "unsatisfiable";
+    case Result::Status::TimedOut:
+      return "timed out";
+  }
+  llvm_unreachable("unknown solver status");
+}
+
+// Numbers the nodes and atoms of a query, and writes its node lines.
+class QueryWriter {
+ public:
+  explicit QueryWriter(llvm::ArrayRef<const Formula *> Vals) {
+    for (const Formula *F : Vals) Roots.push_back(visit(*F));
+  }
+
+  void write(llvm::raw_ostream &OS) const {
+    OS << "p formula " << Atoms.size() << ' ' << Nodes.size() << ' '
+       << Roots.size() << '\n'
+       << Body;
+    for (unsigned Root : Roots) OS << "r " << Root << '\n';
+  }
+
+ private:
+  unsigned visit(const Formula &F) {
+    if (auto It = Nodes.find(&F); It != Nodes.end()) return It->second;
+
+    llvm::SmallVector<unsigned, 2> Operands;
+    for (const Formula *Operand : F.operands())
+      Operands.push_back(visit(*Operand));
+
+    llvm::raw_string_ostream OS(Body);
+    switch (F.kind()) {
+      case Formula::AtomRef: {
+        auto [It, Inserted] = Atoms.try_emplace(F.getAtom(), Atoms.size() + 1);
+        OS << "v " << It->second;
+        break;
+      }
+      case Formula::Literal:
+        OS << (F.literal() ? 't' : 'f');
+        break;
+      default:
+        OS << kindCode(F.kind());
+        for (unsigned Operand : Operands) OS << ' ' << Operand;
+        break;
+    }
+    OS << '\n';
+    unsigned Id = Nodes.size() + 1;
+    Nodes[&F] = Id;
+    return Id;
+  }
+
+  std::string Body;
+  llvm::DenseMap<const Formula *, unsigned> Nodes;
+  llvm::DenseMap<Atom, unsigned> Atoms;
+  llvm::SmallVector<unsigned> Roots;
+};
+}  // namespace
+
+void writeSolverQuery(llvm::ArrayRef<const Formula *> Vals,
+                      llvm::raw_ostream &OS,
+                      llvm::ArrayRef<std::string> Comments) {
+  for (const std::string &Comment : Comments) OS << "c " << Comment << '\n';
+  QueryWriter(Vals).write(OS);
+}
+
+llvm::Expected<std::vector<const Formula *>> readSolverQuery(
+    llvm::StringRef Text, llvm::BumpPtrAllocator &Alloc) {
+  llvm::SmallVector<llvm::StringRef> Lines;
+  Text.split(Lines, '\n');
+  std::vector<const Formula *> Nodes;
+  std::vector<const Formula *> Roots;
+  std::optional<std::pair<unsigned, unsigned>> ExpectedNodesAndRoots;
+  unsigned NumAtoms = 0;
+  for (unsigned I = 0; I < Lines.size(); ++I) {
+    llvm::StringRef Line = Lines[I].trim();
+    if (Line.empty() || Line.starts_with("c")) continue;
+    auto Malformed = [&](llvm::StringRef Message) {
+      return llvm::createStringError(
+          llvm::inconvertibleErrorCode(),
+          "line " + llvm::Twine(I + 1) + ": " + Message + ": " + Line);
+    };
+    llvm::SmallVector<llvm::StringRef, 5> Fields;
+    Line.split(Fields, ' ', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+    llvm::StringRef Code = Fields[0];
+
+    if (Code == "p") {
+      unsigned NumNodes, NumRoots;
+      if (ExpectedNodesAndRoots || Fields.size() != 5 ||
+          Fields[1] != "formula" || Fields[2].getAsInteger(10, NumAtoms) ||
+          Fields[3].getAsInteger(10, NumNodes) ||
+          Fields[4].getAsInteger(10, NumRoots))
+        return Malformed("malformed problem line");
+      ExpectedNodesAndRoots = {NumNodes, NumRoots};
+      continue;
+    }
+    if (!ExpectedNodesAndRoots)
+      return Malformed("expected the problem line first");
+
+    // The operands, which must refer to earlier nodes.
+    llvm::SmallVector<const Formula *, 2> Operands;
+    if (Code != "v") {
+      for (llvm::StringRef Field : llvm::drop_begin(Fields)) {
+        unsigned Node;
+        if (Field.getAsInteger(10, Node) || Node == 0 || Node > Nodes.size())
+          break;
+        Operands.push_back(Nodes[Node - 1]);
+      }
+    }
+    auto Arity = [&](size_t N) {
+      return Operands.size() == N && Fields.size() == N + 1;
+    };
+
+    if (Code == "r") {
+      if (!Arity(1)) return Malformed("expected a node");
+      Roots.push_back(Operands[0]);
+      continue;
+    }
+    const Formula *F = nullptr;
+    if (Code == "v") {
+      unsigned AtomNumber;
+      if (Fields.size() != 2 || Fields[1].getAsInteger(10, AtomNumber) ||
+          AtomNumber == 0 || AtomNumber > NumAtoms)
+        return Malformed("expected an atom");
+      F = &Formula::create(Alloc, Formula::AtomRef, {}, AtomNumber - 1);
+    } else if (Code == "t" || Code == "f") {
+      if (!Arity(0)) return Malformed("unexpected operands");
+      F = &Formula::create(Alloc, Formula::Literal, {}, Code == "t");
+    } else if (Code == "n") {
+      if (!Arity(1)) return Malformed("expected a node");
+      F = &Formula::create(Alloc, Formula::Not, Operands);
+    } else {
+      Formula::Kind Kind;
+      if (Code == "a")
+        Kind = Formula::And;
+      else if (Code == "o")
+        Kind = Formula::Or;
+      else if (Code == "i")
+        Kind = Formula::Implies;
+      else if (Code == "e")
+        Kind = Formula::Equal;
+      else
+        return Malformed("unknown node kind");
+      if (!Arity(2)) return Malformed("expected two nodes");
+      F = &Formula::create(Alloc, Kind, Operands);
+    }
+    Nodes.push_back(F);
+  }
+  if (!ExpectedNodesAndRoots)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "missing the problem line");
+  if (Nodes.size() != ExpectedNodesAndRoots->first ||
+      Roots.size() != ExpectedNodesAndRoots->second)
+    return llvm::createStringError(
+        llvm::inconvertibleErrorCode(),
+        "the numbers of nodes and roots don't match the problem line");
+  return Roots;
+}
+
+SolverFactory SolverCorpusRecorder::wrap(SolverFactory Inner) {
+  return [this, Inner = std::move(Inner)]() {
+    return std::make_unique<RecordingSolver>(*this, Inner());
+  };
+}
+
+void SolverCorpusRecorder::record(llvm::ArrayRef<const Formula *> Vals,
+                                  Result::Status Status,
+                                  std::chrono::microseconds Duration) {
+  // The name only depends on the query, so that each is recorded once.
+  std::string Query;
+  llvm::raw_string_ostream QueryOS(Query);
+  writeSolverQuery(Vals, QueryOS);
+  llvm::SmallString<256> Path(Dir);
+  llvm::sys::path::append(
+      Path, llvm::utohexstr(llvm::xxh3_64bits(Query), /*LowerCase=*/true) +
+                ".query");
+  if (llvm::sys::fs::exists(Path)) return;
+
+  // Written to a temporary file first, so that a concurrent replay (or
+  // recording of the same query) never sees a partial query.
+  llvm::SmallString<256> TempPath;
+  int FD;
+  if (std::error_code EC = llvm::sys::fs::createUniqueFile(
+          Path + "-%%%%%%.tmp", FD, TempPath)) {
+    llvm::errs() << Path << ": " << EC.message() << "\n";
+    return;
+  }
+  std::error_code EC;
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << "c " << statusName(Status) << " after " << Duration.count()
+       << "us\n"
+       << Query;
+    OS.close();
+    EC = OS.error();
+    OS.clear_error();
+  }
+  if (!EC) EC = llvm::sys::fs::rename(TempPath, Path);
+  if (EC) {
+    llvm::errs() << Path << ": " << EC.message() << "\n";
+    llvm::sys::fs::remove(TempPath);
+    return;
+  }
+  ++Recorded;
+}
+
+Result RecordingSolver::solve(llvm::ArrayRef<const Formula *> Vals) {
+  auto Start = std::chrono::steady_clock::now();
+  Result R = Inner->solve(Vals);
+  auto Duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - Start);
+  if (R.getStatus() == Result::Status::TimedOut ||
+      Duration >= Recorder.MinDuration)
+    Recorder.record(Vals, R.getStatus(), Duration);
+  return R;
+}
+
+}  // namespace clang::tidy::nullability
@@ -0,0 +1,106 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_NULLABILITY_SOLVER_CORPUS_H_
+#define CRUBIT_NULLABILITY_SOLVER_CORPUS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nullability/pointer_nullability_analysis.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace clang::tidy::nullability {
+
+/// Writes a solver query (the formulas that must all hold) in a DIMACS-like
+/// text format, for replaying outside of the analysis that made it:
+///
+///   c <comment>
+///   p formula <atoms> <nodes> <roots>
+///   <one line per node>
+///   r <node>            (one line per formula of the query)
+///
+/// Nodes are numbered from 1 in order, after their operands, and are written
+/// as `v <atom>` (atoms are also numbered from 1, in order of first
+/// appearance), `t`, `f`, `n <node>`, or `a`, `o`, `i` or `e` (and, or,
+/// implies, equals) followed by two nodes. Shared subformulas are written
+/// once, so the text stays linear in the size of the formula DAG, and queries
+/// that differ only in the naming of their atoms are written identically.
+///
+/// `Comments` are written as `c` lines, e.g. to describe where the query came
+/// from.
+void writeSolverQuery(llvm::ArrayRef<const dataflow::Formula *> Vals,
+                      llvm::raw_ostream &OS,
+                      llvm::ArrayRef<std::string> Comments = {});
+
+/// Reads a query written by `writeSolverQuery()`. The formulas are allocated
+/// in `Alloc` as written, without the simplifications of `dataflow::Arena`,
+/// and refer to atoms 0 to `<atoms> - 1`.
+llvm::Expected<std::vector<const dataflow::Formula *>> readSolverQuery(
+    llvm::StringRef Text, llvm::BumpPtrAllocator &Alloc);
+
+/// Records the solver queries that are expensive to answer, as a corpus of
+/// `writeSolverQuery()` files for tuning the solver and the formulas against
+/// (see solver_corpus_benchmark).
+///
+/// A query is recorded if the solver times out, e.g. by reaching its SAT
+/// iteration limit, or takes at least `MinDuration`. Each query is written to
+/// `Dir` once, named by a hash of its text.
+///
+/// Thread-safe: the solvers may be used on different threads.
+class SolverCorpusRecorder {
+ public:
+  SolverCorpusRecorder(std::string Dir, std::chrono::microseconds MinDuration)
+      : Dir(std::move(Dir)), MinDuration(MinDuration) {}
+
+  /// Returns a factory for solvers that defer to a solver from `Inner` and
+  /// record its expensive queries. The recorder must outlive the solvers.
+  SolverFactory wrap(SolverFactory Inner);
+
+  /// The number of queries written so far.
+  uint64_t recorded() const { return Recorded; }
+
+ private:
+  friend class RecordingSolver;
+
+  void record(llvm::ArrayRef<const dataflow::Formula *> Vals,
+              dataflow::Solver::Result::Status Status,
+              std::chrono::microseconds Duration);
+
+  std::string Dir;
+  std::chrono::microseconds MinDuration;
+  std::atomic<uint64_t> Recorded = 0;
+};
+
+/// A solver that records the expensive queries of another for a
+/// `SolverCorpusRecorder`.
+class RecordingSolver : public dataflow::Solver {
+ public:
+  RecordingSolver(SolverCorpusRecorder &Recorder,
+                  std::unique_ptr<dataflow::Solver> Inner)
+      : Recorder(Recorder), Inner(std::move(Inner)) {}
+
+  Result solve(llvm::ArrayRef<const dataflow::Formula *> Vals) override;
+
+  bool reachedLimit() const override { return Inner->reachedLimit(); }
+
+ private:
+  SolverCorpusRecorder &Recorder;
+  std::unique_ptr<dataflow::Solver> Inner;
+};
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_SOLVER_CORPUS_H_
@@ -0,0 +1,184 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Replays a corpus of solver queries, recorded with `-solver-corpus-dir` by
+// diagnose_tu_main or collect_evidence_main (see solver_corpus.h), against
+// each of the solvers below:
+//
+//   solver_corpus_benchmark -corpus=/tmp/corpus --benchmark_filter=Simplified
+//
+// Each query is a benchmark of each solver, named after the solver and the
+// query file, and reports whether the solver answered it within
+// -max-sat-iterations.
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/base/nullability.h"
+#include "absl/log/check.h"
+#include "third_party/benchmark/include/benchmark/benchmark.h"
+#include "nullability/solver_corpus.h"
+#include "clang/Analysis/FlowSensitive/Arena.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "clang/Analysis/FlowSensitive/WatchedLiteralsSolver.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+llvm::cl::opt<std::string> CorpusDir{
+    "corpus",
+    llvm::cl::desc("Directory of recorded solver queries (*.query)"),
+    llvm::cl::Required,
+};
+llvm::cl::opt<int64_t> MaxSATIterations{
+    "max-sat-iterations",
+    llvm::cl::desc("SAT iteration limit of the solvers, as in diagnosis"),
+    llvm::cl::init(2'000'000),
+};
+
+namespace clang::tidy::nullability {
+namespace {
+using dataflow::Arena;
+using dataflow::Formula;
+using Result = dataflow::Solver::Result;
+
+struct CorpusQuery {
+  std::string Name;
+  llvm::BumpPtrAllocator Alloc;
+  std::vector<const Formula *> Vals;
+};
+
+using SimplifiedFormulas = llvm::DenseMap<const Formula *, const Formula *>;
+
+// Rebuilds `F` in `A`, which simplifies it as the analysis would have if it
+// had built the formula there (e.g. `X & true` is `X`).
+const Formula &simplify(const Formula &F, Arena &A, SimplifiedFormulas &Memo) {
+  if (auto It = Memo.find(&F); It != Memo.end()) return *It->second;
+  auto Operand = [&](unsigned I) -> const Formula & {
+    return simplify(*F.operands()[I], A, Memo);
+  };
+  const Formula *Simplified = nullptr;
+  switch (F.kind()) {
+    case Formula::AtomRef:
+      Simplified = &A.makeAtomRef(F.getAtom());
+      break;
+    case Formula::Literal:
+      Simplified = &A.makeLiteral(F.literal());
+      break;
+    case Formula::Not:
+      Simplified = &A.makeNot(Operand(0));
+      break;
+    case Formula::And:
+      Simplified = &A.makeAnd(Operand(0), Operand(1));
+      break;
+    case Formula::Or:
+      Simplified = &A.makeOr(Operand(0), Operand(1));
+      break;
+    case Formula::Implies:
+      Simplified = &A.makeImplies(Operand(0), Operand(1));
+      break;
+    case Formula::Equal:
+      Simplified = &A.makeEquals(Operand(0), Operand(1));
+      break;
+  }
+  Memo[&F] = Simplified;
+  return *Simplified;
+}
+
+// Solves `Query` as written.
+std::vector<const Formula *> asWritten(const CorpusQuery &Query, Arena &) {
+  return Query.Vals;
+}
+
+// Solves `Query` after rebuilding it in an arena.
+std::vector<const Formula *> simplified(const CorpusQuery &Query, Arena &A) {
+  SimplifiedFormulas Memo;
+  std::vector<const Formula *> Vals;
+  for (const Formula *F : Query.Vals) Vals.push_back(&simplify(*F, A, Memo));
+  return Vals;
+}
+
+struct SolverConfig {
+  llvm::StringRef Name;
+  std::function<std::vector<const Formula *>(const CorpusQuery &, Arena &)>
+      Prepare;
+  std::function<std::unique_ptr<dataflow::Solver>()> MakeSolver;
+};
+
+std::vector<SolverConfig> solverConfigs() {
+  auto WatchedLiterals = [] {
+    return std::make_unique<dataflow::WatchedLiteralsSolver>(MaxSATIterations);
+  };
+  return {
+      {"WatchedLiterals", asWritten, WatchedLiterals},
+      {"Simplified", simplified, WatchedLiterals},
+  };
+}
+
+void benchmarkQuery(benchmark::State &State, const CorpusQuery &Query,
+                    const SolverConfig &Config) {
+  Arena A;
+  std::vector<const Formula *> Vals = Config.Prepare(Query, A);
+  Result::Status Status = Result::Status::TimedOut;
+  for (auto _ : State) {
+    std::unique_ptr<dataflow::Solver> Solver = Config.MakeSolver();
+    Status = Solver->solve(Vals).getStatus();
+  }
+  State.counters["timed_out"] = Status == Result::Status::TimedOut;
+  State.counters["satisfiable"] = Status == Result::Status::Satisfiable;
+}
+
+// Reads the corpus. The queries are kept in a deque, as the benchmarks refer
+// to them.
+void readCorpus(std::deque<CorpusQuery> &Corpus) {
+  std::error_code EC;
+  for (llvm::sys::fs::directory_iterator It(CorpusDir, EC), End;
+       It != End && !EC; It.increment(EC)) {
+    llvm::StringRef Path = It->path();
+    if (llvm::sys::path::extension(Path) != ".query") continue;
+    auto Buffer = llvm::MemoryBuffer::getFile(Path);
+    QCHECK(Buffer) << Path.str() << ": " << Buffer.getError().message();
+    CorpusQuery &Query = Corpus.emplace_back();
+    Query.Name = llvm::sys::path::stem(Path).str();
+    auto Vals = readSolverQuery((*Buffer)->getBuffer(), Query.Alloc);
+    QCHECK(Vals) << Path.str() << ": " << llvm::toString(Vals.takeError());
+    Query.Vals = std::move(*Vals);
+  }
+  QCHECK(!EC) << CorpusDir << ": " << EC.message();
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
+
+int main(int argc, absl::Nonnull<char **> argv) {
+  using namespace clang::tidy::nullability;
+  benchmark::Initialize(&argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  std::deque<CorpusQuery> Corpus;
+  readCorpus(Corpus);
+  const std::vector<SolverConfig> Configs = solverConfigs();
+  for (const SolverConfig &Config : Configs)
+    for (const CorpusQuery &Query : Corpus)
+      benchmark::RegisterBenchmark(
+          ("BM_Solve/" + Config.Name + "/" + Query.Name).str(),
+          [&Query, &Config](benchmark::State &State) {
+            benchmarkQuery(State, Query, Config);
+          })
+          ->Unit(benchmark::kMillisecond);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
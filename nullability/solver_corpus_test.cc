@@ -0,0 +1,154 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/solver_corpus.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "clang/Analysis/FlowSensitive/Arena.h"
+#include "clang/Analysis/FlowSensitive/Formula.h"
+#include "clang/Analysis/FlowSensitive/Solver.h"
+#include "clang/Analysis/FlowSensitive/WatchedLiteralsSolver.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Testing/Support/Error.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+
+namespace clang::tidy::nullability {
+namespace {
+using dataflow::Arena;
+using dataflow::Formula;
+using Result = dataflow::Solver::Result;
+using ::testing::ElementsAre;
+using ::testing::EndsWith;
+using ::testing::HasSubstr;
+using ::testing::StartsWith;
+
+std::string write(llvm::ArrayRef<const Formula *> Vals) {
+  std::string Text;
+  llvm::raw_string_ostream OS(Text);
+  writeSolverQuery(Vals, OS);
+  return Text;
+}
+
+// Builds `(A | B) & ((A | B) => !A)` and `B`, with the disjunction shared.
+std::vector<const Formula *> query(Arena &Arena) {
+  const Formula &A = Arena.makeAtomRef(Arena.makeAtom());
+  const Formula &B = Arena.makeAtomRef(Arena.makeAtom());
+  const Formula &AOrB = Arena.makeOr(A, B);
+  return {&Arena.makeAnd(AOrB, Arena.makeImplies(AOrB, Arena.makeNot(A))),
+          &B};
+}
+
+TEST(SolverCorpusTest, WritesSharedSubformulasOnce) {
+  Arena Arena;
+  // Atoms are numbered in order of appearance, not as in the arena.
+  Arena.makeAtom();
+  EXPECT_EQ(write(query(Arena)),
+            "p formula 2 6 2\n"
+            "v 1\n"
+            "v 2\n"
+            "o 1 2\n"
+            "n 1\n"
+            "i 3 4\n"
+            "a 3 5\n"
+            "r 6\n"
+            "r 2\n");
+}
+
+TEST(SolverCorpusTest, RoundTrips) {
+  Arena Arena;
+  std::vector<const Formula *> Query = query(Arena);
+  Query.push_back(
+      &Arena.makeEquals(*Query[1], Arena.makeAtomRef(Arena.makeAtom())));
+  Query.push_back(&Arena.makeLiteral(true));
+  std::string Text;
+  llvm::raw_string_ostream OS(Text);
+  writeSolverQuery(Query, OS, {"from a test"});
+  EXPECT_THAT(Text, StartsWith("c from a test\np formula"));
+
+  llvm::BumpPtrAllocator Alloc;
+  auto Read = readSolverQuery(Text, Alloc);
+  ASSERT_THAT_EXPECTED(Read, llvm::Succeeded());
+  EXPECT_EQ(write(*Read), write(Query));
+  EXPECT_EQ(dataflow::WatchedLiteralsSolver().solve(*Read).getStatus(),
+            Result::Status::Satisfiable);
+}
+
+TEST(SolverCorpusTest, RejectsMalformedQueries) {
+  llvm::BumpPtrAllocator Alloc;
+  EXPECT_THAT_EXPECTED(readSolverQuery("v 1\n", Alloc),
+                       llvm::FailedWithMessage(HasSubstr("problem line")));
+  EXPECT_THAT_EXPECTED(
+      readSolverQuery("p formula 1 1 1\nv 2\nr 1\n", Alloc),
+      llvm::FailedWithMessage(HasSubstr("line 2: expected an atom")));
+  EXPECT_THAT_EXPECTED(
+      readSolverQuery("p formula 1 2 1\nv 1\na 1 3\nr 2\n", Alloc),
+      llvm::FailedWithMessage(HasSubstr("expected two nodes")));
+  EXPECT_THAT_EXPECTED(readSolverQuery("p formula 1 1 1\nv 1\n", Alloc),
+                       llvm::FailedWithMessage(HasSubstr("don't match")));
+}
+
+// Always times out.
+class TimingOutSolver : public dataflow::Solver {
+ public:
+  Result solve(llvm::ArrayRef<const Formula *>) override {
+    return Result::TimedOut();
+  }
+  bool reachedLimit() const override { return true; }
+};
+
+TEST(SolverCorpusRecorderTest, RecordsTimedOutQueriesOnce) {
+  llvm::SmallString<128> Dir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("corpus", Dir));
+  SolverCorpusRecorder Recorder(std::string(Dir), std::chrono::hours(1));
+  SolverFactory TimingOut = Recorder.wrap(
+      [] { return std::make_unique<TimingOutSolver>(); });
+  SolverFactory WatchedLiterals = Recorder.wrap(
+      [] { return std::make_unique<dataflow::WatchedLiteralsSolver>(); });
+
+  Arena Arena1;
+  EXPECT_EQ(WatchedLiterals()->solve(query(Arena1)).getStatus(),
+            Result::Status::Satisfiable);
+  EXPECT_EQ(Recorder.recorded(), 0u);
+  EXPECT_EQ(TimingOut()->solve(query(Arena1)).getStatus(),
+            Result::Status::TimedOut);
+  EXPECT_EQ(Recorder.recorded(), 1u);
+  // The same query from another arena is already recorded.
+  Arena Arena2;
+  Arena2.makeAtom();
+  TimingOut()->solve(query(Arena2));
+  EXPECT_EQ(Recorder.recorded(), 1u);
+
+  std::vector<std::string> Paths;
+  std::error_code EC;
+  for (llvm::sys::fs::directory_iterator It(Dir, EC), End; It != End && !EC;
+       It.increment(EC))
+    Paths.push_back(It->path());
+  ASSERT_THAT(Paths, ElementsAre(EndsWith(".query")));
+  const std::string &Path = Paths[0];
+  auto Buffer = llvm::MemoryBuffer::getFile(Path);
+  ASSERT_TRUE(Buffer);
+  EXPECT_THAT((*Buffer)->getBuffer().str(), StartsWith("c timed out"));
+  llvm::BumpPtrAllocator Alloc;
+  auto Read = readSolverQuery((*Buffer)->getBuffer(), Alloc);
+  ASSERT_THAT_EXPECTED(Read, llvm::Succeeded());
+  EXPECT_EQ(write(*Read), write(query(Arena1)));
+
+  llvm::sys::fs::remove(Path);
+  llvm::sys::fs::remove(Dir);
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
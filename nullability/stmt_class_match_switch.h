@@ -0,0 +1,123 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_NULLABILITY_STMT_CLASS_MATCH_SWITCH_H_
+#define CRUBIT_NULLABILITY_STMT_CLASS_MATCH_SWITCH_H_
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/ASTTypeTraits.h"
+#include "clang/AST/Stmt.h"
+#include "clang/ASTMatchers/ASTMatchersInternal.h"
+#include "clang/Analysis/CFG.h"
+#include "clang/Analysis/FlowSensitive/CFGMatchSwitch.h"
+#include "clang/Analysis/FlowSensitive/MatchSwitch.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace clang::tidy::nullability {
+
+/// Like `dataflow::CFGMatchSwitchBuilder` (for `CFGStmt` elements only), but
+/// the switch that it builds only tries, for each statement, the cases that
+/// can match statements of its class.
+///
+/// A `CFGMatchSwitch` tries the matchers of all of its cases in order until
+/// one matches, so most elements are matched against most of the cases. Here,
+/// the cases are filtered by the node type of their action and by the node
+/// kind that their matcher is restricted to (e.g. `CXXMemberCallExpr` for
+/// `cxxMemberCallExpr(...)`), which a matcher checks first anyway, so the
+/// filtered-out cases could not have matched either. The remaining cases are
+/// tried in their original order, so the first matching case is the same as
+/// with `CFGMatchSwitchBuilder`. (This assumes that the matchers match the
+/// statement itself, not a node that `traverse()` skips to.)
+///
+/// The switch for each statement class is built the first time that a
+/// statement of the class is transferred.
+template <typename State, typename Result = void>
+class StmtClassCFGMatchSwitchBuilder {
+ public:
+  /// Registers an action `A` for `CFGStmt`s that will be triggered by the
+  /// match of the pattern `M` against the `Stmt` contained in the `CFGStmt`.
+  ///
+  /// Requirements:
+  ///
+  ///  `NodeT` should be derived from `Stmt`.
+  template <typename NodeT>
+  StmtClassCFGMatchSwitchBuilder &&CaseOfCFGStmt(
+      ast_matchers::internal::Matcher<Stmt> M,
+      dataflow::MatchSwitchAction<NodeT, State, Result> A) && {
+    static_assert(std::is_base_of<Stmt, NodeT>::value,
+                  "NodeT must be derived from Stmt.");
+    ast_matchers::internal::DynTypedMatcher Matcher = M;
+    Cases.push_back(Case{
+        .CanMatch =
+            [Matcher](ASTNodeKind Kind) {
+              return ASTNodeKind::getFromNodeKind<NodeT>().isBaseOf(Kind) &&
+                     Matcher.canMatchNodesOfKind(Kind);
+            },
+        .AddTo =
+            [M = std::move(M), A = std::move(A)](StmtSwitchBuilder &Builder) {
+              std::move(Builder).template CaseOf<NodeT>(M, A);
+            }});
+    return std::move(*this);
+  }
+
+  dataflow::CFGMatchSwitch<State, Result> Build() && {
+    return [AllCases = std::make_shared<const std::vector<Case>>(
+                std::move(Cases)),
+            SwitchesByClass = std::make_shared<
+                llvm::DenseMap<unsigned, std::optional<StmtSwitch>>>()](
+               const CFGElement &Element, ASTContext &Context,
+               State &S) -> Result {
+      std::optional<CFGStmt> CS = Element.getAs<CFGStmt>();
+      if (!CS) return Result();
+      const Stmt &Statement = *CS->getStmt();
+      auto [It, Inserted] =
+          SwitchesByClass->try_emplace(Statement.getStmtClass());
+      if (Inserted)
+        It->second =
+            buildSwitch(*AllCases, ASTNodeKind::getFromNode(Statement));
+      if (!It->second) return Result();
+      return (*It->second)(Statement, Context, S);
+    };
+  }
+
+ private:
+  using StmtSwitchBuilder =
+      dataflow::ASTMatchSwitchBuilder<Stmt, State, Result>;
+  using StmtSwitch = dataflow::ASTMatchSwitch<Stmt, State, Result>;
+
+  struct Case {
+    // Whether the case can match statements of the given kind.
+    std::function<bool(ASTNodeKind)> CanMatch;
+    // Adds the case to the switch for a statement class.
+    std::function<void(StmtSwitchBuilder &)> AddTo;
+  };
+
+  // Returns the switch of the `Cases` that can match statements of `Kind`, or
+  // nullopt if none can.
+  static std::optional<StmtSwitch> buildSwitch(const std::vector<Case> &Cases,
+                                               ASTNodeKind Kind) {
+    StmtSwitchBuilder Builder;
+    bool Empty = true;
+    for (const Case &C : Cases) {
+      if (!C.CanMatch(Kind)) continue;
+      C.AddTo(Builder);
+      Empty = false;
+    }
+    if (Empty) return std::nullopt;
+    return std::move(Builder).Build();
+  }
+
+  std::vector<Case> Cases;
+};
+
+}  // namespace clang::tidy::nullability
+
+#endif  // CRUBIT_NULLABILITY_STMT_CLASS_MATCH_SWITCH_H_
@@ -0,0 +1,124 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "nullability/stmt_class_match_switch.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/Analysis/CFG.h"
+#include "clang/Analysis/FlowSensitive/CFGMatchSwitch.h"
+#include "clang/Testing/TestAST.h"
+#include "llvm/ADT/StringRef.h"
+#include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
+
+namespace clang::tidy::nullability {
+namespace {
+
+using ast_matchers::callExpr;
+using ast_matchers::expr;
+using ast_matchers::hasOperatorName;
+using ast_matchers::hasType;
+using ast_matchers::isAnyPointer;
+using ast_matchers::match;
+using ast_matchers::MatchFinder;
+using ast_matchers::stmt;
+using ast_matchers::unaryOperator;
+
+// The names of the cases that were run.
+using Log = std::vector<std::string>;
+
+template <typename NodeT>
+dataflow::MatchSwitchAction<NodeT, Log> logAs(llvm::StringRef Name) {
+  return [Name](const NodeT *, const MatchFinder::MatchResult &, Log &L) {
+    L.push_back(Name.str());
+  };
+}
+
+// Adds the same cases to a `CFGMatchSwitchBuilder` or to a
+// `StmtClassCFGMatchSwitchBuilder`.
+template <typename BuilderT>
+dataflow::CFGMatchSwitch<Log> buildSwitch(BuilderT Builder) {
+  return std::move(Builder)
+      .template CaseOfCFGStmt<UnaryOperator>(
+          unaryOperator(hasOperatorName("*")), logAs<UnaryOperator>("deref"))
+      .template CaseOfCFGStmt<Expr>(expr(hasType(isAnyPointer())),
+                                    logAs<Expr>("pointer"))
+      .template CaseOfCFGStmt<UnaryOperator>(unaryOperator(),
+                                             logAs<UnaryOperator>("unary"))
+      .template CaseOfCFGStmt<CallExpr>(callExpr(), logAs<CallExpr>("call"))
+      .Build();
+}
+
+// Runs `Switch` on the statement `S`, returning the names of the cases run.
+Log run(const dataflow::CFGMatchSwitch<Log> &Switch, const Stmt &S,
+        ASTContext &Context) {
+  Log L;
+  Switch(CFGStmt(&S), Context, L);
+  return L;
+}
+
+TEST(StmtClassCFGMatchSwitchTest, RunsFirstMatchingCase) {
+  TestAST AST(R"cc(
+    int *f();
+    void target(int *p) {
+      *p;
+      -*p;
+      f();
+    }
+  )cc");
+  auto Switch = buildSwitch(StmtClassCFGMatchSwitchBuilder<Log>());
+  ASTContext &Context = AST.context();
+
+  auto Only = [&](auto Matcher) -> const Stmt & {
+    auto Matches = match(Matcher.bind("s"), Context);
+    EXPECT_EQ(Matches.size(), 1);
+    return *Matches.at(0).template getNodeAs<Stmt>("s");
+  };
+  EXPECT_EQ(run(Switch, Only(unaryOperator(hasOperatorName("*"))), Context),
+            Log{"deref"});
+  EXPECT_EQ(run(Switch, Only(unaryOperator(hasOperatorName("-"))), Context),
+            Log{"unary"});
+  EXPECT_EQ(run(Switch, Only(callExpr()), Context), Log{"pointer"});
+  EXPECT_EQ(run(Switch, *cast<FunctionDecl>(AST.findDecl("target"))->getBody(),
+                Context),
+            Log{});
+}
+
+TEST(StmtClassCFGMatchSwitchTest, SameCasesAsCFGMatchSwitch) {
+  TestAST AST(R"cc(
+    struct S {
+      int *member;
+      void method();
+    };
+    void takesInt(int);
+    void target(int *p, S s) {
+      int *q = p ? p : nullptr;
+      *q = -*p + (int)(long)&s;
+      s.method();
+      takesInt(*s.member);
+      if (q) return;
+    }
+  )cc");
+  auto Expected = buildSwitch(dataflow::CFGMatchSwitchBuilder<Log>());
+  auto Actual = buildSwitch(StmtClassCFGMatchSwitchBuilder<Log>());
+  ASTContext &Context = AST.context();
+
+  auto Matches = match(stmt().bind("s"), Context);
+  ASSERT_FALSE(Matches.empty());
+  for (const auto &Match : Matches) {
+    const Stmt &S = *Match.getNodeAs<Stmt>("s");
+    EXPECT_EQ(run(Actual, S, Context), run(Expected, S, Context))
+        << S.getStmtClassName();
+  }
+}
+
+}  // namespace
+}  // namespace clang::tidy::nullability
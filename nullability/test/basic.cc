@@ -4,7 +4,11 @@
 
 // Tests for basic functionality (simple dereferences without control flow).
 
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "nullability/pointer_nullability_diagnosis.h"
 #include "nullability/pragma.h"
@@ -13,8 +17,14 @@
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/Basic/LLVM.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Testing/Support/Error.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googlemock/include/gmock/gmock.h"
 #include "third_party/llvm/llvm-project/third-party/unittest/googletest/include/gtest/gtest.h"
@@ -22,7 +32,11 @@
 namespace clang::tidy::nullability {
 namespace {
 
+using ::testing::Contains;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
 using ::testing::IsEmpty;
+using ::testing::Not;
 using ::testing::SizeIs;
 
 TEST(PointerNullabilityTest, NoPointerOperations) {
@@ -325,6 +339,426 @@ TEST(PointerNullabilityTest, AnalyzeFunctionWithForwardDeclarationOnlyOnce) {
                        llvm::HasValue(IsEmpty()));
 }
 
+TEST(PointerNullabilityTest, BatchDiagnosisMatchesSingleDecls) {
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(R"cc(
+    void deref(int *_Nullable p) { *p; }
+    void checked(int *_Nullable p) {
+      if (p) *p;
+    }
+    void twice(int *_Nullable p, int *_Nullable q) {
+      *p;
+      *q;
+    }
+    template <typename T>
+    void templated(T *_Nullable p) { *p; }
+    void instantiate() { templated<int>(nullptr); }
+  )cc");
+  NullabilityPragmas NoPragmas;
+  ASTContext &Context = Unit->getASTContext();
+
+  std::vector<const ValueDecl *> Decls;
+  std::vector<size_t> BatchCounts;
+  diagnoseTranslationUnit(
+      Context, NoPragmas,
+      [&](const ValueDecl &VD,
+          llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+              Diags) {
+        ASSERT_THAT_EXPECTED(Diags, llvm::Succeeded());
+        Decls.push_back(&VD);
+        BatchCounts.push_back(Diags->size());
+      });
+
+  std::vector<size_t> SingleCounts;
+  for (const ValueDecl *VD : Decls) {
+    auto Diags = diagnosePointerNullability(VD, NoPragmas);
+    ASSERT_THAT_EXPECTED(Diags, llvm::Succeeded());
+    SingleCounts.push_back(Diags->size());
+  }
+  EXPECT_EQ(BatchCounts, SingleCounts);
+
+  auto CountFor = [&](llvm::StringRef Name) -> size_t {
+    size_t Total = 0;
+    for (size_t I = 0; I < Decls.size(); ++I)
+      if (const auto *ND = dyn_cast<NamedDecl>(Decls[I]);
+          ND && ND->getIdentifier() && ND->getName() == Name)
+        Total += BatchCounts[I];
+    return Total;
+  };
+  EXPECT_EQ(CountFor("deref"), 1);
+  EXPECT_EQ(CountFor("checked"), 0);
+  EXPECT_EQ(CountFor("twice"), 2);
+  // Only the instantiation is analyzed.
+  EXPECT_EQ(CountFor("templated"), 1);
+}
+
+TEST(PointerNullabilityTest, SkipsFunctionsWithoutPointers) {
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(R"cc(
+    int puts(const char *_Nonnull);
+    int add(int a, int b) { return a + b; }
+    void greet() { puts("hello"); }
+    void deref(int *_Nullable p) { *p; }
+    struct S {
+      S() : p(nullptr) {}
+      int *_Nonnull p;
+    };
+  )cc");
+  NullabilityPragmas NoPragmas;
+
+  DiagnosisStats Stats;
+  size_t NumDiags = 0;
+  diagnoseTranslationUnit(
+      Unit->getASTContext(), NoPragmas,
+      [&](const ValueDecl &VD,
+          llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+              Diags) {
+        ASSERT_THAT_EXPECTED(Diags, llvm::Succeeded());
+        NumDiags += Diags->size();
+      },
+      makeDefaultSolverForDiagnosis, &Stats);
+  // `add` and `greet` are skipped; `deref` and the constructor, whose member
+  // initializer is a null pointer constant, are analyzed.
+  EXPECT_EQ(Stats.SkippedFunctions, 2);
+  EXPECT_EQ(Stats.AnalyzedFunctions, 2);
+  EXPECT_EQ(NumDiags, 2);
+}
+
+TEST(PointerNullabilityTest, ParallelDiagnosisMatchesSerial) {
+  static constexpr llvm::StringRef Code = R"cc(
+    void deref(int *_Nullable p) { *p; }
+    void checked(int *_Nullable p) {
+      if (p) *p;
+    }
+    void twice(int *_Nullable p, int *_Nullable q) {
+      *p;
+      *q;
+    }
+    void inconsistent(int *_Nonnull p);
+    void inconsistent(int *_Nullable p);
+  )cc";
+  auto Render =
+      [](const ValueDecl &VD,
+         llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+             Diags) -> std::string {
+    if (!Diags) return llvm::toString(Diags.takeError());
+    const SourceManager &SM = VD.getASTContext().getSourceManager();
+    std::string Out;
+    for (const auto &Diag : *Diags)
+      Out += Diag.Range.getBegin().printToString(SM) + "\n";
+    return Out;
+  };
+
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(Code);
+  NullabilityPragmas NoPragmas;
+  std::vector<std::string> Serial;
+  diagnoseTranslationUnit(
+      Unit->getASTContext(), NoPragmas,
+      [&](const ValueDecl &VD,
+          llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+              Diags) { Serial.push_back(Render(VD, std::move(Diags))); });
+  ASSERT_THAT(Serial, Not(IsEmpty()));
+
+  auto ParseTU = [&](unsigned Worker, TUDiagnoser Diagnose) {
+    std::unique_ptr<ASTUnit> WorkerUnit = tooling::buildASTFromCode(Code);
+    NullabilityPragmas WorkerPragmas;
+    Diagnose(WorkerUnit->getASTContext(), WorkerPragmas);
+  };
+  EXPECT_THAT_EXPECTED(
+      diagnoseTranslationUnitInParallel(/*Workers=*/3, ParseTU, Render),
+      llvm::HasValue(Serial));
+
+  // Worker 2 fails to parse. The others take on its share, but the failure is
+  // reported rather than dropped.
+  EXPECT_THAT_EXPECTED(
+      diagnoseTranslationUnitInParallel(
+          /*Workers=*/3,
+          [&](unsigned Worker, TUDiagnoser Diagnose) {
+            if (Worker != 2) ParseTU(Worker, Diagnose);
+          },
+          Render),
+      llvm::FailedWithMessage(HasSubstr("worker 2")));
+}
+
+TEST(PointerNullabilityTest, ExpiredDeadlineReportsBudgetExceeded) {
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(R"cc(
+    int add(int a, int b) { return a + b; }
+    void deref(int *_Nullable p) { *p; }
+    void inconsistent(int *_Nonnull p);
+    void inconsistent(int *_Nullable p) { *p; }
+  )cc");
+  NullabilityPragmas NoPragmas;
+  DiagnosisOptions Options;
+  Options.Deadline = std::chrono::steady_clock::now();
+
+  DiagnosisStats Stats;
+  std::vector<std::vector<PointerNullabilityDiagnostic::ErrorCode>> Codes;
+  diagnoseTranslationUnit(
+      Unit->getASTContext(), NoPragmas,
+      [&](const ValueDecl &VD,
+          llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+              Diags) {
+        ASSERT_THAT_EXPECTED(Diags, llvm::Succeeded());
+        auto &DeclCodes = Codes.emplace_back();
+        for (const auto &Diag : *Diags) DeclCodes.push_back(Diag.Code);
+      },
+      makeDefaultSolverForDiagnosis, &Stats, Options);
+
+  using Code = PointerNullabilityDiagnostic::ErrorCode;
+  // Functions without pointers don't need the analysis, and the annotations
+  // are still checked for consistency.
+  EXPECT_THAT(Codes, Contains(ElementsAre(Code::InconsistentAnnotations,
+                                          Code::BudgetExceeded)));
+  EXPECT_THAT(Codes, Contains(ElementsAre(Code::BudgetExceeded)));
+  EXPECT_EQ(Stats.SkippedFunctions, 1);
+  EXPECT_EQ(Stats.BudgetExceededFunctions, 2);
+  EXPECT_EQ(Stats.FailedFunctions, 0);
+}
+
+TEST(PointerNullabilityTest, BatchModelsFieldsOfGlobalsReadByLaterFunctions) {
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(R"cc(
+    struct S {
+      int *_Nullable A;
+      int *_Nullable B;
+    };
+    S Global;
+    void readA() { *Global.A; }
+    void readB() {
+      if (Global.B) *Global.B;
+    }
+    void readBoth() {
+      if (Global.A && Global.B) *Global.A + *Global.B;
+      *Global.B;
+    }
+  )cc");
+  NullabilityPragmas NoPragmas;
+  llvm::StringMap<size_t> Findings;
+  DiagnosisStats Stats;
+  diagnoseTranslationUnit(
+      Unit->getASTContext(), NoPragmas,
+      [&](const ValueDecl &VD,
+          llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+              Diags) {
+        ASSERT_THAT_EXPECTED(Diags, llvm::Succeeded());
+        if (isa<FunctionDecl>(VD)) Findings[VD.getName()] = Diags->size();
+      },
+      makeDefaultSolverForDiagnosis, &Stats);
+
+  // `Global` is created while analyzing `readA`, which refers only to `A`. The
+  // checks of `B` in the later functions still hold.
+  EXPECT_EQ(Findings.lookup("readA"), 1);
+  EXPECT_EQ(Findings.lookup("readB"), 0);
+  EXPECT_EQ(Findings.lookup("readBoth"), 1);
+  // `readB` needs a new state, which models both `A` and `B`, so `readBoth`
+  // can be analyzed in it.
+  EXPECT_EQ(Stats.ReleasedStates, 1);
+}
+
+TEST(PointerNullabilityTest, MemoryStatsPerAnalyzedFunction) {
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(R"cc(
+    int add(int a, int b) { return a + b; }
+    struct S {
+      int *_Nullable get() const;
+    };
+    void calls(S s, bool b) {
+      if (b) {
+        if (s.get()) *s.get();
+      }
+      *s.get();
+    }
+  )cc");
+  NullabilityPragmas NoPragmas;
+  DiagnosisOptions Options;
+  std::vector<std::string> Functions;
+  AnalysisMemoryStats CallsStats;
+  Options.MemoryStats = [&](const FunctionDecl &Func,
+                            const AnalysisMemoryStats &Stats) {
+    Functions.push_back(Func.getNameAsString());
+    CallsStats = Stats;
+  };
+
+  diagnoseTranslationUnit(
+      Unit->getASTContext(), NoPragmas,
+      [&](const ValueDecl &VD,
+          llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+              Diags) { ASSERT_THAT_EXPECTED(Diags, llvm::Succeeded()); },
+      makeDefaultSolverForDiagnosis, /*Stats=*/nullptr, Options);
+
+  // Functions that are not analyzed have no measures.
+  EXPECT_THAT(Functions, ElementsAre("calls"));
+  EXPECT_GT(CallsStats.RetainedEnvironments, 1);
+  EXPECT_GT(CallsStats.ArenaAtoms, 0);
+  EXPECT_GT(CallsStats.ExprNullabilityEntries, 0);
+  EXPECT_GT(CallsStats.ConstMethodReturnValues, 0);
+  EXPECT_GE(CallsStats.ConstMethodReturnValues,
+            CallsStats.MaxConstMethodReturnValues);
+  EXPECT_GT(CallsStats.MaxConstMethodReturnValues, 0);
+}
+
+TEST(PointerNullabilityTest, ReleasingStateAfterLargeFunctionsKeepsFindings) {
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(R"cc(
+    int *_Nullable get();
+    void branches(int *_Nullable p, bool b) {
+      if (b) *p;
+      if (p) *p;
+      *get();
+    }
+    void deref(int *_Nullable p) { *p; }
+    void guarded(int *_Nullable p) {
+      if (p) *p;
+    }
+  )cc");
+  NullabilityPragmas NoPragmas;
+  auto Diagnose = [&](const DiagnosisOptions &Options, DiagnosisStats &Stats) {
+    std::vector<std::string> Findings;
+    diagnoseTranslationUnit(
+        Unit->getASTContext(), NoPragmas,
+        [&](const ValueDecl &VD,
+            llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+                Diags) {
+          Findings.push_back(renderDiagnoses(VD, std::move(Diags)));
+        },
+        makeDefaultSolverForDiagnosis, &Stats, Options);
+    return Findings;
+  };
+
+  DiagnosisStats KeptStats;
+  std::vector<std::string> Kept = Diagnose({}, KeptStats);
+  EXPECT_EQ(KeptStats.ReleasedStates, 0);
+
+  DiagnosisOptions Options;
+  // Only `branches` has this many blocks. The state it leaves is released
+  // before `deref` is analyzed.
+  Options.ReleaseStateAfterBlocks = 6;
+  DiagnosisStats ReleasedStats;
+  EXPECT_EQ(Diagnose(Options, ReleasedStats), Kept);
+  EXPECT_EQ(ReleasedStats.ReleasedStates, 1);
+  EXPECT_EQ(ReleasedStats.AnalyzedFunctions, KeptStats.AnalyzedFunctions);
+
+  // Releasing after every function works too.
+  Options.ReleaseStateAfterBlocks = 1;
+  DiagnosisStats AlwaysStats;
+  EXPECT_EQ(Diagnose(Options, AlwaysStats), Kept);
+  EXPECT_EQ(AlwaysStats.ReleasedStates, AlwaysStats.AnalyzedFunctions - 1);
+}
+
+TEST(PointerNullabilityTest, GenerousTimeLimitDoesNotChangeResults) {
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(R"cc(
+    void target(int *_Nullable p) {
+      *p;
+      if (p) *p;
+    }
+  )cc");
+  NullabilityPragmas NoPragmas;
+  ASTContext &Context = Unit->getASTContext();
+  DeclContextLookupResult Result =
+      Context.getTranslationUnitDecl()->lookup(&Context.Idents.get("target"));
+  ASSERT_TRUE(Result.isSingleResult());
+
+  DiagnosisOptions Options;
+  Options.FunctionTimeLimit = std::chrono::hours(1);
+  auto Diags = diagnosePointerNullability(
+      cast<ValueDecl>(Result.front()), NoPragmas,
+      makeDefaultSolverForDiagnosis, Options);
+  ASSERT_THAT_EXPECTED(Diags, llvm::HasValue(SizeIs(1)));
+  EXPECT_EQ((*Diags)[0].Code,
+            PointerNullabilityDiagnostic::ErrorCode::ExpectedNonnull);
+}
+
+TEST(PointerNullabilityTest, SummariesDiagnoseCallsToUnannotatedFunctions) {
+  std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(R"cc(
+    int *find() { return nullptr; }
+    void use(int *p) { *p; }
+    void target(int *_Nullable q) {
+      *find();
+      use(q);
+    }
+  )cc");
+  NullabilityPragmas NoPragmas;
+  ASTContext &Context = Unit->getASTContext();
+  DeclContextLookupResult Result =
+      Context.getTranslationUnitDecl()->lookup(&Context.Idents.get("target"));
+  ASSERT_TRUE(Result.isSingleResult());
+  const auto *Target = cast<ValueDecl>(Result.front());
+
+  auto Diagnose = [&](const DiagnosisOptions &Options) {
+    std::vector<PointerNullabilityDiagnostic::ErrorCode> Codes;
+    diagnosePointerNullability(
+        llvm::ArrayRef<const ValueDecl *>(Target), NoPragmas,
+        [&](const ValueDecl &,
+            llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+                Diags) {
+          ASSERT_THAT_EXPECTED(Diags, llvm::Succeeded());
+          for (const auto &Diag : *Diags) Codes.push_back(Diag.Code);
+        },
+        makeDefaultSolverForDiagnosis, /*Stats=*/nullptr, Options);
+    return Codes;
+  };
+
+  EXPECT_THAT(Diagnose({}), IsEmpty());
+  DiagnosisOptions Options;
+  Options.SummarizeFunctions = true;
+  using Code = PointerNullabilityDiagnostic::ErrorCode;
+  EXPECT_THAT(Diagnose(Options),
+              ElementsAre(Code::ExpectedNonnull, Code::ExpectedNonnull));
+}
+
+TEST(PointerNullabilityTest, CacheReusesFindingsOfUnchangedFunctions) {
+  static constexpr llvm::StringRef Original = R"cc(
+    int *_Nullable get();
+    void take(int *_Nonnull q);
+    void deref(int *_Nullable p) { *p; }
+    void use() { *get(); }
+    void pass(int *_Nullable p) { take(p); }
+  )cc";
+  static constexpr llvm::StringRef Edited = R"cc(
+    int x;
+    int *_Nonnull get();
+    void take(int *_Nonnull q);
+    void deref(int *_Nullable p) { *p; }
+    void use() { *get(); }
+    void pass(int *_Nullable p) { take(p); }
+  )cc";
+  DiagnosisCache Cache;
+  DiagnosisOptions Options;
+  Options.Cache = &Cache;
+  // Diagnoses `Code` from a fresh parse, and describes each finding by its
+  // line, callee and parameter name.
+  auto Diagnose = [&](llvm::StringRef Code, DiagnosisStats &Stats) {
+    std::unique_ptr<ASTUnit> Unit = tooling::buildASTFromCode(Code);
+    NullabilityPragmas NoPragmas;
+    const SourceManager &SM = Unit->getSourceManager();
+    std::vector<std::string> Findings;
+    diagnoseTranslationUnit(
+        Unit->getASTContext(), NoPragmas,
+        [&](const ValueDecl &,
+            llvm::Expected<llvm::SmallVector<PointerNullabilityDiagnostic>>
+                Diags) {
+          ASSERT_THAT_EXPECTED(Diags, llvm::Succeeded());
+          for (const auto &Diag : *Diags) {
+            std::string &Finding = Findings.emplace_back(std::to_string(
+                SM.getPresumedLineNumber(Diag.Range.getBegin())));
+            if (Diag.Callee) Finding += " " + Diag.Callee->getNameAsString();
+            if (Diag.ParamName)
+              Finding += " " + Diag.ParamName->getName().str();
+          }
+        },
+        makeDefaultSolverForDiagnosis, &Stats, Options);
+    return Findings;
+  };
+
+  DiagnosisStats Before;
+  EXPECT_THAT(Diagnose(Original, Before), ElementsAre("4", "5", "6 take q"));
+  EXPECT_EQ(Before.AnalyzedFunctions, 3);
+  EXPECT_EQ(Before.CachedFunctions, 0);
+
+  // The unchanged functions are reused at their new location, but `use` is
+  // analyzed again, as the nullability of `get` has changed.
+  DiagnosisStats After;
+  EXPECT_THAT(Diagnose(Edited, After), ElementsAre("5", "7 take q"));
+  EXPECT_EQ(After.AnalyzedFunctions, 1);
+  EXPECT_EQ(After.CachedFunctions, 2);
+  EXPECT_EQ(Cache.hits(), 2);
+}
+
 TEST(PointerNullabilityTest, CheckMacro) {
   EXPECT_TRUE(checkDiagnostics(R"cc(
 #define CHECK(x) \
@@ -5,6 +5,7 @@
 #include "nullability/type_nullability.h"
 
 #include <cassert>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <utility>
@@ -12,6 +13,7 @@
 
 #include "absl/base/nullability.h"
 #include "absl/log/check.h"
+#include "nullability/ast_context_data.h"
 #include "nullability/type_and_maybe_loc_visitor.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/ASTFwd.h"
@@ -31,6 +33,7 @@
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/Specifiers.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
@@ -146,12 +149,8 @@ static absl::Nullable<const CXXRecordDecl *> getSmartPointerBaseClass(
   return getSmartPointerBaseClass(RD, Seen, BaseAccess);
 }
 
-QualType underlyingRawPointerType(QualType T, AccessSpecifier BaseAccess) {
-  if (!SmartPointersEnabled) return QualType();
-
-  const CXXRecordDecl *RD = T.getCanonicalType()->getAsCXXRecordDecl();
-  if (RD == nullptr) return QualType();
-
+static QualType computeUnderlyingRawPointerType(const CXXRecordDecl *RD,
+                                                AccessSpecifier BaseAccess) {
   const ASTContext &ASTCtx = RD->getASTContext();
 
   // There's a special case we need to handle here:
@@ -204,12 +203,53 @@ QualType underlyingRawPointerType(QualType T, AccessSpecifier BaseAccess) {
   return QualType();
 }
 
+namespace {
+// The smart pointer classification of the records of an `ASTContext`.
+struct SmartPointerClassifications {
+  // The `underlyingRawPointerType()` of a record, keyed on the record and on
+  // `classificationKey()`.
+  llvm::DenseMap<std::pair<const CXXRecordDecl *, unsigned>, QualType>
+      UnderlyingRawPointerTypes;
+};
+
+// Combines the `BaseAccess` and whether `RD` has a definition: an
+// uninstantiated specialization, which is classified from its template
+// arguments, may be instantiated later.
+unsigned classificationKey(const CXXRecordDecl &RD,
+                           AccessSpecifier BaseAccess) {
+  return static_cast<unsigned>(BaseAccess) << 1 | RD.hasDefinition();
+}
+}  // namespace
+
+QualType underlyingRawPointerType(QualType T, AccessSpecifier BaseAccess) {
+  if (!SmartPointersEnabled) return QualType();
+
+  const CXXRecordDecl *RD = T.getCanonicalType()->getAsCXXRecordDecl();
+  if (RD == nullptr) return QualType();
+
+  auto &Classifications =
+      getASTContextData<SmartPointerClassifications>(RD->getASTContext());
+  auto [It, Inserted] = Classifications.UnderlyingRawPointerTypes.try_emplace(
+      {RD, classificationKey(*RD, BaseAccess)});
+  if (Inserted) It->second = computeUnderlyingRawPointerType(RD, BaseAccess);
+  return It->second;
+}
+
+static thread_local uint64_t NullabilityAtomsCreated = 0;
+
+dataflow::Atom makeNullabilityAtom(dataflow::Arena &A) {
+  ++NullabilityAtomsCreated;
+  return A.makeAtom();
+}
+
+uint64_t nullabilityAtomsCreated() { return NullabilityAtomsCreated; }
+
 PointerTypeNullability PointerTypeNullability::createSymbolic(
     dataflow::Arena &A) {
   PointerTypeNullability Symbolic;
   Symbolic.Symbolic = true;
-  Symbolic.Nonnull = A.makeAtom();
-  Symbolic.Nullable = A.makeAtom();
+  Symbolic.Nonnull = makeNullabilityAtom(A);
+  Symbolic.Nullable = makeNullabilityAtom(A);
   return Symbolic;
 }
 
@@ -240,6 +280,25 @@ FileID getGoverningFile(absl::Nullable<const Decl *> D) {
       .first;
 }
 
+FileID getGoverningFile(absl::Nullable<const Decl *> D,
+                        const TypeNullabilityDefaults &Defaults) {
+  if (!D) return FileID();
+  if (!Defaults.Cache) return getGoverningFile(D);
+  return Defaults.Cache->governingFile(
+      D->getLocation(), D->getASTContext().getSourceManager());
+}
+
+FileID TypeNullabilityCache::governingFile(SourceLocation Loc,
+                                           const SourceManager &SM) {
+  if (Loc.isFileID()) return SM.getFileID(Loc);
+  // Finding the expansion location walks out through each enclosing expansion,
+  // which is slow for deeply nested macros. But every location in one
+  // expansion has the same expansion location, so we only need to do it once.
+  auto [It, Inserted] = ExpansionFiles.try_emplace(SM.getFileID(Loc));
+  if (Inserted) It->second = SM.getDecomposedExpansionLoc(Loc).first;
+  return It->second;
+}
+
 namespace {
 // Recognize aliases e.g. Nonnull<T> as equivalent to T _Nonnull, etc.
 // These aliases should be annotated with [[clang::annotate("Nullable")]] etc.
@@ -556,6 +615,12 @@ class NullabilityWalker : public TypeAndMaybeLocVisitor<Impl> {
  public:
   NullabilityWalker(FileID File) : File(File) {}
 
+  // Returns the file whose #pragma governs types written in `D`.
+  // Subclasses may override this, e.g. to memoize it.
+  FileID governingFile(absl::Nullable<const Decl *> D) {
+    return getGoverningFile(D);
+  }
+
   void visit(TypeLoc Loc) { visit(Loc.getType(), Loc); }
   void visit(QualType T, std::optional<TypeLoc> L = std::nullopt) {
     visit(T.getTypePtr(), L);
@@ -676,7 +741,7 @@ class NullabilityWalker : public TypeAndMaybeLocVisitor<Impl> {
           CurrentTemplateContext, &Ctx);
       llvm::SaveAndRestore SwitchFile(File, isTransparentAlias(QualType(TST, 0))
                                                 ? File
-                                                : getGoverningFile(TD));
+                                                : derived().governingFile(TD));
       visitType(TST, L);
       return;
     }
@@ -817,7 +882,8 @@ class NullabilityWalker : public TypeAndMaybeLocVisitor<Impl> {
   }
 
   void visitTypedefType(const TypedefType *T, std::optional<TypedefTypeLoc> L) {
-    llvm::SaveAndRestore SwitchFile(File, getGoverningFile(T->getDecl()));
+    llvm::SaveAndRestore SwitchFile(File,
+                                    derived().governingFile(T->getDecl()));
     // Don't look for new Locs inside an alias.
     visitType(T, std::nullopt);
   }
@@ -984,14 +1050,24 @@ TypeNullability getTypeNullability(
     llvm::function_ref<GetTypeParamNullability> SubstituteTypeParam) {
   CHECK(!T->isDependentType()) << T.getAsString();
 
+  if (Defaults.Cache)
+    if (const auto *Cached = Defaults.Cache->lookup(
+            T, File, /*Resugaring=*/static_cast<bool>(SubstituteTypeParam)))
+      return *Cached;
+
   struct Walker : NullabilityWalker<Walker> {
     std::vector<PointerTypeNullability> Annotations;
     llvm::function_ref<GetTypeParamNullability> SubstituteTypeParam;
     const TypeNullabilityDefaults &Defaults;
+    bool SawTypeParam = false;
 
     Walker(FileID File, const TypeNullabilityDefaults &Defaults)
         : NullabilityWalker(File), Defaults(Defaults) {}
 
+    FileID governingFile(absl::Nullable<const Decl *> D) {
+      return getGoverningFile(D, Defaults);
+    }
+
     void report(absl::Nonnull<const Type *>, FileID File,
                 std::optional<NullabilityKind> NK, std::optional<TypeLoc>) {
       if (!NK) NK = Defaults.get(File);
@@ -1001,6 +1077,7 @@ TypeNullability getTypeNullability(
     void visitSubstTemplateTypeParmType(
         absl::Nonnull<const SubstTemplateTypeParmType *> ST,
         std::optional<SubstTemplateTypeParmTypeLoc> L) {
+      SawTypeParam = true;
       if (SubstituteTypeParam) {
         if (auto Subst = SubstituteTypeParam(ST)) {
           DCHECK_EQ(Subst->size(),
@@ -1017,6 +1094,11 @@ TypeNullability getTypeNullability(
 
   AnnotationVisitor.SubstituteTypeParam = SubstituteTypeParam;
   AnnotationVisitor.visit(T, std::nullopt);
+  // The result doesn't depend on SubstituteTypeParam if it was never consulted.
+  if (Defaults.Cache &&
+      (!SubstituteTypeParam || !AnnotationVisitor.SawTypeParam))
+    Defaults.Cache->insert(T, File, AnnotationVisitor.Annotations,
+                           AnnotationVisitor.SawTypeParam);
   return std::move(AnnotationVisitor.Annotations);
 }
 
@@ -1034,15 +1116,15 @@ TypeNullability getTypeNullability(
 TypeNullability getTypeNullability(
     const ValueDecl &D, const TypeNullabilityDefaults &Defaults,
     llvm::function_ref<GetTypeParamNullability> SubstituteTypeParam) {
-  return getTypeNullability(D.getType(), getGoverningFile(&D), Defaults,
-                            SubstituteTypeParam);
+  return getTypeNullability(D.getType(), getGoverningFile(&D, Defaults),
+                            Defaults, SubstituteTypeParam);
 }
 
 TypeNullability getTypeNullability(
     const TypeDecl &D, const TypeNullabilityDefaults &Defaults,
     llvm::function_ref<GetTypeParamNullability> SubstituteTypeParam) {
   return getTypeNullability(D.getASTContext().getTypeDeclType(&D),
-                            getGoverningFile(&D), Defaults,
+                            getGoverningFile(&D, Defaults), Defaults,
                             SubstituteTypeParam);
 }
 
@@ -1176,6 +1258,10 @@ std::vector<TypeNullabilityLoc> getTypeNullabilityLocs(
     Walker(FileID File, const TypeNullabilityDefaults &Defaults)
         : NullabilityWalker(File), Defaults(Defaults) {}
 
+    FileID governingFile(absl::Nullable<const Decl *> D) {
+      return getGoverningFile(D, Defaults);
+    }
+
     void report(absl::Nonnull<const Type *> T, FileID File,
                 std::optional<NullabilityKind> NK, std::optional<TypeLoc> Loc) {
       if (!NK) {
@@ -25,9 +25,12 @@
 #ifndef CRUBIT_NULLABILITY_TYPE_NULLABILITY_H_
 #define CRUBIT_NULLABILITY_TYPE_NULLABILITY_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/base/nullability.h"
@@ -43,7 +46,9 @@
 #include "clang/Analysis/FlowSensitive/Formula.h"
 #include "clang/Basic/LLVM.h"
 #include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Basic/Specifiers.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLFunctionalExtras.h"
 
 namespace clang::tidy::nullability {
@@ -108,6 +113,17 @@ bool isUnknownValidOn(QualType);
 QualType underlyingRawPointerType(QualType,
                                   AccessSpecifier BaseAccess = AS_public);
 
+/// Creates an atom in `A` for the nullability model (e.g. for the null state of
+/// a pointer), and counts it in `nullabilityAtomsCreated()`.
+dataflow::Atom makeNullabilityAtom(dataflow::Arena &A);
+
+/// The number of atoms that `makeNullabilityAtom()` has created on this
+/// thread. The difference between two calls, on the thread that analyzes some
+/// code, is the number of atoms its analysis created for nullability. (The
+/// arena doesn't count its atoms, and this doesn't include those that the
+/// dataflow framework creates itself, e.g. for flow conditions.)
+uint64_t nullabilityAtomsCreated();
+
 /// Describes the nullability contract of a pointer "slot" within a type.
 ///
 /// This may be concrete: nullable/non-null/unknown nullability.
@@ -192,6 +208,66 @@ std::string nullabilityToString(const TypeNullability &Nullability);
 using GetTypeParamNullability =
     std::optional<TypeNullability>(const SubstTemplateTypeParmType *ST);
 
+/// Memoizes the nullability of types, so that types used throughout a TU (e.g.
+/// by many instantiations of the same templates) are only walked once.
+///
+/// Entries are keyed on the type including its sugar (which carries the
+/// annotations), and on the file it is interpreted in. The cache also memoizes
+/// the governing file of declarations written in macro expansions (see
+/// `getGoverningFile()`). A cache may only be used
+/// with one set of TypeNullabilityDefaults, typically by attaching it to them:
+/// those defaults, and all copies of them, then share the cache. It can outlive
+/// individual analyses, but not the ASTContext.
+///
+/// Not thread-safe.
+class TypeNullabilityCache {
+ public:
+  /// Returns the cached nullability of `T` as written in `File`.
+  /// If `Resugaring`, the caller provides nullability for substituted template
+  /// parameters, so results for types containing them can't be used.
+  absl::Nullable<const TypeNullability *> lookup(QualType T, FileID File,
+                                                 bool Resugaring) {
+    auto It = Entries.find({T.getAsOpaquePtr(), File});
+    if (It == Entries.end() || (Resugaring && It->second.HasTypeParams)) {
+      ++Misses;
+      return nullptr;
+    }
+    ++Hits;
+    return &It->second.Nullability;
+  }
+
+  /// Records the nullability of `T` as written in `File`, ignoring any
+  /// resugaring. `HasTypeParams` is whether `T` contains substituted template
+  /// parameters.
+  void insert(QualType T, FileID File, TypeNullability Nullability,
+              bool HasTypeParams) {
+    Entries.try_emplace({T.getAsOpaquePtr(), File},
+                        Entry{std::move(Nullability), HasTypeParams});
+  }
+
+  size_t size() const { return Entries.size(); }
+  uint64_t hits() const { return Hits; }
+  uint64_t misses() const { return Misses; }
+
+  /// Returns the file whose pragmas govern `Loc`, i.e. the file of its
+  /// expansion location.
+  FileID governingFile(SourceLocation Loc, const SourceManager &SM);
+  /// The number of macro expansions whose governing file has been resolved.
+  size_t expansionFiles() const { return ExpansionFiles.size(); }
+
+ private:
+  struct Entry {
+    TypeNullability Nullability;
+    bool HasTypeParams;
+  };
+
+  llvm::DenseMap<std::pair<const void *, FileID>, Entry> Entries;
+  // The governing file of each macro expansion, keyed by its own FileID.
+  llvm::DenseMap<FileID, FileID> ExpansionFiles;
+  uint64_t Hits = 0;
+  uint64_t Misses = 0;
+};
+
 /// Describes how we should interpret unannotated pointer types (like `int*`).
 /// Typically these are treated as Unknown, and this behavior can be overridden
 /// by per-file pragmas.
@@ -213,6 +289,8 @@ struct TypeNullabilityDefaults {
   // Files where per-file pragmas have changed the default nullability.
   // TODO(sammccall)): this should always be provided, clean up callers.
   absl::Nullable<const NullabilityPragmas *> FileNullability;
+  // If set, getTypeNullability() results are memoized here.
+  absl::Nullable<TypeNullabilityCache *> Cache = nullptr;
 };
 
 /// Traverse over a type to get its nullability. For example, if T is the type
@@ -244,6 +322,9 @@ TypeNullability getTypeNullability(
 
 /// Returns the `FileID` of the file that governs the nullability of `D`.
 FileID getGoverningFile(absl::Nullable<const Decl *> D);
+/// As above, but memoized in `Defaults.Cache` if there is one.
+FileID getGoverningFile(absl::Nullable<const Decl *> D,
+                        const TypeNullabilityDefaults &Defaults);
 
 /// Legacy getTypeNullability variant; treats unannotated pointers as Unknown.
 /// Per-file pragmas are ignored.
@@ -597,6 +597,95 @@ TEST_F(GetTypeNullabilityTest, PragmaSmartPointers) {
               ElementsAre(NullabilityKind::Nullable));
 }
 
+TEST_F(GetTypeNullabilityTest, Cache) {
+  NullabilityPragmas Pragmas;
+  Inputs.Code = R"cpp(
+    template <class X>
+    struct S {
+      using P = X*;
+    };
+    using Target = S<Nullable<int*>>::P;
+    using Plain = Nonnull<int*>*;
+  )cpp";
+  Inputs.MakeAction = makeRegisterPragmasAction(Pragmas);
+  TestAST AST(Inputs);
+  FileID Main = AST.sourceManager().getMainFileID();
+  QualType Templated = getTypedefTarget(AST);
+  QualType Plain = AST.context()
+                       .getTranslationUnitDecl()
+                       ->lookup(&AST.context().Idents.get("Plain"))
+                       .find_first<TypeAliasDecl>()
+                       ->getUnderlyingType();
+
+  TypeNullabilityDefaults Uncached(AST.context(), Pragmas);
+  TypeNullabilityCache Cache;
+  TypeNullabilityDefaults Cached = Uncached;
+  Cached.Cache = &Cache;
+
+  for (QualType T : {Templated, Plain}) {
+    TypeNullability Expected = getTypeNullability(T, Main, Uncached);
+    EXPECT_EQ(getTypeNullability(T, Main, Cached), Expected);
+    EXPECT_EQ(getTypeNullability(T, Main, Cached), Expected);
+  }
+  EXPECT_EQ(Cache.size(), 2);
+  EXPECT_EQ(Cache.misses(), 2);
+  EXPECT_EQ(Cache.hits(), 2);
+
+  // A resugaring callback can change the nullability of types with template
+  // parameters, so the cached result can't be used for them...
+  auto Resugar = [](const SubstTemplateTypeParmType *)
+      -> std::optional<TypeNullability> {
+    return TypeNullability{NullabilityKind::NonNull};
+  };
+  EXPECT_EQ(getTypeNullability(Templated, Main, Cached, Resugar),
+            getTypeNullability(Templated, Main, Uncached, Resugar));
+  EXPECT_EQ(Cache.hits(), 2);
+  // ...but it can for types without any.
+  EXPECT_EQ(getTypeNullability(Plain, Main, Cached, Resugar),
+            getTypeNullability(Plain, Main, Uncached, Resugar));
+  EXPECT_EQ(Cache.hits(), 3);
+}
+
+TEST_F(GetTypeNullabilityTest, CacheGoverningFileOfMacroExpansions) {
+  NullabilityPragmas Pragmas;
+  Inputs.ExtraFiles["macros.h"] = R"cpp(
+#pragma nullability file_default nullable
+#define ALIAS(Name) using Name = int *;
+#define TWO_ALIASES(A, B) ALIAS(A) ALIAS(B)
+  )cpp";
+  Inputs.Code = R"cpp(
+#include "macros.h"
+#pragma nullability file_default nonnull
+    TWO_ALIASES(First, Second)
+    ALIAS(Third)
+    using Plain = int *;
+  )cpp";
+  Inputs.MakeAction = makeRegisterPragmasAction(Pragmas);
+  TestAST AST(Inputs);
+
+  TypeNullabilityDefaults Uncached(AST.context(), Pragmas);
+  TypeNullabilityCache Cache;
+  TypeNullabilityDefaults Cached = Uncached;
+  Cached.Cache = &Cache;
+
+  for (llvm::StringRef Name : {"First", "Second", "Third", "Plain"}) {
+    SCOPED_TRACE(Name);
+    const auto *Alias = AST.context()
+                            .getTranslationUnitDecl()
+                            ->lookup(&AST.context().Idents.get(Name))
+                            .find_first<TypeAliasDecl>();
+    ASSERT_NE(Alias, nullptr);
+    FileID Expected = getGoverningFile(Alias);
+    EXPECT_EQ(Expected, AST.sourceManager().getMainFileID());
+    EXPECT_EQ(getGoverningFile(Alias, Cached), Expected);
+    EXPECT_EQ(getGoverningFile(Alias, Cached), Expected);
+    EXPECT_THAT(getTypeNullability(*Alias, Cached),
+                ElementsAre(NullabilityKind::NonNull));
+  }
+  // The declarations written in macro expansions were memoized.
+  EXPECT_GT(Cache.expansionFiles(), 0);
+}
+
 TEST(IsUnknownValidOnTest, All) {
   std::string Preamble = R"cpp(
     namespace std {
@@ -8,6 +8,7 @@
 #include "rs_bindings_from_cc/importer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "llvm/Support/TimeProfiler.h"
 
 namespace crubit {
 
@@ -20,6 +21,7 @@ void AstConsumer::HandleTranslationUnit(clang::ASTContext& ast_context) {
     return;
   }
   CHECK(instance_.hasSema());
+  llvm::TimeTraceScope time_trace("Import");
   Importer importer(invocation_, ast_context, instance_.getSema());
   importer.Import(ast_context.getTranslationUnitDecl());
 }
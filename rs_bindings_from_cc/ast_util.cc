@@ -4,8 +4,12 @@
 
 #include "rs_bindings_from_cc/ast_util.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/functional/function_ref.h"
 #include "absl/strings/str_cat.h"
@@ -16,6 +20,10 @@
 #include "clang/AST/Type.h"
 #include "clang/Basic/AttrKinds.h"
 #include "clang/Basic/LLVM.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 
 namespace crubit {
 
@@ -96,4 +104,80 @@ std::optional<std::string> CollectUnknownTypeAttrs(
   return unknown_attr;
 }
 
+TranslationUnitPositions::TranslationUnitPositions(
+    const clang::SourceManager& sm)
+    : sm_(sm) {
+  struct Entry {
+    clang::FileID file_id;
+    size_t parent;
+    unsigned include_offset;
+    // The length of the file with everything it includes, plus one so that
+    // the file ends before the location right after its `#include`.
+    uint64_t length;
+  };
+  // Files are entered in the order in which they are included, so a file's
+  // entry comes after the entries of the files that include it.
+  std::vector<Entry> entries;
+  llvm::DenseMap<clang::FileID, size_t> entry_indices;
+  clang::FileID main_file_id = sm.getMainFileID();
+  for (unsigned i = 0; i < sm.local_sloc_entry_size(); ++i) {
+    const clang::SrcMgr::SLocEntry& sloc_entry = sm.getLocalSLocEntry(i);
+    if (!sloc_entry.isFile()) continue;
+    clang::FileID file_id = sm.getFileID(
+        clang::SourceLocation::getFromRawEncoding(sloc_entry.getOffset()));
+    Entry entry = {.file_id = file_id,
+                   .parent = entries.size(),
+                   .include_offset = 0,
+                   .length = sm.getFileIDSize(file_id) + 1ull};
+    if (file_id != main_file_id) {
+      clang::SourceLocation include_loc =
+          sloc_entry.getFile().getIncludeLoc();
+      if (include_loc.isInvalid() || !include_loc.isFileID()) continue;
+      auto [parent_file_id, include_offset] =
+          sm.getDecomposedLoc(include_loc);
+      auto parent = entry_indices.find(parent_file_id);
+      if (parent == entry_indices.end()) continue;
+      entry.parent = parent->second;
+      entry.include_offset = include_offset;
+    }
+    entry_indices[file_id] = entries.size();
+    entries.push_back(entry);
+  }
+
+  for (size_t i = entries.size(); i-- > 0;) {
+    if (entries[i].parent != i) {
+      entries[entries[i].parent].length += entries[i].length;
+    }
+  }
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const Entry& entry = entries[i];
+    uint64_t start = 0;
+    if (entry.parent != i) {
+      File& parent = files_[entries[entry.parent].file_id];
+      uint64_t included_length =
+          parent.includes.empty() ? 0 : parent.includes.back().second;
+      start = parent.start + entry.include_offset + included_length + 1;
+      parent.includes.push_back(
+          {entry.include_offset, included_length + entry.length});
+    }
+    files_[entry.file_id].start = start;
+  }
+}
+
+std::optional<uint64_t> TranslationUnitPositions::GetPosition(
+    clang::SourceLocation loc) const {
+  if (loc.isInvalid()) return std::nullopt;
+  auto [file_id, offset] = sm_.getDecomposedExpansionLoc(loc);
+  auto it = files_.find(file_id);
+  if (it == files_.end()) return std::nullopt;
+  const File& file = it->second;
+  auto include = llvm::partition_point(
+      file.includes, [offset = offset](const auto& include) {
+        return include.first < offset;
+      });
+  uint64_t included_length =
+      include == file.includes.begin() ? 0 : std::prev(include)->second;
+  return file.start + offset + included_length;
+}
+
 }  // namespace crubit
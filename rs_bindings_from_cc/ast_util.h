@@ -5,13 +5,19 @@
 #ifndef CRUBIT_RS_BINDINGS_FROM_CC_AST_UTIL_H_
 #define CRUBIT_RS_BINDINGS_FROM_CC_AST_UTIL_H_
 
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/functional/function_ref.h"
 #include "clang/AST/Attr.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/Basic/AttrKinds.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
 
 namespace crubit {
 
@@ -37,6 +43,37 @@ std::optional<std::string> CollectUnknownTypeAttrs(
     const clang::Type& t, absl::FunctionRef<bool(clang::attr::Kind)> is_known =
                               [](clang::attr::Kind attr) { return false; });
 
+// Positions of the locations in a translation unit: integers that are ordered
+// like `SourceManager::isBeforeInTranslationUnit()` orders the locations, but
+// that are much cheaper to compare.
+//
+// The position of a location is its offset in the translation unit with every
+// `#include` replaced by the contents of the included file. Positions are only
+// known for the files that the main file had included, directly or not, when
+// the object was created.
+class TranslationUnitPositions {
+ public:
+  explicit TranslationUnitPositions(const clang::SourceManager& sm);
+
+  // Returns the position of the expansion location of `loc`, or nullopt if it
+  // isn't in a file included by the main file (e.g. because it is in a module
+  // or in the predefines buffer).
+  //
+  // Note that all locations in a macro expansion have the same position.
+  std::optional<uint64_t> GetPosition(clang::SourceLocation loc) const;
+
+ private:
+  struct File {
+    uint64_t start = 0;
+    // The offsets of the `#include`s in this file, in order, each with the
+    // total length of the files included up to and including it.
+    std::vector<std::pair<unsigned, uint64_t>> includes;
+  };
+
+  const clang::SourceManager& sm_;
+  llvm::DenseMap<clang::FileID, File> files_;
+};
+
 }  // namespace crubit
 
 #endif  // CRUBIT_RS_BINDINGS_FROM_CC_AST_UTIL_H_
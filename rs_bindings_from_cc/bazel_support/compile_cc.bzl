@@ -12,7 +12,9 @@ def compile_cc(
         feature_configuration,
         src,
         cc_infos,
-        extra_cc_compilation_action_inputs):
+        extra_cc_compilation_action_inputs,
+        extra_srcs = [],
+        extra_copts = []):
     """Compiles a C++ source file.
 
     Args:
@@ -23,6 +25,9 @@ def compile_cc(
       src: The source file to be compiled.
       cc_infos: List[CcInfo]: A list of CcInfo dependencies.
       extra_cc_compilation_action_inputs: A list of input files for the C++ compilation action.
+      extra_srcs: Further source files to be compiled into the same library, each by its own
+        compilation action.
+      extra_copts: Further compiler flags, added after the `copts` of the current rule.
 
     Returns:
       A CcInfo provider.
@@ -33,13 +38,14 @@ def compile_cc(
     for copt in getattr(attr, "copts", []):
         # ctx.expand_make_variables is deprecated, but its replacement ctx.var does not suffice.
         user_copts.append(ctx.expand_make_variables("copts", copt, {}))
+    user_copts.extend(extra_copts)
 
     (compilation_context, compilation_outputs) = cc_common.compile(
         name = src.basename,
         actions = ctx.actions,
         feature_configuration = feature_configuration,
         cc_toolchain = cc_toolchain,
-        srcs = [src],
+        srcs = [src] + extra_srcs,
         additional_inputs = extra_cc_compilation_action_inputs,
         user_compile_flags = user_copts,
         compilation_contexts = [cc_info.compilation_context],
@@ -34,7 +34,15 @@ def _get_cc_info(providers):
             return provider
     fail("Couldn't find a CcInfo in the list of providers")
 
-def compile_rust(ctx, attr, src, extra_srcs, deps, crate_name, include_coverage):
+def compile_rust(
+        ctx,
+        attr,
+        src,
+        extra_srcs,
+        deps,
+        crate_name,
+        include_coverage,
+        extra_rustc_flags = []):
     """Compiles a Rust source file.
 
     Args:
@@ -45,6 +53,7 @@ def compile_rust(ctx, attr, src, extra_srcs, deps, crate_name, include_coverage)
       deps: List[DepVariantInfo]: A list of dependencies needed.
       crate_name: (string) crate name for naming the output files (.rlib, .rmeta...))
       include_coverage: (bool) Whether or not coverage information should be generated.
+      extra_rustc_flags: List[str]: Further flags to pass to rustc.
 
     Returns:
       A DepVariantInfo provider.
@@ -68,6 +77,12 @@ def compile_rust(ctx, attr, src, extra_srcs, deps, crate_name, include_coverage)
     )
 
     lib = ctx.actions.declare_file(lib_name)
+
+    # Passing `metadata` makes `rustc_compile_action` emit the .rmeta in a separate
+    # `RustcMetadata` action, whichever way the `pipelined_compilation` setting of rules_rust is
+    # set, and makes dependent bindings crates compile against it rather than the .rlib. So they
+    # start once metadata is ready, without waiting for the codegen of large bindings crates (see
+    # //rs_bindings_from_cc/test/bazel_unit_tests/pipelined_compilation).
     rmeta = ctx.actions.declare_file(rmeta_name)
 
     # TODO(b/336367148): We should inherit almost nothing from `attr`, but for now, at least, we
@@ -97,7 +112,7 @@ def compile_rust(ctx, attr, src, extra_srcs, deps, crate_name, include_coverage)
         ),
         rust_flags = ctx.attr._extra_rustc_flags[ExtraRustcFlagsInfo].extra_rustc_flags + ["-Zallow-features=custom_inner_attributes,impl_trait_in_assoc_type,register_tool,negative_impls,vec_into_raw_parts,extern_types,arbitrary_self_types"] +
                      # TODO(b/349776381): remove.
-                     ["-Adead_code"],
+                     ["-Adead_code"] + extra_rustc_flags,
         output_hash = output_hash,
         force_all_deps_direct = True,
         include_coverage = include_coverage,
@@ -52,7 +52,8 @@ def generate_bindings(
         action_inputs,
         target_args,
         extra_rs_srcs,
-        extra_rs_bindings_from_cc_cli_flags):
+        extra_rs_bindings_from_cc_cli_flags,
+        type_manifests = []):
     """Runs the bindings generator.
 
     Args:
@@ -68,25 +69,66 @@ def generate_bindings(
                         its per-target arguments (headers, features) in json format.
       extra_rs_srcs: A list of extra source files to add.
       extra_rs_bindings_from_cc_cli_flags: CLI flags to be passed to `rs_bindings_from_cc`.
+      type_manifests: The type manifests of the direct dependencies, if the `type_manifests` build
+                      setting is enabled.
 
     Returns:
-      tuple(cc_output, rs_output, namespaces_output, error_report_output): The generated source files.
+      tuple(cc_output, extra_cc_outputs, rs_output, namespaces_output, error_report_output,
+      type_manifest_output, bloat_report_output): The generated source files. `extra_cc_outputs`
+      are the further shards of `cc_output`, if the `rs_api_impl_shards` build setting asks for
+      more than one. `type_manifest_output` is None unless the `type_manifests` build setting is
+      enabled, and `bloat_report_output` unless the `generate_bloat_report` one is.
     """
     crate_name = escape_cpp_target_name(ctx.label.package, ctx.label.name)
     cc_output = ctx.actions.declare_file(crate_name + "_rust_api_impl.cc")
+    extra_cc_outputs = [
+        ctx.actions.declare_file("%s_rust_api_impl_%d.cc" % (crate_name, shard))
+        for shard in range(1, ctx.attr._rs_api_impl_shards[BuildSettingInfo].value)
+    ]
     rs_output = ctx.actions.declare_file(crate_name + "_rust_api.rs")
     namespaces_output = ctx.actions.declare_file(crate_name + "_namespaces.json")
     error_report_output = None
+    type_manifest_output = None
+    bloat_report_output = None
 
-    rs_bindings_from_cc_flags = [
+    # The flags for parsing the headers into the IR.
+    parse_flags = [
         "--stderrthreshold=2",
         "--target=" + str(ctx.label),
+        "--namespaces_out",
+        namespaces_output.path,
+    ]
+    if ctx.attr._lazy_import[BuildSettingInfo].value:
+        parse_flags.append("--lazy_import")
+    if ctx.attr._string_view_as_slice_pointer[BuildSettingInfo].value:
+        parse_flags.append("--string_view_as_slice_pointer")
+    template_instantiation_budget = ctx.attr._template_instantiation_budget[BuildSettingInfo].value
+    if template_instantiation_budget >= 0:
+        parse_flags.append("--template_instantiation_budget=%d" % template_instantiation_budget)
+
+    # Passed to the parse action only, and only without an error report, as that needs the messages
+    # of the unsupported items (which the codegen action may write from the IR).
+    if (not ctx.attr._unsupported_item_comments[BuildSettingInfo].value and
+        not ctx.attr._generate_error_report[BuildSettingInfo].value):
+        parse_flags.append("--unsupported_item_comments=false")
+    if ctx.attr._type_manifests[BuildSettingInfo].value:
+        type_manifest_output = ctx.actions.declare_file(crate_name + "_type_manifest.json")
+        parse_flags += [
+            "--type_manifest_out",
+            type_manifest_output.path,
+        ]
+        if type_manifests:
+            parse_flags.append("--type_manifests=" + ",".join([f.path for f in type_manifests]))
+    else:
+        type_manifests = []
+    type_manifest_outputs = [type_manifest_output] if type_manifest_output else []
+
+    # The flags for generating the bindings from the IR.
+    codegen_flags = [
         "--rs_out",
         rs_output.path,
         "--cc_out",
         cc_output.path,
-        "--namespaces_out",
-        namespaces_output.path,
         "--crubit_support_path_format",
         "\"support/{header}\"",
         "--clang_format_exe_path",
@@ -95,13 +137,64 @@ def generate_bindings(
         ctx.file._rustfmt.path,
         "--rustfmt_config_path",
         ctx.file._rustfmt_cfg.path,
-    ] + extra_rs_bindings_from_cc_cli_flags
+    ]
+    if extra_cc_outputs:
+        codegen_flags += [
+            "--extra_cc_out",
+            ",".join([f.path for f in extra_cc_outputs]),
+        ]
+    if ctx.attr._skip_formatting[BuildSettingInfo].value:
+        codegen_flags.append("--skip_formatting")
+    if ctx.attr._compact_layout_assertions[BuildSettingInfo].value:
+        codegen_flags.append("--compact_layout_assertions")
+    if ctx.attr._inline_always_forwarding_only[BuildSettingInfo].value:
+        codegen_flags.append("--inline_always_forwarding_only")
+    if ctx.attr._minimal_rs_api_impl_includes[BuildSettingInfo].value:
+        codegen_flags.append("--minimal_rs_api_impl_includes")
+    if ctx.attr._rust_enums[BuildSettingInfo].value:
+        codegen_flags.append("--rust_enums")
     if ctx.attr._generate_error_report[BuildSettingInfo].value:
-        error_report_output = ctx.actions.declare_file(crate_name + "_rust_api_error_report.json")
-        rs_bindings_from_cc_flags += [
+        if ctx.attr._binary_error_report[BuildSettingInfo].value:
+            error_report_output = ctx.actions.declare_file(crate_name + "_rust_api_error_report.bin")
+            codegen_flags.append("--binary_error_report")
+        else:
+            error_report_output = ctx.actions.declare_file(crate_name + "_rust_api_error_report.json")
+        codegen_flags += [
             "--error_report_out",
             error_report_output.path,
         ]
+    if ctx.attr._generate_bloat_report[BuildSettingInfo].value:
+        bloat_report_output = ctx.actions.declare_file(crate_name + "_rust_api_bloat_report.json")
+        codegen_flags += [
+            "--bloat_report_out",
+            bloat_report_output.path,
+        ]
+    codegen_outputs = [cc_output, rs_output] + extra_cc_outputs + [
+        x
+        for x in [error_report_output, bloat_report_output]
+        if x
+    ]
+    codegen_inputs = [
+        ctx.executable._clang_format,
+        ctx.executable._rustfmt,
+    ] + ctx.files._rustfmt_cfg
+
+    split_ir_action = ctx.attr._split_ir_action[BuildSettingInfo].value
+    if split_ir_action:
+        ir_output = ctx.actions.declare_file(crate_name + "_rust_api_ir.json")
+        rs_bindings_from_cc_flags = parse_flags + [
+            "--ir_only",
+            "--ir_out",
+            ir_output.path,
+        ] + extra_rs_bindings_from_cc_cli_flags
+        compile_action_output = ir_output
+        compile_action_additional_outputs = [namespaces_output] + type_manifest_outputs
+        compile_action_additional_inputs = [ctx.executable._generator] + type_manifests
+    else:
+        rs_bindings_from_cc_flags = parse_flags + codegen_flags + extra_rs_bindings_from_cc_cli_flags
+        compile_action_output = cc_output
+        compile_action_additional_outputs = [f for f in codegen_outputs if f != cc_output] + [namespaces_output] + type_manifest_outputs
+        compile_action_additional_inputs = [ctx.executable._generator] + codegen_inputs + type_manifests
 
     # TODO(b/324159705): Remove this workaround and fix
     # built_in_include_directories logic once we switch to libc++ runtimes on
@@ -136,7 +229,8 @@ def generate_bindings(
         },
     )
 
-    # Run the `rs_bindings_from_cc` to generate the _rust_api_impl.cc and _rust_api.rs files.
+    # Run the `rs_bindings_from_cc` to parse the headers, and (unless `split_ir_action` is set) to
+    # generate the _rust_api_impl.cc and _rust_api.rs files.
     cc_common.create_compile_action(
         compilation_context = compilation_context,
         actions = ctx.actions,
@@ -144,16 +238,24 @@ def generate_bindings(
         feature_configuration = feature_configuration,
         cc_toolchain = cc_toolchain,
         source_file = public_hdrs[0],
-        output_file = cc_output,
+        output_file = compile_action_output,
         additional_inputs = depset(
-            direct = [
-                ctx.executable._clang_format,
-                ctx.executable._rustfmt,
-                ctx.executable._generator,
-            ] + ctx.files._rustfmt_cfg + extra_rs_srcs,
+            direct = compile_action_additional_inputs + extra_rs_srcs,
             transitive = [action_inputs],
         ),
-        additional_outputs = [x for x in [rs_output, namespaces_output, error_report_output] if x != None],
+        additional_outputs = compile_action_additional_outputs,
         variables = variables,
     )
-    return (cc_output, rs_output, namespaces_output, error_report_output)
+
+    if split_ir_action:
+        # Only the IR is an input of this action, so it is a cache hit whenever the IR didn't
+        # change, and so are the actions that compile its outputs.
+        ctx.actions.run(
+            executable = ctx.executable._generator,
+            arguments = ["--stderrthreshold=2", "--ir_in", ir_output.path] + codegen_flags + extra_rs_bindings_from_cc_cli_flags,
+            inputs = [ir_output] + codegen_inputs,
+            outputs = codegen_outputs,
+            mnemonic = "CppBindingsFromIr",
+            progress_message = "Generating Rust bindings from the IR of %{label}",
+        )
+    return (cc_output, extra_cc_outputs, rs_output, namespaces_output, error_report_output, type_manifest_output, bloat_report_output)
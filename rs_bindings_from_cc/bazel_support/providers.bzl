@@ -17,6 +17,9 @@ RustBindingsFromCcInfo = provider(
                         "{'t': <target>, 'h': [<header>], 'f': [<feature>]}"),
         "namespaces": ("A json file containing the namespace hierarchy for the target we " +
                        "are generating bindings for, or None."),
+        "type_manifest": ("A json file listing the records that the target declares at " +
+                          "namespace scope, and whether it defines them, or None. See " +
+                          "`rs_bindings_from_cc --type_manifest_out`."),
     },
 )
 
@@ -225,6 +225,12 @@ def _rust_bindings_from_cc_aspect_impl(target, ctx):
             if RustBindingsFromCcInfo in dep
         ] + ctx.attr._deps_for_bindings[DepsForBindingsInfo].deps_for_rs_file,
         extra_cc_compilation_action_inputs = extra_cc_compilation_action_inputs,
+        type_manifests = [
+            dep[RustBindingsFromCcInfo].type_manifest
+            for dep in all_deps
+            if RustBindingsFromCcInfo in dep and
+               getattr(dep[RustBindingsFromCcInfo], "type_manifest", None)
+        ],
         extra_rs_bindings_from_cc_cli_flags = collect_rust_bindings_from_cc_cli_flags(target, ctx),
     )
 
@@ -21,6 +21,7 @@ load(
     "GeneratedBindingsInfo",
     "RustBindingsFromCcInfo",
 )
+load("@bazel_skylib//rules:common_settings.bzl", "BuildSettingInfo")
 load("@bazel_tools//tools/cpp:toolchain_utils.bzl", "find_cpp_toolchain")
 
 def generate_and_compile_bindings(
@@ -35,7 +36,8 @@ def generate_and_compile_bindings(
         deps_for_cc_file,
         deps_for_rs_file,
         extra_cc_compilation_action_inputs = [],
-        extra_rs_bindings_from_cc_cli_flags = []):
+        extra_rs_bindings_from_cc_cli_flags = [],
+        type_manifests = []):
     """Runs the bindings generator.
 
     Args:
@@ -53,20 +55,31 @@ def generate_and_compile_bindings(
       extra_cc_compilation_action_inputs: A list of input files for the C++ compilation action.
       extra_rs_bindings_from_cc_cli_flags: CLI flags to pass to `rs_bindings_from_cc`, in addition
                                            to the flags that are passed by the build rule.
+      type_manifests: list[File]: The type manifests of the direct dependencies.
     Returns:
       A RustBindingsFromCcInfo containing the result of the compilation of the generated source
       files, as well a GeneratedBindingsInfo provider containing the generated source files.
     """
     cc_toolchain = find_cpp_toolchain(ctx)
 
+    # By default, bindings generation parses the whole transitive closure of the public headers
+    # from source. With header modules, Clang instead loads the modules precompiled by the
+    # compilation of each `cc_library` in the closure, so that deep dependency chains are parsed
+    # once rather than once per dependent target.
+    if ctx.attr._use_header_modules[BuildSettingInfo].value:
+        bindings_features = ["compiler_param_file", "module_maps", "use_header_modules"]
+        bindings_unsupported_features = []
+    else:
+        bindings_features = ["compiler_param_file"]
+        bindings_unsupported_features = ["module_maps"]
     feature_configuration_for_bindings = cc_common.configure_features(
         ctx = ctx,
         cc_toolchain = cc_toolchain,
-        requested_features = ctx.features + ["compiler_param_file"],
-        unsupported_features = ctx.disabled_features + ["module_maps"],
+        requested_features = ctx.features + bindings_features,
+        unsupported_features = ctx.disabled_features + bindings_unsupported_features,
     )
 
-    cc_output, rs_output, namespaces_output, error_report_output = generate_bindings(
+    cc_output, extra_cc_outputs, rs_output, namespaces_output, error_report_output, type_manifest_output, bloat_report_output = generate_bindings(
         ctx = ctx,
         attr = attr,
         cc_toolchain = cc_toolchain,
@@ -78,6 +91,7 @@ def generate_and_compile_bindings(
         target_args = target_args,
         extra_rs_srcs = extra_rs_srcs,
         extra_rs_bindings_from_cc_cli_flags = extra_rs_bindings_from_cc_cli_flags,
+        type_manifests = type_manifests,
     )
 
     # Relocate the rs files so that they can be read by rustc using relative paths.
@@ -97,6 +111,17 @@ def generate_and_compile_bindings(
         unsupported_features = ctx.disabled_features + ["module_maps"],
     )
 
+    # With cross-language LTO, the thunks in "_rust_api_impl.cc" and the Rust code calling them are
+    # both compiled to LLVM bitcode, so that the linker can inline the thunks into their Rust
+    # callers. This requires clang and rustc to use the same LLVM version, and the final binary to
+    # be linked by a linker that performs ThinLTO on bitcode inputs (e.g. lld with `-flto=thin`).
+    if ctx.attr._cross_language_lto[BuildSettingInfo].value:
+        lto_copts = ["-flto=thin"]
+        lto_rustc_flags = ["-Clinker-plugin-lto"]
+    else:
+        lto_copts = []
+        lto_rustc_flags = []
+
     # Compile the "_rust_api_impl.cc" file
     cc_info = compile_cc(
         ctx,
@@ -106,6 +131,8 @@ def generate_and_compile_bindings(
         cc_output,
         deps_for_cc_file,
         extra_cc_compilation_action_inputs,
+        extra_srcs = extra_cc_outputs,
+        extra_copts = lto_copts,
     )
 
     # TODO(b/216587072): Remove this hacky escaping and use the import! macro once available
@@ -124,6 +151,7 @@ def generate_and_compile_bindings(
         # the .dat file with the underlying cc_library. Once bazel supports baseline_coverage.dat
         # for aspects, we can remove this option.
         include_coverage = False,
+        extra_rustc_flags = lto_rustc_flags,
     )
 
     return [
@@ -132,13 +160,18 @@ def generate_and_compile_bindings(
             dep_variant_info = dep_variant_info,
             target_args = target_args,
             namespaces = namespaces_output,
+            type_manifest = type_manifest_output,
         ),
         GeneratedBindingsInfo(
             cc_file = cc_output,
             rust_file = rs_output,
             namespaces_file = namespaces_output,
         ),
-        OutputGroupInfo(out = depset([x for x in [cc_output, rs_output, namespaces_output, error_report_output] if x != None])),
+        OutputGroupInfo(
+            out = depset([x for x in [cc_output, rs_output, namespaces_output, error_report_output, type_manifest_output] if x != None] + extra_cc_outputs),
+            # For //common:bloat_report_aggregator.
+            bloat_report = depset([bloat_report_output] if bloat_report_output else []),
+        ),
         # The C++ bindings of the generated Rust bindings are the original C++ file.
         CcBindingsFromRustInfo(
             cc_info = cc_info,
@@ -198,4 +231,52 @@ bindings_attrs = {
     "_generate_error_report": attr.label(
         default = "@@//rs_bindings_from_cc/bazel_support:generate_error_report",
     ),
+    "_binary_error_report": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:binary_error_report",
+    ),
+    "_generate_bloat_report": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:generate_bloat_report",
+    ),
+    "_use_header_modules": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:use_header_modules",
+    ),
+    "_rs_api_impl_shards": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:rs_api_impl_shards",
+    ),
+    "_lazy_import": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:lazy_import",
+    ),
+    "_string_view_as_slice_pointer": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:string_view_as_slice_pointer",
+    ),
+    "_template_instantiation_budget": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:template_instantiation_budget",
+    ),
+    "_unsupported_item_comments": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:unsupported_item_comments",
+    ),
+    "_skip_formatting": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:skip_formatting",
+    ),
+    "_compact_layout_assertions": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:compact_layout_assertions",
+    ),
+    "_inline_always_forwarding_only": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:inline_always_forwarding_only",
+    ),
+    "_minimal_rs_api_impl_includes": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:minimal_rs_api_impl_includes",
+    ),
+    "_rust_enums": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:rust_enums",
+    ),
+    "_type_manifests": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:type_manifests",
+    ),
+    "_split_ir_action": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:split_ir_action",
+    ),
+    "_cross_language_lto": attr.label(
+        default = "@@//rs_bindings_from_cc/bazel_support:cross_language_lto",
+    ),
 }
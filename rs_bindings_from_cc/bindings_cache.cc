@@ -0,0 +1,87 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/bindings_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "common/file_io.h"
+#include "rs_bindings_from_cc/generate_bindings_and_metadata.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/xxhash.h"
+
+namespace crubit {
+namespace {
+
+std::string CacheKey(absl::Span<const std::string> command_line) {
+  // The arguments can't contain null characters, so joining them with null
+  // characters keeps them apart.
+  return absl::StrJoin(command_line, absl::string_view("\0", 1));
+}
+
+std::optional<uint64_t> HashFile(absl::string_view path) {
+  absl::StatusOr<std::unique_ptr<llvm::MemoryBuffer>> contents =
+      MapFileContents(path);
+  if (!contents.ok()) return std::nullopt;
+  return llvm::xxh3_64bits(
+      llvm::arrayRefFromStringRef((*contents)->getBuffer()));
+}
+
+}  // namespace
+
+const BindingsAndMetadata* BindingsCache::Find(
+    absl::Span<const std::string> command_line) {
+  auto it = entries_by_key_.find(CacheKey(command_line));
+  if (it == entries_by_key_.end()) return nullptr;
+  std::list<Entry>::iterator entry = it->second;
+  for (const auto& [path, hash] : entry->file_hashes) {
+    if (HashFile(path) != hash) {
+      entries_by_key_.erase(it);
+      entries_.erase(entry);
+      return nullptr;
+    }
+  }
+  entries_.splice(entries_.begin(), entries_, entry);
+  return &entry->bindings;
+}
+
+void BindingsCache::Insert(absl::Span<const std::string> command_line,
+                           BindingsAndMetadata bindings) {
+  std::string key = CacheKey(command_line);
+  if (auto it = entries_by_key_.find(key); it != entries_by_key_.end()) {
+    entries_.erase(it->second);
+    entries_by_key_.erase(it);
+  }
+  if (max_entries_ == 0) return;
+
+  std::vector<std::pair<std::string, uint64_t>> file_hashes;
+  file_hashes.reserve(bindings.input_files.size());
+  for (const std::string& path : bindings.input_files) {
+    std::optional<uint64_t> hash = HashFile(path);
+    if (!hash.has_value()) return;
+    file_hashes.emplace_back(path, *hash);
+  }
+
+  if (entries_.size() == max_entries_) {
+    entries_by_key_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+  entries_.push_front(Entry{.key = key,
+                            .file_hashes = std::move(file_hashes),
+                            .bindings = std::move(bindings)});
+  entries_by_key_.emplace(std::move(key), entries_.begin());
+}
+
+}  // namespace crubit
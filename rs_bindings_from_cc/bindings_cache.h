@@ -0,0 +1,66 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_BINDINGS_CACHE_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_BINDINGS_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "rs_bindings_from_cc/generate_bindings_and_metadata.h"
+
+namespace crubit {
+
+// The bindings generated for the previous requests of a persistent worker,
+// which are kept in memory and reused for a request with the same command
+// line if none of their `input_files` changed since. Repeated requests for
+// the same targets (e.g. from an editor, which asks for the bindings of the
+// targets being edited again and again) then only hash the input files,
+// rather than parsing the headers and generating the bindings again.
+//
+// Like in the migrator's `ConversionManifest`, the include closure is not
+// recomputed, so a new header that shadows one of the input files (e.g. in an
+// earlier include directory) goes unnoticed.
+class BindingsCache {
+ public:
+  // Keeps the bindings of at most `max_entries` command lines, evicting the
+  // least recently used ones.
+  explicit BindingsCache(size_t max_entries) : max_entries_(max_entries) {}
+
+  // Returns the cached bindings of `command_line`, or null if there are none
+  // or if they are out of date. The bindings stay valid until the next call to
+  // `Insert`.
+  const BindingsAndMetadata* Find(absl::Span<const std::string> command_line);
+
+  // Caches the `bindings` generated for `command_line`, with the current
+  // contents of their `input_files`. The bindings are not cached if an input
+  // file can't be read.
+  void Insert(absl::Span<const std::string> command_line,
+              BindingsAndMetadata bindings);
+
+  size_t size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    std::string key;
+    // Pairs of a path and the hash of the contents of the file.
+    std::vector<std::pair<std::string, uint64_t>> file_hashes;
+    BindingsAndMetadata bindings;
+  };
+
+  const size_t max_entries_;
+  // The most recently used entry comes first.
+  std::list<Entry> entries_;
+  absl::flat_hash_map<std::string, std::list<Entry>::iterator> entries_by_key_;
+};
+
+}  // namespace crubit
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_BINDINGS_CACHE_H_
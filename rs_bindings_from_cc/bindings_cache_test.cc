@@ -0,0 +1,108 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/bindings_cache.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/file_io.h"
+#include "rs_bindings_from_cc/generate_bindings_and_metadata.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::Field;
+using ::testing::IsNull;
+using ::testing::Pointee;
+
+const std::vector<std::string> kCommandLine = {"--target=//foo:bar",
+                                               "--rs_out=foo.rs"};
+
+// Writes `contents` into a new file in the test's temporary directory.
+std::string WriteTestFile(absl::string_view name, absl::string_view contents) {
+  std::string path = absl::StrCat(testing::TempDir(), "/", name);
+  CHECK_OK(SetFileContents(path, contents));
+  return path;
+}
+
+BindingsAndMetadata MakeBindings(absl::string_view ir_json,
+                                 std::vector<std::string> input_files) {
+  return BindingsAndMetadata{.ir_json = std::string(ir_json),
+                             .input_files = std::move(input_files)};
+}
+
+TEST(BindingsCacheTest, FindsUpToDateBindings) {
+  std::string header = WriteTestFile("up_to_date.h", "struct Foo {};");
+  BindingsCache cache(/*max_entries=*/4);
+  cache.Insert(kCommandLine, MakeBindings("{}", {header}));
+
+  EXPECT_THAT(cache.Find(kCommandLine),
+              Pointee(Field(&BindingsAndMetadata::ir_json, "{}")));
+}
+
+TEST(BindingsCacheTest, DifferentCommandLine) {
+  std::string header = WriteTestFile("command_line.h", "struct Foo {};");
+  BindingsCache cache(/*max_entries=*/4);
+  cache.Insert(kCommandLine, MakeBindings("{}", {header}));
+
+  EXPECT_THAT(cache.Find({"--target=//foo:bar"}), IsNull());
+  // The arguments are kept apart.
+  EXPECT_THAT(cache.Find({"--target=//foo:bar--rs_out=foo.rs"}), IsNull());
+}
+
+TEST(BindingsCacheTest, ChangedInputFile) {
+  std::string header = WriteTestFile("changed.h", "struct Foo {};");
+  BindingsCache cache(/*max_entries=*/4);
+  cache.Insert(kCommandLine, MakeBindings("{}", {header}));
+
+  WriteTestFile("changed.h", "struct Bar {};");
+  EXPECT_THAT(cache.Find(kCommandLine), IsNull());
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(BindingsCacheTest, UnreadableInputFileIsNotCached) {
+  BindingsCache cache(/*max_entries=*/4);
+  cache.Insert(kCommandLine,
+               MakeBindings("{}", {absl::StrCat(testing::TempDir(),
+                                                "/does_not_exist.h")}));
+
+  EXPECT_THAT(cache.Find(kCommandLine), IsNull());
+}
+
+TEST(BindingsCacheTest, EvictsLeastRecentlyUsed) {
+  std::string header = WriteTestFile("evicted.h", "struct Foo {};");
+  BindingsCache cache(/*max_entries=*/2);
+  cache.Insert({"a"}, MakeBindings("a", {header}));
+  cache.Insert({"b"}, MakeBindings("b", {header}));
+  ASSERT_NE(cache.Find({"a"}), nullptr);
+  cache.Insert({"c"}, MakeBindings("c", {header}));
+
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_THAT(cache.Find({"a"}),
+              Pointee(Field(&BindingsAndMetadata::ir_json, "a")));
+  EXPECT_THAT(cache.Find({"b"}), IsNull());
+  EXPECT_THAT(cache.Find({"c"}),
+              Pointee(Field(&BindingsAndMetadata::ir_json, "c")));
+}
+
+TEST(BindingsCacheTest, InsertReplacesBindings) {
+  std::string header = WriteTestFile("replaced.h", "struct Foo {};");
+  BindingsCache cache(/*max_entries=*/4);
+  cache.Insert(kCommandLine, MakeBindings("old", {header}));
+  cache.Insert(kCommandLine, MakeBindings("new", {header}));
+
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_THAT(cache.Find(kCommandLine),
+              Pointee(Field(&BindingsAndMetadata::ir_json, "new")));
+}
+
+}  // namespace
+}  // namespace crubit
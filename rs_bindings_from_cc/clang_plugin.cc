@@ -0,0 +1,135 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/clang_plugin.h"
+
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "lifetime_annotations/lifetime_annotations.h"
+#include "rs_bindings_from_cc/ast_consumer.h"
+#include "rs_bindings_from_cc/bazel_types.h"
+#include "rs_bindings_from_cc/decl_importer.h"
+#include "rs_bindings_from_cc/target_args_index.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendPluginRegistry.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace crubit {
+namespace {
+
+void ReportError(clang::DiagnosticsEngine& diagnostics,
+                 llvm::StringRef message) {
+  diagnostics.Report(diagnostics.getCustomDiagID(
+      clang::DiagnosticsEngine::Error, "crubit plugin: %0"))
+      << message;
+}
+
+// Imports the AST like the `AstConsumer` of `rs_bindings_from_cc`, and then
+// writes the IR to `ir_out`.
+class IrWritingAstConsumer : public AstConsumer {
+ public:
+  IrWritingAstConsumer(clang::CompilerInstance& instance,
+                       Invocation& invocation, std::string ir_out)
+      : AstConsumer(instance, invocation),
+        invocation_(invocation),
+        ir_out_(std::move(ir_out)) {}
+
+  void HandleTranslationUnit(clang::ASTContext& ast_context) override {
+    AstConsumer::HandleTranslationUnit(ast_context);
+    // The compile fails anyway, and Clang has already printed the errors.
+    if (ast_context.getDiagnostics().hasErrorOccurred()) return;
+
+    invocation_.AddIndexedCrubitFeatures();
+    std::error_code error;
+    llvm::raw_fd_ostream out(ir_out_, error, llvm::sys::fs::OF_None);
+    if (!error) {
+      invocation_.ir_.WriteJson(out);
+      out.close();
+      error = out.error();
+    }
+    if (error) {
+      ReportError(ast_context.getDiagnostics(),
+                  "could not write the IR to `" + ir_out_ +
+                      "`: " + error.message());
+    }
+  }
+
+ private:
+  Invocation& invocation_;
+  std::string ir_out_;
+};
+
+}  // namespace
+
+bool ClangPluginAction::ParseArgs(const clang::CompilerInstance& instance,
+                                  const std::vector<std::string>& args) {
+  clang::DiagnosticsEngine& diagnostics = instance.getDiagnostics();
+  for (llvm::StringRef arg : args) {
+    auto [name, value] = arg.split('=');
+    if (name == "ir_out") {
+      ir_out_ = value.str();
+    } else if (name == "target") {
+      target_ = BazelLabel(value.str());
+    } else if (name == "public_header") {
+      public_headers_.push_back(HeaderName(value.str()));
+    } else if (name == "target_args_index") {
+      absl::StatusOr<TargetArgsIndex> index = TargetArgsIndex::Open(value);
+      if (!index.ok()) {
+        ReportError(diagnostics, std::string(index.status().message()));
+        return false;
+      }
+      target_args_index_ = *std::move(index);
+    } else if (arg == "lazy_import") {
+      lazy_import_ = true;
+    } else if (name == "template_instantiation_budget") {
+      if (value.getAsInteger(10, template_instantiation_budget_)) {
+        ReportError(diagnostics, "invalid `template_instantiation_budget`: `" +
+                                     value.str() + "`");
+        return false;
+      }
+    } else {
+      ReportError(diagnostics, "unknown argument `" + arg.str() + "`");
+      return false;
+    }
+  }
+  if (ir_out_.empty() || !target_.has_value() || public_headers_.empty()) {
+    ReportError(diagnostics,
+                "please specify `ir_out`, `target` and `public_header`");
+    return false;
+  }
+  // The public headers belong to the target even without an index, which the
+  // headers of the other targets are looked up in.
+  for (const HeaderName& header : public_headers_) {
+    header_targets_.try_emplace(header, *target_);
+  }
+  return true;
+}
+
+std::unique_ptr<clang::ASTConsumer> ClangPluginAction::CreateASTConsumer(
+    clang::CompilerInstance& instance, llvm::StringRef) {
+  invocation_ = std::make_unique<Invocation>(
+      *target_, public_headers_, header_targets_, lazy_import_,
+      target_args_index_.has_value() ? &*target_args_index_ : nullptr,
+      template_instantiation_budget_);
+  AddLifetimeAnnotationHandlers(instance.getPreprocessor(),
+                                invocation_->lifetime_context_);
+  return std::make_unique<IrWritingAstConsumer>(instance, *invocation_,
+                                                ir_out_);
+}
+
+static clang::FrontendPluginRegistry::Add<ClangPluginAction>
+    clang_plugin_registration(kClangPluginName,
+                              "writes the Crubit IR of the compiled headers");
+
+}  // namespace crubit
@@ -0,0 +1,72 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_CLANG_PLUGIN_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_CLANG_PLUGIN_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "rs_bindings_from_cc/bazel_types.h"
+#include "rs_bindings_from_cc/decl_importer.h"
+#include "rs_bindings_from_cc/target_args_index.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace crubit {
+
+// The name of the plugin, as in `-fplugin-arg-crubit-...`.
+inline constexpr llvm::StringRef kClangPluginName = "crubit";
+
+// A Clang plugin that writes the IR of the headers of a target as a side
+// output of a regular compile of these headers, e.g. the header parsing or
+// header module action of the `cc_library`. This avoids parsing the headers
+// again in a separate `rs_bindings_from_cc` action:
+//
+//   clang++ -fsyntax-only -fparse-all-comments \
+//       -fplugin=crubit_clang_plugin.so \
+//       -fplugin-arg-crubit-ir_out=foo_rust_api_ir.json \
+//       -fplugin-arg-crubit-target=//foo:foo \
+//       -fplugin-arg-crubit-public_header=foo/foo.h \
+//       [-fplugin-arg-crubit-target_args_index=target_args.index] \
+//       [-fplugin-arg-crubit-lazy_import] \
+//       [-fplugin-arg-crubit-template_instantiation_budget=1000] \
+//       foo/foo.h
+//
+// The arguments mean the same as the flags of `rs_bindings_from_cc` (see
+// cmdline.cc). `public_header` may be repeated. The IR is then turned into
+// bindings by `rs_bindings_from_cc --ir_in`. The output of the compile itself
+// doesn't change.
+//
+// `--extra_rs_srcs` and `--srcs_to_scan_for_instantiations` need the
+// standalone `rs_bindings_from_cc`.
+class ClangPluginAction : public clang::PluginASTAction {
+ public:
+  bool ParseArgs(const clang::CompilerInstance& instance,
+                 const std::vector<std::string>& args) override;
+
+  ActionType getActionType() override { return AddAfterMainAction; }
+
+  std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
+      clang::CompilerInstance& instance, llvm::StringRef) override;
+
+ private:
+  std::string ir_out_;
+  std::optional<BazelLabel> target_;
+  std::vector<HeaderName> public_headers_;
+  absl::flat_hash_map<HeaderName, BazelLabel> header_targets_;
+  std::optional<TargetArgsIndex> target_args_index_;
+  bool lazy_import_ = false;
+  int template_instantiation_budget_ = -1;
+  std::unique_ptr<Invocation> invocation_;
+};
+
+}  // namespace crubit
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_CLANG_PLUGIN_H_
@@ -0,0 +1,82 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/file_io.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::Contains;
+using ::testing::Optional;
+
+// The plugin (from the `clang_plugin` library linked into the test) is added
+// to every compile, like when the compiler loads it with `-fplugin`.
+bool CompileWithPlugin(absl::string_view header_contents,
+                       const std::vector<std::string>& plugin_args) {
+  std::vector<std::string> args = {"-std=c++17"};
+  for (const std::string& plugin_arg : plugin_args) {
+    args.insert(args.end(),
+                {"-Xclang", "-plugin-arg-crubit", "-Xclang", plugin_arg});
+  }
+  return clang::tooling::runToolOnCodeWithArgs(
+      std::make_unique<clang::SyntaxOnlyAction>(),
+      "#include \"test/foo.h\"\n", args, "test/foo.cc", "clang",
+      std::make_shared<clang::PCHContainerOperations>(),
+      {{"test/foo.h", std::string(header_contents)}});
+}
+
+std::vector<std::string> RecordNames(const llvm::json::Value& ir) {
+  std::vector<std::string> names;
+  for (const llvm::json::Value& item : *ir.getAsObject()->getArray("items")) {
+    if (const llvm::json::Object* record =
+            item.getAsObject()->getObject("Record")) {
+      names.push_back(record->getString("rs_name")->str());
+    }
+  }
+  return names;
+}
+
+TEST(ClangPluginTest, WritesIr) {
+  std::string ir_out = absl::StrCat(testing::TempDir(), "/writes_ir.json");
+  ASSERT_TRUE(CompileWithPlugin("struct Foo { int x; };",
+                                {absl::StrCat("ir_out=", ir_out),
+                                 "target=//test:foo",
+                                 "public_header=test/foo.h"}));
+
+  absl::StatusOr<std::string> json = GetFileContents(ir_out);
+  ASSERT_TRUE(json.ok()) << json.status();
+  llvm::Expected<llvm::json::Value> ir = llvm::json::parse(*json);
+  ASSERT_TRUE(static_cast<bool>(ir)) << llvm::toString(ir.takeError());
+  EXPECT_THAT(ir->getAsObject()->getString("current_target"),
+              Optional(llvm::StringRef("//test:foo")));
+  EXPECT_THAT(RecordNames(*ir), Contains("Foo"));
+}
+
+TEST(ClangPluginTest, MissingArgs) {
+  EXPECT_FALSE(CompileWithPlugin("struct Foo {};", {"target=//test:foo"}));
+}
+
+TEST(ClangPluginTest, UnknownArg) {
+  std::string ir_out = absl::StrCat(testing::TempDir(), "/unknown_arg.json");
+  EXPECT_FALSE(CompileWithPlugin(
+      "struct Foo {};", {absl::StrCat("ir_out=", ir_out), "target=//test:foo",
+                         "public_header=test/foo.h", "no_such_arg=1"}));
+}
+
+}  // namespace
+}  // namespace crubit
@@ -7,6 +7,8 @@
 #include <algorithm>
 #include <fstream>
 #include <iterator>
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -25,6 +27,7 @@
 #include "rs_bindings_from_cc/bazel_types.h"
 #include "rs_bindings_from_cc/cmdline_flags.h"
 #include "rs_bindings_from_cc/ir.h"
+#include "rs_bindings_from_cc/target_args_index.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/JSON.h"
 
@@ -35,9 +38,24 @@ ABSL_FLAG(std::string, rs_out, "",
           "output path for the Rust source file with bindings");
 ABSL_FLAG(std::string, cc_out, "",
           "output path for the C++ source file with bindings implementation");
+ABSL_FLAG(std::vector<std::string>, extra_cc_out, std::vector<std::string>(),
+          "(optional) output paths for additional shards of the C++ source "
+          "file with bindings implementation. If present, the implementation "
+          "is split evenly between `cc_out` and these files, so that they can "
+          "be compiled in parallel.");
 ABSL_FLAG(std::string, ir_out, "",
           "(optional) output path for the JSON IR. If not present, the JSON IR "
           "will not be dumped.");
+ABSL_FLAG(bool, ir_only, false,
+          "if set, the tool only parses the headers and writes --ir_out (and "
+          "--namespaces_out, --instantiations_out and --type_manifest_out), "
+          "without generating bindings. See --ir_in.");
+ABSL_FLAG(std::string, ir_in, "",
+          "(optional) path to a JSON IR written with --ir_only. If present, "
+          "the bindings are generated from it instead of from the headers, so "
+          "that a build system can skip generating them (and everything that "
+          "depends on them) when a change to the headers leaves the IR "
+          "unchanged.");
 ABSL_FLAG(std::string, crubit_support_path_format, "",
           "the format of `#include` for including Crubit C++ support library "
           "headers in the "
@@ -77,6 +95,11 @@ ABSL_FLAG(std::string, target_args, "",
           "  },\n"
           "...\n"
           "]");
+ABSL_FLAG(std::string, target_args_index, "",
+          "(optional) path to a target args index (see "
+          "rs_bindings_from_cc/target_args_index.h) with the headers and "
+          "features of the targets that aren't in --target_args, which can "
+          "then be omitted");
 ABSL_FLAG(std::vector<std::string>, extra_rs_srcs, std::vector<std::string>(),
           "Additional Rust source files to include into the crate.");
 ABSL_FLAG(std::vector<std::string>, srcs_to_scan_for_instantiations,
@@ -90,8 +113,87 @@ ABSL_FLAG(std::string, instantiations_out, "",
 ABSL_FLAG(std::string, namespaces_out, "",
           "(optional) output path for the JSON file containing the target's"
           "namespace hierarchy.");
+ABSL_FLAG(std::string, type_manifest_out, "",
+          "(optional) output path for the JSON type manifest of the target: "
+          "the records that it declares at namespace scope, and whether it "
+          "defines them. See --type_manifests.");
+ABSL_FLAG(std::vector<std::string>, type_manifests, std::vector<std::string>(),
+          "(optional) paths of the type manifests (see --type_manifest_out) of "
+          "the direct dependencies. A record that the headers only forward "
+          "declare, but that one of the manifests lists as defined, refers to "
+          "the complete Rust type of that dependency's bindings, so that the "
+          "headers don't need to include the definition.");
+ABSL_FLAG(std::string, lifetime_summaries, "",
+          "(optional) path of the lifetime summaries that lifetime analysis "
+          "inferred for the functions of the target and its dependencies. "
+          "Functions without lifetime annotations (or elided lifetimes) are "
+          "given the lifetimes of their summaries, so that their bindings use "
+          "references rather than raw pointers.");
 ABSL_FLAG(std::string, error_report_out, "",
           "(optional) output path for the JSON error report");
+ABSL_FLAG(std::string, bloat_report_out, "",
+          "(optional) output path for a JSON report of the code generated for "
+          "each item (tokens, thunks, static assertions and an estimate of "
+          "the symbols, see common/bloat_report.rs), for aggregating "
+          "many reports with //common:bloat_report_aggregator");
+ABSL_FLAG(std::string, time_trace_out, "",
+          "(optional) output path for a trace of where the time of the action "
+          "went (in both the C++ and the Rust parts of the tool, including "
+          "Clang), in the Chrome trace event format of -ftime-trace");
+ABSL_FLAG(bool, binary_error_report, false,
+          "write the --error_report_out report in the compact binary format "
+          "(see common/error_report.rs) rather than as JSON, for aggregating "
+          "many reports with //common:error_report_aggregator");
+ABSL_FLAG(bool, lazy_import, false,
+          "if set to true, only the declarations of the current target are "
+          "imported, together with the declarations of other targets that "
+          "they refer to, rather than all the declarations of the translation "
+          "unit");
+ABSL_FLAG(bool, string_view_as_slice_pointer, false,
+          "if set to true, `std::string_view` and `absl::string_view` are "
+          "passed to and from Rust as `*const [u8]`, without conversions, "
+          "which makes the functions that take or return them `unsafe`");
+ABSL_FLAG(int, template_instantiation_budget, -1,
+          "if non-negative, the class template specializations that are only "
+          "used by the types of other declarations (rather than named by a "
+          "type alias) only get bindings for their layout, their special "
+          "member functions and the methods that the C++ code uses, and at "
+          "most this many class templates and method definitions are "
+          "instantiated to generate the bindings of the target");
+ABSL_FLAG(bool, parse_all_comments, true,
+          "if set to false, only doc comments (`///` and `/** */`) are carried "
+          "over to the bindings, which saves time and memory on headers with "
+          "many other comments");
+ABSL_FLAG(bool, unsupported_item_comments, true,
+          "if set to false and there is no --error_report_out, the "
+          "declarations that get no bindings are only recorded by their ids "
+          "and error formats, and the bindings don't carry comments with "
+          "their errors, which saves time and memory on headers with many "
+          "such declarations");
+ABSL_FLAG(bool, skip_formatting, false,
+          "if set to true, the bindings are not run through rustfmt and "
+          "clang-format, but only broken into lines, which saves time when "
+          "nobody reads them");
+ABSL_FLAG(bool, inline_always_forwarding_only, false,
+          "if set to true, only the generated Rust functions that just "
+          "forward their arguments to a C++ thunk are #[inline(always)], and "
+          "the others are #[inline], which leaves it to the compiler whether "
+          "inlining them is worthwhile");
+ABSL_FLAG(bool, minimal_rs_api_impl_includes, false,
+          "if set to true, the generated C++ thunks only include the public "
+          "headers that declare the records and thunked functions of the "
+          "target, rather than all its public headers. Only use this if the "
+          "public headers are self-contained");
+ABSL_FLAG(bool, rust_enums, false,
+          "if set to true, C++ enums whose enumerators have contiguous values "
+          "also get a #[repr] Rust enum of the enumerators, with checked and "
+          "unchecked conversions from the enum newtype, so that Rust code "
+          "can match on them exhaustively");
+ABSL_FLAG(bool, compact_layout_assertions, false,
+          "if set to true, the sizes, alignments and field offsets of all "
+          "records are checked by one table comparison in each of the Rust "
+          "and C++ bindings, rather than by an assertion per value, which "
+          "compiles faster for targets with many records");
 ABSL_FLAG(bool, generate_source_location_in_doc_comment, true,
           "add the source code location from which the binding originates in"
           "the doc comment of the binding");
@@ -100,20 +202,6 @@ namespace crubit {
 
 namespace {
 
-struct TargetArgs {
-  std::string target;
-  std::vector<std::string> headers;
-  std::vector<std::string> features;
-};
-
-bool fromJSON(const llvm::json::Value& json, TargetArgs& out,
-              llvm::json::Path path) {
-  llvm::json::ObjectMapper mapper(json, path);
-  return mapper && mapper.map("t", out.target) &&
-         mapper.mapOptional("h", out.headers) &&
-         mapper.mapOptional("f", out.features);
-}
-
 std::vector<HeaderName> PublicHeaders() {
   std::vector<HeaderName> public_headers;
   const std::vector<std::string>& public_headers_string =
@@ -182,16 +270,43 @@ absl::StatusOr<Cmdline> Cmdline::FromFlags() {
   auto args = CmdlineArgs{
       .current_target = BazelLabel(absl::GetFlag(FLAGS_target)),
       .cc_out = absl::GetFlag(FLAGS_cc_out),
+      .extra_cc_out = absl::GetFlag(FLAGS_extra_cc_out),
       .rs_out = absl::GetFlag(FLAGS_rs_out),
       .ir_out = absl::GetFlag(FLAGS_ir_out),
+      .ir_in = absl::GetFlag(FLAGS_ir_in),
       .namespaces_out = absl::GetFlag(FLAGS_namespaces_out),
+      .type_manifest_out = absl::GetFlag(FLAGS_type_manifest_out),
+      .type_manifests = absl::GetFlag(FLAGS_type_manifests),
+      .lifetime_summaries = absl::GetFlag(FLAGS_lifetime_summaries),
       .crubit_support_path_format =
           absl::GetFlag(FLAGS_crubit_support_path_format),
       .clang_format_exe_path = absl::GetFlag(FLAGS_clang_format_exe_path),
       .rustfmt_exe_path = absl::GetFlag(FLAGS_rustfmt_exe_path),
       .rustfmt_config_path = absl::GetFlag(FLAGS_rustfmt_config_path),
       .error_report_out = absl::GetFlag(FLAGS_error_report_out),
+      .error_report_format = absl::GetFlag(FLAGS_binary_error_report)
+                                 ? ErrorReportFormat::kBinary
+                                 : ErrorReportFormat::kJson,
+      .bloat_report_out = absl::GetFlag(FLAGS_bloat_report_out),
+      .time_trace_out = absl::GetFlag(FLAGS_time_trace_out),
       .do_nothing = absl::GetFlag(FLAGS_do_nothing),
+      .ir_only = absl::GetFlag(FLAGS_ir_only),
+      .lazy_import = absl::GetFlag(FLAGS_lazy_import),
+      .string_view_as_slice_pointer =
+          absl::GetFlag(FLAGS_string_view_as_slice_pointer),
+      .template_instantiation_budget =
+          absl::GetFlag(FLAGS_template_instantiation_budget),
+      .parse_all_comments = absl::GetFlag(FLAGS_parse_all_comments),
+      .unsupported_item_comments =
+          absl::GetFlag(FLAGS_unsupported_item_comments),
+      .skip_formatting = absl::GetFlag(FLAGS_skip_formatting),
+      .compact_layout_assertions =
+          absl::GetFlag(FLAGS_compact_layout_assertions),
+      .inline_always_forwarding_only =
+          absl::GetFlag(FLAGS_inline_always_forwarding_only),
+      .minimal_rs_api_impl_includes =
+          absl::GetFlag(FLAGS_minimal_rs_api_impl_includes),
+      .rust_enums = absl::GetFlag(FLAGS_rust_enums),
       .generate_source_location_in_doc_comment =
           absl::GetFlag(FLAGS_generate_source_location_in_doc_comment)
               ? SourceLocationDocComment::Enabled
@@ -201,8 +316,26 @@ absl::StatusOr<Cmdline> Cmdline::FromFlags() {
       .srcs_to_scan_for_instantiations =
           absl::GetFlag(FLAGS_srcs_to_scan_for_instantiations),
       .instantiations_out = absl::GetFlag(FLAGS_instantiations_out)};
-  absl::Status parse_target_args_status =
-      internal::ParseTargetArgs(absl::GetFlag(FLAGS_target_args), args);
+  absl::Status parse_target_args_status = absl::OkStatus();
+  if (std::string index_path = absl::GetFlag(FLAGS_target_args_index);
+      !index_path.empty()) {
+    absl::StatusOr<TargetArgsIndex> index = TargetArgsIndex::Open(index_path);
+    if (index.ok()) {
+      args.target_args_index =
+          std::make_shared<const TargetArgsIndex>(*std::move(index));
+      args.target_args_index_path = index_path;
+    } else {
+      parse_target_args_status = index.status();
+    }
+  }
+  std::string target_args = absl::GetFlag(FLAGS_target_args);
+  // The headers aren't parsed with --ir_in, so they need no targets.
+  if (parse_target_args_status.ok() &&
+      !(target_args.empty() &&
+        (args.target_args_index != nullptr || !args.ir_in.empty()))) {
+    parse_target_args_status =
+        internal::ParseTargetArgs(std::move(target_args), args);
+  }
   absl::StatusOr<Cmdline> cmdline = Cmdline::Create(std::move(args));
   if (!parse_target_args_status.ok() || !cmdline.ok()) {
     return absl::InvalidArgumentError(
@@ -214,28 +347,50 @@ absl::StatusOr<Cmdline> Cmdline::FromFlags() {
 
 absl::StatusOr<Cmdline> Cmdline::Create(CmdlineArgs args) {
   std::string error;
-  if (args.current_target.empty()) {
+  // With --ir_only, the bindings are not generated, and with --ir_in, the
+  // headers are not parsed.
+  bool parses_headers = args.ir_in.empty();
+  bool generates_bindings = !args.ir_only;
+  if (args.ir_only && !args.ir_in.empty()) {
+    absl::StrAppend(&error, "please specify at most one of --ir_only and "
+                            "--ir_in\n");
+  }
+  if (args.ir_only && args.ir_out.empty()) {
+    absl::StrAppend(&error, "please specify --ir_out with --ir_only\n");
+  }
+  if (!parses_headers &&
+      (!args.namespaces_out.empty() || !args.instantiations_out.empty() ||
+       !args.type_manifest_out.empty() || !args.type_manifests.empty() ||
+       !args.lifetime_summaries.empty())) {
+    absl::StrAppend(&error,
+                    "--namespaces_out, --instantiations_out, "
+                    "--type_manifest_out, --type_manifests and "
+                    "--lifetime_summaries are used when parsing the headers, "
+                    "not with --ir_in\n");
+  }
+  if (parses_headers && args.current_target.empty()) {
     absl::StrAppend(&error, "please specify --target\n");
   }
-  if (args.rs_out.empty()) {
+  if (generates_bindings && args.rs_out.empty()) {
     absl::StrAppend(&error, "please specify --rs_out\n");
   }
-  if (args.cc_out.empty()) {
+  if (generates_bindings && args.cc_out.empty()) {
     absl::StrAppend(&error, "please specify --cc_out\n");
   }
-  if (args.public_headers.empty()) {
+  if (parses_headers && args.public_headers.empty()) {
     absl::StrAppend(&error, "please specify --public_headers\n");
   }
-  if (args.clang_format_exe_path.empty()) {
+  if (generates_bindings && args.clang_format_exe_path.empty()) {
     absl::StrAppend(&error, "please specify --clang_format_exe_path\n");
   }
-  if (args.rustfmt_exe_path.empty()) {
+  if (generates_bindings && args.rustfmt_exe_path.empty()) {
     absl::StrAppend(&error, "please specify --rustfmt_exe_path\n");
   }
 
-  if (args.crubit_support_path_format.empty()) {
+  if (generates_bindings && args.crubit_support_path_format.empty()) {
     absl::StrAppend(&error, "please specify --crubit_support_path_format\n");
-  } else if (!absl::StrContains(args.crubit_support_path_format, "{header}")) {
+  } else if (generates_bindings &&
+             !absl::StrContains(args.crubit_support_path_format, "{header}")) {
     absl::StrAppend(
         &error,
         "cannot find `{header}` placeholder in crubit_support_path_format\n");
@@ -248,8 +403,7 @@ absl::StatusOr<Cmdline> Cmdline::Create(CmdlineArgs args) {
         "requesting a template instantiation mode\n");
   }
   for (const HeaderName& header : args.public_headers) {
-    if (auto it = args.headers_to_targets.find(header);
-        it == args.headers_to_targets.end()) {
+    if (!FindHeaderTarget(args, header).has_value()) {
       absl::StrAppend(
           &error,
           absl::Substitute(
@@ -265,6 +419,21 @@ absl::StatusOr<Cmdline> Cmdline::Create(CmdlineArgs args) {
   return Cmdline(std::move(args));
 }
 
+std::optional<BazelLabel> FindHeaderTarget(const CmdlineArgs& args,
+                                           const HeaderName& header) {
+  if (auto it = args.headers_to_targets.find(header);
+      it != args.headers_to_targets.end()) {
+    return it->second;
+  }
+  if (args.target_args_index != nullptr) {
+    if (std::optional<absl::string_view> target =
+            args.target_args_index->FindHeaderTarget(header.IncludePath())) {
+      return BazelLabel(std::string(*target));
+    }
+  }
+  return std::nullopt;
+}
+
 void ExpandParamfiles(int& argc, char**& argv) {
   std::vector<char*> new_argv;  // Will be leaked if we find a paramfile.
   char** begin = argv;
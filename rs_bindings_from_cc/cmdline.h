@@ -5,6 +5,8 @@
 #ifndef CRUBIT_RS_BINDINGS_FROM_CC_CMDLINE_H_
 #define CRUBIT_RS_BINDINGS_FROM_CC_CMDLINE_H_
 
+#include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -17,6 +19,7 @@
 #include "common/ffi_types.h"
 #include "rs_bindings_from_cc/bazel_types.h"
 #include "rs_bindings_from_cc/ir.h"
+#include "rs_bindings_from_cc/target_args_index.h"
 
 namespace crubit {
 
@@ -24,20 +27,49 @@ namespace crubit {
 struct CmdlineArgs {
   BazelLabel current_target;
   std::string cc_out;
+  std::vector<std::string> extra_cc_out;
   std::string rs_out;
   std::string ir_out;
+  // The JSON IR to generate the bindings from, instead of parsing the headers.
+  std::string ir_in;
   std::string namespaces_out;
+  // The type manifest of the target to write (see `TypeManifestToJson`), and
+  // those of its direct dependencies to read.
+  std::string type_manifest_out;
+  std::vector<std::string> type_manifests;
+  // The summaries written by lifetime analysis (see `LifetimeSummaryStore`),
+  // to take the lifetimes of unannotated functions from.
+  std::string lifetime_summaries;
   std::string crubit_support_path_format;
   std::string clang_format_exe_path;
   std::string rustfmt_exe_path;
   std::string rustfmt_config_path;
   std::string error_report_out;
+  ErrorReportFormat error_report_format = ErrorReportFormat::kJson;
+  std::string bloat_report_out;
+  std::string time_trace_out;
   bool do_nothing = true;
+  // Whether to only write the IR (see `ir_in`), without generating bindings.
+  bool ir_only = false;
+  bool lazy_import = false;
+  bool string_view_as_slice_pointer = false;
+  int template_instantiation_budget = -1;
+  bool parse_all_comments = true;
+  bool unsupported_item_comments = true;
+  bool skip_formatting = false;
+  bool compact_layout_assertions = false;
+  bool inline_always_forwarding_only = false;
+  bool minimal_rs_api_impl_includes = false;
+  bool rust_enums = false;
   SourceLocationDocComment generate_source_location_in_doc_comment =
       SourceLocationDocComment::Enabled;
 
   std::vector<HeaderName> public_headers;
   absl::flat_hash_map<HeaderName, BazelLabel> headers_to_targets;
+  // The index from `--target_args_index`, if any, for the targets that are
+  // not in `headers_to_targets` and `target_to_features`.
+  std::shared_ptr<const TargetArgsIndex> target_args_index;
+  std::string target_args_index_path;
 
   std::vector<std::string> extra_rs_srcs;
 
@@ -68,6 +100,11 @@ class Cmdline {
   CmdlineArgs args_;
 };
 
+// Returns the target of `header`, from `--target_args` or else from
+// `--target_args_index`.
+std::optional<BazelLabel> FindHeaderTarget(const CmdlineArgs& args,
+                                           const HeaderName& header);
+
 namespace internal {
 // Parses --target_args into CmdlineArgs. Only exposed so it can be unit tested.
 absl::Status ParseTargetArgs(absl::string_view target_args_str,
@@ -10,9 +10,22 @@
 #include "absl/flags/declare.h"
 
 ABSL_DECLARE_FLAG(bool, do_nothing);
+ABSL_DECLARE_FLAG(bool, lazy_import);
+ABSL_DECLARE_FLAG(bool, string_view_as_slice_pointer);
+ABSL_DECLARE_FLAG(int, template_instantiation_budget);
+ABSL_DECLARE_FLAG(bool, parse_all_comments);
+ABSL_DECLARE_FLAG(bool, unsupported_item_comments);
+ABSL_DECLARE_FLAG(bool, skip_formatting);
+ABSL_DECLARE_FLAG(bool, compact_layout_assertions);
+ABSL_DECLARE_FLAG(bool, inline_always_forwarding_only);
+ABSL_DECLARE_FLAG(bool, minimal_rs_api_impl_includes);
+ABSL_DECLARE_FLAG(bool, rust_enums);
 ABSL_DECLARE_FLAG(std::string, rs_out);
 ABSL_DECLARE_FLAG(std::string, cc_out);
+ABSL_DECLARE_FLAG(std::vector<std::string>, extra_cc_out);
 ABSL_DECLARE_FLAG(std::string, ir_out);
+ABSL_DECLARE_FLAG(bool, ir_only);
+ABSL_DECLARE_FLAG(std::string, ir_in);
 ABSL_DECLARE_FLAG(std::string, crubit_support_path_format);
 ABSL_DECLARE_FLAG(std::string, clang_format_exe_path);
 ABSL_DECLARE_FLAG(std::string, rustfmt_exe_path);
@@ -20,11 +33,18 @@ ABSL_DECLARE_FLAG(std::string, rustfmt_config_path);
 ABSL_DECLARE_FLAG(std::vector<std::string>, public_headers);
 ABSL_DECLARE_FLAG(std::string, target);
 ABSL_DECLARE_FLAG(std::string, target_args);
+ABSL_DECLARE_FLAG(std::string, target_args_index);
 ABSL_DECLARE_FLAG(std::vector<std::string>, extra_rs_srcs);
 ABSL_DECLARE_FLAG(std::vector<std::string>, srcs_to_scan_for_instantiations);
 ABSL_DECLARE_FLAG(std::string, instantiations_out);
 ABSL_DECLARE_FLAG(std::string, namespaces_out);
+ABSL_DECLARE_FLAG(std::string, type_manifest_out);
+ABSL_DECLARE_FLAG(std::vector<std::string>, type_manifests);
+ABSL_DECLARE_FLAG(std::string, lifetime_summaries);
 ABSL_DECLARE_FLAG(std::string, error_report_out);
+ABSL_DECLARE_FLAG(bool, binary_error_report);
+ABSL_DECLARE_FLAG(std::string, bloat_report_out);
+ABSL_DECLARE_FLAG(std::string, time_trace_out);
 ABSL_DECLARE_FLAG(bool, generate_source_location_in_doc_comment);
 
 #endif  // THIRD_PARTY_CRUBIT_RS_BINDINGS_FROM_CC_CMDLINE_FLAGS_H_
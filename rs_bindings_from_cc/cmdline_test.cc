@@ -6,6 +6,8 @@
 
 #include <fstream>
 #include <initializer_list>
+#include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -23,6 +25,8 @@
 #include "rs_bindings_from_cc/bazel_types.h"
 #include "rs_bindings_from_cc/cmdline_flags.h"
 #include "rs_bindings_from_cc/ir.h"
+#include "rs_bindings_from_cc/target_args_index.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 namespace crubit {
 namespace {
@@ -73,8 +77,19 @@ TEST(CmdlineTest, TestCmdlineArgs) { ASSERT_OK(TestCmdlineArgs().status()); }
 
 TEST(CmdlineTest, BasicCorrectInput) {
   absl::SetFlag(&FLAGS_do_nothing, false);
+  absl::SetFlag(&FLAGS_lazy_import, true);
+  absl::SetFlag(&FLAGS_string_view_as_slice_pointer, true);
+  absl::SetFlag(&FLAGS_template_instantiation_budget, 100);
+  absl::SetFlag(&FLAGS_parse_all_comments, false);
+  absl::SetFlag(&FLAGS_unsupported_item_comments, false);
+  absl::SetFlag(&FLAGS_skip_formatting, true);
+  absl::SetFlag(&FLAGS_compact_layout_assertions, true);
+  absl::SetFlag(&FLAGS_inline_always_forwarding_only, true);
+  absl::SetFlag(&FLAGS_minimal_rs_api_impl_includes, true);
+  absl::SetFlag(&FLAGS_rust_enums, true);
   absl::SetFlag(&FLAGS_rs_out, "rs_out");
   absl::SetFlag(&FLAGS_cc_out, "cc_out");
+  absl::SetFlag(&FLAGS_extra_cc_out, {"cc_out_1", "cc_out_2"});
   absl::SetFlag(&FLAGS_ir_out, "ir_out");
   absl::SetFlag(&FLAGS_crubit_support_path_format,
                 "<crubit/support/path/{header}>");
@@ -89,22 +104,45 @@ TEST(CmdlineTest, BasicCorrectInput) {
                 {"scan_for_instantiations.rs"});
   absl::SetFlag(&FLAGS_instantiations_out, "instantiations_out");
   absl::SetFlag(&FLAGS_namespaces_out, "namespaces_out");
+  absl::SetFlag(&FLAGS_type_manifest_out, "type_manifest_out");
+  absl::SetFlag(&FLAGS_type_manifests, {"dep_1.json", "dep_2.json"});
+  absl::SetFlag(&FLAGS_lifetime_summaries, "lifetime_summaries");
   absl::SetFlag(&FLAGS_error_report_out, "error_report_out");
+  absl::SetFlag(&FLAGS_binary_error_report, true);
+  absl::SetFlag(&FLAGS_bloat_report_out, "bloat_report_out");
+  absl::SetFlag(&FLAGS_time_trace_out, "time_trace_out");
   absl::SetFlag(&FLAGS_generate_source_location_in_doc_comment,
                 SourceLocationDocComment::Disabled);
   ASSERT_OK_AND_ASSIGN(Cmdline cmdline, Cmdline::FromFlags());
   const CmdlineArgs& args = cmdline.args();
   EXPECT_EQ(args.cc_out, "cc_out");
+  EXPECT_THAT(args.extra_cc_out, ElementsAre("cc_out_1", "cc_out_2"));
   EXPECT_EQ(args.rs_out, "rs_out");
   EXPECT_EQ(args.ir_out, "ir_out");
   EXPECT_EQ(args.namespaces_out, "namespaces_out");
+  EXPECT_EQ(args.type_manifest_out, "type_manifest_out");
+  EXPECT_THAT(args.type_manifests, ElementsAre("dep_1.json", "dep_2.json"));
+  EXPECT_EQ(args.lifetime_summaries, "lifetime_summaries");
   EXPECT_EQ(args.crubit_support_path_format, "<crubit/support/path/{header}>");
   EXPECT_EQ(args.clang_format_exe_path, "clang_format_exe_path");
   EXPECT_EQ(args.rustfmt_exe_path, "rustfmt_exe_path");
   EXPECT_EQ(args.rustfmt_config_path, "rustfmt_config_path");
   EXPECT_EQ(args.instantiations_out, "instantiations_out");
   EXPECT_EQ(args.error_report_out, "error_report_out");
+  EXPECT_EQ(args.error_report_format, ErrorReportFormat::kBinary);
+  EXPECT_EQ(args.bloat_report_out, "bloat_report_out");
+  EXPECT_EQ(args.time_trace_out, "time_trace_out");
   EXPECT_EQ(args.do_nothing, false);
+  EXPECT_EQ(args.lazy_import, true);
+  EXPECT_EQ(args.string_view_as_slice_pointer, true);
+  EXPECT_EQ(args.template_instantiation_budget, 100);
+  EXPECT_EQ(args.parse_all_comments, false);
+  EXPECT_EQ(args.unsupported_item_comments, false);
+  EXPECT_EQ(args.skip_formatting, true);
+  EXPECT_EQ(args.compact_layout_assertions, true);
+  EXPECT_EQ(args.inline_always_forwarding_only, true);
+  EXPECT_EQ(args.minimal_rs_api_impl_includes, true);
+  EXPECT_EQ(args.rust_enums, true);
   EXPECT_EQ(args.current_target.value(), "//:t1");
   EXPECT_THAT(args.public_headers, ElementsAre(HeaderName("h1")));
   EXPECT_THAT(args.extra_rs_srcs, ElementsAre("extra_file.rs"));
@@ -264,6 +302,31 @@ TEST(CmdlineTest, PublicHeadersCoveringMultipleTargets) {
                            Pair(HeaderName("d.h"), BazelLabel("//:target2"))));
 }
 
+TEST(CmdlineTest, PublicHeadersInTargetArgsIndex) {
+  std::string index_bytes = TargetArgsIndex::Serialize({
+      {.target = "//:target1", .headers = {"a.h"}},
+      {.target = "//:target2", .headers = {"b.h"}},
+  });
+  ASSERT_OK_AND_ASSIGN(
+      TargetArgsIndex index,
+      TargetArgsIndex::FromBuffer(llvm::MemoryBuffer::getMemBufferCopy(
+          index_bytes)));
+  CmdlineArgs args = {
+      .current_target = BazelLabel("//:target1"),
+      .public_headers = {HeaderName("a.h")},
+      .headers_to_targets = {{HeaderName("c.h"), BazelLabel("//:target3")}},
+      .target_args_index =
+          std::make_shared<const TargetArgsIndex>(std::move(index))};
+
+  EXPECT_EQ(FindHeaderTarget(args, HeaderName("a.h")),
+            BazelLabel("//:target1"));
+  EXPECT_EQ(FindHeaderTarget(args, HeaderName("b.h")),
+            BazelLabel("//:target2"));
+  EXPECT_EQ(FindHeaderTarget(args, HeaderName("c.h")),
+            BazelLabel("//:target3"));
+  EXPECT_EQ(FindHeaderTarget(args, HeaderName("d.h")), std::nullopt);
+}
+
 TEST(CmdlineTest, TargetArgsIntInsteadOfFeaturesArray) {
   ASSERT_THAT(TestCmdlineArgs({"h1"}, R"([{"t": "t1", "f": 123}])"),
               StatusIs(absl::StatusCode::kInvalidArgument,
@@ -368,6 +431,63 @@ TEST(CmdlineTest, SupportPathNoPlaceholder) {
                                  "crubit_support_path_format")));
 }
 
+TEST(CmdlineTest, IrOnlyNeedsNoBindingsOutputs) {
+  ASSERT_OK_AND_ASSIGN(CmdlineArgs args, TestCmdlineArgs());
+  args.ir_only = true;
+  args.rs_out = "";
+  args.cc_out = "";
+  args.clang_format_exe_path = "";
+  args.rustfmt_exe_path = "";
+  args.crubit_support_path_format = "";
+  EXPECT_OK(Cmdline::Create(std::move(args)));
+}
+
+TEST(CmdlineTest, IrOnlyIrOutEmpty) {
+  ASSERT_OK_AND_ASSIGN(CmdlineArgs args, TestCmdlineArgs());
+  args.ir_only = true;
+  args.ir_out = "";
+  EXPECT_THAT(Cmdline::Create(std::move(args)),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("please specify --ir_out with --ir_only")));
+}
+
+TEST(CmdlineTest, IrInNeedsNoHeaders) {
+  ASSERT_OK_AND_ASSIGN(CmdlineArgs args, TestCmdlineArgs());
+  args.ir_in = "ir_in";
+  args.current_target = BazelLabel("");
+  args.public_headers.clear();
+  args.headers_to_targets.clear();
+  args.namespaces_out = "";
+  EXPECT_OK(Cmdline::Create(std::move(args)));
+}
+
+TEST(CmdlineTest, IrInWithNamespacesOut) {
+  ASSERT_OK_AND_ASSIGN(CmdlineArgs args, TestCmdlineArgs());
+  args.ir_in = "ir_in";
+  EXPECT_THAT(Cmdline::Create(std::move(args)),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("not with --ir_in")));
+}
+
+TEST(CmdlineTest, IrInWithTypeManifests) {
+  ASSERT_OK_AND_ASSIGN(CmdlineArgs args, TestCmdlineArgs());
+  args.ir_in = "ir_in";
+  args.namespaces_out = "";
+  args.type_manifests = {"dep.json"};
+  EXPECT_THAT(Cmdline::Create(std::move(args)),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("not with --ir_in")));
+}
+
+TEST(CmdlineTest, IrOnlyAndIrIn) {
+  ASSERT_OK_AND_ASSIGN(CmdlineArgs args, TestCmdlineArgs());
+  args.ir_only = true;
+  args.ir_in = "ir_in";
+  EXPECT_THAT(Cmdline::Create(std::move(args)),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("at most one of --ir_only and --ir_in")));
+}
+
 // A mutable test argv, which doesn't leak memory.
 class Args {
  public:
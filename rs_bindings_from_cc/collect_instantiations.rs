@@ -10,7 +10,7 @@ use proc_macro2::TokenTree;
 use std::collections::HashSet;
 use std::fs;
 use std::panic::catch_unwind;
-use std::path::PathBuf;
+use std::path::{Path, PathBuf};
 use std::process;
 
 /// Parses given files and returns a Json list with all  C++ class
@@ -46,19 +46,53 @@ pub unsafe extern "C" fn CollectInstantiationsImpl(json: FfiU8Slice) -> FfiU8Sli
 }
 
 fn collect_instantiations_impl(filenames: Vec<PathBuf>) -> Result<Vec<String>> {
+    let num_threads = std::thread::available_parallelism().map_or(1, |n| n.get());
+    let chunk_size = std::cmp::max(1, filenames.len().div_ceil(num_threads));
+    // `TokenStream` is not `Send`, so each thread parses its own files and only
+    // hands back the instantiation names. Chunks are joined in order, so that the
+    // reported error (if any) is the one for the first failing file.
+    let chunk_results: Vec<Result<HashSet<String>>> = std::thread::scope(|scope| {
+        let handles: Vec<_> = filenames
+            .chunks(chunk_size)
+            .map(|chunk| {
+                scope.spawn(move || {
+                    let mut result = HashSet::<String>::new();
+                    for filename in chunk {
+                        collect_instantiations_from_file(filename, &mut result)?;
+                    }
+                    Ok(result)
+                })
+            })
+            .collect();
+        handles
+            .into_iter()
+            .map(|handle| handle.join().expect("instantiation scanning thread panicked"))
+            .collect()
+    });
     let mut result = HashSet::<String>::new();
-    for filename in filenames {
-        let content = fs::read_to_string(&filename)
-            .with_context(|| format!("Couldn't read '{}'", filename.display()))?;
-        let token_stream = syn::parse_str(&content)
-            .with_context(|| format!("Couldn't parse the file '{}'", filename.display()))?;
-        find_cc_template_calls(token_stream, &mut result);
+    for chunk_result in chunk_results {
+        result.extend(chunk_result?);
     }
     let mut result_vec = result.into_iter().collect::<Vec<_>>();
     result_vec.sort();
     Ok(result_vec)
 }
 
+fn collect_instantiations_from_file(filename: &Path, results: &mut HashSet<String>) -> Result<()> {
+    let content = fs::read_to_string(filename)
+        .with_context(|| format!("Couldn't read '{}'", filename.display()))?;
+    // Most files don't use `cc_template!` at all. A substring search is much
+    // cheaper than tokenizing them, and can't miss an invocation, since the macro
+    // name has to appear verbatim in the source.
+    if !content.contains("cc_template") {
+        return Ok(());
+    }
+    let token_stream = syn::parse_str(&content)
+        .with_context(|| format!("Couldn't parse the file '{}'", filename.display()))?;
+    find_cc_template_calls(token_stream, results);
+    Ok(())
+}
+
 fn find_cc_template_calls(input: TokenStream, results: &mut HashSet<String>) {
     let mut iter = input.into_iter();
     while let Some(next) = iter.next() {
@@ -124,7 +158,7 @@ mod tests {
 
     #[test]
     fn test_file_doesnt_parse() {
-        let input = make_tmp_input_file("does_not_parse", "This is not (Rust>!");
+        let input = make_tmp_input_file("does_not_parse", "This is not (Rust>! cc_template");
         let err = collect_instantiations_impl(vec![input.clone()]).unwrap_err();
         assert_eq!(
             format!("{:#}", err),
@@ -132,6 +166,30 @@ mod tests {
         );
     }
 
+    #[test]
+    fn test_files_without_cc_template_are_not_parsed() {
+        // This file doesn't parse, but that doesn't matter since it can't contain
+        // any `cc_template!` invocations.
+        let input = make_tmp_input_file("no_cc_template", "This is not (Rust>!");
+        assert!(collect_instantiations_impl(vec![input]).unwrap().is_empty());
+    }
+
+    #[test]
+    fn test_instantiations_from_multiple_files() {
+        let files = (0..10)
+            .map(|i| {
+                make_tmp_input_file(
+                    &format!("file_{i}"),
+                    &quote! { cc_template!(MyTemplate<#i>) }.to_string(),
+                )
+            })
+            .collect::<Vec<_>>();
+        let result = collect_instantiations_impl(files).unwrap();
+        let mut expected = (0..10).map(|i| format!("MyTemplate<{i}i32>")).collect::<Vec<_>>();
+        expected.sort();
+        assert_eq!(result, expected);
+    }
+
     #[test]
     fn test_single_template_parens() {
         let result =
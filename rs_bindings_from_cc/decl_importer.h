@@ -12,14 +12,20 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/log/check.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "lifetime_analysis/lifetime_summaries.h"
 #include "lifetime_annotations/lifetime_annotations.h"
 #include "lifetime_annotations/type_lifetimes.h"
 #include "rs_bindings_from_cc/bazel_types.h"
 #include "rs_bindings_from_cc/ir.h"
+#include "rs_bindings_from_cc/target_args_index.h"
+#include "rs_bindings_from_cc/type_manifest.h"
 #include "clang/AST/DeclBase.h"
+#include "clang/AST/DeclTemplate.h"
 #include "clang/AST/RawCommentList.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/SourceLocation.h"
@@ -31,26 +37,82 @@ namespace crubit {
 class Invocation {
  public:
   Invocation(BazelLabel target, absl::Span<const HeaderName> public_headers,
-             const absl::flat_hash_map<HeaderName, BazelLabel>& header_targets)
+             const absl::flat_hash_map<HeaderName, BazelLabel>& header_targets,
+             bool lazy_import = false,
+             const TargetArgsIndex* target_args_index = nullptr,
+             int template_instantiation_budget = -1,
+             const DependencyTypes* dependency_types = nullptr,
+             const clang::tidy::lifetimes::LifetimeSummaryStore*
+                 lifetime_summaries = nullptr,
+             bool lean_unsupported_items = false,
+             bool string_view_as_slice_pointer = false)
       : target_(target),
         public_headers_(public_headers),
+        lazy_import_(lazy_import),
+        template_instantiation_budget_(template_instantiation_budget),
+        dependency_types_(dependency_types),
+        lifetime_summaries_(lifetime_summaries),
+        lean_unsupported_items_(lean_unsupported_items),
+        string_view_as_slice_pointer_(string_view_as_slice_pointer),
         lifetime_context_(std::make_shared<
                           clang::tidy::lifetimes::LifetimeAnnotationContext>()),
-        header_targets_(header_targets) {
+        header_targets_(header_targets),
+        target_args_index_(target_args_index) {
     // Caller should verify that the inputs are non-empty.
     CHECK(!public_headers_.empty());
-    CHECK(!header_targets_.empty());
+    CHECK(!header_targets_.empty() || target_args_index_ != nullptr);
 
     ir_.public_headers.insert(ir_.public_headers.end(), public_headers_.begin(),
                               public_headers.end());
     ir_.current_target = target_;
+    public_header_set_.insert(public_headers_.begin(), public_headers_.end());
+  }
+
+  // Returns whether `header` is one of the `public_headers_`.
+  bool is_public_header(const HeaderName& header) const {
+    return public_header_set_.contains(header);
   }
 
   // Returns the target of a header, if any.
   std::optional<BazelLabel> header_target(const HeaderName header) const {
     auto it = header_targets_.find(header);
-    return (it != header_targets_.end()) ? std::optional(it->second)
-                                         : std::nullopt;
+    if (it != header_targets_.end()) return it->second;
+    if (target_args_index_ == nullptr) return std::nullopt;
+
+    // The index is only read once for each header.
+    auto [indexed, inserted] = indexed_header_targets_.try_emplace(header);
+    if (inserted) {
+      if (std::optional<absl::string_view> target =
+              target_args_index_->FindHeaderTarget(header.IncludePath())) {
+        indexed->second = BazelLabel(std::string(*target));
+      }
+    }
+    return indexed->second;
+  }
+
+  // Returns the targets whose headers were found in the target args index
+  // (rather than in `header_targets`).
+  std::set<BazelLabel> indexed_targets() const {
+    std::set<BazelLabel> targets;
+    for (const auto& [header, target] : indexed_header_targets_) {
+      if (target.has_value()) targets.insert(*target);
+    }
+    return targets;
+  }
+
+  // Adds the Crubit features of `target_` and of the `indexed_targets()` to
+  // `ir_.crubit_features` from the target args index (if any), unless they
+  // are already there.
+  void AddIndexedCrubitFeatures() {
+    if (target_args_index_ == nullptr) return;
+    std::set<BazelLabel> targets = indexed_targets();
+    targets.insert(target_);
+    for (const BazelLabel& target : targets) {
+      if (ir_.crubit_features.contains(target)) continue;
+      std::vector<absl::string_view> features =
+          target_args_index_->FindTargetFeatures(target.value());
+      ir_.crubit_features[target].insert(features.begin(), features.end());
+    }
   }
 
   // The main target from which we are importing.
@@ -60,14 +122,64 @@ class Invocation {
   // `IR::public_headers` and `HeaderName` for more details.
   const absl::Span<const HeaderName> public_headers_;
 
+  // Whether only the decls of `target_` are imported eagerly. The decls of
+  // other targets are then only imported when they are referred to, e.g. by
+  // the type of a function parameter.
+  const bool lazy_import_;
+
+  // If non-negative, the class template specializations that are only reached
+  // through the types of other decls (rather than named by a type alias)
+  // import their layout, their special member functions and the methods that
+  // the C++ code uses, instead of all their members. At most this many class
+  // templates and method definitions are then instantiated by the importer
+  // (the instantiations that the C++ code needs on its own are free). If
+  // negative, all the members are imported, without a limit.
+  const int template_instantiation_budget_;
+
+  // If not null, the records that the direct dependencies define, by their
+  // type manifests. A record that the headers only forward declare, and that
+  // is in this map, is owned by its defining dependency (see
+  // `IncompleteRecord::is_complete_in_dependency`), so that the bindings can
+  // refer to the dependency's complete Rust type.
+  const DependencyTypes* dependency_types_;
+
+  // If not null, the lifetimes that lifetime analysis inferred for functions
+  // defined elsewhere (see `AnalyzeTranslationUnit()`). A function without
+  // lifetime annotations, or lifetimes from elision, is imported with the
+  // lifetimes of its summary, as if it had been annotated with them, so that
+  // its bindings take and return references rather than raw pointers.
+  const clang::tidy::lifetimes::LifetimeSummaryStore* lifetime_summaries_;
+
+  // Whether the `UnsupportedItem`s only record the ids of the decls and the
+  // formats of the errors, without names, source locations and messages. Set
+  // when nothing reads them: there is no error report, and the bindings don't
+  // carry the errors as comments.
+  const bool lean_unsupported_items_;
+
+  // Whether `std::string_view` and `absl::string_view` are mapped to Rust
+  // `*const [u8]` (see `GetTypeMapOverride()`), rather than to the bindings of
+  // their record. Functions that take or return them are then `unsafe`.
+  const bool string_view_as_slice_pointer_;
+
   const std::shared_ptr<clang::tidy::lifetimes::LifetimeAnnotationContext>
       lifetime_context_;
 
   // The main output of the import process
   IR ir_;
 
+  // The ids of the items in `ir_`.
+  ItemIdAllocator item_ids_;
+
+  // The files that `ir_` was generated from (the headers, including the system
+  // headers), as absolute paths.
+  std::vector<std::string> input_files_;
+
  private:
   const absl::flat_hash_map<HeaderName, BazelLabel>& header_targets_;
+  absl::flat_hash_set<HeaderName> public_header_set_;
+  const TargetArgsIndex* target_args_index_;
+  mutable absl::flat_hash_map<HeaderName, std::optional<BazelLabel>>
+      indexed_header_targets_;
 };
 
 // Explicitly defined interface that defines how `DeclImporter`s are allowed to
@@ -108,8 +220,9 @@ class ImportContext {
   // Updates the cache.
   virtual std::optional<IR::Item> GetDeclItem(clang::Decl* decl) = 0;
 
-  virtual std::optional<IR::Item> GetImportedItem(
-      const clang::Decl* decl) const = 0;
+  // Returns the Item of a Decl if it has already been imported successfully, or
+  // nullptr. Unlike GetDeclItem(), this doesn't copy the item.
+  virtual const IR::Item* GetImportedItem(const clang::Decl* decl) const = 0;
 
   virtual ItemId GenerateItemId(const clang::Decl* decl) const = 0;
   virtual ItemId GenerateItemId(const clang::RawComment* comment) const = 0;
@@ -140,6 +253,12 @@ class ImportContext {
   // other redeclarations of the decl.
   virtual bool IsFromCurrentTarget(const clang::Decl* decl) const = 0;
 
+  // Returns the innermost public header that (transitively) includes the
+  // decl, or nullopt if there is none, or if the decl is a template
+  // instantiation (which may be triggered from any header).
+  virtual std::optional<HeaderName> GetPublicHeader(
+      const clang::Decl* decl) const = 0;
+
   // Gets an IR UnqualifiedIdentifier for the named decl.
   //
   // If the decl's name is an identifier, this returns that identifier as-is.
@@ -198,6 +317,15 @@ class ImportContext {
   // MarkAsSuccessfullyImported.
   virtual bool EnsureSuccessfullyImported(clang::NamedDecl* decl) = 0;
 
+  // Returns whether only the referenced members of `decl` are imported, see
+  // `Invocation::template_instantiation_budget_`.
+  virtual bool ImportsReferencedMembersOnly(
+      const clang::ClassTemplateSpecializationDecl* decl) const = 0;
+
+  // Takes one instantiation from `Invocation::template_instantiation_budget_`.
+  // Returns false, without taking any, if the budget is exhausted.
+  virtual bool TakeTemplateInstantiation() = 0;
+
   Invocation& invocation_;
   clang::ASTContext& ctx_;
   clang::Sema& sema_;
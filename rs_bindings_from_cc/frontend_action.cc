@@ -5,20 +5,51 @@
 #include "rs_bindings_from_cc/frontend_action.h"
 
 #include <memory>
+#include <string>
 
 #include "lifetime_annotations/lifetime_annotations.h"
 #include "rs_bindings_from_cc/ast_consumer.h"
 #include "clang/AST/ASTConsumer.h"
+#include "clang/Basic/FileManager.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/Utils.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
 
 namespace crubit {
+namespace {
+
+// Unlike the base class, also collects the system headers: the bindings
+// depend on them as much as on the other headers.
+class AllDependenciesCollector : public clang::DependencyCollector {
+ public:
+  bool needSystemDependencies() override { return true; }
+};
+
+}  // namespace
 
 std::unique_ptr<clang::ASTConsumer> FrontendAction::CreateASTConsumer(
     clang::CompilerInstance& instance, llvm::StringRef) {
   AddLifetimeAnnotationHandlers(instance.getPreprocessor(),
                                 invocation_.lifetime_context_);
+  dependencies_ = std::make_shared<AllDependenciesCollector>();
+  dependencies_->attachToPreprocessor(instance.getPreprocessor());
   return std::make_unique<AstConsumer>(instance, invocation_);
 }
 
+void FrontendAction::EndSourceFileAction() {
+  // The paths are relative to the working directory of the compilation (which
+  // is not necessarily the working directory of the process).
+  clang::FileManager& file_manager = getCompilerInstance().getFileManager();
+  for (const std::string& dependency : dependencies_->getDependencies()) {
+    llvm::SmallString<256> path(dependency);
+    file_manager.makeAbsolutePath(path);
+    // The files that are only in the virtual file system, like the input that
+    // includes the public headers, are made from the command line.
+    if (!llvm::sys::fs::exists(path)) continue;
+    invocation_.input_files_.push_back(std::string(path));
+  }
+}
+
 }  // namespace crubit
@@ -11,12 +11,14 @@
 #include "clang/AST/ASTConsumer.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/Utils.h"
 #include "llvm/ADT/StringRef.h"
 
 namespace crubit {
 
 // Creates an `ASTConsumer` that generates the intermediate representation
-// (`IR`) into the invocation object.
+// (`IR`) into the invocation object, and records the files that it is
+// generated from in `Invocation::input_files_`.
 class FrontendAction : public clang::ASTFrontendAction {
  public:
   explicit FrontendAction(Invocation& invocation) : invocation_(invocation) {}
@@ -24,8 +26,11 @@ class FrontendAction : public clang::ASTFrontendAction {
   std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
       clang::CompilerInstance& instance, llvm::StringRef) override;
 
+  void EndSourceFileAction() override;
+
  private:
   Invocation& invocation_;
+  std::shared_ptr<clang::DependencyCollector> dependencies_;
 };
 
 }  // namespace crubit
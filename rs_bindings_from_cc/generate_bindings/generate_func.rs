@@ -62,9 +62,13 @@ fn can_skip_cc_thunk(db: &dyn BindingsGenerator, func: &Func) -> bool {
     // In terms of runtime performance, since this only occurs for virtual function
     // calls, which are already slow, it may not be such a big deal. We can
     // benchmark it later. :)
+    //
+    // The exception is a `final` method (or a method of a `final` class): it has
+    // no overriders, so the dynamic dispatch always ends up in this very
+    // definition, and we can call it directly by its mangled name.
     if let Some(meta) = &func.member_func_metadata {
         if let Some(inst_meta) = &meta.instance_method_metadata {
-            if inst_meta.is_virtual {
+            if inst_meta.is_virtual && !inst_meta.is_final {
                 return false;
             }
         }
@@ -85,6 +89,8 @@ fn can_skip_cc_thunk(db: &dyn BindingsGenerator, func: &Func) -> bool {
     // Returning a struct by value requires an explicit thunk, because
     // `rs_bindings_from_cc` may not preserve the ABI of structs (e.g. when
     // replacing field types with an opaque blob of bytes - see b/270454629).
+    // Structs whose fields are all replicated with their original types are
+    // `is_c_abi_compatible_by_value` and can be returned directly.
     //
     // Note: if the RsTypeKind cannot be parsed / rs_type_kind returns Err, then
     // bindings generation will fail for this function, so it doesn't really matter
@@ -1007,6 +1013,36 @@ fn materialize_ctor_in_caller(func: &Func, params: &mut [RsTypeKind]) {
 pub fn generate_func(
     db: &dyn BindingsGenerator,
     func: Rc<Func>,
+) -> Result<Option<(Rc<GeneratedItem>, Rc<FunctionId>)>> {
+    generate_func_impl(db, func, OverloadKind::NotOverloaded)
+}
+
+/// Returns the generated bindings for `func` as one overload of its overload
+/// set: an impl of the overload set's trait for the tuple of its parameter
+/// types. The first overload (`is_first`) also defines the trait, and the
+/// function that dispatches to the impls (see `overloaded_funcs`).
+pub fn generate_func_overload(
+    db: &dyn BindingsGenerator,
+    func: Rc<Func>,
+    is_first: bool,
+) -> Result<Rc<GeneratedItem>> {
+    let (generated_item, _) = generate_func_impl(db, func, OverloadKind::Overload { is_first })?
+        .ok_or_else(|| anyhow!("Cannot generate bindings for overloaded function"))?;
+    Ok(generated_item)
+}
+
+/// Whether `generate_func_impl` generates a function of its own, or one overload
+/// of an overload set.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum OverloadKind {
+    NotOverloaded,
+    Overload { is_first: bool },
+}
+
+fn generate_func_impl(
+    db: &dyn BindingsGenerator,
+    func: Rc<Func>,
+    overload: OverloadKind,
 ) -> Result<Option<(Rc<GeneratedItem>, Rc<FunctionId>)>> {
     let ir = db.ir();
     let crate_root_path = crate::crate_root_path_tokens(&ir);
@@ -1027,6 +1063,13 @@ pub fn generate_func(
         } else {
             return Ok(None);
         };
+    if overload != OverloadKind::NotOverloaded {
+        // Only safe free functions are dispatched on the types of their arguments.
+        ensure!(
+            impl_kind == ImplKind::None { is_unsafe: false } && !func.is_batched,
+            "Cannot generate bindings for overloaded function"
+        );
+    }
     let namespace_qualifier = ir.namespace_qualifier(&func)?.format_for_rs();
 
     let mut return_type = db
@@ -1061,7 +1104,11 @@ pub fn generate_func(
                                 func,
                             );
                         }
-                        clone_prefixes.push(quote!{&mut});
+                        if param_type.is_c_abi_compatible_by_value() {
+                            clone_prefixes.push(quote!{});
+                        } else {
+                            clone_prefixes.push(quote!{&mut});
+                        }
                         clone_suffixes.push(quote!{.clone()});
                         Ok(RsTypeKind::Reference {
                             referent: Rc::new(param_type.clone()),
@@ -1097,7 +1144,16 @@ pub fn generate_func(
         &mut return_type,
     )?;
 
-    let api_func_def = {
+    // Whether the API function does nothing but pass its arguments on to the
+    // thunk and return what the thunk returns.
+    let is_forwarding = !matches!(
+        impl_kind,
+        ImplKind::Trait { trait_name: TraitName::UnpinConstructor { .. }, .. }
+    ) && return_type.is_c_abi_compatible_by_value()
+        && thunk_prepare.is_empty()
+        && clone_suffixes.iter().all(TokenStream::is_empty);
+
+    let (api_func_def, func_body) = {
         let thunk_ident = thunk_ident(&func);
         let func_body = match &impl_kind {
             ImplKind::Trait { trait_name: TraitName::UnpinConstructor { .. }, .. } => {
@@ -1249,13 +1305,15 @@ pub fn generate_func(
             quote! {}
         };
 
-        quote! {
-            #[inline(always)]
+        let inline = inline_attribute(db, is_forwarding);
+        let api_func_def = quote! {
+            #inline
             #pub_ #unsafe_ fn #func_name #fn_generic_params(
                     #( #api_params ),* ) #arrow #function_return_type {
                 #func_body
             }
-        }
+        };
+        (api_func_def, func_body)
     };
 
     let doc_comment = crate::generate_doc_comment(
@@ -1267,7 +1325,32 @@ pub fn generate_func(
     let function_id: FunctionId;
     match impl_kind {
         ImplKind::None { .. } => {
-            api_func = quote! { #doc_comment #api_func_def };
+            api_func = match overload {
+                OverloadKind::NotOverloaded => quote! { #doc_comment #api_func_def },
+                OverloadKind::Overload { is_first } => {
+                    let overload_impl = generate_overload_impl(
+                        db,
+                        &func_name,
+                        &lifetimes,
+                        &param_idents,
+                        &param_types,
+                        &return_type,
+                        &quoted_return_type,
+                        &func_body,
+                        is_forwarding,
+                    )?;
+                    let overload_set = if is_first {
+                        generate_overload_set(&func_name)
+                    } else {
+                        quote! {}
+                    };
+                    quote! {
+                        #overload_set
+                        #doc_comment
+                        #overload_impl
+                    }
+                }
+            };
             function_id = FunctionId {
                 self_type: None,
                 function_path: syn::parse2(quote! { #namespace_qualifier #func_name }).unwrap(),
@@ -1307,8 +1390,9 @@ pub fn generate_func(
                     ImplFor::T => param.to_token_stream_replacing_by_self(Some(&trait_record)),
                     ImplFor::RefT => quote! { #param },
                 };
+                let inline = inline_attribute(db, /* is_forwarding= */ false);
                 quote! {
-                    #[inline(always)]
+                    #inline
                     fn partial_cmp(&self, other: & #quoted_param_or_self) -> Option<core::cmp::Ordering> {
                         if self == other {
                             return Some(core::cmp::Ordering::Equal);
@@ -1382,16 +1466,136 @@ pub fn generate_func(
         }
     }
 
-    let generated_item = GeneratedItem {
+    let mut generated_item = GeneratedItem {
         item: api_func,
         thunks: thunk,
         features,
         thunk_impls: generate_func_thunk_impl(db, &func)?,
         ..Default::default()
     };
+    if func.is_batched {
+        let (batch_api_func, batch_thunk, batch_thunk_impl) =
+            generate_func_batch(db, &func, &param_types, &return_type)?;
+        batch_api_func.to_tokens(&mut generated_item.item);
+        batch_thunk.to_tokens(&mut generated_item.thunks);
+        batch_thunk_impl.to_tokens(&mut generated_item.thunk_impls);
+    }
     Ok(Some((Rc::new(generated_item), Rc::new(function_id))))
 }
 
+/// Returns the name of the trait that the overloads of `func_name` implement.
+fn overload_trait_ident(func_name: &Ident) -> Ident {
+    let func_name = func_name.to_string();
+    format_ident!("__{}_Overload", func_name.trim_start_matches("r#"))
+}
+
+/// Returns the trait of the overload set named `func_name`, and the function
+/// that calls the overload for the types of its arguments.
+///
+/// Like `CtorNew<Args>`, the overloads are impls for `Args`: the parameter type
+/// of an overload with one parameter, and the tuple of the parameter types
+/// otherwise. So the overload is picked at compile time, and calling it costs
+/// no more than calling a function of its own.
+fn generate_overload_set(func_name: &Ident) -> TokenStream {
+    let trait_ident = overload_trait_ident(func_name);
+    let doc = format!(
+        " Calls the overload of `{func_name}` for `args`: `()` for no arguments, the\n \
+        argument itself for one, and a tuple of the arguments otherwise.",
+        func_name = func_name.to_string().trim_start_matches("r#"),
+    );
+    quote! {
+        #[doc(hidden)]
+        #[allow(non_camel_case_types)]
+        pub trait #trait_ident {
+            type Output;
+            fn call(self) -> Self::Output;
+        }
+
+        #[doc = #doc]
+        #[inline(always)]
+        pub fn #func_name<Args: #trait_ident>(args: Args) -> Args::Output {
+            args.call()
+        }
+    }
+}
+
+/// Returns the impl of the trait of the overload set named `func_name` for the
+/// parameter types of one overload, which calls it with `func_body`.
+#[allow(clippy::too_many_arguments)]
+fn generate_overload_impl(
+    db: &dyn BindingsGenerator,
+    func_name: &Ident,
+    lifetimes: &[Lifetime],
+    param_idents: &[Ident],
+    param_types: &[RsTypeKind],
+    return_type: &RsTypeKind,
+    quoted_return_type: &TokenStream,
+    func_body: &TokenStream,
+    is_forwarding: bool,
+) -> Result<TokenStream> {
+    // An `impl Ctor` can't be one of the types of a tuple, nor an associated type
+    // without `impl_trait_in_assoc_type`.
+    ensure!(
+        param_types.iter().all(RsTypeKind::is_unpin) && return_type.is_unpin(),
+        "Cannot generate bindings for overloaded function taking or returning !Unpin types by value"
+    );
+    // The impl's lifetimes must all be constrained by the types of the parameters.
+    ensure!(
+        return_type.lifetimes().all(|lifetime| lifetimes.contains(&lifetime)),
+        "Cannot generate bindings for overloaded function whose return type has a lifetime that \
+        its parameters don't have"
+    );
+    let trait_ident = overload_trait_ident(func_name);
+    let generic_params = format_generic_params(lifetimes, std::iter::empty::<syn::Ident>());
+    let args_type = format_tuple_except_singleton(param_types);
+    // The same bindings as `function_signature` give the parameters of a
+    // function of its own.
+    let arg_patterns = param_idents
+        .iter()
+        .zip(param_types)
+        .map(|(ident, type_)| {
+            if type_.is_c_abi_compatible_by_value() {
+                quote! {#ident}
+            } else {
+                quote! {mut #ident}
+            }
+        })
+        .collect_vec();
+    let arg_patterns = format_tuple_except_singleton(&arg_patterns);
+    let output = if quoted_return_type.is_empty() {
+        quote! {()}
+    } else {
+        quoted_return_type.clone()
+    };
+    let inline = inline_attribute(db, is_forwarding);
+    Ok(quote! {
+        impl #generic_params #trait_ident for #args_type {
+            type Output = #output;
+            #inline
+            fn call(self) -> Self::Output {
+                let #arg_patterns = self;
+                #func_body
+            }
+        }
+    })
+}
+
+/// Returns the inline attribute of a generated API function.
+///
+/// A function that just forwards its arguments to a thunk (or to another API
+/// function) is always inlined, so that calling it costs no more than calling
+/// the thunk. Other functions are, too, unless `inline_always_forwarding_only`
+/// is set, in which case they are only hinted to be inlined: forcing their
+/// (larger) bodies into every caller makes big bindings crates, and the crates
+/// that use them, slower to compile, for little benefit.
+fn inline_attribute(db: &dyn BindingsGenerator, is_forwarding: bool) -> TokenStream {
+    if is_forwarding || !db.inline_always_forwarding_only() {
+        quote! { #[inline(always)] }
+    } else {
+        quote! { #[inline] }
+    }
+}
+
 /// The function signature for a function's bindings.
 struct BindingsSignature {
     /// The lifetime parameters for the Rust function.
@@ -1667,6 +1871,92 @@ fn generate_func_thunk(
     })
 }
 
+/// Returns true if slices of `rs_type_kind` can be passed to a batch thunk, which passes their
+/// elements by value to the C++ function.
+fn is_batch_element_type(rs_type_kind: &RsTypeKind) -> bool {
+    match rs_type_kind.unalias() {
+        RsTypeKind::Primitive(PrimitiveType::Unit) => false,
+        RsTypeKind::Primitive(_) | RsTypeKind::Enum { .. } => true,
+        RsTypeKind::Record { .. } => rs_type_kind.is_c_abi_compatible_by_value(),
+        _ => false,
+    }
+}
+
+/// Generates the batch variant of a function with the `crubit_internal_batch` attribute.
+///
+/// The batch thunk takes `(const T* input, size_t n, R* output)` and calls the function on each
+/// element on the C++ side, so that a whole slice crosses the language boundary in a single call.
+///
+/// Returns the Rust API function, the declaration of the batch thunk, and its C++ definition.
+fn generate_func_batch(
+    db: &dyn BindingsGenerator,
+    func: &Func,
+    param_types: &[RsTypeKind],
+    return_type: &RsTypeKind,
+) -> Result<(TokenStream, TokenStream, TokenStream)> {
+    let UnqualifiedIdentifier::Identifier(id) = &func.name else {
+        bail!("The `crubit_internal_batch` attribute is only supported on named functions");
+    };
+    ensure!(
+        func.member_func_metadata.is_none(),
+        "The `crubit_internal_batch` attribute is not supported on member functions"
+    );
+    let ([param_type], [param]) = (param_types, &func.params[..]) else {
+        bail!("The `crubit_internal_batch` attribute requires a function with a single parameter");
+    };
+    ensure!(
+        is_batch_element_type(param_type) && is_batch_element_type(return_type),
+        "The `crubit_internal_batch` attribute requires parameter and return types that can be \
+         passed by value across the C ABI, got `{}` and `{}`",
+        param_type.to_token_stream(),
+        return_type.to_token_stream(),
+    );
+
+    let ir = db.ir();
+    let crate_root_path = crate::crate_root_path_tokens(&ir);
+    let batch_name = make_rs_ident(&format!("{}_batch", id.identifier));
+    let thunk_ident = format_ident!("{}_batch", thunk_ident(func));
+    let doc_comment = format!(
+        " Calls `{}` on each element of `input`, and stores the results in the corresponding \
+         elements of `output`.\n\n Panics if `input` and `output` have different lengths.",
+        id.identifier
+    );
+    let inline = inline_attribute(db, /* is_forwarding= */ false);
+    let api_func = quote! {
+        #[doc = #doc_comment]
+        #inline
+        pub fn #batch_name(input: &[#param_type], output: &mut [#return_type]) {
+            assert_eq!(input.len(), output.len());
+            unsafe {
+                #crate_root_path::detail::#thunk_ident(
+                    input.as_ptr(), input.len(), output.as_mut_ptr())
+            }
+        }
+    };
+    let thunk = quote! {
+        pub(crate) fn #thunk_ident(
+            input: *const #param_type, n: usize, output: *mut #return_type);
+    };
+
+    let mut cc_param_type = param.type_.cc_type.clone();
+    cc_param_type.is_const = true;
+    let cc_param_type = crate::format_cc_type(&cc_param_type, &ir)?;
+    let mut cc_return_type = func.return_type.cc_type.clone();
+    cc_return_type.is_const = false;
+    let cc_return_type = crate::format_cc_type(&cc_return_type, &ir)?;
+    let fn_ident = crate::format_cc_ident(&id.identifier);
+    let namespace_qualifier = ir.namespace_qualifier(func)?.format_for_cc()?;
+    let thunk_impl = quote! {
+        extern "C" void #thunk_ident(
+                #cc_param_type * input, size_t n, #cc_return_type * output) {
+            for (size_t i = 0; i < n; ++i) {
+                output[i] = #namespace_qualifier #fn_ident(input[i]);
+            }
+        }
+    };
+    Ok((api_func, thunk, thunk_impl))
+}
+
 /// Formats singletons as themselves, and collections of n!=1 items as a tuple.
 ///
 /// In other words, this formats a collection of things as if via `#(#items),*`,
@@ -1708,23 +1998,92 @@ fn format_tuple_except_singleton_replacing_by_self(
     }
 }
 
-/// Identifies all functions having overloads that we can't import (yet).
+/// Identifies all functions having overloads, mapped to the first overload of
+/// each overload set if the set is generated as a trait with an impl for each
+/// overload (see `generate_func_overload`), or to None if it can't be imported
+/// (yet).
 ///
-/// TODO(b/213280424): Implement support for overloaded functions.
-pub fn overloaded_funcs(db: &dyn BindingsGenerator) -> Rc<HashSet<Rc<FunctionId>>> {
-    let mut seen_funcs = HashSet::new();
-    let mut overloaded_funcs = HashSet::new();
+/// An overload set is only imported if every overload in it can be, and if no
+/// two overloads are for the same Rust types (e.g. `long` and `long long`, which
+/// are both `i64`), which would be conflicting impls.
+///
+/// TODO(b/213280424): Implement support for overloaded methods.
+pub fn overloaded_funcs(
+    db: &dyn BindingsGenerator,
+) -> Rc<HashMap<Rc<FunctionId>, Option<Rc<Func>>>> {
+    let mut overload_sets: HashMap<Rc<FunctionId>, Vec<Rc<Func>>> = HashMap::new();
+    let mut function_ids = vec![];
     for func in db.ir().functions() {
-        if let Ok(Some(f)) = db.generate_func(func.clone()) {
-            let (.., function_id) = &f;
-            if !seen_funcs.insert(function_id.clone()) {
-                overloaded_funcs.insert(function_id.clone());
+        if let Ok(Some((_, function_id))) = db.generate_func(func.clone()) {
+            let overloads = overload_sets.entry(function_id.clone()).or_default();
+            if overloads.is_empty() {
+                function_ids.push(function_id);
             }
+            overloads.push(func.clone());
+        }
+    }
+    let mut overloaded_funcs = HashMap::new();
+    for function_id in function_ids {
+        let overloads = &overload_sets[&function_id];
+        if overloads.len() == 1 {
+            continue;
         }
+        let is_dispatchable =
+            overloads.iter().all(|func| generate_func_overload(db, func.clone(), false).is_ok())
+                && has_distinct_overload_args(db, overloads);
+        overloaded_funcs.insert(function_id, is_dispatchable.then(|| overloads[0].clone()));
     }
     Rc::new(overloaded_funcs)
 }
 
+/// Returns whether the Rust types of the parameters of each of `overloads` are
+/// different from those of the others, on all the platforms that Crubit
+/// supports (which are LP64, with either a signed or an unsigned `char`).
+fn has_distinct_overload_args(db: &dyn BindingsGenerator, overloads: &[Rc<Func>]) -> bool {
+    const LP64_ALIASES: &[(&str, &str)] = &[
+        (":: core :: ffi :: c_uchar", "u8"),
+        (":: core :: ffi :: c_schar", "i8"),
+        (":: core :: ffi :: c_ushort", "u16"),
+        (":: core :: ffi :: c_short", "i16"),
+        (":: core :: ffi :: c_uint", "u32"),
+        (":: core :: ffi :: c_int", "i32"),
+        (":: core :: ffi :: c_ulonglong", "u64"),
+        (":: core :: ffi :: c_longlong", "i64"),
+        (":: core :: ffi :: c_ulong", "u64"),
+        (":: core :: ffi :: c_long", "i64"),
+        ("usize", "u64"),
+        ("isize", "i64"),
+    ];
+    let Ok(args_types) = overloads
+        .iter()
+        .map(|func| {
+            let param_types = func
+                .params
+                .iter()
+                .map(|p| db.rs_type_kind(p.type_.rs_type.clone()))
+                .collect::<Result<Vec<_>>>()?;
+            // Lifetimes don't make types different.
+            let args_type = format_tuple_except_singleton(&param_types)
+                .to_string()
+                .split(' ')
+                .map(|token| if token.starts_with('\'') { "'_" } else { token })
+                .join(" ");
+            Ok(LP64_ALIASES
+                .iter()
+                .fold(args_type, |args_type, (alias, type_)| args_type.replace(alias, type_)))
+        })
+        .collect::<Result<Vec<String>>>()
+    else {
+        return false;
+    };
+    ["i8", "u8"].iter().all(|c_char| {
+        let mut seen = HashSet::new();
+        args_types
+            .iter()
+            .all(|args_type| seen.insert(args_type.replace(":: core :: ffi :: c_char", c_char)))
+    })
+}
+
 fn unique_lifetimes<'a>(
     types: impl IntoIterator<Item = &'a RsTypeKind> + 'a,
 ) -> impl Iterator<Item = Lifetime> + 'a {
@@ -1813,9 +2172,17 @@ fn generate_func_thunk_impl(db: &dyn BindingsGenerator, func: &Func) -> Result<T
                 Some("&") => Ok(quote! { * #ident }),
                 Some("&&") => Ok(quote! { std::move(* #ident) }),
                 _ => {
-                    // non-Unpin types are wrapped by a pointer in the thunk.
-                    if !db.rs_type_kind(p.type_.rs_type.clone())?.is_c_abi_compatible_by_value() {
+                    let rs_type_kind = db.rs_type_kind(p.type_.rs_type.clone())?;
+                    if !rs_type_kind.is_c_abi_compatible_by_value() {
+                        // non-Unpin types are wrapped by a pointer in the thunk.
                         Ok(quote! { std::move(* #ident) })
+                    } else if let RsTypeKind::Record { .. } | RsTypeKind::UniquePtr { .. } =
+                        rs_type_kind.unalias()
+                    {
+                        // Records passed by value may have nontrivial copy constructors (e.g.
+                        // `[[clang::trivial_abi]]` ones), so move them instead of copying. A
+                        // `std::unique_ptr` can't be copied at all.
+                        Ok(quote! { std::move(#ident) })
                     } else {
                         Ok(quote! { #ident })
                     }
@@ -2039,6 +2406,42 @@ mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_unique_ptr_param_and_return() -> Result<()> {
+        let ir = ir_from_cc_dependency(
+            "struct Foo final {};
+            inline std::unique_ptr<Foo> Wrap(std::unique_ptr<Foo> foo);",
+            "namespace std {
+            template <typename T> struct default_delete {
+              void operator()(T* p) const { delete p; }
+            };
+            template <typename T, typename D = default_delete<T>> class unique_ptr {
+             public:
+              unique_ptr(unique_ptr&& other);
+              ~unique_ptr() { D()(p_); }
+             private:
+              T* p_;
+            };
+            }  // namespace std",
+        )?;
+
+        let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                pub fn Wrap(mut foo: ::cc_std::unique_ptr::UniquePtr<crate::Foo>)
+                    -> ::cc_std::unique_ptr::UniquePtr<crate::Foo>
+            }
+        );
+        assert_cc_matches!(
+            rs_api_impl,
+            quote! {
+                new (__return) auto(Wrap(std::move(*foo)));
+            }
+        );
+        Ok(())
+    }
+
     #[test]
     fn test_ref_to_struct_in_thunk_impls() -> Result<()> {
         let ir = ir_from_cc("struct S{}; inline void foo(S& s) {} ")?;
@@ -2550,7 +2953,7 @@ mod tests {
                     #[inline(always)]
                     fn eq(& self, rhs: & Self) -> bool {
                         unsafe { crate::detail::__rust_thunk___Zeq10SomeStructS_(
-                                &mut self.clone(), &mut rhs.clone()) }
+                                self.clone(), rhs.clone()) }
                     }
                 }
             }
@@ -2684,7 +3087,7 @@ mod tests {
                     #[inline(always)]
                     fn lt(& self, rhs: &Self) -> bool {
                         unsafe { crate::detail::__rust_thunk___Zlt10SomeStructS_(
-                                &mut self.clone(), &mut rhs.clone()) }
+                                self.clone(), rhs.clone()) }
                     }
                 }
             }
@@ -2965,7 +3368,7 @@ mod tests {
     #[test]
     fn test_overloaded_functions() -> Result<()> {
         // TODO(b/213280424): We don't support creating bindings for overloaded
-        // functions yet, except in the case of overloaded constructors with a
+        // methods yet, except in the case of overloaded constructors with a
         // single parameter.
         let ir = ir_from_cc(
             r#" #pragma clang lifetime_elision
@@ -2989,13 +3392,50 @@ mod tests {
         )?;
         let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
 
-        // Cannot overload free functions.
-        assert_cc_matches!(rs_api, {
-            let txt = "Generated from: google3/ir_from_cc_virtual_header.h;l=4\n\
-                           Error while generating bindings for item 'f':\n\
-                           Cannot generate bindings for overloaded function";
-            quote! { __COMMENT__ #txt }
-        });
+        // Overloaded free functions are dispatched on the types of their arguments.
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                pub trait __f_Overload {
+                    type Output;
+                    fn call(self) -> Self::Output;
+                }
+            }
+        );
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                pub fn f<Args: __f_Overload>(args: Args) -> Args::Output {
+                    args.call()
+                }
+            }
+        );
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                impl __f_Overload for () {
+                    type Output = ();
+                    #[inline(always)]
+                    fn call(self) -> Self::Output {
+                        let () = self;
+                        unsafe { crate::detail::__rust_thunk___Z1fv() }
+                    }
+                }
+            }
+        );
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                impl __f_Overload for ::core::ffi::c_int {
+                    type Output = ();
+                    #[inline(always)]
+                    fn call(self) -> Self::Output {
+                        let i = self;
+                        unsafe { crate::detail::__rust_thunk___Z1fi(i) }
+                    }
+                }
+            }
+        );
         assert_rs_not_matches!(rs_api, quote! {pub fn f()});
         assert_rs_not_matches!(rs_api, quote! {pub fn f(i: ::core::ffi::c_int)});
 
@@ -3007,8 +3447,9 @@ mod tests {
         });
         assert_rs_not_matches!(rs_api, quote! {pub fn f(... S1 ...)});
 
-        // And thunks aren't generated for either.
-        assert_cc_not_matches!(rs_api_impl, quote! {f});
+        // And thunks aren't generated for the overloaded methods.
+        assert_cc_not_matches!(rs_api_impl, quote! {__rust_thunk___ZN2S11fEv});
+        assert_cc_not_matches!(rs_api_impl, quote! {__rust_thunk___ZN2S11fEi});
 
         // But we can import member functions that have the same name as a free
         // function.
@@ -3024,6 +3465,21 @@ mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_overloaded_functions_with_the_same_rust_types() -> Result<()> {
+        // `long` and `long long` are both `i64`, so the impls would conflict.
+        let ir = ir_from_cc(
+            r#"
+                void g(long l);
+                void g(long long ll);
+            "#,
+        )?;
+        let rs_api = generate_bindings_tokens(ir)?.rs_api;
+        assert_rs_not_matches!(rs_api, quote! {__g_Overload});
+        assert_rs_not_matches!(rs_api, quote! {pub fn g});
+        Ok(())
+    }
+
     /// !Unpin references should not be pinned.
     #[test]
     fn test_nonunpin_ref_param() -> Result<()> {
@@ -3359,6 +3815,57 @@ mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_virtual_method_uses_thunk() -> Result<()> {
+        let ir = ir_from_cc(
+            r#"#pragma clang lifetime_elision
+            struct Polymorphic {
+              virtual int Get() const;
+            };
+            "#,
+        )?;
+        let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
+        assert_rs_not_matches!(rs_api, quote! {#[link_name = "_ZNK11Polymorphic3GetEv"]});
+        assert_cc_matches!(
+            rs_api_impl,
+            quote! {
+                extern "C" int __rust_thunk___ZNK11Polymorphic3GetEv(
+                        const struct Polymorphic* __this) {
+                    return __this->Get();
+                }
+            }
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn test_final_virtual_method_skips_thunk() -> Result<()> {
+        let ir = ir_from_cc(
+            r#"#pragma clang lifetime_elision
+            struct Base {
+              virtual int Get() const;
+              virtual int GetOther() const;
+            };
+            struct FinalOverride : Base {
+              int Get() const final;
+              int GetOther() const override;
+            };
+            struct FinalClass final : Base {
+              int Get() const override;
+            };
+            "#,
+        )?;
+        let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
+        for mangled_name in ["_ZNK13FinalOverride3GetEv", "_ZNK10FinalClass3GetEv"] {
+            assert_rs_matches!(rs_api, quote! {#[link_name = #mangled_name]});
+            let thunk_ident = format_ident!("__rust_thunk___{}", mangled_name);
+            assert_cc_not_matches!(rs_api_impl, quote! {#thunk_ident});
+        }
+        // `GetOther()` can still be overridden by a subclass of `FinalOverride`.
+        assert_cc_matches!(rs_api_impl, quote! {__rust_thunk___ZNK13FinalOverride8GetOtherEv});
+        Ok(())
+    }
+
     #[test]
     fn test_unpin_by_value_param() -> Result<()> {
         let ir = ir_from_cc(
@@ -3371,6 +3878,67 @@ mod tests {
             "#,
         )?;
         let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                #[inline(always)]
+                pub fn foo(param: crate::Trivial) {
+                    unsafe { crate::detail::__rust_thunk___Z3foo7Trivial(param) }
+                }
+            }
+        );
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                #[link_name = "_Z3foo7Trivial"]
+                pub(crate) fn __rust_thunk___Z3foo7Trivial(param: crate::Trivial);
+            }
+        );
+        assert_cc_not_matches!(rs_api_impl, quote! {__rust_thunk___Z3foo7Trivial});
+        Ok(())
+    }
+
+    #[test]
+    fn test_unpin_by_value_param_inline() -> Result<()> {
+        let ir = ir_from_cc(
+            r#"#pragma clang lifetime_elision
+            struct Trivial final {
+              int trivial_field;
+            };
+
+            inline void foo(Trivial param) {}
+            "#,
+        )?;
+        let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                pub(crate) fn __rust_thunk___Z3foo7Trivial(param: crate::Trivial);
+            }
+        );
+        assert_cc_matches!(
+            rs_api_impl,
+            quote! {
+                extern "C" void __rust_thunk___Z3foo7Trivial(struct Trivial param) {
+                    foo(std::move(param));
+                }
+            }
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn test_unpin_by_value_param_with_opaque_field() -> Result<()> {
+        let ir = ir_from_cc(
+            r#"#pragma clang lifetime_elision
+            struct Trivial final {
+              [[no_unique_address]] int opaque_field;
+            };
+
+            void foo(Trivial param);
+            "#,
+        )?;
+        let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
         assert_rs_matches!(
             rs_api,
             quote! {
@@ -3414,10 +3982,88 @@ mod tests {
             quote! {
                 #[inline(always)]
                 pub fn foo() -> crate::Trivial {
+                    unsafe { crate::detail::__rust_thunk___Z3foov() }
+                }
+            }
+        );
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                #[link_name = "_Z3foov"]
+                pub(crate) fn __rust_thunk___Z3foov() -> crate::Trivial;
+            }
+        );
+        assert_cc_not_matches!(rs_api_impl, quote! {__rust_thunk___Z3foov});
+        Ok(())
+    }
+
+    #[test]
+    fn test_trivial_abi_by_value_return() -> Result<()> {
+        let ir = ir_from_cc(
+            r#"#pragma clang lifetime_elision
+            struct [[clang::trivial_abi]] TrivialAbi final {
+              TrivialAbi(const TrivialAbi&);
+              ~TrivialAbi();
+              int field;
+            };
+
+            TrivialAbi foo(TrivialAbi param);
+            inline TrivialAbi bar(TrivialAbi param) { return param; }
+            "#,
+        )?;
+        let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                #[inline(always)]
+                pub fn foo(param: crate::TrivialAbi) -> crate::TrivialAbi {
+                    unsafe { crate::detail::__rust_thunk___Z3foo10TrivialAbi(param) }
+                }
+            }
+        );
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                #[link_name = "_Z3foo10TrivialAbi"]
+                pub(crate) fn __rust_thunk___Z3foo10TrivialAbi(
+                    param: crate::TrivialAbi
+                ) -> crate::TrivialAbi;
+            }
+        );
+        assert_cc_not_matches!(rs_api_impl, quote! {__rust_thunk___Z3foo10TrivialAbi});
+        assert_cc_matches!(
+            rs_api_impl,
+            quote! {
+                extern "C" struct TrivialAbi __rust_thunk___Z3bar10TrivialAbi(
+                        struct TrivialAbi param) {
+                    return bar(std::move(param));
+                }
+            }
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn test_batch_function() -> Result<()> {
+        let ir = ir_from_cc(
+            r#"
+            namespace ns {
+            [[clang::annotate("crubit_internal_batch")]] inline float Square(float x) {
+              return x * x;
+            }
+            }  // namespace ns
+            "#,
+        )?;
+        let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(ir)?;
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                #[inline(always)]
+                pub fn Square_batch(input: &[f32], output: &mut [f32]) {
+                    assert_eq!(input.len(), output.len());
                     unsafe {
-                        let mut __return = ::core::mem::MaybeUninit::<crate::Trivial>::uninit();
-                        crate::detail::__rust_thunk___Z3foov(&mut __return);
-                        __return.assume_init()
+                        crate::detail::__rust_thunk___ZN2ns6SquareEf_batch(
+                            input.as_ptr(), input.len(), output.as_mut_ptr())
                     }
                 }
             }
@@ -3425,22 +4071,36 @@ mod tests {
         assert_rs_matches!(
             rs_api,
             quote! {
-                pub(crate) fn __rust_thunk___Z3foov(
-                    __return: &mut ::core::mem::MaybeUninit<crate::Trivial>
-                );
+                pub(crate) fn __rust_thunk___ZN2ns6SquareEf_batch(
+                    input: *const f32, n: usize, output: *mut f32);
             }
         );
         assert_cc_matches!(
             rs_api_impl,
             quote! {
-                extern "C" void __rust_thunk___Z3foov(struct Trivial* __return) {
-                    new (__return) auto(foo());
+                extern "C" void __rust_thunk___ZN2ns6SquareEf_batch(
+                        const float* input, size_t n, float* output) {
+                    for (size_t i = 0; i < n; ++i) {
+                        output[i] = ns::Square(input[i]);
+                    }
                 }
             }
         );
         Ok(())
     }
 
+    #[test]
+    fn test_batch_function_unsupported_type() -> Result<()> {
+        let ir = ir_from_cc(
+            r#"#pragma clang lifetime_elision
+            [[clang::annotate("crubit_internal_batch")]] int& Get(int& x);"#,
+        )?;
+        let BindingsTokens { rs_api, .. } = generate_bindings_tokens(ir)?;
+        assert_rs_not_matches!(rs_api, quote! {Get_batch});
+        assert_rs_not_matches!(rs_api, quote! {pub fn Get});
+        Ok(())
+    }
+
     #[test]
     fn test_unpin_rvalue_ref_qualified_method() -> Result<()> {
         let ir = ir_from_cc(
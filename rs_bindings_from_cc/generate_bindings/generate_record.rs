@@ -3,7 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 #![allow(clippy::collapsible_else_if)]
 
-use crate::{BindingsGenerator, Database, GeneratedItem};
+use crate::{BindingsGenerator, Database, GeneratedItem, LayoutChecks};
 
 use crate::rs_snippet::{should_derive_clone, should_derive_copy, RsTypeKind};
 use arc_anyhow::{Context, Result};
@@ -333,27 +333,22 @@ pub fn generate_record(db: &Database, record: &Rc<Record>) -> Result<GeneratedIt
         })
         .collect::<Result<Vec<_>>>()?;
 
-    let field_offset_assertions = fields_with_bounds
+    let field_offset_checks = fields_with_bounds
         .enumerate()
-        .map(|(field_index, (field, _, _, _))| {
-            if let Some(field) = field {
-                let field_ident = make_rs_field_ident(field, field_index);
-
-                // The assertion below reinforces that the division by 8 on the next line is
-                // justified (because the bitfields have been coallesced / filtered out
-                // earlier).
-                assert_eq!(field.offset % 8, 0);
-                let expected_offset = Literal::usize_unsuffixed(field.offset / 8);
-
-                let actual_offset_expr = quote! {
-                    ::core::mem::offset_of!(#qualified_ident, #field_ident)
-                };
-                quote! {
-                    assert!(#actual_offset_expr == #expected_offset);
-                }
-            } else {
-                quote! {}
-            }
+        .filter_map(|(field_index, (field, _, _, _))| {
+            let field = field?;
+            let field_ident = make_rs_field_ident(field, field_index);
+
+            // The assertion below reinforces that the division by 8 on the next line is
+            // justified (because the bitfields have been coallesced / filtered out
+            // earlier).
+            assert_eq!(field.offset % 8, 0);
+            let expected_offset = Literal::usize_unsuffixed(field.offset / 8);
+
+            let actual_offset_expr = quote! {
+                ::core::mem::offset_of!(#qualified_ident, #field_ident)
+            };
+            Some((actual_offset_expr, expected_offset))
         })
         .collect_vec();
     let mut features = BTreeSet::new();
@@ -443,11 +438,11 @@ pub fn generate_record(db: &Database, record: &Rc<Record>) -> Result<GeneratedIt
     if crubit_features.contains(ir::CrubitFeature::Experimental) {
         record_generated_items.push(cc_struct_upcast_impl(record, &ir)?);
     }
-    let no_unique_address_accessors = if crubit_features.contains(ir::CrubitFeature::Experimental) {
-        cc_struct_no_unique_address_impl(db, record)?
-    } else {
-        quote! {}
-    };
+    let field_accessors = cc_struct_field_accessors_impl(
+        db,
+        record,
+        crubit_features.contains(ir::CrubitFeature::Experimental),
+    )?;
     let incomplete_definition = if crubit_features.contains(ir::CrubitFeature::Experimental) {
         quote! {
             forward_declare::unsafe_define!(forward_declare::symbol!(#fully_qualified_cc_name), #qualified_ident);
@@ -458,7 +453,24 @@ pub fn generate_record(db: &Database, record: &Rc<Record>) -> Result<GeneratedIt
 
     let mut items = vec![];
     let mut thunks_from_record_items = vec![];
-    let mut thunk_impls_from_record_items = vec![cc_struct_layout_assertion(db, record)?];
+    let mut layout_checks = LayoutChecks {
+        rs: rs_size_align_checks(&qualified_ident, &record.size_align),
+        cc: cc_struct_layout_checks(db, record)?,
+    };
+    layout_checks.rs.extend(field_offset_checks);
+    let (size_align_assertions, field_offset_assertions, cc_layout_assertion_tokens) =
+        if db.compact_layout_assertions() {
+            (quote! {}, quote! {}, None)
+        } else {
+            let mut layout_checks = std::mem::take(&mut layout_checks);
+            let field_offset_checks = layout_checks.rs.split_off(2);
+            (
+                rs_layout_assertions(&layout_checks.rs),
+                rs_layout_assertions(&field_offset_checks),
+                Some(cc_layout_assertions(&layout_checks.cc)),
+            )
+        };
+    let mut thunk_impls_from_record_items = cc_layout_assertion_tokens.into_iter().collect_vec();
     let mut assertions_from_record_items = vec![];
 
     for generated in record_generated_items {
@@ -472,6 +484,7 @@ pub fn generate_record(db: &Database, record: &Rc<Record>) -> Result<GeneratedIt
         if !generated.thunk_impls.is_empty() {
             thunk_impls_from_record_items.push(generated.thunk_impls);
         }
+        layout_checks.extend(&generated.layout_checks);
         features.extend(generated.features.clone());
     }
 
@@ -491,7 +504,7 @@ pub fn generate_record(db: &Database, record: &Rc<Record>) -> Result<GeneratedIt
 
         #incomplete_definition
 
-        #no_unique_address_accessors
+        #field_accessors
 
         __NEWLINE__ __NEWLINE__
         #( #items __NEWLINE__ __NEWLINE__)*
@@ -526,11 +539,10 @@ pub fn generate_record(db: &Database, record: &Rc<Record>) -> Result<GeneratedIt
         add_conditional_assertion(should_implement_drop(record), quote! { Drop });
         assertions
     };
-    let size_align_assertions = rs_size_align_assertions(qualified_ident, &record.size_align);
     let assertion_tokens = quote! {
         #size_align_assertions
         #( #record_trait_assertions )*
-        #( #field_offset_assertions )*
+        #field_offset_assertions
         #( #field_copy_trait_assertions )*
         #( #assertions_from_record_items )*
     };
@@ -545,21 +557,41 @@ pub fn generate_record(db: &Database, record: &Rc<Record>) -> Result<GeneratedIt
         assertions: assertion_tokens,
         thunks: thunk_tokens,
         thunk_impls: quote! {#(#thunk_impls_from_record_items __NEWLINE__ __NEWLINE__)*},
+        layout_checks,
         ..Default::default()
     })
 }
 
-pub fn rs_size_align_assertions(
+/// Returns the checks of the size and alignment of `type_name`, in that order.
+pub fn rs_size_align_checks(
     type_name: impl ToTokens,
     size_align: &ir::SizeAlign,
-) -> TokenStream {
+) -> Vec<(TokenStream, Literal)> {
     let type_name = type_name.into_token_stream();
     let size = Literal::usize_unsuffixed(size_align.size);
     let alignment = Literal::usize_unsuffixed(size_align.alignment);
-    quote! {
-        assert!(::core::mem::size_of::<#type_name>() == #size);
-        assert!(::core::mem::align_of::<#type_name>() == #alignment);
-    }
+    vec![
+        (quote! { ::core::mem::size_of::<#type_name>() }, size),
+        (quote! { ::core::mem::align_of::<#type_name>() }, alignment),
+    ]
+}
+
+/// Returns an `assert!` for each of the Rust `checks` of a `LayoutChecks`.
+pub fn rs_layout_assertions(checks: &[(TokenStream, Literal)]) -> TokenStream {
+    let assertions = checks.iter().map(|(actual, expected)| {
+        quote! {
+            assert!(#actual == #expected);
+        }
+    });
+    quote! { #( #assertions )* }
+}
+
+/// Returns a `static_assert` for each of the C++ `checks` of a `LayoutChecks`.
+fn cc_layout_assertions(checks: &[(TokenStream, Literal)]) -> TokenStream {
+    let assertions = checks.iter().map(|(actual, expected)| {
+        quote! { static_assert(#actual == #expected); }
+    });
+    quote! { #( #assertions )* }
 }
 
 fn generate_derives(record: &Record) -> Vec<Ident> {
@@ -573,11 +605,13 @@ fn generate_derives(record: &Record) -> Vec<Ident> {
     derives
 }
 
-fn cc_struct_layout_assertion(db: &Database, record: &Record) -> Result<TokenStream> {
+/// Returns the checks of the size, alignment and public field offsets of
+/// `record` in C++.
+fn cc_struct_layout_checks(db: &Database, record: &Record) -> Result<Vec<(TokenStream, Literal)>> {
     let record_ident = crate::format_cc_ident(record.cc_name.as_ref());
     let namespace_qualifier = db.ir().namespace_qualifier(record)?.format_for_cc()?;
     let tag_kind = crate::cc_tag_kind(record);
-    let field_assertions = record
+    let field_checks = record
         .fields
         .iter()
         .filter(|f| f.access == AccessSpecifier::Public && f.identifier.is_some())
@@ -599,7 +633,7 @@ fn cc_struct_layout_assertion(db: &Database, record: &Record) -> Result<TokenStr
                 CRUBIT_OFFSET_OF(#field_ident, #tag_kind #namespace_qualifier #record_ident)
             };
 
-            quote! { static_assert( #actual_offset == #expected_offset); }
+            (actual_offset, expected_offset)
         });
     // only use CRUBIT_SIZEOF for alignment > 1, so as to simplify the generated
     // code.
@@ -610,21 +644,54 @@ fn cc_struct_layout_assertion(db: &Database, record: &Record) -> Result<TokenStr
     } else {
         quote! {CRUBIT_SIZEOF}
     };
-    Ok(quote! {
-        static_assert(#sizeof(#tag_kind #namespace_qualifier #record_ident) == #size);
-        static_assert(alignof(#tag_kind #namespace_qualifier #record_ident) == #alignment);
-        #( #field_assertions )*
-    })
+    Ok([
+        (quote! { #sizeof(#tag_kind #namespace_qualifier #record_ident) }, size),
+        (quote! { alignof(#tag_kind #namespace_qualifier #record_ident) }, alignment),
+    ]
+    .into_iter()
+    .chain(field_checks)
+    .collect())
+}
+
+/// Returns whether `field` is public and has a known type, but is laid out as
+/// an opaque blob of bytes only because it is nontrivial and `record`
+/// implements `Drop` (see `get_field_rs_type_kind_for_layout`).
+///
+/// Such fields can still be read through an accessor, as a shared reference
+/// neither moves nor destroys them.
+fn is_opaque_nontrivial_field(db: &Database, record: &Record, field: &Field) -> bool {
+    field.access == AccessSpecifier::Public
+        && field.identifier.is_some()
+        && field.size != 0
+        && !field.is_bitfield
+        && !field.is_no_unique_address
+        && field.unknown_attr.is_none()
+        && field.type_.as_ref().is_ok_and(|t| db.rs_type_kind(t.rs_type.clone()).is_ok())
+        && get_field_rs_type_kind_for_layout(db, record, field).is_err()
 }
 
-/// Returns the accessor functions for no_unique_address member variables.
-fn cc_struct_no_unique_address_impl(db: &Database, record: &Record) -> Result<TokenStream> {
+/// Returns the accessor functions for the public member variables that are
+/// laid out as opaque blobs of bytes, but whose type is known: no_unique_address
+/// member variables (with experimental features), and nontrivial ones of
+/// records that implement `Drop`.
+///
+/// The accessors compute the address from the offset of the member variable,
+/// which is asserted in the layout checks, so reading through them is a plain
+/// load rather than a call into C++.
+fn cc_struct_field_accessors_impl(
+    db: &Database,
+    record: &Record,
+    no_unique_address_accessors: bool,
+) -> Result<TokenStream> {
     let mut fields = vec![];
     let mut types = vec![];
     let mut field_offsets = vec![];
     let mut doc_comments = vec![];
     for field in &record.fields {
-        if field.access != AccessSpecifier::Public || !field.is_no_unique_address {
+        let is_no_unique_address = no_unique_address_accessors
+            && field.access == AccessSpecifier::Public
+            && field.is_no_unique_address;
+        if !is_no_unique_address && !is_opaque_nontrivial_field(db, record, field) {
             continue;
         }
         // `[[no_unique_address]]` cannot be applied to a bitfield.
@@ -633,8 +700,8 @@ fn cc_struct_no_unique_address_impl(db: &Database, record: &Record) -> Result<To
         assert_eq!(field.offset % 8, 0, "invalid subobject: [[no_unique_address]] on a bitfield");
 
         // Can't use `get_field_rs_type_kind_for_layout` here, because we want to dig
-        // into no_unique_address fields, despite laying them out as opaque
-        // blobs of bytes.
+        // into no_unique_address and nontrivial fields, despite laying them out as
+        // opaque blobs of bytes.
         if let Ok(rs_type) = field.type_.as_ref().map(|t| t.rs_type.clone()) {
             fields.push(make_rs_ident(
                 &field
@@ -2254,6 +2321,30 @@ mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_forward_declared_complete_in_dependency() -> Result<()> {
+        let mut ir = ir_from_cc(
+            r#"#pragma clang lifetime_elision
+            struct ForwardDeclared;
+            void TakesPointer(ForwardDeclared* p);"#,
+        )?;
+        // As if the type manifest of the dependency listed the record as complete.
+        for item in ir.items_mut() {
+            if let Item::IncompleteRecord(incomplete_record) = item {
+                let incomplete_record = Rc::make_mut(incomplete_record);
+                incomplete_record.owning_target = BazelLabel(ir_testing::DEPENDENCY_TARGET.into());
+                incomplete_record.is_complete_in_dependency = true;
+            }
+        }
+        let rs_api = generate_bindings_tokens(ir)?.rs_api;
+        assert_rs_matches!(
+            rs_api,
+            quote! { pub unsafe fn TakesPointer(p: *mut dependency::ForwardDeclared) }
+        );
+        assert_rs_not_matches!(rs_api, quote! {forward_declare::forward_declare!});
+        Ok(())
+    }
+
     #[test]
     fn test_private_struct_not_present() -> Result<()> {
         let ir = ir_from_cc(&with_lifetime_macros(
@@ -2464,6 +2555,20 @@ mod tests {
                 pub(crate) inner_field: [::core::mem::MaybeUninit<u8>; 1],
             }}
         );
+        // It can still be read, without a thunk.
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                impl Outer {
+                    pub fn inner_field(&self) -> &crate::Inner {
+                        unsafe {
+                            let ptr = (self as *const Self as *const u8).offset(0);
+                            &*(ptr as *const crate::Inner)
+                        }
+                    }
+                }
+            }
+        );
         Ok(())
     }
 
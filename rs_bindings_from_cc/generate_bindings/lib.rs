@@ -8,12 +8,16 @@ mod generate_record;
 mod rs_snippet;
 
 use generate_func::{
-    generate_func, get_binding, is_record_clonable, overloaded_funcs, FunctionId, ImplKind,
+    generate_func, generate_func_overload, get_binding, is_record_clonable, overloaded_funcs,
+    FunctionId, ImplKind,
 };
 use generate_record::{generate_incomplete_record, generate_record};
 
-use crate::rs_snippet::{CratePath, Lifetime, Mutability, PrimitiveType, RsTypeKind};
+use crate::rs_snippet::{
+    CratePath, CrubitFeatureRequirements, Lifetime, Mutability, PrimitiveType, RsTypeKind,
+};
 use arc_anyhow::{Context, Error, Result};
+use bloat_report::{BloatReport, ItemBloat, TokenCounts};
 use code_gen_utils::{format_cc_includes, make_rs_ident, CcInclude};
 use error_report::{anyhow, bail, ensure, ErrorReport, ErrorReporting, IgnoreErrors};
 use ffi_types::*;
@@ -21,15 +25,17 @@ use ir::*;
 use itertools::Itertools;
 use proc_macro2::{Ident, Literal, TokenStream};
 use quote::{quote, ToTokens};
-use std::collections::{BTreeSet, HashSet};
+use std::collections::hash_map::DefaultHasher;
+use std::collections::{BTreeSet, HashMap, HashSet};
 use std::ffi::{OsStr, OsString};
 use std::fmt::{Display, Formatter};
+use std::hash::{Hash, Hasher};
 use std::panic::catch_unwind;
-use std::path::Path;
+use std::path::{Path, PathBuf};
 use std::process;
 use std::rc::Rc;
 use token_stream_printer::{
-    cc_tokens_to_formatted_string, rs_tokens_to_formatted_string, RustfmtConfig,
+    rs_and_cc_tokens_to_formatted_strings, tokens_to_unformatted_string, RustfmtConfig,
 };
 
 /// FFI equivalent of `Bindings`.
@@ -38,6 +44,7 @@ pub struct FfiBindings {
     rs_api: FfiU8SliceBox,
     rs_api_impl: FfiU8SliceBox,
     error_report: FfiU8SliceBox,
+    bloat_report: FfiU8SliceBox,
 }
 
 /// Deserializes IR from `json` and generates bindings source code.
@@ -71,7 +78,15 @@ pub unsafe extern "C" fn GenerateBindingsImpl(
     rustfmt_exe_path: FfiU8Slice,
     rustfmt_config_path: FfiU8Slice,
     generate_error_report: bool,
+    error_report_format: ErrorReportFormat,
     generate_source_loc_doc_comment: SourceLocationDocComment,
+    rs_api_impl_shards: usize,
+    skip_formatting: bool,
+    compact_layout_assertions: bool,
+    inline_always_forwarding_only: bool,
+    minimal_rs_api_impl_includes: bool,
+    rust_enums: bool,
+    generate_bloat_report: bool,
 ) -> FfiBindings {
     let json: &[u8] = json.as_slice();
     let crubit_support_path_format: &str =
@@ -86,6 +101,14 @@ pub unsafe extern "C" fn GenerateBindingsImpl(
         // It is ok to abort here.
         let errors: Rc<dyn ErrorReporting> =
             if generate_error_report { Rc::new(ErrorReport::new()) } else { Rc::new(IgnoreErrors) };
+        let mut bloat_report = generate_bloat_report.then(BloatReport::default);
+        // Cached bindings come without the errors reported while generating them (or their bloat
+        // report), so the cache can only be used if there is no report to write.
+        let cache_dir = if generate_error_report || generate_bloat_report {
+            None
+        } else {
+            std::env::var_os(BINDINGS_CACHE_DIR_ENV_VAR).map(PathBuf::from)
+        };
         let Bindings { rs_api, rs_api_impl } = generate_bindings(
             json,
             crubit_support_path_format,
@@ -94,6 +117,14 @@ pub unsafe extern "C" fn GenerateBindingsImpl(
             &rustfmt_config_path,
             errors.clone(),
             generate_source_loc_doc_comment,
+            rs_api_impl_shards,
+            skip_formatting,
+            compact_layout_assertions,
+            inline_always_forwarding_only,
+            minimal_rs_api_impl_includes,
+            rust_enums,
+            cache_dir.as_deref(),
+            bloat_report.as_mut(),
         )
         .unwrap();
         FfiBindings {
@@ -102,7 +133,18 @@ pub unsafe extern "C" fn GenerateBindingsImpl(
                 rs_api_impl.into_bytes().into_boxed_slice(),
             ),
             error_report: FfiU8SliceBox::from_boxed_slice(
-                errors.serialize_to_vec().unwrap().into_boxed_slice(),
+                match error_report_format {
+                    ErrorReportFormat::Json => errors.serialize_to_vec(),
+                    ErrorReportFormat::Binary => errors.serialize_to_binary(),
+                }
+                .unwrap()
+                .into_boxed_slice(),
+            ),
+            bloat_report: FfiU8SliceBox::from_boxed_slice(
+                bloat_report
+                    .map(|report| report.serialize_to_vec().unwrap())
+                    .unwrap_or_default()
+                    .into_boxed_slice(),
             ),
         }
     })
@@ -117,12 +159,36 @@ memoized::query_group! {
         fn errors(&self) -> Rc<dyn ErrorReporting>;
         #[input]
         fn generate_source_loc_doc_comment(&self) -> SourceLocationDocComment;
+        /// Whether the layout of records is checked by one table per language
+        /// (see `LayoutChecks`), rather than by an assertion per value.
+        #[input]
+        fn compact_layout_assertions(&self) -> bool;
+        /// Whether only the API functions that just forward their arguments to
+        /// a thunk are `#[inline(always)]` (see `generate_func::inline_attribute`).
+        #[input]
+        fn inline_always_forwarding_only(&self) -> bool;
+        /// Whether `rs_api_impl` only includes the public headers that it needs
+        /// (see `public_headers_for_rs_api_impl`).
+        #[input]
+        fn minimal_rs_api_impl_includes(&self) -> bool;
+        /// Whether enums with contiguous enumerators also get a Rust enum of
+        /// the enumerators (see `generate_rust_enum`).
+        #[input]
+        fn rust_enums(&self) -> bool;
 
         fn rs_type_kind(&self, rs_type: RsType) -> Result<RsTypeKind>;
 
+        /// The features required by `rs_type_kind(rs_type)`, which are looked
+        /// up for each item whose signature contains the type, and for each of
+        /// its targets.
+        fn crubit_feature_requirements(
+            &self,
+            rs_type: RsType,
+        ) -> Result<Rc<CrubitFeatureRequirements>>;
+
         fn generate_func(&self, func: Rc<Func>) -> Result<Option<(Rc<GeneratedItem>, Rc<FunctionId>)>>;
 
-        fn overloaded_funcs(&self) -> Rc<HashSet<Rc<FunctionId>>>;
+        fn overloaded_funcs(&self) -> Rc<HashMap<Rc<FunctionId>, Option<Rc<Func>>>>;
 
         fn is_record_clonable(&self, record: Rc<Record>) -> bool;
 
@@ -153,6 +219,93 @@ pub(crate) struct BindingsTokens {
     rs_api_impl: TokenStream,
 }
 
+/// Environment variable naming a directory in which generated bindings are
+/// cached, keyed on the IR and everything else that they depend on. A target
+/// whose IR is unchanged (e.g. because only the bodies of inline functions in
+/// its headers changed) then gets the bindings of the previous run, which are
+/// byte-identical to those a full run would generate, without generating or
+/// formatting them again. Caching is disabled if it is unset.
+const BINDINGS_CACHE_DIR_ENV_VAR: &str = "CRUBIT_BINDINGS_CACHE_DIR";
+
+/// Returns the name under which the bindings generated with the given
+/// arguments are cached, or `None` if the files they depend on can't be read.
+fn bindings_cache_key(
+    json: &[u8],
+    crubit_support_path_format: &str,
+    clang_format_exe_path: &OsStr,
+    rustfmt_exe_path: &OsStr,
+    rustfmt_config_path: &OsStr,
+    generate_source_loc_doc_comment: SourceLocationDocComment,
+    rs_api_impl_shards: usize,
+    skip_formatting: bool,
+    compact_layout_assertions: bool,
+    inline_always_forwarding_only: bool,
+    minimal_rs_api_impl_includes: bool,
+    rust_enums: bool,
+) -> Option<String> {
+    // Executables are identified by their path, size, and modification time, which
+    // includes the binary that this generator is linked into.
+    let current_exe = std::env::current_exe().ok()?;
+    let mut exe_identities = vec![];
+    for exe_path in [current_exe.as_os_str(), clang_format_exe_path, rustfmt_exe_path] {
+        let metadata = std::fs::metadata(exe_path).ok()?;
+        exe_identities.push((exe_path, metadata.len(), metadata.modified().ok()));
+    }
+    let rustfmt_config = if rustfmt_config_path.is_empty() {
+        vec![]
+    } else {
+        std::fs::read(rustfmt_config_path).ok()?
+    };
+    // `DefaultHasher` is only 64 bits wide, so two differently-salted hashes are
+    // combined to make collisions negligible.
+    let hash = |salt: u8| {
+        let mut hasher = DefaultHasher::new();
+        salt.hash(&mut hasher);
+        json.hash(&mut hasher);
+        crubit_support_path_format.hash(&mut hasher);
+        exe_identities.hash(&mut hasher);
+        rustfmt_config.hash(&mut hasher);
+        generate_source_loc_doc_comment.hash(&mut hasher);
+        rs_api_impl_shards.hash(&mut hasher);
+        skip_formatting.hash(&mut hasher);
+        compact_layout_assertions.hash(&mut hasher);
+        inline_always_forwarding_only.hash(&mut hasher);
+        minimal_rs_api_impl_includes.hash(&mut hasher);
+        rust_enums.hash(&mut hasher);
+        hasher.finish()
+    };
+    Some(format!("{:016x}{:016x}", hash(0), hash(1)))
+}
+
+/// Returns the bindings cached in `cache_dir` under `key`, if any.
+fn read_cached_bindings(cache_dir: &Path, key: &str) -> Option<Bindings> {
+    let rs_api = std::fs::read_to_string(cache_dir.join(format!("{key}.rs"))).ok()?;
+    let rs_api_impl = std::fs::read_to_string(cache_dir.join(format!("{key}.cc"))).ok()?;
+    Some(Bindings { rs_api, rs_api_impl })
+}
+
+/// Caches `bindings` in `cache_dir` under `key`.
+///
+/// The cache is only an optimization, so failures are ignored. Each file is
+/// written to a temporary file first, and the `.cc` file, which is read second,
+/// is renamed into place last, so that concurrent readers never see a partial
+/// entry.
+fn write_cached_bindings(cache_dir: &Path, key: &str, bindings: &Bindings) {
+    if std::fs::create_dir_all(cache_dir).is_err() {
+        return;
+    }
+    for (extension, contents) in [("rs", &bindings.rs_api), ("cc", &bindings.rs_api_impl)] {
+        let path = cache_dir.join(format!("{key}.{extension}"));
+        let tmp_path = path.with_extension(format!("{extension}.tmp{}", process::id()));
+        if std::fs::write(&tmp_path, contents).is_err()
+            || std::fs::rename(&tmp_path, &path).is_err()
+        {
+            let _ = std::fs::remove_file(&tmp_path);
+            return;
+        }
+    }
+}
+
 fn generate_bindings(
     json: &[u8],
     crubit_support_path_format: &str,
@@ -161,26 +314,79 @@ fn generate_bindings(
     rustfmt_config_path: &OsStr,
     errors: Rc<dyn ErrorReporting>,
     generate_source_loc_doc_comment: SourceLocationDocComment,
+    rs_api_impl_shards: usize,
+    skip_formatting: bool,
+    compact_layout_assertions: bool,
+    inline_always_forwarding_only: bool,
+    minimal_rs_api_impl_includes: bool,
+    rust_enums: bool,
+    cache_dir: Option<&Path>,
+    bloat_report: Option<&mut BloatReport>,
 ) -> Result<Bindings> {
-    let ir = Rc::new(deserialize_ir(json)?);
+    let cache = cache_dir.and_then(|cache_dir| {
+        let key = bindings_cache_key(
+            json,
+            crubit_support_path_format,
+            clang_format_exe_path,
+            rustfmt_exe_path,
+            rustfmt_config_path,
+            generate_source_loc_doc_comment,
+            rs_api_impl_shards,
+            skip_formatting,
+            compact_layout_assertions,
+            inline_always_forwarding_only,
+            minimal_rs_api_impl_includes,
+            rust_enums,
+        )?;
+        Some((cache_dir, key))
+    });
+    if let Some((cache_dir, key)) = &cache {
+        let _span = time_trace::scope("ReadCachedBindings");
+        if let Some(bindings) = read_cached_bindings(cache_dir, key) {
+            return Ok(bindings);
+        }
+    }
 
-    let BindingsTokens { rs_api, rs_api_impl } = generate_bindings_tokens(
-        ir.clone(),
-        crubit_support_path_format,
-        errors,
-        generate_source_loc_doc_comment,
-    )?;
-    let rs_api = {
-        let rustfmt_exe_path = Path::new(rustfmt_exe_path);
-        let rustfmt_config_path = if rustfmt_config_path.is_empty() {
-            None
-        } else {
-            Some(Path::new(rustfmt_config_path))
+    let ir = {
+        let _span = time_trace::scope("DeserializeIr");
+        Rc::new(deserialize_ir(json)?)
+    };
+
+    let BindingsTokens { rs_api, rs_api_impl } = {
+        let _span = time_trace::scope("GenerateBindingsTokens");
+        generate_bindings_tokens(
+            ir.clone(),
+            crubit_support_path_format,
+            errors,
+            generate_source_loc_doc_comment,
+            rs_api_impl_shards,
+            compact_layout_assertions,
+            inline_always_forwarding_only,
+            minimal_rs_api_impl_includes,
+            rust_enums,
+            bloat_report,
+        )?
+    };
+    let (rs_api, rs_api_impl) = if skip_formatting {
+        (tokens_to_unformatted_string(rs_api)?, tokens_to_unformatted_string(rs_api_impl)?)
+    } else {
+        let _span = time_trace::scope("FormatBindings");
+        let rustfmt_config = {
+            let rustfmt_exe_path = Path::new(rustfmt_exe_path);
+            let rustfmt_config_path = if rustfmt_config_path.is_empty() {
+                None
+            } else {
+                Some(Path::new(rustfmt_config_path))
+            };
+            RustfmtConfig::new(rustfmt_exe_path, rustfmt_config_path)
         };
-        let rustfmt_config = RustfmtConfig::new(rustfmt_exe_path, rustfmt_config_path);
-        rs_tokens_to_formatted_string(rs_api, &rustfmt_config)?
+        rs_and_cc_tokens_to_formatted_strings(
+            rs_api,
+            &rustfmt_config,
+            rs_api_impl,
+            Path::new(clang_format_exe_path),
+        )?
     };
-    let rs_api_impl = cc_tokens_to_formatted_string(rs_api_impl, Path::new(clang_format_exe_path))?;
 
     // Add top-level comments that help identify where the generated bindings came
     // from.
@@ -231,7 +437,11 @@ fn generate_bindings(
         {rs_api_impl}"
     );
 
-    Ok(Bindings { rs_api, rs_api_impl })
+    let bindings = Bindings { rs_api, rs_api_impl };
+    if let Some((cache_dir, key)) = &cache {
+        write_cached_bindings(cache_dir, key, &bindings);
+    }
+    Ok(bindings)
 }
 
 fn generate_doc_comment(
@@ -268,6 +478,7 @@ fn generate_enum(db: &Database, enum_: &Enum) -> Result<GeneratedItem> {
             ),
         );
     };
+    let rust_enum = generate_rust_enum(db, enum_, &name, &underlying_type, enumerators);
     let enumerators = enumerators.iter().map(|enumerator| {
         if let Some(unknown_attr) = &enumerator.unknown_attr {
             let comment = format!(
@@ -312,10 +523,135 @@ fn generate_enum(db: &Database, enum_: &Enum) -> Result<GeneratedItem> {
                 value.0
             }
         }
+        #rust_enum
     };
     Ok(item.into())
 }
 
+/// Returns the primitive type that a Rust enum with the representation of
+/// `primitive` is `#[repr]`, and whether it is signed, or `None` if `primitive`
+/// isn't an integer type.
+///
+/// The C integer types are mapped according to LP64, which is what Crubit
+/// supports; on other platforms the `transmute` in `generate_rust_enum` would
+/// fail to compile.
+fn enum_repr(primitive: PrimitiveType) -> Option<(Ident, bool)> {
+    let (repr, is_signed) = match primitive {
+        PrimitiveType::u8 | PrimitiveType::c_uchar => ("u8", false),
+        PrimitiveType::i8 | PrimitiveType::c_schar => ("i8", true),
+        PrimitiveType::u16 | PrimitiveType::c_ushort => ("u16", false),
+        PrimitiveType::i16 | PrimitiveType::c_short => ("i16", true),
+        PrimitiveType::u32 | PrimitiveType::c_uint => ("u32", false),
+        PrimitiveType::i32 | PrimitiveType::c_int => ("i32", true),
+        PrimitiveType::u64 | PrimitiveType::c_ulong | PrimitiveType::c_ulonglong => ("u64", false),
+        PrimitiveType::i64 | PrimitiveType::c_long | PrimitiveType::c_longlong => ("i64", true),
+        PrimitiveType::usize => ("usize", false),
+        PrimitiveType::isize => ("isize", true),
+        PrimitiveType::Unit | PrimitiveType::bool | PrimitiveType::f32 | PrimitiveType::f64 => {
+            return None
+        }
+    };
+    Some((make_rs_ident(repr), is_signed))
+}
+
+/// Generates a `#[repr]` Rust enum `<Name>Enum` of the enumerators of `enum_`,
+/// and the conversions between it and the newtype `name`, if
+/// `db.rust_enums()` and the values of the enumerators are contiguous.
+///
+/// The newtype remains the type of the enum in the bindings, because C++ may
+/// store any value of the underlying type in it, which would be UB in a Rust
+/// enum. But with contiguous values, `to_enum` only takes a single range check,
+/// after which Rust code can `match` on the enum exhaustively.
+fn generate_rust_enum(
+    db: &Database,
+    enum_: &Enum,
+    name: &Ident,
+    underlying_type: &RsTypeKind,
+    enumerators: &[Enumerator],
+) -> Option<TokenStream> {
+    if !db.rust_enums() || enumerators.iter().any(|e| e.unknown_attr.is_some()) {
+        return None;
+    }
+    let RsTypeKind::Primitive(primitive) = underlying_type.unalias() else {
+        return None;
+    };
+    let (repr, is_signed) = enum_repr(*primitive)?;
+    // Discriminants must be unique, so enumerators with the value of an earlier
+    // one are left to the newtype's constants.
+    let mut seen_values = HashSet::new();
+    let variants: Vec<(Ident, i128)> = enumerators
+        .iter()
+        .filter_map(|enumerator| {
+            let value = if enumerator.value.is_negative {
+                enumerator.value.wrapped_value as i64 as i128
+            } else {
+                enumerator.value.wrapped_value as i128
+            };
+            seen_values
+                .insert(value)
+                .then(|| (make_rs_ident(&enumerator.identifier.identifier), value))
+        })
+        .collect();
+    // An enum without variants can't have a `#[repr]`.
+    let min = variants.iter().map(|(_, value)| *value).min()?;
+    let max = variants.iter().map(|(_, value)| *value).max()?;
+    if max - min + 1 != variants.len() as i128 {
+        return None;
+    }
+
+    let enum_name = make_rs_ident(&format!("{}Enum", enum_.identifier.identifier));
+    let variants = variants.iter().map(|(ident, value)| {
+        let value = Literal::i128_unsuffixed(*value);
+        quote! { #ident = #value }
+    });
+    let max = Literal::i128_unsuffixed(max);
+    // `0 <= self.0` would trip `unused_comparisons` for unsigned types.
+    let in_range = if min == 0 && !is_signed {
+        quote! { self.0 <= #max }
+    } else {
+        let min = Literal::i128_unsuffixed(min);
+        quote! { #min <= self.0 && self.0 <= #max }
+    };
+    let doc_comment = format!(
+        " The enumerators of `{name}`, see `{name}::to_enum`.",
+        name = enum_.identifier.identifier
+    );
+    Some(quote! {
+        #[doc = #doc_comment]
+        #[repr(#repr)]
+        #[derive(Debug, PartialEq, Eq, Copy, Clone, Hash, PartialOrd, Ord)]
+        pub enum #enum_name {
+            #(#variants),*
+        }
+        impl #name {
+            #[doc = " Returns the enumerator that `self` is, or `None` if it is another value of"]
+            #[doc = " the underlying type."]
+            #[inline(always)]
+            pub const fn to_enum(self) -> Option<#enum_name> {
+                if #in_range {
+                    Some(unsafe { self.to_enum_unchecked() })
+                } else {
+                    None
+                }
+            }
+            #[doc = " Returns the enumerator that `self` is, without checking that it is one."]
+            #[doc = ""]
+            #[doc = " # Safety"]
+            #[doc = ""]
+            #[doc = " `self` must be one of the enumerators, i.e. `self.to_enum()` is not `None`."]
+            #[inline(always)]
+            pub const unsafe fn to_enum_unchecked(self) -> #enum_name {
+                unsafe { ::core::mem::transmute::<#underlying_type, #enum_name>(self.0) }
+            }
+        }
+        impl From<#enum_name> for #name {
+            fn from(value: #enum_name) -> #name {
+                #name(value as #underlying_type)
+            }
+        }
+    })
+}
+
 fn generate_type_alias(db: &Database, type_alias: &TypeAlias) -> Result<GeneratedItem> {
     let ident = make_rs_ident(&type_alias.identifier.identifier);
     let doc_comment = generate_doc_comment(
@@ -338,6 +674,10 @@ fn generate_unsupported(db: &Database, item: &UnsupportedItem) -> Result<Generat
     for error in &item.errors {
         db.errors().insert(&error.to_error());
     }
+    // Lean items (see `--unsupported_item_comments`) have no name nor messages to comment with.
+    if item.name.is_empty() {
+        return Ok(GeneratedItem::default());
+    }
 
     let source_loc = item.source_loc();
     let source_loc = match &source_loc {
@@ -370,6 +710,7 @@ fn generate_namespace(db: &Database, namespace: &Namespace) -> Result<GeneratedI
     let mut thunks = vec![];
     let mut thunk_impls = vec![];
     let mut assertions = vec![];
+    let mut layout_checks = LayoutChecks::default();
     let mut features = BTreeSet::new();
 
     for item_id in namespace.child_item_ids.iter() {
@@ -387,6 +728,7 @@ fn generate_namespace(db: &Database, namespace: &Namespace) -> Result<GeneratedI
         if !generated.assertions.is_empty() {
             assertions.push(generated.assertions);
         }
+        layout_checks.extend(&generated.layout_checks);
         features.extend(generated.features);
     }
 
@@ -446,6 +788,7 @@ fn generate_namespace(db: &Database, namespace: &Namespace) -> Result<GeneratedI
         thunks: quote! { #( #thunks )* },
         thunk_impls: quote! { #( #thunk_impls )* },
         assertions: quote! { #( #assertions )* },
+        layout_checks,
         ..Default::default()
     })
 }
@@ -457,9 +800,64 @@ struct GeneratedItem {
     // C++ source code for helper functions.
     thunk_impls: TokenStream,
     assertions: TokenStream,
+    // Checked in a table with those of all other items, rather than in
+    // `assertions` / `thunk_impls`, if `compact_layout_assertions` is set.
+    layout_checks: LayoutChecks,
     features: BTreeSet<Ident>,
 }
 
+/// Layout values (sizes, alignments and field offsets) that the bindings
+/// check, each as a constant expression and the value that it must have.
+///
+/// By default, each check is its own assertion next to the item it is about.
+/// With `compact_layout_assertions`, the checks of all items are instead
+/// gathered here and emitted as a single table comparison in each of
+/// `rs_api` and `rs_api_impl`, which is much cheaper to compile than thousands
+/// of assertions, but doesn't say which record a failed check is about.
+#[derive(Clone, Debug, Default)]
+struct LayoutChecks {
+    // `usize` constant expressions in Rust.
+    rs: Vec<(TokenStream, Literal)>,
+    // `size_t` constant expressions in C++.
+    cc: Vec<(TokenStream, Literal)>,
+}
+
+impl LayoutChecks {
+    fn extend(&mut self, other: &LayoutChecks) {
+        self.rs.extend(other.rs.iter().cloned());
+        self.cc.extend(other.cc.iter().cloned());
+    }
+
+    /// Returns Rust statements that check all of `self.rs`, for the
+    /// `const _: () = { ... };` of the assertions. `self.rs` must not be empty.
+    fn rs_table(&self) -> TokenStream {
+        let len = Literal::usize_unsuffixed(self.rs.len());
+        let (actual, expected): (Vec<_>, Vec<_>) = self.rs.iter().cloned().unzip();
+        quote! {
+            const ACTUAL_LAYOUT: [usize; #len] = [ #( #actual ),* ];
+            const EXPECTED_LAYOUT: [usize; #len] = [ #( #expected ),* ];
+            let mut i = 0;
+            while i < #len {
+                assert!(ACTUAL_LAYOUT[i] == EXPECTED_LAYOUT[i]);
+                i += 1;
+            }
+        }
+    }
+
+    /// Returns C++ declarations that check all of `self.cc`, using
+    /// `support/internal/layout_checks.h`. `self.cc` must not be empty.
+    fn cc_table(&self) -> TokenStream {
+        let len = Literal::usize_unsuffixed(self.cc.len());
+        let (actual, expected): (Vec<_>, Vec<_>) = self.cc.iter().cloned().unzip();
+        quote! {
+            constexpr std::size_t kCrubitActualLayout[] = { #( #actual ),* };
+            constexpr std::size_t kCrubitExpectedLayout[] = { #( #expected ),* };
+            static_assert(
+                crubit::FirstLayoutMismatch(kCrubitActualLayout, kCrubitExpectedLayout) == #len);
+        }
+    }
+}
+
 impl From<TokenStream> for GeneratedItem {
     fn from(item: TokenStream) -> Self {
         GeneratedItem { item, ..Default::default() }
@@ -497,13 +895,14 @@ fn generate_item_impl(db: &Database, item: &Item) -> Result<GeneratedItem> {
     let generated_item = match item {
         Item::Func(func) => match db.generate_func(func.clone())? {
             None => GeneratedItem::default(),
-            Some((item, function_id)) => {
-                if overloaded_funcs.contains(&function_id) {
-                    bail!("Cannot generate bindings for overloaded function")
-                } else {
-                    (*item).clone()
+            Some((item, function_id)) => match overloaded_funcs.get(&function_id) {
+                None => (*item).clone(),
+                Some(None) => bail!("Cannot generate bindings for overloaded function"),
+                Some(Some(first_overload)) => {
+                    let is_first = first_overload == func;
+                    (*generate_func_overload(db, func.clone(), is_first)?).clone()
                 }
-            }
+            },
         },
         Item::IncompleteRecord(incomplete_record) => {
             generate_incomplete_record(db, incomplete_record)?
@@ -535,10 +934,14 @@ fn generate_item_impl(db: &Database, item: &Item) -> Result<GeneratedItem> {
                     an existing Rust type ({rs_type})",
                 cc_type = type_override.debug_name(&ir),
             );
-            let assertions = if let Some(size_align) = &type_override.size_align {
-                generate_record::rs_size_align_assertions(rs_type, size_align)
-            } else {
+            let mut layout_checks = LayoutChecks::default();
+            if let Some(size_align) = &type_override.size_align {
+                layout_checks.rs = generate_record::rs_size_align_checks(rs_type, size_align);
+            }
+            let assertions = if db.compact_layout_assertions() {
                 quote! {}
+            } else {
+                generate_record::rs_layout_assertions(&std::mem::take(&mut layout_checks.rs))
             };
 
             GeneratedItem {
@@ -546,6 +949,7 @@ fn generate_item_impl(db: &Database, item: &Item) -> Result<GeneratedItem> {
                     __COMMENT__ #disable_comment
                 },
                 assertions,
+                layout_checks,
                 ..Default::default()
             }
         }
@@ -756,11 +1160,10 @@ fn required_crubit_features(
         };
 
     let require_rs_type_kind = |missing_features: &mut Vec<RequiredCrubitFeature>,
-                                rs_type_kind: &RsTypeKind,
+                                requirements: &CrubitFeatureRequirements,
                                 context: &dyn Fn() -> Rc<str>| {
         for target in item.defining_target().into_iter().chain(item.owning_target()) {
-            let (missing, desc) =
-                rs_type_kind.required_crubit_features(ir.target_crubit_features(target));
+            let (missing, desc) = requirements.missing_features(ir.target_crubit_features(target));
             if !missing.is_empty() {
                 let context = context();
                 let capability_description = if desc.is_empty() {
@@ -798,10 +1201,11 @@ fn required_crubit_features(
                     &|| "destructors".into(),
                 );
             } else {
-                let return_type = db.rs_type_kind(func.return_type.rs_type.clone())?;
+                let return_type =
+                    db.crubit_feature_requirements(func.return_type.rs_type.clone())?;
                 require_rs_type_kind(&mut missing_features, &return_type, &|| "return type".into());
                 for (i, param) in func.params.iter().enumerate() {
-                    let param_type = db.rs_type_kind(param.type_.rs_type.clone())?;
+                    let param_type = db.crubit_feature_requirements(param.type_.rs_type.clone())?;
                     require_rs_type_kind(&mut missing_features, &param_type, &|| {
                         format!("the type of {} (parameter #{i})", &param.identifier).into()
                     });
@@ -847,6 +1251,13 @@ fn required_crubit_features(
                         &|| "[[deprecated]] attribute".into(),
                     );
                 }
+                if func.is_batched {
+                    require_any_feature(
+                        &mut missing_features,
+                        ir::CrubitFeature::Experimental.into(),
+                        &|| "crubit_internal_batch attribute".into(),
+                    );
+                }
                 for param in &func.params {
                     if let Some(unknown_attr) = &param.unknown_attr {
                         require_any_feature(
@@ -867,21 +1278,21 @@ fn required_crubit_features(
         Item::Record(record) => {
             require_rs_type_kind(
                 &mut missing_features,
-                &RsTypeKind::new_record(record.clone(), &db.ir())?,
+                &RsTypeKind::new_record(record.clone(), &db.ir())?.crubit_feature_requirements(),
                 &|| "".into(),
             );
         }
         Item::TypeAlias(alias) => {
             require_rs_type_kind(
                 &mut missing_features,
-                &new_type_alias(db, alias.clone())?,
+                &new_type_alias(db, alias.clone())?.crubit_feature_requirements(),
                 &|| "".into(),
             );
         }
         Item::Enum(e) => {
             require_rs_type_kind(
                 &mut missing_features,
-                &RsTypeKind::new_enum(e.clone(), &db.ir())?,
+                &RsTypeKind::new_enum(e.clone(), &db.ir())?.crubit_feature_requirements(),
                 &|| "".into(),
             );
         }
@@ -892,12 +1303,16 @@ fn required_crubit_features(
                 &|| "namespace".into(),
             );
         }
-        Item::IncompleteRecord(_) => {
-            require_any_feature(
-                &mut missing_features,
-                ir::CrubitFeature::Experimental.into(),
-                &|| "incomplete type".into(),
-            );
+        Item::IncompleteRecord(incomplete_record) => {
+            // A record that a dependency defines is the complete type of its bindings.
+            let required_feature = if incomplete_record.is_complete_in_dependency {
+                ir::CrubitFeature::Supported
+            } else {
+                ir::CrubitFeature::Experimental
+            };
+            require_any_feature(&mut missing_features, required_feature.into(), &|| {
+                "incomplete type".into()
+            });
         }
         Item::Comment { .. } | Item::UseMod { .. } => {}
         Item::TypeMapOverride { .. } => {
@@ -911,6 +1326,32 @@ fn required_crubit_features(
     Ok(missing_features)
 }
 
+/// Measures the code generated for a top-level `item`, for the bloat report.
+/// The thunks are the functions declared in `generated.thunks`; the layout
+/// checks of `generated` count as assertions.
+fn measure_item(ir: &IR, item: &Item, generated: &GeneratedItem) -> ItemBloat {
+    let mut rs = TokenCounts::of(&generated.item);
+    let thunks = TokenCounts::of(&generated.thunks);
+    rs += thunks;
+    rs += TokenCounts::of(&generated.assertions);
+    let mut cc = TokenCounts::of(&generated.thunk_impls);
+    let layout_checks = &generated.layout_checks;
+    rs.static_asserts += layout_checks.rs.len() as u64;
+    cc.static_asserts += layout_checks.cc.len() as u64;
+    ItemBloat::new(
+        item.debug_name(ir).to_string(),
+        item.source_loc().map(|source_loc| source_loc.to_string()),
+        rs,
+        cc,
+        thunks.fns,
+    )
+}
+
+/// The comment line that separates the shards of `rs_api_impl` when more than
+/// one is requested. `SplitRsApiImplShards` in `src_code_gen.cc` splits the
+/// formatted output on it.
+const RS_API_IMPL_SHARD_SEPARATOR: &str = "crubit:rs_api_impl_shard";
+
 // Returns the Rust code implementing bindings, plus any auxiliary C++ code
 // needed to support it.
 fn generate_bindings_tokens(
@@ -918,11 +1359,25 @@ fn generate_bindings_tokens(
     crubit_support_path_format: &str,
     errors: Rc<dyn ErrorReporting>,
     generate_source_loc_doc_comment: SourceLocationDocComment,
+    rs_api_impl_shards: usize,
+    compact_layout_assertions: bool,
+    inline_always_forwarding_only: bool,
+    minimal_rs_api_impl_includes: bool,
+    rust_enums: bool,
+    mut bloat_report: Option<&mut BloatReport>,
 ) -> Result<BindingsTokens> {
-    let db = Database::new(ir.clone(), errors, generate_source_loc_doc_comment);
+    let db = Database::new(
+        ir.clone(),
+        errors,
+        generate_source_loc_doc_comment,
+        compact_layout_assertions,
+        inline_always_forwarding_only,
+        minimal_rs_api_impl_includes,
+        rust_enums,
+    );
     let mut items = vec![];
     let mut thunks = vec![];
-    let mut thunk_impls = vec![
+    let thunk_impls_prelude = [
         generate_rs_api_impl_includes(&db, crubit_support_path_format)?,
         quote! {
             __HASH_TOKEN__ pragma clang diagnostic push __NEWLINE__
@@ -931,7 +1386,9 @@ fn generate_bindings_tokens(
             __HASH_TOKEN__ pragma clang diagnostic ignored "-Wthread-safety-analysis" __NEWLINE__
         },
     ];
+    let mut thunk_impls = vec![];
     let mut assertions = vec![];
+    let mut layout_checks = LayoutChecks::default();
 
     let mut features = BTreeSet::new();
 
@@ -942,6 +1399,9 @@ fn generate_bindings_tokens(
         let item =
             ir.find_decl(*top_level_item_id).context("Failed to look up ir.top_level_item_ids")?;
         let generated = generate_item(&db, item)?;
+        if let Some(bloat_report) = bloat_report.as_deref_mut() {
+            bloat_report.add(measure_item(&ir, item, &generated));
+        }
         items.push(generated.item);
         if !generated.thunks.is_empty() {
             thunks.push(generated.thunks);
@@ -952,15 +1412,52 @@ fn generate_bindings_tokens(
         if !generated.thunk_impls.is_empty() {
             thunk_impls.push(generated.thunk_impls);
         }
+        layout_checks.extend(&generated.layout_checks);
         features.extend(generated.features);
     }
 
-    thunk_impls.push(quote! {
+    memoized::print_query_stats_if_requested(&db.query_stats());
+    if let Some(bloat_report) = bloat_report {
+        bloat_report.target = ir.current_target().0.to_string();
+    }
+
+    // The layout checks of all records go into the last shard of
+    // `rs_api_impl`, and after all other assertions in `rs_api`.
+    if !layout_checks.cc.is_empty() {
+        thunk_impls.push(layout_checks.cc_table());
+    }
+    if !layout_checks.rs.is_empty() {
+        assertions.push(layout_checks.rs_table());
+    }
+
+    let thunk_impls_postlude = quote! {
         __NEWLINE__
         __HASH_TOKEN__ pragma clang diagnostic pop __NEWLINE__
         // To satisfy http://cs/symbol:devtools.metadata.Presubmit.CheckTerminatingNewline check.
         __NEWLINE__
-    });
+    };
+    // Each shard of `rs_api_impl` is a complete source file with a contiguous
+    // range of the thunk implementations, so that the shards can be compiled
+    // in parallel. Shards are ended by a separator comment, except for the
+    // last one, so that a single shard is the same as no sharding.
+    let rs_api_impl_shards = rs_api_impl_shards.max(1);
+    let shard_size = thunk_impls.len().div_ceil(rs_api_impl_shards);
+    let rs_api_impl = (0..rs_api_impl_shards)
+        .map(|shard| {
+            let begin = (shard * shard_size).min(thunk_impls.len());
+            let end = (begin + shard_size).min(thunk_impls.len());
+            let shard_thunk_impls = thunk_impls_prelude
+                .iter()
+                .chain(&thunk_impls[begin..end])
+                .chain(std::iter::once(&thunk_impls_postlude));
+            let separator = if shard + 1 < rs_api_impl_shards {
+                quote! { __COMMENT__ #RS_API_IMPL_SHARD_SEPARATOR }
+            } else {
+                quote! {}
+            };
+            quote! { #(#shard_thunk_impls  __NEWLINE__ __NEWLINE__ )* #separator }
+        })
+        .collect::<TokenStream>();
 
     let mod_detail = if thunks.is_empty() {
         quote! {}
@@ -1035,7 +1532,7 @@ fn generate_bindings_tokens(
 
             #assertions
         },
-        rs_api_impl: quote! {#(#thunk_impls  __NEWLINE__ __NEWLINE__ )*},
+        rs_api_impl,
     })
 }
 
@@ -1044,6 +1541,13 @@ fn format_cc_ident(ident: &str) -> TokenStream {
     code_gen_utils::format_cc_ident(ident).expect("IR should only contain valid C++ identifiers")
 }
 
+fn crubit_feature_requirements(
+    db: &dyn BindingsGenerator,
+    rs_type: RsType,
+) -> Result<Rc<CrubitFeatureRequirements>> {
+    Ok(Rc::new(db.rs_type_kind(rs_type)?.crubit_feature_requirements()))
+}
+
 fn rs_type_kind(db: &dyn BindingsGenerator, ty: ir::RsType) -> Result<RsTypeKind> {
     if let Some(unknown_attr) = &ty.unknown_attr {
         // In most places, we only bail for unknown attributes in supported. However,
@@ -1159,6 +1663,12 @@ fn rs_type_kind(db: &dyn BindingsGenerator, ty: ir::RsType) -> Result<RsTypeKind
                 mutability: Mutability::Const,
                 lifetime: get_lifetime()?,
             },
+            "#UniquePtr" => {
+                RsTypeKind::UniquePtr { pointee: get_pointee()?, is_trivial_abi: false }
+            }
+            "#UniquePtr trivial_abi" => {
+                RsTypeKind::UniquePtr { pointee: get_pointee()?, is_trivial_abi: true }
+            }
             "Option" => {
                 let mut type_args = get_type_args()?;
                 ensure!(
@@ -1394,12 +1904,22 @@ fn generate_rs_api_impl_includes(
 
     let mut internal_includes = BTreeSet::new();
     internal_includes.insert(CcInclude::memory()); // ubiquitous.
+    // Batch thunks take the number of elements as a `size_t`.
+    if ir.functions().any(|func| func.is_batched) {
+        internal_includes.insert(CcInclude::cstddef());
+    }
     if ir.records().next().is_some() {
         internal_includes.insert(CcInclude::cstddef());
         internal_includes.insert(CcInclude::SupportLibHeader(
             crubit_support_path_format.into(),
             "internal/sizeof.h".into(),
         ));
+        if db.compact_layout_assertions() {
+            internal_includes.insert(CcInclude::SupportLibHeader(
+                crubit_support_path_format.into(),
+                "internal/layout_checks.h".into(),
+            ));
+        }
     };
     for crubit_header in ["internal/cxx20_backports.h", "internal/offsetof.h"] {
         internal_includes.insert(CcInclude::SupportLibHeader(
@@ -1414,8 +1934,13 @@ fn generate_rs_api_impl_includes(
     // process these includes via `format_cc_includes` to preserve their
     // original order (some libraries require certain headers to be included
     // first - e.g. `config.h`).
-    let ir_includes =
-        ir.public_headers().map(|hdr| CcInclude::user_header(hdr.name.clone())).collect_vec();
+    let needed_headers =
+        if db.minimal_rs_api_impl_includes() { public_headers_for_rs_api_impl(db) } else { None };
+    let ir_includes = ir
+        .public_headers()
+        .filter(|hdr| needed_headers.as_ref().map_or(true, |needed| needed.contains(&hdr.name)))
+        .map(|hdr| CcInclude::user_header(hdr.name.clone()))
+        .collect_vec();
 
     Ok(quote! {
         #internal_includes
@@ -1425,6 +1950,35 @@ fn generate_rs_api_impl_includes(
     })
 }
 
+/// Returns the public headers that declare what `rs_api_impl` refers to: the
+/// records of the current target (for their layout assertions) and the
+/// functions that need a C++ thunk. Enums, type aliases and functions called
+/// directly through their symbol need no header.
+///
+/// Returns `None` if some of these items don't know their public header (e.g.
+/// template instantiations), in which case all the public headers are needed.
+fn public_headers_for_rs_api_impl(db: &Database) -> Option<HashSet<Rc<str>>> {
+    let ir = db.ir();
+    let mut headers = HashSet::new();
+    for record in ir.records() {
+        if ir.is_current_target(&record.owning_target) {
+            headers.insert(record.public_header.as_ref()?.name.clone());
+        }
+    }
+    for func in ir.functions() {
+        if !ir.is_current_target(&func.owning_target) {
+            continue;
+        }
+        let Ok(Some((generated_func, _))) = db.generate_func(func.clone()) else {
+            continue;
+        };
+        if !generated_func.thunk_impls.is_empty() {
+            headers.insert(func.public_header.as_ref()?.name.clone());
+        }
+    }
+    Some(headers)
+}
+
 #[cfg(test)]
 pub(crate) mod tests {
     use super::*;
@@ -1455,6 +2009,12 @@ pub(crate) mod tests {
             "crubit/rs_bindings_support",
             Rc::new(IgnoreErrors),
             SourceLocationDocComment::Enabled,
+            /* rs_api_impl_shards= */ 1,
+            /* compact_layout_assertions= */ false,
+            /* inline_always_forwarding_only= */ false,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
+            /* bloat_report= */ None,
         )
     }
 
@@ -1463,9 +2023,84 @@ pub(crate) mod tests {
             Rc::new(ir_from_cc(cc_src)?),
             Rc::new(ErrorReport::new()),
             SourceLocationDocComment::Enabled,
+            /* compact_layout_assertions= */ false,
+            /* inline_always_forwarding_only= */ false,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
         ))
     }
 
+    #[test]
+    fn test_bindings_cache() -> Result<()> {
+        let cache_dir = tempfile::tempdir()?;
+        let exe = std::env::current_exe()?;
+        let key = |json: &[u8],
+                   generate_source_loc_doc_comment,
+                   skip_formatting,
+                   compact_layout_assertions,
+                   inline_always_forwarding_only,
+                   minimal_rs_api_impl_includes,
+                   rust_enums| {
+            bindings_cache_key(
+                json,
+                "crubit/rs_bindings_support",
+                exe.as_os_str(),
+                exe.as_os_str(),
+                OsStr::new(""),
+                generate_source_loc_doc_comment,
+                /* rs_api_impl_shards= */ 1,
+                skip_formatting,
+                compact_layout_assertions,
+                inline_always_forwarding_only,
+                minimal_rs_api_impl_includes,
+                rust_enums,
+            )
+            .unwrap()
+        };
+        let key_a =
+            key(b"{}", SourceLocationDocComment::Enabled, false, false, false, false, false);
+        assert_ne!(
+            key_a,
+            key(b"{ }", SourceLocationDocComment::Enabled, false, false, false, false, false)
+        );
+        assert_ne!(
+            key_a,
+            key(b"{}", SourceLocationDocComment::Disabled, false, false, false, false, false)
+        );
+        assert_ne!(
+            key_a,
+            key(b"{}", SourceLocationDocComment::Enabled, true, false, false, false, false)
+        );
+        assert_ne!(
+            key_a,
+            key(b"{}", SourceLocationDocComment::Enabled, false, true, false, false, false)
+        );
+        assert_ne!(
+            key_a,
+            key(b"{}", SourceLocationDocComment::Enabled, false, false, true, false, false)
+        );
+        assert_ne!(
+            key_a,
+            key(b"{}", SourceLocationDocComment::Enabled, false, false, false, true, false)
+        );
+        assert_ne!(
+            key_a,
+            key(b"{}", SourceLocationDocComment::Enabled, false, false, false, false, true)
+        );
+
+        assert!(read_cached_bindings(cache_dir.path(), &key_a).is_none());
+        write_cached_bindings(
+            cache_dir.path(),
+            &key_a,
+            &Bindings { rs_api: "rs".to_string(), rs_api_impl: "cc".to_string() },
+        );
+        let Bindings { rs_api, rs_api_impl } =
+            read_cached_bindings(cache_dir.path(), &key_a).unwrap();
+        assert_eq!(rs_api, "rs");
+        assert_eq!(rs_api_impl, "cc");
+        Ok(())
+    }
+
     #[test]
     fn test_disable_thread_safety_warnings() -> Result<()> {
         let ir = ir_from_cc("inline void foo() {}")?;
@@ -1485,6 +2120,184 @@ pub(crate) mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_compact_layout_assertions() -> Result<()> {
+        let ir = ir_from_cc("struct SomeStruct final { int first; int second; };")?;
+        let BindingsTokens { rs_api, rs_api_impl } = super::generate_bindings_tokens(
+            Rc::new(ir),
+            "crubit/rs_bindings_support",
+            Rc::new(IgnoreErrors),
+            SourceLocationDocComment::Enabled,
+            /* rs_api_impl_shards= */ 1,
+            /* compact_layout_assertions= */ true,
+            /* inline_always_forwarding_only= */ false,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
+            /* bloat_report= */ None,
+        )?;
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                const ACTUAL_LAYOUT: [usize; 4] = [
+                    ::core::mem::size_of::<crate::SomeStruct>(),
+                    ::core::mem::align_of::<crate::SomeStruct>(),
+                    ::core::mem::offset_of!(crate::SomeStruct, first),
+                    ::core::mem::offset_of!(crate::SomeStruct, second)
+                ];
+                const EXPECTED_LAYOUT: [usize; 4] = [8, 4, 0, 4];
+                let mut i = 0;
+                while i < 4 {
+                    assert!(ACTUAL_LAYOUT[i] == EXPECTED_LAYOUT[i]);
+                    i += 1;
+                }
+            }
+        );
+        assert_rs_not_matches!(
+            rs_api,
+            quote! { assert!(::core::mem::size_of::<crate::SomeStruct>() == 8) }
+        );
+        assert_cc_matches!(
+            rs_api_impl,
+            quote! {
+                constexpr std::size_t kCrubitActualLayout[] = {
+                    CRUBIT_SIZEOF(struct SomeStruct),
+                    alignof(struct SomeStruct),
+                    CRUBIT_OFFSET_OF(first, struct SomeStruct),
+                    CRUBIT_OFFSET_OF(second, struct SomeStruct)
+                };
+                constexpr std::size_t kCrubitExpectedLayout[] = {8, 4, 0, 4};
+                static_assert(
+                    crubit::FirstLayoutMismatch(kCrubitActualLayout, kCrubitExpectedLayout) == 4);
+            }
+        );
+        assert_cc_not_matches!(
+            rs_api_impl,
+            quote! { static_assert(CRUBIT_SIZEOF(struct SomeStruct) == 8) }
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn test_inline_always_forwarding_only() -> Result<()> {
+        let ir = ir_from_cc(
+            "struct S final { int i; }; inline int Forward(int i); inline S Construct();",
+        )?;
+        let rs_api = super::generate_bindings_tokens(
+            Rc::new(ir),
+            "crubit/rs_bindings_support",
+            Rc::new(IgnoreErrors),
+            SourceLocationDocComment::Enabled,
+            /* rs_api_impl_shards= */ 1,
+            /* compact_layout_assertions= */ false,
+            /* inline_always_forwarding_only= */ true,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
+            /* bloat_report= */ None,
+        )?
+        .rs_api;
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                #[inline(always)]
+                pub fn Forward(i: ::core::ffi::c_int) -> ::core::ffi::c_int { ... }
+            }
+        );
+        assert_rs_matches!(
+            rs_api,
+            quote! {
+                #[inline]
+                pub fn Construct() -> crate::S { ... }
+            }
+        );
+        Ok(())
+    }
+
+    #[test]
+    fn test_bloat_report() -> Result<()> {
+        let ir = ir_from_cc("inline int f(int x) { return x; } struct S final { int x; };")?;
+        let mut bloat_report = BloatReport::default();
+        super::generate_bindings_tokens(
+            Rc::new(ir),
+            "crubit/rs_bindings_support",
+            Rc::new(IgnoreErrors),
+            SourceLocationDocComment::Enabled,
+            /* rs_api_impl_shards= */ 1,
+            /* compact_layout_assertions= */ false,
+            /* inline_always_forwarding_only= */ false,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
+            Some(&mut bloat_report),
+        )?;
+        assert_eq!(bloat_report.target, "//test:testing_target");
+        let item = |name: &str| bloat_report.items.iter().find(|item| item.name == name).unwrap();
+        // The API function and the declaration of its thunk, which is defined in C++.
+        let f = item("f");
+        assert_eq!(f.thunks, 1);
+        assert_eq!(f.estimated_symbols, 2);
+        assert!(f.rs_tokens > 0 && f.cc_tokens > 0);
+        let s = item("S");
+        assert!(s.static_asserts > 0);
+        Ok(())
+    }
+
+    #[test]
+    fn test_rs_api_impl_shards() -> Result<()> {
+        let ir = ir_from_cc("inline void foo() {} inline void bar() {}")?;
+        let rs_api_impl = super::generate_bindings_tokens(
+            Rc::new(ir),
+            "crubit/rs_bindings_support",
+            Rc::new(IgnoreErrors),
+            SourceLocationDocComment::Enabled,
+            /* rs_api_impl_shards= */ 2,
+            /* compact_layout_assertions= */ false,
+            /* inline_always_forwarding_only= */ false,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
+            /* bloat_report= */ None,
+        )?
+        .rs_api_impl
+        .to_string();
+        // Each shard is a complete source file with one of the thunks.
+        let shards: Vec<&str> = rs_api_impl.split(RS_API_IMPL_SHARD_SEPARATOR).collect();
+        assert_eq!(shards.len(), 2);
+        for shard in &shards {
+            assert_eq!(shard.matches("pragma clang diagnostic push").count(), 1);
+            assert_eq!(shard.matches("pragma clang diagnostic pop").count(), 1);
+        }
+        assert!(shards[0].contains("__rust_thunk___Z3foov"));
+        assert!(shards[1].contains("__rust_thunk___Z3barv"));
+        Ok(())
+    }
+
+    #[test]
+    fn test_minimal_rs_api_impl_includes() -> Result<()> {
+        let rs_api_impl = |cc: &str, minimal_rs_api_impl_includes| -> Result<String> {
+            Ok(super::generate_bindings_tokens(
+                Rc::new(ir_from_cc(cc)?),
+                "crubit/rs_bindings_support",
+                Rc::new(IgnoreErrors),
+                SourceLocationDocComment::Enabled,
+                /* rs_api_impl_shards= */ 1,
+                /* compact_layout_assertions= */ false,
+                /* inline_always_forwarding_only= */ false,
+                minimal_rs_api_impl_includes,
+                /* rust_enums= */ false,
+                /* bloat_report= */ None,
+            )?
+            .rs_api_impl
+            .to_string())
+        };
+        let header = "ir_from_cc_virtual_header.h";
+        // Enums and functions without a thunk don't need the header...
+        let no_thunks = "enum Color { kRed }; extern \"C\" void f(int);";
+        assert!(!rs_api_impl(no_thunks, true)?.contains(header));
+        assert!(rs_api_impl(no_thunks, false)?.contains(header));
+        // ...but layout assertions and thunks do.
+        assert!(rs_api_impl("struct S final {};", true)?.contains(header));
+        assert!(rs_api_impl("inline void g() {}", true)?.contains(header));
+        Ok(())
+    }
+
     // TODO(b/200067824): These should generate nested types.
     #[test]
     fn test_nested_type_definitions() -> Result<()> {
@@ -1908,6 +2721,85 @@ pub(crate) mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_generate_rust_enum() -> Result<()> {
+        let rs_api = |cc: &str| -> Result<TokenStream> {
+            Ok(super::generate_bindings_tokens(
+                Rc::new(ir_from_cc(cc)?),
+                "crubit/rs_bindings_support",
+                Rc::new(IgnoreErrors),
+                SourceLocationDocComment::Enabled,
+                /* rs_api_impl_shards= */ 1,
+                /* compact_layout_assertions= */ false,
+                /* inline_always_forwarding_only= */ false,
+                /* minimal_rs_api_impl_includes= */ false,
+                /* rust_enums= */ true,
+                /* bloat_report= */ None,
+            )?
+            .rs_api)
+        };
+        assert_rs_matches!(
+            rs_api("enum class Color { kRed = -1, kGreen, kBlue, kDefault = kGreen };")?,
+            quote! {
+                pub struct Color(::core::ffi::c_int);
+                ...
+                #[repr(i32)]
+                #[derive(Debug, PartialEq, Eq, Copy, Clone, Hash, PartialOrd, Ord)]
+                pub enum ColorEnum {
+                    kRed = -1,
+                    kGreen = 0,
+                    kBlue = 1
+                }
+                impl Color {
+                    ...
+                    pub const fn to_enum(self) -> Option<ColorEnum> {
+                        if -1 <= self.0 && self.0 <= 1 {
+                            Some(unsafe { self.to_enum_unchecked() })
+                        } else {
+                            None
+                        }
+                    }
+                    ...
+                    pub const unsafe fn to_enum_unchecked(self) -> ColorEnum {
+                        unsafe {
+                            ::core::mem::transmute::<::core::ffi::c_int, ColorEnum>(self.0)
+                        }
+                    }
+                }
+                impl From<ColorEnum> for Color {
+                    fn from(value: ColorEnum) -> Color {
+                        Color(value as ::core::ffi::c_int)
+                    }
+                }
+            }
+        );
+        // Unsigned values starting at 0 only need an upper bound.
+        assert_rs_matches!(
+            rs_api("enum Color : unsigned char { kRed, kGreen };")?,
+            quote! {
+                #[repr(u8)]
+                ...
+                pub const fn to_enum(self) -> Option<ColorEnum> {
+                    if self.0 <= 1 {
+                        ...
+                    }
+                    ...
+                }
+            }
+        );
+        // Non-contiguous values, bools, and enums without enumerators keep the
+        // newtype only.
+        assert_rs_not_matches!(rs_api("enum Color { kRed, kBlue = 2 };")?, quote! { ColorEnum });
+        assert_rs_not_matches!(rs_api("enum Color : bool { kNo, kYes };")?, quote! { ColorEnum });
+        assert_rs_not_matches!(rs_api("enum Color {};")?, quote! { ColorEnum });
+        // ...and so does everything without the option.
+        assert_rs_not_matches!(
+            generate_bindings_tokens(ir_from_cc("enum Color { kRed };")?)?.rs_api,
+            quote! { ColorEnum }
+        );
+        Ok(())
+    }
+
     #[test]
     fn test_generate_opaque_enum() -> Result<()> {
         let ir = ir_from_cc("enum Color : int;")?;
@@ -2906,6 +3798,10 @@ pub(crate) mod tests {
             Rc::new(make_ir_from_items([])),
             Rc::new(ErrorReport::new()),
             SourceLocationDocComment::Enabled,
+            /* compact_layout_assertions= */ false,
+            /* inline_always_forwarding_only= */ false,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
         );
         let actual = generate_unsupported(
             &db,
@@ -2929,6 +3825,10 @@ pub(crate) mod tests {
             Rc::new(make_ir_from_items([])),
             Rc::new(ErrorReport::new()),
             SourceLocationDocComment::Enabled,
+            /* compact_layout_assertions= */ false,
+            /* inline_always_forwarding_only= */ false,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
         );
         let actual = generate_unsupported(
             &db,
@@ -2949,6 +3849,10 @@ pub(crate) mod tests {
             Rc::new(make_ir_from_items([])),
             Rc::new(ErrorReport::new()),
             SourceLocationDocComment::Disabled,
+            /* compact_layout_assertions= */ false,
+            /* inline_always_forwarding_only= */ false,
+            /* minimal_rs_api_impl_includes= */ false,
+            /* rust_enums= */ false,
         );
         let actual = generate_unsupported(
             &db,
@@ -194,6 +194,50 @@ pub fn check_by_value(record: &Record) -> Result<()> {
     Ok(())
 }
 
+/// Returns true if the Rust struct generated for `record` has the same
+/// `extern "C"` ABI as the C++ type when passed by value.
+///
+/// This holds for records whose fields are all primitives (or raw pointers to
+/// primitives), and that C++ passes in registers (i.e. trivially relocatable
+/// ones, including `[[clang::trivial_abi]]` records with nontrivial special
+/// members). Their `#[repr(C)]` struct replicates every field with its
+/// original type, rather than an opaque blob of bytes (see
+/// docs/struct_layout). The access of the fields doesn't matter: private
+/// fields keep their types too, and only their visibility differs. The only
+/// other field is the zero-sized `__non_field_data` of non-aggregates, which
+/// doesn't take part in the ABI.
+pub fn is_record_c_abi_compatible_by_value(record: &Record) -> bool {
+    fn is_scalar(rs_type: &RsType) -> bool {
+        if rs_type.unknown_attr.is_some() {
+            return false;
+        }
+        match rs_type.name.as_deref() {
+            Some("*mut" | "*const") => {
+                rs_type.type_args.len() == 1
+                    && (rs_type.type_args[0].is_unit_type() || is_scalar(&rs_type.type_args[0]))
+            }
+            Some(name) => {
+                rs_type.type_args.is_empty()
+                    && !matches!(PrimitiveType::from_str(name), None | Some(PrimitiveType::Unit))
+            }
+            None => false,
+        }
+    }
+    record.is_unpin()
+        && !record.is_union()
+        && !record.is_derived_class
+        && !record.override_alignment
+        && record.unknown_attr.is_none()
+        && record.fields.first().is_some_and(|field| field.offset == 0)
+        && record.fields.iter().all(|field| {
+            field.size != 0
+                && !field.is_bitfield
+                && !field.is_no_unique_address
+                && field.unknown_attr.is_none()
+                && field.type_.as_ref().is_ok_and(|t| is_scalar(&t.rs_type))
+        })
+}
+
 #[allow(non_camel_case_types)]
 #[derive(Copy, Clone, Debug, PartialEq, Eq, Hash)]
 pub enum PrimitiveType {
@@ -333,6 +377,14 @@ pub enum RsTypeKind {
     Primitive(PrimitiveType),
     /// Nullable T, using the rust Option type.
     Option(Rc<RsTypeKind>),
+    /// `std::unique_ptr<T>` with the default deleter, as
+    /// `::cc_std::unique_ptr::UniquePtr<T>`.
+    UniquePtr {
+        pointee: Rc<RsTypeKind>,
+        /// Whether the `std::unique_ptr` is passed in registers, like a pointer
+        /// (e.g. with libc++'s `_LIBCPP_ABI_ENABLE_UNIQUE_PTR_TRIVIAL_ABI`).
+        is_trivial_abi: bool,
+    },
     Other {
         name: Rc<str>,
         type_args: Rc<[RsTypeKind]>,
@@ -367,6 +419,15 @@ impl RsTypeKind {
         }
     }
 
+    /// Returns the type that `self` is an alias of, looking through all type
+    /// aliases.
+    pub fn unalias(&self) -> &RsTypeKind {
+        match self {
+            RsTypeKind::TypeAlias { underlying_type, .. } => underlying_type.unalias(),
+            _ => self,
+        }
+    }
+
     /// Returns true if the type is known to be `Unpin`, false otherwise.
     pub fn is_unpin(&self) -> bool {
         match self {
@@ -382,7 +443,9 @@ impl RsTypeKind {
     /// In particular, anything representing a pointer with unknown lifetime is
     /// unsafe.
     pub fn is_unsafe(&self) -> bool {
-        // TODO(b/315346467): also include string_view, etc. here.
+        // Note that `std::string_view` is mapped to a pointer, `*const [u8]`, with
+        // `--string_view_as_slice_pointer`.
+        // TODO(b/315346467): also include other view types here.
         matches!(self, RsTypeKind::Pointer { .. })
     }
 
@@ -397,25 +460,29 @@ impl RsTypeKind {
         &self,
         enabled_features: flagset::FlagSet<ir::CrubitFeature>,
     ) -> (flagset::FlagSet<ir::CrubitFeature>, String) {
+        self.crubit_feature_requirements().missing_features(enabled_features)
+    }
+
+    /// Returns the features required to use this type, regardless of which
+    /// features are enabled.
+    ///
+    /// Unlike `required_crubit_features`, the result doesn't depend on the
+    /// target, so it can be computed once per type (see
+    /// `BindingsGenerator::crubit_feature_requirements`) and then checked
+    /// against the features of each target.
+    pub fn crubit_feature_requirements(&self) -> CrubitFeatureRequirements {
         // TODO(b/318006909): Explain why a given feature is required, don't just return
         // a FlagSet.
 
-        let mut missing_features = <flagset::FlagSet<ir::CrubitFeature>>::default();
-        let mut reasons = <std::collections::BTreeSet<std::borrow::Cow<'static, str>>>::new();
+        let mut requirements = CrubitFeatureRequirements::default();
         let mut require_feature =
             |required_feature: ir::CrubitFeature,
              reason: Option<&dyn Fn() -> std::borrow::Cow<'static, str>>| {
-                let required_features =
-                    <flagset::FlagSet<ir::CrubitFeature>>::from(required_feature);
-                let missing = required_features - enabled_features;
-                if !missing.is_empty() {
-                    missing_features |= missing;
-                    if let Some(reason) = reason {
-                        reasons.insert(reason());
-                    }
+                requirements.required_features |= required_feature;
+                if let Some(reason) = reason {
+                    requirements.reasons.insert((required_feature as u8, reason()));
                 }
             };
-
         for rs_type_kind in self.dfs_iter() {
             match rs_type_kind {
                 RsTypeKind::Pointer { .. } => require_feature(CrubitFeature::Supported, None),
@@ -435,10 +502,16 @@ impl RsTypeKind {
                         );
                     }
                 }
-                RsTypeKind::IncompleteRecord { .. } => require_feature(
-                    CrubitFeature::Experimental,
-                    Some(&|| format!("{rs_type_kind} is not a complete type)").into()),
-                ),
+                RsTypeKind::IncompleteRecord { incomplete_record, .. } => {
+                    if incomplete_record.is_complete_in_dependency {
+                        require_feature(CrubitFeature::Supported, None)
+                    } else {
+                        require_feature(
+                            CrubitFeature::Experimental,
+                            Some(&|| format!("{rs_type_kind} is not a complete type)").into()),
+                        )
+                    }
+                }
                 // Here, we can very carefully be non-recursive into the _structure_ of the type.
                 //
                 // Whether a record type is supported in rust does _not_ depend on whether each
@@ -466,11 +539,12 @@ impl RsTypeKind {
                 RsTypeKind::TypeAlias { .. } => require_feature(CrubitFeature::Supported, None),
                 RsTypeKind::Primitive { .. } => require_feature(CrubitFeature::Supported, None),
                 RsTypeKind::Option { .. } => require_feature(CrubitFeature::Supported, None),
+                RsTypeKind::UniquePtr { .. } => require_feature(CrubitFeature::Supported, None),
                 // Fallback case, we can't really give a good error message here.
                 RsTypeKind::Other { .. } => require_feature(CrubitFeature::Experimental, None),
             }
         }
-        (missing_features, reasons.into_iter().join(", "))
+        requirements
     }
 
     /// Returns true if the type can be passed by value through `extern "C"` ABI
@@ -491,12 +565,13 @@ impl RsTypeKind {
             // `rs_bindings_from_cc` can change the type of fields (e.g. using a blob of bytes for
             // unsupported field types, or for no_unique_address fields).  Changing the type
             // of fields may change the ABI, which means that we can no longer assume
-            // that `extern "C"` ABI thunks can pass such types by value.
-            //
-            // TODO(b/274177296): Return `true` for structs where bindings replicate the type of
-            // all the fields.
-            RsTypeKind::Record { .. } => false,
+            // that `extern "C"` ABI thunks can pass such types by value - unless the
+            // bindings replicate the type of all the fields.
+            RsTypeKind::Record { record, .. } => is_record_c_abi_compatible_by_value(record),
             RsTypeKind::Other { is_same_abi, .. } => *is_same_abi,
+            // Otherwise, `std::unique_ptr` is non-trivial for the purposes of calls and
+            // is passed through a pointer to a temporary.
+            RsTypeKind::UniquePtr { is_trivial_abi, .. } => *is_trivial_abi,
             _ => true,
         }
     }
@@ -617,6 +692,7 @@ impl RsTypeKind {
             RsTypeKind::Enum { .. } => true,
             RsTypeKind::TypeAlias { underlying_type, .. } => underlying_type.implements_copy(),
             RsTypeKind::Option(t) => t.implements_copy(),
+            RsTypeKind::UniquePtr { .. } => false,
             RsTypeKind::Other { type_args, .. } => {
                 // All types that may appear here without `type_args` (e.g.
                 // primitive types like `i32`) implement `Copy`. Generic types
@@ -752,6 +828,10 @@ impl RsTypeKind {
                 // TODO(jeanpierreda): This should likely be `::core::option::Option`.
                 quote! {Option<#type_arg>}
             }
+            RsTypeKind::UniquePtr { pointee, .. } => {
+                let pointee_ = pointee.to_token_stream_replacing_by_self(self_record);
+                quote! {::cc_std::unique_ptr::UniquePtr<#pointee_>}
+            }
             RsTypeKind::Other { name, type_args, .. } => {
                 let name: TokenStream = name.parse().expect("Invalid RsType::name in the IR");
                 let generic_params =
@@ -763,6 +843,36 @@ impl RsTypeKind {
     }
 }
 
+/// The Crubit features that are required to use a type, and why.
+#[derive(Clone, Debug, Default, PartialEq, Eq)]
+pub struct CrubitFeatureRequirements {
+    required_features: flagset::FlagSet<ir::CrubitFeature>,
+    /// The reasons for requiring each feature, keyed on the bits of the
+    /// feature (`CrubitFeature` isn't `Ord`), so that the reasons for the
+    /// missing features can be found without walking the type again.
+    reasons: std::collections::BTreeSet<(u8, std::borrow::Cow<'static, str>)>,
+}
+
+impl CrubitFeatureRequirements {
+    /// Returns the required features that are not in `enabled_features`, and
+    /// the reasons for requiring them.
+    pub fn missing_features(
+        &self,
+        enabled_features: flagset::FlagSet<ir::CrubitFeature>,
+    ) -> (flagset::FlagSet<ir::CrubitFeature>, String) {
+        let missing_features = self.required_features - enabled_features;
+        let reasons = self
+            .reasons
+            .iter()
+            .filter(|(feature, _)| {
+                missing_features.into_iter().any(|missing| missing as u8 == *feature)
+            })
+            .map(|(_, reason)| reason)
+            .collect::<std::collections::BTreeSet<_>>();
+        (missing_features, reasons.into_iter().join(", "))
+    }
+}
+
 impl std::fmt::Display for RsTypeKind {
     // Formats the token stream of the RsTypeKind to a string. Note that this can
     // include extra whitespace, where we'd ideally remove it, but it is hard to
@@ -841,6 +951,9 @@ impl ToTokens for RsTypeKind {
                 // TODO(jeanpierreda): This should likely be `::core::option::Option`.
                 quote! {Option<#t>}
             }
+            RsTypeKind::UniquePtr { pointee, .. } => {
+                quote! {::cc_std::unique_ptr::UniquePtr<#pointee>}
+            }
             RsTypeKind::Other { name, type_args, .. } => {
                 let name: TokenStream = name.parse().expect("Invalid RsType::name in the IR");
                 let generic_params =
@@ -882,6 +995,7 @@ impl<'ty> Iterator for RsTypeKindIter<'ty> {
                         self.todo.extend(param_types.iter().rev());
                     }
                     RsTypeKind::Option(t) => self.todo.push(t),
+                    RsTypeKind::UniquePtr { pointee, .. } => self.todo.push(pointee),
                     RsTypeKind::Other { type_args, .. } => self.todo.extend(type_args.iter().rev()),
                 };
                 Some(curr)
@@ -1032,4 +1146,40 @@ mod tests {
         assert_eq!(result.features, [make_rs_ident("arbitrary_self_types")].into_iter().collect());
         Ok(())
     }
+
+    #[test]
+    fn test_crubit_feature_requirements() {
+        // `&*const i32`: the pointer requires `supported`, the reference `experimental`.
+        let ty = RsTypeKind::Reference {
+            referent: Rc::new(RsTypeKind::Pointer {
+                pointee: Rc::new(RsTypeKind::Primitive(PrimitiveType::i32)),
+                mutability: Mutability::Const,
+            }),
+            mutability: Mutability::Const,
+            lifetime: Lifetime::new("a"),
+        };
+        let requirements = ty.crubit_feature_requirements();
+
+        let supported = flagset::FlagSet::from(CrubitFeature::Supported);
+        let experimental = flagset::FlagSet::from(CrubitFeature::Experimental);
+        assert_eq!(
+            requirements.missing_features(flagset::FlagSet::default()),
+            (supported | experimental, "references are not supported".to_string())
+        );
+        assert_eq!(
+            requirements.missing_features(supported),
+            (experimental, "references are not supported".to_string())
+        );
+        assert_eq!(
+            requirements.missing_features(supported | experimental),
+            (flagset::FlagSet::default(), String::new())
+        );
+        // The requirements agree with the features computed for each target.
+        for enabled in [flagset::FlagSet::default(), supported, supported | experimental] {
+            assert_eq!(
+                ty.required_crubit_features(enabled),
+                requirements.missing_features(enabled)
+            );
+        }
+    }
 }
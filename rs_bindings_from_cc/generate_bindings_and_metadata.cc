@@ -9,17 +9,25 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
-#include "absl/container/flat_hash_set.h"
 #include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "common/file_io.h"
 #include "common/status_macros.h"
+#include "lifetime_analysis/lifetime_summaries.h"
 #include "rs_bindings_from_cc/cmdline.h"
 #include "rs_bindings_from_cc/collect_instantiations.h"
 #include "rs_bindings_from_cc/collect_namespaces.h"
 #include "rs_bindings_from_cc/ir.h"
 #include "rs_bindings_from_cc/ir_from_cc.h"
 #include "rs_bindings_from_cc/src_code_gen.h"
+#include "rs_bindings_from_cc/type_manifest.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/TimeProfiler.h"
 
 namespace crubit {
 
@@ -33,29 +41,59 @@ std::optional<const Namespace*> FindNamespace(const IR& ir,
   return std::nullopt;
 }
 
-std::vector<const Record*> FindInstantiationsInNamespace(const IR& ir,
-                                                         ItemId namespace_id) {
-  absl::flat_hash_set<ItemId> record_ids;
-  for (const auto* type_alias : ir.get_items_if<TypeAlias>()) {
-    if (type_alias->enclosing_item_id == namespace_id) {
-      const MappedType* mapped_type = &type_alias->underlying_type;
-      CHECK(mapped_type->cc_type.decl_id.has_value());
-      CHECK(mapped_type->rs_type.decl_id.has_value());
-      CHECK(mapped_type->cc_type.decl_id.value() ==
-            mapped_type->rs_type.decl_id.value());
-      record_ids.insert(mapped_type->rs_type.decl_id.value());
-    }
+// Maps each requested instantiation to the name of the Rust struct generated
+// for it. Requests that spell the same specialization differently (e.g. through
+// a typedef of a template argument) all resolve to a single record, so its
+// bindings are generated only once and every spelling refers to them.
+absl::btree_map<std::string, std::string> MapRequestedInstantiations(
+    const IR& ir, ItemId namespace_id,
+    const std::vector<std::string>& requested_instantiations) {
+  absl::flat_hash_map<ItemId, const Record*> records;
+  for (const auto* record : ir.get_items_if<Record>()) {
+    records.insert({record->id, record});
   }
 
-  std::vector<const Record*> result;
-  for (const auto* record : ir.get_items_if<Record>()) {
-    if (record_ids.find(record->id) != record_ids.end()) {
-      result.push_back(record);
+  absl::btree_map<std::string, std::string> result;
+  for (const auto* type_alias : ir.get_items_if<TypeAlias>()) {
+    if (type_alias->enclosing_item_id != namespace_id) continue;
+    const MappedType* mapped_type = &type_alias->underlying_type;
+    CHECK(mapped_type->cc_type.decl_id.has_value());
+    CHECK(mapped_type->rs_type.decl_id.has_value());
+    CHECK(mapped_type->cc_type.decl_id.value() ==
+          mapped_type->rs_type.decl_id.value());
+    auto record = records.find(mapped_type->rs_type.decl_id.value());
+    if (record == records.end()) continue;
+    result.insert({record->second->cc_name, record->second->rs_name});
+
+    absl::string_view alias_name = type_alias->identifier.Ident();
+    size_t index;
+    if (absl::ConsumePrefix(&alias_name, kInstantiationAliasPrefix) &&
+        absl::SimpleAtoi(alias_name, &index) &&
+        index < requested_instantiations.size()) {
+      result.insert(
+          {requested_instantiations[index], record->second->rs_name});
     }
   }
   return result;
 }
 
+// Generates the bindings of the IR in `ir_json` as requested by `args`.
+static absl::StatusOr<Bindings> GenerateBindingsFromArgs(
+    const CmdlineArgs& args, std::string ir_json) {
+  llvm::TimeTraceScope time_trace("GenerateBindings");
+  return GenerateBindingsFromJson(
+      std::move(ir_json), args.crubit_support_path_format,
+      args.clang_format_exe_path, args.rustfmt_exe_path,
+      args.rustfmt_config_path,
+      /*generate_error_report=*/!args.error_report_out.empty(),
+      args.error_report_format, args.generate_source_location_in_doc_comment,
+      /*rs_api_impl_shards=*/1 + args.extra_cc_out.size(),
+      args.skip_formatting, args.compact_layout_assertions,
+      args.inline_always_forwarding_only, args.minimal_rs_api_impl_includes,
+      args.rust_enums,
+      /*generate_bloat_report=*/!args.bloat_report_out.empty());
+}
+
 absl::StatusOr<BindingsAndMetadata> GenerateBindingsAndMetadata(
     Cmdline& cmdline, std::vector<std::string> clang_args,
     absl::flat_hash_map<HeaderName, std::string>
@@ -64,11 +102,75 @@ absl::StatusOr<BindingsAndMetadata> GenerateBindingsAndMetadata(
   clang_args_view.insert(clang_args_view.end(), clang_args.begin(),
                          clang_args.end());
   const CmdlineArgs& args = cmdline.args();
+  std::vector<std::string> input_files;
+  if (!args.target_args_index_path.empty()) {
+    input_files.push_back(args.target_args_index_path);
+  }
+  if (!args.rustfmt_config_path.empty()) {
+    input_files.push_back(args.rustfmt_config_path);
+  }
 
-  CRUBIT_ASSIGN_OR_RETURN(
-      std::vector<std::string> requested_instantiations,
-      CollectInstantiations(args.srcs_to_scan_for_instantiations));
+  // The headers were already parsed by an `--ir_only` run, which also wrote
+  // the namespaces, the instantiations and the type manifest.
+  if (!args.ir_in.empty()) {
+    std::string ir_json;
+    {
+      llvm::TimeTraceScope time_trace("ReadIr", args.ir_in);
+      CRUBIT_ASSIGN_OR_RETURN(ir_json, GetFileContents(args.ir_in));
+    }
+    input_files.push_back(args.ir_in);
+    CRUBIT_ASSIGN_OR_RETURN(Bindings bindings,
+                            GenerateBindingsFromArgs(args, std::move(ir_json)));
+    return BindingsAndMetadata{
+        .rs_api = std::move(bindings.rs_api),
+        .rs_api_impl = bindings.rs_api_impl,
+        .extra_rs_api_impl = std::move(bindings.extra_rs_api_impl),
+        .rs_api_impl_buffer = std::move(bindings.rs_api_impl_buffer),
+        .error_report = std::move(bindings.error_report),
+        .bloat_report = std::move(bindings.bloat_report),
+        .ir_json = std::move(bindings.ir_json),
+        .input_files = std::move(input_files),
+    };
+  }
 
+  std::vector<std::string> requested_instantiations;
+  {
+    llvm::TimeTraceScope time_trace("CollectInstantiations");
+    CRUBIT_ASSIGN_OR_RETURN(
+        requested_instantiations,
+        CollectInstantiations(args.srcs_to_scan_for_instantiations));
+  }
+  input_files.insert(input_files.end(),
+                     args.srcs_to_scan_for_instantiations.begin(),
+                     args.srcs_to_scan_for_instantiations.end());
+
+  std::optional<DependencyTypes> dependency_types;
+  if (!args.type_manifests.empty()) {
+    llvm::TimeTraceScope time_trace("ReadTypeManifests");
+    dependency_types.emplace();
+    for (const std::string& type_manifest : args.type_manifests) {
+      CRUBIT_ASSIGN_OR_RETURN(std::string json, GetFileContents(type_manifest));
+      CRUBIT_RETURN_IF_ERROR(AddTypeManifest(json, *dependency_types));
+    }
+  }
+  input_files.insert(input_files.end(), args.type_manifests.begin(),
+                     args.type_manifests.end());
+
+  std::optional<clang::tidy::lifetimes::LifetimeSummaryStore>
+      lifetime_summaries;
+  if (!args.lifetime_summaries.empty()) {
+    llvm::TimeTraceScope time_trace("ReadLifetimeSummaries");
+    llvm::Expected<clang::tidy::lifetimes::LifetimeSummaryStore> store =
+        clang::tidy::lifetimes::LifetimeSummaryStore::Read(
+            args.lifetime_summaries);
+    if (!store) {
+      return absl::InvalidArgumentError(llvm::toString(store.takeError()));
+    }
+    lifetime_summaries = *std::move(store);
+    input_files.push_back(args.lifetime_summaries);
+  }
+
+  std::vector<std::string> clang_input_files;
   CRUBIT_ASSIGN_OR_RETURN(
       IR ir, IrFromCc(IrFromCcOptions{
                  .current_target = args.current_target,
@@ -79,40 +181,70 @@ absl::StatusOr<BindingsAndMetadata> GenerateBindingsAndMetadata(
                  .extra_rs_srcs = args.extra_rs_srcs,
                  .clang_args = clang_args_view,
                  .extra_instantiations = requested_instantiations,
-                 .crubit_features = args.target_to_features}));
+                 .crubit_features = args.target_to_features,
+                 .target_args_index = args.target_args_index.get(),
+                 .dependency_types = dependency_types.has_value()
+                                         ? &*dependency_types
+                                         : nullptr,
+                 .lifetime_summaries = lifetime_summaries.has_value()
+                                           ? &*lifetime_summaries
+                                           : nullptr,
+                 .lazy_import = args.lazy_import,
+                 .template_instantiation_budget =
+                     args.template_instantiation_budget,
+                 .parse_all_comments = args.parse_all_comments,
+                 .lean_unsupported_items = !args.unsupported_item_comments &&
+                                           args.error_report_out.empty(),
+                 .string_view_as_slice_pointer =
+                     args.string_view_as_slice_pointer,
+                 .input_files = &clang_input_files}));
+  input_files.insert(input_files.end(), clang_input_files.begin(),
+                     clang_input_files.end());
 
   if (!args.instantiations_out.empty()) {
     ir.crate_root_path = "__cc_template_instantiations_rs_api";
   }
 
-  bool generate_error_report = !args.error_report_out.empty();
-  CRUBIT_ASSIGN_OR_RETURN(
-      Bindings bindings,
-      GenerateBindings(ir, args.crubit_support_path_format,
-                       args.clang_format_exe_path, args.rustfmt_exe_path,
-                       args.rustfmt_config_path, generate_error_report,
-                       args.generate_source_location_in_doc_comment));
+  std::string ir_json;
+  {
+    llvm::TimeTraceScope time_trace("IrToJson");
+    ir_json = IrToCompactJson(ir);
+  }
+  Bindings bindings;
+  if (args.ir_only) {
+    bindings.ir_json = std::move(ir_json);
+  } else {
+    CRUBIT_ASSIGN_OR_RETURN(bindings,
+                            GenerateBindingsFromArgs(args, std::move(ir_json)));
+  }
 
-  absl::flat_hash_map<std::string, std::string> instantiations;
+  absl::btree_map<std::string, std::string> instantiations;
   std::optional<const Namespace*> ns =
       FindNamespace(ir, kInstantiationsNamespaceName);
   if (ns.has_value()) {
-    std::vector<const Record*> records =
-        FindInstantiationsInNamespace(ir, ns.value()->id);
-    for (const auto* record : records) {
-      instantiations.insert({record->cc_name, record->rs_name});
-    }
+    instantiations = MapRequestedInstantiations(ir, ns.value()->id,
+                                                requested_instantiations);
   }
 
   auto top_level_namespaces = crubit::CollectNamespaces(ir);
+  std::string type_manifest;
+  if (!args.type_manifest_out.empty()) {
+    type_manifest = TypeManifestToJson(ir);
+  }
 
   return BindingsAndMetadata{
-      .ir = ir,
-      .rs_api = bindings.rs_api,
+      .ir = std::move(ir),
+      .rs_api = std::move(bindings.rs_api),
       .rs_api_impl = bindings.rs_api_impl,
+      .extra_rs_api_impl = std::move(bindings.extra_rs_api_impl),
+      .rs_api_impl_buffer = std::move(bindings.rs_api_impl_buffer),
       .namespaces = std::move(top_level_namespaces),
+      .type_manifest = std::move(type_manifest),
       .instantiations = std::move(instantiations),
-      .error_report = bindings.error_report,
+      .error_report = std::move(bindings.error_report),
+      .bloat_report = std::move(bindings.bloat_report),
+      .ir_json = std::move(bindings.ir_json),
+      .input_files = std::move(input_files),
   };
 }
 
@@ -8,8 +8,11 @@
 #include <string>
 #include <vector>
 
+#include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "common/ffi_types.h"
 #include "rs_bindings_from_cc/cmdline.h"
 #include "rs_bindings_from_cc/collect_namespaces.h"
 #include "rs_bindings_from_cc/ir.h"
@@ -18,19 +21,33 @@ namespace crubit {
 // Contains generated bindings and all related metadata, such as the IR.
 struct BindingsAndMetadata {
   // Intermediate representation of the Clang AST from which we generated
-  // bindings.
+  // bindings. Empty with `--ir_in`, which only has `ir_json`.
   IR ir;
   // Generated Rust source code.
-  std::string rs_api;
+  RustOwnedBuffer rs_api;
   // Generated C++ source code.
-  std::string rs_api_impl;
+  absl::string_view rs_api_impl;
+  // Further shards of the generated C++ source code, one for each
+  // `--extra_cc_out`.
+  std::vector<absl::string_view> extra_rs_api_impl;
+  // Owns the generated C++ source code of all the shards.
+  RustOwnedBuffer rs_api_impl_buffer;
   // A hierarchy tree for all C++ namespaces used in the target.
   NamespacesHierarchy namespaces;
+  // The type manifest of the target, as JSON (see `TypeManifestToJson`).
+  std::string type_manifest;
   // C++ class templates explicitly instantiated in this TU and their Rust
-  // struct name.
-  absl::flat_hash_map<std::string, std::string> instantiations;
-  // A JSON error report, if requested.
-  std::string error_report;
+  // struct name, sorted so that `--instantiations_out` is deterministic.
+  absl::btree_map<std::string, std::string> instantiations;
+  // An error report, if requested.
+  RustOwnedBuffer error_report;
+  // A report of the code generated for each item, if requested.
+  RustOwnedBuffer bloat_report;
+  // `ir` serialized as JSON.
+  std::string ir_json;
+  // The files that the bindings were generated from: the headers that Clang
+  // read (or `--ir_in`), and the other input files named on the command line.
+  std::vector<std::string> input_files;
 };
 
 // Returns `BindingsAndMetadata` as requested by the user on the command line.
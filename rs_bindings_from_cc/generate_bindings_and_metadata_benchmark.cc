@@ -0,0 +1,183 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Measures how the time and memory that rs_bindings_from_cc takes scale with
+// the size of the headers, on synthetic headers with `N` records, functions,
+// class templates and namespaces.
+//
+// Run with e.g. `--benchmark_filter=BM_Import/10000` to measure one phase at a
+// size: `peak_rss` is the high-water mark of the whole process, so it is only
+// meaningful for the first benchmark that reaches it.
+
+#include <sys/resource.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "third_party/benchmark/include/benchmark/benchmark.h"
+#include "rs_bindings_from_cc/cmdline.h"
+#include "rs_bindings_from_cc/generate_bindings_and_metadata.h"
+#include "rs_bindings_from_cc/ir.h"
+#include "rs_bindings_from_cc/src_code_gen.h"
+
+namespace crubit {
+namespace {
+
+constexpr absl::string_view kHeaderName = "synthetic.h";
+
+// The number of entities of each kind per namespace.
+constexpr int kEntitiesPerNamespace = 100;
+
+// Returns a header with `n` records (each with a field, a method and a
+// constructor), `n` functions, `n` class template instantiations, and
+// `n / (2 * kEntitiesPerNamespace)` namespaces, which are each opened twice.
+std::string MakeSyntheticHeader(int n) {
+  std::string header = "#pragma once\n";
+  for (int i = 0; i < n; ++i) {
+    if (i % kEntitiesPerNamespace == 0) {
+      if (i != 0) absl::StrAppend(&header, "}\n");
+      absl::StrAppendFormat(&header, "namespace ns%d {\n",
+                            i / kEntitiesPerNamespace / 2);
+    }
+    absl::StrAppendFormat(&header,
+                          "struct Record%d {\n"
+                          "  explicit Record%d(int value);\n"
+                          "  int Method(int delta) const;\n"
+                          "  int field;\n"
+                          "};\n"
+                          "int Function%d(const Record%d& record, int x);\n"
+                          "template <typename T> struct Template%d {\n"
+                          "  T Get() const { return value; }\n"
+                          "  T value;\n"
+                          "};\n"
+                          "using Alias%d = Template%d<Record%d>;\n",
+                          i, i, i, i, i, i, i, i);
+  }
+  if (n > 0) absl::StrAppend(&header, "}\n");
+  return header;
+}
+
+Cmdline MakeCmdline(bool ir_only) {
+  auto args = CmdlineArgs{
+      .current_target = BazelLabel("//:synthetic"),
+      .cc_out = "cc_out",
+      .rs_out = "rs_out",
+      // Nothing is written to the output paths, and formatting is skipped, but
+      // `Cmdline::Create` requires them.
+      .ir_out = "ir_out",
+      .crubit_support_path_format = "<crubit/support/path/{header}>",
+      .clang_format_exe_path = "clang-format",
+      .rustfmt_exe_path = "rustfmt",
+      .ir_only = ir_only,
+      // Formatting runs rustfmt and clang-format in subprocesses, which this
+      // benchmark doesn't measure.
+      .skip_formatting = true,
+      .public_headers = {HeaderName(std::string(kHeaderName))},
+  };
+  args.headers_to_targets[args.public_headers[0]] = args.current_target;
+  absl::StatusOr<Cmdline> cmdline = Cmdline::Create(args);
+  CHECK_OK(cmdline);
+  return *std::move(cmdline);
+}
+
+absl::flat_hash_map<HeaderName, std::string> MakeHeaders(int n) {
+  return {{HeaderName(std::string(kHeaderName)), MakeSyntheticHeader(n)}};
+}
+
+void ReportPeakRss(benchmark::State& state) {
+  struct rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  // `ru_maxrss` is in kilobytes on Linux.
+  state.counters["peak_rss"] = benchmark::Counter(
+      static_cast<double>(usage.ru_maxrss) * 1024,
+      benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+}
+
+// Parses the headers into the IR, like an `--ir_only` run.
+void BM_Import(benchmark::State& state) {
+  Cmdline cmdline = MakeCmdline(/*ir_only=*/true);
+  absl::flat_hash_map<HeaderName, std::string> headers =
+      MakeHeaders(state.range(0));
+  for (auto _ : state) {
+    absl::StatusOr<BindingsAndMetadata> result =
+        GenerateBindingsAndMetadata(cmdline, /*clang_args=*/{}, headers);
+    CHECK_OK(result);
+    benchmark::DoNotOptimize(result->ir_json);
+  }
+  ReportPeakRss(state);
+}
+BENCHMARK(BM_Import)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Generates the bindings from the IR, like an `--ir_in` run.
+void BM_Codegen(benchmark::State& state) {
+  std::string ir_json;
+  {
+    Cmdline cmdline = MakeCmdline(/*ir_only=*/true);
+    absl::StatusOr<BindingsAndMetadata> result = GenerateBindingsAndMetadata(
+        cmdline, /*clang_args=*/{}, MakeHeaders(state.range(0)));
+    CHECK_OK(result);
+    ir_json = std::move(result->ir_json);
+  }
+  Cmdline cmdline = MakeCmdline(/*ir_only=*/false);
+  const CmdlineArgs& args = cmdline.args();
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::string json = ir_json;
+    state.ResumeTiming();
+    absl::StatusOr<Bindings> bindings = GenerateBindingsFromJson(
+        std::move(json), args.crubit_support_path_format,
+        args.clang_format_exe_path, args.rustfmt_exe_path,
+        args.rustfmt_config_path, /*generate_error_report=*/false,
+        args.error_report_format, args.generate_source_location_in_doc_comment,
+        /*rs_api_impl_shards=*/1, args.skip_formatting);
+    CHECK_OK(bindings);
+    benchmark::DoNotOptimize(bindings->rs_api.view());
+  }
+  state.counters["ir_bytes"] = static_cast<double>(ir_json.size());
+  ReportPeakRss(state);
+}
+BENCHMARK(BM_Codegen)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Both of the above in one run.
+void BM_EndToEnd(benchmark::State& state) {
+  Cmdline cmdline = MakeCmdline(/*ir_only=*/false);
+  absl::flat_hash_map<HeaderName, std::string> headers =
+      MakeHeaders(state.range(0));
+  for (auto _ : state) {
+    absl::StatusOr<BindingsAndMetadata> result =
+        GenerateBindingsAndMetadata(cmdline, /*clang_args=*/{}, headers);
+    CHECK_OK(result);
+    benchmark::DoNotOptimize(result->rs_api.view());
+  }
+  ReportPeakRss(state);
+}
+BENCHMARK(BM_EndToEnd)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace crubit
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
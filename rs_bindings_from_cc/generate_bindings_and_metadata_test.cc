@@ -9,7 +9,7 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
-#include "absl/container/flat_hash_map.h"
+#include "absl/container/btree_map.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -20,14 +20,17 @@
 #include "rs_bindings_from_cc/cmdline.h"
 #include "rs_bindings_from_cc/collect_namespaces.h"
 #include "rs_bindings_from_cc/ir.h"
+#include "llvm/Support/FormatVariadic.h"
 
 namespace crubit {
 namespace {
 
 using ::testing::ElementsAre;
+using ::testing::HasSubstr;
 using ::testing::IsEmpty;
 using ::testing::Pair;
 using ::testing::StrEq;
+using ::testing::UnorderedElementsAre;
 
 constexpr absl::string_view kDefaultRustfmtExePath =
     "third_party/crosstool/rust/unstable/main_sysroot/bin/rustfmt";
@@ -68,13 +71,80 @@ TEST(GenerateBindingsAndMetadataTest, GeneratingIR) {
 
   ASSERT_EQ(result.ir.public_headers.size(), 1);
   ASSERT_EQ(result.ir.public_headers.front().IncludePath(), "a.h");
-  ASSERT_EQ(result.error_report, "");
+  ASSERT_EQ(result.error_report.view(), "");
+  ASSERT_EQ(result.ir_json,
+            std::string(llvm::formatv("{0}", result.ir.ToJson())));
 
   // Check that IR items have the proper owning target set.
   auto item = result.ir.get_items_if<Namespace>().front();
   ASSERT_EQ(item->owning_target.value(), "//:target");
 }
 
+TEST(GenerateBindingsAndMetadataTest, IrOnlyThenIrInMatchesSingleRun) {
+  constexpr absl::string_view kHeader = "struct S { int field; };";
+  Cmdline cmdline = MakeCmdline("a.h");
+  ASSERT_OK_AND_ASSIGN(
+      BindingsAndMetadata single_run,
+      GenerateBindingsAndMetadata(cmdline, DefaultClangArgs(),
+                                  /*virtual_headers_contents_for_testing=*/
+                                  {{HeaderName("a.h"), std::string(kHeader)}}));
+
+  CmdlineArgs ir_only_args = MakeCmdline("a.h").args();
+  ir_only_args.ir_only = true;
+  ASSERT_OK_AND_ASSIGN(Cmdline ir_only_cmdline, Cmdline::Create(ir_only_args));
+  ASSERT_OK_AND_ASSIGN(
+      BindingsAndMetadata ir_only,
+      GenerateBindingsAndMetadata(ir_only_cmdline, DefaultClangArgs(),
+                                  /*virtual_headers_contents_for_testing=*/
+                                  {{HeaderName("a.h"), std::string(kHeader)}}));
+  EXPECT_EQ(ir_only.ir_json, single_run.ir_json);
+  EXPECT_EQ(ir_only.rs_api.view(), "");
+
+  CmdlineArgs ir_in_args = MakeCmdline("a.h").args();
+  ir_in_args.ir_in = WriteFileForCurrentTest("ir.json", ir_only.ir_json);
+  ir_in_args.namespaces_out = "";
+  ASSERT_OK_AND_ASSIGN(Cmdline ir_in_cmdline, Cmdline::Create(ir_in_args));
+  ASSERT_OK_AND_ASSIGN(BindingsAndMetadata ir_in,
+                       GenerateBindingsAndMetadata(ir_in_cmdline, {}));
+  EXPECT_EQ(ir_in.rs_api.view(), single_run.rs_api.view());
+  EXPECT_EQ(ir_in.rs_api_impl, single_run.rs_api_impl);
+}
+
+TEST(GenerateBindingsAndMetadataTest, OutputsAreDeterministic) {
+  constexpr absl::string_view kHeader = R"cc(
+    namespace b { namespace inner { struct S {}; } }
+    namespace a { void F(); }
+    namespace b { inline void G(); }
+    template <typename T> struct Tmpl { T t; };
+    using TmplInt = Tmpl<int>;
+  )cc";
+  auto generate = [&]() {
+    CmdlineArgs args = MakeCmdline("a.h").args();
+    args.target_to_features[BazelLabel("//:target")] = {
+        "supported", "non_extern_c_functions", "experimental"};
+    args.target_to_features[BazelLabel("//:other")] = {"supported",
+                                                       "experimental"};
+    absl::StatusOr<Cmdline> cmdline = Cmdline::Create(args);
+    CHECK_OK(cmdline);
+    return GenerateBindingsAndMetadata(
+        *cmdline, DefaultClangArgs(),
+        /*virtual_headers_contents_for_testing=*/
+        {{HeaderName("a.h"), std::string(kHeader)}});
+  };
+  ASSERT_OK_AND_ASSIGN(BindingsAndMetadata first, generate());
+  ASSERT_OK_AND_ASSIGN(BindingsAndMetadata second, generate());
+
+  EXPECT_EQ(first.ir_json, second.ir_json);
+  EXPECT_EQ(first.rs_api.view(), second.rs_api.view());
+  EXPECT_EQ(first.rs_api_impl, second.rs_api_impl);
+  EXPECT_EQ(NamespacesAsJson(first.namespaces),
+            NamespacesAsJson(second.namespaces));
+  // Hash-based containers are serialized in sorted order.
+  EXPECT_THAT(first.ir_json,
+              HasSubstr(R"("//:target":["experimental",)"
+                        R"("non_extern_c_functions","supported"])"));
+}
+
 TEST(GenerateBindingsAndMetadataTest, InstantiationsAreEmptyInNormalMode) {
   Cmdline cmdline = MakeCmdline("a.h");
 
@@ -87,7 +157,7 @@ TEST(GenerateBindingsAndMetadataTest, InstantiationsAreEmptyInNormalMode) {
   ASSERT_THAT(result.instantiations, IsEmpty());
 }
 
-absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
+absl::StatusOr<absl::btree_map<std::string, std::string>>
 GetInstantiationsFor(absl::string_view header_content,
                      absl::string_view rust_source) {
   std::string a_rs_path = WriteFileForCurrentTest("a.rs", rust_source);
@@ -199,6 +269,27 @@ TEST(GenerateBindingsAndMetadataTest,
                                "__CcTemplateInst16ExpectedTemplateIbE")));
 }
 
+TEST(GenerateBindingsAndMetadataTest,
+     DifferentSpellingsOfAnInstantiationShareTheStruct) {
+  ASSERT_OK_AND_ASSIGN(auto instantiations,
+                       GetInstantiationsFor(
+                           R"cc(
+                             using MyBool = bool;
+
+                             template <typename T>
+                             class ExpectedTemplate {};
+                           )cc",
+                           "cc_template!{ExpectedTemplate<bool>}\n"
+                           "cc_template!{ExpectedTemplate<MyBool>}"));
+
+  ASSERT_THAT(instantiations,
+              UnorderedElementsAre(
+                  Pair("ExpectedTemplate<bool>",
+                       "__CcTemplateInst16ExpectedTemplateIbE"),
+                  Pair("ExpectedTemplate<MyBool>",
+                       "__CcTemplateInst16ExpectedTemplateIbE")));
+}
+
 TEST(GenerateBindingsAndMetadataTest, NamespacesJsonGenerated) {
   constexpr absl::string_view kHeaderContent = R"(
     namespace top_level_1 {
@@ -6,9 +6,10 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <iterator>
-#include <map>
 #include <memory>
 #include <optional>
 #include <set>
@@ -21,6 +22,7 @@
 #include "absl/base/no_destructor.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
@@ -30,6 +32,7 @@
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
 #include "absl/strings/substitute.h"
 #include "common/status_macros.h"
 #include "lifetime_annotations/type_lifetimes.h"
@@ -43,7 +46,9 @@
 #include "clang/AST/DeclBase.h"
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/DeclFriend.h"
+#include "clang/AST/DeclTemplate.h"
 #include "clang/AST/Mangle.h"
+#include "clang/AST/PrettyPrinter.h"
 #include "clang/AST/RawCommentList.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/AttrKinds.h"
@@ -54,10 +59,14 @@
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/Specifiers.h"
+#include "clang/Index/USRGeneration.h"
 #include "clang/Sema/Sema.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/Regex.h"
 
 namespace crubit {
@@ -220,11 +229,30 @@ static int GetDeclOrder(const clang::Decl* decl) {
   return 999;
 }
 
+// Returns whether `a` is before `b`, comparing their precomputed positions if
+// they are known and differ, which is much cheaper.
+static bool IsBeforeInTranslationUnit(clang::SourceLocation a,
+                                      std::optional<uint64_t> a_position,
+                                      clang::SourceLocation b,
+                                      std::optional<uint64_t> b_position,
+                                      const clang::SourceManager& sm) {
+  if (a_position.has_value() && b_position.has_value() &&
+      *a_position != *b_position) {
+    return *a_position < *b_position;
+  }
+  return sm.isBeforeInTranslationUnit(a, b);
+}
+
 class Importer::SourceOrderKey {
  public:
-  explicit SourceOrderKey(clang::SourceRange source_range, int decl_order = 0,
-                          std::string name = "")
-      : source_range_(source_range), decl_order_(decl_order), name_(name) {}
+  explicit SourceOrderKey(clang::SourceRange source_range,
+                          const TranslationUnitPositions& positions,
+                          int decl_order = 0, std::string name = "")
+      : source_range_(source_range),
+        begin_position_(positions.GetPosition(source_range.getBegin())),
+        end_position_(positions.GetPosition(source_range.getEnd())),
+        decl_order_(decl_order),
+        name_(name) {}
 
   SourceOrderKey(const SourceOrderKey&) = default;
   SourceOrderKey& operator=(const SourceOrderKey&) = default;
@@ -236,12 +264,14 @@ class Importer::SourceOrderKey {
         return !source_range_.isValid() && other.source_range_.isValid();
     } else {
       if (source_range_.getBegin() != other.source_range_.getBegin()) {
-        return sm.isBeforeInTranslationUnit(source_range_.getBegin(),
-                                            other.source_range_.getBegin());
+        return IsBeforeInTranslationUnit(
+            source_range_.getBegin(), begin_position_,
+            other.source_range_.getBegin(), other.begin_position_, sm);
       }
       if (source_range_.getEnd() != other.source_range_.getEnd()) {
-        return sm.isBeforeInTranslationUnit(source_range_.getEnd(),
-                                            other.source_range_.getEnd());
+        return IsBeforeInTranslationUnit(
+            source_range_.getEnd(), end_position_,
+            other.source_range_.getEnd(), other.end_position_, sm);
       }
     }
 
@@ -255,19 +285,29 @@ class Importer::SourceOrderKey {
 
  private:
   clang::SourceRange source_range_;
+  std::optional<uint64_t> begin_position_;
+  std::optional<uint64_t> end_position_;
   int decl_order_;
   std::string name_;
 };
 
 Importer::SourceOrderKey Importer::GetSourceOrderKey(
     const clang::Decl* decl) const {
-  return SourceOrderKey(decl->getSourceRange(), GetDeclOrder(decl),
-                        GetNameForSourceOrder(decl));
+  return SourceOrderKey(decl->getSourceRange(), GetTranslationUnitPositions(),
+                        GetDeclOrder(decl), GetNameForSourceOrder(decl));
 }
 
 Importer::SourceOrderKey Importer::GetSourceOrderKey(
     const clang::RawComment* comment) const {
-  return SourceOrderKey(comment->getSourceRange());
+  return SourceOrderKey(comment->getSourceRange(),
+                        GetTranslationUnitPositions());
+}
+
+const TranslationUnitPositions& Importer::GetTranslationUnitPositions() const {
+  if (!tu_positions_.has_value()) {
+    tu_positions_.emplace(ctx_.getSourceManager());
+  }
+  return *tu_positions_;
 }
 
 class Importer::SourceLocationComparator {
@@ -383,13 +423,68 @@ clang::Decl* Importer::CanonicalizeDecl(clang::Decl* decl) const {
   return const_cast<clang::Decl*>(ret);
 }
 
+std::string Importer::GetWorkingDirectory(clang::ASTContext& ctx) {
+  llvm::ErrorOr<std::string> working_directory =
+      ctx.getSourceManager()
+          .getFileManager()
+          .getVirtualFileSystem()
+          .getCurrentWorkingDirectory();
+  if (!working_directory || working_directory->empty()) return "";
+  if (!llvm::sys::path::is_separator(working_directory->back())) {
+    *working_directory += llvm::sys::path::get_separator();
+  }
+  return *std::move(working_directory);
+}
+
+absl::string_view Importer::GetRelativeFilename(
+    absl::string_view filename) const {
+  if (!working_directory_.empty()) {
+    absl::ConsumePrefix(&filename, working_directory_);
+  }
+  absl::ConsumePrefix(&filename, "./");
+  return filename;
+}
+
+std::string Importer::PrintSourceLocation(clang::SourceLocation loc) const {
+  const clang::SourceManager& sm = ctx_.getSourceManager();
+  clang::PresumedLoc presumed_loc = sm.getPresumedLoc(sm.getSpellingLoc(loc));
+  if (presumed_loc.isInvalid()) return "<invalid loc>";
+  return absl::StrCat(GetRelativeFilename(presumed_loc.getFilename()), ":",
+                      presumed_loc.getLine(), ":", presumed_loc.getColumn());
+}
+
+std::string Importer::GetItemIdKey(const clang::Decl* decl) const {
+  llvm::SmallString<128> usr;
+  // Note that generateUSRForDecl() returns true on failure.
+  if (!clang::index::generateUSRForDecl(decl, usr)) {
+    return absl::StrCat(decl->getDeclKindName(), ":", usr.str());
+  }
+  return absl::StrCat(decl->getDeclKindName(), "@",
+                      PrintSourceLocation(decl->getLocation()));
+}
+
+ItemId Importer::GetOrAllocateItemId(
+    const void* key_object, absl::FunctionRef<std::string()> key) const {
+  auto [it, inserted] = item_ids_.try_emplace(key_object, 0);
+  if (inserted) {
+    it->second = invocation_.item_ids_.Allocate(key());
+  }
+  return it->second;
+}
+
 ItemId Importer::GenerateItemId(const clang::Decl* decl) const {
   const clang::Decl* canonicalized = CanonicalizeDecl(decl);
-  return ItemId(reinterpret_cast<uintptr_t>(canonicalized));
+  // Injected class names have no canonical decl.
+  if (canonicalized == nullptr) return ItemId(0);
+  return GetOrAllocateItemId(canonicalized,
+                             [&] { return GetItemIdKey(canonicalized); });
 }
 
 ItemId Importer::GenerateItemId(const clang::RawComment* comment) const {
-  return ItemId(reinterpret_cast<uintptr_t>(comment));
+  return GetOrAllocateItemId(comment, [&] {
+    return absl::StrCat("comment@",
+                        PrintSourceLocation(comment->getBeginLoc()));
+  });
 }
 
 absl::StatusOr<std::optional<ItemId>> Importer::GetEnclosingItemId(
@@ -424,25 +519,28 @@ std::vector<ItemId> Importer::GetItemIdsInSourceOrder(
   auto compare_locations = SourceLocationComparator(sm);
 
   // We are only interested in comments within this decl context.
-  std::vector<const clang::RawComment*> comments_in_range(
-      llvm::lower_bound(comments_, parent_decl->getBeginLoc(),
-                        compare_locations),
-      llvm::upper_bound(comments_, parent_decl->getEndLoc(),
-                        compare_locations));
-
-  std::map<clang::SourceLocation, const clang::RawComment*,
-           SourceLocationComparator>
-      ordered_comments(compare_locations);
-  for (auto& comment : comments_in_range) {
-    if (IsFilteredComment(sm, *comment)) continue;
-    ordered_comments.insert({comment->getBeginLoc(), comment});
+  auto [first_comment, last_comment] = GetCommentsInRange(
+      parent_decl->getBeginLoc(), parent_decl->getEndLoc());
+  std::vector<bool> is_free_comment(last_comment - first_comment);
+  for (size_t i = first_comment; i < last_comment; ++i) {
+    is_free_comment[i - first_comment] = !filtered_comments_[i];
   }
+  auto remove_comments_in_range = [&](clang::SourceLocation begin,
+                                      clang::SourceLocation end) {
+    auto [first, last] = GetCommentsInRange(begin, end);
+    for (size_t i = std::max(first, first_comment);
+         i < std::min(last, last_comment); ++i) {
+      is_free_comment[i - first_comment] = false;
+    }
+  };
 
   absl::flat_hash_set<ItemId> visited_item_ids;
 
   auto* decl_context = clang::cast<clang::DeclContext>(parent_decl);
   for (auto decl : GetCanonicalChildren(decl_context)) {
-    auto item = GetDeclItem(decl);
+    bool has_item = ShouldImportWithDeclContext(decl)
+                        ? GetDeclItem(decl).has_value()
+                        : GetImportedItem(decl) != nullptr;
     // We generated IR for top level items coming from different targets,
     // however we shouldn't generate bindings for them, so we don't add them
     // to ir.top_level_item_ids.
@@ -450,7 +548,7 @@ std::vector<ItemId> Importer::GetItemIdsInSourceOrder(
       continue;
     }
     // Only add item ids for decls that can be successfully imported.
-    if (item.has_value()) {
+    if (has_item) {
       auto item_id = GenerateItemId(decl);
       // TODO(rosica): Drop this check when we start importing also other
       // redecls, not just the canonical
@@ -463,14 +561,16 @@ std::vector<ItemId> Importer::GetItemIdsInSourceOrder(
     // We remove comments attached to a child decl or that are within a child
     // decl.
     if (auto raw_comment = ctx_.getRawCommentForDeclNoCache(decl)) {
-      ordered_comments.erase(raw_comment->getBeginLoc());
+      remove_comments_in_range(raw_comment->getBeginLoc(),
+                               raw_comment->getBeginLoc());
     }
-    ordered_comments.erase(ordered_comments.lower_bound(decl->getBeginLoc()),
-                           ordered_comments.upper_bound(decl->getEndLoc()));
+    remove_comments_in_range(decl->getBeginLoc(), decl->getEndLoc());
   }
 
-  for (auto& [_, comment] : ordered_comments) {
-    items.push_back({GetSourceOrderKey(comment), GenerateItemId(comment)});
+  for (size_t i = first_comment; i < last_comment; ++i) {
+    if (!is_free_comment[i - first_comment]) continue;
+    items.push_back(
+        {GetSourceOrderKey(comments_[i]), GenerateItemId(comments_[i])});
   }
   llvm::sort(items, compare_locations);
 
@@ -515,6 +615,37 @@ void Importer::ImportFreeComments() {
     }
   }
   llvm::sort(comments_, SourceLocationComparator(sm));
+
+  filtered_comments_.reserve(comments_.size());
+  comment_positions_.reserve(comments_.size());
+  for (const clang::RawComment* comment : comments_) {
+    filtered_comments_.push_back(IsFilteredComment(sm, *comment));
+    std::optional<uint64_t> position =
+        GetTranslationUnitPositions().GetPosition(comment->getBeginLoc());
+    if (position.has_value()) comment_positions_.push_back(*position);
+  }
+  // Positions are only used if all comments have one, e.g. not when the
+  // headers come from a module.
+  if (comment_positions_.size() != comments_.size()) comment_positions_.clear();
+}
+
+std::pair<size_t, size_t> Importer::GetCommentsInRange(
+    clang::SourceLocation begin, clang::SourceLocation end) const {
+  const TranslationUnitPositions& positions = GetTranslationUnitPositions();
+  std::optional<uint64_t> begin_position = positions.GetPosition(begin);
+  std::optional<uint64_t> end_position = positions.GetPosition(end);
+  if (!comment_positions_.empty() && begin_position.has_value() &&
+      end_position.has_value()) {
+    return {llvm::lower_bound(comment_positions_, *begin_position) -
+                comment_positions_.begin(),
+            llvm::upper_bound(comment_positions_, *end_position) -
+                comment_positions_.begin()};
+  }
+  auto compare_locations = SourceLocationComparator(ctx_.getSourceManager());
+  return {llvm::lower_bound(comments_, begin, compare_locations) -
+              comments_.begin(),
+          llvm::upper_bound(comments_, end, compare_locations) -
+              comments_.begin()};
 }
 
 void Importer::Import(clang::TranslationUnitDecl* translation_unit_decl) {
@@ -530,7 +661,11 @@ void Importer::Import(clang::TranslationUnitDecl* translation_unit_decl) {
                  .id = GenerateItemId(comment)}});
   }
 
+  if (invocation_.template_instantiation_budget_ >= 0) {
+    CollectAliasedTemplateInstantiations(translation_unit_decl);
+  }
   ImportDeclsFromDeclContext(translation_unit_decl);
+  if (invocation_.lazy_import_) ImportEnclosingNamespaces();
   for (const auto& [decl, item] : import_cache_) {
     if (item.has_value()) {
       if (std::holds_alternative<UnsupportedItem>(*item) &&
@@ -559,10 +694,70 @@ void Importer::Import(clang::TranslationUnitDecl* translation_unit_decl) {
 void Importer::ImportDeclsFromDeclContext(
     const clang::DeclContext* decl_context) {
   for (auto decl : GetCanonicalChildren(decl_context)) {
-    GetDeclItem(decl);
+    if (ShouldImportWithDeclContext(decl)) GetDeclItem(decl);
+  }
+}
+
+bool Importer::ShouldImportWithDeclContext(const clang::Decl* decl) const {
+  return !invocation_.lazy_import_ || IsFromCurrentTarget(decl);
+}
+
+void Importer::ImportEnclosingNamespaces() {
+  std::vector<clang::NamespaceDecl*> namespaces;
+  for (const auto& [decl, item] : import_cache_) {
+    if (!item.has_value()) continue;
+    for (const clang::DeclContext* decl_context = decl->getDeclContext();
+         decl_context != nullptr; decl_context = decl_context->getParent()) {
+      if (const auto* namespace_decl =
+              clang::dyn_cast<clang::NamespaceDecl>(decl_context)) {
+        namespaces.push_back(const_cast<clang::NamespaceDecl*>(namespace_decl));
+      }
+    }
+  }
+  // Importing a namespace of another target imports none of its children, so
+  // this doesn't add items whose namespaces would be missing in turn.
+  for (clang::NamespaceDecl* namespace_decl : namespaces) {
+    GetDeclItem(namespace_decl);
+  }
+}
+
+void Importer::CollectAliasedTemplateInstantiations(
+    const clang::DeclContext* decl_context) {
+  for (const clang::Decl* decl : decl_context->decls()) {
+    if (const auto* alias = clang::dyn_cast<clang::TypedefNameDecl>(decl)) {
+      if (const auto* specialization =
+              clang::dyn_cast_or_null<clang::ClassTemplateSpecializationDecl>(
+                  alias->getUnderlyingType()->getAsCXXRecordDecl())) {
+        aliased_template_instantiations_.insert(
+            specialization->getCanonicalDecl());
+      }
+    } else if (clang::isa<clang::NamespaceDecl, clang::LinkageSpecDecl>(decl)) {
+      CollectAliasedTemplateInstantiations(
+          clang::cast<clang::DeclContext>(decl));
+    } else if (const auto* record_decl =
+                   clang::dyn_cast<clang::CXXRecordDecl>(decl);
+               record_decl != nullptr && !record_decl->isDependentContext()) {
+      CollectAliasedTemplateInstantiations(record_decl);
+    }
   }
 }
 
+bool Importer::ImportsReferencedMembersOnly(
+    const clang::ClassTemplateSpecializationDecl* decl) const {
+  return invocation_.template_instantiation_budget_ >= 0 &&
+         decl->getSpecializationKind() == clang::TSK_ImplicitInstantiation &&
+         !aliased_template_instantiations_.contains(decl->getCanonicalDecl());
+}
+
+bool Importer::TakeTemplateInstantiation() {
+  if (invocation_.template_instantiation_budget_ < 0) return true;
+  if (template_instantiations_ >= invocation_.template_instantiation_budget_) {
+    return false;
+  }
+  ++template_instantiations_;
+  return true;
+}
+
 std::optional<IR::Item> Importer::GetDeclItem(clang::Decl* decl) {
   // TODO(jeanpierreda): Move `decl->getCanonicalDecl()` from callers into here.
   if (auto it = import_cache_.find(decl); it != import_cache_.end()) {
@@ -684,13 +879,12 @@ std::optional<IR::Item> Importer::ImportDecl(clang::Decl* decl) {
   return std::nullopt;
 }
 
-std::optional<IR::Item> Importer::GetImportedItem(
-    const clang::Decl* decl) const {
+const IR::Item* Importer::GetImportedItem(const clang::Decl* decl) const {
   auto it = import_cache_.find(decl);
-  if (it != import_cache_.end()) {
-    return it->second;
+  if (it == import_cache_.end() || !it->second.has_value()) {
+    return nullptr;
   }
-  return std::nullopt;
+  return &*it->second;
 }
 
 BazelLabel Importer::GetOwningTarget(const clang::Decl* decl) const {
@@ -734,21 +928,53 @@ bool Importer::IsFromCurrentTarget(const clang::Decl* decl) const {
   return invocation_.target_ == GetOwningTarget(decl);
 }
 
+std::optional<HeaderName> Importer::GetPublicHeader(
+    const clang::Decl* decl) const {
+  if (IsFullClassTemplateSpecializationOrChild(decl)) {
+    return std::nullopt;
+  }
+
+  // Like in `GetOwningTarget`, go up the include stack, until a public header
+  // is found.
+  clang::SourceManager& source_manager = ctx_.getSourceManager();
+  auto source_location = decl->getLocation();
+  while (source_location.isValid()) {
+    if (source_location.isMacroID()) {
+      source_location = source_manager.getExpansionLoc(source_location);
+    }
+    auto id = source_manager.getFileID(source_location);
+    std::optional<llvm::StringRef> filename =
+        source_manager.getNonBuiltinFilenameForID(id);
+    if (!filename) {
+      return std::nullopt;
+    }
+    if (filename->starts_with("./")) {
+      filename = filename->substr(2);
+    }
+    HeaderName header(filename->str());
+    if (invocation_.is_public_header(header)) {
+      return header;
+    }
+    source_location = source_manager.getIncludeLoc(id);
+  }
+  return std::nullopt;
+}
+
 IR::Item Importer::ImportUnsupportedItem(const clang::Decl* decl,
                                          FormattedError error) {
-  std::string name = "unnamed";
-  if (const auto* named_decl = clang::dyn_cast<clang::NamedDecl>(decl)) {
-    name = named_decl->getQualifiedNameAsString();
-  }
-  std::string source_loc = ConvertSourceLocation(decl->getBeginLoc());
-  return UnsupportedItem{.name = name,
-                         .errors = {error},
-                         .source_loc = source_loc,
-                         .id = GenerateItemId(decl)};
+  return ImportUnsupportedItem(decl,
+                               std::vector<FormattedError>{std::move(error)});
 }
 
 IR::Item Importer::ImportUnsupportedItem(const clang::Decl* decl,
                                          std::vector<FormattedError> errors) {
+  if (invocation_.lean_unsupported_items_) {
+    // Only the error formats are kept, see
+    // `Invocation::lean_unsupported_items_`.
+    for (FormattedError& error : errors) error.message.clear();
+    return UnsupportedItem{.errors = std::move(errors),
+                           .id = GenerateItemId(decl)};
+  }
   std::string name = "unnamed";
   if (const auto* named_decl = clang::dyn_cast<clang::NamedDecl>(decl)) {
     name = named_decl->getQualifiedNameAsString();
@@ -828,9 +1054,7 @@ std::string Importer::ConvertSourceLocation(clang::SourceLocation loc) const {
     spelling_loc_str = kSourceLocUnknown;
   } else {
     uint32_t spelling_line = sm.getSpellingLineNumber(loc);
-    if (absl::StartsWith(spelling_filename, "./")) {
-      spelling_filename = spelling_filename.substr(2);
-    }
+    spelling_filename = GetRelativeFilename(spelling_filename);
     spelling_loc_str =
         kSourceLocationFunc(kGeneratedFrom, spelling_filename, spelling_line);
   }
@@ -844,9 +1068,7 @@ std::string Importer::ConvertSourceLocation(clang::SourceLocation loc) const {
     expansion_loc_str = kSourceLocUnknown;
   } else {
     uint32_t expansion_line = sm.getExpansionLineNumber(loc);
-    if (absl::StartsWith(expansion_filename, "./")) {
-      expansion_filename = expansion_filename.substr(2);
-    }
+    expansion_filename = GetRelativeFilename(expansion_filename);
     expansion_loc_str =
         kSourceLocationFunc(kExpandedAt, expansion_filename, expansion_line);
   }
@@ -868,9 +1090,23 @@ absl::StatusOr<MappedType> Importer::ConvertTemplateSpecializationType(
         type_string));
   }
 
+  if (std::optional<MappedType> unique_ptr =
+          ConvertUniquePtrType(specialization_decl)) {
+    return *std::move(unique_ptr);
+  }
+
   if (HasBeenAlreadySuccessfullyImported(specialization_decl))
     return ConvertTypeDecl(specialization_decl);
 
+  // Only the instantiations that the C++ code doesn't need on its own count
+  // towards the budget.
+  if (!specialization_decl->hasDefinition() && !TakeTemplateInstantiation()) {
+    return absl::InvalidArgumentError(absl::Substitute(
+        "Not instantiating template specialization type $0: the budget of $1 "
+        "template instantiations is exhausted",
+        type_string, invocation_.template_instantiation_budget_));
+  }
+
   // `Sema::isCompleteType` will try to instantiate the class template as a
   // side-effect and we rely on this here. `decl->getDefinition()` can
   // return nullptr before the call to sema and return its definition
@@ -910,8 +1146,113 @@ absl::StatusOr<MappedType> Importer::ConvertTemplateSpecializationType(
   return ConvertTypeDecl(specialization_decl);
 }
 
+// Returns whether `deleter_type` is `std::default_delete<pointee_type>`.
+static bool IsDefaultDeleteOf(const clang::ASTContext& ctx,
+                              clang::QualType deleter_type,
+                              clang::QualType pointee_type) {
+  const auto* deleter_decl =
+      clang::dyn_cast_or_null<clang::ClassTemplateSpecializationDecl>(
+          deleter_type->getAsCXXRecordDecl());
+  if (deleter_decl == nullptr || !deleter_decl->isInStdNamespace() ||
+      deleter_decl->getName() != "default_delete") {
+    return false;
+  }
+  const clang::TemplateArgumentList& args = deleter_decl->getTemplateArgs();
+  return args.size() == 1 &&
+         args[0].getKind() == clang::TemplateArgument::Type &&
+         ctx.hasSameType(args[0].getAsType(), pointee_type);
+}
+
+// Returns whether `delete` on a `record*` is exactly a call to the destructor
+// of `record` followed by the global `operator delete`, which is what
+// `UniquePtr<T>` does when it is dropped.
+static bool IsDeletedByGlobalOperatorDelete(clang::Sema& sema,
+                                            clang::CXXRecordDecl* record) {
+  // A virtual destructor may destroy (and deallocate) a derived object.
+  if (record->isDynamicClass()) return false;
+  auto has_operator_delete = [](const clang::CXXRecordDecl* record) {
+    clang::DeclarationName name =
+        record->getASTContext().DeclarationNames.getCXXOperatorName(
+            clang::OO_Delete);
+    return !record->lookup(name).empty();
+  };
+  if (has_operator_delete(record)) return false;
+  if (!record->forallBases([&](const clang::CXXRecordDecl* base) {
+        return !has_operator_delete(base);
+      })) {
+    return false;
+  }
+  clang::CXXDestructorDecl* destructor = sema.LookupDestructor(record);
+  return destructor != nullptr && !destructor->isDeleted() &&
+         destructor->getAccess() == clang::AS_public;
+}
+
+std::optional<MappedType> Importer::ConvertUniquePtrType(
+    clang::ClassTemplateSpecializationDecl* specialization_decl) {
+  // The bindings of the standard library itself can't name `::cc_std`.
+  if (!specialization_decl->isInStdNamespace() ||
+      specialization_decl->getName() != "unique_ptr" ||
+      IsFromCurrentTarget(specialization_decl->getSpecializedTemplate())) {
+    return std::nullopt;
+  }
+  const clang::TemplateArgumentList& args =
+      specialization_decl->getTemplateArgs();
+  if (args.size() != 2 || args[0].getKind() != clang::TemplateArgument::Type ||
+      args[1].getKind() != clang::TemplateArgument::Type) {
+    return std::nullopt;
+  }
+  clang::QualType pointee_type = args[0].getAsType();
+  // Arrays are deleted with `delete[]`, and other deleters run their own code.
+  if (pointee_type->isArrayType() ||
+      !IsDefaultDeleteOf(ctx_, args[1].getAsType(), pointee_type)) {
+    return std::nullopt;
+  }
+
+  if (!specialization_decl->hasDefinition() && !TakeTemplateInstantiation()) {
+    return std::nullopt;
+  }
+  clang::QualType unique_ptr_type = ctx_.getRecordType(specialization_decl);
+  bool is_complete = false;
+  crubit::RecordingDiagnosticConsumer diagnostic_recorder =
+      crubit::RecordDiagnostics(sema_.getDiagnostics(), [&] {
+        clang::SourceLocation loc = specialization_decl->getLocation();
+        is_complete = sema_.isCompleteType(loc, unique_ptr_type) &&
+                      sema_.isCompleteType(loc, pointee_type);
+      });
+  if (!is_complete || diagnostic_recorder.getNumErrors() != 0) {
+    return std::nullopt;
+  }
+  if (ctx_.getTypeSize(unique_ptr_type) != ctx_.getTypeSize(ctx_.VoidPtrTy) ||
+      ctx_.getTypeAlign(unique_ptr_type) != ctx_.getTypeAlign(ctx_.VoidPtrTy)) {
+    return std::nullopt;
+  }
+  if (clang::CXXRecordDecl* pointee_record =
+          pointee_type->getAsCXXRecordDecl();
+      pointee_record != nullptr &&
+      !IsDeletedByGlobalOperatorDelete(sema_, pointee_record)) {
+    return std::nullopt;
+  }
+
+  absl::StatusOr<MappedType> mapped_pointee_type =
+      ConvertQualType(pointee_type, /*lifetimes=*/nullptr,
+                      /*ref_qualifier_kind=*/std::nullopt);
+  if (!mapped_pointee_type.ok()) return std::nullopt;
+
+  // Spelled like the template specializations in cxx_record.cc, so that the
+  // thunks name `T` by its namespace-qualified, desugared name.
+  clang::PrintingPolicy policy(ctx_.getLangOpts());
+  policy.IncludeTagDefinition = false;
+  policy.PrintCanonicalTypes = true;
+  policy.UsePreferredNames = false;
+  policy.AlwaysIncludeTypeForTemplateArgument = true;
+  return MappedType::UniquePtrTo(
+      *std::move(mapped_pointee_type), unique_ptr_type.getAsString(policy),
+      specialization_decl->getDefinition()->canPassInRegisters());
+}
+
 absl::StatusOr<MappedType> Importer::ConvertTypeDecl(clang::NamedDecl* decl) {
   if (!EnsureSuccessfullyImported(decl)) {
+    unimported_type_decls_.insert(CanonicalizeDecl(decl));
     return absl::NotFoundError(absl::Substitute(
         "No generated bindings found for '$0'", decl->getNameAsString()));
   }
@@ -964,7 +1305,8 @@ absl::StatusOr<MappedType> Importer::ConvertUnattributedType(
   assert(!lifetimes || IsSameCanonicalUnqualifiedType(
                            lifetimes->Type(), clang::QualType(type, 0)));
 
-  if (auto override_type = GetTypeMapOverride(*type);
+  if (auto override_type = GetTypeMapOverride(
+          *type, invocation_.string_view_as_slice_pointer_);
       override_type.has_value()) {
     return *std::move(override_type);
   } else if (type->isPointerType() || type->isLValueReferenceType() ||
@@ -1101,6 +1443,14 @@ absl::StatusOr<MappedType> Importer::ConvertUnattributedType(
         return absl::UnimplementedError("Unsupported builtin type");
     }
   } else if (const auto* tag_type = type->getAsAdjusted<clang::TagType>()) {
+    if (auto* specialization_decl =
+            clang::dyn_cast<clang::ClassTemplateSpecializationDecl>(
+                tag_type->getDecl())) {
+      if (std::optional<MappedType> unique_ptr =
+              ConvertUniquePtrType(specialization_decl)) {
+        return *std::move(unique_ptr);
+      }
+    }
     return ConvertTypeDecl(tag_type->getDecl());
   } else if (const auto* typedef_type =
                  type->getAsAdjusted<clang::TypedefType>()) {
@@ -1149,6 +1499,30 @@ absl::StatusOr<MappedType> Importer::ConvertQualType(
     const clang::tidy::lifetimes::ValueLifetimes* lifetimes,
     std::optional<clang::RefQualifierKind> ref_qualifier_kind, bool nullable) {
   qual_type = GetUnelaboratedType(std::move(qual_type), ctx_);
+
+  // Lifetimes are only known by their address, which may be reused by the
+  // lifetimes of a later decl, so types with lifetimes aren't cached.
+  if (lifetimes != nullptr) {
+    return ConvertUncachedQualType(qual_type, lifetimes, ref_qualifier_kind,
+                                   nullable);
+  }
+  TypeCacheKey key(qual_type.getAsOpaquePtr(), ref_qualifier_kind, nullable);
+  if (auto it = type_cache_.find(key); it != type_cache_.end()) {
+    return it->second;
+  }
+  // Converting the type may import decls that convert the same type again, so
+  // the result is only cached once it's complete, and replaces the result of
+  // any such nested conversion.
+  absl::StatusOr<MappedType> type = ConvertUncachedQualType(
+      qual_type, /*lifetimes=*/nullptr, ref_qualifier_kind, nullable);
+  type_cache_.insert_or_assign(key, type);
+  return type;
+}
+
+absl::StatusOr<MappedType> Importer::ConvertUncachedQualType(
+    clang::QualType qual_type,
+    const clang::tidy::lifetimes::ValueLifetimes* lifetimes,
+    std::optional<clang::RefQualifierKind> ref_qualifier_kind, bool nullable) {
   std::string type_string = qual_type.getAsString();
   absl::StatusOr<MappedType> type = ConvertType(
       qual_type.getTypePtr(), lifetimes, ref_qualifier_kind, nullable);
@@ -1170,6 +1544,17 @@ absl::StatusOr<MappedType> Importer::ConvertQualType(
 }
 
 std::string Importer::GetMangledName(const clang::NamedDecl* named_decl) const {
+  const clang::Decl* canonical_decl = named_decl->getCanonicalDecl();
+  if (auto it = mangled_names_.find(canonical_decl);
+      it != mangled_names_.end()) {
+    return it->second;
+  }
+  std::string name = MangleName(named_decl);
+  mangled_names_.emplace(canonical_decl, name);
+  return name;
+}
+
+std::string Importer::MangleName(const clang::NamedDecl* named_decl) const {
   if (auto record_decl = clang::dyn_cast<clang::RecordDecl>(named_decl)) {
     // Mangled record names are used to 1) provide valid Rust identifiers for
     // C++ template specializations, and 2) help build unique names for virtual
@@ -1267,6 +1652,18 @@ std::string Importer::GetNameForSourceOrder(const clang::Decl* decl) const {
 
 absl::StatusOr<UnqualifiedIdentifier> Importer::GetTranslatedName(
     const clang::NamedDecl* named_decl) const {
+  const clang::Decl* canonical_decl = named_decl->getCanonicalDecl();
+  if (auto it = translated_names_.find(canonical_decl);
+      it != translated_names_.end()) {
+    return it->second;
+  }
+  absl::StatusOr<UnqualifiedIdentifier> name = TranslateName(named_decl);
+  translated_names_.emplace(canonical_decl, name);
+  return name;
+}
+
+absl::StatusOr<UnqualifiedIdentifier> Importer::TranslateName(
+    const clang::NamedDecl* named_decl) const {
   switch (named_decl->getDeclName().getNameKind()) {
     case clang::DeclarationName::Identifier: {
       auto name = std::string(named_decl->getName());
@@ -1316,8 +1713,14 @@ absl::StatusOr<UnqualifiedIdentifier> Importer::GetTranslatedName(
 }
 
 void Importer::MarkAsSuccessfullyImported(const clang::NamedDecl* decl) {
-  known_type_decls_.insert(
-      clang::cast<clang::TypeDecl>(CanonicalizeDecl(decl)));
+  const auto* type_decl = clang::cast<clang::TypeDecl>(CanonicalizeDecl(decl));
+  known_type_decls_.insert(type_decl);
+  // Types that failed to convert because this decl wasn't imported yet (e.g.
+  // because it was still being imported) may convert now.
+  if (unimported_type_decls_.erase(type_decl)) {
+    absl::erase_if(type_cache_,
+                   [](const auto& entry) { return !entry.second.ok(); });
+  }
 }
 
 bool Importer::HasBeenAlreadySuccessfullyImported(
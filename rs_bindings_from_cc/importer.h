@@ -5,20 +5,26 @@
 #ifndef CRUBIT_RS_BINDINGS_FROM_CC_IMPORTER_H_
 #define CRUBIT_RS_BINDINGS_FROM_CC_IMPORTER_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <set>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/check.h"
 #include "absl/log/die_if_null.h"
 #include "absl/status/statusor.h"
 #include "common/status_macros.h"
 #include "lifetime_annotations/type_lifetimes.h"
+#include "rs_bindings_from_cc/ast_util.h"
 #include "rs_bindings_from_cc/bazel_types.h"
 #include "rs_bindings_from_cc/decl_importer.h"
 #include "rs_bindings_from_cc/importers/class_template.h"
@@ -49,7 +55,8 @@ class Importer final : public ImportContext {
   explicit Importer(Invocation& invocation, clang::ASTContext& ctx,
                     clang::Sema& sema)
       : ImportContext(invocation, ctx, sema),
-        mangler_(ABSL_DIE_IF_NULL(ctx_.createMangleContext())) {
+        mangler_(ABSL_DIE_IF_NULL(ctx_.createMangleContext())),
+        working_directory_(GetWorkingDirectory(ctx)) {
     decl_importers_.push_back(std::make_unique<TypeMapOverrideImporter>(*this));
     decl_importers_.push_back(
         std::make_unique<ClassTemplateDeclImporter>(*this));
@@ -79,8 +86,7 @@ class Importer final : public ImportContext {
   IR::Item ImportUnsupportedItem(const clang::Decl* decl,
                                  std::set<std::string> messages) override;
   std::optional<IR::Item> ImportDecl(clang::Decl* decl) override;
-  std::optional<IR::Item> GetImportedItem(
-      const clang::Decl* decl) const override;
+  const IR::Item* GetImportedItem(const clang::Decl* decl) const override;
 
   ItemId GenerateItemId(const clang::Decl* decl) const override;
   ItemId GenerateItemId(const clang::RawComment* comment) const override;
@@ -91,6 +97,8 @@ class Importer final : public ImportContext {
   std::string GetMangledName(const clang::NamedDecl* named_decl) const override;
   BazelLabel GetOwningTarget(const clang::Decl* decl) const override;
   bool IsFromCurrentTarget(const clang::Decl* decl) const override;
+  std::optional<HeaderName> GetPublicHeader(
+      const clang::Decl* decl) const override;
   absl::StatusOr<UnqualifiedIdentifier> GetTranslatedName(
       const clang::NamedDecl* named_decl) const override;
   absl::StatusOr<Identifier> GetTranslatedIdentifier(
@@ -103,6 +111,7 @@ class Importer final : public ImportContext {
   }
   std::optional<std::string> GetComment(const clang::Decl* decl) const override;
   std::string ConvertSourceLocation(clang::SourceLocation loc) const override;
+  // Results, including errors, are cached for types without lifetimes.
   absl::StatusOr<MappedType> ConvertQualType(
       clang::QualType qual_type,
       const clang::tidy::lifetimes::ValueLifetimes* lifetimes,
@@ -119,6 +128,10 @@ class Importer final : public ImportContext {
     return HasBeenAlreadySuccessfullyImported(decl);
   }
 
+  bool ImportsReferencedMembersOnly(
+      const clang::ClassTemplateSpecializationDecl* decl) const override;
+  bool TakeTemplateInstantiation() override;
+
  private:
   class SourceOrderKey;
   class SourceLocationComparator;
@@ -129,6 +142,28 @@ class Importer final : public ImportContext {
   // Returns a SourceOrderKey for the given `comment` that should be used for
   // ordering Items.
   SourceOrderKey GetSourceOrderKey(const clang::RawComment* comment) const;
+  // Returns the positions of source locations that SourceOrderKeys use, which
+  // are computed on first use, once the whole translation unit has been
+  // parsed.
+  const TranslationUnitPositions& GetTranslationUnitPositions() const;
+
+  // Returns the working directory of the file system of `ctx`, with a trailing
+  // separator, or an empty string if it is unknown.
+  static std::string GetWorkingDirectory(clang::ASTContext& ctx);
+  // Returns `filename` relative to the working directory (the execroot, when
+  // run by Bazel) if it is in it, and without a leading `./`, so that the IR
+  // doesn't depend on where the workspace is checked out.
+  absl::string_view GetRelativeFilename(absl::string_view filename) const;
+  // Returns `loc` as `file:line:column`, with the file relative to the working
+  // directory.
+  std::string PrintSourceLocation(clang::SourceLocation loc) const;
+
+  // Returns the key from which the ItemId of `decl` is derived: its kind and
+  // USR, or its kind and location if it has no USR.
+  std::string GetItemIdKey(const clang::Decl* decl) const;
+  // Returns the id for `key_object`, allocating it from `key` on first use.
+  ItemId GetOrAllocateItemId(const void* key_object,
+                             absl::FunctionRef<std::string()> key) const;
 
   // Returns a name for `decl` that should be used for ordering declarations.
   std::string GetNameForSourceOrder(const clang::Decl* decl) const;
@@ -141,12 +176,33 @@ class Importer final : public ImportContext {
   std::optional<IR::Item> GetDeclItem(clang::Decl* decl) override;
   // Stores the comments of this target in source order.
   void ImportFreeComments();
+  // Returns the range of indices of the `comments_` that begin between `begin`
+  // and `end`, inclusive.
+  std::pair<size_t, size_t> GetCommentsInRange(clang::SourceLocation begin,
+                                               clang::SourceLocation end) const;
+
+  // Returns whether `decl` should be imported when its decl context is, rather
+  // than only when something refers to it. See `Invocation::lazy_import_`.
+  bool ShouldImportWithDeclContext(const clang::Decl* decl) const;
+  // Imports the namespaces that enclose the imported items, which only the
+  // decls of the current target import on their own when `lazy_import_`.
+  void ImportEnclosingNamespaces();
+  // Adds the class template specializations that the type aliases in
+  // `decl_context` (and in its nested namespaces and records) name to
+  // `aliased_template_instantiations_`.
+  void CollectAliasedTemplateInstantiations(
+      const clang::DeclContext* decl_context);
 
   clang::Decl* CanonicalizeDecl(clang::Decl* decl) const;
   const clang::Decl* CanonicalizeDecl(const clang::Decl* decl) const;
 
   std::vector<clang::Decl*> GetCanonicalChildren(
       const clang::DeclContext* decl_context) const;
+  // Implements ConvertQualType(), without caching.
+  absl::StatusOr<MappedType> ConvertUncachedQualType(
+      clang::QualType qual_type,
+      const clang::tidy::lifetimes::ValueLifetimes* lifetimes,
+      std::optional<clang::RefQualifierKind> ref_qualifier_kind, bool nullable);
   // Converts a type to a MappedType.
   //
   // ref_qualifier_kind is the member function reference qualifier, e.g., `&`
@@ -169,15 +225,61 @@ class Importer final : public ImportContext {
   absl::StatusOr<MappedType> ConvertTemplateSpecializationType(
       const clang::TemplateSpecializationType* type);
 
+  // Returns the mapping of `specialization_decl` to
+  // `::cc_std::unique_ptr::UniquePtr<T>` if it is a `std::unique_ptr<T>` with
+  // the default deleter, laid out as a single pointer, whose `T` can be deleted
+  // by `UniquePtr` (see support/cc_std/unique_ptr.rs). Returns nullopt
+  // otherwise, and the specialization is imported like any other.
+  std::optional<MappedType> ConvertUniquePtrType(
+      clang::ClassTemplateSpecializationDecl* specialization_decl);
+
+  // The uncached implementations of GetMangledName() and GetTranslatedName().
+  std::string MangleName(const clang::NamedDecl* named_decl) const;
+  absl::StatusOr<UnqualifiedIdentifier> TranslateName(
+      const clang::NamedDecl* named_decl) const;
+
   // The different decl importers. Note that order matters: the first importer
   // to successfully match a decl "wins", and no other importers are tried.
   std::vector<std::unique_ptr<DeclImporter>> decl_importers_;
   std::unique_ptr<clang::MangleContext> mangler_;
+  // The working directory that GetRelativeFilename() makes paths relative to,
+  // with a trailing separator, or empty if it is unknown.
+  std::string working_directory_;
   absl::flat_hash_map<const clang::Decl*, std::optional<IR::Item>>
       import_cache_;
   absl::flat_hash_set<const clang::ClassTemplateSpecializationDecl*>
       class_template_instantiations_;
+  // The canonical decls of the class template specializations that are named
+  // by a type alias, which import all their members even if
+  // `Invocation::template_instantiation_budget_` is set.
+  absl::flat_hash_set<const clang::Decl*> aliased_template_instantiations_;
+  // The number of instantiations taken by TakeTemplateInstantiation().
+  int template_instantiations_ = 0;
   std::vector<const clang::RawComment*> comments_;
+  // Whether each of `comments_` is left out of the items of its decl context,
+  // see IsFilteredComment().
+  std::vector<bool> filtered_comments_;
+  // The positions of the beginnings of `comments_`, if they are all known.
+  std::vector<uint64_t> comment_positions_;
+  mutable std::optional<TranslationUnitPositions> tu_positions_;
+  // The results of ConvertQualType() for types without lifetimes, keyed by the
+  // type (with its sugar, so that typedefs keep their own mapping), the ref
+  // qualifier and the nullability.
+  using TypeCacheKey =
+      std::tuple<const void*, std::optional<clang::RefQualifierKind>, bool>;
+  absl::flat_hash_map<TypeCacheKey, absl::StatusOr<MappedType>> type_cache_;
+  // The decls that a type failed to convert for because they weren't imported,
+  // which invalidate the cached errors once they are.
+  absl::flat_hash_set<const clang::Decl*> unimported_type_decls_;
+  // The ids generated by GenerateItemId(), which are allocated on first use.
+  mutable absl::flat_hash_map<const void*, ItemId> item_ids_;
+  // The results of GetMangledName() and GetTranslatedName(), keyed by the
+  // canonical decl, as they are the same for all redeclarations and are asked
+  // for repeatedly (e.g. for source order and for thunk names).
+  mutable absl::flat_hash_map<const clang::Decl*, std::string> mangled_names_;
+  mutable absl::flat_hash_map<const clang::Decl*,
+                              absl::StatusOr<UnqualifiedIdentifier>>
+      translated_names_;
 
   // Set of decls that have been successfully imported (i.e. that will be
   // present in the IR output / that will not produce dangling ItemIds in the IR
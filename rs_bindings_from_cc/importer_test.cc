@@ -2,6 +2,7 @@
 // Exceptions. See /LICENSE for license information.
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
+#include <memory>
 #include <optional>
 #include <string>
 #include <variant>
@@ -11,11 +12,25 @@
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "common/status_test_matchers.h"
+#include "lifetime_analysis/lifetime_summaries.h"
+#include "lifetime_annotations/function_lifetimes.h"
+#include "lifetime_annotations/lifetime_annotations.h"
 #include "rs_bindings_from_cc/bazel_types.h"
 #include "rs_bindings_from_cc/ir.h"
 #include "rs_bindings_from_cc/ir_from_cc.h"
+#include "rs_bindings_from_cc/type_manifest.h"
+#include "clang/AST/Decl.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
 
 namespace crubit {
 namespace {
@@ -355,6 +370,262 @@ TEST(ImporterTest, TwoFuncsFromTwoHeaders) {
                                    VariantWith<Func>(IdentifierIs("Bar"))));
 }
 
+TEST(ImporterTest, LazyImport) {
+  ASSERT_OK_AND_ASSIGN(
+      IR ir,
+      IrFromCc({.current_target = BazelLabel{"//test:current"},
+                .public_headers = {HeaderName("test/dep.h"),
+                                   HeaderName("test/current.h")},
+                .virtual_headers_contents_for_testing =
+                    {{HeaderName("test/dep.h"), R"cc(
+                       namespace dep {
+                       struct Used {};
+                       struct Unused {};
+                       void DepFunc();
+                       }  // namespace dep
+                     )cc"},
+                     {HeaderName("test/current.h"), "void F(dep::Used* u);"}},
+                .headers_to_targets =
+                    {
+                        {HeaderName("test/dep.h"), BazelLabel{"//test:dep"}},
+                        {HeaderName("test/current.h"),
+                         BazelLabel{"//test:current"}},
+                    },
+                .lazy_import = true}));
+  EXPECT_THAT(ItemsWithoutBuiltins(ir),
+              UnorderedElementsAre(VariantWith<Namespace>(IdentifierIs("dep")),
+                                   VariantWith<Record>(RsNameIs("Used")),
+                                   VariantWith<Func>(IdentifierIs("F"))));
+}
+
+constexpr absl::string_view kTemplateWithMethods = R"cc(
+  template <typename T>
+  struct Box final {
+    T value;
+    T Used() const { return value; }
+    T Unused() const { return value; }
+  };
+  struct Holder final {
+    Box<int> box;
+  };
+  inline int Get(const Holder& holder) { return holder.box.Used(); }
+)cc";
+
+TEST(ImporterTest, TemplateInstantiationBudgetImportsReferencedMethods) {
+  ASSERT_OK_AND_ASSIGN(
+      IR ir, IrFromCc({.extra_source_code_for_testing = kTemplateWithMethods,
+                       .template_instantiation_budget = 100}));
+  std::vector<const Func*> funcs = ir.get_items_if<Func>();
+  EXPECT_THAT(funcs, Contains(Pointee(IdentifierIs("Used"))));
+  EXPECT_THAT(funcs, Not(Contains(Pointee(IdentifierIs("Unused")))));
+}
+
+TEST(ImporterTest, TemplateInstantiationBudgetImportsAliasedTemplates) {
+  ASSERT_OK_AND_ASSIGN(
+      IR ir, IrFromCc({.extra_source_code_for_testing =
+                           absl::StrCat(kTemplateWithMethods,
+                                        "using IntBox = Box<int>;"),
+                       .template_instantiation_budget = 100}));
+  std::vector<const Func*> funcs = ir.get_items_if<Func>();
+  EXPECT_THAT(funcs, Contains(Pointee(IdentifierIs("Used"))));
+  EXPECT_THAT(funcs, Contains(Pointee(IdentifierIs("Unused"))));
+}
+
+TEST(ImporterTest, TemplateInstantiationBudgetIsExhausted) {
+  absl::string_view file = R"cc(
+    template <typename T>
+    struct Box final {
+      T value;
+    };
+    void Take(Box<int>* box);
+  )cc";
+  ASSERT_OK_AND_ASSIGN(IR ir,
+                       IrFromCc({.extra_source_code_for_testing = file,
+                                 .template_instantiation_budget = 1}));
+  EXPECT_THAT(ir.get_items_if<Func>(), Contains(Pointee(IdentifierIs("Take"))));
+
+  ASSERT_OK_AND_ASSIGN(ir,
+                       IrFromCc({.extra_source_code_for_testing = file,
+                                 .template_instantiation_budget = 0}));
+  EXPECT_THAT(ir.get_items_if<Func>(), IsEmpty());
+  EXPECT_THAT(
+      ir.get_items_if<UnsupportedItem>(),
+      Contains(Pointee(AllOf(
+          testing::Field("name", &UnsupportedItem::name, "Take"),
+          testing::Field("errors", &UnsupportedItem::errors,
+                         Contains(testing::Field(
+                             "message", &FormattedError::message,
+                             HasSubstr("the budget of 0 template "
+                                       "instantiations is exhausted"))))))));
+}
+
+TEST(ImporterTest, LeanUnsupportedItemsOnlyKeepIdsAndFormats) {
+  ASSERT_OK_AND_ASSIGN(
+      IR ir, IrFromCc({.extra_source_code_for_testing = R"cc(
+                         template <typename T>
+                         struct Box final {
+                           T value;
+                         };
+                         void Take(Box<int>* box);
+                       )cc",
+                       .template_instantiation_budget = 0,
+                       .lean_unsupported_items = true}));
+  std::vector<const UnsupportedItem*> unsupported =
+      ir.get_items_if<UnsupportedItem>();
+  ASSERT_THAT(unsupported, Not(IsEmpty()));
+  for (const UnsupportedItem* item : unsupported) {
+    EXPECT_THAT(item->name, IsEmpty());
+    EXPECT_THAT(item->source_loc, IsEmpty());
+    EXPECT_THAT(item->errors, Not(IsEmpty()));
+    for (const FormattedError& error : item->errors) {
+      EXPECT_THAT(error.message, IsEmpty());
+    }
+  }
+}
+
+// Mocks `std::string_view`, with the layout of libc++'s, because C++ standard
+// library headers aren't available to a unit test (see b/214344126).
+constexpr absl::string_view kStringViewMock = R"cc(
+  namespace std {
+  class __string_view {
+    const char* data_;
+    decltype(sizeof(0)) size_;
+  };
+  using string_view = __string_view;
+  }  // namespace std
+  namespace absl {
+  using string_view = std::string_view;
+  }  // namespace absl
+  namespace other {
+  using string_view = std::string_view;
+  }  // namespace other
+
+  void StdStringView(std::string_view sv);
+  void AbslStringView(absl::string_view sv);
+  void OtherStringView(other::string_view sv);
+)cc";
+
+TEST(ImporterTest, StringViewIsARecordByDefault) {
+  ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({kStringViewMock}));
+  EXPECT_THAT(ir.get_items_if<Func>(),
+              Contains(Pointee(AllOf(
+                  IdentifierIs("StdStringView"),
+                  ParamsAre(ParamType(RsTypeIs(NameIs(""))))))));
+}
+
+TEST(ImporterTest, StringViewAsSlicePointer) {
+  ASSERT_OK_AND_ASSIGN(
+      IR ir, IrFromCc({.extra_source_code_for_testing = kStringViewMock,
+                       .string_view_as_slice_pointer = true}));
+  std::vector<const Func*> funcs = ir.get_items_if<Func>();
+  EXPECT_THAT(funcs, Contains(Pointee(AllOf(
+                         IdentifierIs("StdStringView"),
+                         ParamsAre(ParamType(
+                             CcTypeIs(NameIs("std::string_view")),
+                             RsTypeIs(RsConstPointsTo(NameIs("[u8]")))))))));
+  EXPECT_THAT(funcs, Contains(Pointee(AllOf(
+                         IdentifierIs("AbslStringView"),
+                         ParamsAre(ParamType(
+                             CcTypeIs(NameIs("absl::string_view")),
+                             RsTypeIs(RsConstPointsTo(NameIs("[u8]")))))))));
+  // Only the standard spellings are mapped.
+  EXPECT_THAT(funcs, Contains(Pointee(AllOf(
+                         IdentifierIs("OtherStringView"),
+                         ParamsAre(ParamType(RsTypeIs(NameIs(""))))))));
+}
+
+TEST(ImporterTest, StringViewWithOtherLayoutIsNotMapped) {
+  // Mimics the layout of libstdc++'s `std::string_view`.
+  ASSERT_OK_AND_ASSIGN(
+      IR ir, IrFromCc({.extra_source_code_for_testing = R"cc(
+                         namespace std {
+                         class __string_view {
+                           decltype(sizeof(0)) size_;
+                           const char* data_;
+                         };
+                         using string_view = __string_view;
+                         }  // namespace std
+
+                         void StdStringView(std::string_view sv);
+                       )cc",
+                       .string_view_as_slice_pointer = true}));
+  EXPECT_THAT(ir.get_items_if<Func>(),
+              Contains(Pointee(AllOf(
+                  IdentifierIs("StdStringView"),
+                  ParamsAre(ParamType(RsTypeIs(NameIs(""))))))));
+}
+
+TEST(ImporterTest, UniquePtr) {
+  ASSERT_OK_AND_ASSIGN(
+      IR ir,
+      IrFromCc({.current_target = BazelLabel{"//test:current"},
+                .public_headers = {HeaderName("test/memory.h"),
+                                   HeaderName("test/current.h")},
+                .virtual_headers_contents_for_testing =
+                    {{HeaderName("test/memory.h"), R"cc(
+                       namespace std {
+                       template <typename T>
+                       struct default_delete {
+                         void operator()(T* p) const { delete p; }
+                       };
+                       template <typename T, typename D = default_delete<T>>
+                       class unique_ptr {
+                        public:
+                         unique_ptr(unique_ptr&& other);
+                         ~unique_ptr() { D()(p_); }
+
+                        private:
+                         T* p_;
+                       };
+                       }  // namespace std
+                     )cc"},
+                     {HeaderName("test/current.h"), R"cc(
+                       struct Foo {};
+                       struct WithOperatorDelete {
+                         static void operator delete(void* p);
+                       };
+                       void TakesFoo(std::unique_ptr<Foo> p);
+                       void TakesWithOperatorDelete(
+                           std::unique_ptr<WithOperatorDelete> p);
+                     )cc"}},
+                .headers_to_targets =
+                    {
+                        {HeaderName("test/memory.h"), BazelLabel{"//test:std"}},
+                        {HeaderName("test/current.h"),
+                         BazelLabel{"//test:current"}},
+                    }}));
+  std::optional<ItemId> foo_id = DeclIdForRecord(ir, "Foo");
+  ASSERT_TRUE(foo_id.has_value());
+  EXPECT_THAT(ir.get_items_if<Func>(),
+              Contains(Pointee(AllOf(
+                  IdentifierIs("TakesFoo"),
+                  ParamsAre(ParamType(RsTypeIs(
+                      NameIs("#UniquePtr"),
+                      RsTypeParamsAre(DeclIdIs(*foo_id)))))))));
+  // `delete` would call the class-specific `operator delete`.
+  EXPECT_THAT(ir.get_items_if<Func>(),
+              Not(Contains(Pointee(AllOf(
+                  IdentifierIs("TakesWithOperatorDelete"),
+                  ParamsAre(ParamType(RsTypeIs(NameIs("#UniquePtr"))))))));
+}
+
+TEST(ImporterTest, SourceLocationIsRelativeToWorkingDirectory) {
+  llvm::SmallString<256> working_directory;
+  ASSERT_FALSE(llvm::sys::fs::current_path(working_directory));
+  // A header that is found through an absolute include path.
+  HeaderName header(absl::StrCat(working_directory.str(), "/test/abs.h"));
+  ASSERT_OK_AND_ASSIGN(
+      IR ir,
+      IrFromCc({.current_target = BazelLabel{"//test:abs"},
+                .public_headers = {header},
+                .virtual_headers_contents_for_testing = {{header,
+                                                          "void Foo();"}},
+                .headers_to_targets = {{header, BazelLabel{"//test:abs"}}}}));
+  std::vector<const Func*> funcs = ir.get_items_if<Func>();
+  ASSERT_THAT(funcs, SizeIs(1));
+  EXPECT_EQ(funcs[0]->source_loc, "Generated from: google3/test/abs.h;l=1");
+}
+
 TEST(ImporterTest, NonInlineFunc) {
   ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({"void Foo() {}"}));
   EXPECT_THAT(ItemsWithoutBuiltins(ir),
@@ -400,6 +671,25 @@ TEST(ImporterTest, TestImportConstStructPointerFunc) {
                             ParamsAre(ParamType(is_ptr_to_const_s))))));
 }
 
+TEST(ImporterTest, RepeatedTypesKeepTheirSugar) {
+  ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({R"cc(
+    typedef int* IntPtr;
+    IntPtr Foo(int* a, IntPtr b, int* c);
+  )cc"}));
+  std::vector<const TypeAlias*> aliases = ir.get_items_if<TypeAlias>();
+  auto alias = llvm::find_if(aliases, [](const TypeAlias* alias) {
+    return alias->identifier.Ident() == "IntPtr";
+  });
+  ASSERT_NE(alias, aliases.end());
+
+  auto is_int_ptr_alias = CcTypeIs(DeclIdIs((*alias)->id));
+  EXPECT_THAT(ir.items,
+              Contains(VariantWith<Func>(AllOf(
+                  IdentifierIs("Foo"), ReturnType(is_int_ptr_alias),
+                  ParamsAre(ParamType(IsIntPtr()), ParamType(is_int_ptr_alias),
+                            ParamType(IsIntPtr()))))));
+}
+
 TEST(ImporterTest, TestImportReferenceFunc) {
   ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({"int& Foo(int& a);"}));
 
@@ -775,11 +1065,18 @@ TEST(ImporterTest, TrivialAbi) {
     struct [[clang::trivial_abi]] Nontrivial {
       Nontrivial(const Nontrivial&) {}
     };
+    struct [[clang::trivial_abi]] NontrivialMoveAndDestructor {
+      NontrivialMoveAndDestructor(NontrivialMoveAndDestructor&&) {}
+      ~NontrivialMoveAndDestructor() {}
+    };
+    struct NontrivialField {
+      Nontrivial field;
+    };
   )cc";
   ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({file}));
 
   std::vector<const Record*> records = ir.get_items_if<Record>();
-  EXPECT_THAT(records, SizeIs(3));
+  EXPECT_THAT(records, SizeIs(5));
   EXPECT_THAT(records, Each(Pointee(IsTrivialAbi())));
 }
 
@@ -788,11 +1085,17 @@ TEST(ImporterTest, NotTrivialAbi) {
     struct Nontrivial {
       Nontrivial(const Nontrivial&) {}
     };
+    struct NontrivialField {
+      Nontrivial field;
+    };
+    struct NontrivialDestructor {
+      ~NontrivialDestructor() {}
+    };
   )cc";
   ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({file}));
 
   std::vector<const Record*> records = ir.get_items_if<Record>();
-  EXPECT_THAT(records, SizeIs(1));
+  EXPECT_THAT(records, SizeIs(3));
   EXPECT_THAT(records, Each(Pointee(Not(IsTrivialAbi()))));
 }
 
@@ -832,6 +1135,71 @@ TEST(ImporterTest, TopLevelItemIds) {
           VariantWith<Comment>(TextIs("namespace top_level_namespace"))));
 }
 
+TEST(ImporterTest, ItemIdsAreReproducible) {
+  absl::string_view file = R"cc(
+    // Comment
+    struct S {
+      void Method();
+    };
+    namespace ns {
+    void Func();
+    }
+    namespace ns {
+    void OtherFunc();
+    }
+  )cc";
+  ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({file}));
+  ASSERT_OK_AND_ASSIGN(IR reimported_ir, IrFromCc({file}));
+  EXPECT_EQ(llvm::formatv("{0}", ir.ToJson()).str(),
+            llvm::formatv("{0}", reimported_ir.ToJson()).str());
+
+  // The two declarations of `ns` have the same USR, but are different items.
+  std::vector<const Namespace*> namespaces = ir.get_items_if<Namespace>();
+  ASSERT_THAT(namespaces, SizeIs(2));
+  EXPECT_NE(namespaces[0]->id, namespaces[1]->id);
+  EXPECT_EQ(namespaces[0]->canonical_namespace_id,
+            namespaces[1]->canonical_namespace_id);
+}
+
+TEST(ImporterTest, WriteJsonMatchesToJson) {
+  absl::string_view file = R"cc(
+    // Comment
+    struct S {
+      int field;
+      void Method(const S& other);
+    };
+    namespace ns {
+    enum E { kA, kB };
+    using Alias = E;
+    }
+  )cc";
+  ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({file}));
+  ir.crate_root_path = "__cc_template_instantiations_rs_api";
+  ir.crubit_features[BazelLabel("//other:target")] = {"supported"};
+  ir.crubit_features[BazelLabel("//:target")] = {"supported", "experimental"};
+  EXPECT_EQ(IrToCompactJson(ir), llvm::formatv("{0}", ir.ToJson()).str());
+}
+
+TEST(ImporterTest, OnlyDocComments) {
+  absl::string_view file = R"cc(
+    // Free comment
+
+    /// Doc comment
+    void Documented();
+    // Plain comment
+    void Undocumented();
+  )cc";
+  ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({.extra_source_code_for_testing = file,
+                                        .parse_all_comments = false}));
+  EXPECT_THAT(ir.get_items_if<Comment>(), IsEmpty());
+  EXPECT_THAT(ir.items, Contains(VariantWith<Func>(
+                            AllOf(IdentifierIs("Documented"),
+                                  DocCommentIs("Doc comment")))));
+  EXPECT_THAT(ir.items, Contains(VariantWith<Func>(
+                            AllOf(IdentifierIs("Undocumented"),
+                                  Not(DocCommentIs("Plain comment"))))));
+}
+
 TEST(ImporterTest, ForwardDeclarationAndDefinition) {
   absl::string_view file = R"cc(
     struct ForwardDeclaredStruct;
@@ -872,6 +1240,74 @@ TEST(ImporterTest, DuplicateForwardDeclarations) {
                          RsNameIs("ForwardDeclaredStructWithNoDefinition"))));
 }
 
+TEST(ImporterTest, ForwardDeclarationCompleteInDependency) {
+  absl::string_view file = R"cc(
+    namespace ns {
+    struct InDependency;
+    struct NotInDependency;
+    }  // namespace ns
+    struct Defined;
+    struct Defined {};
+  )cc";
+  DependencyTypes dependency_types = {
+      {"ns::InDependency", BazelLabel("//test:dependency")},
+      {"Defined", BazelLabel("//test:dependency")},
+  };
+  ASSERT_OK_AND_ASSIGN(
+      IR ir, IrFromCc({.extra_source_code_for_testing = file,
+                       .dependency_types = &dependency_types}));
+
+  std::vector<const IncompleteRecord*> records =
+      ir.get_items_if<IncompleteRecord>();
+  ASSERT_THAT(records, SizeIs(2));
+  EXPECT_EQ(records[0]->cc_name, "InDependency");
+  EXPECT_EQ(records[0]->owning_target, BazelLabel("//test:dependency"));
+  EXPECT_TRUE(records[0]->is_complete_in_dependency);
+  EXPECT_EQ(records[1]->cc_name, "NotInDependency");
+  EXPECT_EQ(records[1]->owning_target, BazelLabel("//test:testing_target"));
+  EXPECT_FALSE(records[1]->is_complete_in_dependency);
+  // The definition in the TU wins over the type manifest.
+  EXPECT_THAT(ir.get_items_if<Record>(),
+              ElementsAre(Pointee(RsNameIs("Defined"))));
+}
+
+TEST(ImporterTest, LifetimesFromSummaries) {
+  // A summary of the definition, as lifetime analysis would have stored it.
+  std::unique_ptr<clang::ASTUnit> definition = clang::tooling::buildASTFromCode(
+      "int* f(int* a, int* b) { return a; }");
+  ASSERT_NE(definition, nullptr);
+  const auto* f = clang::ast_matchers::selectFirst<clang::FunctionDecl>(
+      "f", clang::ast_matchers::match(
+               clang::ast_matchers::functionDecl(
+                   clang::ast_matchers::hasName("f"))
+                   .bind("f"),
+               definition->getASTContext()));
+  ASSERT_NE(f, nullptr);
+  llvm::Expected<clang::tidy::lifetimes::FunctionLifetimes> lifetimes =
+      clang::tidy::lifetimes::ParseLifetimeAnnotations(f, "a, b -> a");
+  ASSERT_TRUE(static_cast<bool>(lifetimes));
+  clang::tidy::lifetimes::LifetimeSummaryStore store;
+  ASSERT_TRUE(store.Add(f, *lifetimes));
+
+  absl::string_view file = "int* f(int* a, int* b);";
+  ASSERT_OK_AND_ASSIGN(IR ir,
+                       IrFromCc({.extra_source_code_for_testing = file,
+                                 .lifetime_summaries = &store}));
+  std::vector<const Func*> funcs = ir.get_items_if<Func>();
+  ASSERT_THAT(funcs, ElementsAre(Pointee(IdentifierIs("f"))));
+  std::vector<std::string> lifetime_names;
+  for (const LifetimeName& lifetime : funcs[0]->lifetime_params) {
+    lifetime_names.push_back(lifetime.name);
+  }
+  EXPECT_THAT(lifetime_names, ElementsAre("a", "b"));
+
+  // Without the summary, the function has no lifetimes.
+  ASSERT_OK_AND_ASSIGN(ir, IrFromCc({.extra_source_code_for_testing = file}));
+  funcs = ir.get_items_if<Func>();
+  ASSERT_THAT(funcs, ElementsAre(Pointee(IdentifierIs("f"))));
+  EXPECT_THAT(funcs[0]->lifetime_params, IsEmpty());
+}
+
 TEST(ImporterTest, RecordItemIds) {
   absl::string_view file = R"cc(
     struct TopLevelStruct {
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <iterator>
 #include <optional>
 #include <string>
 #include <utility>
@@ -31,6 +32,7 @@
 #include "clang/AST/CXXInheritance.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
 #include "clang/AST/PrettyPrinter.h"
 #include "clang/AST/RecordLayout.h"
 #include "clang/AST/Type.h"
@@ -121,6 +123,28 @@ absl::StatusOr<RecordType> TranslateRecordType(
   llvm::report_fatal_error("Unrecognized clang::TagKind");
 }
 
+// Returns the qualified name of `record_decl` as type manifests spell it (see
+// `TypeManifestToJson`), or nullopt if it is not a (non-template) record at
+// namespace scope.
+std::optional<std::string> TypeManifestName(
+    const clang::CXXRecordDecl* record_decl) {
+  if (record_decl->getName().empty() ||
+      clang::isa<clang::ClassTemplateSpecializationDecl>(record_decl)) {
+    return std::nullopt;
+  }
+  std::string name = record_decl->getName().str();
+  for (const clang::DeclContext* context = record_decl->getDeclContext();
+       !context->isTranslationUnit(); context = context->getParent()) {
+    if (clang::isa<clang::LinkageSpecDecl>(context)) continue;
+    const auto* namespace_decl = clang::dyn_cast<clang::NamespaceDecl>(context);
+    if (namespace_decl == nullptr || namespace_decl->isAnonymousNamespace()) {
+      return std::nullopt;
+    }
+    name = absl::StrCat(namespace_decl->getName().str(), "::", name);
+  }
+  return name;
+}
+
 }  // namespace
 
 std::optional<Identifier> CXXRecordDeclImporter::GetTranslatedFieldName(
@@ -300,13 +324,29 @@ std::optional<IR::Item> CXXRecordDeclImporter::Import(
 
   ictx_.MarkAsSuccessfullyImported(record_decl);
   if (!record_decl->isCompleteDefinition()) {
-    return IncompleteRecord{.cc_name = std::move(cc_name),
-                            .rs_name = std::move(rs_name),
-                            .id = ictx_.GenerateItemId(record_decl),
-                            .owning_target = ictx_.GetOwningTarget(record_decl),
-                            .unknown_attr = std::move(unknown_attr),
-                            .record_type = *record_type,
-                            .enclosing_item_id = *std::move(enclosing_item_id)};
+    BazelLabel owning_target = ictx_.GetOwningTarget(record_decl);
+    bool is_complete_in_dependency = false;
+    // A record that isn't defined anywhere in the TU may be defined by a
+    // dependency whose definition wasn't included.
+    if (ictx_.invocation_.dependency_types_ != nullptr &&
+        record_decl->getDefinition() == nullptr) {
+      if (std::optional<std::string> name = TypeManifestName(record_decl)) {
+        auto it = ictx_.invocation_.dependency_types_->find(*name);
+        if (it != ictx_.invocation_.dependency_types_->end()) {
+          owning_target = it->second;
+          is_complete_in_dependency = true;
+        }
+      }
+    }
+    return IncompleteRecord{
+        .cc_name = std::move(cc_name),
+        .rs_name = std::move(rs_name),
+        .id = ictx_.GenerateItemId(record_decl),
+        .owning_target = std::move(owning_target),
+        .unknown_attr = std::move(unknown_attr),
+        .record_type = *record_type,
+        .enclosing_item_id = *std::move(enclosing_item_id),
+        .is_complete_in_dependency = is_complete_in_dependency};
   }
 
   ictx_.sema_.ForceDeclarationOfImplicitMembers(record_decl);
@@ -334,8 +374,9 @@ std::optional<IR::Item> CXXRecordDeclImporter::Import(
       .unknown_attr = std::move(unknown_attr),
       .doc_comment = std::move(doc_comment),
       .source_loc = ictx_.ConvertSourceLocation(source_loc),
+      .public_header = ictx_.GetPublicHeader(record_decl),
       .unambiguous_public_bases = GetUnambiguousPublicBases(*record_decl),
-      .fields = ImportFields(record_decl),
+      .fields = ImportFields(record_decl, layout),
       .size_align =
           {
               .size = layout.getSize().getQuantity(),
@@ -346,6 +387,7 @@ std::optional<IR::Item> CXXRecordDeclImporter::Import(
       .copy_constructor = GetCopyCtorSpecialMemberFunc(*record_decl),
       .move_constructor = GetMoveCtorSpecialMemberFunc(*record_decl),
       .destructor = GetDestructorSpecialMemberFunc(*record_decl),
+      // Same as `__is_trivially_relocatable` for records.
       .is_trivial_abi = record_decl->canPassInRegisters(),
       .is_inheritable = !is_effectively_final,
       .is_abstract = record_decl->isAbstract(),
@@ -394,12 +436,12 @@ std::optional<IR::Item> CXXRecordDeclImporter::Import(
 }
 
 std::vector<Field> CXXRecordDeclImporter::ImportFields(
-    clang::CXXRecordDecl* record_decl) {
+    clang::CXXRecordDecl* record_decl, const clang::ASTRecordLayout& layout) {
   clang::AccessSpecifier default_access =
       record_decl->isClass() ? clang::AS_private : clang::AS_public;
   std::vector<Field> fields;
-  const clang::ASTRecordLayout& layout =
-      ictx_.ctx_.getASTRecordLayout(record_decl);
+  fields.reserve(std::distance(record_decl->field_begin(),
+                               record_decl->field_end()));
   for (const clang::FieldDecl* field_decl : record_decl->fields()) {
     clang::AccessSpecifier access = field_decl->getAccess();
     if (access == clang::AS_none) {
@@ -433,9 +475,8 @@ std::vector<Field> CXXRecordDeclImporter::ImportFields(
     if (field_record) {
       // If it is a record as a direct member, its item must be already
       // imported.
-      auto item = ictx_.GetImportedItem(field_record);
-      if (item.has_value()) {
-        if (const auto* record = std::get_if<Record>(&item.value())) {
+      if (const IR::Item* item = ictx_.GetImportedItem(field_record)) {
+        if (const auto* record = std::get_if<Record>(item)) {
           is_inheritable = record->is_inheritable;
         }
       }
@@ -474,6 +515,7 @@ std::vector<BaseClass> CXXRecordDeclImporter::GetUnambiguousPublicBases(
   //
   // However, lookupInBases does not recurse into a class once it's found.
   // So we need to call lookupInBases once per class, making this O(N^4).
+  if (record_decl.getNumBases() == 0) return {};
 
   llvm::SmallPtrSet<const clang::CXXRecordDecl*, 4> seen;
   std::vector<BaseClass> bases;
@@ -12,6 +12,7 @@
 #include "rs_bindings_from_cc/ir.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclCXX.h"
+#include "clang/AST/RecordLayout.h"
 
 namespace crubit {
 
@@ -23,7 +24,8 @@ class CXXRecordDeclImporter : public DeclImporterBase<clang::CXXRecordDecl> {
   std::optional<IR::Item> Import(clang::CXXRecordDecl*) override;
 
  private:
-  std::vector<Field> ImportFields(clang::CXXRecordDecl*);
+  std::vector<Field> ImportFields(clang::CXXRecordDecl*,
+                                  const clang::ASTRecordLayout& layout);
   std::vector<BaseClass> GetUnambiguousPublicBases(
       const clang::CXXRecordDecl& record_decl) const;
   std::optional<Identifier> GetTranslatedFieldName(
@@ -16,6 +16,7 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
+#include "lifetime_analysis/lifetime_summaries.h"
 #include "lifetime_annotations/lifetime.h"
 #include "lifetime_annotations/lifetime_annotations.h"
 #include "lifetime_annotations/lifetime_error.h"
@@ -27,6 +28,8 @@
 #include "rs_bindings_from_cc/recording_diagnostic_consumer.h"
 #include "clang/AST/Attr.h"
 #include "clang/AST/Attrs.inc"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
 #include "clang/AST/DeclarationName.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/Diagnostic.h"
@@ -50,6 +53,21 @@ static bool IsInStdNamespace(const clang::FunctionDecl* decl) {
   return false;
 }
 
+// Returns whether `decl` is a default, copy or move constructor, a copy or move
+// assignment operator or a destructor, which the bindings of a record need
+// even if nothing calls them.
+static bool IsSpecialMemberFunction(const clang::FunctionDecl* decl) {
+  if (const auto* ctor = clang::dyn_cast<clang::CXXConstructorDecl>(decl)) {
+    return ctor->isDefaultConstructor() || ctor->isCopyOrMoveConstructor();
+  }
+  if (const auto* method = clang::dyn_cast<clang::CXXMethodDecl>(decl)) {
+    return clang::isa<clang::CXXDestructorDecl>(method) ||
+           method->isCopyAssignmentOperator() ||
+           method->isMoveAssignmentOperator();
+  }
+  return false;
+}
+
 Identifier FunctionDeclImporter::GetTranslatedParamName(
     const clang::ParmVarDecl* param_decl) {
   int param_pos = param_decl->getFunctionScopeIndex();
@@ -103,6 +121,18 @@ std::optional<IR::Item> FunctionDeclImporter::Import(
   // invoke this method, which triggers instantiation when compiling the
   // generated bindings, which fails the build.
   if (template_decl_for_method) {
+    // Methods that neither the C++ code nor the bindings of the record need
+    // aren't imported when only reached through the types of other decls, so
+    // that mostly unused instantiations don't instantiate all their methods.
+    if (const auto* specialization_decl =
+            clang::dyn_cast<clang::ClassTemplateSpecializationDecl>(
+                function_decl->getDeclContext());
+        specialization_decl != nullptr &&
+        ictx_.ImportsReferencedMembersOnly(specialization_decl) &&
+        !function_decl->isReferenced() &&
+        !IsSpecialMemberFunction(function_decl)) {
+      return std::nullopt;
+    }
     // Some methods in STL are explicitly marked with
     // `__attribute__((exclude_from_explicit_instantiation))`, and attempt to
     // instantiate them may crash clang, so we skip them for now.
@@ -116,6 +146,14 @@ std::optional<IR::Item> FunctionDeclImporter::Import(
           });
     }
     if (!function_decl->isDefined() && !skip_instantiation) {
+      if (!ictx_.TakeTemplateInstantiation()) {
+        return ictx_.ImportUnsupportedItem(
+            function_decl,
+            absl::StrCat(
+                "Not instantiating the method template: the budget of ",
+                ictx_.invocation_.template_instantiation_budget_,
+                " template instantiations is exhausted"));
+      }
       // Here, we have the option to instantiate the function
       // definition recursively, that is, to instantiate the function
       // templates invoked within the (templated) body. This checks the
@@ -201,6 +239,12 @@ std::optional<IR::Item> FunctionDeclImporter::Import(
           function_decl, llvm::toString(std::move(remaining_err)));
     }
   }
+  // Without lifetimes from annotations or elision, use those that lifetime
+  // analysis inferred from the definition, if there is a summary of it.
+  if (!lifetimes && ictx_.invocation_.lifetime_summaries_ != nullptr) {
+    lifetimes = ictx_.invocation_.lifetime_summaries_->LookupDeclaration(
+        function_decl, &lifetime_symbol_table);
+  }
 
   absl::StatusOr<UnqualifiedIdentifier> translated_name =
       ictx_.GetTranslatedName(function_decl);
@@ -342,6 +386,10 @@ std::optional<IR::Item> FunctionDeclImporter::Import(
           .reference = reference,
           .is_const = method_decl->isConst(),
           .is_virtual = method_decl->isVirtual(),
+          .is_final = method_decl->isVirtual() &&
+                      !method_decl->isPureVirtual() &&
+                      (method_decl->hasAttr<clang::FinalAttr>() ||
+                       method_decl->getParent()->isEffectivelyFinal()),
       };
     }
 
@@ -374,6 +422,7 @@ std::optional<IR::Item> FunctionDeclImporter::Import(
 
   std::optional<std::string> nodiscard;
   std::optional<std::string> deprecated;
+  bool is_batched = false;
   std::optional<std::string> unknown_attr =
       CollectUnknownAttrs(*function_decl, [&](const clang::Attr& attr) {
         if (auto* unused_attr =
@@ -389,6 +438,15 @@ std::optional<IR::Item> FunctionDeclImporter::Import(
         } else if (clang::isa<clang::NoThrowAttr>(attr)) {
           // nothrow attributes don't affect Rust.
           return true;
+        } else if (auto* annotate_attr =
+                       clang::dyn_cast<clang::AnnotateAttr>(&attr)) {
+          // Other annotations, and a malformed `crubit_internal_batch`, are
+          // unknown attributes.
+          if (annotate_attr->getAnnotation() == "crubit_internal_batch" &&
+              annotate_attr->args_size() == 0) {
+            is_batched = true;
+            return true;
+          }
         }
         return false;
       });
@@ -418,10 +476,12 @@ std::optional<IR::Item> FunctionDeclImporter::Import(
       .nodiscard = std::move(nodiscard),
       .deprecated = std::move(deprecated),
       .unknown_attr = std::move(unknown_attr),
+      .is_batched = is_batched,
       .has_c_calling_convention = has_c_calling_convention,
       .is_member_or_descendant_of_class_template =
           is_member_or_descendant_of_class_template,
       .source_loc = ictx_.ConvertSourceLocation(function_decl->getBeginLoc()),
+      .public_header = ictx_.GetPublicHeader(function_decl),
       .id = ictx_.GenerateItemId(function_decl),
       .enclosing_item_id = *std::move(enclosing_item_id),
   };
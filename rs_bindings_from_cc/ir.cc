@@ -4,23 +4,40 @@
 
 #include "rs_bindings_from_cc/ir.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <optional>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/log/check.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "common/string_type.h"
 #include "common/strong_int.h"
 #include "clang/AST/Type.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 
 namespace crubit {
 
+ItemId ItemIdAllocator::Allocate(absl::string_view key) {
+  ItemId id(llvm::xxh3_64bits(llvm::arrayRefFromStringRef(key)));
+  for (int i = 1; !allocated_.insert(id).second; ++i) {
+    id = ItemId(llvm::xxh3_64bits(
+        llvm::arrayRefFromStringRef(absl::StrCat(key, "#", i))));
+  }
+  return id;
+}
+
 template <class T>
 llvm::json::Value toJSON(const T& t) {
   return t.ToJson();
@@ -165,6 +182,17 @@ MappedType MappedType::FuncPtr(absl::string_view cc_call_conv,
   return result;
 }
 
+MappedType MappedType::UniquePtrTo(MappedType pointee_type,
+                                   std::string cc_name, bool trivial_abi) {
+  return MappedType{
+      .rs_type = RsType{.name = std::string(
+                            trivial_abi ? internal::kRustUniquePtrTrivialAbi
+                                        : internal::kRustUniquePtr),
+                        .type_args = {std::move(pointee_type.rs_type)}},
+      .cc_type = CcType{.name = std::move(cc_name)},
+  };
+}
+
 MappedType MappedType::FuncRef(absl::string_view cc_call_conv,
                                absl::string_view rs_abi,
                                std::optional<LifetimeId> lifetime,
@@ -285,6 +313,7 @@ llvm::json::Value MemberFuncMetadata::InstanceMethodMetadata::ToJson() const {
       {"reference", reference_str},
       {"is_const", is_const},
       {"is_virtual", is_virtual},
+      {"is_final", is_final},
   };
 }
 
@@ -339,10 +368,12 @@ llvm::json::Value Func::ToJson() const {
       {"is_noreturn", is_noreturn},
       {"nodiscard", nodiscard},
       {"deprecated", deprecated},
+      {"is_batched", is_batched},
       {"has_c_calling_convention", has_c_calling_convention},
       {"is_member_or_descendant_of_class_template",
        is_member_or_descendant_of_class_template},
       {"source_loc", source_loc},
+      {"public_header", public_header},
       {"id", id},
       {"enclosing_item_id", enclosing_item_id},
       {"adl_enclosing_record", adl_enclosing_record},
@@ -427,6 +458,7 @@ llvm::json::Value IncompleteRecord::ToJson() const {
       {"unknown_attr", unknown_attr},
       {"record_type", RecordTypeToString(record_type)},
       {"enclosing_item_id", enclosing_item_id},
+      {"is_complete_in_dependency", is_complete_in_dependency},
   };
 
   return llvm::json::Object{
@@ -458,6 +490,7 @@ llvm::json::Value Record::ToJson() const {
       {"unknown_attr", unknown_attr},
       {"doc_comment", doc_comment},
       {"source_loc", source_loc},
+      {"public_header", public_header},
       {"unambiguous_public_bases", unambiguous_public_bases},
       {"fields", fields},
       {"lifetime_params", lifetime_params},
@@ -541,9 +574,11 @@ llvm::json::Value UnsupportedItem::ToJson() const {
   llvm::json::Object unsupported{
       {"name", name},
       {"errors", json_errors},
-      {"source_loc", source_loc},
       {"id", id},
   };
+  if (!source_loc.empty()) {
+    unsupported["source_loc"] = source_loc;
+  }
 
   return llvm::json::Object{
       {"UnsupportedItem", std::move(unsupported)},
@@ -584,13 +619,58 @@ llvm::json::Value Namespace::ToJson() const {
   };
 }
 
-llvm::json::Value IR::ToJson() const {
-  std::vector<llvm::json::Value> json_items;
-  json_items.reserve(items.size());
-  for (const auto& item : items) {
-    std::visit([&](auto&& item) { json_items.push_back(item.ToJson()); }, item);
+namespace {
+
+// Calls `convert(i)` for each item index `i` of `ir`. The items own their
+// data, unlike during import, where everything refers to the AST, which can
+// only be used by one thread. So for large IRs, `convert` is called on several
+// threads, each taking the next item that is left.
+template <typename Convert>
+void ForEachItemInParallel(const IR& ir, Convert convert) {
+  constexpr size_t kMinItemsPerWorker = 512;
+  size_t workers =
+      std::clamp<size_t>(ir.items.size() / kMinItemsPerWorker, 1,
+                         std::max(std::thread::hardware_concurrency(), 1u));
+  std::atomic<size_t> next = 0;
+  auto run_worker = [&] {
+    for (size_t i = next++; i < ir.items.size(); i = next++) {
+      convert(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t worker = 1; worker < workers; ++worker) {
+    threads.emplace_back(run_worker);
+  }
+  run_worker();
+  for (std::thread& thread : threads) thread.join();
+}
+
+llvm::json::Value ItemToJson(const IR::Item& item) {
+  return std::visit([](auto&& item) { return item.ToJson(); }, item);
+}
+
+// Returns the Crubit features of each target, sorted (like the keys of a JSON
+// object when it is written) so that the IR is deterministic.
+std::vector<std::pair<llvm::StringRef, std::vector<llvm::StringRef>>>
+SortedCrubitFeatures(const IR& ir) {
+  std::vector<std::pair<llvm::StringRef, std::vector<llvm::StringRef>>> sorted;
+  sorted.reserve(ir.crubit_features.size());
+  for (const auto& [target, features] : ir.crubit_features) {
+    std::vector<llvm::StringRef> sorted_features(features.begin(),
+                                                 features.end());
+    std::sort(sorted_features.begin(), sorted_features.end());
+    sorted.emplace_back(target.value(), std::move(sorted_features));
   }
-  CHECK_EQ(json_items.size(), items.size());
+  std::sort(sorted.begin(), sorted.end());
+  return sorted;
+}
+
+}  // namespace
+
+llvm::json::Value IR::ToJson() const {
+  std::vector<llvm::json::Value> json_items(items.size(), nullptr);
+  ForEachItemInParallel(
+      *this, [&](size_t i) { json_items[i] = ItemToJson(items[i]); });
 
   std::vector<llvm::json::Value> top_level_ids;
   top_level_ids.reserve(top_level_item_ids.size());
@@ -599,12 +679,12 @@ llvm::json::Value IR::ToJson() const {
   }
 
   llvm::json::Object features_json;
-  for (const auto& [target, features] : crubit_features) {
+  for (const auto& [target, features] : SortedCrubitFeatures(*this)) {
     std::vector<llvm::json::Value> feature_array;
-    for (const std::string& feature : features) {
-      feature_array.push_back(feature);
+    for (llvm::StringRef feature : features) {
+      feature_array.push_back(feature.str());
     }
-    features_json[target.value()] = std::move(feature_array);
+    features_json[target] = std::move(feature_array);
   }
 
   llvm::json::Object result{
@@ -620,6 +700,48 @@ llvm::json::Value IR::ToJson() const {
   return std::move(result);
 }
 
+void IR::WriteJson(llvm::raw_ostream& os) const {
+  // Each item is rendered (in parallel) as soon as its JSON is built, so that
+  // only the text of the items is kept until it is written.
+  std::vector<std::string> rendered_items(items.size());
+  ForEachItemInParallel(*this, [&](size_t i) {
+    llvm::raw_string_ostream item_os(rendered_items[i]);
+    item_os << ItemToJson(items[i]);
+  });
+
+  // The attributes are written in the order in which `llvm::json::Object`s are
+  // written (sorted by key), to write the same bytes as `ToJson`.
+  llvm::json::OStream json(os);
+  json.object([&] {
+    if (!crate_root_path.empty()) {
+      json.attribute("crate_root_path", crate_root_path);
+    }
+    json.attributeObject("crubit_features", [&] {
+      for (const auto& [target, features] : SortedCrubitFeatures(*this)) {
+        json.attributeArray(target, [&] {
+          for (llvm::StringRef feature : features) json.value(feature);
+        });
+      }
+    });
+    json.attribute("current_target", current_target.value());
+    json.attributeArray("items", [&] {
+      for (std::string& rendered_item : rendered_items) {
+        json.rawValue(rendered_item);
+        // The text of the item isn't needed anymore.
+        std::string().swap(rendered_item);
+      }
+    });
+    json.attributeArray("public_headers", [&] {
+      for (const HeaderName& header : public_headers) {
+        json.value(header.ToJson());
+      }
+    });
+    json.attributeArray("top_level_item_ids", [&] {
+      for (const ItemId& id : top_level_item_ids) json.value(id.value());
+    });
+  });
+}
+
 std::string ItemToString(const IR::Item& item) {
   return std::visit(
       [&](auto&& item) { return llvm::formatv("{0}", item.ToJson()); }, item);
@@ -57,6 +57,13 @@ inline constexpr absl::string_view kRustRvalueRefConst =
 // Function pointers.
 inline constexpr absl::string_view kRustFuncPtr = "#funcPtr";
 
+// `std::unique_ptr<T>` with the default deleter, as
+// `::cc_std::unique_ptr::UniquePtr<T>`. The trivial_abi variant is passed by
+// value in registers, like a pointer.
+inline constexpr absl::string_view kRustUniquePtr = "#UniquePtr";
+inline constexpr absl::string_view kRustUniquePtrTrivialAbi =
+    "#UniquePtr trivial_abi";
+
 // C++ types therein.
 inline constexpr absl::string_view kCcPtr = "*";
 inline constexpr absl::string_view kCcLValueRef = "&";
@@ -101,6 +108,24 @@ inline std::ostream& operator<<(std::ostream& o, const HeaderName& h) {
 //  We use ItemIds for this.
 CRUBIT_DEFINE_STRONG_INT_TYPE(ItemId, uintptr_t);
 
+// Allocates ItemIds that are derived from the items themselves rather than
+// from addresses, so that importing the same headers produces the same IR in
+// every run.
+//
+// The id of an item is a hash of a key that identifies it, e.g. its USR. If the
+// id is already taken, because of a hash collision or because two items have
+// the same key, the key is rehashed with a counter until a free id is found.
+// Since items are imported in a deterministic order, so is the outcome of that.
+class ItemIdAllocator {
+ public:
+  // Returns a new id for the item identified by `key`. Every call returns a
+  // different id, so callers must remember the id of an item themselves.
+  ItemId Allocate(absl::string_view key);
+
+ private:
+  absl::flat_hash_set<ItemId> allocated_;
+};
+
 inline std::string DebugStringFromDecl(const clang::Decl* decl) {
   auto canonical_decl_id =
       reinterpret_cast<uintptr_t>(decl->getCanonicalDecl());
@@ -184,6 +209,8 @@ struct RsType {
   //   `type_args`; param types are stored in other `type_args`; <abi> would be
   //   replaced with "cdecl", "stdcall" or other Abi - see
   //   https://doc.rust-lang.org/reference/types/function-pointer.html);
+  // - "#UniquePtr" or "#UniquePtr trivial_abi" (`std::unique_ptr<T>`; `T` is
+  //   `type_args[0]`);
   // - An empty string when `decl_id` is non-empty.
   std::string name;
 
@@ -263,6 +290,12 @@ struct MappedType {
                             MappedType return_type,
                             std::vector<MappedType> param_types);
 
+  // Creates the mapped type of a `std::unique_ptr<T>` with the default
+  // deleter, which is spelled `cc_name` in C++. `trivial_abi` is whether the
+  // `std::unique_ptr` is passed in registers.
+  static MappedType UniquePtrTo(MappedType pointee_type, std::string cc_name,
+                                bool trivial_abi);
+
   bool IsVoid() const { return rs_type.name == "()"; }
 
   llvm::json::Value ToJson() const;
@@ -406,6 +439,10 @@ struct MemberFuncMetadata {
     ReferenceQualification reference = kUnqualified;
     bool is_const = false;
     bool is_virtual = false;
+    // True if calls to this virtual method always run this definition: the
+    // method is `final`, or its class is, so there is no overrider to dispatch
+    // to.
+    bool is_final = false;
   };
 
   llvm::json::Value ToJson() const;
@@ -438,9 +475,16 @@ struct Func {
   std::optional<std::string> nodiscard;
   std::optional<std::string> deprecated;
   std::optional<std::string> unknown_attr;
+  // True if the function has the `crubit_internal_batch` attribute, and the
+  // bindings should also include a variant that calls it on each element of an
+  // array, in a single call across the language boundary.
+  bool is_batched = false;
   bool has_c_calling_convention = true;
   bool is_member_or_descendant_of_class_template = false;
   std::string source_loc;
+  // The public header of the current target that declares this function
+  // (directly, or through the headers it includes), if any.
+  std::optional<HeaderName> public_header;
   ItemId id;
   std::optional<ItemId> enclosing_item_id;
   // If present, this function should only generate top-level bindings if its
@@ -568,6 +612,9 @@ struct Record {
   std::optional<std::string> unknown_attr;
   std::optional<std::string> doc_comment;
   std::string source_loc;
+  // The public header of the current target that defines this record
+  // (directly, or through the headers it includes), if any.
+  std::optional<HeaderName> public_header;
   std::vector<BaseClass> unambiguous_public_bases;
   std::vector<Field> fields;
   std::vector<LifetimeName> lifetime_params;
@@ -599,6 +646,10 @@ struct Record {
   //
   //  * https://eel.is/c++draft/class.temporary#3
   //  * https://clang.llvm.org/docs/AttributeReference.html#trivial-abi
+  //
+  // These are exactly the records that Clang reports as trivially relocatable
+  // (`__is_trivially_relocatable`), and they become `Unpin` Rust types, which
+  // Rust moves with a `memcpy` rather than by calling the move constructor.
   bool is_trivial_abi = false;
 
   // Whether this type can be inherited from.
@@ -644,6 +695,11 @@ struct IncompleteRecord {
   std::optional<std::string> unknown_attr;
   RecordType record_type;
   std::optional<ItemId> enclosing_item_id;
+  // Whether `owning_target` is a dependency whose type manifest lists the
+  // record as complete, so its bindings have the (complete) Rust type of the
+  // record, even though the headers of the current target only forward
+  // declare it.
+  bool is_complete_in_dependency = false;
 };
 
 struct Enumerator {
@@ -707,7 +763,8 @@ struct UnsupportedItem {
   // TODO(forster): We could show the original declaration in the generated
   // message (potentially also for successfully imported items).
 
-  // Qualified name of the item for which we couldn't generate bindings
+  // Qualified name of the item for which we couldn't generate bindings, or
+  // empty if the item is lean (see `Invocation::lean_unsupported_items_`).
   std::string name;
 
   std::vector<FormattedError> errors;
@@ -789,6 +846,11 @@ inline std::ostream& operator<<(std::ostream& o,
 struct IR {
   llvm::json::Value ToJson() const;
 
+  // Writes the same bytes as `llvm::formatv("{0}", ToJson())`, but without
+  // building the JSON of the whole IR in memory first: only the JSON of each
+  // item is built, and rendered right away.
+  void WriteJson(llvm::raw_ostream& os) const;
+
   template <typename T>
   std::vector<const T*> get_items_if() const {
     std::vector<const T*> filtered_items;
@@ -836,6 +898,15 @@ inline std::string IrToJson(const IR& ir) {
   return std::string(llvm::formatv("{0:2}", ir.ToJson()));
 }
 
+// Returns the JSON of `ir` with no indentation, as passed to the bindings
+// generator.
+inline std::string IrToCompactJson(const IR& ir) {
+  std::string json;
+  llvm::raw_string_ostream os(json);
+  ir.WriteJson(os);
+  return json;
+}
+
 inline std::ostream& operator<<(std::ostream& o, const IR& ir) {
   return o << IrToJson(ir);
 }
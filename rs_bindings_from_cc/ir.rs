@@ -11,11 +11,13 @@ use code_gen_utils::{make_rs_ident, NamespaceQualifier};
 use once_cell::unsync::OnceCell;
 use proc_macro2::{Ident, TokenStream};
 use quote::{quote, ToTokens};
+use serde::de::{Deserializer, Visitor};
 use serde::Deserialize;
+use std::cell::RefCell;
 use std::collections::hash_map::{Entry, HashMap};
+use std::collections::HashSet;
 use std::fmt::{self, Debug, Display, Formatter};
 use std::hash::{Hash, Hasher};
-use std::io::Read;
 use std::rc::Rc;
 
 /// Common data about all items.
@@ -52,10 +54,78 @@ where
     }
 }
 
-/// Deserialize `IR` from JSON given as a reader.
-pub fn deserialize_ir<R: Read>(reader: R) -> Result<IR> {
-    let flat_ir = serde_json::from_reader(reader)?;
-    Ok(make_ir(flat_ir))
+/// Deserialize `IR` from JSON given as bytes.
+///
+/// The whole IR is already in memory when it is handed over from C++, so this
+/// reads it as a slice: `serde_json::from_slice` is considerably faster than
+/// `from_reader`, which goes through `io::Read` a byte at a time.
+///
+/// The names, labels and other strings that large IRs repeat many times are
+/// interned while deserializing (see `deserialize_interned`), so that each
+/// distinct string is allocated once and the copies share its `Rc<str>`.
+pub fn deserialize_ir(json: &[u8]) -> Result<IR> {
+    STRING_POOL.with(|pool| *pool.borrow_mut() = Some(HashSet::new()));
+    let flat_ir = serde_json::from_slice(json);
+    STRING_POOL.with(|pool| *pool.borrow_mut() = None);
+    Ok(make_ir(flat_ir?))
+}
+
+thread_local! {
+    /// The strings interned so far by the `deserialize_ir` call in progress, if
+    /// any.
+    static STRING_POOL: RefCell<Option<HashSet<Rc<str>>>> = const { RefCell::new(None) };
+}
+
+/// Returns the interned copy of `s` (see `deserialize_ir`), or a new `Rc<str>`
+/// outside of `deserialize_ir`.
+fn intern(s: &str) -> Rc<str> {
+    STRING_POOL.with(|pool| match &mut *pool.borrow_mut() {
+        Some(pool) => {
+            if let Some(interned) = pool.get(s) {
+                return interned.clone();
+            }
+            let interned = Rc::<str>::from(s);
+            pool.insert(interned.clone());
+            interned
+        }
+        None => s.into(),
+    })
+}
+
+/// Deserializes a string field as an interned `Rc<str>`. Unlike the default
+/// deserialization of `Rc<str>`, a string that was already interned is not
+/// copied at all. Equality comparisons of interned strings are also quicker,
+/// since `Rc` compares the pointers first.
+fn deserialize_interned<'de, D>(deserializer: D) -> std::result::Result<Rc<str>, D::Error>
+where
+    D: Deserializer<'de>,
+{
+    struct InternedStrVisitor;
+    impl<'de> Visitor<'de> for InternedStrVisitor {
+        type Value = Rc<str>;
+
+        fn expecting(&self, f: &mut Formatter) -> fmt::Result {
+            f.write_str("a string")
+        }
+
+        fn visit_str<E: serde::de::Error>(self, s: &str) -> std::result::Result<Rc<str>, E> {
+            Ok(intern(s))
+        }
+    }
+    deserializer.deserialize_str(InternedStrVisitor)
+}
+
+/// Like `deserialize_interned`, for optional string fields.
+fn deserialize_interned_option<'de, D>(
+    deserializer: D,
+) -> std::result::Result<Option<Rc<str>>, D::Error>
+where
+    D: Deserializer<'de>,
+{
+    #[derive(Deserialize)]
+    #[serde(transparent)]
+    struct Interned(#[serde(deserialize_with = "deserialize_interned")] Rc<str>);
+    Ok(Option::<Interned>::deserialize(deserializer)?.map(|Interned(s)| s))
 }
 
 /// Create a testing `IR` instance from given parts. This function does not use
@@ -74,7 +144,7 @@ where
     make_ir(FlatIR {
         public_headers,
         current_target,
-        items,
+        items: items.into_iter().collect(),
         top_level_item_ids,
         crate_root_path,
         crubit_features: crubit_features
@@ -85,86 +155,29 @@ where
 }
 
 fn make_ir(flat_ir: FlatIR) -> IR {
-    let mut used_decl_ids = HashMap::new();
-    for item in &flat_ir.items {
-        if let Some(existing_decl) = used_decl_ids.insert(item.id(), item) {
-            panic!("Duplicate decl_id found in {:?} and {:?}", existing_decl, item);
-        }
-    }
-    let item_id_to_item_idx = flat_ir
-        .items
-        .iter()
-        .enumerate()
-        .map(|(idx, item)| (item.id(), idx))
-        .collect::<HashMap<_, _>>();
-
-    let mut lifetimes: HashMap<LifetimeId, LifetimeName> = HashMap::new();
-    for item in &flat_ir.items {
-        let lifetime_params = match item {
-            Item::Record(record) => &record.lifetime_params,
-            Item::Func(func) => &func.lifetime_params,
-            _ => continue,
-        };
-        for lifetime in lifetime_params {
-            match lifetimes.entry(lifetime.id) {
-                Entry::Occupied(occupied) => {
-                    panic!(
-                        "Duplicate use of lifetime ID {:?} in item {item:?} for names: '{}, '{}",
-                        lifetime.id,
-                        &occupied.get().name,
-                        &lifetime.name
-                    )
-                }
-                Entry::Vacant(vacant) => {
-                    vacant.insert(lifetime.clone());
-                }
-            }
-        }
-    }
+    // The other indices are built while the items are deserialized, but this one
+    // depends on `current_target`, which may come after the items.
     let mut namespace_id_to_number_of_reopened_namespaces = HashMap::new();
     let mut reopened_namespace_id_to_idx = HashMap::new();
-
-    flat_ir
-        .items
-        .iter()
-        .filter_map(|item| match item {
-            Item::Namespace(ns) if ns.owning_target == flat_ir.current_target => {
-                Some((ns.canonical_namespace_id, ns.id))
-            }
-            _ => None,
-        })
-        .for_each(|(canonical_id, id)| {
-            let current_count =
-                *namespace_id_to_number_of_reopened_namespaces.entry(canonical_id).or_insert(0);
-            reopened_namespace_id_to_idx.insert(id, current_count);
-            namespace_id_to_number_of_reopened_namespaces.insert(canonical_id, current_count + 1);
-        });
-
-    let mut function_name_to_functions = HashMap::<UnqualifiedIdentifier, Vec<Rc<Func>>>::new();
-    flat_ir
-        .items
-        .iter()
-        .filter_map(|item| match item {
-            Item::Func(func) => Some(func),
-            _ => None,
-        })
-        .for_each(|f| {
-            function_name_to_functions.entry(f.name.clone()).or_default().push(f.clone());
-        });
-
-    IR {
-        flat_ir,
-        item_id_to_item_idx,
-        lifetimes,
-        namespace_id_to_number_of_reopened_namespaces,
-        reopened_namespace_id_to_idx,
-        function_name_to_functions,
+    for &idx in &flat_ir.items.item_idxs.namespaces {
+        let Item::Namespace(ns) = &flat_ir.items.items[idx] else { continue };
+        if ns.owning_target != flat_ir.current_target {
+            continue;
+        }
+        let count = namespace_id_to_number_of_reopened_namespaces
+            .entry(ns.canonical_namespace_id)
+            .or_insert(0);
+        reopened_namespace_id_to_idx.insert(ns.id, *count);
+        *count += 1;
     }
+
+    IR { flat_ir, namespace_id_to_number_of_reopened_namespaces, reopened_namespace_id_to_idx }
 }
 
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct HeaderName {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub name: Rc<str>,
 }
 
@@ -176,6 +189,7 @@ pub struct LifetimeId(pub i32);
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct LifetimeName {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub name: Rc<str>,
     pub id: LifetimeId,
 }
@@ -183,9 +197,11 @@ pub struct LifetimeName {
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct RsType {
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub name: Option<Rc<str>>,
     pub lifetime_args: Rc<[LifetimeId]>,
     pub type_args: Rc<[RsType]>,
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
     pub decl_id: Option<ItemId>,
 }
@@ -199,6 +215,7 @@ impl RsType {
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct CcType {
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub name: Option<Rc<str>>,
     pub is_const: bool,
     pub type_args: Vec<CcType>,
@@ -231,6 +248,7 @@ pub struct MappedType {
 #[derive(PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct Identifier {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub identifier: Rc<str>,
 }
 
@@ -256,6 +274,7 @@ pub struct IntegerConstant {
 #[derive(PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct Operator {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub name: Rc<str>,
 }
 
@@ -294,7 +313,7 @@ impl ToTokens for ItemId {
 /// A Bazel label, e.g. `//foo:bar`.
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(transparent)]
-pub struct BazelLabel(pub Rc<str>);
+pub struct BazelLabel(#[serde(deserialize_with = "deserialize_interned")] pub Rc<str>);
 
 impl BazelLabel {
     /// Returns the target name. E.g. `bar` for `//foo:bar`.
@@ -418,6 +437,7 @@ pub struct InstanceMethodMetadata {
     pub reference: ReferenceQualification,
     pub is_const: bool,
     pub is_virtual: bool,
+    pub is_final: bool,
 }
 
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
@@ -441,6 +461,7 @@ pub struct FuncParam {
     ///
     /// One notable example is `lifetimebound`, which we might expect to map
     /// to Rust lifetimes.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
 }
 
@@ -465,19 +486,31 @@ pub struct Func {
     pub is_noreturn: bool,
     /// The `[[nodiscard("...")]]` string. If `[[nodiscard]]`, then the empty
     /// string is used.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub nodiscard: Option<Rc<str>>,
     /// The `[[deprecated("...")]]` string. If `[[deprecated]]`, then the empty
     /// string is used.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub deprecated: Option<Rc<str>>,
     /// A human-readable list of attributes that Crubit doesn't understand.
     ///
     /// Because attributes can change the behavior or semantics of functions in
     /// fairly significant ways, and in ways that may affect interop, we
     /// default-closed and do not expose functions with unknown attributes.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
+    /// Whether the function has the `crubit_internal_batch` attribute.
+    ///
+    /// If so, the bindings also include a `<name>_batch` function that calls it
+    /// on each element of a slice, looping on the C++ side.
+    pub is_batched: bool,
     pub has_c_calling_convention: bool,
     pub is_member_or_descendant_of_class_template: bool,
+    #[serde(deserialize_with = "deserialize_interned")]
     pub source_loc: Rc<str>,
+    /// The public header of the current target that declares the function
+    /// (directly, or through the headers that it includes), if any.
+    pub public_header: Option<HeaderName>,
     pub id: ItemId,
     pub enclosing_item_id: Option<ItemId>,
     pub adl_enclosing_record: Option<ItemId>,
@@ -544,6 +577,7 @@ pub struct Field {
     pub size: usize,
 
     /// A human-readable list of attributes that Crubit doesn't understand.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
 
     pub is_no_unique_address: bool,
@@ -572,7 +606,9 @@ pub struct BaseClass {
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct IncompleteRecord {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub cc_name: Rc<str>,
+    #[serde(deserialize_with = "deserialize_interned")]
     pub rs_name: Rc<str>,
     pub id: ItemId,
     pub owning_target: BazelLabel,
@@ -581,9 +617,15 @@ pub struct IncompleteRecord {
     /// Because attributes can change the behavior or semantics of types in
     /// fairly significant ways, and in ways that may affect interop, we
     /// default-closed and do not expose functions with unknown attributes.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
     pub record_type: RecordType,
     pub enclosing_item_id: Option<ItemId>,
+    /// Whether `owning_target` is a dependency whose type manifest lists the
+    /// record as complete. The record is then the complete Rust type that the
+    /// dependency's bindings define, rather than a `forward_declare!`d type.
+    #[serde(default)]
+    pub is_complete_in_dependency: bool,
 }
 
 impl GenericItem for IncompleteRecord {
@@ -629,7 +671,9 @@ pub struct SizeAlign {
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct Record {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub rs_name: Rc<str>,
+    #[serde(deserialize_with = "deserialize_interned")]
     pub cc_name: Rc<str>,
     pub mangled_cc_name: Rc<str>,
     pub id: ItemId,
@@ -642,9 +686,14 @@ pub struct Record {
     /// Because attributes can change the behavior or semantics of types in
     /// fairly significant ways, and in ways that may affect interop, we
     /// default-closed and do not expose functions with unknown attributes.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
     pub doc_comment: Option<Rc<str>>,
+    #[serde(deserialize_with = "deserialize_interned")]
     pub source_loc: Rc<str>,
+    /// The public header of the current target that defines the record
+    /// (directly, or through the headers that it includes), if any.
+    pub public_header: Option<HeaderName>,
     pub unambiguous_public_bases: Vec<BaseClass>,
     pub fields: Vec<Field>,
     pub lifetime_params: Vec<LifetimeName>,
@@ -709,6 +758,7 @@ pub struct Enum {
     pub identifier: Identifier,
     pub id: ItemId,
     pub owning_target: BazelLabel,
+    #[serde(deserialize_with = "deserialize_interned")]
     pub source_loc: Rc<str>,
     pub underlying_type: MappedType,
     /// The enumerators. If None, this is a forward-declared (opaque) enum.
@@ -718,6 +768,7 @@ pub struct Enum {
     /// latter has `None`.
     pub enumerators: Option<Vec<Enumerator>>,
     /// A human-readable list of attributes that Crubit doesn't understand.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
     pub enclosing_item_id: Option<ItemId>,
 }
@@ -743,6 +794,7 @@ pub struct Enumerator {
     pub identifier: Identifier,
     pub value: IntegerConstant,
     /// A human-readable list of attributes that Crubit doesn't understand.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
 }
 
@@ -754,8 +806,10 @@ pub struct TypeAlias {
     pub owning_target: BazelLabel,
     pub doc_comment: Option<Rc<str>>,
     /// A human-readable list of attributes that Crubit doesn't understand.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
     pub underlying_type: MappedType,
+    #[serde(deserialize_with = "deserialize_interned")]
     pub source_loc: Rc<str>,
     pub enclosing_item_id: Option<ItemId>,
 }
@@ -807,7 +861,9 @@ impl<T> Hash for IgnoredField<T> {
 #[derive(Debug, PartialEq, Eq, Hash, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct FormattedError {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub fmt: Rc<str>,
+    #[serde(deserialize_with = "deserialize_interned")]
     pub message: Rc<str>,
 }
 
@@ -824,8 +880,10 @@ impl FormattedError {
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct UnsupportedItem {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub name: Rc<str>,
     pub errors: Vec<Rc<FormattedError>>,
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub source_loc: Option<Rc<str>>,
     pub id: ItemId,
     #[serde(skip)]
@@ -895,6 +953,7 @@ pub struct Namespace {
     pub id: ItemId,
     pub canonical_namespace_id: ItemId,
     /// A human-readable list of attributes that Crubit doesn't understand.
+    #[serde(default, deserialize_with = "deserialize_interned_option")]
     pub unknown_attr: Option<Rc<str>>,
     pub owning_target: BazelLabel,
     #[serde(default)]
@@ -921,6 +980,7 @@ impl GenericItem for Namespace {
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct UseMod {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub path: Rc<str>,
     pub mod_name: Identifier,
     pub id: ItemId,
@@ -944,7 +1004,9 @@ impl GenericItem for UseMod {
 #[derive(Debug, PartialEq, Eq, Hash, Clone, Deserialize)]
 #[serde(deny_unknown_fields)]
 pub struct TypeMapOverride {
+    #[serde(deserialize_with = "deserialize_interned")]
     pub rs_name: Rc<str>,
+    #[serde(deserialize_with = "deserialize_interned")]
     pub cc_name: Rc<str>,
     pub owning_target: BazelLabel,
     pub size_align: Option<SizeAlign>,
@@ -1221,7 +1283,7 @@ struct FlatIR {
     public_headers: Vec<HeaderName>,
     current_target: BazelLabel,
     #[serde(default)]
-    items: Vec<Item>,
+    items: IndexedItems,
     #[serde(default)]
     top_level_item_ids: Vec<ItemId>,
     #[serde(default)]
@@ -1258,7 +1320,7 @@ impl Debug for FlatIR {
         f.debug_struct("FlatIR")
             .field("public_headers", public_headers)
             .field("current_target", current_target)
-            .field("items", items)
+            .field("items", &items.items)
             .field("top_level_item_ids", top_level_item_ids)
             .field("crate_root_path", crate_root_path)
             .field("crubit_features", &DebugHashMap(crubit_features))
@@ -1266,67 +1328,197 @@ impl Debug for FlatIR {
     }
 }
 
+/// Indices of the items of each kind that `IR` has an accessor for, in
+/// `items` order, so that the accessors don't filter all items.
+#[derive(PartialEq, Eq, Clone, Debug, Default)]
+struct ItemIdxsByKind {
+    functions: Vec<usize>,
+    records: Vec<usize>,
+    unsupported_items: Vec<usize>,
+    comments: Vec<usize>,
+    namespaces: Vec<usize>,
+}
+
+/// The items of an `IR`, with the indices that `IR` looks them up by.
+///
+/// The indices are updated as each item is pushed, so deserializing the items
+/// builds the indices in the same pass, while the item is still hot in the
+/// cache, instead of walking all items again for each index afterwards.
+#[derive(PartialEq, Eq, Clone, Default)]
+struct IndexedItems {
+    items: Vec<Item>,
+    // A map from a `decl_id` to an index of an `Item` in `items`. (The IDs are
+    // hashes, so they can't index a `Vec` directly.)
+    item_id_to_item_idx: HashMap<ItemId, usize>,
+    item_idxs: ItemIdxsByKind,
+    lifetimes: HashMap<LifetimeId, LifetimeName>,
+    function_name_to_functions: HashMap<UnqualifiedIdentifier, Vec<Rc<Func>>>,
+}
+
+impl IndexedItems {
+    fn with_capacity(capacity: usize) -> Self {
+        IndexedItems {
+            items: Vec::with_capacity(capacity),
+            item_id_to_item_idx: HashMap::with_capacity(capacity),
+            ..Default::default()
+        }
+    }
+
+    fn push(&mut self, item: Item) {
+        let idx = self.items.len();
+        if let Some(existing_idx) = self.item_id_to_item_idx.insert(item.id(), idx) {
+            panic!("Duplicate decl_id found in {:?} and {:?}", self.items[existing_idx], item);
+        }
+        match &item {
+            Item::Func(func) => {
+                self.item_idxs.functions.push(idx);
+                self.add_lifetimes(&item, &func.lifetime_params);
+                self.function_name_to_functions
+                    .entry(func.name.clone())
+                    .or_default()
+                    .push(func.clone());
+            }
+            Item::Record(record) => {
+                self.item_idxs.records.push(idx);
+                self.add_lifetimes(&item, &record.lifetime_params);
+            }
+            Item::UnsupportedItem(_) => self.item_idxs.unsupported_items.push(idx),
+            Item::Comment(_) => self.item_idxs.comments.push(idx),
+            Item::Namespace(_) => self.item_idxs.namespaces.push(idx),
+            _ => {}
+        }
+        self.items.push(item);
+    }
+
+    fn add_lifetimes(&mut self, item: &Item, lifetime_params: &[LifetimeName]) {
+        for lifetime in lifetime_params {
+            match self.lifetimes.entry(lifetime.id) {
+                Entry::Occupied(occupied) => {
+                    panic!(
+                        "Duplicate use of lifetime ID {:?} in item {item:?} for names: '{}, '{}",
+                        lifetime.id,
+                        &occupied.get().name,
+                        &lifetime.name
+                    )
+                }
+                Entry::Vacant(vacant) => {
+                    vacant.insert(lifetime.clone());
+                }
+            }
+        }
+    }
+}
+
+impl FromIterator<Item> for IndexedItems {
+    fn from_iter<I: IntoIterator<Item = Item>>(iter: I) -> Self {
+        let iter = iter.into_iter();
+        let mut items = IndexedItems::with_capacity(iter.size_hint().0);
+        for item in iter {
+            items.push(item);
+        }
+        items
+    }
+}
+
+impl<'de> Deserialize<'de> for IndexedItems {
+    fn deserialize<D>(deserializer: D) -> std::result::Result<IndexedItems, D::Error>
+    where
+        D: Deserializer<'de>,
+    {
+        struct IndexedItemsVisitor;
+        impl<'de> Visitor<'de> for IndexedItemsVisitor {
+            type Value = IndexedItems;
+
+            fn expecting(&self, f: &mut Formatter) -> fmt::Result {
+                f.write_str("a sequence of items")
+            }
+
+            fn visit_seq<A>(self, mut seq: A) -> std::result::Result<IndexedItems, A::Error>
+            where
+                A: serde::de::SeqAccess<'de>,
+            {
+                // Like serde's own `Vec` impl, don't trust large size hints from
+                // the input.
+                let mut items =
+                    IndexedItems::with_capacity(seq.size_hint().unwrap_or(0).min(1 << 16));
+                while let Some(item) = seq.next_element()? {
+                    items.push(item);
+                }
+                Ok(items)
+            }
+        }
+        deserializer.deserialize_seq(IndexedItemsVisitor)
+    }
+}
+
 /// Struct providing the necessary information about the API of a C++ target to
 /// enable generation of Rust bindings source code (both `rs_api.rs` and
 /// `rs_api_impl.cc` files).
 #[derive(PartialEq, Debug)]
 pub struct IR {
     flat_ir: FlatIR,
-    // A map from a `decl_id` to an index of an `Item` in the `flat_ir.items` vec.
-    item_id_to_item_idx: HashMap<ItemId, usize>,
-    lifetimes: HashMap<LifetimeId, LifetimeName>,
     namespace_id_to_number_of_reopened_namespaces: HashMap<ItemId, usize>,
     reopened_namespace_id_to_idx: HashMap<ItemId, usize>,
-    function_name_to_functions: HashMap<UnqualifiedIdentifier, Vec<Rc<Func>>>,
 }
 
 impl IR {
     pub fn items(&self) -> impl Iterator<Item = &Item> {
-        self.flat_ir.items.iter()
+        self.flat_ir.items.items.iter()
     }
 
     pub fn top_level_item_ids(&self) -> impl Iterator<Item = &ItemId> {
         self.flat_ir.top_level_item_ids.iter()
     }
 
+    /// Note that the indices of the `IR` are not updated, so the items must
+    /// keep their kind and ID.
     pub fn items_mut(&mut self) -> impl Iterator<Item = &mut Item> {
-        self.flat_ir.items.iter_mut()
+        self.flat_ir.items.items.iter_mut()
     }
 
     pub fn public_headers(&self) -> impl Iterator<Item = &HeaderName> {
         self.flat_ir.public_headers.iter()
     }
 
+    /// Returns the items at `idxs` that `filter` maps to a `T`.
+    fn items_at<'a, T: 'a>(
+        &'a self,
+        idxs: &'a [usize],
+        filter: impl Fn(&'a Item) -> Option<&'a T> + 'a,
+    ) -> impl Iterator<Item = &'a T> + 'a {
+        idxs.iter().filter_map(move |&idx| filter(&self.flat_ir.items.items[idx]))
+    }
+
     pub fn functions(&self) -> impl Iterator<Item = &Rc<Func>> {
-        self.items().filter_map(|item| match item {
+        self.items_at(&self.flat_ir.items.item_idxs.functions, |item| match item {
             Item::Func(func) => Some(func),
             _ => None,
         })
     }
 
     pub fn records(&self) -> impl Iterator<Item = &Rc<Record>> {
-        self.items().filter_map(|item| match item {
+        self.items_at(&self.flat_ir.items.item_idxs.records, |item| match item {
             Item::Record(func) => Some(func),
             _ => None,
         })
     }
 
     pub fn unsupported_items(&self) -> impl Iterator<Item = &Rc<UnsupportedItem>> {
-        self.items().filter_map(|item| match item {
+        self.items_at(&self.flat_ir.items.item_idxs.unsupported_items, |item| match item {
             Item::UnsupportedItem(unsupported_item) => Some(unsupported_item),
             _ => None,
         })
     }
 
     pub fn comments(&self) -> impl Iterator<Item = &Rc<Comment>> {
-        self.items().filter_map(|item| match item {
+        self.items_at(&self.flat_ir.items.item_idxs.comments, |item| match item {
             Item::Comment(comment) => Some(comment),
             _ => None,
         })
     }
 
     pub fn namespaces(&self) -> impl Iterator<Item = &Rc<Namespace>> {
-        self.items().filter_map(|item| match item {
+        self.items_at(&self.flat_ir.items.item_idxs.namespaces, |item| match item {
             Item::Namespace(ns) => Some(ns),
             _ => None,
         })
@@ -1354,10 +1546,13 @@ impl IR {
 
     pub fn find_untyped_decl(&self, decl_id: ItemId) -> &Item {
         let idx = *self
+            .flat_ir
+            .items
             .item_id_to_item_idx
             .get(&decl_id)
             .unwrap_or_else(|| panic!("Couldn't find decl_id {:?} in the IR.", decl_id));
         self.flat_ir
+            .items
             .items
             .get(idx)
             .unwrap_or_else(|| panic!("Couldn't find an item at idx {}", idx))
@@ -1408,7 +1603,7 @@ impl IR {
     }
 
     pub fn get_lifetime(&self, lifetime_id: LifetimeId) -> Option<&LifetimeName> {
-        self.lifetimes.get(&lifetime_id)
+        self.flat_ir.items.lifetimes.get(&lifetime_id)
     }
 
     pub fn get_reopened_namespace_idx(&self, id: ItemId) -> Result<usize> {
@@ -1453,7 +1648,11 @@ impl IR {
         &self,
         function_name: &UnqualifiedIdentifier,
     ) -> impl Iterator<Item = &Rc<Func>> {
-        self.function_name_to_functions.get(function_name).map_or([].iter(), |v| v.iter())
+        self.flat_ir
+            .items
+            .function_name_to_functions
+            .get(function_name)
+            .map_or([].iter(), |v| v.iter())
     }
 
     pub fn namespace_qualifier(&self, item: &impl GenericItem) -> Result<NamespaceQualifier> {
@@ -1530,13 +1729,71 @@ mod tests {
             public_headers: vec![HeaderName { name: "foo/bar.h".into() }],
             current_target: "//foo:bar".into(),
             top_level_item_ids: vec![],
-            items: vec![],
+            items: Default::default(),
             crate_root_path: None,
             crubit_features: Default::default(),
         };
         assert_eq!(ir.flat_ir, expected);
     }
 
+    #[test]
+    fn test_deserialize_ir_interns_strings() {
+        let input = r#"
+        {
+            "public_headers": [{ "name": "foo/bar.h" }, { "name": "foo/bar.h" }],
+            "current_target": "//foo:bar"
+        }
+        "#;
+        let ir = deserialize_ir(input.as_bytes()).unwrap();
+        let [first, second] = &ir.flat_ir.public_headers[..] else {
+            panic!("Expected two headers, got {:?}", ir.flat_ir.public_headers);
+        };
+        assert_eq!(&*first.name, "foo/bar.h");
+        assert!(Rc::ptr_eq(&first.name, &second.name));
+    }
+
+    #[test]
+    fn test_deserialize_ir_indexes_items() {
+        // `current_target` comes after the items, which are indexed as they are
+        // deserialized.
+        let input = r#"
+        {
+            "items": [
+                {"Comment": {"text": "foo", "id": 1}},
+                {"Namespace": {
+                    "name": {"identifier": "ns"}, "id": 2, "canonical_namespace_id": 2,
+                    "owning_target": "//foo:bar", "enclosing_item_id": null, "is_inline": false
+                }},
+                {"Namespace": {
+                    "name": {"identifier": "ns"}, "id": 3, "canonical_namespace_id": 2,
+                    "owning_target": "//foo:bar", "enclosing_item_id": null, "is_inline": false
+                }}
+            ],
+            "current_target": "//foo:bar"
+        }
+        "#;
+        let ir = deserialize_ir(input.as_bytes()).unwrap();
+        assert_eq!(ir.comments().map(|comment| &*comment.text).collect::<Vec<_>>(), ["foo"]);
+        assert_eq!(ir.namespaces().map(|ns| ns.id).collect::<Vec<_>>(), [ItemId(2), ItemId(3)]);
+        let Item::Comment(comment) = ir.find_untyped_decl(ItemId(1)) else {
+            panic!("Expected a comment");
+        };
+        assert_eq!(&*comment.text, "foo");
+        assert!(!ir.is_last_reopened_namespace(ItemId(2), ItemId(2)).unwrap());
+        assert!(ir.is_last_reopened_namespace(ItemId(3), ItemId(2)).unwrap());
+
+        // The same indices are built for the items of a test `IR`.
+        let parts = make_ir_from_parts::<flagset::FlagSet<CrubitFeature>>(
+            ir.items().cloned().collect(),
+            vec![],
+            "//foo:bar".into(),
+            vec![],
+            None,
+            HashMap::new(),
+        );
+        assert_eq!(parts, ir);
+    }
+
     #[test]
     fn test_empty_crate_root_path() {
         let input = "{ \"current_target\": \"//foo:bar\" }";
@@ -4,7 +4,6 @@
 
 #include "rs_bindings_from_cc/ir_from_cc.h"
 
-#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
@@ -24,6 +23,7 @@
 #include "rs_bindings_from_cc/ir.h"
 #include "clang/Serialization/PCHContainerOperations.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/Support/TimeProfiler.h"
 
 namespace crubit {
 
@@ -71,26 +71,40 @@ absl::StatusOr<IR> IrFromCc(IrFromCcOptions options) {
     for (const std::string& extra_instantiation :
          options.extra_instantiations) {
       absl::SubstituteAndAppend(&virtual_input_file_content,
-                                "using __cc_template_instantiation_$0 = $1;\n",
+                                "using $0$1 = $2;\n", kInstantiationAliasPrefix,
                                 counter++, extra_instantiation);
     }
     absl::SubstituteAndAppend(&virtual_input_file_content,
                               "}  // namespace $0\n",
                               kInstantiationsNamespaceName);
   }
-  std::vector<std::string> args_as_strings = {
-      // Parse non-doc comments that are used as documentation
-      "-fparse-all-comments"};
+  std::vector<std::string> args_as_strings;
+  if (options.parse_all_comments) {
+    // Parse non-doc comments that are used as documentation
+    args_as_strings.push_back("-fparse-all-comments");
+  }
   args_as_strings.insert(args_as_strings.end(), options.clang_args.begin(),
                          options.clang_args.end());
 
   Invocation invocation(options.current_target, augmented_public_headers,
-                        options.headers_to_targets);
-  if (!clang::tooling::runToolOnCodeWithArgs(
-          std::make_unique<FrontendAction>(invocation),
-          virtual_input_file_content, args_as_strings, kVirtualInputPath,
-          "rs_bindings_from_cc",
-          std::make_shared<clang::PCHContainerOperations>(), file_contents)) {
+                        options.headers_to_targets, options.lazy_import,
+                        options.target_args_index,
+                        options.template_instantiation_budget,
+                        options.dependency_types, options.lifetime_summaries,
+                        options.lean_unsupported_items,
+                        options.string_view_as_slice_pointer);
+  bool compiled;
+  {
+    // Covers both parsing and importing the headers (see `AstConsumer`), in
+    // which Clang records spans of its own.
+    llvm::TimeTraceScope time_trace("RunClang");
+    compiled = clang::tooling::runToolOnCodeWithArgs(
+        std::make_unique<FrontendAction>(invocation),
+        virtual_input_file_content, args_as_strings, kVirtualInputPath,
+        "rs_bindings_from_cc",
+        std::make_shared<clang::PCHContainerOperations>(), file_contents);
+  }
+  if (!compiled) {
     return absl::Status(absl::StatusCode::kInvalidArgument,
                         "Could not compile header contents");
   }
@@ -102,7 +116,8 @@ absl::StatusOr<IR> IrFromCc(IrFromCcOptions options) {
     // TODO(jeanpierreda): It'd be nice to give these human-readable names, e.g. the
     // name of the file without the `.rs`, but it's also annoying to handle name
     // collisions.
-    ItemId id(reinterpret_cast<uintptr_t>(&extra_source));
+    ItemId id =
+        invocation.item_ids_.Allocate(absl::StrCat("UseMod:", extra_source));
     invocation.ir_.items.push_back(UseMod{
         .path = extra_source,
         .mod_name = Identifier(absl::StrCat("__crubit_mod_", i)),
@@ -112,6 +127,10 @@ absl::StatusOr<IR> IrFromCc(IrFromCcOptions options) {
     ++i;
   }
   invocation.ir_.crubit_features = std::move(options.crubit_features);
+  invocation.AddIndexedCrubitFeatures();
+  if (options.input_files != nullptr) {
+    *options.input_files = std::move(invocation.input_files_);
+  }
   return invocation.ir_;
 }
 
@@ -7,14 +7,18 @@
 
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "lifetime_analysis/lifetime_summaries.h"
 #include "rs_bindings_from_cc/bazel_types.h"
 #include "rs_bindings_from_cc/ir.h"
+#include "rs_bindings_from_cc/target_args_index.h"
+#include "rs_bindings_from_cc/type_manifest.h"
 
 namespace crubit {
 
@@ -23,6 +27,12 @@ namespace crubit {
 static constexpr absl::string_view kInstantiationsNamespaceName =
     "__cc_template_instantiations";
 
+// Prefix of the aliases in `kInstantiationsNamespaceName` that name the
+// requested instantiations. The alias for `extra_instantiations[i]` is named
+// `kInstantiationAliasPrefix` followed by `i`.
+static constexpr absl::string_view kInstantiationAliasPrefix =
+    "__cc_template_instantiation_";
+
 struct NonCopyable final {
   NonCopyable() = default;
   NonCopyable(const NonCopyable&) = delete;
@@ -40,6 +50,16 @@ struct IrFromCcOptions final {
   absl::Span<const std::string> extra_instantiations = {};
   absl::flat_hash_map<BazelLabel, absl::flat_hash_set<std::string>>
       crubit_features = {};
+  const TargetArgsIndex* target_args_index = nullptr;
+  const DependencyTypes* dependency_types = nullptr;
+  const clang::tidy::lifetimes::LifetimeSummaryStore* lifetime_summaries =
+      nullptr;
+  bool lazy_import = false;
+  int template_instantiation_budget = -1;
+  bool parse_all_comments = true;
+  bool lean_unsupported_items = false;
+  bool string_view_as_slice_pointer = false;
+  std::vector<std::string>* input_files = nullptr;
 
   // Not an argument, just here to prevent the options struct from being
   // copied/moved with nontrivial lifetime implications.
@@ -72,6 +92,33 @@ static_assert(std::is_aggregate_v<IrFromCcOptions>);
 // * `extra_instantiations`: names of full C++ class template specializations
 //   to instantiate and generate bindings from.
 // * `crubit_features`: The set of Crubit features to enable for each target.
+// * `target_args_index`: if not null, the index used for the headers and the
+//   features of the targets that aren't in `headers_to_targets` and
+//   `crubit_features`. Only the features of `current_target` and of the
+//   targets whose headers were looked up are added to the IR.
+// * `dependency_types`: if not null, the records that the direct dependencies
+//   define, read from their type manifests. The records that the headers only
+//   forward declare refer to these definitions. See
+//   `Invocation::dependency_types_`.
+// * `lifetime_summaries`: if not null, the lifetimes inferred by lifetime
+//   analysis for the functions that have no lifetimes from annotations or
+//   elision. See `Invocation::lifetime_summaries_`.
+// * `lazy_import`: whether to only import the decls of `current_target` and
+//   the decls of other targets that they refer to, instead of all decls.
+// * `template_instantiation_budget`: if non-negative, class template
+//   specializations that are only reached through the types of other decls
+//   only import their layout, special members and the methods that the C++
+//   code uses, and at most this many templates are instantiated for the
+//   import. See `Invocation::template_instantiation_budget_`.
+// * `parse_all_comments`: whether to keep all comments, rather than only doc
+//   comments (`///` and `/** */`), as documentation and free comments.
+// * `lean_unsupported_items`: whether the decls that can't be imported are
+//   only recorded by their ids and error formats, without messages. See
+//   `Invocation::lean_unsupported_items_`.
+// * `string_view_as_slice_pointer`: whether string views are mapped to Rust
+//   `*const [u8]`. See `Invocation::string_view_as_slice_pointer_`.
+// * `input_files`: if not null, set to the absolute paths of the files that
+//   Clang read (the headers, including the system headers).
 //
 absl::StatusOr<IR> IrFromCc(IrFromCcOptions options);
 
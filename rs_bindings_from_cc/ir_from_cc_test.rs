@@ -95,9 +95,11 @@ fn test_function() {
                 nodiscard: None,
                 deprecated: None,
                 unknown_attr: None,
+                is_batched: false,
                 has_c_calling_convention: true,
                 is_member_or_descendant_of_class_template: false,
                 source_loc: "Generated from: google3/ir_from_cc_virtual_header.h;l=3",
+                public_header: Some(HeaderName { name: "ir_from_cc_virtual_header.h" }),
                 id: ItemId(...),
                 enclosing_item_id: None,
                 adl_enclosing_record: None,
@@ -120,6 +122,35 @@ fn test_function_with_asm_label() {
     );
 }
 
+#[test]
+fn test_function_with_batch_attribute() {
+    let ir = ir_from_cc(
+        r#"[[clang::annotate("crubit_internal_batch")]] int f(int a);
+        [[clang::annotate("crubit_internal_batch", 1)]] int g(int a);"#,
+    )
+    .unwrap();
+    assert_ir_matches!(
+        ir,
+        quote! {
+            Func {
+                name: "f", ...
+                unknown_attr: None,
+                is_batched: true, ...
+            }
+        }
+    );
+    assert_ir_matches!(
+        ir,
+        quote! {
+            Func {
+                name: "g", ...
+                unknown_attr: Some("clang::annotate"),
+                is_batched: false, ...
+            }
+        }
+    );
+}
+
 #[test]
 fn test_function_with_unnamed_parameters() {
     let ir = ir_from_cc("int f(int, int);").unwrap();
@@ -2437,6 +2468,7 @@ fn test_record_with_unsupported_base() -> Result<()> {
               unknown_attr: None,
               doc_comment: Some(...),
               source_loc: "Generated from: google3/ir_from_cc_virtual_header.h;l=15",
+              public_header: Some(HeaderName { name: "ir_from_cc_virtual_header.h" }),
               unambiguous_public_bases: [],
               fields: [Field {
                   identifier: Some("derived_field"), ...
@@ -2818,6 +2850,7 @@ fn test_member_function() {
             reference: ir::ReferenceQualification::Unqualified,
             is_const: false,
             is_virtual: false,
+            is_final: false,
         }),
     );
 }
@@ -2831,6 +2864,7 @@ fn test_member_function_const() {
             reference: ir::ReferenceQualification::Unqualified,
             is_const: true,
             is_virtual: false,
+            is_final: false,
         }),
     );
 }
@@ -2844,10 +2878,56 @@ fn test_member_function_virtual() {
             reference: ir::ReferenceQualification::Unqualified,
             is_const: false,
             is_virtual: true,
+            is_final: false,
+        }),
+    );
+}
+
+#[test]
+fn test_member_function_virtual_final() {
+    assert_member_function_has_instance_method_metadata(
+        "Function",
+        "virtual void Function() final;",
+        &Some(ir::InstanceMethodMetadata {
+            reference: ir::ReferenceQualification::Unqualified,
+            is_const: false,
+            is_virtual: true,
+            is_final: true,
         }),
     );
 }
 
+#[test]
+fn test_member_function_virtual_in_final_class() {
+    let ir = ir_from_cc(
+        r#"
+        struct Base {
+          virtual void Function();
+        };
+        struct Struct final : Base {
+          void Function() override;
+        }; "#,
+    )
+    .unwrap();
+    let struct_id = ir.records().find(|r| r.rs_name.as_ref() == "Struct").unwrap().id;
+    let metadata = |name: &str| {
+        ir.functions()
+            .find(|f| {
+                f.name == UnqualifiedIdentifier::Identifier(ir_id(name))
+                    && f.member_func_metadata.as_ref().unwrap().record_id == struct_id
+            })
+            .unwrap()
+            .member_func_metadata
+            .as_ref()
+            .unwrap()
+            .instance_method_metadata
+            .clone()
+            .unwrap()
+    };
+    assert!(metadata("Function").is_virtual);
+    assert!(metadata("Function").is_final);
+}
+
 #[test]
 fn test_member_function_lvalue() {
     assert_member_function_has_instance_method_metadata(
@@ -2857,6 +2937,7 @@ fn test_member_function_lvalue() {
             reference: ir::ReferenceQualification::LValue,
             is_const: false,
             is_virtual: false,
+            is_final: false,
         }),
     );
 }
@@ -2870,6 +2951,7 @@ fn test_member_function_rvalue() {
             reference: ir::ReferenceQualification::RValue,
             is_const: false,
             is_virtual: false,
+            is_final: false,
         }),
     );
 }
@@ -2925,6 +3007,7 @@ fn test_member_function_explicit_constructor() {
             reference: ir::ReferenceQualification::Unqualified,
             is_const: false,
             is_virtual: false,
+            is_final: false,
         }),
     );
 }
@@ -2947,6 +3030,7 @@ fn test_member_function_constructor() {
                 reference: ir::ReferenceQualification::Unqualified,
                 is_const: false,
                 is_virtual: false,
+                is_final: false,
             }),
         );
     }
@@ -4072,6 +4156,34 @@ fn test_source_location_with_macro_defined_in_another_file() {
     );
 }
 
+#[test]
+fn test_public_header() {
+    let ir = ir_from_cc_dependency(
+        "struct MyStruct final {}; void MyFunc(); using Alias = MyTemplate<int>;",
+        "void DependencyFunc(); template <typename T> struct MyTemplate { T t; };",
+    )
+    .unwrap();
+    let public_header = quote! { Some(HeaderName { name: "ir_from_cc_virtual_header.h" }) };
+    assert_ir_matches!(
+        ir,
+        quote! { Record { rs_name: "MyStruct", ..., public_header: #public_header, ... } }
+    );
+    assert_ir_matches!(
+        ir,
+        quote! { Func { name: "MyFunc", ..., public_header: #public_header, ... } }
+    );
+    // The header of the dependency isn't a public header of the current target.
+    assert_ir_matches!(
+        ir,
+        quote! { Func { name: "DependencyFunc", ..., public_header: None, ... } }
+    );
+    // Template instantiations may be triggered from any header.
+    assert_ir_matches!(
+        ir,
+        quote! { Record { rs_name: "__CcTemplateInst10MyTemplateIiE", ..., public_header: None, ... } }
+    );
+}
+
 #[test]
 fn test_source_location_class_template_specialization() {
     let cc_snippet = "template <typename T> class MyClassTemplateToTestSourceLocation { T t_; };
@@ -0,0 +1,165 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/merged_namespaces.h"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+
+namespace crubit {
+
+absl::Status MergedNamespaces::Add(absl::string_view namespaces_json) {
+  llvm::Expected<llvm::json::Value> json = llvm::json::parse(namespaces_json);
+  if (!json) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Malformed namespaces JSON: ",
+                     llvm::toString(json.takeError())));
+  }
+  const llvm::json::Object* hierarchy = json->getAsObject();
+  std::optional<llvm::StringRef> label =
+      hierarchy != nullptr ? hierarchy->getString("label") : std::nullopt;
+  if (!label) {
+    return absl::InvalidArgumentError(
+        "Malformed namespaces JSON: missing `label`");
+  }
+
+  // Converts a namespace of the file, with all the namespaces nested in it.
+  auto convert = [&](const auto& convert, const llvm::json::Value& value,
+                     Namespace& ns) -> absl::Status {
+    const llvm::json::Object* object = value.getAsObject();
+    std::optional<llvm::StringRef> name =
+        object != nullptr ? object->getString("name") : std::nullopt;
+    if (!name) {
+      return absl::InvalidArgumentError(
+          "Malformed namespaces JSON: missing namespace `name`");
+    }
+    ns.name = name->str();
+    ns.labels.insert(label->str());
+    if (const llvm::json::Array* children = object->getArray("children")) {
+      for (const llvm::json::Value& child_value : *children) {
+        Namespace child;
+        if (absl::Status status = convert(convert, child_value, child);
+            !status.ok()) {
+          return status;
+        }
+        std::string child_name = child.name;
+        ns.children.insert_or_assign(std::move(child_name), std::move(child));
+      }
+    }
+    return absl::OkStatus();
+  };
+
+  // Like in `MergedNamespaceHierarchy::from_json_namespace_hierarchy`, the
+  // namespaces of a single file are not merged with each other.
+  std::map<std::string, Namespace> file_namespaces;
+  if (const llvm::json::Array* namespaces = hierarchy->getArray("namespaces")) {
+    for (const llvm::json::Value& value : *namespaces) {
+      Namespace ns;
+      if (absl::Status status = convert(convert, value, ns); !status.ok()) {
+        return status;
+      }
+      std::string name = ns.name;
+      file_namespaces.insert_or_assign(std::move(name), std::move(ns));
+    }
+  }
+  for (auto& [name, ns] : file_namespaces) {
+    auto it = top_level_namespaces_.find(name);
+    if (it == top_level_namespaces_.end()) {
+      top_level_namespaces_.emplace(name, std::move(ns));
+    } else {
+      Merge(it->second, std::move(ns));
+    }
+  }
+  return absl::OkStatus();
+}
+
+void MergedNamespaces::Merge(Namespace& ns, Namespace other) {
+  ns.labels.merge(other.labels);
+  for (auto& [name, child] : other.children) {
+    AddChild(ns, std::move(child));
+  }
+}
+
+void MergedNamespaces::AddChild(Namespace& ns, Namespace child) {
+  ns.labels.insert(child.labels.begin(), child.labels.end());
+  auto it = ns.children.find(child.name);
+  if (it == ns.children.end()) {
+    std::string name = child.name;
+    ns.children.emplace(std::move(name), std::move(child));
+    return;
+  }
+  // Like `MergedNamespace::add_child`, the labels of a namespace that was
+  // already reopened are not added to it (only to its parent).
+  for (auto& [name, grandchild] : child.children) {
+    AddChild(it->second, std::move(grandchild));
+  }
+}
+
+std::string MergedNamespaces::ToPrecomputedJson(
+    absl::Span<const std::string> sources) const {
+  std::set<absl::string_view> labels;
+  auto collect_labels = [&](const auto& collect_labels,
+                            const Namespace& ns) -> void {
+    labels.insert(ns.labels.begin(), ns.labels.end());
+    for (const auto& [name, child] : ns.children) {
+      collect_labels(collect_labels, child);
+    }
+  };
+  for (const auto& [name, ns] : top_level_namespaces_) {
+    collect_labels(collect_labels, ns);
+  }
+  std::map<absl::string_view, int64_t> label_indices;
+  llvm::json::Array label_array;
+  for (absl::string_view label : labels) {
+    label_indices.emplace(label, label_indices.size());
+    label_array.push_back(std::string(label));
+  }
+
+  auto to_json = [&](const auto& to_json,
+                     const Namespace& ns) -> llvm::json::Value {
+    llvm::json::Object object{{"n", ns.name}};
+    if (!ns.labels.empty()) {
+      llvm::json::Array indices;
+      for (const std::string& label : ns.labels) {
+        indices.push_back(label_indices.at(label));
+      }
+      object["l"] = std::move(indices);
+    }
+    if (!ns.children.empty()) {
+      llvm::json::Array children;
+      for (const auto& [name, child] : ns.children) {
+        children.push_back(to_json(to_json, child));
+      }
+      object["c"] = std::move(children);
+    }
+    return object;
+  };
+  llvm::json::Array namespaces;
+  for (const auto& [name, ns] : top_level_namespaces_) {
+    namespaces.push_back(to_json(to_json, ns));
+  }
+
+  llvm::json::Array source_array;
+  for (const std::string& source : sources) source_array.push_back(source);
+  llvm::json::Value result = llvm::json::Object{
+      {"sources", std::move(source_array)},
+      {"labels", std::move(label_array)},
+      {"namespaces", std::move(namespaces)},
+  };
+  return llvm::formatv("{0}", result);
+}
+
+}  // namespace crubit
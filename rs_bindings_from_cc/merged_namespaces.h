@@ -0,0 +1,54 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_MERGED_NAMESPACES_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_MERGED_NAMESPACES_H_
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace crubit {
+
+// The namespace hierarchy of the C++ dependencies of a Rust crate, merged from
+// the `*_namespaces.json` files of the dependencies (see collect_namespaces.h).
+//
+// The hierarchy is merged once, when the crate is built (see
+// `merged_namespaces_builder.cc`), so that the `cc_import!` macro doesn't need
+// to read and merge the files of all the dependencies again in every
+// expansion. The merging matches `MergedNamespaceHierarchy::merge` in
+// support/cc_import/merged_namespaces.rs.
+class MergedNamespaces {
+ public:
+  // Merges the hierarchy in the contents of a `*_namespaces.json` file into
+  // this one.
+  absl::Status Add(absl::string_view namespaces_json);
+
+  // Returns the merged hierarchy of the files at `sources` (which have been
+  // `Add`ed in that order), as the JSON of a `PrecomputedNamespaceHierarchy`
+  // in support/cc_import/merged_namespaces.rs. Each label is only stored once,
+  // and is referred to by its index.
+  std::string ToPrecomputedJson(absl::Span<const std::string> sources) const;
+
+ private:
+  struct Namespace {
+    std::string name;
+    std::map<std::string, Namespace> children;
+    // The targets that reopen this namespace.
+    std::set<std::string> labels;
+  };
+
+  static void Merge(Namespace& ns, Namespace other);
+  static void AddChild(Namespace& ns, Namespace child);
+
+  std::map<std::string, Namespace> top_level_namespaces_;
+};
+
+}  // namespace crubit
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_MERGED_NAMESPACES_H_
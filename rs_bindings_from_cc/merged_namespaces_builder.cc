@@ -0,0 +1,71 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Merges the `*_namespaces.json` files of the C++ dependencies of a Rust crate
+// (see merged_namespaces.h) into a rustc env file, which sets
+// `CC_IMPORT_MERGED_NAMESPACES` for the `cc_import!` macro:
+//
+//   merged_namespaces_builder --out=namespaces.env a_namespaces.json ...
+//
+// The files must be listed in the same order as in `CC_IMPORT_NAMESPACES`.
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "common/file_io.h"
+#include "common/status_macros.h"
+#include "rs_bindings_from_cc/merged_namespaces.h"
+
+ABSL_FLAG(std::string, out, "", "output path for the rustc env file");
+ABSL_FLAG(int64_t, max_size, 100000,
+          "maximum size of the merged hierarchy, in bytes; a larger one "
+          "doesn't fit into an environment variable, so the env file is left "
+          "empty, and `cc_import!` merges the namespace files itself");
+
+namespace crubit {
+namespace {
+
+absl::Status Main(absl::Span<char* const> namespace_files) {
+  std::string out = absl::GetFlag(FLAGS_out);
+  if (out.empty()) return absl::InvalidArgumentError("please specify --out");
+  std::vector<std::string> sources;
+  MergedNamespaces merged;
+  for (const char* namespace_file : namespace_files) {
+    CRUBIT_ASSIGN_OR_RETURN(std::string contents,
+                            GetFileContents(namespace_file));
+    if (absl::Status status = merged.Add(contents); !status.ok()) {
+      return absl::Status(status.code(),
+                          absl::StrCat("`", namespace_file, "`: ",
+                                       status.message()));
+    }
+    sources.push_back(namespace_file);
+  }
+  std::string json = merged.ToPrecomputedJson(sources);
+  if (static_cast<int64_t>(json.size()) > absl::GetFlag(FLAGS_max_size)) {
+    return SetFileContents(out, "");
+  }
+  return SetFileContents(
+      out, absl::StrCat("CC_IMPORT_MERGED_NAMESPACES=", json, "\n"));
+}
+
+}  // namespace
+}  // namespace crubit
+
+int main(int argc, char* argv[]) {
+  std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  // Skip $0.
+  absl::Status status = crubit::Main(absl::MakeConstSpan(args).subspan(1));
+  if (!status.ok()) {
+    std::cerr << status << std::endl;
+    return 1;
+  }
+  return 0;
+}
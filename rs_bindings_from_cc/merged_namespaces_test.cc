@@ -0,0 +1,80 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/merged_namespaces.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "common/status_test_matchers.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::HasSubstr;
+
+TEST(MergedNamespacesTest, Empty) {
+  MergedNamespaces merged;
+  EXPECT_EQ(merged.ToPrecomputedJson({}),
+            R"({"labels":[],"namespaces":[],"sources":[]})");
+}
+
+TEST(MergedNamespacesTest, MergesReopenedNamespaces) {
+  MergedNamespaces merged;
+  ASSERT_OK(merged.Add(R"({
+    "label": "//foo/bar:baz",
+    "namespaces": [
+      {
+        "name": "top_level_1",
+        "children": [
+          {
+            "name": "reopened",
+            "children": [{"name": "baz_specific", "children": []}]
+          }
+        ]
+      }
+    ]
+  })"));
+  ASSERT_OK(merged.Add(R"({
+    "label": "//foo/bar:xyz",
+    "namespaces": [
+      {
+        "name": "top_level_1",
+        "children": [
+          {"name": "xyz_specific", "children": []},
+          {"name": "reopened", "children": []}
+        ]
+      },
+      {"name": "top_level_2", "children": []}
+    ]
+  })"));
+  ASSERT_OK(merged.Add(R"({"label": "//foo/bar:empty"})"));
+
+  // Like in the `cc_import!` macro, `reopened` isn't attributed to `xyz`,
+  // which only reopens it.
+  EXPECT_EQ(merged.ToPrecomputedJson({"baz.json", "xyz.json", "empty.json"}),
+            R"({"labels":["//foo/bar:baz","//foo/bar:xyz"],)"
+            R"("namespaces":[)"
+            R"({"c":[)"
+            R"({"c":[{"l":[0],"n":"baz_specific"}],"l":[0],"n":"reopened"},)"
+            R"({"l":[1],"n":"xyz_specific"}],)"
+            R"("l":[0,1],"n":"top_level_1"},)"
+            R"({"l":[1],"n":"top_level_2"}],)"
+            R"("sources":["baz.json","xyz.json","empty.json"]})");
+}
+
+TEST(MergedNamespacesTest, MalformedJson) {
+  MergedNamespaces merged;
+  EXPECT_THAT(merged.Add("{"), StatusIs(absl::StatusCode::kInvalidArgument,
+                                        HasSubstr("Malformed")));
+  EXPECT_THAT(merged.Add(R"({"namespaces": []})"),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("missing `label`")));
+  EXPECT_THAT(merged.Add(R"({"label": "//a", "namespaces": [{}]})"),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("missing namespace `name`")));
+}
+
+}  // namespace
+}  // namespace crubit
@@ -0,0 +1,191 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/multi_tool.h"
+
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "lifetime_analysis/analyze.h"
+#include "lifetime_analysis/lifetime_summaries.h"
+#include "lifetime_annotations/lifetime_annotations.h"
+#include "nullability/inference/collect_evidence.h"
+#include "nullability/inference/evidence_shard.h"
+#include "nullability/inference/infer_tu.h"
+#include "nullability/inference/inference.proto.h"
+#include "nullability/pointer_nullability_diagnosis.h"
+#include "nullability/pragma.h"
+#include "rs_bindings_from_cc/ast_consumer.h"
+#include "rs_bindings_from_cc/decl_importer.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace crubit {
+namespace {
+
+namespace lifetimes = ::clang::tidy::lifetimes;
+namespace nullability = ::clang::tidy::nullability;
+
+void ReportError(clang::DiagnosticsEngine& diagnostics,
+                 llvm::StringRef message) {
+  diagnostics.Report(diagnostics.getCustomDiagID(
+      clang::DiagnosticsEngine::Error, "crubit multi_tool: %0"))
+      << message;
+}
+
+// Writes `path` with `write`, reporting an error if that fails.
+void WriteFile(clang::DiagnosticsEngine& diagnostics, llvm::StringRef path,
+               llvm::function_ref<void(llvm::raw_ostream&)> write) {
+  std::error_code error;
+  llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_None);
+  if (!error) {
+    write(out);
+    out.close();
+    error = out.error();
+  }
+  if (error) {
+    ReportError(diagnostics, "could not write `" + path.str() +
+                                 "`: " + error.message());
+  }
+}
+
+class MultiToolConsumer : public clang::ASTConsumer {
+ public:
+  MultiToolConsumer(
+      clang::CompilerInstance& instance, const MultiToolOptions& options,
+      const nullability::NullabilityPragmas& pragmas,
+      const lifetimes::LifetimeAnnotationContext& lifetime_context,
+      lifetimes::LifetimeSummaryStore* lifetime_summaries,
+      Invocation* invocation)
+      : instance_(instance),
+        options_(options),
+        pragmas_(pragmas),
+        lifetime_context_(lifetime_context),
+        lifetime_summaries_(lifetime_summaries),
+        invocation_(invocation) {}
+
+  void HandleTranslationUnit(clang::ASTContext& ast_context) override {
+    // As with `rs_bindings_from_cc`, nothing is written for a TU that doesn't
+    // compile, and Clang has already printed the errors.
+    if (ast_context.getDiagnostics().hasErrorOccurred()) return;
+    if (!options_.nullability_diagnostics_out.empty()) {
+      WriteNullabilityDiagnostics(ast_context);
+    }
+    if (!options_.evidence_out.empty()) WriteEvidence(ast_context);
+    if (lifetime_summaries_ != nullptr) WriteLifetimeSummaries(ast_context);
+    if (invocation_ != nullptr) WriteIr(ast_context);
+  }
+
+ private:
+  void WriteNullabilityDiagnostics(clang::ASTContext& ast_context) {
+    std::string findings;
+    nullability::diagnoseTranslationUnit(
+        ast_context, pragmas_,
+        [&](const clang::ValueDecl& decl,
+            llvm::Expected<
+                llvm::SmallVector<nullability::PointerNullabilityDiagnostic>>
+                diagnostics) {
+          findings +=
+              nullability::renderDiagnoses(decl, std::move(diagnostics));
+        });
+    WriteFile(ast_context.getDiagnostics(),
+              options_.nullability_diagnostics_out,
+              [&](llvm::raw_ostream& out) { out << findings; });
+  }
+
+  void WriteEvidence(clang::ASTContext& ast_context) {
+    nullability::EvidenceShardWriter shard;
+    nullability::collectTUEvidence(
+        ast_context, pragmas_,
+        [&](const nullability::Evidence& evidence) { shard.add(evidence); },
+        /*Previous=*/{}, /*Filter=*/nullptr, /*Stats=*/nullptr,
+        /*WideningThreshold=*/0, /*Deduplicate=*/false, options_.usr_cache);
+    WriteFile(ast_context.getDiagnostics(), options_.evidence_out,
+              [&](llvm::raw_ostream& out) { out << shard.finish(); });
+  }
+
+  void WriteLifetimeSummaries(clang::ASTContext& ast_context) {
+    lifetimes::AnalyzeTranslationUnit(
+        ast_context.getTranslationUnitDecl(), lifetime_context_,
+        /*diag_reporter=*/{}, /*debug_info=*/nullptr, lifetime_summaries_);
+    if (llvm::Error error =
+            lifetime_summaries_->Write(options_.lifetime_summaries_out)) {
+      ReportError(ast_context.getDiagnostics(),
+                  llvm::toString(std::move(error)));
+    }
+  }
+
+  void WriteIr(clang::ASTContext& ast_context) {
+    AstConsumer(instance_, *invocation_).HandleTranslationUnit(ast_context);
+    WriteFile(ast_context.getDiagnostics(), options_.ir_out,
+              [&](llvm::raw_ostream& out) { invocation_->ir_.WriteJson(out); });
+  }
+
+  clang::CompilerInstance& instance_;
+  const MultiToolOptions& options_;
+  const nullability::NullabilityPragmas& pragmas_;
+  const lifetimes::LifetimeAnnotationContext& lifetime_context_;
+  lifetimes::LifetimeSummaryStore* lifetime_summaries_;
+  Invocation* invocation_;
+};
+
+}  // namespace
+
+std::unique_ptr<clang::ASTConsumer> MultiToolAction::CreateASTConsumer(
+    clang::CompilerInstance& instance, llvm::StringRef) {
+  clang::DiagnosticsEngine& diagnostics = instance.getDiagnostics();
+  if (!options_.lifetime_summaries_out.empty()) {
+    llvm::Expected<lifetimes::LifetimeSummaryStore> store =
+        lifetimes::LifetimeSummaryStore::Read(options_.lifetime_summaries_out);
+    if (!store) {
+      ReportError(diagnostics, llvm::toString(store.takeError()));
+      return nullptr;
+    }
+    lifetime_summaries_ = *std::move(store);
+  }
+  lifetimes::LifetimeSummaryStore* lifetime_summaries =
+      lifetime_summaries_.has_value() ? &*lifetime_summaries_ : nullptr;
+
+  if (!options_.ir_out.empty()) {
+    if (!options_.target.has_value() || options_.public_headers.empty()) {
+      ReportError(diagnostics,
+                  "writing the IR needs a target and public headers");
+      return nullptr;
+    }
+    header_targets_ = options_.header_targets;
+    for (const HeaderName& header : options_.public_headers) {
+      header_targets_.try_emplace(header, *options_.target);
+    }
+    invocation_ = std::make_unique<Invocation>(
+        *options_.target, options_.public_headers, header_targets_,
+        options_.lazy_import, /*target_args_index=*/nullptr,
+        options_.template_instantiation_budget, /*dependency_types=*/nullptr,
+        lifetime_summaries);
+    // The importer and lifetime analysis read the same annotations.
+    lifetime_context_ = invocation_->lifetime_context_;
+  } else {
+    lifetime_context_ =
+        std::make_shared<lifetimes::LifetimeAnnotationContext>();
+  }
+  lifetimes::AddLifetimeAnnotationHandlers(instance.getPreprocessor(),
+                                           lifetime_context_);
+  nullability::registerPragmaHandler(instance.getPreprocessor(), pragmas_);
+
+  return std::make_unique<MultiToolConsumer>(
+      instance, options_, pragmas_, *lifetime_context_, lifetime_summaries,
+      invocation_.get());
+}
+
+}  // namespace crubit
@@ -0,0 +1,94 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_MULTI_TOOL_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_MULTI_TOOL_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "lifetime_analysis/lifetime_summaries.h"
+#include "lifetime_annotations/lifetime_annotations.h"
+#include "nullability/inference/collect_evidence.h"
+#include "nullability/pragma.h"
+#include "rs_bindings_from_cc/bazel_types.h"
+#include "rs_bindings_from_cc/decl_importer.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace crubit {
+
+// The tools that `MultiToolAction` runs on a translation unit, and where each
+// writes its output. A tool runs if its output path is not empty.
+struct MultiToolOptions {
+  // The IR of the bindings of `target`, as written by `rs_bindings_from_cc
+  // --ir_only`. The arguments below mean the same as the flags of
+  // `rs_bindings_from_cc`. The public headers belong to `target`, and the
+  // other headers to the targets of `header_targets`.
+  std::string ir_out;
+  std::optional<BazelLabel> target;
+  std::vector<HeaderName> public_headers;
+  absl::flat_hash_map<HeaderName, BazelLabel> header_targets;
+  bool lazy_import = false;
+  int template_instantiation_budget = -1;
+
+  // The findings of the nullability checks on all the functions of the TU, as
+  // printed by diagnose_tu_main.
+  std::string nullability_diagnostics_out;
+
+  // The nullability evidence of the TU, as the shard written by
+  // collect_evidence_main. If not null, the USRs of the evidence are looked
+  // up in (and added to) `usr_cache`.
+  std::string evidence_out;
+  clang::tidy::nullability::SharedUSRCache* usr_cache = nullptr;
+
+  // The lifetimes that lifetime analysis infers for the functions of the TU,
+  // as a `LifetimeSummaryStore`. The store is read from this path if it
+  // exists, so that the functions it already has summaries for are not
+  // analyzed again, and then written back with the new summaries. When the IR
+  // is written too, the importer takes the lifetimes of unannotated functions
+  // from the store, as with `rs_bindings_from_cc --lifetime_summaries`.
+  std::string lifetime_summaries_out;
+};
+
+// Parses a translation unit once, and runs the tools of `MultiToolOptions` on
+// the same AST, instead of each tool parsing the TU on its own. The tools also
+// share the preprocessor state that they record during the parse: the
+// nullability pragmas, and the lifetime annotations.
+//
+// The nullability tools run first, on the AST as parsed. Lifetime analysis
+// runs next, so that its summaries are complete before the importer, which
+// runs last as it instantiates templates in the AST.
+//
+// Errors writing the outputs are reported as Clang errors, so that the action
+// fails.
+class MultiToolAction : public clang::ASTFrontendAction {
+ public:
+  // `options` must outlive the action.
+  explicit MultiToolAction(const MultiToolOptions& options)
+      : options_(options) {}
+
+ protected:
+  std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
+      clang::CompilerInstance& instance, llvm::StringRef) override;
+
+ private:
+  const MultiToolOptions& options_;
+  absl::flat_hash_map<HeaderName, BazelLabel> header_targets_;
+  clang::tidy::nullability::NullabilityPragmas pragmas_;
+  std::shared_ptr<clang::tidy::lifetimes::LifetimeAnnotationContext>
+      lifetime_context_;
+  std::optional<clang::tidy::lifetimes::LifetimeSummaryStore>
+      lifetime_summaries_;
+  std::unique_ptr<Invocation> invocation_;
+};
+
+}  // namespace crubit
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_MULTI_TOOL_H_
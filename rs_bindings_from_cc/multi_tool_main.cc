@@ -0,0 +1,159 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// multi_tool_main parses a translation unit once and runs any of the Crubit
+// tools on it (see `MultiToolAction`), each writing its own output:
+//
+//   multi_tool_main -p build/ foo/foo.cc \
+//       -ir_out=foo_rust_api_ir.json -target=//foo:foo \
+//       -public_header=foo/foo.h \
+//       -nullability_diagnostics_out=foo.nullability.txt \
+//       -evidence_out=foo.shard -usr_cache=usrs.cache \
+//       -lifetime_summaries_out=lifetimes.summaries
+//
+// The IR is turned into bindings by `rs_bindings_from_cc --ir_in`, the
+// evidence shards are merged by merge_main, and the lifetime summaries are
+// read by `rs_bindings_from_cc --lifetime_summaries` (and by later runs of
+// this tool on other TUs).
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "nullability/inference/collect_evidence.h"
+#include "nullability/type_nullability.h"
+#include "rs_bindings_from_cc/bazel_types.h"
+#include "rs_bindings_from_cc/multi_tool.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+
+llvm::cl::OptionCategory options_category("multi_tool_main options");
+
+llvm::cl::opt<std::string> ir_out_flag{
+    "ir_out",
+    llvm::cl::desc("Output path for the bindings IR of -target"),
+    llvm::cl::cat(options_category),
+};
+llvm::cl::opt<std::string> target_flag{
+    "target",
+    llvm::cl::desc("The target that the bindings IR is for"),
+    llvm::cl::cat(options_category),
+};
+llvm::cl::list<std::string> public_header_flag{
+    "public_header",
+    llvm::cl::desc("A public header of -target (may be repeated)"),
+    llvm::cl::cat(options_category),
+};
+llvm::cl::opt<bool> lazy_import_flag{
+    "lazy_import",
+    llvm::cl::desc("Only import the declarations of -target, and those of "
+                   "other targets that they refer to"),
+    llvm::cl::init(false),
+    llvm::cl::cat(options_category),
+};
+llvm::cl::opt<int> template_instantiation_budget_flag{
+    "template_instantiation_budget",
+    llvm::cl::desc("As for rs_bindings_from_cc (-1: no budget)"),
+    llvm::cl::init(-1),
+    llvm::cl::cat(options_category),
+};
+llvm::cl::opt<std::string> nullability_diagnostics_out_flag{
+    "nullability_diagnostics_out",
+    llvm::cl::desc("Output path for the findings of the nullability checks"),
+    llvm::cl::cat(options_category),
+};
+llvm::cl::opt<std::string> evidence_out_flag{
+    "evidence_out",
+    llvm::cl::desc("Output path for the nullability evidence shard"),
+    llvm::cl::cat(options_category),
+};
+llvm::cl::opt<std::string> usr_cache_flag{
+    "usr_cache",
+    llvm::cl::desc("File that keeps the USRs of header declarations for the "
+                   "evidence between runs, as for collect_evidence_main"),
+    llvm::cl::cat(options_category),
+};
+llvm::cl::opt<std::string> lifetime_summaries_out_flag{
+    "lifetime_summaries_out",
+    llvm::cl::desc("Lifetime summary store to read (if it exists) and to "
+                   "write back with the lifetimes inferred for the TU"),
+    llvm::cl::cat(options_category),
+};
+
+}  // namespace
+
+int main(int argc, const char** argv) {
+  using clang::tooling::ArgumentInsertPosition;
+  auto parser = clang::tooling::CommonOptionsParser::create(argc, argv,
+                                                            options_category);
+  QCHECK(parser) << llvm::toString(parser.takeError());
+  QCHECK_EQ(parser->getSourcePathList().size(), 1u)
+      << "the outputs are for a single translation unit";
+
+  crubit::MultiToolOptions options{
+      .ir_out = ir_out_flag,
+      .lazy_import = lazy_import_flag,
+      .template_instantiation_budget = template_instantiation_budget_flag,
+      .nullability_diagnostics_out = nullability_diagnostics_out_flag,
+      .evidence_out = evidence_out_flag,
+      .lifetime_summaries_out = lifetime_summaries_out_flag,
+  };
+  if (!target_flag.empty()) options.target = crubit::BazelLabel(target_flag);
+  for (const std::string& header : public_header_flag) {
+    options.public_headers.push_back(crubit::HeaderName(header));
+  }
+
+  clang::tidy::nullability::enableSmartPointers(true);
+  std::optional<clang::tidy::nullability::SharedUSRCache> usr_cache;
+  if (!evidence_out_flag.empty() && !usr_cache_flag.empty()) {
+    usr_cache.emplace();
+    if (llvm::sys::fs::exists(usr_cache_flag)) {
+      llvm::Error error = usr_cache->load(usr_cache_flag);
+      QCHECK(!error) << usr_cache_flag << ": "
+                     << llvm::toString(std::move(error));
+    }
+    options.usr_cache = &*usr_cache;
+  }
+
+  clang::tooling::ClangTool tool(parser->getCompilations(),
+                                 parser->getSourcePathList());
+  // The importer takes the documentation of the declarations from all their
+  // comments, as `rs_bindings_from_cc` does.
+  if (!options.ir_out.empty()) {
+    tool.appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+        "-fparse-all-comments", ArgumentInsertPosition::BEGIN));
+  }
+  class Factory : public clang::tooling::FrontendActionFactory {
+   public:
+    explicit Factory(const crubit::MultiToolOptions& options)
+        : options_(options) {}
+    std::unique_ptr<clang::FrontendAction> create() override {
+      return std::make_unique<crubit::MultiToolAction>(options_);
+    }
+
+   private:
+    const crubit::MultiToolOptions& options_;
+  };
+  Factory factory(options);
+  int result = tool.run(&factory);
+
+  if (usr_cache.has_value()) {
+    if (llvm::Error error = usr_cache->save(usr_cache_flag)) {
+      llvm::errs() << usr_cache_flag << ": "
+                   << llvm::toString(std::move(error)) << "\n";
+    }
+  }
+  return result;
+}
@@ -0,0 +1,78 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/multi_tool.h"
+
+#include <memory>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/file_io.h"
+#include "rs_bindings_from_cc/bazel_types.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/FileSystem.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Not;
+
+constexpr absl::string_view kHeader = R"cc(
+  struct Foo {
+    int x;
+  };
+  inline int Deref(int* _Nullable p) { return *p; }
+  inline int* Identity(int* p) { return p; }
+)cc";
+
+bool RunMultiTool(const MultiToolOptions& options) {
+  return clang::tooling::runToolOnCodeWithArgs(
+      std::make_unique<MultiToolAction>(options), "#include \"test/foo.h\"\n",
+      {"-std=c++17"}, "test/foo.cc", "clang",
+      std::make_shared<clang::PCHContainerOperations>(),
+      {{"test/foo.h", std::string(kHeader)}});
+}
+
+std::string OutputPath(absl::string_view name) {
+  return absl::StrCat(testing::TempDir(), "/", name);
+}
+
+std::string ReadOutput(const std::string& path) {
+  absl::StatusOr<std::string> contents = GetFileContents(path);
+  EXPECT_TRUE(contents.ok()) << contents.status();
+  return contents.ok() ? *contents : "";
+}
+
+TEST(MultiToolTest, WritesEveryOutputFromOneParse) {
+  MultiToolOptions options{
+      .ir_out = OutputPath("ir.json"),
+      .target = BazelLabel("//test:foo"),
+      .public_headers = {HeaderName("test/foo.h")},
+      .nullability_diagnostics_out = OutputPath("diagnostics.txt"),
+      .evidence_out = OutputPath("evidence.shard"),
+      .lifetime_summaries_out = OutputPath("lifetimes.summaries"),
+  };
+  llvm::sys::fs::remove(options.lifetime_summaries_out);
+  ASSERT_TRUE(RunMultiTool(options));
+
+  EXPECT_THAT(ReadOutput(options.ir_out), HasSubstr("\"Foo\""));
+  EXPECT_THAT(ReadOutput(options.nullability_diagnostics_out),
+              HasSubstr("warning: expected nonnull"));
+  EXPECT_THAT(ReadOutput(options.evidence_out), Not(IsEmpty()));
+  EXPECT_THAT(ReadOutput(options.lifetime_summaries_out), Not(IsEmpty()));
+}
+
+TEST(MultiToolTest, IrNeedsTarget) {
+  EXPECT_FALSE(RunMultiTool({.ir_out = OutputPath("no_target_ir.json")}));
+}
+
+}  // namespace
+}  // namespace crubit
@@ -0,0 +1,78 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/persistent_worker.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace crubit {
+
+bool IsPersistentWorker(absl::Span<char* const> args) {
+  return std::any_of(args.begin(), args.end(), [](const char* arg) {
+    return absl::string_view(arg) == "--persistent_worker";
+  });
+}
+
+absl::Status RunPersistentWorker(std::istream& in, llvm::raw_ostream& out,
+                                 const WorkRequestHandler& handler) {
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty()) continue;
+    llvm::Expected<llvm::json::Value> request = llvm::json::parse(line);
+    if (!request) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Malformed work request: ",
+                       llvm::toString(request.takeError())));
+    }
+    const llvm::json::Object* request_obj = request->getAsObject();
+    if (request_obj == nullptr) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Work request is not an object: ", line));
+    }
+
+    // Fields with default values are omitted from the JSON, so a missing
+    // `arguments` is empty and a missing `requestId` is 0.
+    std::vector<std::string> arguments;
+    if (const llvm::json::Array* args = request_obj->getArray("arguments")) {
+      for (const llvm::json::Value& arg : *args) {
+        std::optional<llvm::StringRef> arg_str = arg.getAsString();
+        if (!arg_str.has_value()) {
+          return absl::InvalidArgumentError(
+              absl::StrCat("Work request argument is not a string: ", line));
+        }
+        arguments.push_back(arg_str->str());
+      }
+    }
+    int64_t request_id = request_obj->getInteger("requestId").value_or(0);
+
+    absl::Status status = handler(arguments);
+
+    llvm::json::Object response;
+    response["exitCode"] = status.ok() ? 0 : 1;
+    response["output"] = std::string(status.message());
+    response["requestId"] = request_id;
+    out << llvm::formatv("{0}", llvm::json::Value(std::move(response)))
+        << "\n";
+    out.flush();
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace crubit
@@ -0,0 +1,48 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_PERSISTENT_WORKER_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_PERSISTENT_WORKER_H_
+
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace crubit {
+
+// Returns whether the command line `args` (without the program name) asks
+// for the process to run as a Bazel persistent worker, i.e. whether it
+// contains `--persistent_worker`.
+//
+// This must be checked before flag parsing, because the flag is not an Abseil
+// flag.
+bool IsPersistentWorker(absl::Span<char* const> args);
+
+// Handles one work request, given the arguments of the request as they would
+// have been passed on the command line (without the program name).
+using WorkRequestHandler =
+    std::function<absl::Status(const std::vector<std::string>& arguments)>;
+
+// Serves the work requests that Bazel sends to a persistent worker using the
+// JSON worker protocol, until `in` is closed:
+// https://bazel.build/remote/creating#work-request
+//
+// Each line of `in` is a JSON `WorkRequest`, which is passed to `handler`, and
+// for each a JSON `WorkResponse` line is written to `out`. A request that
+// `handler` fails has a nonzero `exitCode` and the error message as its
+// `output`.
+//
+// Returns an error if `in` contains something other than a work request, in
+// which case the worker can't continue.
+absl::Status RunPersistentWorker(std::istream& in, llvm::raw_ostream& out,
+                                 const WorkRequestHandler& handler);
+
+}  // namespace crubit
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_PERSISTENT_WORKER_H_
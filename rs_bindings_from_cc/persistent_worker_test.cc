@@ -0,0 +1,83 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/persistent_worker.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "common/status_test_matchers.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+
+TEST(PersistentWorkerTest, IsPersistentWorker) {
+  char rs_out[] = "--rs_out=foo.rs";
+  char persistent_worker[] = "--persistent_worker";
+  std::vector<char*> args = {rs_out};
+  EXPECT_FALSE(IsPersistentWorker(args));
+  args.push_back(persistent_worker);
+  EXPECT_TRUE(IsPersistentWorker(args));
+}
+
+TEST(PersistentWorkerTest, ServesRequests) {
+  std::istringstream in(
+      R"({"arguments": ["--rs_out=a.rs", "a.h"], "requestId": 1})"
+      "\n"
+      R"({"arguments": ["--fail"], "requestId": 2})"
+      "\n"
+      // Fields with default values may be omitted.
+      "{}\n");
+  std::string out;
+  llvm::raw_string_ostream out_stream(out);
+  std::vector<std::vector<std::string>> requests;
+
+  EXPECT_THAT(
+      RunPersistentWorker(in, out_stream,
+                          [&](const std::vector<std::string>& arguments) {
+                            requests.push_back(arguments);
+                            if (arguments == std::vector<std::string>{
+                                                 "--fail"}) {
+                              return absl::InvalidArgumentError("failed");
+                            }
+                            return absl::OkStatus();
+                          }),
+      IsOk());
+  EXPECT_THAT(requests,
+              ElementsAre(ElementsAre("--rs_out=a.rs", "a.h"),
+                          ElementsAre("--fail"), IsEmpty()));
+  EXPECT_EQ(out_stream.str(),
+            R"({"exitCode":0,"output":"","requestId":1})"
+            "\n"
+            R"({"exitCode":1,"output":"failed","requestId":2})"
+            "\n"
+            R"({"exitCode":0,"output":"","requestId":0})"
+            "\n");
+}
+
+TEST(PersistentWorkerTest, MalformedRequest) {
+  std::istringstream in("not json\n");
+  std::string out;
+  llvm::raw_string_ostream out_stream(out);
+  EXPECT_THAT(RunPersistentWorker(
+                  in, out_stream,
+                  [](const std::vector<std::string>&) {
+                    return absl::OkStatus();
+                  }),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Malformed work request")));
+  EXPECT_THAT(out, IsEmpty());
+}
+
+}  // namespace
+}  // namespace crubit
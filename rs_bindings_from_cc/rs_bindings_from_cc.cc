@@ -7,37 +7,81 @@
 // * a C++ source file with the implementation of the bindings
 
 #include <cstddef>
+#include <iostream>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/flags/parse.h"
+#include "absl/flags/reflection.h"
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "common/file_io.h"
 #include "common/status_macros.h"
+#include "common/time_trace.h"
+#include "rs_bindings_from_cc/bindings_cache.h"
 #include "rs_bindings_from_cc/cmdline.h"
 #include "rs_bindings_from_cc/collect_namespaces.h"
 #include "rs_bindings_from_cc/generate_bindings_and_metadata.h"
 #include "rs_bindings_from_cc/ir.h"
+#include "rs_bindings_from_cc/persistent_worker.h"
 #include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/JSON.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/raw_ostream.h"
 
 namespace crubit {
 
-std::string InstantiationsAsJson(
-    const BindingsAndMetadata& bindings_and_metadata) {
+void WriteInstantiationsAsJson(
+    llvm::raw_ostream& os, const BindingsAndMetadata& bindings_and_metadata) {
   llvm::json::Object obj;
   for (const auto& entry : bindings_and_metadata.instantiations) {
     obj[entry.first] = entry.second;
   }
-  return std::string(llvm::formatv("{0:2}", llvm::json::Value(std::move(obj))));
+  os << llvm::formatv("{0:2}", llvm::json::Value(std::move(obj)));
 }
 
-absl::Status Main(absl::Span<char* const> positional_args) {
-  CRUBIT_ASSIGN_OR_RETURN(Cmdline cmdline, Cmdline::FromFlags());
+// Writes the generated bindings (and the error report) to the files named on
+// the command line.
+absl::Status WriteBindings(const CmdlineArgs& args,
+                           const BindingsAndMetadata& bindings_and_metadata) {
+  llvm::TimeTraceScope time_trace("WriteBindings");
+  CRUBIT_RETURN_IF_ERROR(
+      SetFileContents(args.rs_out, bindings_and_metadata.rs_api.view()));
+  CRUBIT_RETURN_IF_ERROR(
+      SetFileContents(args.cc_out, bindings_and_metadata.rs_api_impl));
+  if (bindings_and_metadata.extra_rs_api_impl.size() !=
+      args.extra_cc_out.size()) {
+    return absl::InternalError(
+        "The generator returned the wrong number of C++ source shards");
+  }
+  for (size_t i = 0; i < args.extra_cc_out.size(); ++i) {
+    CRUBIT_RETURN_IF_ERROR(
+        SetFileContents(args.extra_cc_out[i],
+                        bindings_and_metadata.extra_rs_api_impl[i]));
+  }
+
+  if (!args.error_report_out.empty()) {
+    CRUBIT_RETURN_IF_ERROR(SetFileContents(
+        args.error_report_out, bindings_and_metadata.error_report.view()));
+  }
+  if (!args.bloat_report_out.empty()) {
+    CRUBIT_RETURN_IF_ERROR(SetFileContents(
+        args.bloat_report_out, bindings_and_metadata.bloat_report.view()));
+  }
+
+  return absl::OkStatus();
+}
+
+// Generates the bindings as requested by `cmdline`. `command_line` is the
+// whole (expanded) command line, which the bindings are cached by in `cache`,
+// if any.
+absl::Status GenerateAndWriteBindings(
+    Cmdline& cmdline, absl::Span<char* const> positional_args,
+    absl::Span<const std::string> command_line, BindingsCache* cache) {
   const CmdlineArgs& args = cmdline.args();
 
   if (args.do_nothing) {
@@ -47,36 +91,57 @@ absl::Status Main(absl::Span<char* const> positional_args) {
     CRUBIT_RETURN_IF_ERROR(SetFileContents(
         args.cc_out,
         "// intentionally left empty because --do_nothing was passed."));
+    for (const std::string& extra_cc_out : args.extra_cc_out) {
+      CRUBIT_RETURN_IF_ERROR(SetFileContents(
+          extra_cc_out,
+          "// intentionally left empty because --do_nothing was passed."));
+    }
     if (!args.instantiations_out.empty()) {
       CRUBIT_RETURN_IF_ERROR(SetFileContents(args.instantiations_out, "[]"));
     }
     if (!args.namespaces_out.empty()) {
       CRUBIT_RETURN_IF_ERROR(SetFileContents(args.namespaces_out, "[]"));
     }
+    if (!args.type_manifest_out.empty()) {
+      CRUBIT_RETURN_IF_ERROR(SetFileContents(
+          args.type_manifest_out,
+          absl::StrCat(R"({"target": ")", args.current_target.value(),
+                       R"(", "types": []})")));
+    }
     return absl::OkStatus();
   }
 
-  std::vector<std::string> clang_args;
-  clang_args.insert(clang_args.end(), positional_args.begin(),
-                    positional_args.end());
-
-  CRUBIT_ASSIGN_OR_RETURN(
-      BindingsAndMetadata bindings_and_metadata,
-      GenerateBindingsAndMetadata(cmdline, std::move(clang_args)));
+  std::optional<BindingsAndMetadata> generated;
+  const BindingsAndMetadata* cached = nullptr;
+  if (cache != nullptr) {
+    llvm::TimeTraceScope time_trace("FindCachedBindings");
+    cached = cache->Find(command_line);
+  }
+  if (cached == nullptr) {
+    std::vector<std::string> clang_args;
+    clang_args.insert(clang_args.end(), positional_args.begin(),
+                      positional_args.end());
+    CRUBIT_ASSIGN_OR_RETURN(
+        generated, GenerateBindingsAndMetadata(cmdline, std::move(clang_args)));
+  }
+  const BindingsAndMetadata& bindings_and_metadata =
+      cached != nullptr ? *cached : *generated;
 
   if (!args.ir_out.empty()) {
     CRUBIT_RETURN_IF_ERROR(
-        SetFileContents(args.ir_out, IrToJson(bindings_and_metadata.ir)));
+        SetFileContents(args.ir_out, bindings_and_metadata.ir_json));
   }
 
-  CRUBIT_RETURN_IF_ERROR(
-      SetFileContents(args.rs_out, bindings_and_metadata.rs_api));
-  CRUBIT_RETURN_IF_ERROR(
-      SetFileContents(args.cc_out, bindings_and_metadata.rs_api_impl));
+  // With --ir_only, the bindings are generated by a later `--ir_in` run.
+  if (!args.ir_only) {
+    CRUBIT_RETURN_IF_ERROR(WriteBindings(args, bindings_and_metadata));
+  }
 
   if (!args.instantiations_out.empty()) {
-    CRUBIT_RETURN_IF_ERROR(SetFileContents(
-        args.instantiations_out, InstantiationsAsJson(bindings_and_metadata)));
+    CRUBIT_RETURN_IF_ERROR(WriteFileContents(
+        args.instantiations_out, [&](llvm::raw_ostream& os) {
+          WriteInstantiationsAsJson(os, bindings_and_metadata);
+        }));
   }
 
   if (!args.namespaces_out.empty()) {
@@ -85,21 +150,83 @@ absl::Status Main(absl::Span<char* const> positional_args) {
         crubit::NamespacesAsJson(bindings_and_metadata.namespaces)));
   }
 
-  if (!args.error_report_out.empty()) {
-    CRUBIT_RETURN_IF_ERROR(SetFileContents(args.error_report_out,
-                                           bindings_and_metadata.error_report));
+  if (!args.type_manifest_out.empty()) {
+    CRUBIT_RETURN_IF_ERROR(SetFileContents(
+        args.type_manifest_out, bindings_and_metadata.type_manifest));
   }
 
+  if (cache != nullptr && generated.has_value()) {
+    llvm::TimeTraceScope time_trace("CacheBindings");
+    cache->Insert(command_line, *std::move(generated));
+  }
   return absl::OkStatus();
 }
 
+// Runs `GenerateAndWriteBindings` with the flags from the command line, and
+// records a trace of it in `--time_trace_out`, if set.
+absl::Status Main(absl::Span<char* const> positional_args,
+                  absl::Span<const std::string> command_line,
+                  BindingsCache* cache) {
+  CRUBIT_ASSIGN_OR_RETURN(Cmdline cmdline, Cmdline::FromFlags());
+  const std::string& time_trace_out = cmdline.args().time_trace_out;
+  if (time_trace_out.empty()) {
+    return GenerateAndWriteBindings(cmdline, positional_args, command_line,
+                                    cache);
+  }
+
+  StartTimeTrace("rs_bindings_from_cc");
+  absl::Status status = GenerateAndWriteBindings(cmdline, positional_args,
+                                                 command_line, cache);
+  absl::Status time_trace_status = FinishTimeTrace(time_trace_out);
+  return status.ok() ? time_trace_status : status;
+}
+
+// Parses the command line `argv` and runs `Main` with it (and `cache`, if
+// any).
+absl::Status ParseCommandLineAndRun(int argc, char* argv[],
+                                    BindingsCache* cache = nullptr) {
+  ExpandParamfiles(argc, argv);
+  PreprocessTargetArgs(argc, argv);
+  std::vector<std::string> command_line(argv + 1, argv + argc);
+  auto args = absl::ParseCommandLine(argc, argv);
+  return Main(args, command_line, cache);
+}
+
+// The number of command lines whose bindings a persistent worker keeps in
+// memory.
+constexpr size_t kMaxCachedBindings = 16;
+
+// Runs `Main` for each work request, as `program_name` would have been run
+// with the arguments of the request. This keeps a single process alive across
+// many bindings generation actions, so that it only starts up once, and so
+// that a request whose command line and input files didn't change since a
+// previous one reuses its bindings (e.g. when an editor asks for the bindings
+// of the targets being edited).
+absl::Status RunAsPersistentWorker(char* program_name) {
+  BindingsCache cache(kMaxCachedBindings);
+  return RunPersistentWorker(
+      std::cin, llvm::outs(),
+      [program_name, &cache](const std::vector<std::string>& arguments) {
+        // Flags keep their values across calls to absl::ParseCommandLine, so
+        // they are restored afterwards for the next request.
+        absl::FlagSaver flag_saver;
+        std::vector<std::string> arg_storage = arguments;
+        std::vector<char*> argv = {program_name};
+        for (std::string& arg : arg_storage) argv.push_back(arg.data());
+        argv.push_back(nullptr);
+        return ParseCommandLineAndRun(argv.size() - 1, argv.data(), &cache);
+      });
+}
+
 }  // namespace crubit
 
 int main(int argc, char* argv[]) {
-  crubit::ExpandParamfiles(argc, argv);
-  crubit::PreprocessTargetArgs(argc, argv);
-  auto args = absl::ParseCommandLine(argc, argv);
-  absl::Status status = crubit::Main(args);
+  // Bazel starts a persistent worker with `--persistent_worker` and sends the
+  // actual command lines as work requests on stdin.
+  absl::Status status =
+      crubit::IsPersistentWorker(absl::MakeConstSpan(argv + 1, argc - 1))
+          ? crubit::RunAsPersistentWorker(argv[0])
+          : crubit::ParseCommandLineAndRun(argc, argv);
   if (!status.ok()) {
     llvm::errs() << status.message() << "\n";
     return -1;
@@ -4,14 +4,16 @@
 
 #include "rs_bindings_from_cc/src_code_gen.h"
 
+#include <cstddef>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "common/ffi_types.h"
-#include "common/status_macros.h"
 #include "rs_bindings_from_cc/ir.h"
-#include "llvm/Support/FormatVariadic.h"
 
 namespace crubit {
 
@@ -20,6 +22,7 @@ struct FfiBindings {
   FfiU8SliceBox rs_api;
   FfiU8SliceBox rs_api_impl;
   FfiU8SliceBox error_report;
+  FfiU8SliceBox bloat_report;
 };
 
 // This function is implemented in Rust.
@@ -27,44 +30,77 @@ extern "C" FfiBindings GenerateBindingsImpl(
     FfiU8Slice json, FfiU8Slice crubit_support_path_format,
     FfiU8Slice clang_format_exe_path, FfiU8Slice rustfmt_exe_path,
     FfiU8Slice rustfmt_config_path, bool generate_error_report,
-    SourceLocationDocComment generate_source_location_in_doc_comment);
+    ErrorReportFormat error_report_format,
+    SourceLocationDocComment generate_source_location_in_doc_comment,
+    size_t rs_api_impl_shards, bool skip_formatting,
+    bool compact_layout_assertions, bool inline_always_forwarding_only,
+    bool minimal_rs_api_impl_includes, bool rust_enums,
+    bool generate_bloat_report);
 
-// Creates `Bindings` instance from copied data from `ffi_bindings`.
-static absl::StatusOr<Bindings> MakeBindingsFromFfiBindings(
-    const FfiBindings& ffi_bindings) {
-  Bindings bindings;
-
-  const FfiU8SliceBox& rs_api = ffi_bindings.rs_api;
-  const FfiU8SliceBox& rs_api_impl = ffi_bindings.rs_api_impl;
-  const FfiU8SliceBox& error_report = ffi_bindings.error_report;
-
-  bindings.rs_api = std::string(rs_api.ptr, rs_api.size);
-  bindings.rs_api_impl = std::string(rs_api_impl.ptr, rs_api_impl.size);
-  bindings.error_report = std::string(error_report.ptr, error_report.size);
-  return bindings;
+// Splits `rs_api_impl` into the shards that the generator separated with
+// `RS_API_IMPL_SHARD_SEPARATOR` comment lines.
+static std::vector<absl::string_view> SplitRsApiImplShards(
+    absl::string_view rs_api_impl) {
+  static constexpr absl::string_view kSeparator =
+      "\n// crubit:rs_api_impl_shard\n";
+  return absl::StrSplit(rs_api_impl, kSeparator);
 }
 
-// Deallocates given `ffi_bindings` instance that was created in Rust.
-static void FreeFfiBindings(FfiBindings ffi_bindings) {
-  FreeFfiU8SliceBox(ffi_bindings.rs_api);
-  FreeFfiU8SliceBox(ffi_bindings.rs_api_impl);
-  FreeFfiU8SliceBox(ffi_bindings.error_report);
+// Creates `Bindings` instance that takes ownership of the buffers of
+// `ffi_bindings`.
+static Bindings MakeBindingsFromFfiBindings(FfiBindings ffi_bindings) {
+  Bindings bindings;
+  bindings.rs_api = RustOwnedBuffer(ffi_bindings.rs_api);
+  bindings.rs_api_impl_buffer = RustOwnedBuffer(ffi_bindings.rs_api_impl);
+  std::vector<absl::string_view> rs_api_impl_shards =
+      SplitRsApiImplShards(bindings.rs_api_impl_buffer.view());
+  bindings.rs_api_impl = rs_api_impl_shards.front();
+  bindings.extra_rs_api_impl.assign(rs_api_impl_shards.begin() + 1,
+                                    rs_api_impl_shards.end());
+  bindings.error_report = RustOwnedBuffer(ffi_bindings.error_report);
+  bindings.bloat_report = RustOwnedBuffer(ffi_bindings.bloat_report);
+  return bindings;
 }
 
 absl::StatusOr<Bindings> GenerateBindings(
     const IR& ir, absl::string_view crubit_support_path_format,
     absl::string_view clang_format_exe_path, absl::string_view rustfmt_exe_path,
     absl::string_view rustfmt_config_path, bool generate_error_report,
-    SourceLocationDocComment generate_source_location_in_doc_comment) {
-  std::string json = llvm::formatv("{0}", ir.ToJson());
+    ErrorReportFormat error_report_format,
+    SourceLocationDocComment generate_source_location_in_doc_comment,
+    size_t rs_api_impl_shards, bool skip_formatting,
+    bool compact_layout_assertions, bool inline_always_forwarding_only,
+    bool minimal_rs_api_impl_includes, bool rust_enums,
+    bool generate_bloat_report) {
+  return GenerateBindingsFromJson(
+      IrToCompactJson(ir), crubit_support_path_format, clang_format_exe_path,
+      rustfmt_exe_path, rustfmt_config_path, generate_error_report,
+      error_report_format, generate_source_location_in_doc_comment,
+      rs_api_impl_shards, skip_formatting, compact_layout_assertions,
+      inline_always_forwarding_only, minimal_rs_api_impl_includes, rust_enums,
+      generate_bloat_report);
+}
+
+absl::StatusOr<Bindings> GenerateBindingsFromJson(
+    std::string json, absl::string_view crubit_support_path_format,
+    absl::string_view clang_format_exe_path, absl::string_view rustfmt_exe_path,
+    absl::string_view rustfmt_config_path, bool generate_error_report,
+    ErrorReportFormat error_report_format,
+    SourceLocationDocComment generate_source_location_in_doc_comment,
+    size_t rs_api_impl_shards, bool skip_formatting,
+    bool compact_layout_assertions, bool inline_always_forwarding_only,
+    bool minimal_rs_api_impl_includes, bool rust_enums,
+    bool generate_bloat_report) {
   FfiBindings ffi_bindings = GenerateBindingsImpl(
       MakeFfiU8Slice(json), MakeFfiU8Slice(crubit_support_path_format),
       MakeFfiU8Slice(clang_format_exe_path), MakeFfiU8Slice(rustfmt_exe_path),
       MakeFfiU8Slice(rustfmt_config_path), generate_error_report,
-      generate_source_location_in_doc_comment);
-  CRUBIT_ASSIGN_OR_RETURN(Bindings bindings,
-                          MakeBindingsFromFfiBindings(ffi_bindings));
-  FreeFfiBindings(ffi_bindings);
+      error_report_format, generate_source_location_in_doc_comment,
+      rs_api_impl_shards, skip_formatting, compact_layout_assertions,
+      inline_always_forwarding_only, minimal_rs_api_impl_includes, rust_enums,
+      generate_bloat_report);
+  Bindings bindings = MakeBindingsFromFfiBindings(ffi_bindings);
+  bindings.ir_json = std::move(json);
   return bindings;
 }
 
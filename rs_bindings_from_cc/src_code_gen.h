@@ -5,7 +5,9 @@
 #ifndef CRUBIT_RS_BINDINGS_FROM_CC_SRC_CODE_GEN_H_
 #define CRUBIT_RS_BINDINGS_FROM_CC_SRC_CODE_GEN_H_
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -14,14 +16,26 @@
 
 namespace crubit {
 
-// Source code for generated bindings.
+// Source code for generated bindings. The sources are kept in the buffers
+// that the generator (which is implemented in Rust) returned them in.
 struct Bindings {
   // Rust source code.
-  std::string rs_api;
+  RustOwnedBuffer rs_api;
   // C++ source code.
-  std::string rs_api_impl;
+  absl::string_view rs_api_impl;
+  // Further shards of the C++ source code, if more than one was requested.
+  std::vector<absl::string_view> extra_rs_api_impl;
+  // Owns the C++ source code of all the shards (`rs_api_impl` and
+  // `extra_rs_api_impl` point into it).
+  RustOwnedBuffer rs_api_impl_buffer;
   // Optional JSON error report.
-  std::string error_report;
+  RustOwnedBuffer error_report;
+  // Optional JSON report of the code generated for each item (see
+  // common/bloat_report.rs).
+  RustOwnedBuffer bloat_report;
+  // The IR as the JSON it was handed to the generator in, so that callers
+  // that also write it out don't need to serialize it again.
+  std::string ir_json;
 };
 
 // Generates bindings from the given `IR`.
@@ -29,7 +43,27 @@ absl::StatusOr<Bindings> GenerateBindings(
     const IR& ir, absl::string_view crubit_support_path_format,
     absl::string_view clang_format_exe_path, absl::string_view rustfmt_exe_path,
     absl::string_view rustfmt_config_path, bool generate_error_report,
-    SourceLocationDocComment generate_source_location_in_doc_comment);
+    ErrorReportFormat error_report_format,
+    SourceLocationDocComment generate_source_location_in_doc_comment,
+    size_t rs_api_impl_shards = 1, bool skip_formatting = false,
+    bool compact_layout_assertions = false,
+    bool inline_always_forwarding_only = false,
+    bool minimal_rs_api_impl_includes = false, bool rust_enums = false,
+    bool generate_bloat_report = false);
+
+// Generates bindings from the JSON serialization of an `IR` (as in
+// `Bindings::ir_json`).
+absl::StatusOr<Bindings> GenerateBindingsFromJson(
+    std::string ir_json, absl::string_view crubit_support_path_format,
+    absl::string_view clang_format_exe_path, absl::string_view rustfmt_exe_path,
+    absl::string_view rustfmt_config_path, bool generate_error_report,
+    ErrorReportFormat error_report_format,
+    SourceLocationDocComment generate_source_location_in_doc_comment,
+    size_t rs_api_impl_shards = 1, bool skip_formatting = false,
+    bool compact_layout_assertions = false,
+    bool inline_always_forwarding_only = false,
+    bool minimal_rs_api_impl_includes = false, bool rust_enums = false,
+    bool generate_bloat_report = false);
 
 }  // namespace crubit
 
@@ -0,0 +1,239 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/target_args_index.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "common/file_io.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace crubit {
+namespace {
+
+// The first bytes of a serialized index. Bump the version when changing the
+// format.
+constexpr absl::string_view kMagic = "crubit target args index v1\n";
+
+// The numbers of targets, headers and features follow the magic.
+constexpr uint64_t kCountsOffset = kMagic.size();
+constexpr uint64_t kTablesOffset = kCountsOffset + 3 * sizeof(uint32_t);
+
+// A string is referred to by its offset in the file and its size.
+constexpr uint64_t kStringRecordSize = 2 * sizeof(uint32_t);
+// A target record is its label, followed by the range of its features in the
+// feature table.
+constexpr uint64_t kTargetRecordSize = kStringRecordSize + 2 * sizeof(uint32_t);
+// A header record is its name, followed by the index of its target.
+constexpr uint64_t kHeaderRecordSize = kStringRecordSize + sizeof(uint32_t);
+// A feature record is just its name.
+constexpr uint64_t kFeatureRecordSize = kStringRecordSize;
+
+void AppendU32(std::string& out, uint32_t value) {
+  char bytes[sizeof(uint32_t)];
+  llvm::support::endian::write32le(bytes, value);
+  out.append(bytes, sizeof(bytes));
+}
+
+// Writes the records of the index, and the strings they refer to, which are
+// placed after all the records.
+class IndexWriter {
+ public:
+  IndexWriter(uint64_t strings_offset) : strings_offset_(strings_offset) {}
+
+  void AppendU32(uint32_t value) { crubit::AppendU32(records_, value); }
+
+  void AppendString(absl::string_view s) {
+    auto [it, inserted] = string_offsets_.try_emplace(
+        std::string(s), strings_offset_ + strings_.size());
+    if (inserted) strings_.append(s);
+    AppendU32(it->second);
+    AppendU32(s.size());
+  }
+
+  std::string Finish() && { return std::move(records_) + strings_; }
+
+ private:
+  const uint64_t strings_offset_;
+  std::string records_;
+  std::string strings_;
+  std::map<std::string, uint32_t> string_offsets_;
+};
+
+}  // namespace
+
+bool fromJSON(const llvm::json::Value& json, TargetArgs& out,
+              llvm::json::Path path) {
+  llvm::json::ObjectMapper mapper(json, path);
+  return mapper && mapper.map("t", out.target) &&
+         mapper.mapOptional("h", out.headers) &&
+         mapper.mapOptional("f", out.features);
+}
+
+std::string TargetArgsIndex::Serialize(absl::Span<const TargetArgs> targets) {
+  // Targets may be listed more than once, so they are merged first.
+  std::map<std::string, std::set<std::string>> target_features;
+  std::map<std::string, std::string> header_targets;
+  for (const TargetArgs& target : targets) {
+    std::set<std::string>& features = target_features[target.target];
+    features.insert(target.features.begin(), target.features.end());
+    for (const std::string& header : target.headers) {
+      auto [it, inserted] = header_targets.try_emplace(header, target.target);
+      if (!inserted && target.target < it->second) it->second = target.target;
+    }
+  }
+  std::map<absl::string_view, uint32_t> target_indices;
+  uint32_t num_features = 0;
+  for (const auto& [target, features] : target_features) {
+    target_indices.emplace(target, target_indices.size());
+    num_features += features.size();
+  }
+
+  std::string result(kMagic);
+  AppendU32(result, target_features.size());
+  AppendU32(result, header_targets.size());
+  AppendU32(result, num_features);
+  IndexWriter writer(kTablesOffset +
+                     target_features.size() * kTargetRecordSize +
+                     header_targets.size() * kHeaderRecordSize +
+                     num_features * kFeatureRecordSize);
+  uint32_t features_begin = 0;
+  for (const auto& [target, features] : target_features) {
+    writer.AppendString(target);
+    writer.AppendU32(features_begin);
+    features_begin += features.size();
+    writer.AppendU32(features_begin);
+  }
+  for (const auto& [header, target] : header_targets) {
+    writer.AppendString(header);
+    writer.AppendU32(target_indices.at(target));
+  }
+  for (const auto& [target, features] : target_features) {
+    for (const std::string& feature : features) {
+      writer.AppendString(feature);
+    }
+  }
+  return result + std::move(writer).Finish();
+}
+
+absl::StatusOr<TargetArgsIndex> TargetArgsIndex::Open(absl::string_view path) {
+  absl::StatusOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      MapFileContents(path);
+  if (!buffer.ok()) {
+    return absl::Status(
+        buffer.status().code(),
+        absl::StrCat("Could not read the target args index `", path,
+                     "`: ", buffer.status().message()));
+  }
+  return FromBuffer(*std::move(buffer));
+}
+
+absl::StatusOr<TargetArgsIndex> TargetArgsIndex::FromBuffer(
+    std::unique_ptr<llvm::MemoryBuffer> buffer) {
+  llvm::StringRef bytes = buffer->getBuffer();
+  if (bytes.size() < kTablesOffset || !bytes.starts_with(kMagic)) {
+    return absl::InvalidArgumentError(
+        "Invalid target args index: unexpected header");
+  }
+  TargetArgsIndex index(std::move(buffer));
+  index.num_targets_ = index.ReadU32(kCountsOffset);
+  index.num_headers_ = index.ReadU32(kCountsOffset + sizeof(uint32_t));
+  index.num_features_ = index.ReadU32(kCountsOffset + 2 * sizeof(uint32_t));
+  uint64_t tables_size = index.num_targets_ * kTargetRecordSize +
+                         index.num_headers_ * kHeaderRecordSize +
+                         index.num_features_ * kFeatureRecordSize;
+  if (bytes.size() < kTablesOffset + tables_size) {
+    return absl::InvalidArgumentError(
+        "Invalid target args index: the file is truncated");
+  }
+  return index;
+}
+
+TargetArgsIndex::TargetArgsIndex(std::unique_ptr<llvm::MemoryBuffer> buffer)
+    : buffer_(std::move(buffer)) {}
+
+uint32_t TargetArgsIndex::ReadU32(uint64_t offset) const {
+  return llvm::support::endian::read32le(buffer_->getBufferStart() + offset);
+}
+
+absl::string_view TargetArgsIndex::ReadString(uint64_t record_offset) const {
+  uint64_t offset = ReadU32(record_offset);
+  uint64_t size = ReadU32(record_offset + sizeof(uint32_t));
+  // The records were checked to be in the file when it was opened, but the
+  // strings weren't, so that opening the index doesn't read all of it.
+  if (offset + size > buffer_->getBufferSize()) return "";
+  return absl::string_view(buffer_->getBufferStart() + offset, size);
+}
+
+absl::string_view TargetArgsIndex::TargetLabel(uint32_t index) const {
+  return ReadString(kTablesOffset + index * kTargetRecordSize);
+}
+
+std::optional<absl::string_view> TargetArgsIndex::FindHeaderTarget(
+    absl::string_view header) const {
+  uint64_t headers_offset = kTablesOffset + num_targets_ * kTargetRecordSize;
+  // Binary search for the first header that isn't less than `header`.
+  uint32_t begin = 0;
+  uint32_t end = num_headers_;
+  while (begin < end) {
+    uint32_t middle = begin + (end - begin) / 2;
+    if (ReadString(headers_offset + middle * kHeaderRecordSize) < header) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  uint64_t record_offset = headers_offset + begin * kHeaderRecordSize;
+  if (begin == num_headers_ || ReadString(record_offset) != header) {
+    return std::nullopt;
+  }
+  uint32_t target_index = ReadU32(record_offset + kStringRecordSize);
+  if (target_index >= num_targets_) return std::nullopt;
+  return TargetLabel(target_index);
+}
+
+std::vector<absl::string_view> TargetArgsIndex::FindTargetFeatures(
+    absl::string_view target) const {
+  uint32_t begin = 0;
+  uint32_t end = num_targets_;
+  while (begin < end) {
+    uint32_t middle = begin + (end - begin) / 2;
+    if (TargetLabel(middle) < target) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  if (begin == num_targets_ || TargetLabel(begin) != target) return {};
+
+  uint64_t record_offset = kTablesOffset + begin * kTargetRecordSize;
+  uint32_t features_begin = ReadU32(record_offset + kStringRecordSize);
+  uint32_t features_end = std::min(
+      ReadU32(record_offset + kStringRecordSize + sizeof(uint32_t)),
+      num_features_);
+  uint64_t features_offset = kTablesOffset + num_targets_ * kTargetRecordSize +
+                             num_headers_ * kHeaderRecordSize;
+  std::vector<absl::string_view> features;
+  for (uint32_t i = features_begin; i < features_end; ++i) {
+    features.push_back(ReadString(features_offset + i * kFeatureRecordSize));
+  }
+  return features;
+}
+
+}  // namespace crubit
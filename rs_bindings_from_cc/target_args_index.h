@@ -0,0 +1,84 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_TARGET_ARGS_INDEX_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_TARGET_ARGS_INDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace crubit {
+
+// The arguments of a single target, as in an element of `--target_args`.
+struct TargetArgs {
+  std::string target;
+  std::vector<std::string> headers;
+  std::vector<std::string> features;
+};
+
+bool fromJSON(const llvm::json::Value& json, TargetArgs& out,
+              llvm::json::Path path);
+
+// A read-only index of the `TargetArgs` of a whole dependency closure: the
+// target of each header, and the Crubit features of each target.
+//
+// Unlike `--target_args`, which each bindings action parses into hash maps
+// before it can look up anything, the index is built once (see
+// `target_args_index_builder.cc`) and memory-mapped by each action, which then
+// only reads the few entries it looks up.
+//
+// The serialized index is a header, sorted tables of fixed-size records for
+// the targets, headers and features (with 32-bit little-endian fields), and
+// the strings they refer to. Lookups are binary searches.
+class TargetArgsIndex {
+ public:
+  // Serializes the index of `targets`. A header that is assigned to more than
+  // one target is assigned to the one that comes first alphabetically, like in
+  // `--target_args`.
+  static std::string Serialize(absl::Span<const TargetArgs> targets);
+
+  // Memory-maps the serialized index at `path`.
+  static absl::StatusOr<TargetArgsIndex> Open(absl::string_view path);
+
+  // Reads a serialized index (from `Serialize`) that is kept in `buffer`.
+  static absl::StatusOr<TargetArgsIndex> FromBuffer(
+      std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+  // Returns the target that `header` belongs to, if any.
+  std::optional<absl::string_view> FindHeaderTarget(
+      absl::string_view header) const;
+
+  // Returns the features enabled for `target` (none if the target isn't in
+  // the index).
+  std::vector<absl::string_view> FindTargetFeatures(
+      absl::string_view target) const;
+
+  uint32_t num_targets() const { return num_targets_; }
+  uint32_t num_headers() const { return num_headers_; }
+
+ private:
+  explicit TargetArgsIndex(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+  uint32_t ReadU32(uint64_t offset) const;
+  absl::string_view ReadString(uint64_t record_offset) const;
+  absl::string_view TargetLabel(uint32_t index) const;
+
+  std::unique_ptr<llvm::MemoryBuffer> buffer_;
+  uint32_t num_targets_ = 0;
+  uint32_t num_headers_ = 0;
+  uint32_t num_features_ = 0;
+};
+
+}  // namespace crubit
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_TARGET_ARGS_INDEX_H_
@@ -0,0 +1,75 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Builds the `TargetArgsIndex` (see target_args_index.h) of the target args in
+// the given files, for `rs_bindings_from_cc --target_args_index`:
+//
+//   target_args_index_builder --out=index.bin target_args.txt ...
+//
+// Each line of the input files is the JSON of the args of one target, like the
+// elements of `--target_args` (e.g.
+// `{"t": "//foo:bar", "h": ["foo/bar.h"], "f": ["supported"]}`).
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "common/file_io.h"
+#include "common/status_macros.h"
+#include "rs_bindings_from_cc/target_args_index.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+
+ABSL_FLAG(std::string, out, "", "output path for the index");
+
+namespace crubit {
+namespace {
+
+absl::Status AppendTargetArgs(absl::string_view file_name,
+                              std::vector<TargetArgs>& targets) {
+  CRUBIT_ASSIGN_OR_RETURN(std::string contents, GetFileContents(file_name));
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    if (line.empty()) continue;
+    llvm::Expected<TargetArgs> target = llvm::json::parse<TargetArgs>(line);
+    if (!target) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Malformed target args in `", file_name,
+                       "`: ", llvm::toString(target.takeError())));
+    }
+    targets.push_back(*std::move(target));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status Main(absl::Span<char* const> input_files) {
+  std::string out = absl::GetFlag(FLAGS_out);
+  if (out.empty()) return absl::InvalidArgumentError("please specify --out");
+  std::vector<TargetArgs> targets;
+  for (absl::string_view input_file : input_files) {
+    CRUBIT_RETURN_IF_ERROR(AppendTargetArgs(input_file, targets));
+  }
+  return SetFileContents(out, TargetArgsIndex::Serialize(targets));
+}
+
+}  // namespace
+}  // namespace crubit
+
+int main(int argc, char* argv[]) {
+  std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  // Skip $0.
+  absl::Status status =
+      crubit::Main(absl::MakeConstSpan(args).subspan(1));
+  if (!status.ok()) {
+    std::cerr << status << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/target_args_index.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "common/status_test_matchers.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Optional;
+
+absl::StatusOr<TargetArgsIndex> FromString(absl::string_view bytes) {
+  return TargetArgsIndex::FromBuffer(llvm::MemoryBuffer::getMemBufferCopy(
+      llvm::StringRef(bytes.data(), bytes.size())));
+}
+
+TEST(TargetArgsIndexTest, Lookups) {
+  std::string bytes = TargetArgsIndex::Serialize({
+      {.target = "//foo:foo",
+       .headers = {"foo/foo.h", "foo/internal.h"},
+       .features = {"supported"}},
+      {.target = "//bar:bar",
+       .headers = {"bar/bar.h"},
+       .features = {"supported", "experimental"}},
+      {.target = "//baz:baz"},
+  });
+  ASSERT_OK_AND_ASSIGN(TargetArgsIndex index, FromString(bytes));
+
+  EXPECT_EQ(index.num_targets(), 3);
+  EXPECT_EQ(index.num_headers(), 3);
+  EXPECT_THAT(index.FindHeaderTarget("foo/foo.h"), Optional(Eq("//foo:foo")));
+  EXPECT_THAT(index.FindHeaderTarget("foo/internal.h"),
+              Optional(Eq("//foo:foo")));
+  EXPECT_THAT(index.FindHeaderTarget("bar/bar.h"), Optional(Eq("//bar:bar")));
+  EXPECT_EQ(index.FindHeaderTarget("baz/baz.h"), std::nullopt);
+  EXPECT_EQ(index.FindHeaderTarget(""), std::nullopt);
+  EXPECT_EQ(index.FindHeaderTarget("zzz.h"), std::nullopt);
+
+  EXPECT_THAT(index.FindTargetFeatures("//foo:foo"), ElementsAre("supported"));
+  EXPECT_THAT(index.FindTargetFeatures("//bar:bar"),
+              ElementsAre("experimental", "supported"));
+  EXPECT_THAT(index.FindTargetFeatures("//baz:baz"), IsEmpty());
+  EXPECT_THAT(index.FindTargetFeatures("//unknown:unknown"), IsEmpty());
+}
+
+TEST(TargetArgsIndexTest, DuplicateHeaderIsAssignedToFirstTarget) {
+  std::string bytes = TargetArgsIndex::Serialize({
+      {.target = "//b:b", .headers = {"shared.h"}},
+      {.target = "//a:a", .headers = {"shared.h"}},
+      {.target = "//c:c", .headers = {"shared.h"}},
+  });
+  ASSERT_OK_AND_ASSIGN(TargetArgsIndex index, FromString(bytes));
+  EXPECT_THAT(index.FindHeaderTarget("shared.h"), Optional(Eq("//a:a")));
+}
+
+TEST(TargetArgsIndexTest, RepeatedTargetsAreMerged) {
+  std::string bytes = TargetArgsIndex::Serialize({
+      {.target = "//a:a", .headers = {"a1.h"}, .features = {"f1"}},
+      {.target = "//a:a", .headers = {"a2.h"}, .features = {"f1", "f2"}},
+  });
+  ASSERT_OK_AND_ASSIGN(TargetArgsIndex index, FromString(bytes));
+  EXPECT_EQ(index.num_targets(), 1);
+  EXPECT_THAT(index.FindHeaderTarget("a1.h"), Optional(Eq("//a:a")));
+  EXPECT_THAT(index.FindHeaderTarget("a2.h"), Optional(Eq("//a:a")));
+  EXPECT_THAT(index.FindTargetFeatures("//a:a"), ElementsAre("f1", "f2"));
+}
+
+TEST(TargetArgsIndexTest, Empty) {
+  ASSERT_OK_AND_ASSIGN(TargetArgsIndex index,
+                       FromString(TargetArgsIndex::Serialize({})));
+  EXPECT_EQ(index.num_targets(), 0);
+  EXPECT_EQ(index.FindHeaderTarget("foo.h"), std::nullopt);
+  EXPECT_THAT(index.FindTargetFeatures("//foo:foo"), IsEmpty());
+}
+
+TEST(TargetArgsIndexTest, InvalidHeader) {
+  EXPECT_THAT(FromString("not an index"),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("unexpected header")));
+}
+
+TEST(TargetArgsIndexTest, Truncated) {
+  std::string bytes = TargetArgsIndex::Serialize({
+      {.target = "//foo:foo", .headers = {"foo.h"}},
+  });
+  EXPECT_THAT(FromString(absl::string_view(bytes).substr(0, bytes.size() / 2)),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("truncated")));
+}
+
+TEST(TargetArgsIndexTest, OpenMissingFile) {
+  EXPECT_THAT(TargetArgsIndex::Open("/does/not/exist"),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("/does/not/exist")));
+}
+
+}  // namespace
+}  // namespace crubit
@@ -0,0 +1,30 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/test/benchmarks/call_overhead.h"
+
+#include <cstddef>
+#include <string_view>
+
+int AddOne(int x) { return x + 1; }
+
+TrivialAbi MakeTrivialAbi(int value) { return TrivialAbi{.value = value}; }
+
+Nontrivial MakeNontrivial(int value) { return Nontrivial(value); }
+
+Polymorphic::~Polymorphic() = default;
+
+int Polymorphic::Get() const { return 1; }
+
+int PolymorphicFinal::Get() const { return 2; }
+
+size_t Length(std::string_view s) { return s.size(); }
+
+Vec2 operator+(Vec2 lhs, Vec2 rhs) {
+  return Vec2{.x = lhs.x + rhs.x, .y = lhs.y + rhs.y};
+}
+
+bool operator==(const Vec2& lhs, const Vec2& rhs) {
+  return lhs.x == rhs.x && lhs.y == rhs.y;
+}
@@ -0,0 +1,70 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_TEST_BENCHMARKS_CALL_OVERHEAD_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_TEST_BENCHMARKS_CALL_OVERHEAD_H_
+
+#include <cstddef>
+#include <string_view>
+
+#pragma clang lifetime_elision
+
+// Representative C++ APIs, whose bindings `call_overhead_benchmark` calls in a
+// loop. The functions do as little work as possible, so that the benchmark
+// measures the cost of the call itself.
+//
+// Out-of-line functions are defined in `call_overhead.cc`, so that Clang
+// can't inline them into the thunks; their inline counterparts can only be
+// called through a thunk.
+
+// Trivial functions.
+int AddOne(int x);
+inline int AddOneInline(int x) { return x + 1; }
+
+// A trivially relocatable type with a destructor, which is returned by value
+// in registers.
+struct [[clang::trivial_abi]] TrivialAbi final {
+  ~TrivialAbi() {}
+  int value;
+};
+TrivialAbi MakeTrivialAbi(int value);
+
+// A non-trivial type, which is constructed and destroyed through `ctor.rs`,
+// and returned by value through an out parameter.
+struct Nontrivial final {
+  Nontrivial() : value(0) {}
+  Nontrivial(int value) : value(value) {}  // NOLINT(google-explicit-constructor)
+  Nontrivial(const Nontrivial& other) : value(other.value) {}
+  ~Nontrivial() {}
+
+  int value;
+};
+Nontrivial MakeNontrivial(int value);
+inline Nontrivial MakeNontrivialInline(int value) { return Nontrivial(value); }
+
+// Virtual methods, with and without dynamic dispatch.
+class Polymorphic {
+ public:
+  virtual ~Polymorphic();
+  virtual int Get() const;
+};
+class PolymorphicFinal final : public Polymorphic {
+ public:
+  int Get() const override;
+};
+
+// `std::string_view` parameters, which are passed as `cc_std`'s
+// `string_view` struct (or as Rust slice pointers, with
+// `--string_view_as_slice_pointer`).
+size_t Length(std::string_view s);
+
+// Operator overloads.
+struct Vec2 final {
+  int x;
+  int y;
+};
+Vec2 operator+(Vec2 lhs, Vec2 rhs);
+bool operator==(const Vec2& lhs, const Vec2& rhs);
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_TEST_BENCHMARKS_CALL_OVERHEAD_H_
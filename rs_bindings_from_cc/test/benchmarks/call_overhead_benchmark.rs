@@ -0,0 +1,86 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! Measures the per-call overhead of calling C++ through the generated
+//! bindings, for the representative APIs in `call_overhead.h`.
+//!
+//! Each benchmark calls one API in a loop and prints the time per call. Run
+//! with `--test_output=all`, and compare the results before and after a
+//! change to the generated thunks, or with and without cross-language LTO.
+
+#[cfg(test)]
+mod tests {
+    use call_overhead::*;
+    use ctor::{emplace, CtorNew};
+    use std::hint::black_box;
+    use std::time::Instant;
+
+    const ITERATIONS: i32 = 10_000_000;
+
+    /// Calls `f` `ITERATIONS` times, and prints the time per call.
+    fn bench(name: &str, mut f: impl FnMut(i32) -> i32) {
+        let start = Instant::now();
+        let mut sum = 0i32;
+        for i in 0..ITERATIONS {
+            sum = sum.wrapping_add(f(black_box(i)));
+        }
+        let nanos = start.elapsed().as_nanos();
+        black_box(sum);
+        println!("{name}: {:.3} ns/call", nanos as f64 / ITERATIONS as f64);
+    }
+
+    #[test]
+    fn bench_trivial_function() {
+        bench("AddOne", AddOne);
+        bench("AddOneInline", AddOneInline);
+    }
+
+    #[test]
+    fn bench_return_by_value() {
+        bench("MakeTrivialAbi", |i| MakeTrivialAbi(i).value);
+        bench("MakeNontrivial", |i| {
+            emplace! { let n = MakeNontrivial(i); }
+            n.value
+        });
+        bench("MakeNontrivialInline", |i| {
+            emplace! { let n = MakeNontrivialInline(i); }
+            n.value
+        });
+    }
+
+    #[test]
+    fn bench_constructor_and_destructor() {
+        bench("Nontrivial::ctor_new", |i| {
+            emplace! { let n = Nontrivial::ctor_new(i); }
+            n.value
+        });
+        emplace! { let original = Nontrivial::ctor_new(42); }
+        bench("Nontrivial copy", |_| {
+            emplace! { let n = ctor::copy(&*original); }
+            n.value
+        });
+    }
+
+    #[test]
+    fn bench_virtual_method() {
+        emplace! {
+            let polymorphic = Polymorphic::ctor_new(());
+            let polymorphic_final = PolymorphicFinal::ctor_new(());
+        }
+        bench("Polymorphic::Get", |_| black_box(&*polymorphic).Get());
+        bench("PolymorphicFinal::Get", |_| black_box(&*polymorphic_final).Get());
+    }
+
+    #[test]
+    fn bench_string_view_parameter() {
+        let s = "Hello, world!";
+        bench("Length", |_| Length(cc_std::std::string_view::from(black_box(s))) as i32);
+    }
+
+    #[test]
+    fn bench_operator() {
+        bench("Vec2 + Vec2", |i| (Vec2 { x: i, y: 1 } + Vec2 { x: 1, y: i }).x);
+        bench("Vec2 == Vec2", |i| (Vec2 { x: i, y: 1 } == Vec2 { x: 1, y: i }) as i32);
+    }
+}
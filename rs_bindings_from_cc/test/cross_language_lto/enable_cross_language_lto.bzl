@@ -0,0 +1,47 @@
+# Part of the Crubit project, under the Apache License v2.0 with LLVM
+# Exceptions. See /LICENSE for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+"""A wrapper rule to build tests with cross-language LTO."""
+
+_CROSS_LANGUAGE_LTO = "//rs_bindings_from_cc/bazel_support:cross_language_lto"
+_EXTRA_RUSTC_FLAGS = "@rules_rust//:extra_rustc_flags"
+_LINKOPT = "//command_line_option:linkopt"
+
+def _enable_cross_language_lto_transition_impl(settings, _attr):
+    return {
+        _CROSS_LANGUAGE_LTO: True,
+        # The Rust callers need to be compiled to bitcode as well, so that the thunks can be
+        # inlined into them.
+        _EXTRA_RUSTC_FLAGS: settings[_EXTRA_RUSTC_FLAGS] + ["-Clinker-plugin-lto"],
+        _LINKOPT: settings[_LINKOPT] + ["-fuse-ld=lld", "-flto=thin"],
+    }
+
+_enable_cross_language_lto_transition = transition(
+    implementation = _enable_cross_language_lto_transition_impl,
+    inputs = [_EXTRA_RUSTC_FLAGS, _LINKOPT],
+    outputs = [_CROSS_LANGUAGE_LTO, _EXTRA_RUSTC_FLAGS, _LINKOPT],
+)
+
+def _enable_cross_language_lto_test_impl(ctx):
+    tut = ctx.attr.target_under_test[0]
+    output = ctx.actions.declare_file(ctx.label.name)
+    target = tut[DefaultInfo].files.to_list()[0]
+
+    ctx.actions.symlink(output = output, target_file = target, is_executable = True)
+    return [
+        DefaultInfo(
+            executable = output,
+        ),
+    ]
+
+enable_cross_language_lto_test = rule(
+    implementation = _enable_cross_language_lto_test_impl,
+    attrs = {
+        "target_under_test": attr.label(
+            mandatory = True,
+            cfg = _enable_cross_language_lto_transition,
+        ),
+    },
+    test = True,
+)
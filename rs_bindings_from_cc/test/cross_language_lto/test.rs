@@ -0,0 +1,21 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#[cfg(test)]
+mod tests {
+    use thunks::*;
+
+    #[test]
+    fn test_inline_function() {
+        assert_eq!(AddOne(41), 42);
+    }
+
+    #[test]
+    fn test_constructor_and_method() {
+        let mut accumulator: Accumulator = Default::default();
+        accumulator.Add(40);
+        accumulator.Add(2);
+        assert_eq!(accumulator.sum, 42);
+    }
+}
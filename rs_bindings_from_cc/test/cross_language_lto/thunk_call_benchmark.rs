@@ -0,0 +1,46 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! Measures the cost of calling C++ inline functions through their thunks.
+//!
+//! This is built both with and without cross-language LTO. Without it, each
+//! iteration makes an opaque call into `thunks_rust_api_impl.cc`; with it, the
+//! thunks are inlined, and only the loop itself remains.
+
+#[cfg(test)]
+mod tests {
+    use std::hint::black_box;
+    use std::time::Instant;
+    use thunks::*;
+
+    const ITERATIONS: i32 = 10_000_000;
+
+    fn report(name: &str, nanos: u128) {
+        println!("{name}: {:.3} ns/call", nanos as f64 / ITERATIONS as f64);
+    }
+
+    #[test]
+    fn bench_inline_function() {
+        let start = Instant::now();
+        let mut x = 0;
+        for _ in 0..ITERATIONS {
+            x = AddOne(black_box(x));
+        }
+        report("AddOne", start.elapsed().as_nanos());
+        assert_eq!(x, ITERATIONS);
+    }
+
+    #[test]
+    fn bench_constructor_and_method() {
+        let start = Instant::now();
+        let mut sum = 0;
+        for i in 0..ITERATIONS {
+            let mut accumulator: Accumulator = Default::default();
+            accumulator.Add(black_box(i % 2));
+            sum += black_box(accumulator).sum;
+        }
+        report("Accumulator", start.elapsed().as_nanos());
+        assert_eq!(sum, ITERATIONS / 2);
+    }
+}
@@ -0,0 +1,24 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_TEST_CROSS_LANGUAGE_LTO_THUNKS_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_TEST_CROSS_LANGUAGE_LTO_THUNKS_H_
+
+#pragma clang lifetime_elision
+
+// Inline functions are only callable from Rust through a thunk in the
+// generated `_rust_api_impl.cc` file.
+inline int AddOne(int x) { return x + 1; }
+
+struct Accumulator final {
+  // Non-trivial, so that the constructor is called through a thunk that uses
+  // `crubit::construct_at`.
+  Accumulator() : sum(0) {}
+
+  void Add(int x) { sum += x; }
+
+  int sum;
+};
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_TEST_CROSS_LANGUAGE_LTO_THUNKS_H_
@@ -0,0 +1,21 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_TEST_FUNCTION_BATCH_BATCH_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_TEST_FUNCTION_BATCH_BATCH_H_
+
+#include "support/internal/attribute_macros.h"
+
+CRUBIT_INTERNAL_BATCH inline float Square(float x) { return x * x; }
+
+struct Point final {
+  int x;
+  int y;
+};
+
+CRUBIT_INTERNAL_BATCH inline int ManhattanLength(Point p) {
+  return (p.x < 0 ? -p.x : p.x) + (p.y < 0 ? -p.y : p.y);
+}
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_TEST_FUNCTION_BATCH_BATCH_H_
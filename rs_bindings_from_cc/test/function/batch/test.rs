@@ -0,0 +1,40 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#[cfg(test)]
+mod tests {
+    use batch::*;
+
+    #[test]
+    fn test_single_call() {
+        assert_eq!(Square(3.0), 9.0);
+    }
+
+    #[test]
+    fn test_batch_call() {
+        let input = [1.0, 2.0, 3.0];
+        let mut output = [0.0; 3];
+        Square_batch(&input, &mut output);
+        assert_eq!(output, [1.0, 4.0, 9.0]);
+    }
+
+    #[test]
+    fn test_empty_batch_call() {
+        Square_batch(&[], &mut []);
+    }
+
+    #[test]
+    fn test_batch_call_with_structs() {
+        let input = [Point { x: 1, y: -2 }, Point { x: -3, y: 4 }];
+        let mut output = [0; 2];
+        ManhattanLength_batch(&input, &mut output);
+        assert_eq!(output, [3, 7]);
+    }
+
+    #[test]
+    #[should_panic]
+    fn test_batch_call_with_mismatched_lengths() {
+        Square_batch(&[1.0, 2.0], &mut [0.0]);
+    }
+}
@@ -48,21 +48,11 @@ __rust_thunk___ZN23test_namespace_bindings1SaSEOS0_(
   return &__this->operator=(std::move(*__param_0));
 }
 
-extern "C" int __rust_thunk___ZN23test_namespace_bindings1fENS_1SE(
-    struct test_namespace_bindings::S* s) {
-  return test_namespace_bindings::f(std::move(*s));
-}
 extern "C" void
 __rust_thunk___ZN23test_namespace_bindings15inline_functionEv() {
   test_namespace_bindings::inline_function();
 }
 
-extern "C" void __rust_thunk___Z8identityN23test_namespace_bindings1SE(
-    struct test_namespace_bindings::S* __return,
-    struct test_namespace_bindings::S* s) {
-  new (__return) auto(identity(std::move(*s)));
-}
-
 static_assert(sizeof(struct test_namespace_bindings_reopened::inner::S) == 1);
 static_assert(alignof(struct test_namespace_bindings_reopened::inner::S) == 1);
 
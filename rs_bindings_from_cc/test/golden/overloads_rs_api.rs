@@ -14,11 +14,37 @@
 #![allow(nonstandard_style)]
 #![deny(warnings)]
 
-// Error while generating bindings for item 'Overload':
-// Cannot generate bindings for overloaded function
+#[doc(hidden)]
+#[allow(non_camel_case_types)]
+pub trait __Overload_Overload {
+    type Output;
+    fn call(self) -> Self::Output;
+}
 
-// Error while generating bindings for item 'Overload':
-// Cannot generate bindings for overloaded function
+/// Calls the overload of `Overload` for `args`: `()` for no arguments, the
+/// argument itself for one, and a tuple of the arguments otherwise.
+#[inline(always)]
+pub fn Overload<Args: __Overload_Overload>(args: Args) -> Args::Output {
+    args.call()
+}
+
+impl __Overload_Overload for () {
+    type Output = ();
+    #[inline(always)]
+    fn call(self) -> Self::Output {
+        let () = self;
+        unsafe { crate::detail::__rust_thunk___Z8Overloadv() }
+    }
+}
+
+impl __Overload_Overload for ::core::ffi::c_int {
+    type Output = ();
+    #[inline(always)]
+    fn call(self) -> Self::Output {
+        let __param_0 = self;
+        unsafe { crate::detail::__rust_thunk___Z8Overloadi(__param_0) }
+    }
+}
 
 // Error while generating bindings for item 'UncallableOverload':
 // Cannot generate bindings for overloaded function
@@ -44,6 +70,10 @@ mod detail {
     #[allow(unused_imports)]
     use super::*;
     extern "C" {
+        #[link_name = "_Z8Overloadv"]
+        pub(crate) fn __rust_thunk___Z8Overloadv();
+        #[link_name = "_Z8Overloadi"]
+        pub(crate) fn __rust_thunk___Z8Overloadi(__param_0: ::core::ffi::c_int);
         pub(crate) fn __rust_thunk___Z20AlsoTemplateOverloadv();
     }
 }
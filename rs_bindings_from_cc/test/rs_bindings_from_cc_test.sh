@@ -296,4 +296,39 @@ EOT
     "Verify #include paths are based on the argument of --crubit_support_path_format"
 }
 
+function test::time_trace_out() {
+  local rs_out="${TEST_TMPDIR}/rs_api.rs"
+  local cc_out="${TEST_TMPDIR}/rs_api_impl.cc"
+  local time_trace_out="${TEST_TMPDIR}/time_trace.json"
+
+  local hdr="${TEST_TMPDIR}/hello_world.h"
+  echo "int MyFunction();" > "${hdr}"
+
+  local json
+  json="$(cat <<-EOT
+  [{"t": "//foo/bar:baz", "h": ["${hdr}"], "f": ["experimental", "supported"]}]
+EOT
+)"
+
+  EXPECT_SUCCEED \
+    "\"${RS_BINDINGS_FROM_CC}\" \
+      --target=//foo/bar:baz \
+      --rs_out=\"${rs_out}\" \
+      --cc_out=\"${cc_out}\" \
+      --crubit_support_path_format=\"<test/crubit/support/path/{header}>\" \
+      --clang_format_exe_path=\"${DEFAULT_CLANG_FORMAT_EXE_PATH}\" \
+      --rustfmt_exe_path=\"${DEFAULT_RUSTFMT_EXE_PATH}\" \
+      --public_headers=\"${hdr}\" \
+      --target_args=\"$(echo "${json}" | quote_escape)\" \
+      --time_trace_out=\"${time_trace_out}\""
+
+  EXPECT_FILE_NOT_EMPTY "${time_trace_out}"
+  EXPECT_SUCCEED "grep traceEvents \"${time_trace_out}\"" \
+    "Verify the time trace is in the Chrome trace event format"
+  EXPECT_SUCCEED "grep '\"RunClang\"' \"${time_trace_out}\"" \
+    "Verify the time trace has the spans of the C++ code"
+  EXPECT_SUCCEED "grep '\"rustfmt\"' \"${time_trace_out}\"" \
+    "Verify the time trace has the spans of the Rust code (on its threads)"
+}
+
 gbash::unit::main "$@"
@@ -0,0 +1,23 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/test/struct/relocation/relocation.h"
+
+namespace {
+int move_constructor_calls = 0;
+int destructor_calls = 0;
+}  // namespace
+
+void Relocatable::RecordMoveConstructorCall() { ++move_constructor_calls; }
+
+void Relocatable::RecordDestructorCall() { ++destructor_calls; }
+
+int Relocatable::GetMoveConstructorCalls() { return move_constructor_calls; }
+
+int Relocatable::GetDestructorCalls() { return destructor_calls; }
+
+void Relocatable::ResetCounters() {
+  move_constructor_calls = 0;
+  destructor_calls = 0;
+}
@@ -0,0 +1,46 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_TEST_STRUCT_RELOCATION_RELOCATION_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_TEST_STRUCT_RELOCATION_RELOCATION_H_
+
+#pragma clang lifetime_elision
+
+// A type with a user-defined move constructor and destructor, which is
+// nevertheless trivially relocatable (`__is_trivially_relocatable`), because
+// it is `[[clang::trivial_abi]]`.
+//
+// The move constructor and destructor count their calls, so that tests can
+// check that Rust moves it with a `memcpy`, rather than by calling the move
+// constructor.
+struct [[clang::trivial_abi]] Relocatable final {
+  Relocatable(Relocatable&& other) : value(other.value) {
+    RecordMoveConstructorCall();
+  }
+  ~Relocatable() { RecordDestructorCall(); }
+
+  static Relocatable Make(int value) { return Relocatable(value); }
+
+  static void RecordMoveConstructorCall();
+  static void RecordDestructorCall();
+  static int GetMoveConstructorCalls();
+  static int GetDestructorCalls();
+  static void ResetCounters();
+
+  int value;
+
+ private:
+  explicit Relocatable(int value) : value(value) {}
+};
+
+// Same as `Relocatable`, but as a field.
+struct [[clang::trivial_abi]] RelocatableWrapper final {
+  static RelocatableWrapper Make(int value) {
+    return RelocatableWrapper{Relocatable::Make(value)};
+  }
+
+  Relocatable field;
+};
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_TEST_STRUCT_RELOCATION_RELOCATION_H_
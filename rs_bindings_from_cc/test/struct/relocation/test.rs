@@ -0,0 +1,44 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#[cfg(test)]
+mod tests {
+    use relocation::*;
+    use static_assertions::assert_impl_all;
+
+    assert_impl_all!(Relocatable: Unpin);
+    assert_impl_all!(RelocatableWrapper: Unpin);
+
+    /// A `Vec` of trivially relocatable types grows by relocating its
+    /// elements with a `memcpy`, without calling their move constructors.
+    #[test]
+    fn test_vec_growth_relocates_without_move_constructor() {
+        Relocatable::ResetCounters();
+        {
+            let mut v = Vec::new();
+            for i in 0..100 {
+                v.push(Relocatable::Make(i));
+            }
+            v.shrink_to_fit();
+            v.swap(0, 99);
+            assert_eq!(v.iter().map(|r| r.value).sum::<i32>(), 4950);
+            assert_eq!(v[0].value, 99);
+            assert_eq!(Relocatable::GetDestructorCalls(), 0);
+        }
+        assert_eq!(Relocatable::GetMoveConstructorCalls(), 0);
+        assert_eq!(Relocatable::GetDestructorCalls(), 100);
+    }
+
+    #[test]
+    fn test_field_relocates_without_move_constructor() {
+        Relocatable::ResetCounters();
+        {
+            let wrappers: Vec<RelocatableWrapper> = (0..10).map(RelocatableWrapper::Make).collect();
+            let moved: Vec<RelocatableWrapper> = wrappers.into_iter().rev().collect();
+            assert_eq!(moved[0].field.value, 9);
+        }
+        assert_eq!(Relocatable::GetMoveConstructorCalls(), 0);
+        assert_eq!(Relocatable::GetDestructorCalls(), 10);
+    }
+}
@@ -0,0 +1,124 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/type_manifest.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "rs_bindings_from_cc/bazel_types.h"
+#include "rs_bindings_from_cc/ir.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+
+namespace crubit {
+namespace {
+
+// Returns the qualified name of a record named `name` in the item
+// `enclosing_item_id`, or nullopt if the record isn't at namespace scope.
+std::optional<std::string> QualifiedName(
+    absl::string_view name, std::optional<ItemId> enclosing_item_id,
+    const absl::flat_hash_map<ItemId, const Namespace*>& namespaces) {
+  std::string qualified_name(name);
+  while (enclosing_item_id.has_value()) {
+    auto ns = namespaces.find(*enclosing_item_id);
+    if (ns == namespaces.end()) return std::nullopt;
+    qualified_name =
+        absl::StrCat(ns->second->name.Ident(), "::", qualified_name);
+    enclosing_item_id = ns->second->enclosing_item_id;
+  }
+  return qualified_name;
+}
+
+}  // namespace
+
+std::string TypeManifestToJson(const IR& ir) {
+  absl::flat_hash_map<ItemId, const Namespace*> namespaces;
+  for (const Namespace* ns : ir.get_items_if<Namespace>()) {
+    namespaces.insert({ns->id, ns});
+  }
+
+  // A record may be forward declared by the target before it is defined, so
+  // a definition wins. The btree_map makes the output deterministic.
+  absl::btree_map<std::string, bool> types;
+  for (const Record* record : ir.get_items_if<Record>()) {
+    if (record->owning_target != ir.current_target ||
+        record->defining_target.has_value() ||
+        record->is_anon_record_with_typedef) {
+      continue;
+    }
+    if (std::optional<std::string> name = QualifiedName(
+            record->cc_name, record->enclosing_item_id, namespaces)) {
+      types[*std::move(name)] = true;
+    }
+  }
+  for (const IncompleteRecord* record : ir.get_items_if<IncompleteRecord>()) {
+    if (record->owning_target != ir.current_target) continue;
+    if (std::optional<std::string> name = QualifiedName(
+            record->cc_name, record->enclosing_item_id, namespaces)) {
+      types.try_emplace(*std::move(name), false);
+    }
+  }
+
+  llvm::json::Array json_types;
+  for (const auto& [name, complete] : types) {
+    json_types.push_back(llvm::json::Object{
+        {"name", name},
+        {"complete", complete},
+    });
+  }
+  llvm::json::Value manifest = llvm::json::Object{
+      {"target", ir.current_target.value()},
+      {"types", std::move(json_types)},
+  };
+  return llvm::formatv("{0:2}", manifest);
+}
+
+absl::Status AddTypeManifest(absl::string_view json, DependencyTypes& types) {
+  llvm::Expected<llvm::json::Value> manifest =
+      llvm::json::parse(llvm::StringRef(json.data(), json.size()));
+  if (auto err = manifest.takeError()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Malformed type manifest: ", toString(std::move(err))));
+  }
+  const llvm::json::Object* object = manifest->getAsObject();
+  std::optional<llvm::StringRef> target =
+      object != nullptr ? object->getString("target") : std::nullopt;
+  const llvm::json::Array* json_types =
+      object != nullptr ? object->getArray("types") : nullptr;
+  if (!target.has_value() || target->empty() || json_types == nullptr) {
+    return absl::InvalidArgumentError(
+        "Expected a type manifest to be an object with a non-empty `target` "
+        "string and a `types` array");
+  }
+  BazelLabel target_label(target->str());
+  for (const llvm::json::Value& type : *json_types) {
+    const llvm::json::Object* type_object = type.getAsObject();
+    std::optional<llvm::StringRef> name =
+        type_object != nullptr ? type_object->getString("name") : std::nullopt;
+    std::optional<bool> complete = type_object != nullptr
+                                       ? type_object->getBoolean("complete")
+                                       : std::nullopt;
+    if (!name.has_value() || name->empty() || !complete.has_value()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Expected the `types` of the type manifest of ", target_label.value(),
+          " to be objects with a non-empty `name` string and a `complete` "
+          "bool"));
+    }
+    if (*complete) {
+      types.try_emplace(name->str(), target_label);
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace crubit
@@ -0,0 +1,41 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_RS_BINDINGS_FROM_CC_TYPE_MANIFEST_H_
+#define CRUBIT_RS_BINDINGS_FROM_CC_TYPE_MANIFEST_H_
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "rs_bindings_from_cc/bazel_types.h"
+#include "rs_bindings_from_cc/ir.h"
+
+namespace crubit {
+
+// The records that the dependencies define (have a definition of) in their
+// own headers, by their qualified C++ name (e.g. `ns::inner::Record`, with
+// inline namespaces spelled out), mapped to the owning target.
+using DependencyTypes = absl::flat_hash_map<std::string, BazelLabel>;
+
+// Returns the type manifest of `ir.current_target` as JSON, e.g.:
+//
+//   {
+//     "target": "//foo:bar",
+//     "types": [{"name": "ns::Record", "complete": true}, ...]
+//   }
+//
+// The manifest lists the namespace-scope records that the target owns, sorted
+// by name, and whether the target defines them or only forward declares them.
+// Records in anonymous namespaces, nested records and template
+// instantiations are not listed.
+std::string TypeManifestToJson(const IR& ir);
+
+// Adds the records that the type manifest `json` lists as complete to `types`.
+absl::Status AddTypeManifest(absl::string_view json, DependencyTypes& types);
+
+}  // namespace crubit
+
+#endif  // CRUBIT_RS_BINDINGS_FROM_CC_TYPE_MANIFEST_H_
@@ -0,0 +1,118 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "rs_bindings_from_cc/type_manifest.h"
+
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "common/status_macros.h"
+#include "common/status_test_matchers.h"
+#include "rs_bindings_from_cc/bazel_types.h"
+#include "rs_bindings_from_cc/ir.h"
+#include "rs_bindings_from_cc/ir_from_cc.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+
+namespace crubit {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Pair;
+using ::testing::UnorderedElementsAre;
+
+llvm::json::Value ParseJson(absl::string_view json) {
+  return llvm::cantFail(
+      llvm::json::parse(llvm::StringRef(json.data(), json.size())));
+}
+
+TEST(TypeManifestTest, NamespaceScopeRecords) {
+  absl::string_view file = R"(
+    struct Defined {};
+    struct ForwardDeclared;
+    namespace ns {
+      inline namespace v1 {
+        struct Inner {
+          struct Nested {};
+        };
+      }
+    }
+    template <typename T> struct Template {};
+    using Instantiation = Template<int>;
+  )";
+  ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({file}));
+
+  EXPECT_EQ(ParseJson(TypeManifestToJson(ir)), ParseJson(R"({
+              "target": "//test:testing_target",
+              "types": [
+                {"name": "Defined", "complete": true},
+                {"name": "ForwardDeclared", "complete": false},
+                {"name": "ns::v1::Inner", "complete": true}
+              ]
+            })"));
+}
+
+TEST(TypeManifestTest, DefinitionAfterForwardDeclaration) {
+  absl::string_view file = R"(
+    struct Record;
+    void Use(Record* record);
+    struct Record {};
+  )";
+  ASSERT_OK_AND_ASSIGN(IR ir, IrFromCc({file}));
+
+  EXPECT_EQ(ParseJson(TypeManifestToJson(ir)), ParseJson(R"({
+              "target": "//test:testing_target",
+              "types": [{"name": "Record", "complete": true}]
+            })"));
+}
+
+TEST(TypeManifestTest, AddTypeManifest) {
+  DependencyTypes types;
+  ASSERT_OK(AddTypeManifest(R"({
+                              "target": "//dep:lib",
+                              "types": [
+                                {"name": "ns::Complete", "complete": true},
+                                {"name": "Incomplete", "complete": false}
+                              ]
+                            })",
+                            types));
+
+  EXPECT_THAT(types, UnorderedElementsAre(
+                         Pair("ns::Complete", BazelLabel("//dep:lib"))));
+}
+
+TEST(TypeManifestTest, AddTypeManifestKeepsTheFirstTarget) {
+  DependencyTypes types;
+  ASSERT_OK(AddTypeManifest(
+      R"({"target": "//a", "types": [{"name": "X", "complete": true}]})",
+      types));
+  ASSERT_OK(AddTypeManifest(
+      R"({"target": "//b", "types": [{"name": "X", "complete": true}]})",
+      types));
+
+  EXPECT_THAT(types, UnorderedElementsAre(Pair("X", BazelLabel("//a"))));
+}
+
+TEST(TypeManifestTest, AddMalformedTypeManifest) {
+  DependencyTypes types;
+  EXPECT_THAT(AddTypeManifest("[]", types),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("`target` string and a `types` array")));
+  EXPECT_THAT(AddTypeManifest(R"({"target": "//a", "types": [{"name": ""}]})",
+                              types),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("non-empty `name` string")));
+  EXPECT_THAT(AddTypeManifest("{", types),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Malformed type manifest")));
+  EXPECT_THAT(types, IsEmpty());
+}
+
+}  // namespace
+}  // namespace crubit
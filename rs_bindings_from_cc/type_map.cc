@@ -6,11 +6,16 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
 #include "rs_bindings_from_cc/ir.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
 #include "clang/AST/Type.h"
+#include "clang/Basic/IdentifierTable.h"
 
 namespace crubit {
 
@@ -60,9 +65,92 @@ std::optional<absl::string_view> MapKnownCcTypeToRsType(
   return it->second;
 }
 
+// Returns the name of the typedef that `cc_type` spells, if any.
+//
+// Only such types can print as one of the names in `MapKnownCcTypeToRsType`,
+// and their name is the last component of that, so it is a cheap way to rule
+// out most types without printing them.
+std::optional<absl::string_view> GetTypedefName(const clang::Type& cc_type) {
+  const clang::Type* type = &cc_type;
+  while (true) {
+    if (const auto* elaborated_type =
+            clang::dyn_cast<clang::ElaboratedType>(type)) {
+      type = elaborated_type->getNamedType().getTypePtr();
+    } else if (const auto* subst_type =
+                   clang::dyn_cast<clang::SubstTemplateTypeParmType>(type)) {
+      type = subst_type->getReplacementType().getTypePtr();
+    } else {
+      break;
+    }
+  }
+
+  const clang::NamedDecl* decl = nullptr;
+  if (const auto* typedef_type = clang::dyn_cast<clang::TypedefType>(type)) {
+    decl = typedef_type->getDecl();
+  } else if (const auto* using_type = clang::dyn_cast<clang::UsingType>(type)) {
+    decl = using_type->getFoundDecl();
+  } else {
+    return std::nullopt;
+  }
+  const clang::IdentifierInfo* identifier = decl->getIdentifier();
+  if (identifier == nullptr) return std::nullopt;
+  return absl::string_view(identifier->getName());
+}
+
+// Returns true if `cc_type` is a string view with the layout of a Rust slice
+// pointer: a pointer to `char`, followed by the number of characters.
+//
+// This is the case for libc++'s `std::string_view`, but not, for example, for
+// libstdc++'s, which starts with the size.
+bool HasSliceLayout(const clang::Type& cc_type) {
+  const auto* record = clang::dyn_cast_or_null<clang::CXXRecordDecl>(
+      cc_type.getAsRecordDecl());
+  if (record == nullptr) return false;
+  record = record->getDefinition();
+  if (record == nullptr || record->isUnion() || record->isDynamicClass() ||
+      record->getNumBases() != 0) {
+    return false;
+  }
+  std::vector<const clang::FieldDecl*> fields(record->field_begin(),
+                                              record->field_end());
+  if (fields.size() != 2) return false;
+  clang::QualType data_type = fields[0]->getType();
+  clang::QualType size_type = fields[1]->getType();
+  const clang::ASTContext& ast_context = record->getASTContext();
+  return data_type->isPointerType() &&
+         data_type->getPointeeType()->isCharType() &&
+         size_type->isUnsignedIntegerType() &&
+         ast_context.getTypeSize(size_type) ==
+             ast_context.getTypeSize(data_type) &&
+         !fields[0]->isBitField() && !fields[1]->isBitField();
+}
+
 }  // namespace
 
-std::optional<MappedType> GetTypeMapOverride(const clang::Type& cc_type) {
+std::optional<MappedType> GetTypeMapOverride(
+    const clang::Type& cc_type, bool string_view_as_slice_pointer) {
+  // Every name in the map also has an unqualified entry.
+  std::optional<absl::string_view> typedef_name = GetTypedefName(cc_type);
+  if (!typedef_name.has_value()) return std::nullopt;
+
+  // String views are passed as Rust slice pointers, without conversions: both
+  // are a pointer and a size, and are passed in the same registers. This is
+  // opt-in, as it makes the functions that take string views `unsafe`.
+  if (*typedef_name == "string_view") {
+    if (!string_view_as_slice_pointer) return std::nullopt;
+    std::string type_string = clang::QualType(&cc_type, 0).getAsString();
+    if ((type_string != "std::string_view" &&
+         type_string != "absl::string_view") ||
+        !HasSliceLayout(cc_type)) {
+      return std::nullopt;
+    }
+    MappedType mapped_type = MappedType::Simple("*const", type_string);
+    mapped_type.rs_type.type_args.push_back(RsType{.name = "[u8]"});
+    return mapped_type;
+  }
+
+  if (!MapKnownCcTypeToRsType(*typedef_name).has_value()) return std::nullopt;
+
   std::string type_string = clang::QualType(&cc_type, 0).getAsString();
   std::optional<absl::string_view> rust_type =
       MapKnownCcTypeToRsType(type_string);
@@ -18,11 +18,14 @@ namespace crubit {
 // The return value is a fully-qualified Rust name, including builtin type
 // names.
 //
-// For example, C++ `int64_t` becomes Rust `i64`.
+// For example, C++ `int64_t` becomes Rust `i64`. If
+// `string_view_as_slice_pointer` is set, C++ `std::string_view` also becomes
+// Rust `*const [u8]` (if its layout is that of a Rust slice pointer).
 //
 // To create a new type mapping, add the type to the hardcoded list
 // of types.
-std::optional<MappedType> GetTypeMapOverride(const clang::Type& cc_type);
+std::optional<MappedType> GetTypeMapOverride(
+    const clang::Type& cc_type, bool string_view_as_slice_pointer = false);
 
 }  // namespace crubit
 
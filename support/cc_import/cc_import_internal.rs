@@ -3,7 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
 use import_internal::{ImportMacroInput, Mode};
-use merged_namespaces::{JsonNamespaceHierarchy, MergedNamespaceHierarchy};
+use merged_namespaces::{MergedNamespaceHierarchy, PrecomputedNamespaceHierarchy};
 use proc_macro2::TokenStream;
 use quote::ToTokens;
 use syn::parse::{Parse, ParseStream};
@@ -34,20 +34,20 @@ fn get_namespace_hierarchy() -> MergedNamespaceHierarchy {
     let files: Vec<String> = serde_json::from_str(&namespace_json_files)
         .expect("Could not parse CC_IMPORT_NAMESPACES environment variable");
 
-    let merged_hierarchy = files
-        .iter()
-        .map(|file_path| {
-            let json_file_content = std::fs::read_to_string(file_path)
-                .unwrap_or_else(|_| panic!("Couldn't read file {}", &file_path));
-            let json_namespace_hierarchy: JsonNamespaceHierarchy =
-                serde_json::from_str(&json_file_content)
-                    .expect("Did not parse JSON content successfully");
-            MergedNamespaceHierarchy::from_json_namespace_hierarchy(&json_namespace_hierarchy)
-        })
-        .reduce(|mut merged, next| {
-            merged.merge(next);
-            merged
-        })
-        .unwrap();
-    merged_hierarchy
+    get_precomputed_namespace_hierarchy(&files)
+        .unwrap_or_else(|| MergedNamespaceHierarchy::from_json_files(&files))
+}
+
+/// Returns the hierarchy that was merged when building the crate (see
+/// `rs_bindings_from_cc/merged_namespaces_builder.cc`), if it was merged from
+/// exactly the namespace `files`. For example, a `rust_test` of a crate gets
+/// the hierarchy of the crate, which lacks the namespaces of the `cc_deps` of
+/// the test itself.
+fn get_precomputed_namespace_hierarchy(files: &[String]) -> Option<MergedNamespaceHierarchy> {
+    let merged_json = std::env::var("CC_IMPORT_MERGED_NAMESPACES").ok()?;
+    let precomputed: PrecomputedNamespaceHierarchy = serde_json::from_str(&merged_json).ok()?;
+    if precomputed.sources != files {
+        return None;
+    }
+    precomputed.into_merged().ok()
 }
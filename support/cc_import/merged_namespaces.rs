@@ -122,6 +122,85 @@ impl MergedNamespaceHierarchy {
             }
         }
     }
+
+    /// Reads and merges the namespace hierarchies of the `*_namespaces.json`
+    /// files at `paths`.
+    pub fn from_json_files(paths: &[String]) -> MergedNamespaceHierarchy {
+        paths
+            .iter()
+            .map(|file_path| {
+                let json_file_content = std::fs::read_to_string(file_path)
+                    .unwrap_or_else(|_| panic!("Couldn't read file {}", &file_path));
+                let json_namespace_hierarchy: JsonNamespaceHierarchy =
+                    serde_json::from_str(&json_file_content)
+                        .expect("Did not parse JSON content successfully");
+                MergedNamespaceHierarchy::from_json_namespace_hierarchy(&json_namespace_hierarchy)
+            })
+            .reduce(|mut merged, next| {
+                merged.merge(next);
+                merged
+            })
+            .unwrap()
+    }
+}
+
+/// A `MergedNamespaceHierarchy` that was merged when building the crate (by
+/// `rs_bindings_from_cc/merged_namespaces_builder.cc`), so that `cc_import!`
+/// doesn't need to read and merge the namespace files of all the dependencies
+/// again. Each label is only stored once, and is referred to by its index in
+/// `labels`.
+#[derive(Debug, Deserialize)]
+pub struct PrecomputedNamespaceHierarchy {
+    /// The paths of the namespace files that were merged, in order.
+    pub sources: Vec<String>,
+    labels: Vec<Rc<str>>,
+    namespaces: Vec<PrecomputedNamespace>,
+}
+
+#[derive(Debug, Deserialize)]
+struct PrecomputedNamespace {
+    #[serde(rename = "n")]
+    name: Rc<str>,
+    #[serde(rename = "l", default)]
+    labels: Vec<usize>,
+    #[serde(rename = "c", default)]
+    children: Vec<PrecomputedNamespace>,
+}
+
+impl PrecomputedNamespaceHierarchy {
+    /// Returns the merged hierarchy, or an error if a label index is out of
+    /// range.
+    pub fn into_merged(self) -> Result<MergedNamespaceHierarchy, String> {
+        fn into_merged(
+            namespace: PrecomputedNamespace,
+            labels: &[Rc<str>],
+        ) -> Result<MergedNamespace, String> {
+            let PrecomputedNamespace { name, labels: label_indices, children } = namespace;
+            Ok(MergedNamespace {
+                labels: label_indices
+                    .into_iter()
+                    .map(|index| {
+                        labels.get(index).cloned().ok_or_else(|| {
+                            format!("Invalid label index {index} in namespace '{name}'")
+                        })
+                    })
+                    .collect::<Result<_, _>>()?,
+                children: children
+                    .into_iter()
+                    .map(|child| Ok((child.name.clone(), into_merged(child, labels)?)))
+                    .collect::<Result<_, String>>()?,
+                name,
+            })
+        }
+
+        let PrecomputedNamespaceHierarchy { sources: _, labels, namespaces } = self;
+        Ok(MergedNamespaceHierarchy {
+            top_level_namespaces: namespaces
+                .into_iter()
+                .map(|namespace| Ok((namespace.name.clone(), into_merged(namespace, &labels)?)))
+                .collect::<Result<_, String>>()?,
+        })
+    }
 }
 
 impl ToTokens for MergedNamespaceHierarchy {
@@ -427,4 +506,101 @@ mod tests {
             }
         );
     }
+
+    #[test]
+    fn test_precomputed_matches_merged() {
+        let hierarchy_one: JsonNamespaceHierarchy = serde_json::from_str(
+            r#"{
+            "label": "//foo/bar:baz",
+            "namespaces": [
+                {
+                    "name": "top_level_1",
+                    "children": [
+                        {
+                            "name": "reopened",
+                            "children": [
+                                {
+                                    "name": "baz_specific",
+                                    "children": []
+                                }
+                            ]
+                        }
+                    ]
+                }
+            ]
+        }"#,
+        )
+        .unwrap();
+
+        let hierarchy_two: JsonNamespaceHierarchy = serde_json::from_str(
+            r#"{
+            "label": "//foo/bar:xyz",
+            "namespaces": [
+                {
+                    "name": "top_level_1",
+                    "children": [
+                        {
+                            "name": "xyz_specific",
+                            "children": []
+                        },
+                        {
+                            "name": "reopened",
+                            "children": []
+                        }
+                    ]
+                },
+                {
+                    "name": "top_level_2",
+                    "children": []
+                }
+            ]
+        }"#,
+        )
+        .unwrap();
+
+        let mut merged_hierarchy =
+            MergedNamespaceHierarchy::from_json_namespace_hierarchy(&hierarchy_one);
+        merged_hierarchy
+            .merge(MergedNamespaceHierarchy::from_json_namespace_hierarchy(&hierarchy_two));
+
+        // The same hierarchy, as merged by `merged_namespaces_builder` (see
+        // `MergedNamespacesTest.MergesReopenedNamespaces` in
+        // rs_bindings_from_cc/merged_namespaces_test.cc).
+        let precomputed: PrecomputedNamespaceHierarchy = serde_json::from_str(
+            r#"{
+            "labels": ["//foo/bar:baz", "//foo/bar:xyz"],
+            "namespaces": [
+                {
+                    "c": [
+                        {"c": [{"l": [0], "n": "baz_specific"}], "l": [0], "n": "reopened"},
+                        {"l": [1], "n": "xyz_specific"}
+                    ],
+                    "l": [0, 1],
+                    "n": "top_level_1"
+                },
+                {"l": [1], "n": "top_level_2"}
+            ],
+            "sources": ["baz.json", "xyz.json"]
+        }"#,
+        )
+        .unwrap();
+        assert_eq!(precomputed.sources, ["baz.json", "xyz.json"]);
+        let precomputed_hierarchy = precomputed.into_merged().unwrap();
+        assert_eq!(
+            quote! {#precomputed_hierarchy}.to_string(),
+            quote! {#merged_hierarchy}.to_string()
+        );
+    }
+
+    #[test]
+    fn test_precomputed_invalid_label_index() {
+        let precomputed: PrecomputedNamespaceHierarchy = serde_json::from_str(
+            r#"{"sources": [], "labels": ["//:a"], "namespaces": [{"n": "a", "l": [1]}]}"#,
+        )
+        .unwrap();
+        assert_eq!(
+            precomputed.into_merged().unwrap_err(),
+            "Invalid label index 1 in namespace 'a'"
+        );
+    }
 }
@@ -0,0 +1,126 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+/// In-place access to the characters of a C++ `std::string`.
+///
+/// `String` reimplements `data()` and `size()` against the (default) libc++
+/// layout of `std::string` on little-endian platforms, so that Rust can read
+/// and write the characters without copying them and without calling into C++.
+///
+/// A `String` is never created in Rust. Instead, a pointer to a C++
+/// `std::string` is reinterpreted as a pointer to a `String`:
+///
+/// ```ignore
+/// let s: &String = unsafe { &*(GetString() as *const String) };
+/// assert_eq!(s.as_slice(), b"Hello, world!");
+/// ```
+///
+/// Operations that change the size of the string are not supported: they
+/// need to switch between the short and the long representation, which is
+/// left to C++.
+// TODO: b/324045078 - Move this into its own crate once `cc_std` can depend on
+// a Rust crate.
+pub mod string {
+    use core::mem::{align_of, size_of};
+
+    /// The long representation of the string, used for strings that don't fit
+    /// in the object itself. The first word holds the capacity, with the least
+    /// significant bit set to mark the long representation.
+    #[repr(C)]
+    #[derive(Clone, Copy)]
+    struct Long {
+        cap_and_is_long: usize,
+        size: usize,
+        data: *mut u8,
+    }
+
+    /// The short representation of the string ("short string optimization").
+    /// The first byte holds the size, shifted left by one, with the least
+    /// significant bit cleared to mark the short representation.
+    #[repr(C)]
+    #[derive(Clone, Copy)]
+    struct Short {
+        size_and_is_long: u8,
+        data: [u8; size_of::<Long>() - 1],
+    }
+
+    #[repr(C)]
+    pub union String {
+        long: Long,
+        short: Short,
+    }
+
+    const _: () = assert!(size_of::<String>() == 3 * size_of::<*const u8>());
+    const _: () = assert!(align_of::<String>() == align_of::<*const u8>());
+
+    impl String {
+        #[inline(always)]
+        fn is_long(&self) -> bool {
+            // SAFETY: both representations start with the `is_long` bit.
+            unsafe { self.short.size_and_is_long & 1 != 0 }
+        }
+
+        /// Returns the number of characters in the string, not including the
+        /// terminating null character.
+        #[inline(always)]
+        pub fn len(&self) -> usize {
+            // SAFETY: `is_long()` tells which representation is active.
+            unsafe {
+                if self.is_long() {
+                    self.long.size
+                } else {
+                    (self.short.size_and_is_long >> 1) as usize
+                }
+            }
+        }
+
+        /// Returns whether the string is empty.
+        #[inline(always)]
+        pub fn is_empty(&self) -> bool {
+            self.len() == 0
+        }
+
+        /// Returns a pointer to the characters, which are followed by a null
+        /// character (similar to C++ `data()`).
+        #[inline(always)]
+        pub fn as_ptr(&self) -> *const u8 {
+            // SAFETY: `is_long()` tells which representation is active.
+            unsafe {
+                if self.is_long() {
+                    self.long.data
+                } else {
+                    self.short.data.as_ptr()
+                }
+            }
+        }
+
+        /// Returns the characters of the string, without copying them and
+        /// without the terminating null character.
+        #[inline(always)]
+        pub fn as_slice(&self) -> &[u8] {
+            // SAFETY: the string holds `len()` initialized characters at
+            // `as_ptr()`, which live as long as `self` is not modified.
+            unsafe { core::slice::from_raw_parts(self.as_ptr(), self.len()) }
+        }
+
+        /// Returns the characters of the string as a mutable slice, without
+        /// copying them and without the terminating null character.
+        #[inline(always)]
+        pub fn as_mut_slice(&mut self) -> &mut [u8] {
+            let len = self.len();
+            // SAFETY: `is_long()` tells which representation is active.
+            let data = unsafe {
+                if self.is_long() {
+                    self.long.data
+                } else {
+                    self.short.data.as_mut_ptr()
+                }
+            };
+            // SAFETY: the string holds `len` initialized characters at `data`,
+            // and `&mut self` guarantees exclusive access to them. (For the
+            // short representation, `data` points into `self`.)
+            unsafe { core::slice::from_raw_parts_mut(data, len) }
+        }
+    }
+}
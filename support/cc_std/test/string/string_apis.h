@@ -0,0 +1,36 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_SUPPORT_CC_STD_TEST_STRING_STRING_APIS_H_
+#define CRUBIT_SUPPORT_CC_STD_TEST_STRING_STRING_APIS_H_
+
+#include <cstddef>
+#include <string>
+
+// `cc_std::string::String` assumes that `std::string` is three words.
+static_assert(sizeof(std::string) == 3 * sizeof(char*));
+static_assert(alignof(std::string) == alignof(char*));
+
+namespace crubit_string {
+
+// `std::string` is passed as `void*`, which Rust then reinterprets as a
+// `cc_std::string::String`.
+
+// Returns a string short enough to be stored inline in the `std::string`.
+inline void* NewShortString() { return new std::string("Hello"); }
+
+// Returns a string long enough to be stored on the heap.
+inline void* NewLongString() {
+  return new std::string("Hello, world! This string does not fit inline.");
+}
+
+inline void DeleteString(void* s) { delete static_cast<std::string*>(s); }
+
+inline char GetFirstChar(const void* s) {
+  return static_cast<const std::string*>(s)->front();
+}
+
+}  // namespace crubit_string
+
+#endif  // CRUBIT_SUPPORT_CC_STD_TEST_STRING_STRING_APIS_H_
@@ -0,0 +1,40 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+use cc_std::string::String;
+use string_apis::crubit_string::{DeleteString, GetFirstChar, NewLongString, NewShortString};
+
+/// Calls `f` with the C++ `std::string` at `raw`, and then deletes it.
+fn with_string(raw: *mut core::ffi::c_void, f: impl FnOnce(*mut core::ffi::c_void, &mut String)) {
+    f(raw, unsafe { &mut *(raw as *mut String) });
+    unsafe { DeleteString(raw) };
+}
+
+#[test]
+fn test_short_string() {
+    with_string(NewShortString(), |_, s| {
+        assert_eq!(s.len(), 5);
+        assert_eq!(s.as_slice(), b"Hello");
+        // The characters are null-terminated.
+        assert_eq!(unsafe { *s.as_ptr().add(5) }, 0);
+    });
+}
+
+#[test]
+fn test_long_string() {
+    with_string(NewLongString(), |_, s| {
+        assert_eq!(s.as_slice(), b"Hello, world! This string does not fit inline.");
+        assert_eq!(unsafe { *s.as_ptr().add(s.len()) }, 0);
+    });
+}
+
+#[test]
+fn test_as_mut_slice_writes_in_place() {
+    for raw in [NewShortString(), NewLongString()] {
+        with_string(raw, |raw, s| {
+            s.as_mut_slice()[0] = b'J';
+            assert_eq!(unsafe { GetFirstChar(raw) }, b'J' as _);
+        });
+    }
+}
@@ -0,0 +1,48 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+use cc_std::unique_ptr::UniquePtr;
+use unique_ptr_apis::crubit_unique_ptr::{
+    DestroyedCount, MakeCounted, MakeInt, TakeCounted, TakeInt,
+};
+
+#[test]
+fn test_round_trip() {
+    let i = MakeInt(42);
+    assert!(!i.is_null());
+    assert_eq!(i.as_ref(), Some(&42));
+    assert_eq!(TakeInt(i), 42);
+}
+
+#[test]
+fn test_null() {
+    assert_eq!(TakeInt(UniquePtr::null()), -1);
+    assert_eq!(TakeCounted(UniquePtr::default()), -1);
+}
+
+#[test]
+fn test_move_keeps_the_pointee_in_place() {
+    let i = MakeInt(7);
+    let ptr = i.as_ptr();
+    let moved = Box::new(i);
+    assert_eq!(moved.as_ptr(), ptr);
+    assert_eq!(TakeInt(*moved), 7);
+}
+
+#[test]
+fn test_into_raw_and_from_raw() {
+    let ptr = MakeInt(3).into_raw();
+    assert_eq!(TakeInt(unsafe { UniquePtr::from_raw(ptr) }), 3);
+}
+
+// The only test that destroys `Counted` objects, so that the count doesn't
+// depend on the other tests, which run concurrently.
+#[test]
+fn test_destroyed_exactly_once() {
+    let before = DestroyedCount();
+    drop(MakeCounted(1));
+    assert_eq!(DestroyedCount(), before + 1);
+    assert_eq!(TakeCounted(MakeCounted(2)), 2);
+    assert_eq!(DestroyedCount(), before + 2);
+}
@@ -0,0 +1,53 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_SUPPORT_CC_STD_TEST_UNIQUE_PTR_UNIQUE_PTR_APIS_H_
+#define CRUBIT_SUPPORT_CC_STD_TEST_UNIQUE_PTR_UNIQUE_PTR_APIS_H_
+
+#include <cstdint>
+#include <memory>
+
+// `cc_std::unique_ptr::UniquePtr<T>` assumes that `std::unique_ptr<T>` is a
+// single pointer.
+static_assert(sizeof(std::unique_ptr<int32_t>) == sizeof(int32_t*));
+static_assert(alignof(std::unique_ptr<int32_t>) == alignof(int32_t*));
+
+namespace crubit_unique_ptr {
+
+inline int32_t& DestroyedCountStorage() {
+  static int32_t count = 0;
+  return count;
+}
+
+// The number of `Counted` objects destroyed so far.
+inline int32_t DestroyedCount() { return DestroyedCountStorage(); }
+
+struct Counted final {
+  ~Counted() { ++DestroyedCountStorage(); }
+  int32_t value = 0;
+};
+
+inline std::unique_ptr<Counted> MakeCounted(int32_t value) {
+  auto counted = std::make_unique<Counted>();
+  counted->value = value;
+  return counted;
+}
+
+// Returns the value of `counted`, or -1 if it is null.
+inline int32_t TakeCounted(std::unique_ptr<Counted> counted) {
+  return counted == nullptr ? -1 : counted->value;
+}
+
+inline std::unique_ptr<int32_t> MakeInt(int32_t value) {
+  return std::make_unique<int32_t>(value);
+}
+
+// Returns the value of `i`, or -1 if it is null.
+inline int32_t TakeInt(std::unique_ptr<int32_t> i) {
+  return i == nullptr ? -1 : *i;
+}
+
+}  // namespace crubit_unique_ptr
+
+#endif  // CRUBIT_SUPPORT_CC_STD_TEST_UNIQUE_PTR_UNIQUE_PTR_APIS_H_
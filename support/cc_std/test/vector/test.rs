@@ -0,0 +1,58 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+use cc_std::vector::Vector;
+use vector_apis::crubit_vector::{DeleteVector, NewVector, Size, Sum};
+
+/// Calls `f` with a new C++ `std::vector<int32_t>{1, 2, 3}`.
+fn with_vector(f: impl FnOnce(*mut core::ffi::c_void, &mut Vector<i32>)) {
+    let raw = NewVector();
+    f(raw, unsafe { &mut *(raw as *mut Vector<i32>) });
+    unsafe { DeleteVector(raw) };
+}
+
+#[test]
+fn test_as_slice() {
+    with_vector(|_, v| {
+        assert_eq!(v.len(), 3);
+        assert!(!v.is_empty());
+        assert_eq!(v.as_slice(), &[1, 2, 3]);
+    });
+}
+
+#[test]
+fn test_as_mut_slice_writes_in_place() {
+    with_vector(|raw, v| {
+        let ptr = v.as_ptr();
+        v.as_mut_slice()[0] = 10;
+        assert_eq!(v.as_ptr(), ptr);
+        assert_eq!(unsafe { Sum(raw) }, 15);
+    });
+}
+
+#[test]
+fn test_reserve() {
+    with_vector(|raw, v| {
+        v.reserve(100);
+        assert!(v.capacity() >= 100);
+        assert_eq!(v.as_slice(), &[1, 2, 3]);
+        let ptr = v.as_ptr();
+        v.reserve(10);
+        assert_eq!(v.as_ptr(), ptr);
+        assert_eq!(unsafe { Size(raw) }, 3);
+    });
+}
+
+#[test]
+fn test_push_back() {
+    with_vector(|raw, v| {
+        for i in 4..=100 {
+            v.push_back(i);
+        }
+        assert_eq!(v.len(), 100);
+        assert_eq!(v.as_slice()[99], 100);
+        assert_eq!(unsafe { Size(raw) }, 100);
+        assert_eq!(unsafe { Sum(raw) }, 5050);
+    });
+}
@@ -0,0 +1,39 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_SUPPORT_CC_STD_TEST_VECTOR_VECTOR_APIS_H_
+#define CRUBIT_SUPPORT_CC_STD_TEST_VECTOR_VECTOR_APIS_H_
+
+#include <cstdint>
+#include <vector>
+
+// `cc_std::vector::Vector<T>` assumes that `std::vector<T>` is three pointers.
+static_assert(sizeof(std::vector<int32_t>) == 3 * sizeof(int32_t*));
+static_assert(alignof(std::vector<int32_t>) == alignof(int32_t*));
+
+namespace crubit_vector {
+
+// `std::vector<int32_t>` is passed as `void*`, which Rust then reinterprets
+// as a `cc_std::vector::Vector<i32>`.
+
+inline void* NewVector() { return new std::vector<int32_t>{1, 2, 3}; }
+
+inline void DeleteVector(void* v) {
+  delete static_cast<std::vector<int32_t>*>(v);
+}
+
+inline int32_t Sum(const void* v) {
+  int32_t sum = 0;
+  for (int32_t i : *static_cast<const std::vector<int32_t>*>(v)) sum += i;
+  return sum;
+}
+
+inline int32_t Size(const void* v) {
+  return static_cast<int32_t>(
+      static_cast<const std::vector<int32_t>*>(v)->size());
+}
+
+}  // namespace crubit_vector
+
+#endif  // CRUBIT_SUPPORT_CC_STD_TEST_VECTOR_VECTOR_APIS_H_
@@ -0,0 +1,148 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+/// An owning pointer with the layout of a C++ `std::unique_ptr<T>`.
+///
+/// The generated bindings map `std::unique_ptr<T, std::default_delete<T>>` to
+/// `UniquePtr<T>`, as long as the `std::unique_ptr` is laid out as a single
+/// pointer, and `delete` on a `T*` is exactly a call to the destructor of `T`
+/// followed by the global `::operator delete`. Other deleters, arrays, types
+/// with a virtual destructor, and types with a class-specific `operator delete`
+/// keep the bindings of a template instantiation.
+///
+/// `UniquePtr<T>` is `Unpin`, even if `T` isn't: moving it only moves the
+/// pointer, and the pointee stays where it is. So a `UniquePtr<T>` is moved by
+/// `memcpy` in Rust, and across the FFI boundary it is moved out of with
+/// `std::move` in C++, which leaves a null pointer behind.
+///
+/// Dropping a non-null `UniquePtr<T>` drops the pointee in place, which runs
+/// the (single) destructor thunk of `T`, if any, and then frees the memory with
+/// `::operator delete`, like `std::default_delete<T>` does.
+// TODO: b/324045078 - Move this into its own crate once `cc_std` can depend on
+// a Rust crate.
+pub mod unique_ptr {
+    use core::ffi::c_void;
+    use core::marker::PhantomData;
+    use core::mem::{align_of, size_of};
+    use core::pin::Pin;
+    use core::ptr;
+
+    #[repr(transparent)]
+    pub struct UniquePtr<T> {
+        ptr: *mut T,
+        // `UniquePtr<T>` owns a `T`, so it drops one.
+        _marker: PhantomData<T>,
+    }
+
+    const _: () = assert!(size_of::<UniquePtr<u8>>() == size_of::<*const u8>());
+    const _: () = assert!(align_of::<UniquePtr<u8>>() == align_of::<*const u8>());
+
+    // The alignment up to which `::operator new(size_t)` suffices. This is
+    // `__STDCPP_DEFAULT_NEW_ALIGNMENT__` on all the platforms that Crubit
+    // supports.
+    const DEFAULT_NEW_ALIGNMENT: usize = 16;
+
+    extern "C" {
+        // `::operator delete(void*)`, which `delete` calls for types that are
+        // not over-aligned.
+        #[link_name = "_ZdlPv"]
+        fn operator_delete(ptr: *mut c_void);
+        // `::operator delete(void*, std::align_val_t)`, which `delete` calls
+        // for over-aligned types.
+        #[link_name = "_ZdlPvSt11align_val_t"]
+        fn operator_delete_aligned(ptr: *mut c_void, align: usize);
+    }
+
+    // SAFETY: `UniquePtr<T>` owns its `T`, like a `Box<T>`.
+    unsafe impl<T: Send> Send for UniquePtr<T> {}
+    // SAFETY: `UniquePtr<T>` only gives out `&T` from `&self`.
+    unsafe impl<T: Sync> Sync for UniquePtr<T> {}
+
+    impl<T> Unpin for UniquePtr<T> {}
+
+    impl<T> UniquePtr<T> {
+        /// Returns a null `UniquePtr`, like a default-constructed
+        /// `std::unique_ptr`.
+        #[inline(always)]
+        pub const fn null() -> Self {
+            Self { ptr: ptr::null_mut(), _marker: PhantomData }
+        }
+
+        /// Takes ownership of `ptr`.
+        ///
+        /// # Safety
+        ///
+        /// `ptr` must be null, or point to a `T` allocated by C++ `new` (or
+        /// released from a `std::unique_ptr<T>`) that nothing else owns.
+        #[inline(always)]
+        pub unsafe fn from_raw(ptr: *mut T) -> Self {
+            Self { ptr, _marker: PhantomData }
+        }
+
+        /// Releases ownership of the pointee, like `std::unique_ptr::release`.
+        /// The caller is responsible for deleting it.
+        #[inline(always)]
+        pub fn into_raw(self) -> *mut T {
+            let ptr = self.ptr;
+            core::mem::forget(self);
+            ptr
+        }
+
+        /// Returns the pointer, like `std::unique_ptr::get`, without releasing
+        /// ownership.
+        #[inline(always)]
+        pub fn as_ptr(&self) -> *mut T {
+            self.ptr
+        }
+
+        #[inline(always)]
+        pub fn is_null(&self) -> bool {
+            self.ptr.is_null()
+        }
+
+        /// Returns a reference to the pointee, or `None` if this is null.
+        #[inline(always)]
+        pub fn as_ref(&self) -> Option<&T> {
+            // SAFETY: a non-null `ptr` points to a `T` that `self` owns.
+            unsafe { self.ptr.as_ref() }
+        }
+
+        /// Returns a pinned mutable reference to the pointee, or `None` if
+        /// this is null. The pointee is pinned because C++ may rely on its
+        /// address, and the `UniquePtr` never moves it.
+        #[inline(always)]
+        pub fn as_mut(&mut self) -> Option<Pin<&mut T>> {
+            // SAFETY: a non-null `ptr` points to a `T` that `self` owns, and
+            // that is not moved until it is dropped.
+            unsafe { self.ptr.as_mut().map(|pointee| Pin::new_unchecked(pointee)) }
+        }
+    }
+
+    impl<T> Default for UniquePtr<T> {
+        #[inline(always)]
+        fn default() -> Self {
+            Self::null()
+        }
+    }
+
+    impl<T> Drop for UniquePtr<T> {
+        #[inline(always)]
+        fn drop(&mut self) {
+            if self.ptr.is_null() {
+                return;
+            }
+            // SAFETY: `ptr` points to a `T` allocated by C++ `new` that `self`
+            // owns, and `delete` on it is the destructor followed by the global
+            // `::operator delete` (see the type's documentation).
+            unsafe {
+                ptr::drop_in_place(self.ptr);
+                if align_of::<T>() <= DEFAULT_NEW_ALIGNMENT {
+                    operator_delete(self.ptr as *mut c_void);
+                } else {
+                    operator_delete_aligned(self.ptr as *mut c_void, align_of::<T>());
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,169 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+/// In-place access to a C++ `std::vector<T>`.
+///
+/// `std::vector<T>` is a class template, so the generated bindings can't
+/// provide its member functions for an arbitrary `T`. Instead, `Vector<T>`
+/// reimplements the parts that don't need to run C++ code on the elements,
+/// against the libc++ layout of `std::vector<T, std::allocator<T>>`: three
+/// pointers, to the first element, one past the last element, and one past the
+/// end of the allocation.
+///
+/// A `Vector<T>` is never created in Rust. Instead, a pointer to a C++
+/// `std::vector<T>` is reinterpreted as a pointer to a `Vector<T>`, which then
+/// accesses the elements without copying them:
+///
+/// ```ignore
+/// let v: &mut Vector<i32> = unsafe { &mut *(GetVector() as *mut Vector<i32>) };
+/// v.as_mut_slice()[0] += 1;
+/// v.push_back(4);
+/// ```
+// TODO: b/324045078 - Move this into its own crate once `cc_std` can depend on
+// a Rust crate.
+pub mod vector {
+    use core::ffi::c_void;
+    use core::mem::{align_of, size_of};
+    use core::ptr;
+
+    #[repr(C)]
+    pub struct Vector<T> {
+        begin: *mut T,
+        end: *mut T,
+        end_cap: *mut T,
+    }
+
+    const _: () = assert!(size_of::<Vector<u8>>() == 3 * size_of::<*const u8>());
+    const _: () = assert!(align_of::<Vector<u8>>() == align_of::<*const u8>());
+
+    // The alignment up to which `::operator new(size_t)` suffices, and which
+    // `std::allocator` uses for all types that are not over-aligned. This is
+    // `__STDCPP_DEFAULT_NEW_ALIGNMENT__` on all the platforms that Crubit
+    // supports.
+    const DEFAULT_NEW_ALIGNMENT: usize = 16;
+
+    extern "C" {
+        // `::operator new(size_t)`, which `std::allocator<T>::allocate` calls.
+        #[link_name = "_Znwm"]
+        fn operator_new(size: usize) -> *mut c_void;
+        // `::operator delete(void*)`, which can free memory allocated by
+        // `::operator new(size_t)`.
+        #[link_name = "_ZdlPv"]
+        fn operator_delete(ptr: *mut c_void);
+    }
+
+    impl<T> Vector<T> {
+        /// Returns the number of elements in the vector.
+        #[inline(always)]
+        pub fn len(&self) -> usize {
+            if size_of::<T>() == 0 {
+                return 0;
+            }
+            (self.end as usize - self.begin as usize) / size_of::<T>()
+        }
+
+        /// Returns whether the vector contains no elements.
+        #[inline(always)]
+        pub fn is_empty(&self) -> bool {
+            self.begin == self.end
+        }
+
+        /// Returns the number of elements the vector can hold without
+        /// reallocating.
+        #[inline(always)]
+        pub fn capacity(&self) -> usize {
+            if size_of::<T>() == 0 {
+                return 0;
+            }
+            (self.end_cap as usize - self.begin as usize) / size_of::<T>()
+        }
+
+        /// Returns a pointer to the first element, which may be null if the
+        /// vector never had any elements (similar to C++ `data()`).
+        #[inline(always)]
+        pub fn as_ptr(&self) -> *const T {
+            self.begin
+        }
+
+        /// Returns the elements of the vector, without copying them.
+        ///
+        /// The slice borrows from the vector, so the vector can't be modified
+        /// (and its buffer can't be reallocated) while the slice is alive.
+        #[inline(always)]
+        pub fn as_slice(&self) -> &[T] {
+            if self.begin.is_null() {
+                return &[];
+            }
+            // SAFETY: `[begin, end)` are the initialized elements of the
+            // vector, which live as long as `self` is not modified.
+            unsafe { core::slice::from_raw_parts(self.begin, self.len()) }
+        }
+
+        /// Returns the elements of the vector as a mutable slice, without
+        /// copying them.
+        #[inline(always)]
+        pub fn as_mut_slice(&mut self) -> &mut [T] {
+            if self.begin.is_null() {
+                return &mut [];
+            }
+            // SAFETY: `[begin, end)` are the initialized elements of the
+            // vector, and `&mut self` guarantees exclusive access to them.
+            unsafe { core::slice::from_raw_parts_mut(self.begin, self.len()) }
+        }
+    }
+
+    /// Growing the vector moves the elements with a `memcpy`, and never runs
+    /// C++ copy or move constructors, so it is only available for `Copy`
+    /// types.
+    impl<T: Copy> Vector<T> {
+        /// Ensures the vector can hold at least `new_cap` elements without
+        /// reallocating. Like C++ `reserve()`, this never shrinks the buffer.
+        ///
+        /// Panics if `T` is over-aligned, since `std::allocator<T>` would then
+        /// use the aligned `::operator new`.
+        pub fn reserve(&mut self, new_cap: usize) {
+            assert!(align_of::<T>() <= DEFAULT_NEW_ALIGNMENT, "over-aligned types are unsupported");
+            assert!(size_of::<T>() != 0, "zero-sized types are unsupported");
+            if new_cap <= self.capacity() {
+                return;
+            }
+            let len = self.len();
+            let size = new_cap.checked_mul(size_of::<T>()).expect("capacity overflow");
+            // SAFETY: `::operator new` either returns a buffer of `size` bytes,
+            // suitably aligned for `T`, or throws (which aborts, since it
+            // unwinds through an `extern "C"` function).
+            let new_begin = unsafe { operator_new(size) } as *mut T;
+            if !self.begin.is_null() {
+                // SAFETY: the old buffer holds `len` initialized `T`s, and the
+                // new buffer has room for `new_cap > len` of them. The buffers
+                // are distinct allocations, so they don't overlap.
+                unsafe {
+                    ptr::copy_nonoverlapping(self.begin, new_begin, len);
+                    operator_delete(self.begin as *mut c_void);
+                }
+            }
+            self.begin = new_begin;
+            // SAFETY: `len` and `new_cap` are within the new allocation.
+            unsafe {
+                self.end = new_begin.add(len);
+                self.end_cap = new_begin.add(new_cap);
+            }
+        }
+
+        /// Appends `value` to the end of the vector, growing it if needed.
+        pub fn push_back(&mut self, value: T) {
+            if self.end == self.end_cap {
+                // Grow geometrically, like libc++ does.
+                let new_cap = core::cmp::max(2 * self.capacity(), 1);
+                self.reserve(new_cap);
+            }
+            // SAFETY: `end` is within the allocation, and past the initialized
+            // elements.
+            unsafe {
+                self.end.write(value);
+                self.end = self.end.add(1);
+            }
+        }
+    }
+}
@@ -91,6 +91,30 @@
 //! `ctor` adds a `ctor!` macro to make it easy to initialize a struct
 //! that contains non-trivially-relocatable fields.
 //!
+//! ## Move elision
+//!
+//! Composed `Ctor`s never construct into a temporary: `ctor!`, `ctor_then()`,
+//! `EitherCtor`, `emplace!` and `Box::emplace` all pass the final destination
+//! down to the innermost `Ctor`, so that each field of an aggregate is
+//! constructed directly in its final location. No C++ move constructor runs
+//! unless it is asked for, via `mov!` (or `RvalueReference`).
+//!
+//! In particular, to build an aggregate from the result of another function,
+//! pass the `Ctor` that function returns to `ctor!`, rather than emplacing it
+//! first:
+//!
+//! ```
+//! // No move: `Inner::new()` constructs directly into `outer.inner`.
+//! ctor!(Outer { inner: Inner::new() })
+//! // One move: `Inner::new()` constructs into `inner`, which is then moved into
+//! // `outer.inner`.
+//! emplace! { let inner = Inner::new(); }
+//! ctor!(Outer { inner: RvalueReference(inner) })
+//! ```
+//!
+//! To run code on a field after constructing it, use `ctor_then()`, and to
+//! choose between constructors at runtime, use `EitherCtor`.
+//!
 //! ## Features
 //!
 //! This library requires the following unstable features enabled in users:
@@ -467,6 +491,44 @@ impl<C: Ctor, F: FnOnce(Pin<&mut C::Output>)> Ctor for CtorThen<C, F> {
 
 impl<C: Ctor, F: FnOnce(Pin<&mut C::Output>)> !Unpin for CtorThen<C, F> {}
 
+// ==========
+// EitherCtor
+// ==========
+
+/// A `Ctor` which constructs using one of two `Ctor`s with the same output,
+/// chosen at runtime.
+///
+/// The two `Ctor`s usually have different types, so without `EitherCtor`, the
+/// branches of an `if` would need to be emplaced first, and then moved into
+/// place.
+///
+/// ```
+/// ctor!(Outer {
+///   inner: if use_default {
+///     EitherCtor::Left(Inner::ctor_new(()))
+///   } else {
+///     EitherCtor::Right(Inner::ctor_new(42))
+///   }
+/// })
+/// ```
+#[must_use = must_use_ctor!()]
+pub enum EitherCtor<L, R> {
+    Left(L),
+    Right(R),
+}
+
+impl<L: Ctor, R: Ctor<Output = L::Output>> Ctor for EitherCtor<L, R> {
+    type Output = L::Output;
+    unsafe fn ctor(self, dest: Pin<&mut MaybeUninit<Self::Output>>) {
+        match self {
+            EitherCtor::Left(ctor) => ctor.ctor(dest),
+            EitherCtor::Right(ctor) => ctor.ctor(dest),
+        }
+    }
+}
+
+impl<L, R> !Unpin for EitherCtor<L, R> {}
+
 // ========
 // emplace!
 // ========
@@ -1670,6 +1732,104 @@ mod test {
         assert_eq!(*log.borrow(), vec!["move ctor", "drop"]);
     }
 
+    struct LoggingInner<'a> {
+        x: DropCtorLogger<'a>,
+        y: DropCtorLogger<'a>,
+    }
+    unsafe impl RecursivelyPinned for LoggingInner<'_> {
+        type CtorInitializedFields = Self;
+    }
+
+    struct LoggingOuter<'a> {
+        inner: LoggingInner<'a>,
+        z: DropCtorLogger<'a>,
+    }
+    unsafe impl RecursivelyPinned for LoggingOuter<'_> {
+        type CtorInitializedFields = Self;
+    }
+
+    fn logging_ctor<'a>(
+        log: &'a RefCell<Vec<&'static str>>,
+        ctor_message: &'static str,
+    ) -> LoggingCtor<'a> {
+        LoggingCtor { log, ctor_message }
+    }
+
+    fn new_logging_inner<'a>(
+        log: &'a RefCell<Vec<&'static str>>,
+    ) -> impl Ctor<Output = LoggingInner<'a>> + Captures<'a> {
+        ctor!(LoggingInner {
+            x: logging_ctor(log, "x"),
+            y: logging_ctor(log, "y").ctor_then(|_| log.borrow_mut().push("then")),
+        })
+    }
+
+    /// Tests that composing `Ctor`s constructs every field of a nested
+    /// aggregate in place, without calling a move constructor.
+    #[test]
+    fn test_nested_ctor_no_moves() {
+        let log = RefCell::new(vec![]);
+        let log = &log;
+        {
+            emplace! {
+                let _outer = ctor!(LoggingOuter {
+                    inner: new_logging_inner(log),
+                    z: EitherCtor::<_, LoggingCtor>::Left(logging_ctor(log, "z")),
+                });
+            }
+            assert_eq!(*log.borrow(), vec!["x", "y", "then", "z"]);
+        }
+        assert_eq!(*log.borrow(), vec!["x", "y", "then", "z", "drop", "drop", "drop"]);
+    }
+
+    /// Tests that `Box::emplace` constructs a nested aggregate in place.
+    #[test]
+    fn test_nested_ctor_box_emplace_no_moves() {
+        let log = RefCell::new(vec![]);
+        let log = &log;
+        let outer = Box::emplace(ctor!(LoggingOuter {
+            inner: new_logging_inner(log),
+            z: logging_ctor(log, "z"),
+        }));
+        assert_eq!(*log.borrow(), vec!["x", "y", "then", "z"]);
+        drop(outer);
+    }
+
+    /// Tests that emplacing a field first, and then moving it into place,
+    /// calls the move constructor exactly once.
+    #[test]
+    fn test_nested_ctor_mov_moves_once() {
+        let log = RefCell::new(vec![]);
+        let log = &log;
+        {
+            emplace! {
+                let z = logging_ctor(log, "z");
+                let _outer = ctor!(LoggingOuter {
+                    inner: new_logging_inner(log),
+                    z: RvalueReference(z),
+                });
+            }
+            assert_eq!(*log.borrow(), vec!["z", "x", "y", "then", "move ctor"]);
+        }
+    }
+
+    #[test]
+    fn test_either_ctor() {
+        fn new_u32(add_two: bool) -> impl Ctor<Output = u32> {
+            if add_two {
+                EitherCtor::Left(40.ctor_then(|mut y| *y += 2))
+            } else {
+                EitherCtor::Right(1)
+            }
+        }
+        emplace! {
+            let left = new_u32(true);
+            let right = new_u32(false);
+        }
+        assert_eq!(*left, 42);
+        assert_eq!(*right, 1);
+    }
+
     fn takes_rvalue_reference<T>(_: RvalueReference<T>) {}
     /// Non-obvious fact: you can mov() an owned reference type! Moving anything
     /// also performs a rust move, but the resulting rvalue reference is
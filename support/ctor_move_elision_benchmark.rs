@@ -0,0 +1,124 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+//! Counts the move constructor calls (and measures the time) it takes to
+//! construct a nested aggregate with non-trivially-relocatable fields, either
+//! by composing `Ctor`s, or by emplacing a field first and moving it into
+//! place.
+#![cfg(test)]
+#![feature(negative_impls)]
+
+use ctor::{ctor, emplace, Ctor, CtorNew, EitherCtor, RecursivelyPinned, RvalueReference};
+use std::cell::Cell;
+use std::hint::black_box;
+use std::mem::MaybeUninit;
+use std::pin::Pin;
+use std::time::Instant;
+
+const ITERATIONS: usize = 1_000_000;
+
+thread_local! {
+    static MOVE_CTOR_CALLS: Cell<usize> = Cell::new(0);
+}
+
+/// A type which isn't trivially relocatable, like a C++ class with a
+/// user-defined move constructor, which counts the calls to that constructor.
+struct Field {
+    value: [u64; 4],
+}
+impl !Unpin for Field {}
+
+impl Field {
+    fn new(value: u64) -> FieldCtor {
+        FieldCtor(value)
+    }
+}
+
+struct FieldCtor(u64);
+impl !Unpin for FieldCtor {}
+
+impl Ctor for FieldCtor {
+    type Output = Field;
+    unsafe fn ctor(self, dest: Pin<&mut MaybeUninit<Field>>) {
+        Pin::into_inner_unchecked(dest).write(Field { value: [self.0; 4] });
+    }
+}
+
+impl CtorNew<RvalueReference<'_, Field>> for Field {
+    type CtorType = FieldCtor;
+    fn ctor_new(src: RvalueReference<'_, Field>) -> FieldCtor {
+        MOVE_CTOR_CALLS.with(|calls| calls.set(calls.get() + 1));
+        Field::new(src.value[0])
+    }
+}
+
+struct Inner {
+    a: Field,
+    b: Field,
+}
+unsafe impl RecursivelyPinned for Inner {
+    type CtorInitializedFields = Self;
+}
+
+struct Outer {
+    inner: Inner,
+    c: Field,
+}
+unsafe impl RecursivelyPinned for Outer {
+    type CtorInitializedFields = Self;
+}
+
+/// Runs `f` `ITERATIONS` times, and returns the move constructor calls per
+/// iteration.
+fn bench(name: &str, mut f: impl FnMut(u64) -> u64) -> usize {
+    MOVE_CTOR_CALLS.with(|calls| calls.set(0));
+    let start = Instant::now();
+    let mut sum = 0;
+    for i in 0..ITERATIONS {
+        sum += f(black_box(i as u64));
+    }
+    let nanos = start.elapsed().as_nanos();
+    black_box(sum);
+    let moves = MOVE_CTOR_CALLS.with(|calls| calls.get()) / ITERATIONS;
+    println!(
+        "{name}: {moves} move ctor calls, {:.3} ns/iteration",
+        nanos as f64 / ITERATIONS as f64
+    );
+    moves
+}
+
+#[test]
+fn bench_composed_ctors() {
+    let moves = bench("composed", |i| {
+        emplace! {
+            let outer = ctor!(Outer {
+                inner: ctor!(Inner { a: Field::new(i), b: Field::new(i + 1) }),
+                c: if i % 2 == 0 {
+                    EitherCtor::Left(Field::new(i + 2))
+                } else {
+                    EitherCtor::Right(Field::new(i + 3))
+                },
+            });
+        }
+        outer.inner.a.value[0] + outer.c.value[3]
+    });
+    assert_eq!(moves, 0);
+}
+
+#[test]
+fn bench_emplace_then_move() {
+    let moves = bench("emplace then move", |i| {
+        emplace! {
+            let a = Field::new(i);
+            let b = Field::new(i + 1);
+            let c = Field::new(i + 2);
+            let outer = ctor!(Outer {
+                inner: ctor!(Inner { a: RvalueReference(a), b: RvalueReference(b) }),
+                c: RvalueReference(c),
+            });
+        }
+        outer.inner.a.value[0] + outer.c.value[3]
+    });
+    assert_eq!(moves, 3);
+}
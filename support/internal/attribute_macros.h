@@ -71,4 +71,29 @@
 #define CRUBIT_INTERNAL_SAME_ABI \
   CRUBIT_INTERNAL_ANNOTATE("crubit_internal_same_abi")
 
+// Also generates a batch variant of a function's Rust bindings.
+//
+// This can be applied to a non-member function that takes a single parameter
+// and returns a value, both of which are of types that can be passed by value
+// across the C ABI (e.g. integers, floating point numbers, enums, and structs
+// of these). Calling such a function from a Rust loop crosses the language
+// boundary once per element; the batch variant instead calls it on each element
+// of a slice, looping on the C++ side, where the loop can be inlined and
+// vectorized.
+//
+// For example, this C++ header:
+//
+// ```c++
+// CRUBIT_INTERNAL_BATCH inline float Square(float x) { return x * x; }
+// ```
+//
+// Becomes this Rust interface:
+//
+// ```rust
+// pub fn Square(x: f32) -> f32;
+// pub fn Square_batch(input: &[f32], output: &mut [f32]);  // panics if the
+//                                                          // lengths differ
+// ```
+#define CRUBIT_INTERNAL_BATCH CRUBIT_INTERNAL_ANNOTATE("crubit_internal_batch")
+
 #endif  // CRUBIT_SUPPORT_INTERNAL_ATTRIBUTES_H_
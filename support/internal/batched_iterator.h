@@ -0,0 +1,130 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_SUPPORT_INTERNAL_BATCHED_ITERATOR_H_
+#define CRUBIT_SUPPORT_INTERNAL_BATCHED_ITERATOR_H_
+
+#include <cstddef>
+#include <type_traits>
+
+namespace crubit {
+
+// `BatchedIteratorEnd` is the sentinel returned by the `end()` method of
+// Rust iterators.  See `BatchedIterator` below.
+struct BatchedIteratorEnd final {};
+
+// `BatchedIterator<Item>` lets C++ range-based `for` loops consume a Rust
+// iterator, without calling into Rust for every item.  Instead, the items are
+// pulled from the Rust iterator in batches of up to `kBatchSize` items, into a
+// buffer stored in the `BatchedIterator` itself (i.e. on the C++ stack).
+//
+// An example will help to illustrate the purpose of this class:
+//
+//     ```rs
+//     pub struct Counter { ... }
+//     impl Iterator for Counter {
+//         type Item = u32;
+//         fn next(&mut self) -> Option<u32> { ... }
+//     }
+//     ```
+//
+// The generated C++ bindings of `Counter` will have `begin` and `end` methods
+// that return a `BatchedIterator<std::uint32_t>` and a `BatchedIteratorEnd`,
+// so that C++ can iterate over the items like so:
+//
+//     ```cc
+//     for (std::uint32_t i : counter) { ... }
+//     ```
+//
+// Note that (like `Iterator::next` in Rust) iterating consumes the items of
+// the Rust iterator.  In particular, breaking out of the loop early discards
+// the items that have already been pulled into the buffer (but that the loop
+// didn't get to).
+//
+// `Item` has to be trivially destructible: the Rust thunk moves the items into
+// the buffer (via `memcpy`), and the buffer never runs the items' destructors.
+template <typename Item, std::size_t kBatchSize = 64>
+class BatchedIterator final {
+  static_assert(std::is_trivially_destructible_v<Item>);
+  static_assert(kBatchSize > 0);
+
+ public:
+  // A (Rust thunk) function that writes the next (up to) `capacity` items of
+  // the Rust iterator `iter` into `buffer`, and returns the number of items
+  // written.  Writing fewer than `capacity` items means that the Rust iterator
+  // has been exhausted.
+  using NextBatchFn = std::size_t (*)(void* iter, Item* buffer,
+                                      std::size_t capacity);
+
+  using value_type = Item;
+  using reference = const Item&;
+
+  // Creates an iterator over the items of the Rust iterator `iter`, and pulls
+  // the first batch of items.
+  BatchedIterator(void* iter, NextBatchFn next_batch)
+      : iter_(iter), next_batch_(next_batch) {
+    Refill();
+  }
+
+  // Copying a `BatchedIterator` would copy the whole buffer (and there is
+  // still only one underlying Rust iterator).  Range-based `for` loops don't
+  // need to copy (or move) the iterator.
+  BatchedIterator(const BatchedIterator&) = delete;
+  BatchedIterator& operator=(const BatchedIterator&) = delete;
+  ~BatchedIterator() = default;
+
+  reference operator*() const { return buffer_[pos_]; }
+  const Item* operator->() const { return &buffer_[pos_]; }
+
+  BatchedIterator& operator++() {
+    ++pos_;
+    if (pos_ == size_) {
+      Refill();
+    }
+    return *this;
+  }
+
+  friend bool operator==(const BatchedIterator& it, BatchedIteratorEnd) {
+    return it.pos_ == it.size_;
+  }
+  friend bool operator!=(const BatchedIterator& it, BatchedIteratorEnd end) {
+    return !(it == end);
+  }
+  friend bool operator==(BatchedIteratorEnd end, const BatchedIterator& it) {
+    return it == end;
+  }
+  friend bool operator!=(BatchedIteratorEnd end, const BatchedIterator& it) {
+    return !(it == end);
+  }
+
+ private:
+  void Refill() {
+    pos_ = 0;
+    if (exhausted_) {
+      size_ = 0;
+      return;
+    }
+    size_ = next_batch_(iter_, buffer_, kBatchSize);
+    // Not calling into Rust again after a short batch is important for Rust
+    // iterators that are not fused (i.e. that may return `Some` after having
+    // returned `None`).
+    exhausted_ = size_ < kBatchSize;
+  }
+
+  void* iter_;
+  NextBatchFn next_batch_;
+  std::size_t pos_ = 0;
+  std::size_t size_ = 0;
+  bool exhausted_ = false;
+
+  // The anonymous union avoids running `Item`'s default constructor (which
+  // may not exist) - the items are written by the Rust thunk.
+  union {
+    Item buffer_[kBatchSize];
+  };
+};
+
+}  // namespace crubit
+
+#endif  // CRUBIT_SUPPORT_INTERNAL_BATCHED_ITERATOR_H_
@@ -0,0 +1,132 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "support/internal/batched_iterator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+// A fake of a Rust iterator that counts from 0 up to (but not including)
+// `limit`, which is not fused: after the first `None`, `next` starts
+// returning items again.
+struct FakeRustIterator {
+  std::int32_t next_item = 0;
+  std::int32_t limit = 0;
+  int num_calls = 0;
+};
+
+// A fake of the Rust thunk - calls the fake `Iterator::next` up to `capacity`
+// times.
+std::size_t FakeNextBatch(void* iter, std::int32_t* buffer,
+                          std::size_t capacity) {
+  auto& fake = *static_cast<FakeRustIterator*>(iter);
+  fake.num_calls++;
+  std::size_t len = 0;
+  while (len < capacity) {
+    if (fake.next_item >= fake.limit) {
+      fake.next_item = 0;  // Not fused.
+      break;
+    }
+    buffer[len++] = fake.next_item++;
+  }
+  return len;
+}
+
+template <std::size_t kBatchSize>
+struct FakeRange {
+  crubit::BatchedIterator<std::int32_t, kBatchSize> begin() {
+    return crubit::BatchedIterator<std::int32_t, kBatchSize>(&iter,
+                                                             &FakeNextBatch);
+  }
+  crubit::BatchedIteratorEnd end() { return {}; }
+
+  FakeRustIterator iter;
+};
+
+template <std::size_t kBatchSize>
+std::vector<std::int32_t> Collect(FakeRange<kBatchSize>& range) {
+  std::vector<std::int32_t> result;
+  for (std::int32_t i : range) {
+    result.push_back(i);
+  }
+  return result;
+}
+
+TEST(BatchedIteratorTest, Empty) {
+  FakeRange<4> range;
+  EXPECT_THAT(Collect(range), IsEmpty());
+  EXPECT_EQ(range.iter.num_calls, 1);
+}
+
+TEST(BatchedIteratorTest, SingleBatch) {
+  FakeRange<4> range{.iter = {.limit = 3}};
+  EXPECT_THAT(Collect(range), ElementsAre(0, 1, 2));
+  EXPECT_EQ(range.iter.num_calls, 1);
+}
+
+TEST(BatchedIteratorTest, MultipleBatches) {
+  FakeRange<4> range{.iter = {.limit = 10}};
+  EXPECT_THAT(Collect(range), ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9));
+  EXPECT_EQ(range.iter.num_calls, 3);
+}
+
+// A full last batch requires one more call to find out that the Rust iterator
+// has been exhausted.
+TEST(BatchedIteratorTest, FullLastBatch) {
+  FakeRange<4> range{.iter = {.limit = 8}};
+  EXPECT_THAT(Collect(range), ElementsAre(0, 1, 2, 3, 4, 5, 6, 7));
+  EXPECT_EQ(range.iter.num_calls, 3);
+}
+
+TEST(BatchedIteratorTest, DefaultBatchSize) {
+  FakeRange<64> range{.iter = {.limit = 1000}};
+  std::vector<std::int32_t> items = Collect(range);
+  ASSERT_EQ(items.size(), 1000);
+  EXPECT_EQ(items[999], 999);
+  EXPECT_EQ(range.iter.num_calls, 16);
+}
+
+TEST(BatchedIteratorTest, BreakDiscardsBufferedItems) {
+  FakeRange<4> range{.iter = {.limit = 10}};
+  for (std::int32_t i : range) {
+    if (i == 1) break;
+  }
+  // Items 2 and 3 have been pulled into the buffer of the first loop.
+  EXPECT_THAT(Collect(range), ElementsAre(4, 5, 6, 7, 8, 9));
+}
+
+// A struct without a default constructor can be an `Item`.
+struct NoDefaultCtor {
+  explicit NoDefaultCtor(int x) : x(x) {}
+  int x;
+};
+
+std::size_t NextBatchOfOne(void* iter, NoDefaultCtor* buffer,
+                           std::size_t /*capacity*/) {
+  bool& done = *static_cast<bool*>(iter);
+  if (done) return 0;
+  done = true;
+  buffer[0] = NoDefaultCtor(42);
+  return 1;
+}
+
+TEST(BatchedIteratorTest, ItemWithoutDefaultConstructor) {
+  bool done = false;
+  crubit::BatchedIterator<NoDefaultCtor> it(&done, &NextBatchOfOne);
+  ASSERT_NE(it, crubit::BatchedIteratorEnd());
+  EXPECT_EQ(it->x, 42);
+  ++it;
+  EXPECT_EQ(it, crubit::BatchedIteratorEnd());
+}
+
+}  // namespace
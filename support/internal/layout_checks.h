@@ -0,0 +1,38 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_SUPPORT_INTERNAL_LAYOUT_CHECKS_H_
+#define CRUBIT_SUPPORT_INTERNAL_LAYOUT_CHECKS_H_
+
+#include <cstddef>
+
+namespace crubit {
+
+// Returns the index of the first element of `actual` that differs from the
+// corresponding element of `expected`, or `N` if they are all equal.
+//
+// Bindings generated with `--compact_layout_assertions` check the sizes,
+// alignments and field offsets of all records in a single table, rather than
+// with a `static_assert` per value:
+//
+//     ```cc
+//     constexpr std::size_t kActual[] = {sizeof(S), alignof(S), ...};
+//     constexpr std::size_t kExpected[] = {4, 4, ...};
+//     static_assert(crubit::FirstLayoutMismatch(kActual, kExpected) == 2);
+//     ```
+//
+// If the check fails, Clang reports the index that was evaluated, which is the
+// position of the mismatched value in the table.
+template <std::size_t N>
+constexpr std::size_t FirstLayoutMismatch(const std::size_t (&actual)[N],
+                                          const std::size_t (&expected)[N]) {
+  for (std::size_t i = 0; i < N; ++i) {
+    if (actual[i] != expected[i]) return i;
+  }
+  return N;
+}
+
+}  // namespace crubit
+
+#endif  // CRUBIT_SUPPORT_INTERNAL_LAYOUT_CHECKS_H_
@@ -0,0 +1,37 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "support/internal/layout_checks.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "support/internal/offsetof.h"
+
+namespace {
+
+struct S {
+  int32_t a;
+  int64_t b;
+};
+
+constexpr std::size_t kActual[] = {sizeof(S), alignof(S),
+                                   CRUBIT_OFFSET_OF(a, S),
+                                   CRUBIT_OFFSET_OF(b, S)};
+constexpr std::size_t kExpected[] = {16, 8, 0, 8};
+static_assert(crubit::FirstLayoutMismatch(kActual, kExpected) == 4);
+
+TEST(LayoutChecksTest, AllMatch) {
+  constexpr std::size_t kValues[] = {1, 2, 3};
+  EXPECT_EQ(crubit::FirstLayoutMismatch(kValues, kValues), 3);
+}
+
+TEST(LayoutChecksTest, ReturnsFirstMismatch) {
+  constexpr std::size_t kActualValues[] = {1, 5, 3, 6};
+  constexpr std::size_t kExpectedValues[] = {1, 2, 3, 4};
+  EXPECT_EQ(crubit::FirstLayoutMismatch(kActualValues, kExpectedValues), 1);
+}
+
+}  // namespace
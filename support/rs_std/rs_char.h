@@ -5,10 +5,13 @@
 #ifndef CRUBIT_SUPPORT_RS_STD_CHAR_H_
 #define CRUBIT_SUPPORT_RS_STD_CHAR_H_
 
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 
 #include "absl/base/optimization.h"
+#include "absl/types/span.h"
 #include "support/internal/attribute_macros.h"
 
 namespace rs_std {
@@ -40,22 +43,48 @@ class CRUBIT_INTERNAL_RUST_TYPE("char") CRUBIT_INTERNAL_SAME_ABI rs_char final {
   // This function mimics Rust's `char::from_u32`:
   // https://doc.rust-lang.org/std/primitive.char.html#method.from_u32
   static constexpr std::optional<rs_char> from_u32(char32_t c) {
-    // TODO(lukasza): Consider using slightly more efficient checks similarly
-    // to how `char_try_from_u32` is implemented in Rust standard library.
-    if (ABSL_PREDICT_FALSE(c > 0x10ffff)) {
-      // Value greater than Rust's `char::MAX`:
-      // https://doc.rust-lang.org/std/primitive.char.html#associatedconstant.MAX
-      return std::nullopt;
-    }
-
-    if (ABSL_PREDICT_FALSE(c >= 0xd800 && c <= 0xdfff)) {
-      // Surrogate characters.
+    if (ABSL_PREDICT_FALSE(!is_valid_u32(c))) {
       return std::nullopt;
     }
 
     return from_u32_unchecked(c);
   }
 
+  // Converts each `char32_t` of `input` into a `rs_std::rs_char` at the same
+  // index of `output` (which must be at least as long as `input`), as
+  // `from_u32` would.
+  //
+  // Returns the number of converted values: `input.size()` if all of them are
+  // valid, or else the index of the first invalid value.  The values of
+  // `output` from that index on are unspecified (but valid `rs_char`s).
+  //
+  // Unlike a loop over `from_u32`, this validates and copies a block of values
+  // at a time without branching on each of them, so that compilers can
+  // vectorize the conversion.
+  static size_t from_u32_span(absl::Span<const char32_t> input,
+                              absl::Span<rs_char> output) {
+    assert(output.size() >= input.size());
+    constexpr size_t kBlockSize = 16;
+    size_t i = 0;
+    for (; i + kBlockSize <= input.size(); i += kBlockSize) {
+      bool all_valid = true;
+      for (size_t j = i; j < i + kBlockSize; ++j) {
+        bool valid = is_valid_u32(input[j]);
+        all_valid &= valid;
+        // Invalid values are replaced, so that `output` never holds them.
+        output[j] = from_u32_unchecked(valid ? input[j] : 0);
+      }
+      if (ABSL_PREDICT_FALSE(!all_valid)) break;
+    }
+    // The values after the last full block, or the block with the first
+    // invalid value.
+    for (; i < input.size(); ++i) {
+      if (ABSL_PREDICT_FALSE(!is_valid_u32(input[i]))) return i;
+      output[i] = from_u32_unchecked(input[i]);
+    }
+    return input.size();
+  }
+
   constexpr rs_char(const rs_char&) = default;
   constexpr rs_char& operator=(const rs_char&) = default;
   constexpr rs_char(rs_char&&) = default;
@@ -90,6 +119,17 @@ class CRUBIT_INTERNAL_RUST_TYPE("char") CRUBIT_INTERNAL_SAME_ABI rs_char final {
   static const rs_char MAX;
 
  private:
+  // Whether `c` is neither a surrogate nor greater than Rust's `char::MAX`:
+  // https://doc.rust-lang.org/std/primitive.char.html#associatedconstant.MAX
+  //
+  // This is the single comparison that `char_try_from_u32` in the Rust
+  // standard library uses: `^ 0xd800` maps the surrogates to
+  // `[0, 0x800)`, and `- 0x800` then wraps them around above the other
+  // invalid values.
+  static constexpr bool is_valid_u32(std::uint32_t c) {
+    return (c ^ 0xd800) - 0x800 < 0x110000 - 0x800;
+  }
+
   // This function mimics Rust's `char::from_u32_unchecked`:
   // https://doc.rust-lang.org/std/primitive.char.html#method.from_u32_unchecked
   //
@@ -0,0 +1,61 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "third_party/benchmark/include/benchmark/benchmark.h"
+#include "support/rs_std/rs_char.h"
+
+namespace {
+
+// Valid values from all the ranges of Unicode scalar values (ASCII, the Basic
+// Multilingual Plane below and above the surrogates, and the other planes).
+std::vector<char32_t> MakeInput(size_t size) {
+  constexpr char32_t kValues[] = {U'a', 0xd7ff, 0xe000, U'🦀', 0x10ffff};
+  std::vector<char32_t> input(size);
+  for (size_t i = 0; i < size; ++i) {
+    input[i] = kValues[i % std::size(kValues)];
+  }
+  return input;
+}
+
+// Converts the values one at a time, as callers without a bulk API do.
+void BM_FromU32Loop(benchmark::State& state) {
+  std::vector<char32_t> input = MakeInput(state.range(0));
+  std::vector<rs_std::rs_char> output(input.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < input.size(); ++i) {
+      std::optional<rs_std::rs_char> c = rs_std::rs_char::from_u32(input[i]);
+      if (!c.has_value()) break;
+      output[i] = *c;
+    }
+    benchmark::DoNotOptimize(output.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_FromU32Loop)->Range(8, 1 << 16);
+
+void BM_FromU32Span(benchmark::State& state) {
+  std::vector<char32_t> input = MakeInput(state.range(0));
+  std::vector<rs_std::rs_char> output(input.size());
+  for (auto _ : state) {
+    size_t converted =
+        rs_std::rs_char::from_u32_span(input, absl::MakeSpan(output));
+    benchmark::DoNotOptimize(converted);
+    benchmark::DoNotOptimize(output.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_FromU32Span)->Range(8, 1 << 16);
+
+}  // namespace
+
+BENCHMARK_MAIN();
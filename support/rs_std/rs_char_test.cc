@@ -6,10 +6,13 @@
 
 #include <stdint.h>
 
+#include <cstddef>
 #include <optional>
 #include <type_traits>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "absl/types/span.h"
 
 namespace {
 
@@ -168,6 +171,49 @@ TEST(RsCharTest, ComparisonWithAnotherRsChar) {
   EXPECT_TRUE(*b > *a);
 }
 
+TEST(RsCharTest, FromU32Span) {
+  // More than one block of values, so that both the blocks and the values
+  // after them are covered.
+  std::vector<char32_t> input;
+  for (char32_t c = 0xd7f0; c < 0xd800; ++c) input.push_back(c);
+  for (char32_t c = 0xe000; c < 0xe010; ++c) input.push_back(c);
+  input.push_back(0x10ffff);
+  input.push_back(U'🦀');
+  std::vector<rs_std::rs_char> output(input.size());
+
+  EXPECT_EQ(input.size(),
+            rs_std::rs_char::from_u32_span(input, absl::MakeSpan(output)));
+  for (size_t i = 0; i < input.size(); ++i) {
+    EXPECT_EQ(input[i], uint32_t{output[i]}) << i;
+  }
+
+  EXPECT_EQ(size_t{0}, rs_std::rs_char::from_u32_span({}, {}));
+}
+
+TEST(RsCharTest, FromU32SpanValidityChecks) {
+  // The index of the first invalid value, whether in a full block of values or
+  // after the last one.
+  for (size_t invalid_index : {0, 5, 15, 16, 31, 32, 34}) {
+    for (char32_t invalid :
+         std::vector<char32_t>{0xd800, 0xdfff, 0x110000, 0xffffffff}) {
+      std::vector<char32_t> input(35, U'a');
+      input[invalid_index] = invalid;
+      input.back() = 0xdc00;
+      std::vector<rs_std::rs_char> output(input.size());
+
+      EXPECT_EQ(invalid_index,
+                rs_std::rs_char::from_u32_span(input, absl::MakeSpan(output)))
+          << uint32_t{invalid} << " at " << invalid_index;
+      for (size_t i = 0; i < invalid_index; ++i) {
+        EXPECT_EQ(U'a', uint32_t{output[i]}) << i;
+      }
+      for (rs_std::rs_char c : output) {
+        EXPECT_TRUE(rs_std::rs_char::from_u32(uint32_t{c}).has_value());
+      }
+    }
+  }
+}
+
 TEST(RsCharTest, DefaultConstructedValue) {
   rs_std::rs_char c;
   EXPECT_EQ(0, uint32_t{c});
@@ -0,0 +1,108 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_SUPPORT_RS_STD_SLICE_REF_H_
+#define CRUBIT_SUPPORT_RS_STD_SLICE_REF_H_
+
+#include <cstddef>
+#include <type_traits>
+
+#if __cplusplus > 201703L
+#include <span>
+#endif
+
+namespace rs_std {
+
+// `rs_std::SliceRef<T>` is a C++ representation of the `&[T]` slice reference
+// type from Rust (and `rs_std::SliceRef<T>` with a non-const `T` represents
+// `&mut [T]`).  `rust_builtin_type_abi_assumptions.md` documents the layout
+// compatibility of these types.
+//
+// Like a Rust slice reference, a `SliceRef` doesn't own the elements - it is a
+// pointer to the first element together with the number of elements.  It is
+// trivially copyable, and therefore passing a `SliceRef` to (or returning it
+// from) Rust never copies the elements.
+//
+// Unlike `std::span<T>`, the pointer of a `SliceRef` is never null - empty
+// slices use a dangling, but non-null and suitably aligned pointer, as
+// required by Rust.  The conversions from and to `std::span<T>` take care of
+// this difference.
+template <typename T>
+class SliceRef final {
+ public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using size_type = std::size_t;
+  using pointer = T*;
+  using reference = T&;
+  using iterator = T*;
+
+  // Creates an empty `SliceRef`.
+  SliceRef() noexcept : ptr_(dangling()), size_(0) {}
+
+  // Creates a `SliceRef` that refers to the `size` elements starting at
+  // `ptr`.  `ptr` may be null if `size` is 0.
+  SliceRef(T* ptr, size_type size) noexcept
+      : ptr_(ptr == nullptr ? dangling() : ptr), size_(size) {}
+
+  // Converts `SliceRef<T>` into `SliceRef<const T>` (similarly to how Rust
+  // can coerce `&mut [T]` into `&[T]`).
+  template <typename U,
+            typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+  SliceRef(SliceRef<U> other) noexcept  // NOLINT(google-explicit-constructor)
+      : ptr_(other.data()), size_(other.size()) {}
+
+#if __cplusplus > 201703L
+  // Converts a `std::span<T>` into a `SliceRef<T>`, without copying the
+  // elements.
+  template <typename U, std::size_t Extent,
+            typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+  SliceRef(std::span<U, Extent> span) noexcept  // NOLINT(google-explicit-constructor)
+      : SliceRef(span.data(), span.size()) {}
+
+  // Converts this `SliceRef<T>` into a `std::span<T>`, without copying the
+  // elements.
+  constexpr std::span<T> to_span() const noexcept {
+    return std::span<T>(ptr_, size_);
+  }
+  constexpr operator std::span<T>() const noexcept {  // NOLINT
+    return to_span();
+  }
+#endif
+
+  constexpr SliceRef(const SliceRef&) = default;
+  constexpr SliceRef& operator=(const SliceRef&) = default;
+  constexpr SliceRef(SliceRef&&) = default;
+  constexpr SliceRef& operator=(SliceRef&&) = default;
+  ~SliceRef() = default;
+
+  // Returns a pointer to the first element.  The pointer is dangling (but not
+  // null) if the slice is empty.
+  constexpr T* data() const noexcept { return ptr_; }
+  constexpr size_type size() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+
+  constexpr iterator begin() const noexcept { return ptr_; }
+  constexpr iterator end() const noexcept { return ptr_ + size_; }
+
+  constexpr T& operator[](size_type index) const noexcept {
+    return ptr_[index];
+  }
+
+ private:
+  // Mimics Rust's `NonNull::dangling`:
+  // https://doc.rust-lang.org/std/ptr/struct.NonNull.html#method.dangling
+  static T* dangling() noexcept {
+    return reinterpret_cast<T*>(alignof(T));  // NOLINT
+  }
+
+  // The field order matters - it is verified by the layout assertions in
+  // `assert_slice_ref_layout` in `cc_bindings_from_rs/bindings.rs`.
+  T* ptr_;
+  size_type size_;
+};
+
+}  // namespace rs_std
+
+#endif  // CRUBIT_SUPPORT_RS_STD_SLICE_REF_H_
@@ -0,0 +1,103 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "support/rs_std/slice_ref.h"
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Check that `rs_std::SliceRef` is trivially destructible, copyable, and
+// moveable, so that it can be passed to (and returned from) Rust with a
+// `memcpy`.
+static_assert(std::is_trivially_destructible_v<rs_std::SliceRef<const int>>);
+static_assert(
+    std::is_trivially_copy_constructible_v<rs_std::SliceRef<const int>>);
+static_assert(std::is_trivially_copy_assignable_v<rs_std::SliceRef<const int>>);
+static_assert(
+    std::is_trivially_move_constructible_v<rs_std::SliceRef<const int>>);
+static_assert(std::is_trivially_move_assignable_v<rs_std::SliceRef<const int>>);
+
+// Layout assertions.
+//
+// `cc_bindings_from_rs` assumes that `&[T]` is a pointer followed by a
+// `usize` length.  This is verified on Rust side in `assert_slice_ref_layout`
+// in `cc_bindings_from_rs/bindings.rs` via `layout.size()`, `layout.align()`
+// and `layout.abi()`.
+static_assert(sizeof(rs_std::SliceRef<const int>) == 2 * sizeof(void*));
+static_assert(alignof(rs_std::SliceRef<const int>) == alignof(void*));
+static_assert(std::is_standard_layout_v<rs_std::SliceRef<const int>>);
+
+// `SliceRef<T>` (i.e. `&mut [T]`) converts to `SliceRef<const T>` (i.e.
+// `&[T]`), but not the other way around.
+static_assert(std::is_convertible_v<rs_std::SliceRef<int>,
+                                    rs_std::SliceRef<const int>>);
+static_assert(!std::is_convertible_v<rs_std::SliceRef<const int>,
+                                     rs_std::SliceRef<int>>);
+
+TEST(SliceRefTest, Default) {
+  rs_std::SliceRef<const int64_t> slice;
+  EXPECT_TRUE(slice.empty());
+  EXPECT_EQ(slice.size(), 0);
+  EXPECT_EQ(slice.begin(), slice.end());
+
+  // Rust requires a non-null and aligned pointer even for empty slices.
+  EXPECT_NE(slice.data(), nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(slice.data()) % alignof(int64_t), 0);
+}
+
+TEST(SliceRefTest, FromEmptySpan) {
+  std::span<const int64_t> span;
+  ASSERT_EQ(span.data(), nullptr);
+
+  rs_std::SliceRef<const int64_t> slice = span;
+  EXPECT_TRUE(slice.empty());
+  EXPECT_NE(slice.data(), nullptr);
+}
+
+TEST(SliceRefTest, FromSpanDoesNotCopy) {
+  std::vector<int> v = {1, 2, 3};
+  rs_std::SliceRef<int> slice = std::span<int>(v);
+  EXPECT_EQ(slice.data(), v.data());
+  EXPECT_EQ(slice.size(), 3);
+
+  slice[1] = 42;
+  EXPECT_EQ(v[1], 42);
+}
+
+TEST(SliceRefTest, ToSpan) {
+  std::vector<int> v = {1, 2, 3};
+  rs_std::SliceRef<const int> slice(v.data(), v.size());
+  std::span<const int> span = slice;
+  EXPECT_EQ(span.data(), v.data());
+  EXPECT_EQ(span.size(), 3);
+}
+
+TEST(SliceRefTest, Iteration) {
+  const int array[] = {1, 2, 3};
+  rs_std::SliceRef<const int> slice(array, 3);
+  int sum = 0;
+  for (int i : slice) {
+    sum += i;
+  }
+  EXPECT_EQ(sum, 6);
+}
+
+TEST(SliceRefTest, MutToConst) {
+  int array[] = {1, 2, 3};
+  rs_std::SliceRef<int> mut_slice(array, 3);
+  rs_std::SliceRef<const int> const_slice = mut_slice;
+  EXPECT_EQ(const_slice.data(), array);
+  EXPECT_EQ(const_slice.size(), 3);
+}
+
+}  // namespace
@@ -0,0 +1,160 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef CRUBIT_SUPPORT_RS_STD_STR_REF_H_
+#define CRUBIT_SUPPORT_RS_STD_STR_REF_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace rs_std {
+
+// `rs_std::StrRef` is a C++ representation of the `&str` string reference
+// type from Rust.  `rust_builtin_type_abi_assumptions.md` documents the layout
+// compatibility of these types.
+//
+// Like `std::string_view`, a `StrRef` doesn't own the characters - it is a
+// pointer to the first byte together with the number of bytes.  Passing a
+// `StrRef` to (or returning it from) Rust never copies the characters.
+//
+// Unlike `std::string_view`:
+// - The bytes of a `StrRef` are always valid UTF-8 (Rust's `str` requires
+//   this).  `StrRef::from_utf8` verifies this, and
+//   `StrRef::from_utf8_unchecked` can be used when the caller already knows
+//   that the bytes are valid UTF-8 (e.g. for ASCII string literals, or for
+//   strings that came from Rust).
+// - The pointer of a `StrRef` is never null, even for empty strings, as
+//   required by Rust.
+class StrRef final {
+ public:
+  using size_type = std::size_t;
+  using const_iterator = const char*;
+
+  // Creates an empty `StrRef`.
+  constexpr StrRef() noexcept : StrRef("", 0) {}
+
+  // Converts a `std::string_view` into a `StrRef`, without copying the
+  // characters.  Returns `std::nullopt` if `s` is not valid UTF-8.
+  //
+  // This function mimics Rust's `str::from_utf8`:
+  // https://doc.rust-lang.org/std/str/fn.from_utf8.html
+  static constexpr std::optional<StrRef> from_utf8(std::string_view s) {
+    if (!is_valid_utf8(s)) {
+      return std::nullopt;
+    }
+    return from_utf8_unchecked(s);
+  }
+
+  // Converts a `std::string_view` into a `StrRef`, without copying the
+  // characters and without verifying that `s` is valid UTF-8.
+  //
+  // SAFETY REQUIREMENTS: `s` is valid UTF-8.  Passing invalid UTF-8 to Rust is
+  // undefined behavior.
+  //
+  // This function mimics Rust's `str::from_utf8_unchecked`:
+  // https://doc.rust-lang.org/std/str/fn.from_utf8_unchecked.html
+  static constexpr StrRef from_utf8_unchecked(std::string_view s) noexcept {
+    return s.data() == nullptr ? StrRef() : StrRef(s.data(), s.size());
+  }
+
+  constexpr StrRef(const StrRef&) = default;
+  constexpr StrRef& operator=(const StrRef&) = default;
+  constexpr StrRef(StrRef&&) = default;
+  constexpr StrRef& operator=(StrRef&&) = default;
+  ~StrRef() = default;
+
+  // Converts this `StrRef` into a `std::string_view`, without copying the
+  // characters.
+  constexpr std::string_view to_string_view() const noexcept {
+    return std::string_view(ptr_, size_);
+  }
+  constexpr operator std::string_view() const noexcept {  // NOLINT
+    return to_string_view();
+  }
+
+  // Returns a pointer to the first byte.  Note that (unlike C strings) the
+  // bytes are not null-terminated.
+  constexpr const char* data() const noexcept { return ptr_; }
+
+  // Returns the length of the string in bytes (not in characters).
+  constexpr size_type size() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+
+  constexpr const_iterator begin() const noexcept { return ptr_; }
+  constexpr const_iterator end() const noexcept { return ptr_ + size_; }
+
+  constexpr bool operator==(const StrRef& other) const noexcept {
+    return to_string_view() == other.to_string_view();
+  }
+  constexpr bool operator!=(const StrRef& other) const noexcept {
+    return !(*this == other);
+  }
+
+ private:
+  // Private constructor - intended to only be used from `from_utf8_unchecked`
+  // (and the default constructor).  `ptr` is never null.
+  constexpr StrRef(const char* ptr, size_type size) noexcept
+      : ptr_(ptr), size_(size) {}
+
+  // Returns whether `s` is valid UTF-8, i.e. that it doesn't contain overlong
+  // encodings, surrogates, or code points above `char::MAX`.  See also
+  // https://doc.rust-lang.org/std/str/fn.from_utf8.html#errors
+  static constexpr bool is_valid_utf8(std::string_view s) {
+    size_type i = 0;
+    while (i < s.size()) {
+      const std::uint8_t b0 = static_cast<std::uint8_t>(s[i]);
+      if (b0 < 0x80) {
+        i += 1;
+        continue;
+      }
+
+      // The number of continuation bytes, and the valid range of the first
+      // continuation byte (narrower than 0x80..=0xbf to reject overlong
+      // encodings, surrogates, and code points above 0x10ffff).
+      size_type num_continuation_bytes = 0;
+      std::uint8_t min_b1 = 0x80;
+      std::uint8_t max_b1 = 0xbf;
+      if (b0 >= 0xc2 && b0 <= 0xdf) {
+        num_continuation_bytes = 1;
+      } else if (b0 >= 0xe0 && b0 <= 0xef) {
+        num_continuation_bytes = 2;
+        if (b0 == 0xe0) min_b1 = 0xa0;
+        if (b0 == 0xed) max_b1 = 0x9f;
+      } else if (b0 >= 0xf0 && b0 <= 0xf4) {
+        num_continuation_bytes = 3;
+        if (b0 == 0xf0) min_b1 = 0x90;
+        if (b0 == 0xf4) max_b1 = 0x8f;
+      } else {
+        return false;
+      }
+
+      if (s.size() - i <= num_continuation_bytes) {
+        return false;
+      }
+      const std::uint8_t b1 = static_cast<std::uint8_t>(s[i + 1]);
+      if (b1 < min_b1 || b1 > max_b1) {
+        return false;
+      }
+      for (size_type j = 2; j <= num_continuation_bytes; ++j) {
+        const std::uint8_t b = static_cast<std::uint8_t>(s[i + j]);
+        if (b < 0x80 || b > 0xbf) {
+          return false;
+        }
+      }
+      i += num_continuation_bytes + 1;
+    }
+    return true;
+  }
+
+  // The field order matters - it is verified by the layout assertions in
+  // `assert_slice_ref_layout` in `cc_bindings_from_rs/bindings.rs`.
+  const char* ptr_;
+  size_type size_;
+};
+
+}  // namespace rs_std
+
+#endif  // CRUBIT_SUPPORT_RS_STD_STR_REF_H_
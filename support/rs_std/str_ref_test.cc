@@ -0,0 +1,108 @@
+// Part of the Crubit project, under the Apache License v2.0 with LLVM
+// Exceptions. See /LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "support/rs_std/str_ref.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using ::rs_std::StrRef;
+
+// Check that `rs_std::StrRef` is trivially destructible, copyable, and
+// moveable, so that it can be passed to (and returned from) Rust with a
+// `memcpy`.
+static_assert(std::is_trivially_destructible_v<StrRef>);
+static_assert(std::is_trivially_copy_constructible_v<StrRef>);
+static_assert(std::is_trivially_copy_assignable_v<StrRef>);
+static_assert(std::is_trivially_move_constructible_v<StrRef>);
+static_assert(std::is_trivially_move_assignable_v<StrRef>);
+
+// Layout assertions.
+//
+// `cc_bindings_from_rs` assumes that `&str` is a pointer followed by a
+// `usize` length.  This is verified on Rust side in `assert_slice_ref_layout`
+// in `cc_bindings_from_rs/bindings.rs` via `layout.size()`, `layout.align()`
+// and `layout.abi()`.
+static_assert(sizeof(StrRef) == 2 * sizeof(void*));
+static_assert(alignof(StrRef) == alignof(void*));
+static_assert(std::is_standard_layout_v<StrRef>);
+
+// `from_utf8` can be used in constant expressions.
+static_assert(StrRef::from_utf8("foo").has_value());
+static_assert(!StrRef::from_utf8("\xff").has_value());
+
+TEST(StrRefTest, Default) {
+  StrRef s;
+  EXPECT_TRUE(s.empty());
+  EXPECT_EQ(s.size(), 0);
+  EXPECT_NE(s.data(), nullptr);
+}
+
+TEST(StrRefTest, FromEmptyStringView) {
+  std::string_view sv;
+  ASSERT_EQ(sv.data(), nullptr);
+
+  std::optional<StrRef> s = StrRef::from_utf8(sv);
+  ASSERT_TRUE(s.has_value());
+  EXPECT_TRUE(s->empty());
+  EXPECT_NE(s->data(), nullptr);
+  EXPECT_NE(StrRef::from_utf8_unchecked(sv).data(), nullptr);
+}
+
+TEST(StrRefTest, FromStringViewDoesNotCopy) {
+  std::string str = "Hello, world!";
+  std::optional<StrRef> s = StrRef::from_utf8(str);
+  ASSERT_TRUE(s.has_value());
+  EXPECT_EQ(s->data(), str.data());
+  EXPECT_EQ(s->size(), str.size());
+
+  std::string_view sv = *s;
+  EXPECT_EQ(sv.data(), str.data());
+  EXPECT_EQ(sv, "Hello, world!");
+}
+
+TEST(StrRefTest, FromUtf8Valid) {
+  EXPECT_TRUE(StrRef::from_utf8("ASCII").has_value());
+  EXPECT_TRUE(StrRef::from_utf8("\xc2\xa0").has_value());          // U+00A0
+  EXPECT_TRUE(StrRef::from_utf8("\xe2\x82\xac").has_value());      // U+20AC
+  EXPECT_TRUE(StrRef::from_utf8("\xed\x9f\xbf").has_value());      // U+D7FF
+  EXPECT_TRUE(StrRef::from_utf8("\xf0\x9f\x98\x80").has_value());  // U+1F600
+  EXPECT_TRUE(StrRef::from_utf8("\xf4\x8f\xbf\xbf").has_value());  // U+10FFFF
+  EXPECT_TRUE(StrRef::from_utf8(std::string_view("\0", 1)).has_value());
+}
+
+TEST(StrRefTest, FromUtf8Invalid) {
+  // Unexpected continuation byte.
+  EXPECT_FALSE(StrRef::from_utf8("\x80").has_value());
+  // Truncated sequences.
+  EXPECT_FALSE(StrRef::from_utf8("\xc2").has_value());
+  EXPECT_FALSE(StrRef::from_utf8("\xe2\x82").has_value());
+  EXPECT_FALSE(StrRef::from_utf8("\xf0\x9f\x98").has_value());
+  // Non-continuation byte in the middle of a sequence.
+  EXPECT_FALSE(StrRef::from_utf8("\xe2\x41\xac").has_value());
+  // Overlong encodings.
+  EXPECT_FALSE(StrRef::from_utf8("\xc0\xaf").has_value());
+  EXPECT_FALSE(StrRef::from_utf8("\xe0\x80\xaf").has_value());
+  EXPECT_FALSE(StrRef::from_utf8("\xf0\x80\x80\xaf").has_value());
+  // Surrogates.
+  EXPECT_FALSE(StrRef::from_utf8("\xed\xa0\x80").has_value());
+  // Above `char::MAX`.
+  EXPECT_FALSE(StrRef::from_utf8("\xf4\x90\x80\x80").has_value());
+  EXPECT_FALSE(StrRef::from_utf8("\xf5\x80\x80\x80").has_value());
+}
+
+TEST(StrRefTest, Equality) {
+  std::string str = "foo";
+  StrRef s = StrRef::from_utf8_unchecked(str);
+  EXPECT_EQ(s, StrRef::from_utf8_unchecked("foo"));
+  EXPECT_NE(s, StrRef::from_utf8_unchecked("bar"));
+}
+
+}  // namespace